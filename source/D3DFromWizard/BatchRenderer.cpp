@@ -0,0 +1,351 @@
+//
+// BatchRenderer.cpp - Offline rendering of queued camera and scene jobs into image files
+//
+
+#include "pch.h"
+#include "BatchRenderer.h"
+#include "FrameCapture.h"
+#include "MeshLoader.h"
+#include "SampleScenes.h"
+
+#include <chrono>
+#include <deque>
+#include <float.h>
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+    const float c_fovAngleY = 0.785398163f;
+    const float c_degreesToRadians = 0.0174532925f;
+
+    // The rest of the line after the fields already read, without surrounding blanks.
+    std::string ReadRest(std::istringstream& stream)
+    {
+        std::string rest;
+        std::getline(stream, rest);
+        size_t first = rest.find_first_not_of(" \t\r");
+        size_t last = rest.find_last_not_of(" \t\r");
+        return first == std::string::npos ? std::string() : rest.substr(first, last - first + 1);
+    }
+};
+
+bool DX::LoadBatchJobs(const std::string& path, std::vector<BatchJob>& jobs, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "Unable to read " + path;
+        return false;
+    }
+
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream stream(line);
+        std::string first;
+        if (!(stream >> first))
+        {
+            continue;
+        }
+
+        BatchJob job = {};
+        if (first == "turntable")
+        {
+            uint32_t images = 0;
+            if (stream >> job.scene >> images >> job.pitch >> job.distance >> job.width >> job.height && images > 0)
+            {
+                std::string prefix = ReadRest(stream);
+                if (!prefix.empty())
+                {
+                    for (uint32_t image = 0; image < images; ++image)
+                    {
+                        char suffix[32];
+                        sprintf_s(suffix, "%03u.png", image);
+                        job.yaw = 360.0f * image / images;
+                        job.output = prefix + suffix;
+                        jobs.push_back(job);
+                    }
+                    continue;
+                }
+            }
+        }
+        else
+        {
+            job.scene = first;
+            if (stream >> job.yaw >> job.pitch >> job.distance >> job.width >> job.height)
+            {
+                job.output = ReadRest(stream);
+                if (!job.output.empty())
+                {
+                    jobs.push_back(job);
+                    continue;
+                }
+            }
+        }
+
+        error = path + "(" + std::to_string(lineNumber) + "): expected a job, got \"" + line + "\"";
+        return false;
+    }
+
+    return true;
+}
+
+DX::BatchRenderer::BatchRenderer(IBatchRenderBackend& backend) :
+    m_backend(backend)
+{
+}
+
+bool DX::BatchRenderer::LoadScenes(const std::vector<BatchJob>& jobs, const std::string& assetDirectory, std::string& error)
+{
+    error.clear();
+    for (const BatchJob& job : jobs)
+    {
+        if (FindScene(job.scene))
+        {
+            continue;
+        }
+
+        const SampleMesh* sample = FindSampleMesh(job.scene);
+        std::string meshPath = sample ? sample->path : job.scene;
+
+        Scene scene = {};
+        scene.name = job.scene;
+        try
+        {
+            MeshData mesh = LoadMesh(assetDirectory + "/" + meshPath);
+
+            // Cameras orbit the bounding sphere around the box centre.
+            float lower[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float upper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (const MeshVertex& vertex : mesh.vertices)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lower[axis] = std::min(lower[axis], vertex.position[axis]);
+                    upper[axis] = std::max(upper[axis], vertex.position[axis]);
+                }
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                scene.center[axis] = mesh.vertices.empty() ? 0.0f : 0.5f * (lower[axis] + upper[axis]);
+            }
+            for (const MeshVertex& vertex : mesh.vertices)
+            {
+                float dx = vertex.position[0] - scene.center[0];
+                float dy = vertex.position[1] - scene.center[1];
+                float dz = vertex.position[2] - scene.center[2];
+                scene.radius = std::max(scene.radius, dx * dx + dy * dy + dz * dz);
+            }
+            scene.radius = std::max(sqrtf(scene.radius), 1e-6f);
+
+            scene.index = m_backend.AddScene(mesh);
+        }
+        catch (const std::exception& exception)
+        {
+            error += std::string(exception.what()) + "\n";
+
+            // Jobs naming it are counted as failed.
+            scene.radius = 0.0f;
+        }
+        m_scenes.push_back(scene);
+    }
+
+    return error.empty();
+}
+
+DX::BatchStatistics DX::BatchRenderer::Run(const std::vector<BatchJob>& jobs, uint32_t encodeThreads)
+{
+    using Clock = std::chrono::steady_clock;
+
+    BatchStatistics statistics = {};
+    statistics.latencySeconds.assign(jobs.size(), 0.0);
+
+    std::vector<Clock::time_point> beginTimes(jobs.size());
+    std::vector<size_t> jobOfSequence(jobs.size());
+
+    // Only ever called on one thread at a time; read once Stop has joined it.
+    CaptureDesc desc;
+    desc.format = CaptureFormat_Png;
+    desc.framesPerSecond = 0;
+    desc.encodeThreads = encodeThreads;
+    desc.waitWhenFull = true;
+    desc.onWritten = [&](uint64_t sequence, bool written)
+    {
+        size_t job = jobOfSequence[sequence];
+        if (written)
+        {
+            statistics.latencySeconds[job] = std::chrono::duration<double>(Clock::now() - beginTimes[job]).count();
+            statistics.images++;
+        }
+        else
+        {
+            statistics.failed++;
+        }
+    };
+
+    FrameCapture capture;
+    capture.Start(desc);
+
+    auto start = Clock::now();
+
+    // Targets in use hold jobs in the order they began, which is the order they finish in.
+    std::deque<std::pair<uint32_t, size_t>> inFlight;
+    std::vector<uint32_t> freeTargets;
+    for (uint32_t target = m_backend.GetTargetCount(); target-- > 0;)
+    {
+        freeTargets.push_back(target);
+    }
+
+    size_t next = 0;
+    uint64_t sequence = 0;
+    uint32_t skipped = 0;
+    while (next < jobs.size() || !inFlight.empty())
+    {
+        bool begun = false;
+        while (!freeTargets.empty() && next < jobs.size())
+        {
+            const BatchJob& job = jobs[next];
+            const Scene* scene = FindScene(job.scene);
+            if (!scene || scene->radius == 0.0f || job.width == 0 || job.height == 0)
+            {
+                skipped++;
+                next++;
+                continue;
+            }
+
+            BatchView view;
+            BuildView(*scene, job, view);
+
+            beginTimes[next] = Clock::now();
+            m_backend.Begin(freeTargets.back(), view);
+            inFlight.emplace_back(freeTargets.back(), next);
+            freeTargets.pop_back();
+            next++;
+            begun = true;
+        }
+
+        if (begun)
+        {
+            m_backend.Flush();
+        }
+
+        if (inFlight.empty())
+        {
+            continue;
+        }
+
+        // Only wait for the oldest job when no other can be started meanwhile.
+        uint32_t target = inFlight.front().first;
+        size_t jobIndex = inFlight.front().second;
+        bool wait = freeTargets.empty() || next == jobs.size();
+
+        const uint8_t* pixels;
+        uint32_t rowPitch;
+        PixelFormat format;
+        if (!m_backend.Map(target, wait, pixels, rowPitch, format))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const BatchJob& job = jobs[jobIndex];
+        jobOfSequence[sequence++] = jobIndex;
+        capture.SubmitPixels(pixels, job.width, job.height, rowPitch, format, job.output.c_str());
+        m_backend.Unmap(target);
+
+        freeTargets.push_back(target);
+        inFlight.pop_front();
+    }
+
+    capture.Stop();
+    statistics.failed += skipped;
+
+    statistics.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    statistics.imagesPerSecond = statistics.seconds > 0.0 ? statistics.images / statistics.seconds : 0.0;
+    return statistics;
+}
+
+const DX::BatchRenderer::Scene* DX::BatchRenderer::FindScene(const std::string& name) const
+{
+    for (const Scene& scene : m_scenes)
+    {
+        if (scene.name == name)
+        {
+            return &scene;
+        }
+    }
+    return nullptr;
+}
+
+void DX::BatchRenderer::BuildView(const Scene& scene, const BatchJob& job, BatchView& view) const
+{
+    float yaw = job.yaw * c_degreesToRadians;
+    float pitch = job.pitch * c_degreesToRadians;
+
+    // Yaw 0 looks at the front, down +Z; positive yaw orbits to the right.
+    float toEye[3] = { -cosf(pitch) * sinf(yaw), sinf(pitch), -cosf(pitch) * cosf(yaw) };
+    float distance = job.distance * scene.radius;
+    float eye[3] =
+    {
+        scene.center[0] + toEye[0] * distance,
+        scene.center[1] + toEye[1] * distance,
+        scene.center[2] + toEye[2] * distance
+    };
+
+    // Depth covers the bounding sphere, with the near plane as far out as that allows.
+    float nearZ = std::max(distance - scene.radius, 0.01f * scene.radius);
+    float farZ = distance + scene.radius * 1.01f;
+
+    float viewMatrix[4][4];
+    float projection[4][4];
+    BuildLookAtMatrix(eye, scene.center, viewMatrix);
+    BuildPerspectiveMatrix(c_fovAngleY, static_cast<float>(job.width) / job.height, nearZ, farZ, projection);
+
+    view.scene = scene.index;
+    view.width = job.width;
+    view.height = job.height;
+    MultiplyMatrices(viewMatrix, projection, view.worldViewProjection);
+
+    // A key light above and behind the camera.
+    float light[3] = { toEye[0], toEye[1] + 0.8f, toEye[2] };
+    float length = sqrtf(light[0] * light[0] + light[1] * light[1] + light[2] * light[2]);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        view.lightDirection[axis] = light[axis] / length;
+    }
+}
+
+std::string DX::FormatBatchStatistics(const BatchStatistics& statistics)
+{
+    std::vector<double> latencies;
+    for (double latency : statistics.latencySeconds)
+    {
+        if (latency > 0.0)
+        {
+            latencies.push_back(latency);
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&](double fraction)
+    {
+        return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))] * 1000.0;
+    };
+
+    char buff[256] = {};
+    sprintf_s(buff, "Batch: %u images, %u failed in %.2f s (%.1f images/s); latency p50 %.1f ms, p95 %.1f ms, max %.1f ms\n",
+        statistics.images, statistics.failed, statistics.seconds, statistics.imagesPerSecond,
+        percentile(0.5), percentile(0.95), latencies.empty() ? 0.0 : latencies.back() * 1000.0);
+    return buff;
+}
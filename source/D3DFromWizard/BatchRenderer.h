@@ -0,0 +1,115 @@
+//
+// BatchRenderer.h - Offline rendering of queued camera and scene jobs into image files
+//
+
+#pragma once
+
+#include "ImageEncoding.h"
+#include "MeshData.h"
+
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // One image: a camera orbiting a scene's bounding sphere, looking at its centre.
+    struct BatchJob
+    {
+        std::string scene;          // A sample mesh name (see GetSampleMeshes), or a mesh path.
+        float       yaw;            // Degrees around the vertical axis.
+        float       pitch;          // Degrees above the horizon.
+        float       distance;       // In bounding radii from the centre.
+        uint32_t    width;
+        uint32_t    height;
+        std::string output;         // A .png file.
+    };
+
+    // Reads a job list, one job per line, '#' starting a comment:
+    //   <scene> <yaw> <pitch> <distance> <width> <height> <output.png>
+    //   turntable <scene> <images> <pitch> <distance> <width> <height> <output prefix>
+    // A turntable is that many jobs at evenly spaced yaws, written to <prefix>000.png onwards.
+    // Returns false with a message naming the line if the file cannot be read or parsed.
+    bool LoadBatchJobs(const std::string& path, std::vector<BatchJob>& jobs, std::string& error);
+
+    // What a backend draws for one job: the scene with this transform, lit from lightDirection
+    // (world space, towards the light), over the background colour.
+    struct BatchView
+    {
+        uint32_t    scene;
+        uint32_t    width;
+        uint32_t    height;
+        float       worldViewProjection[4][4];     // Row vectors, D3D clip space.
+        float       lightDirection[3];
+    };
+
+    // A backend renders jobs into its own offscreen targets. Several jobs can be in flight: Begin
+    // only queues the work where the backend allows it, and Map of the oldest job reports whether
+    // it has finished.
+    interface IBatchRenderBackend
+    {
+        virtual ~IBatchRenderBackend() {}
+
+        // Returns the scene's index for BatchView.
+        virtual uint32_t AddScene(const MeshData& mesh) = 0;
+
+        // Targets that can hold jobs at once.
+        virtual uint32_t GetTargetCount() const = 0;
+
+        virtual void Begin(uint32_t target, const BatchView& view) = 0;
+
+        // Starts the work queued by Begin.
+        virtual void Flush() = 0;
+
+        // Returns false if the target's job is not finished yet and wait is false. Otherwise the
+        // pixels stay valid until Unmap.
+        virtual bool Map(uint32_t target, bool wait, const uint8_t*& pixels, uint32_t& rowPitch, PixelFormat& format) = 0;
+        virtual void Unmap(uint32_t target) = 0;
+    };
+
+    struct BatchStatistics
+    {
+        uint32_t                images;             // Written.
+        uint32_t                failed;             // Unknown scene, or the file could not be written.
+        double                  seconds;            // From the first Begin until the last file is written.
+        double                  imagesPerSecond;
+        std::vector<double>     latencySeconds;     // Per job, from Begin until written; 0 if it failed.
+    };
+
+    // Drives a backend over a job list. Scenes are loaded and uploaded once, then jobs are kept
+    // in flight on every target while finished images go through a FrameCapture's encode
+    // threads, so rendering, readback, PNG compression and disk writes overlap.
+    class BatchRenderer
+    {
+    public:
+        explicit BatchRenderer(IBatchRenderBackend& backend);
+
+        BatchRenderer(const BatchRenderer&) = delete;
+        BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+        // Loads every scene the jobs name that is not loaded yet. Scene names come from
+        // GetSampleMeshes; anything else is taken as a mesh path. Returns false, with the
+        // reasons, if any failed to load.
+        bool LoadScenes(const std::vector<BatchJob>& jobs, const std::string& assetDirectory, std::string& error);
+
+        // Renders the jobs in order and waits until every image is written.
+        BatchStatistics Run(const std::vector<BatchJob>& jobs, uint32_t encodeThreads);
+
+    private:
+        struct Scene
+        {
+            std::string name;
+            uint32_t    index;          // In the backend.
+            float       center[3];
+            float       radius;
+        };
+
+        const Scene* FindScene(const std::string& name) const;
+        void BuildView(const Scene& scene, const BatchJob& job, BatchView& view) const;
+
+        IBatchRenderBackend&    m_backend;
+        std::vector<Scene>      m_scenes;
+    };
+
+    // Images per second, then latency percentiles.
+    std::string FormatBatchStatistics(const BatchStatistics& statistics);
+}
@@ -0,0 +1,214 @@
+//
+// BatchBenchmark.cpp - Measures turntable rendering one image per process cycle, reloading the
+//                      scene each time, against the batch renderer
+//
+
+#include "pch.h"
+#include "BatchRenderer.h"
+#include "HeadlessBatchRenderBackend.h"
+#include "SampleScenes.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<BatchJob> MakeTurntable(const std::string& scene, uint32_t images, uint32_t width, uint32_t height, const std::string& prefix)
+    {
+        std::vector<BatchJob> jobs(images);
+        for (uint32_t image = 0; image < images; ++image)
+        {
+            char suffix[32];
+            sprintf_s(suffix, "%03u.png", image);
+
+            jobs[image].scene = scene;
+            jobs[image].yaw = 360.0f * image / images;
+            jobs[image].pitch = 20.0f;
+            jobs[image].distance = 2.5f;
+            jobs[image].width = width;
+            jobs[image].height = height;
+            jobs[image].output = prefix + suffix;
+        }
+        return jobs;
+    }
+
+    // What each image costs without batching: a fresh pool, backend and scene load, then the
+    // image rendered and encoded on the calling thread.
+    bool MeasureSingle(const std::vector<BatchJob>& jobs, const std::string& assetDirectory, BatchStatistics& statistics)
+    {
+        statistics = {};
+        statistics.latencySeconds.assign(jobs.size(), 0.0);
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            auto begin = Clock::now();
+
+            WorkerPool workers;
+            HeadlessBatchRenderBackend backend(&workers);
+            BatchRenderer renderer(backend);
+            std::vector<BatchJob> job(1, jobs[i]);
+
+            std::string error;
+            if (!renderer.LoadScenes(job, assetDirectory, error))
+            {
+                fprintf(stderr, "%s", error.c_str());
+                return false;
+            }
+
+            BatchStatistics single = renderer.Run(job, 0);
+            statistics.images += single.images;
+            statistics.failed += single.failed;
+            statistics.latencySeconds[i] = std::chrono::duration<double>(Clock::now() - begin).count();
+        }
+
+        statistics.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        statistics.imagesPerSecond = statistics.seconds > 0.0 ? statistics.images / statistics.seconds : 0.0;
+        return true;
+    }
+
+    // The scene is loaded once, outside the measurement's latencies but inside its total.
+    bool MeasureBatch(const std::vector<BatchJob>& jobs, const std::string& assetDirectory, uint32_t encodeThreads, BatchStatistics& statistics)
+    {
+        auto start = Clock::now();
+
+        WorkerPool workers;
+        HeadlessBatchRenderBackend backend(&workers);
+        BatchRenderer renderer(backend);
+
+        std::string error;
+        if (!renderer.LoadScenes(jobs, assetDirectory, error))
+        {
+            fprintf(stderr, "%s", error.c_str());
+            return false;
+        }
+
+        statistics = renderer.Run(jobs, encodeThreads);
+        statistics.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        statistics.imagesPerSecond = statistics.seconds > 0.0 ? statistics.images / statistics.seconds : 0.0;
+        return true;
+    }
+
+    void Report(const char* name, const BatchStatistics& statistics, const BatchStatistics* baseline)
+    {
+        std::vector<double> latencies = statistics.latencySeconds;
+        std::sort(latencies.begin(), latencies.end());
+        double p50 = latencies.empty() ? 0.0 : latencies[latencies.size() / 2] * 1000.0;
+        double p95 = latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)] * 1000.0;
+
+        printf("  %-6s %7.2f s  %7.1f images/s  latency p50 %8.1f ms  p95 %8.1f ms",
+            name, statistics.seconds, statistics.imagesPerSecond, p50, p95);
+        if (baseline)
+        {
+            printf("  %6.1fx", statistics.imagesPerSecond / std::max(baseline->imagesPerSecond, 1e-9));
+        }
+        printf("\n");
+    }
+
+    void RemoveOutputs(const std::vector<BatchJob>& jobs)
+    {
+        for (const BatchJob& job : jobs)
+        {
+            remove(job.output.c_str());
+        }
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardBatchBenchmark [options]\n"
+            "  --assets <dir>          directory holding the scene meshes (default %s)\n"
+            "  --images <n>            turntable images per scene (default 24)\n"
+            "  --width <n>             image width (default 640)\n"
+            "  --height <n>            image height (default 360)\n"
+            "  --threads <n>           encode threads of the batch runs (default 4)\n"
+            "  --output <prefix>       where the images go (default batch_benchmark_)\n"
+            "  --scene <name>          only teapot, corvette or murcielago\n"
+            "  --keep                  keep the images\n",
+            BENCHMARK_ASSET_DIRECTORY);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    uint32_t images = 24;
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t threads = 4;
+    std::string output = "batch_benchmark_";
+    std::string onlyScene;
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue)             assetDirectory = argv[++i];
+        else if (argument == "--images" && hasValue)        images = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--width" && hasValue)         width = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--height" && hasValue)        height = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--output" && hasValue)        output = argv[++i];
+        else if (argument == "--scene" && hasValue)         onlyScene = argv[++i];
+        else if (argument == "--keep")                      keep = true;
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (images == 0 || width == 0 || height == 0 || threads == 0)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    printf("%u turntable images of %ux%u per scene, %u encode threads\n", images, width, height, threads);
+
+    size_t sceneCount;
+    const SampleMesh* scenes = GetSampleMeshes(sceneCount);
+    for (size_t scene = 0; scene < sceneCount; ++scene)
+    {
+        if (!onlyScene.empty() && onlyScene != scenes[scene].name)
+        {
+            continue;
+        }
+
+        std::vector<BatchJob> jobs = MakeTurntable(scenes[scene].name, images, width, height, output + scenes[scene].name + "_");
+
+        BatchStatistics single, batch;
+        if (!MeasureSingle(jobs, assetDirectory, single) ||
+            !MeasureBatch(jobs, assetDirectory, threads, batch))
+        {
+            RemoveOutputs(jobs);
+            return 1;
+        }
+
+        printf("%s:\n", scenes[scene].name);
+        Report("single", single, nullptr);
+        Report("batch", batch, &single);
+
+        if (!keep)
+        {
+            RemoveOutputs(jobs);
+        }
+
+        if (single.failed != 0 || batch.failed != 0)
+        {
+            fprintf(stderr, "Some %s images were not written\n", scenes[scene].name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
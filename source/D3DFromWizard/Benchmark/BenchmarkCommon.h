@@ -0,0 +1,50 @@
+//
+// BenchmarkCommon.h - Timing and random numbers shared by the benchmarks
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+
+namespace DX
+{
+    // Runs load until minSeconds have passed, at least once, and returns the fastest run.
+    // load returns its own time, or 0 to be timed here.
+    template<typename Load>
+    double MeasureFastest(double minSeconds, Load load)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        double best = 1e30;
+        Clock::time_point start = Clock::now();
+        do
+        {
+            Clock::time_point begin = Clock::now();
+            double seconds = load();
+            best = std::min(best, seconds > 0.0 ? seconds : std::chrono::duration<double>(Clock::now() - begin).count());
+        } while (std::chrono::duration<double>(Clock::now() - start).count() < minSeconds);
+        return best;
+    }
+
+    // Stateless random numbers, so generated scenes come out identical in any order and on
+    // any thread.
+    inline uint32_t Mix(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    const uint32_t c_randomStreams = 16;
+
+    // Uniform in [0, 1). Each seed has c_randomStreams independent values, one per stream.
+    inline float Random(uint32_t seed, uint32_t stream)
+    {
+        return (Mix(seed * c_randomStreams + stream) >> 8) * (1.0f / 16777216.0f);
+    }
+}
@@ -0,0 +1,174 @@
+//
+// BenchmarkMain.cpp - Headless benchmark runner: runs preset scenes, writes results and
+//                     optionally fails when they regress against a baseline
+//
+
+#include "pch.h"
+#include "BenchmarkResults.h"
+
+#include <stdexcept>
+
+using namespace DX;
+
+#ifndef BENCHMARK_ASSET_DIRECTORY
+#define BENCHMARK_ASSET_DIRECTORY "meshes"
+#endif
+
+namespace
+{
+    const int c_exitRegression = 1;
+    const int c_exitError = 2;
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardBenchmark [options]\n"
+            "  --scene <name>          run only this preset (may be repeated; default: all)\n"
+            "  --list                  list the presets and exit\n"
+            "  --warmup-frames <n>     frames rendered before measuring (default 120)\n"
+            "  --frames <n>            frames measured per scene (default 600)\n"
+            "  --assets <directory>    mesh directory (default " BENCHMARK_ASSET_DIRECTORY ")\n"
+            "  --output <file>         write JSON results to file instead of stdout\n"
+            "  --baseline <file>       compare against earlier results\n"
+            "  --threshold <fraction>  slowdown that counts as a regression (default 0.10)\n");
+    }
+
+    const char* NextArgument(int argc, char** argv, int& i)
+    {
+        if (i + 1 >= argc)
+        {
+            throw std::runtime_error(std::string("missing value for ") + argv[i]);
+        }
+        return argv[++i];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> sceneNames;
+    uint32_t warmupFrames = 120;
+    uint32_t frames = 600;
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    std::string outputPath;
+    std::string baselinePath;
+    double threshold = 0.10;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string argument = argv[i];
+            if (argument == "--scene")              sceneNames.push_back(NextArgument(argc, argv, i));
+            else if (argument == "--warmup-frames") warmupFrames = static_cast<uint32_t>(strtoul(NextArgument(argc, argv, i), nullptr, 10));
+            else if (argument == "--frames")        frames = static_cast<uint32_t>(strtoul(NextArgument(argc, argv, i), nullptr, 10));
+            else if (argument == "--assets")        assetDirectory = NextArgument(argc, argv, i);
+            else if (argument == "--output")        outputPath = NextArgument(argc, argv, i);
+            else if (argument == "--baseline")      baselinePath = NextArgument(argc, argv, i);
+            else if (argument == "--threshold")     threshold = strtod(NextArgument(argc, argv, i), nullptr);
+            else if (argument == "--list")
+            {
+                size_t count = 0;
+                const PresetSceneDesc* presets = GetPresetScenes(count);
+                for (size_t j = 0; j < count; ++j)
+                {
+                    printf("%s\n", presets[j].name);
+                }
+                return 0;
+            }
+            else if (argument == "--help" || argument == "-h")
+            {
+                PrintUsage(stdout);
+                return 0;
+            }
+            else
+            {
+                throw std::runtime_error("unknown option " + argument);
+            }
+        }
+
+        if (frames == 0)
+        {
+            throw std::runtime_error("--frames must be at least 1");
+        }
+
+        std::vector<const PresetSceneDesc*> scenes;
+        if (sceneNames.empty())
+        {
+            size_t count = 0;
+            const PresetSceneDesc* presets = GetPresetScenes(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                scenes.push_back(&presets[i]);
+            }
+        }
+        for (const std::string& name : sceneNames)
+        {
+            const PresetSceneDesc* preset = FindPresetScene(name);
+            if (!preset)
+            {
+                throw std::runtime_error("unknown scene " + name);
+            }
+            scenes.push_back(preset);
+        }
+
+        // Load the baseline first so a bad path fails before minutes of rendering.
+        std::vector<BenchmarkBaseline> baseline;
+        if (!baselinePath.empty())
+        {
+            baseline = LoadBenchmarkBaseline(baselinePath);
+        }
+
+        std::vector<BenchmarkSceneResult> results;
+        for (const PresetSceneDesc* desc : scenes)
+        {
+            fprintf(stderr, "%s: loading %s\n", desc->name, desc->mesh);
+            results.push_back(RunBenchmarkScene(*desc, assetDirectory, warmupFrames, frames));
+
+            const BenchmarkSceneResult& result = results.back();
+            const TelemetryChannelSummary& frame = result.telemetry.channels[TelemetryChannel_Frame];
+            fprintf(stderr, "%s: %u instances, %.0f draws, %.0f triangles/frame, frame p50 %.3f ms p95 %.3f ms p99 %.3f ms\n",
+                result.name.c_str(), result.instances, result.counters.draws, result.counters.visibleTriangles,
+                frame.p50, frame.p95, frame.p99);
+        }
+
+        std::string text = FormatBenchmarkResults(results);
+        if (outputPath.empty())
+        {
+            fputs(text.c_str(), stdout);
+        }
+        else
+        {
+            FILE* file = nullptr;
+            if (fopen_s(&file, outputPath.c_str(), "wb") != 0 || !file)
+            {
+                throw std::runtime_error("cannot write " + outputPath);
+            }
+            fputs(text.c_str(), file);
+            fclose(file);
+        }
+
+        if (!baselinePath.empty())
+        {
+            bool regressed = false;
+            for (const BenchmarkComparison& comparison : CompareBenchmarkResults(baseline, results, threshold))
+            {
+                fprintf(stderr, "%s %s: %.3f ms -> %.3f ms (%+.1f%%)%s\n",
+                    comparison.name.c_str(), comparison.metric, comparison.baseline, comparison.current,
+                    comparison.change * 100.0, comparison.regressed ? " REGRESSION" : "");
+                regressed |= comparison.regressed;
+            }
+            if (regressed)
+            {
+                return c_exitRegression;
+            }
+        }
+    }
+    catch (const std::exception& error)
+    {
+        fprintf(stderr, "error: %s\n", error.what());
+        PrintUsage(stderr);
+        return c_exitError;
+    }
+
+    return 0;
+}
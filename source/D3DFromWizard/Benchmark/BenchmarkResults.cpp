@@ -0,0 +1,319 @@
+//
+// BenchmarkResults.cpp - Machine-readable benchmark results and regression comparison
+//
+
+#include "pch.h"
+#include "BenchmarkResults.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+using namespace DX;
+
+namespace
+{
+    const int c_resultsVersion = 1;
+
+    // Differences below this are timer and scheduler noise however large they are relatively.
+    const double c_noiseFloorMilliseconds = 0.01;
+
+    // Just enough JSON to read back what FormatBenchmarkResults writes: objects, arrays,
+    // numbers, strings without escapes, booleans and null.
+    struct JsonValue
+    {
+        enum Type { Null, Boolean, Number, String, Array, Object };
+
+        JsonValue() : type(Null), number(0.0) {}
+
+        const JsonValue* Find(const char* key) const
+        {
+            auto it = members.find(key);
+            return it != members.end() ? &it->second : nullptr;
+        }
+
+        Type                                type;
+        double                              number;
+        std::string                         text;
+        std::vector<JsonValue>              elements;
+        std::map<std::string, JsonValue>    members;
+    };
+
+    class JsonReader
+    {
+    public:
+        explicit JsonReader(const std::string& text) : m_text(text), m_position(0) {}
+
+        JsonValue Parse()
+        {
+            JsonValue value = ParseValue();
+            SkipWhitespace();
+            if (m_position != m_text.size())
+            {
+                Fail("trailing characters");
+            }
+            return value;
+        }
+
+    private:
+        void Fail(const char* what)
+        {
+            throw std::runtime_error(std::string("JSON ") + what + " at offset " + std::to_string(m_position));
+        }
+
+        void SkipWhitespace()
+        {
+            while (m_position < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_position])))
+            {
+                m_position++;
+            }
+        }
+
+        bool Consume(char c)
+        {
+            SkipWhitespace();
+            if (m_position < m_text.size() && m_text[m_position] == c)
+            {
+                m_position++;
+                return true;
+            }
+            return false;
+        }
+
+        void Expect(char c)
+        {
+            if (!Consume(c))
+            {
+                Fail("syntax error");
+            }
+        }
+
+        bool ConsumeWord(const char* word)
+        {
+            size_t length = strlen(word);
+            if (m_text.compare(m_position, length, word) == 0)
+            {
+                m_position += length;
+                return true;
+            }
+            return false;
+        }
+
+        std::string ParseString()
+        {
+            Expect('"');
+            size_t end = m_text.find('"', m_position);
+            if (end == std::string::npos)
+            {
+                Fail("unterminated string");
+            }
+            std::string text = m_text.substr(m_position, end - m_position);
+            m_position = end + 1;
+            return text;
+        }
+
+        JsonValue ParseValue()
+        {
+            JsonValue value;
+            SkipWhitespace();
+            if (m_position >= m_text.size())
+            {
+                Fail("unexpected end");
+            }
+
+            char c = m_text[m_position];
+            if (c == '{')
+            {
+                m_position++;
+                value.type = JsonValue::Object;
+                if (!Consume('}'))
+                {
+                    do
+                    {
+                        std::string key = ParseString();
+                        Expect(':');
+                        value.members[key] = ParseValue();
+                    } while (Consume(','));
+                    Expect('}');
+                }
+            }
+            else if (c == '[')
+            {
+                m_position++;
+                value.type = JsonValue::Array;
+                if (!Consume(']'))
+                {
+                    do
+                    {
+                        value.elements.push_back(ParseValue());
+                    } while (Consume(','));
+                    Expect(']');
+                }
+            }
+            else if (c == '"')
+            {
+                value.type = JsonValue::String;
+                value.text = ParseString();
+            }
+            else if (ConsumeWord("true"))
+            {
+                value.type = JsonValue::Boolean;
+                value.number = 1.0;
+            }
+            else if (ConsumeWord("false"))
+            {
+                value.type = JsonValue::Boolean;
+            }
+            else if (ConsumeWord("null"))
+            {
+                value.type = JsonValue::Null;
+            }
+            else
+            {
+                const char* start = m_text.c_str() + m_position;
+                char* end = nullptr;
+                value.type = JsonValue::Number;
+                value.number = strtod(start, &end);
+                if (end == start)
+                {
+                    Fail("unexpected character");
+                }
+                m_position += end - start;
+            }
+            return value;
+        }
+
+        const std::string&  m_text;
+        size_t              m_position;
+    };
+
+    double GetNumber(const JsonValue& object, const char* key)
+    {
+        const JsonValue* value = object.Find(key);
+        if (!value || value->type != JsonValue::Number)
+        {
+            throw std::runtime_error(std::string("missing number \"") + key + "\"");
+        }
+        return value->number;
+    }
+
+    const JsonValue& GetMember(const JsonValue& object, const char* key, JsonValue::Type type)
+    {
+        const JsonValue* value = object.Find(key);
+        if (!value || value->type != type)
+        {
+            throw std::runtime_error(std::string("missing member \"") + key + "\"");
+        }
+        return *value;
+    }
+
+    void AddComparison(std::vector<BenchmarkComparison>& comparisons, const std::string& name, const char* metric, double baseline, double current, double threshold)
+    {
+        BenchmarkComparison comparison;
+        comparison.name = name;
+        comparison.metric = metric;
+        comparison.baseline = baseline;
+        comparison.current = current;
+        comparison.change = baseline > 0.0 ? (current - baseline) / baseline : 0.0;
+        comparison.regressed = comparison.change > threshold && current - baseline > c_noiseFloorMilliseconds;
+        comparisons.push_back(comparison);
+    }
+}
+
+std::string DX::FormatBenchmarkResults(const std::vector<BenchmarkSceneResult>& results)
+{
+    char buffer[768];
+    sprintf_s(buffer, "{\"version\":%d,\"scenes\":[", c_resultsVersion);
+    std::string text = buffer;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkSceneResult& result = results[i];
+        sprintf_s(buffer,
+            "%s\n{\"name\":\"%s\",\"instances\":%u,\"sourceTriangles\":%llu,\"loadMs\":%.3f,\"cookMs\":%.3f,"
+            "\"warmupFrames\":%u,\"frames\":%u,"
+            "\"perFrame\":{\"visibleInstances\":%.1f,\"visibleClusters\":%.1f,\"visibleTriangles\":%.1f,\"drawnTriangles\":%.1f,"
+            "\"draws\":%.1f,\"bindings\":%.1f,\"materialSwitches\":%.1f,\"materialBinds\":%.1f},"
+            "\"telemetry\":",
+            i ? "," : "", result.name.c_str(), result.instances, static_cast<unsigned long long>(result.sourceTriangles),
+            result.loadMilliseconds, result.cookMilliseconds, result.warmupFrames, result.frames,
+            result.counters.visibleInstances, result.counters.visibleClusters, result.counters.visibleTriangles, result.counters.drawnTriangles,
+            result.counters.draws, result.counters.bindings, result.counters.materialSwitches, result.counters.materialBinds);
+        text += buffer;
+
+        // FormatJson writes one object per line; drop the line end to nest it.
+        std::string telemetry = FrameTelemetry::FormatJson(result.telemetry);
+        while (!telemetry.empty() && telemetry.back() == '\n')
+        {
+            telemetry.pop_back();
+        }
+        text += telemetry;
+        text += "}";
+    }
+
+    text += "\n]}\n";
+    return text;
+}
+
+std::vector<BenchmarkBaseline> DX::LoadBenchmarkBaseline(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open baseline " + path);
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    std::vector<BenchmarkBaseline> baseline;
+    try
+    {
+        JsonValue root = JsonReader(text).Parse();
+        if (root.type != JsonValue::Object || GetNumber(root, "version") != c_resultsVersion)
+        {
+            throw std::runtime_error("unsupported results version");
+        }
+
+        for (const JsonValue& scene : GetMember(root, "scenes", JsonValue::Array).elements)
+        {
+            const JsonValue& channels = GetMember(GetMember(scene, "telemetry", JsonValue::Object), "channels", JsonValue::Object);
+            const JsonValue& frame = GetMember(channels, GetTelemetryChannelName(TelemetryChannel_Frame), JsonValue::Object);
+
+            BenchmarkBaseline entry;
+            entry.name = GetMember(scene, "name", JsonValue::String).text;
+            entry.frameP50 = GetNumber(frame, "p50");
+            entry.frameP95 = GetNumber(frame, "p95");
+            baseline.push_back(entry);
+        }
+    }
+    catch (const std::runtime_error& error)
+    {
+        throw std::runtime_error(path + ": " + error.what());
+    }
+    return baseline;
+}
+
+std::vector<BenchmarkComparison> DX::CompareBenchmarkResults(
+    const std::vector<BenchmarkBaseline>& baseline,
+    const std::vector<BenchmarkSceneResult>& results,
+    double threshold)
+{
+    std::vector<BenchmarkComparison> comparisons;
+    for (const BenchmarkSceneResult& result : results)
+    {
+        for (const BenchmarkBaseline& entry : baseline)
+        {
+            if (entry.name == result.name)
+            {
+                const TelemetryChannelSummary& frame = result.telemetry.channels[TelemetryChannel_Frame];
+                AddComparison(comparisons, result.name, "frame p50", entry.frameP50, frame.p50, threshold);
+                AddComparison(comparisons, result.name, "frame p95", entry.frameP95, frame.p95, threshold);
+                break;
+            }
+        }
+    }
+    return comparisons;
+}
@@ -0,0 +1,43 @@
+//
+// BenchmarkResults.h - Machine-readable benchmark results and regression comparison
+//
+
+#pragma once
+
+#include "BenchmarkScene.h"
+
+namespace DX
+{
+    // The timings a baseline keeps for one scene, in milliseconds.
+    struct BenchmarkBaseline
+    {
+        std::string name;
+        double      frameP50;
+        double      frameP95;
+    };
+
+    struct BenchmarkComparison
+    {
+        std::string name;
+        const char* metric;
+        double      baseline;
+        double      current;
+        double      change;         // (current - baseline) / baseline
+        bool        regressed;
+    };
+
+    // One JSON document covering every scene of a run.
+    std::string FormatBenchmarkResults(const std::vector<BenchmarkSceneResult>& results);
+
+    // Reads the scenes of a document written by FormatBenchmarkResults. Throws std::runtime_error
+    // if the file cannot be read or is not a results document.
+    std::vector<BenchmarkBaseline> LoadBenchmarkBaseline(const std::string& path);
+
+    // Compares the frame time median and 95th percentile of every scene present in both. A metric
+    // regresses when it is more than threshold (a fraction) slower than the baseline and the
+    // slowdown is larger than timer noise.
+    std::vector<BenchmarkComparison> CompareBenchmarkResults(
+        const std::vector<BenchmarkBaseline>& baseline,
+        const std::vector<BenchmarkSceneResult>& results,
+        double threshold);
+}
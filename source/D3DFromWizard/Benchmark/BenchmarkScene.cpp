@@ -0,0 +1,70 @@
+//
+// BenchmarkScene.cpp - Preset scenes driven frame by frame through the headless game
+//
+
+#include "pch.h"
+#include "BenchmarkScene.h"
+#include "Game.h"
+
+using namespace DX;
+
+namespace
+{
+    const int c_outputWidth = 1920;
+    const int c_outputHeight = 1080;
+};
+
+DX::BenchmarkSceneResult DX::RunBenchmarkScene(const PresetSceneDesc& desc, const std::string& assetDirectory, uint32_t warmupFrames, uint32_t frames)
+{
+    Game game;
+    game.Initialize(nullptr, c_outputWidth, c_outputHeight);
+    PresetSceneLoadStatistics load = game.LoadScene(desc, assetDirectory);
+    game.OnRunModeChanged(RunMode_Benchmark);
+
+    BenchmarkSceneCounters counters = {};
+    for (uint32_t frame = 0; frame < warmupFrames + frames; ++frame)
+    {
+        // Every Tick starts by closing the frame before it, so resetting before the first
+        // measured Tick keeps one sample per measured frame in every channel.
+        if (frame == warmupFrames)
+        {
+            game.GetTelemetry().Reset();
+            counters = BenchmarkSceneCounters{};
+        }
+
+        game.Tick();
+
+        const PresetSceneStatistics& scene = game.GetScene()->GetStatistics();
+        const HeadlessCommandStatistics& sink = game.GetCommandStatistics();
+        const MaterialFrameStatistics& materials = game.GetMaterials().GetFrameStatistics();
+        counters.visibleInstances += scene.visibleInstances;
+        counters.visibleClusters += scene.visibleClusters;
+        counters.visibleTriangles += scene.visibleTriangles;
+        counters.drawnTriangles += scene.drawnTriangles;
+        counters.draws += sink.draws;
+        counters.bindings += sink.bindings;
+        counters.materialSwitches += materials.switches;
+        counters.materialBinds += materials.binds;
+    }
+
+    BenchmarkSceneResult result = {};
+    result.name = desc.name;
+    result.instances = game.GetScene()->GetInstanceCount();
+    result.sourceTriangles = load.sourceTriangles;
+    result.loadMilliseconds = load.loadMilliseconds;
+    result.cookMilliseconds = load.cookMilliseconds;
+    result.warmupFrames = warmupFrames;
+    result.frames = frames;
+    result.telemetry = game.GetTelemetry().GetSummary();
+
+    double scale = frames > 0 ? 1.0 / frames : 0.0;
+    result.counters.visibleInstances = counters.visibleInstances * scale;
+    result.counters.visibleClusters = counters.visibleClusters * scale;
+    result.counters.visibleTriangles = counters.visibleTriangles * scale;
+    result.counters.drawnTriangles = counters.drawnTriangles * scale;
+    result.counters.draws = counters.draws * scale;
+    result.counters.bindings = counters.bindings * scale;
+    result.counters.materialSwitches = counters.materialSwitches * scale;
+    result.counters.materialBinds = counters.materialBinds * scale;
+    return result;
+}
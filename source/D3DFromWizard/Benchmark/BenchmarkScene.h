@@ -0,0 +1,44 @@
+//
+// BenchmarkScene.h - Preset scenes driven frame by frame through the headless game
+//
+
+#pragma once
+
+#include "FrameTelemetry.h"
+#include "PresetScene.h"
+
+namespace DX
+{
+    // Per-frame averages over the measured phase.
+    struct BenchmarkSceneCounters
+    {
+        double visibleInstances;
+        double visibleClusters;
+        double visibleTriangles;
+        double drawnTriangles;
+        double draws;
+        double bindings;
+        double materialSwitches;
+        double materialBinds;
+    };
+
+    struct BenchmarkSceneResult
+    {
+        std::string             name;
+        uint32_t                instances;
+        size_t                  sourceTriangles;
+        double                  loadMilliseconds;
+        double                  cookMilliseconds;
+        uint32_t                warmupFrames;
+        uint32_t                frames;
+        TelemetrySummary        telemetry;
+        BenchmarkSceneCounters  counters;
+    };
+
+    // Creates a headless Game at 1920x1080, loads the preset into it and ticks it uncapped, as
+    // the game's --benchmark mode does: warm-up frames first, then the measured ones. Each
+    // frame is the game's own update and render, so the scene's culling, the compacted index
+    // list, state sorting and submission to the headless sink are all measured together.
+    // Throws std::runtime_error if the preset's mesh cannot be loaded.
+    BenchmarkSceneResult RunBenchmarkScene(const PresetSceneDesc& desc, const std::string& assetDirectory, uint32_t warmupFrames, uint32_t frames);
+}
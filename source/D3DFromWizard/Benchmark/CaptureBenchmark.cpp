@@ -0,0 +1,261 @@
+//
+// CaptureBenchmark.cpp - Measures what frame capture costs the game thread, encoding on the
+//                        submitting thread against the encode and writer threads
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "FrameCapture.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    const char* c_formatNames[] = { "raw", "png", "y4m" };
+    const char* c_formatExtensions[] = { ".rgba", "", ".y4m" };
+
+    // A stand-in for a rendered frame in BGRA order: a scrolling gradient with a few moving
+    // boxes and a little noise, so neither the filters nor the matcher have it too easy.
+    void DrawFrame(std::vector<uint32_t>& pixels, uint32_t width, uint32_t height, uint32_t frame)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            uint32_t* row = pixels.data() + size_t(y) * width;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint32_t r = ((x + frame * 3) * 255 / width) & 0xff;
+                uint32_t g = (y * 255 / height) & 0xff;
+                uint32_t b = (Mix(x * 7919u + y * 104729u + frame) & 0x0f) + 96;
+                row[x] = 0xff000000u | (r << 16) | (g << 8) | b;
+            }
+        }
+
+        for (uint32_t box = 0; box < 6; ++box)
+        {
+            uint32_t size = height / 8;
+            uint32_t left = (Mix(box) + frame * (box + 1) * 4) % (width - size);
+            uint32_t top = (Mix(box + 100) + frame * (box + 2)) % (height - size);
+            uint32_t color = Mix(box + 200) | 0xff000000u;
+            for (uint32_t y = top; y < top + size; ++y)
+            {
+                std::fill_n(pixels.data() + size_t(y) * width + left, size, color);
+            }
+        }
+    }
+
+    struct Result
+    {
+        FrameCaptureStatistics  statistics;
+        uint64_t                hash;           // Of everything written.
+    };
+
+    uint64_t HashFile(const std::string& path, uint64_t hash)
+    {
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "rb") != 0 || !file)
+        {
+            return hash;
+        }
+
+        std::vector<uint8_t> buffer(1 << 16);
+        size_t read;
+        while ((read = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+        {
+            for (size_t i = 0; i < read; ++i)
+            {
+                hash = HashValue(buffer[i], hash);
+            }
+        }
+        fclose(file);
+        return hash;
+    }
+
+    // Submits frames paced at framesPerSecond, as a game at that rate would, then stops the
+    // capture and hashes the output.
+    bool Measure(CaptureFormat format, uint32_t encodeThreads, const std::string& path,
+        const std::vector<std::vector<uint32_t>>& frames, uint32_t width, uint32_t height,
+        uint32_t frameCount, uint32_t framesPerSecond, bool keep, Result& result)
+    {
+        CaptureDesc desc;
+        desc.path = path;
+        desc.format = format;
+        desc.framesPerSecond = framesPerSecond;
+        desc.encodeThreads = encodeThreads;
+        desc.waitWhenFull = false;
+
+        FrameCapture capture;
+        if (!capture.Start(desc))
+        {
+            fprintf(stderr, "Unable to write %s\n", path.c_str());
+            return false;
+        }
+
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+        auto deadline = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frameCount; ++frame)
+        {
+            const std::vector<uint32_t>& pixels = frames[frame % frames.size()];
+            capture.SubmitPixels(pixels.data(), width, height, width * 4, PixelFormat_Bgra8);
+
+            deadline += interval;
+            std::this_thread::sleep_until(deadline);
+        }
+        capture.Stop();
+
+        result.statistics = capture.GetStatistics();
+
+        result.hash = c_hashSeed;
+        if (format == CaptureFormat_Png)
+        {
+            for (uint32_t frame = 0; frame < frameCount; ++frame)
+            {
+                char suffix[32];
+                sprintf_s(suffix, "%06u.png", frame);
+                result.hash = HashFile(path + suffix, result.hash);
+                if (!keep)
+                {
+                    remove((path + suffix).c_str());
+                }
+            }
+        }
+        else
+        {
+            result.hash = HashFile(path, result.hash);
+            if (!keep)
+            {
+                remove(path.c_str());
+            }
+        }
+        return true;
+    }
+
+    void Report(const char* name, const Result& result, uint32_t framesPerSecond, const Result* baseline)
+    {
+        const FrameCaptureStatistics& stats = result.statistics;
+        double submitted = static_cast<double>(std::max<uint64_t>(stats.submitted, 1));
+        double written = static_cast<double>(std::max<uint64_t>(stats.written, 1));
+        double submitMs = stats.submitSeconds * 1000.0 / submitted;
+
+        printf("  %-6s game thread %7.3f ms/frame (max %7.3f, %5.1f%% of the frame)  encode %7.3f ms  write %6.3f ms  "
+            "%4llu dropped  %7.1f MB",
+            name, submitMs, stats.maxSubmitSeconds * 1000.0, submitMs * framesPerSecond / 10.0,
+            stats.encodeSeconds * 1000.0 / written, stats.writeSeconds * 1000.0 / written,
+            static_cast<unsigned long long>(stats.dropped), stats.bytesWritten / (1024.0 * 1024.0));
+
+        if (baseline)
+        {
+            printf("  %6.1fx", baseline->statistics.submitSeconds / std::max(stats.submitSeconds, 1e-9));
+        }
+        printf("\n");
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardCaptureBenchmark [options]\n"
+            "  --width <n>             frame width (default 1280)\n"
+            "  --height <n>            frame height (default 720)\n"
+            "  --frames <n>            frames captured per run (default 120)\n"
+            "  --fps <n>               rate the frames are submitted at (default 60)\n"
+            "  --threads <n>           encode threads of the asynchronous runs (default 2)\n"
+            "  --output <prefix>       where the captures go (default capture_benchmark)\n"
+            "  --format <name>         only raw, png or y4m\n"
+            "  --keep                  keep the captured files\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t frameCount = 120;
+    uint32_t framesPerSecond = 60;
+    uint32_t threads = 2;
+    std::string output = "capture_benchmark";
+    int onlyFormat = -1;
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        CaptureFormat format;
+
+        if (argument == "--width" && hasValue)              width = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--height" && hasValue)        height = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--frames" && hasValue)        frameCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--fps" && hasValue)           framesPerSecond = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--output" && hasValue)        output = argv[++i];
+        else if (argument == "--format" && hasValue && ParseCaptureFormat(argv[i + 1], format))
+        {
+            onlyFormat = format;
+            ++i;
+        }
+        else if (argument == "--keep")                      keep = true;
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (width < 16 || height < 16 || frameCount == 0 || framesPerSecond == 0 || threads == 0)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    // A short loop of distinct frames, drawn up front so drawing is not measured.
+    std::vector<std::vector<uint32_t>> frames(std::min(frameCount, 16u));
+    for (uint32_t frame = 0; frame < frames.size(); ++frame)
+    {
+        frames[frame].resize(size_t(width) * height);
+        DrawFrame(frames[frame], width, height, frame);
+    }
+
+    printf("%u frames of %ux%u at %u FPS, %u encode threads, %u frames queued at most\n",
+        frameCount, width, height, framesPerSecond, threads, c_maxQueuedCaptureFrames);
+
+    bool identical = true;
+    for (uint32_t format = 0; format < 3; ++format)
+    {
+        if (onlyFormat >= 0 && format != static_cast<uint32_t>(onlyFormat))
+        {
+            continue;
+        }
+
+        std::string path = output + (format == CaptureFormat_Png ? "_" : "") + c_formatExtensions[format];
+
+        Result sync, async;
+        if (!Measure(static_cast<CaptureFormat>(format), 0, path, frames, width, height, frameCount, framesPerSecond, false, sync) ||
+            !Measure(static_cast<CaptureFormat>(format), threads, path, frames, width, height, frameCount, framesPerSecond, keep, async))
+        {
+            return 1;
+        }
+
+        // Both write every frame the same way; only where the work happens differs. When the
+        // encoders cannot keep up some frames are dropped, and there is nothing to compare.
+        bool comparable = sync.statistics.dropped == 0 && async.statistics.dropped == 0;
+        bool same = !comparable || sync.hash == async.hash;
+        identical = identical && same;
+
+        printf("%s:%s\n", c_formatNames[format], !same ? " (outputs differ)" : comparable ? "" : " (not compared: frames dropped)");
+        Report("sync", sync, framesPerSecond, nullptr);
+        Report("async", async, framesPerSecond, &sync);
+    }
+
+    if (!identical)
+    {
+        fprintf(stderr, "The asynchronous capture wrote different output\n");
+        return 1;
+    }
+
+    return 0;
+}
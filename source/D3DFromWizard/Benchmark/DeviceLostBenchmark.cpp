@@ -0,0 +1,313 @@
+//
+// DeviceLostBenchmark.cpp - Times device lost recovery: reloading assets against restoring
+//                           them from the resource registry
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "HeadlessResourceDevice.h"
+#include "MemoryTracker.h"
+#include "ResourceRegistry.h"
+
+#include <chrono>
+#include <string>
+
+using namespace DX;
+
+namespace
+{
+    // Stand-ins for the D3D11 values, which are not available without the SDK headers.
+    const uint32_t c_bindVertexBuffer = 0x1;
+    const uint32_t c_bindShaderResource = 0x8;
+    const uint32_t c_formatR8G8B8A8Unorm = 28;
+
+    struct AssetSetDesc
+    {
+        uint32_t    textures;
+        uint32_t    textureSize;
+        uint32_t    buffers;
+        uint32_t    bufferBytes;
+    };
+
+    struct Asset
+    {
+        std::string     name;
+        ResourceDesc    desc;
+        uint64_t        offset;     // In the pack file.
+        uint64_t        size;
+    };
+
+    // Smooth gradients with a little noise, so the mips are not all one colour.
+    std::vector<uint8_t> MakeTexture(uint32_t seed, uint32_t size)
+    {
+        std::vector<uint8_t> texels(size_t(size) * size * 4);
+        uint8_t* texel = texels.data();
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                uint32_t noise = Mix(seed * 0x9e3779b9u + y * size + x);
+                *texel++ = static_cast<uint8_t>(x * 255 / size + (noise & 15));
+                *texel++ = static_cast<uint8_t>(y * 255 / size + ((noise >> 4) & 15));
+                *texel++ = static_cast<uint8_t>(seed * 37 + ((noise >> 8) & 15));
+                *texel++ = 255;
+            }
+        }
+        return texels;
+    }
+
+    std::vector<uint8_t> MakeBuffer(uint32_t seed, uint32_t bytes)
+    {
+        std::vector<uint8_t> data(bytes);
+        for (uint32_t i = 0; i < bytes; ++i)
+        {
+            data[i] = static_cast<uint8_t>(Mix(seed * 0x85ebca6bu + i));
+        }
+        return data;
+    }
+
+    void WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+    {
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "wb") != 0 || !file)
+        {
+            throw std::runtime_error("Unable to write " + path);
+        }
+
+        bool written = data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size();
+        written = fclose(file) == 0 && written;
+        if (!written)
+        {
+            throw std::runtime_error("Unable to write " + path);
+        }
+    }
+
+    std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "rb") != 0 || !file)
+        {
+            throw std::runtime_error("Unable to read " + path);
+        }
+
+        std::vector<uint8_t> data;
+        uint8_t buffer[64 * 1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+        fclose(file);
+        return data;
+    }
+
+    // Writes every asset to its own file, as an asset directory would hold them, and all of
+    // them to one cooked pack that the registry maps.
+    std::vector<Asset> WriteAssetSet(const AssetSetDesc& set, const std::string& directory)
+    {
+        std::vector<Asset> assets;
+        std::vector<uint8_t> pack;
+
+        for (uint32_t i = 0; i < set.textures + set.buffers; ++i)
+        {
+            Asset asset;
+            std::vector<uint8_t> data;
+
+            char name[64];
+            if (i < set.textures)
+            {
+                sprintf_s(name, "texture%03u.rgba", i);
+                asset.desc = ResourceDesc::Texture2D(c_bindShaderResource, set.textureSize, set.textureSize, 0, c_formatR8G8B8A8Unorm, 4);
+                data = MakeTexture(i, set.textureSize);
+            }
+            else
+            {
+                sprintf_s(name, "buffer%03u.bin", i - set.textures);
+                asset.desc = ResourceDesc::Buffer(c_bindVertexBuffer, set.bufferBytes);
+                data = MakeBuffer(i, set.bufferBytes);
+            }
+
+            asset.name = name;
+            asset.offset = pack.size();
+            asset.size = data.size();
+            assets.push_back(asset);
+
+            WriteFile(directory + "/" + name, data);
+            pack.insert(pack.end(), data.begin(), data.end());
+        }
+
+        WriteFile(directory + "/assets.pack", pack);
+        return assets;
+    }
+
+    ResourceEncoding GetEncoding(const Asset& asset)
+    {
+        return asset.desc.type == ResourceType_Texture2D ? ResourceEncoding_GenerateMips : ResourceEncoding_Raw;
+    }
+
+    struct Timing
+    {
+        double median;
+        double minimum;
+        ResourceUploadStatistics last;
+        uint64_t checksum;
+    };
+
+    template<typename Recover>
+    Timing Measure(HeadlessResourceDevice& device, uint32_t iterations, Recover recover)
+    {
+        std::vector<double> samples(iterations);
+        Timing timing = {};
+
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            device.SimulateDeviceRemoved();
+
+            auto start = std::chrono::steady_clock::now();
+            timing.last = recover();
+            samples[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        timing.checksum = device.ComputeChecksum();
+
+        std::sort(samples.begin(), samples.end());
+        timing.median = samples[iterations / 2];
+        timing.minimum = samples[0];
+        return timing;
+    }
+
+    void Report(const char* name, const Timing& timing, double baseline)
+    {
+        printf("%-22s median %8.2f ms  min %8.2f ms  decode %7.2f ms  create %7.2f ms  %7.0f MB/s  %5.2fx\n",
+            name, timing.median, timing.minimum, timing.last.decodeSeconds * 1000.0, timing.last.createSeconds * 1000.0,
+            timing.last.uploadBytes / (1024.0 * 1024.0) / (timing.median / 1000.0), baseline / timing.median);
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardDeviceLostBenchmark [options]\n"
+            "  --textures <n>          synthetic RGBA textures (default 48)\n"
+            "  --texture-size <n>      texture width and height (default 1024)\n"
+            "  --buffers <n>           synthetic vertex buffers (default 64)\n"
+            "  --buffer-kb <n>         size of each buffer (default 512)\n"
+            "  --iterations <n>        device removals measured per method (default 5)\n"
+            "  --workers <n>           worker threads for the parallel restore (default: hardware threads - 1)\n"
+            "  --directory <path>      where the asset files are written (default: current directory)\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    AssetSetDesc set = { 48, 1024, 64, 512 * 1024 };
+    uint32_t iterations = 5;
+    uint32_t workers = 0;
+    std::string directory = ".";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--textures" && hasValue)           set.textures = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--texture-size" && hasValue)  set.textureSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--buffers" && hasValue)       set.buffers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--buffer-kb" && hasValue)     set.bufferBytes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)) * 1024;
+        else if (argument == "--iterations" && hasValue)    iterations = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--workers" && hasValue)       workers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--directory" && hasValue)     directory = argv[++i];
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (set.textures + set.buffers == 0 || set.textureSize == 0 || set.bufferBytes == 0 || iterations == 0)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    try
+    {
+        WorkerPool pool(workers);
+        std::vector<Asset> assets = WriteAssetSet(set, directory);
+        bool matches;
+
+        // The registry keeps the pack mapped; it has to go before the files can be deleted.
+        {
+            auto pack = std::make_shared<MappedFile>();
+            if (!pack->Open(directory + "/assets.pack"))
+            {
+                throw std::runtime_error("Unable to map " + directory + "/assets.pack");
+            }
+
+            ResourceRegistry registry;
+            for (const Asset& asset : assets)
+            {
+                registry.AddMapped(asset.name.c_str(), asset.desc, GetEncoding(asset), pack, static_cast<size_t>(asset.offset), static_cast<size_t>(asset.size));
+            }
+
+            HeadlessResourceDevice device;
+            ResourceUploadStatistics initial = registry.Upload(device, &pool);
+
+            printf("%u textures of %ux%u, %u buffers of %u KB: %.1f MB of images, %.1f MB uploaded, %u batches\n",
+                set.textures, set.textureSize, set.textureSize, set.buffers, set.bufferBytes / 1024,
+                initial.imageBytes / (1024.0 * 1024.0), initial.uploadBytes / (1024.0 * 1024.0), initial.batches);
+
+            // What OnDeviceRestored did before the registry: load and decode every asset again.
+            Timing reload = Measure(device, iterations, [&]()
+            {
+                ResourceRegistry reloaded;
+                for (const Asset& asset : assets)
+                {
+                    reloaded.Add(asset.name.c_str(), asset.desc, GetEncoding(asset), ReadFile(directory + "/" + asset.name));
+                }
+                return reloaded.Upload(device, nullptr);
+            });
+
+            Timing serial = Measure(device, iterations, [&]()
+            {
+                registry.OnDeviceLost();
+                return registry.Upload(device, nullptr);
+            });
+
+            Timing parallel = Measure(device, iterations, [&]()
+            {
+                registry.OnDeviceLost();
+                return registry.Upload(device, &pool);
+            });
+
+            Report("reload from files", reload, reload.median);
+            Report("restore", serial, reload.median);
+
+            char name[32];
+            sprintf_s(name, "restore x%u", pool.GetThreadCount());
+            Report(name, parallel, reload.median);
+
+            printf("%s", FormatMemorySnapshot(GetMemoryTracker().TakeSnapshot()).c_str());
+
+            matches = serial.checksum == reload.checksum && parallel.checksum == reload.checksum;
+        }
+
+        for (const Asset& asset : assets)
+        {
+            remove((directory + "/" + asset.name).c_str());
+        }
+        remove((directory + "/assets.pack").c_str());
+
+        if (!matches)
+        {
+            fprintf(stderr, "Restored resources differ from the reloaded ones\n");
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
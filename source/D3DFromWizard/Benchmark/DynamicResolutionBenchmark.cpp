@@ -0,0 +1,202 @@
+//
+// DynamicResolutionBenchmark.cpp - Runs the dynamic resolution controller against simulated GPU
+//                                  loads and compares it with rendering at the output size
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+#include "Hash.h"
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Frame cost model: work that does not scale with resolution, plus work proportional to
+    // the rendered pixels that fills this much of the budget at the output size and load 1.
+    const double c_fixedFraction = 0.25;
+    const double c_scaledFraction = 0.6;
+    const double c_noise = 0.05;
+
+    enum Scenario
+    {
+        Scenario_Steady,        // Fits at full resolution.
+        Scenario_Heavy,         // Never fits at full resolution.
+        Scenario_Spikes,        // Explosions: short bursts of heavy load.
+        Scenario_Ramp,          // Load climbs far past the minimum scale and comes back.
+        Scenario_Count
+    };
+
+    const char* c_scenarioNames[Scenario_Count] = { "steady", "heavy", "spikes", "ramp" };
+
+    double GetLoad(Scenario scenario, uint32_t frame, uint32_t frames)
+    {
+        switch (scenario)
+        {
+        case Scenario_Steady:   return 1.0;
+        case Scenario_Heavy:    return 1.6;
+        case Scenario_Spikes:   return (frame % 300) >= 200 && (frame % 300) < 260 ? 2.2 : 1.0;
+        case Scenario_Ramp:
+        default:
+        {
+            double phase = double(frame) / frames;
+            return 0.8 + 4.0 * (phase < 0.5 ? phase : 1.0 - phase) * 1.7;
+        }
+        }
+    }
+
+    struct Result
+    {
+        uint64_t    overBudget;
+        double      p95;            // Milliseconds.
+        double      meanScale;
+        float       lowestScale;
+        uint64_t    scaleChanges;
+        uint64_t    hash;           // Of the scale sequence.
+    };
+
+    // Simulates frames with the given per-axis scale policy. The controller only hears about
+    // a frame c_gpuTimerLatency frames later, as with GPU timestamps.
+    Result Simulate(Scenario scenario, uint32_t frames, uint32_t seed, double budget,
+        DynamicResolutionController* controller, FILE* trace)
+    {
+        std::vector<double> times(frames);
+        Result result = {};
+        result.lowestScale = 1.0f;
+        result.hash = c_hashSeed;
+
+        if (controller)
+        {
+            controller->Reset();
+        }
+
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            if (controller && frame >= c_gpuTimerLatency)
+            {
+                controller->Update(times[frame - c_gpuTimerLatency]);
+            }
+
+            float scale = controller ? controller->GetScale() : 1.0f;
+            double noise = 1.0 + c_noise * ((Mix(seed * 0x9e3779b9u + frame) >> 8) * (2.0 / 16777216.0) - 1.0);
+            double seconds = budget * (c_fixedFraction + c_scaledFraction * scale * scale * GetLoad(scenario, frame, frames)) * noise;
+            times[frame] = seconds;
+
+            result.overBudget += seconds > budget;
+            result.meanScale += scale;
+            result.lowestScale = std::min(result.lowestScale, scale);
+            result.hash = HashValue(scale, result.hash);
+
+            if (trace)
+            {
+                fprintf(trace, "%s,%s,%u,%.4f,%.5f\n", c_scenarioNames[scenario], controller ? "dynamic" : "fixed", frame, seconds * 1000.0, scale);
+            }
+        }
+
+        result.meanScale /= frames;
+        result.scaleChanges = controller ? controller->GetStatistics().scaleChanges : 0;
+
+        std::sort(times.begin(), times.end());
+        result.p95 = times[frames * 95 / 100] * 1000.0;
+        return result;
+    }
+
+    void Report(const char* name, const Result& result, uint32_t frames)
+    {
+        printf("  %-8s over budget %5.1f%%  p95 %6.2f ms  mean scale %.3f  lowest %.3f  %4llu changes\n",
+            name, 100.0 * result.overBudget / frames, result.p95, result.meanScale, result.lowestScale,
+            static_cast<unsigned long long>(result.scaleChanges));
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardDynamicResolutionBenchmark [options]\n"
+            "  --frames <n>            frames simulated per scenario (default 3000)\n"
+            "  --target-fps <n>        frame budget (default 60)\n"
+            "  --seed <n>              seed of the frame time noise (default 1)\n"
+            "  --trace <path>          write every frame as CSV: scenario,policy,frame,ms,scale\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 3000;
+    uint32_t targetFps = 60;
+    uint32_t seed = 1;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--frames" && hasValue)             frames = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--target-fps" && hasValue)    targetFps = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--seed" && hasValue)          seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--trace" && hasValue)         tracePath = argv[++i];
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (frames <= c_gpuTimerLatency || targetFps == 0)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    FILE* trace = nullptr;
+    if (!tracePath.empty())
+    {
+        if (fopen_s(&trace, tracePath.c_str(), "w") != 0 || !trace)
+        {
+            fprintf(stderr, "Unable to write %s\n", tracePath.c_str());
+            return 1;
+        }
+        fprintf(trace, "scenario,policy,frame,ms,scale\n");
+    }
+
+    double budget = 1.0 / targetFps;
+    DynamicResolutionController controller;
+    controller.SetDesc(DynamicResolutionController::GetDefaultDesc(budget));
+
+    const DynamicResolutionDesc& desc = controller.GetDesc();
+    printf("%u frames per scenario at %u FPS, scale %.2f to %.2f, results delayed %u frames\n",
+        frames, targetFps, desc.minScale, desc.maxScale, c_gpuTimerLatency);
+
+    bool reproducible = true;
+    for (uint32_t scenario = 0; scenario < Scenario_Count; ++scenario)
+    {
+        Result fixed = Simulate(static_cast<Scenario>(scenario), frames, seed, budget, nullptr, trace);
+        Result dynamic = Simulate(static_cast<Scenario>(scenario), frames, seed, budget, &controller, trace);
+
+        // The controller has no state beyond what Reset clears, so a second run must match.
+        Result again = Simulate(static_cast<Scenario>(scenario), frames, seed, budget, &controller, nullptr);
+        reproducible = reproducible && again.hash == dynamic.hash;
+
+        printf("%s (scale sequence %016llx):\n", c_scenarioNames[scenario], static_cast<unsigned long long>(dynamic.hash));
+        Report("fixed", fixed, frames);
+        Report("dynamic", dynamic, frames);
+    }
+
+    if (trace)
+    {
+        fclose(trace);
+    }
+
+    if (!reproducible)
+    {
+        fprintf(stderr, "The controller gave different scales for the same frame times\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,304 @@
+//
+// EntityBenchmark.cpp - Compares the chunked entity storage with an array of game objects
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "EntityWorld.h"
+
+#include <chrono>
+#include <math.h>
+#include <string>
+
+using namespace DX;
+
+namespace
+{
+    const float c_deltaTime = 1.0f / 60.0f;
+    const float c_gravity = 9.8f;
+    const float c_restitution = 0.8f;
+
+    // Every entity carries the same data in both layouts. Only the first four are touched by
+    // the update; the rest stand in for the state a real game object drags along.
+    struct Position     { float x, y, z; };
+    struct Velocity     { float x, y, z; };
+    struct Spin         { float angle, rate; };
+    struct Lifetime     { float remaining; };
+    struct Transform    { float m[4][4]; };
+    struct Health       { float current, maximum; };
+    struct Name         { char text[32]; };
+
+    // Array of structs baseline: one object per entity, the optional spin behind a flag.
+    struct GameObject
+    {
+        Position    position;
+        Velocity    velocity;
+        Spin        spin;
+        bool        spins;
+        Lifetime    lifetime;
+        Transform   transform;
+        Health      health;
+        Name        name;
+    };
+
+    GameObject Spawn(uint32_t seed)
+    {
+        GameObject object = {};
+        object.position = Position{ Random(seed, 0) * 100.0f - 50.0f, Random(seed, 1) * 20.0f, Random(seed, 2) * 100.0f - 50.0f };
+        object.velocity = Velocity{ Random(seed, 3) * 4.0f - 2.0f, Random(seed, 1) * 8.0f, Random(seed, 0) * 4.0f - 2.0f };
+        object.spins = (seed & 3) == 0;
+        object.spin = Spin{ 0.0f, Random(seed, 2) * 6.0f };
+        object.lifetime = Lifetime{ 1.0f + Random(seed, 3) * 4.0f };
+        object.transform.m[0][0] = object.transform.m[1][1] = object.transform.m[2][2] = object.transform.m[3][3] = 1.0f;
+        object.health = Health{ 100.0f, 100.0f };
+        sprintf_s(object.name.text, "entity %u", seed);
+        return object;
+    }
+
+    inline void Move(Position& position, Velocity& velocity)
+    {
+        velocity.y -= c_gravity * c_deltaTime;
+        position.x += velocity.x * c_deltaTime;
+        position.y += velocity.y * c_deltaTime;
+        position.z += velocity.z * c_deltaTime;
+
+        if (position.y < 0.0f)
+        {
+            position.y = -position.y;
+            velocity.y = -velocity.y * c_restitution;
+        }
+    }
+
+    class AosScene
+    {
+    public:
+        explicit AosScene(uint32_t count)
+        {
+            m_objects.reserve(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                m_objects.push_back(Spawn(i));
+            }
+            m_nextSeed = count;
+        }
+
+        void Update()
+        {
+            for (GameObject& object : m_objects)
+            {
+                Move(object.position, object.velocity);
+
+                if (object.spins)
+                {
+                    object.spin.angle += object.spin.rate * c_deltaTime;
+                }
+
+                object.lifetime.remaining -= c_deltaTime;
+                if (object.lifetime.remaining <= 0.0f)
+                {
+                    object = Spawn(m_nextSeed++);
+                }
+            }
+        }
+
+        size_t GetCount() const     { return m_objects.size(); }
+
+    private:
+        std::vector<GameObject> m_objects;
+        uint32_t                m_nextSeed;
+    };
+
+    class EcsScene
+    {
+    public:
+        EcsScene(uint32_t count, WorkerPool* pool) :
+            m_pool(pool),
+            m_nextSeed(0)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                Create(m_world, m_nextSeed++);
+            }
+        }
+
+        void Update()
+        {
+            Run<Position, Velocity>([](uint32_t count, const Entity*, Position* positions, Velocity* velocities)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    Move(positions[i], velocities[i]);
+                }
+            });
+
+            Run<Spin>([](uint32_t count, const Entity*, Spin* spins)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    spins[i].angle += spins[i].rate * c_deltaTime;
+                }
+            });
+
+            // Expired entities are replaced through the command buffer. Seeds are handed out
+            // after playback so that they do not depend on which thread got there first.
+            EntityCommandBuffer& commands = m_world.GetCommandBuffer();
+            Run<Lifetime>([&commands](uint32_t count, const Entity* entities, Lifetime* lifetimes)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    lifetimes[i].remaining -= c_deltaTime;
+                    if (lifetimes[i].remaining <= 0.0f)
+                    {
+                        commands.DestroyEntity(entities[i]);
+                    }
+                }
+            });
+
+            uint32_t before = m_world.GetEntityCount();
+            m_world.PlaybackCommands();
+            for (uint32_t i = m_world.GetEntityCount(); i < before; ++i)
+            {
+                Create(m_world, m_nextSeed++);
+            }
+        }
+
+        size_t GetCount() const     { return m_world.GetEntityCount(); }
+        const EntityWorld& GetWorld() const     { return m_world; }
+
+    private:
+        static void Create(EntityWorld& world, uint32_t seed)
+        {
+            GameObject object = Spawn(seed);
+            if (object.spins)
+            {
+                world.CreateEntity(object.position, object.velocity, object.spin, object.lifetime, object.transform, object.health, object.name);
+            }
+            else
+            {
+                world.CreateEntity(object.position, object.velocity, object.lifetime, object.transform, object.health, object.name);
+            }
+        }
+
+        template<typename... Ts, typename Function>
+        void Run(Function function)
+        {
+            if (m_pool)
+                m_world.ParallelForEachChunk<Ts...>(*m_pool, function);
+            else
+                m_world.ForEachChunk<Ts...>(function);
+        }
+
+        EntityWorld     m_world;
+        WorkerPool*     m_pool;
+        uint32_t        m_nextSeed;
+    };
+
+    struct Timing
+    {
+        double median;
+        double mean;
+        double minimum;
+    };
+
+    template<typename Scene>
+    Timing Measure(Scene& scene, uint32_t warmup, uint32_t iterations)
+    {
+        for (uint32_t i = 0; i < warmup; ++i)
+        {
+            scene.Update();
+        }
+
+        std::vector<double> samples(iterations);
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            scene.Update();
+            samples[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        Timing timing = {};
+        for (double sample : samples)
+        {
+            timing.mean += sample;
+        }
+        timing.mean /= iterations;
+
+        std::sort(samples.begin(), samples.end());
+        timing.median = samples[iterations / 2];
+        timing.minimum = samples[0];
+        return timing;
+    }
+
+    void Report(const char* name, const Timing& timing, size_t entities, double baseline)
+    {
+        printf("%-18s median %8.3f ms  mean %8.3f ms  min %8.3f ms  %6.2f ns/entity  %5.2fx\n",
+            name, timing.median, timing.mean, timing.minimum,
+            timing.median * 1.0e6 / entities, baseline / timing.median);
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardEntityBenchmark [options]\n"
+            "  --entities <n>          entities in each layout (default 100000)\n"
+            "  --warmup <n>            updates before measuring (default 30)\n"
+            "  --iterations <n>        updates measured (default 300)\n"
+            "  --workers <n>           worker threads for the parallel run (default: hardware threads - 1)\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t entities = 100000;
+    uint32_t warmup = 30;
+    uint32_t iterations = 300;
+    uint32_t workers = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--entities" && hasValue)           entities = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--warmup" && hasValue)        warmup = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--iterations" && hasValue)    iterations = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--workers" && hasValue)       workers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (entities == 0 || iterations == 0)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    WorkerPool pool(workers);
+
+    printf("%u entities, %zu bytes per game object, %u updates after %u warm-up\n",
+        entities, sizeof(GameObject), iterations, warmup);
+
+    AosScene aos(entities);
+    Timing aosTiming = Measure(aos, warmup, iterations);
+
+    EcsScene ecs(entities, nullptr);
+    Timing ecsTiming = Measure(ecs, warmup, iterations);
+
+    EcsScene parallel(entities, &pool);
+    Timing parallelTiming = Measure(parallel, warmup, iterations);
+
+    printf("entity world: %zu archetypes, %zu chunks of %zu KB\n",
+        ecs.GetWorld().GetArchetypeCount(), ecs.GetWorld().GetChunkCount(), c_entityChunkSize / 1024);
+
+    Report("array-of-structs", aosTiming, aos.GetCount(), aosTiming.median);
+    Report("chunks", ecsTiming, ecs.GetCount(), aosTiming.median);
+
+    char name[32];
+    sprintf_s(name, "chunks x%u", pool.GetThreadCount());
+    Report(name, parallelTiming, parallel.GetCount(), aosTiming.median);
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+//
+// FbxBenchmark.cpp - Load time and peak memory of the streaming FBX reader against reading
+//                    the whole file into a DOM first
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "FbxReader.h"
+#include "Inflate.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Every heap block in the process, counted by the operator new and delete below. Each
+    // block carries its size in a header that keeps the 16-byte alignment malloc gives.
+    const size_t c_blockHeader = 16;
+
+    std::atomic<size_t> g_liveBytes(0);
+    std::atomic<size_t> g_peakBytes(0);
+
+    void* AllocateCounted(size_t size)
+    {
+        void* block = malloc(size + c_blockHeader);
+        if (!block)
+        {
+            return nullptr;
+        }
+        *static_cast<size_t*>(block) = size;
+
+        size_t live = g_liveBytes.fetch_add(size) + size;
+        size_t peak = g_peakBytes.load();
+        while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live))
+        {
+        }
+        return static_cast<uint8_t*>(block) + c_blockHeader;
+    }
+
+    void FreeCounted(void* memory)
+    {
+        if (memory)
+        {
+            void* block = static_cast<uint8_t*>(memory) - c_blockHeader;
+            g_liveBytes.fetch_sub(*static_cast<size_t*>(block));
+            free(block);
+        }
+    }
+
+    // The bytes a call adds at its peak over what was live before it.
+    template<typename Load>
+    size_t MeasurePeak(Load load)
+    {
+        size_t before = g_liveBytes.load();
+        g_peakBytes.store(before);
+        load();
+        return g_peakBytes.load() - before;
+    }
+}
+
+void* operator new(size_t size)
+{
+    void* memory = AllocateCounted(size);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size)                                   { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept     { return AllocateCounted(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept   { return AllocateCounted(size); }
+void operator delete(void* memory) noexcept                         { FreeCounted(memory); }
+void operator delete[](void* memory) noexcept                       { FreeCounted(memory); }
+void operator delete(void* memory, size_t) noexcept                 { FreeCounted(memory); }
+void operator delete[](void* memory, size_t) noexcept               { FreeCounted(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept  { FreeCounted(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { FreeCounted(memory); }
+
+namespace
+{
+    // What a general purpose loader builds before it looks at any geometry: the whole file in
+    // memory, then every record with every property decoded and every array inflated.
+    struct DomProperty
+    {
+        char                    type;
+        int64_t                 integer;
+        double                  number;
+        std::string             text;           // Strings and raw bytes.
+        std::vector<uint8_t>    array;          // Inflated elements.
+    };
+
+    struct DomNode
+    {
+        std::string             name;
+        std::vector<DomProperty> properties;
+        std::vector<DomNode>    children;
+    };
+
+    void BuildDom(const FbxRecordCursor& cursor, FbxRecordCursor records, std::vector<DomNode>& nodes)
+    {
+        FbxRecord record;
+        while (records.Next(record))
+        {
+            nodes.emplace_back();
+            DomNode& node = nodes.back();
+            node.name.assign(record.name, record.nameLength);
+
+            FbxPropertyCursor properties(record);
+            FbxProperty property;
+            while (properties.Next(property))
+            {
+                node.properties.emplace_back();
+                DomProperty& decoded = node.properties.back();
+                decoded.type = property.type;
+                decoded.integer = property.integer;
+                decoded.number = property.number;
+
+                if (property.IsArray())
+                {
+                    decoded.array.resize(static_cast<size_t>(property.arrayLength) * property.GetElementSize());
+                    if (!property.compressed)
+                    {
+                        memcpy(decoded.array.data(), property.data, decoded.array.size());
+                    }
+                    else if (!InflateZlib(property.data, property.size, decoded.array.data(), decoded.array.size()))
+                    {
+                        throw std::runtime_error("Corrupt FBX array");
+                    }
+                }
+                else if (property.data)
+                {
+                    decoded.text.assign(reinterpret_cast<const char*>(property.data), property.size);
+                }
+            }
+
+            BuildDom(cursor, cursor.GetChildren(record), node.children);
+        }
+    }
+
+    size_t CountNodes(const std::vector<DomNode>& nodes)
+    {
+        size_t count = nodes.size();
+        for (const DomNode& node : nodes)
+        {
+            count += CountNodes(node.children);
+        }
+        return count;
+    }
+
+    // Reads the file with ifstream, as Load3ds does, and builds the DOM over the copy.
+    size_t LoadWholeFile(const std::string& path, std::vector<DomNode>& nodes)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Unable to open " + path);
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < 27 || memcmp(data.data(), "Kaydara FBX Binary  ", 21) != 0)
+        {
+            throw std::runtime_error("Not a binary FBX file: " + path);
+        }
+
+        uint32_t version;
+        memcpy(&version, data.data() + 23, sizeof(version));
+        FbxRecordCursor records(data.data(), data.data() + 27, data.data() + data.size(), version >= 7500);
+        nodes.clear();
+        BuildDom(records, records, nodes);
+        return CountNodes(nodes);
+    }
+
+    double ToMegabytes(size_t bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    void Run(const std::string& path, WorkerPool& workers, double minSeconds)
+    {
+        size_t nodeCount = 0;
+        size_t wholePeak = MeasurePeak([&]()
+        {
+            std::vector<DomNode> nodes;
+            nodeCount = LoadWholeFile(path, nodes);
+        });
+        double wholeSeconds = MeasureFastest(minSeconds, [&]() { std::vector<DomNode> nodes; LoadWholeFile(path, nodes); return 0.0; });
+
+        FbxLoadStatistics stats = {};
+        size_t meshCount = 0, triangleCount = 0, materialCount = 0;
+        size_t singlePeak = MeasurePeak([&]()
+        {
+            FbxModel model = LoadFbxModel(path, nullptr, &stats);
+            meshCount = model.mesh.vertices.size();
+            triangleCount = model.mesh.GetTriangleCount();
+            materialCount = model.materials.size();
+        });
+        size_t pooledPeak = MeasurePeak([&]() { LoadFbxModel(path, &workers); });
+        double singleSeconds = MeasureFastest(minSeconds, [&]() { LoadFbxModel(path); return 0.0; });
+        FbxLoadStatistics pooledStats = {};
+        double pooledSeconds = MeasureFastest(minSeconds, [&]() { LoadFbxModel(path, &workers, &pooledStats); return 0.0; });
+
+        printf("%s: %.2f MB, %zu records, %u arrays read (%.2f MB compressed, %.2f MB decoded), %u meshes,"
+            " %zu vertices, %zu triangles, %zu materials\n",
+            path.substr(path.find_last_of("/\\") + 1).c_str(), ToMegabytes(stats.fileBytes), nodeCount, stats.arrays,
+            ToMegabytes(stats.compressedBytes), ToMegabytes(stats.decodedBytes), stats.geometries, meshCount, triangleCount, materialCount);
+        // The streaming reader maps the file instead of copying it to the heap, and its scan
+        // touches every page, so the whole mapping is added to its heap peak for the comparison.
+        size_t mappedBytes = stats.fileBytes;
+        size_t singleTotal = singlePeak + mappedBytes;
+        printf("  whole file + DOM  %8.2f ms  peak heap %7.2f MB  mapped %7.2f MB   (no mesh built)\n",
+            wholeSeconds * 1000.0, ToMegabytes(wholePeak), 0.0);
+        printf("  streaming         %8.2f ms  peak heap %7.2f MB  mapped %7.2f MB   %5.1fx faster  %5.1f%% of the memory\n",
+            singleSeconds * 1000.0, ToMegabytes(singlePeak), ToMegabytes(mappedBytes), wholeSeconds / singleSeconds,
+            100.0 * singleTotal / std::max<size_t>(wholePeak, 1));
+        printf("  streaming, pool   %8.2f ms  peak heap %7.2f MB  mapped %7.2f MB   %5.1fx faster   scan %.2f  inflate %.2f  build %.2f ms\n",
+            pooledSeconds * 1000.0, ToMegabytes(pooledPeak), ToMegabytes(mappedBytes), wholeSeconds / pooledSeconds,
+            pooledStats.scanSeconds * 1000.0, pooledStats.inflateSeconds * 1000.0, pooledStats.buildSeconds * 1000.0);
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardFbxBenchmark [options] [file.fbx ...]\n"
+            "  --assets <dir>          directory holding Corvette-F3 and MURCIELAGO640.FBX, with teapot.fbx and\n"
+            "                          crate01.fbx one up (default %s)\n"
+            "  --threads <n>           worker pool threads, 0 for the hardware threads (default 0)\n"
+            "  --seconds <s>           minimum time each loader is repeated for (default 0.5)\n",
+            BENCHMARK_ASSET_DIRECTORY);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    uint32_t threads = 0;
+    double minSeconds = 0.5;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue)             assetDirectory = argv[++i];
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--seconds" && hasValue)       minSeconds = atof(argv[++i]);
+        else if (argument.size() > 0 && argument[0] != '-') files.push_back(argument);
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (files.empty())
+    {
+        files.push_back(assetDirectory + "/../crate01.fbx");
+        files.push_back(assetDirectory + "/../teapot.fbx");
+        files.push_back(assetDirectory + "/Corvette-F3/Corvette-F3.FBX");
+        files.push_back(assetDirectory + "/MURCIELAGO640.FBX");
+    }
+
+    WorkerPool workers(threads > 0 ? threads - 1 : 0);
+    printf("%u threads; heap peaks count every block allocated during the load, including the result;"
+        " mapped is the file a reader maps rather than copies, and the memory compared is heap plus mapped\n",
+        workers.GetThreadCount());
+
+    try
+    {
+        for (const std::string& file : files)
+        {
+            Run(file, workers, minSeconds);
+        }
+    }
+    catch (const std::exception& exception)
+    {
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    return 0;
+}
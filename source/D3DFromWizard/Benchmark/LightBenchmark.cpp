@@ -0,0 +1,283 @@
+//
+// LightBenchmark.cpp - Times clustered light assignment for growing light counts and checks
+//                      that every lit point finds its lights in its cluster
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "LightClustering.h"
+
+#include <chrono>
+#include <math.h>
+#include <string>
+
+using namespace DX;
+
+namespace
+{
+    const float c_sceneRadius = 80.0f;
+    const uint32_t c_samplesPerLight = 16;
+
+    // Half point lights, half spots, scattered around the camera so that about a quarter of
+    // them are in view at any time.
+    std::vector<Light> MakeLights(uint32_t count)
+    {
+        std::vector<Light> lights(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Light& light = lights[i];
+            light.position[0] = (Random(i, 0) * 2.0f - 1.0f) * c_sceneRadius;
+            light.position[1] = Random(i, 1) * 20.0f - 5.0f;
+            light.position[2] = (Random(i, 2) * 2.0f - 1.0f) * c_sceneRadius;
+            light.range = 2.0f + Random(i, 3) * 6.0f;
+            light.color[0] = light.color[1] = light.color[2] = 1.0f;
+
+            if (i & 1)
+            {
+                float x = Random(i, 4) * 2.0f - 1.0f, y = -0.5f - Random(i, 5), z = Random(i, 6) * 2.0f - 1.0f;
+                float length = sqrtf(x * x + y * y + z * z);
+                light.direction[0] = x / length;
+                light.direction[1] = y / length;
+                light.direction[2] = z / length;
+                light.spotAngle = 0.2f + Random(i, 7) * 1.0f;
+                light.type = LightType_Spot;
+            }
+            else
+            {
+                light.direction[0] = light.direction[1] = light.direction[2] = 0.0f;
+                light.spotAngle = 0.0f;
+                light.type = LightType_Point;
+            }
+        }
+        return lights;
+    }
+
+    // Camera at eye height turning about the vertical axis, as a row-vector view matrix.
+    void MakeView(float yaw, float view[4][4])
+    {
+        float c = cosf(yaw), s = sinf(yaw);
+        float rows[4][4] =
+        {
+            { c,    0.0f, s,    0.0f },
+            { 0.0f, 1.0f, 0.0f, 0.0f },
+            { -s,   0.0f, c,    0.0f },
+            { 0.0f, -2.0f, 0.0f, 1.0f },
+        };
+        memcpy(view, rows, sizeof(rows));
+    }
+
+    void TransformPoint(const float point[3], const float view[4][4], float result[3])
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            result[j] = point[0] * view[0][j] + point[1] * view[1][j] + point[2] * view[2][j] + view[3][j];
+        }
+    }
+
+    // Points the light actually reaches: inside its range and, for spots, inside the cone.
+    // Returns the number of lit points whose cluster does not list the light.
+    uint32_t CountMissedSamples(const LightClusterBuilder& builder, const std::vector<Light>& lights, const float view[4][4], uint32_t& samples)
+    {
+        const std::vector<LightClusterRange>& clusters = builder.GetClusters();
+        const std::vector<uint16_t>& indices = builder.GetLightIndices();
+
+        uint32_t missed = 0;
+        for (uint32_t i = 0; i < lights.size(); ++i)
+        {
+            const Light& light = lights[i];
+            uint32_t taken = 0;
+            for (uint32_t attempt = 0; attempt < c_samplesPerLight * 8 && taken < c_samplesPerLight; ++attempt)
+            {
+                uint32_t seed = Mix(i * 0x9e3779b9u + attempt);
+                float offset[3] = { Random(seed, 8) * 2.0f - 1.0f, Random(seed, 9) * 2.0f - 1.0f, Random(seed, 10) * 2.0f - 1.0f };
+                float length = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+                if (length > 0.999f || length < 1.0e-3f)
+                    continue;
+
+                if (light.type == LightType_Spot &&
+                    (offset[0] * light.direction[0] + offset[1] * light.direction[1] + offset[2] * light.direction[2]) < cosf(light.spotAngle) * length)
+                    continue;
+
+                float point[3], viewPoint[3];
+                for (uint32_t j = 0; j < 3; ++j)
+                {
+                    point[j] = light.position[j] + offset[j] * light.range;
+                }
+                TransformPoint(point, view, viewPoint);
+                ++taken;
+
+                int32_t cluster = builder.FindCluster(viewPoint);
+                if (cluster < 0)
+                    continue;
+
+                ++samples;
+                const LightClusterRange& range = clusters[cluster];
+                const uint16_t* first = indices.data() + range.offset;
+                if (std::find(first, first + range.count, static_cast<uint16_t>(i)) == first + range.count)
+                {
+                    ++missed;
+                }
+            }
+        }
+        return missed;
+    }
+
+    struct Timing
+    {
+        double median;
+        double mean;
+        double minimum;
+    };
+
+    // The camera turns a little every frame, so each build sees different bounds.
+    Timing Measure(LightClusterBuilder& builder, const std::vector<Light>& lights, WorkerPool* pool, uint32_t warmup, uint32_t iterations)
+    {
+        float view[4][4];
+        for (uint32_t i = 0; i < warmup; ++i)
+        {
+            MakeView(i * 0.01f, view);
+            builder.Build(lights.data(), static_cast<uint32_t>(lights.size()), view, pool);
+        }
+
+        std::vector<double> samples(iterations);
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            MakeView((warmup + i) * 0.01f, view);
+
+            auto start = std::chrono::steady_clock::now();
+            builder.Build(lights.data(), static_cast<uint32_t>(lights.size()), view, pool);
+            samples[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        Timing timing = {};
+        for (double sample : samples)
+        {
+            timing.mean += sample;
+        }
+        timing.mean /= iterations;
+
+        std::sort(samples.begin(), samples.end());
+        timing.median = samples[iterations / 2];
+        timing.minimum = samples[0];
+        return timing;
+    }
+
+    void Report(const char* name, const Timing& timing, double baseline)
+    {
+        printf("  %-14s median %8.3f ms  mean %8.3f ms  min %8.3f ms  %5.2fx\n",
+            name, timing.median, timing.mean, timing.minimum, baseline / timing.median);
+    }
+
+    bool SameClusters(const LightClusterBuilder& a, const LightClusterBuilder& b)
+    {
+        const std::vector<LightClusterRange>& clustersA = a.GetClusters();
+        const std::vector<LightClusterRange>& clustersB = b.GetClusters();
+        for (size_t i = 0; i < clustersA.size(); ++i)
+        {
+            if (clustersA[i].offset != clustersB[i].offset || clustersA[i].count != clustersB[i].count)
+                return false;
+        }
+        return a.GetLightIndices() == b.GetLightIndices();
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardLightBenchmark [options]\n"
+            "  --lights <n>            measure only this light count (default: 64 to 4096 in steps of 4x)\n"
+            "  --warmup <n>            builds before measuring (default 20)\n"
+            "  --iterations <n>        builds measured per method (default 200)\n"
+            "  --workers <n>           worker threads for the parallel build (default: hardware threads - 1)\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t lightCount = 0;
+    uint32_t warmup = 20;
+    uint32_t iterations = 200;
+    uint32_t workers = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--lights" && hasValue)             lightCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--warmup" && hasValue)        warmup = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--iterations" && hasValue)    iterations = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--workers" && hasValue)       workers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (iterations == 0 || lightCount > c_maxClusteredLights)
+    {
+        PrintUsage(stderr);
+        return 2;
+    }
+
+    std::vector<uint32_t> lightCounts;
+    if (lightCount != 0)
+    {
+        lightCounts.push_back(lightCount);
+    }
+    else
+    {
+        for (uint32_t count = 64; count <= c_maxClusteredLights; count *= 4)
+        {
+            lightCounts.push_back(count);
+        }
+    }
+
+    WorkerPool pool(workers);
+    bool failed = false;
+
+    printf("%ux%ux%u clusters, %u builds after %u warm-up\n",
+        c_lightGridTilesX, c_lightGridTilesY, c_lightGridSlices, iterations, warmup);
+
+    for (uint32_t count : lightCounts)
+    {
+        std::vector<Light> lights = MakeLights(count);
+
+        LightClusterBuilder scalar, simd, parallel;
+        scalar.SetSimdEnabled(false);
+
+        Timing scalarTiming = Measure(scalar, lights, nullptr, warmup, iterations);
+        Timing simdTiming = Measure(simd, lights, nullptr, warmup, iterations);
+        Timing parallelTiming = Measure(parallel, lights, &pool, warmup, iterations);
+
+        // All three saw the same last view; their lists must agree exactly.
+        bool identical = SameClusters(scalar, simd) && SameClusters(scalar, parallel);
+
+        float view[4][4];
+        MakeView((warmup + iterations - 1) * 0.01f, view);
+        uint32_t samples = 0;
+        uint32_t missed = CountMissedSamples(parallel, lights, view, samples);
+
+        const LightClusterStatistics& stats = parallel.GetStatistics();
+        printf("%u lights: %u visible, %u light-cluster pairs, %u occupied clusters, at most %u lights per cluster\n",
+            stats.lights, stats.visibleLights, stats.lightClusterPairs, stats.occupiedClusters, stats.maxLightsPerCluster);
+
+        Report("scalar", scalarTiming, scalarTiming.median);
+        Report("sse2", simdTiming, scalarTiming.median);
+
+        char name[32];
+        sprintf_s(name, "sse2 x%u", pool.GetThreadCount());
+        Report(name, parallelTiming, scalarTiming.median);
+
+        printf("  %u of %u lit sample points missed their light, results %s\n", missed, samples, identical ? "identical" : "DIFFER");
+        failed = failed || missed != 0 || !identical;
+    }
+
+    if (failed)
+    {
+        fprintf(stderr, "Light clustering is not conservative, or the builds disagree\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,411 @@
+//
+// ObjBenchmark.cpp - Measures OBJ parse throughput: a line by line iostream reader against the
+//                    chunked parser on one thread and on the worker pool
+//
+
+#include "pch.h"
+#include "BenchmarkCommon.h"
+#include "MeshLoader.h"
+#include "ObjParser.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct NaiveVertexKey
+    {
+        int position;
+        int texcoord;
+        int normal;
+
+        bool operator==(const NaiveVertexKey& other) const
+        {
+            return position == other.position && texcoord == other.texcoord && normal == other.normal;
+        }
+    };
+
+    struct NaiveVertexKeyHash
+    {
+        size_t operator()(const NaiveVertexKey& key) const
+        {
+            return static_cast<size_t>(key.position) * 73856093u ^ static_cast<size_t>(key.texcoord) * 19349663u ^ static_cast<size_t>(key.normal) * 83492791u;
+        }
+    };
+
+    int ResolveNaiveIndex(int index, size_t count)
+    {
+        return index > 0 ? index - 1 : index < 0 ? static_cast<int>(count) + index : -1;
+    }
+
+    void ParseNaiveCorner(const std::string& token, int& position, int& texcoord, int& normal)
+    {
+        position = texcoord = normal = 0;
+
+        const char* cursor = token.c_str();
+        char* end = nullptr;
+        position = static_cast<int>(strtol(cursor, &end, 10));
+        if (*end != '/')
+        {
+            return;
+        }
+
+        cursor = end + 1;
+        if (*cursor != '/')
+        {
+            texcoord = static_cast<int>(strtol(cursor, &end, 10));
+            cursor = end;
+        }
+
+        if (*cursor == '/')
+        {
+            normal = static_cast<int>(strtol(cursor + 1, &end, 10));
+        }
+    }
+
+    // The reader LoadObj used before the chunked parser: getline, istringstream and an
+    // unordered_map of corners.
+    MeshData LoadObjNaive(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Unable to open " + path);
+        }
+
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        std::unordered_map<NaiveVertexKey, uint32_t, NaiveVertexKeyHash> vertexMap;
+        std::vector<uint32_t> polygon;
+
+        MeshData mesh;
+        mesh.name = path;
+
+        std::string line;
+        std::string keyword;
+        std::string token;
+
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            if (!(stream >> keyword))
+            {
+                continue;
+            }
+
+            if (keyword == "v")
+            {
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                stream >> x >> y >> z;
+                positions.insert(positions.end(), { x, y, z });
+            }
+            else if (keyword == "vn")
+            {
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                stream >> x >> y >> z;
+                normals.insert(normals.end(), { x, y, z });
+            }
+            else if (keyword == "vt")
+            {
+                float u = 0.0f, v = 0.0f;
+                stream >> u >> v;
+                texcoords.insert(texcoords.end(), { u, v });
+            }
+            else if (keyword == "f")
+            {
+                polygon.clear();
+
+                while (stream >> token)
+                {
+                    int p, t, n;
+                    ParseNaiveCorner(token, p, t, n);
+
+                    NaiveVertexKey key;
+                    key.position = ResolveNaiveIndex(p, positions.size() / 3);
+                    key.texcoord = ResolveNaiveIndex(t, texcoords.size() / 2);
+                    key.normal = ResolveNaiveIndex(n, normals.size() / 3);
+
+                    if (key.position < 0 || static_cast<size_t>(key.position) * 3 >= positions.size())
+                    {
+                        throw std::runtime_error("Invalid vertex index in " + path);
+                    }
+
+                    auto it = vertexMap.find(key);
+                    if (it == vertexMap.end())
+                    {
+                        MeshVertex vertex = {};
+                        memcpy(vertex.position, &positions[key.position * 3], sizeof(vertex.position));
+                        if (key.normal >= 0 && static_cast<size_t>(key.normal) * 3 < normals.size())
+                        {
+                            memcpy(vertex.normal, &normals[key.normal * 3], sizeof(vertex.normal));
+                        }
+                        if (key.texcoord >= 0 && static_cast<size_t>(key.texcoord) * 2 < texcoords.size())
+                        {
+                            vertex.texcoord[0] = texcoords[key.texcoord * 2];
+                            vertex.texcoord[1] = 1.0f - texcoords[key.texcoord * 2 + 1];
+                        }
+
+                        it = vertexMap.emplace(key, static_cast<uint32_t>(mesh.vertices.size())).first;
+                        mesh.vertices.push_back(vertex);
+                    }
+
+                    polygon.push_back(it->second);
+                }
+
+                for (size_t i = 2; i < polygon.size(); ++i)
+                {
+                    mesh.indices.push_back(polygon[0]);
+                    mesh.indices.push_back(polygon[i - 1]);
+                    mesh.indices.push_back(polygon[i]);
+                }
+            }
+        }
+
+        if (normals.empty())
+        {
+            ComputeVertexNormals(mesh);
+        }
+
+        return mesh;
+    }
+
+    // A stand-in for a large scanned or CAD export: patches of 256 x 256 quads with positions,
+    // normals and texture coordinates, alternating absolute and relative face indices, and a
+    // material switch per patch. Returns false if the file cannot be written.
+    bool WriteSyntheticObj(const std::string& path, uint64_t targetBytes)
+    {
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "wb") != 0 || !file)
+        {
+            return false;
+        }
+
+        const uint32_t side = 257;
+        const uint32_t patchVertices = side * side;
+        std::string text;
+        char line[160];
+        uint64_t written = 0;
+        uint64_t base = 0;
+        fprintf(file, "mtllib synthetic.mtl\n");
+
+        for (uint32_t patch = 0; written < targetBytes; ++patch)
+        {
+            text.clear();
+            int length = sprintf_s(line, "o patch%u\nusemtl material%u\n", patch, patch % 4);
+            text.append(line, length);
+
+            for (uint32_t i = 0; i < patchVertices; ++i)
+            {
+                uint32_t x = i % side, z = i / side;
+                float height = (Mix(patch * patchVertices + i) & 0xffff) / 65536.0f;
+                length = sprintf_s(line, "v %.6f %.6f %.6f\nvn %.4f %.4f %.4f\nvt %.6f %.6f\n",
+                    patch * 300.0f + x * 1.1719f, height, z * -1.3281f,
+                    height - 0.5f, 0.7071f, 0.5f - height,
+                    x / 256.0f, z / 256.0f);
+                text.append(line, length);
+            }
+
+            bool relative = patch % 2 == 1;
+            for (uint32_t z = 0; z + 1 < side; ++z)
+            {
+                for (uint32_t x = 0; x + 1 < side; ++x)
+                {
+                    uint64_t corners[4] = { z * side + x, z * side + x + 1, (z + 1) * side + x + 1, (z + 1) * side + x };
+                    text += 'f';
+                    for (uint64_t corner : corners)
+                    {
+                        long long index = relative ? static_cast<long long>(corner) - patchVertices : static_cast<long long>(base + corner + 1);
+                        length = sprintf_s(line, " %lld/%lld/%lld", index, index, index);
+                        text.append(line, length);
+                    }
+                    text += '\n';
+                }
+            }
+
+            base += patchVertices;
+            written += fwrite(text.data(), 1, text.size(), file);
+        }
+
+        bool ok = ferror(file) == 0;
+        fclose(file);
+        return ok;
+    }
+
+    bool SameMesh(const MeshData& a, const MeshData& b)
+    {
+        return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+            memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(MeshVertex)) == 0 &&
+            memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(uint32_t)) == 0;
+    }
+
+    uint64_t GetFileSize(const std::string& path)
+    {
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "rb") != 0 || !file)
+        {
+            return 0;
+        }
+        fseek(file, 0, SEEK_END);
+        long long size = ftell(file);
+        fclose(file);
+        return size > 0 ? static_cast<uint64_t>(size) : 0;
+    }
+
+    // Returns false if the outputs differ.
+    bool Run(const std::string& name, const std::string& path, WorkerPool& workers, double minSeconds, bool naive)
+    {
+        uint64_t bytes = GetFileSize(path);
+        double megabytes = bytes / (1024.0 * 1024.0);
+
+        MeshData reference;
+        ObjModel single, pooled;
+        ObjParseStatistics singleStats = {}, pooledStats = {};
+
+        double naiveSeconds = naive ? MeasureFastest(minSeconds, [&]() { reference = LoadObjNaive(path); return 0.0; }) : 0.0;
+
+        // Keeps the phase times of the fastest run, timed from the mapping of the file.
+        auto loadFast = [&](ObjModel& model, WorkerPool* pool, ObjParseStatistics& best)
+        {
+            Clock::time_point begin = Clock::now();
+            ObjParseStatistics stats = {};
+            model = LoadObjModel(path, pool, &stats);
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            if (best.totalSeconds == 0.0 || seconds < best.totalSeconds)
+            {
+                best = stats;
+                best.totalSeconds = seconds;
+            }
+            return seconds;
+        };
+        double singleSeconds = MeasureFastest(minSeconds, [&]() { return loadFast(single, nullptr, singleStats); });
+        double pooledSeconds = MeasureFastest(minSeconds, [&]() { return loadFast(pooled, &workers, pooledStats); });
+
+        bool same = SameMesh(single.mesh, pooled.mesh) && (!naive || SameMesh(reference, single.mesh));
+
+        printf("%s: %.1f MB, %zu vertices, %zu triangles, %zu materials, %zu subsets%s\n",
+            name.c_str(), megabytes, single.mesh.vertices.size(), single.mesh.GetTriangleCount(),
+            single.materials.size(), single.subsets.size(), same ? "" : " (outputs differ)");
+        if (naive)
+        {
+            printf("  iostream   %9.2f ms  %8.1f MB/s\n", naiveSeconds * 1000.0, megabytes / naiveSeconds);
+        }
+
+        auto report = [&](const char* label, double seconds, const ObjParseStatistics& stats)
+        {
+            printf("  %-10s %9.2f ms  %8.1f MB/s", label, seconds * 1000.0, megabytes / seconds);
+            if (naive)
+            {
+                printf("  %6.1fx", naiveSeconds / seconds);
+            }
+            printf("   %u chunks: count %.2f  parse %.2f  merge %.2f  build %.2f ms\n", stats.chunks,
+                stats.countSeconds * 1000.0, stats.parseSeconds * 1000.0, stats.mergeSeconds * 1000.0, stats.buildSeconds * 1000.0);
+        };
+        report("1 thread", singleSeconds, singleStats);
+        report("pool", pooledSeconds, pooledStats);
+
+        return same;
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardObjBenchmark [options] [file.obj ...]\n"
+            "  --assets <dir>          directory holding teapot and Corvette-F3 (default %s)\n"
+            "  --synthetic-mb <n>      size of the generated OBJ file, 0 for none (default 256)\n"
+            "  --synthetic <path>      where the generated file goes (default obj_benchmark.obj)\n"
+            "  --threads <n>           worker pool threads, 0 for the hardware threads (default 0)\n"
+            "  --seconds <s>           minimum time each reader is repeated for (default 0.5)\n"
+            "  --no-naive              skip the iostream reader on the generated file\n"
+            "  --keep                  keep the generated file\n",
+            BENCHMARK_ASSET_DIRECTORY);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    uint64_t syntheticMegabytes = 256;
+    std::string syntheticPath = "obj_benchmark.obj";
+    uint32_t threads = 0;
+    double minSeconds = 0.5;
+    bool naiveSynthetic = true;
+    bool keep = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue)             assetDirectory = argv[++i];
+        else if (argument == "--synthetic-mb" && hasValue)  syntheticMegabytes = strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--synthetic" && hasValue)     syntheticPath = argv[++i];
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--seconds" && hasValue)       minSeconds = atof(argv[++i]);
+        else if (argument == "--no-naive")                  naiveSynthetic = false;
+        else if (argument == "--keep")                      keep = true;
+        else if (argument.size() > 0 && argument[0] != '-') files.push_back(argument);
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+
+    if (files.empty())
+    {
+        files.push_back(assetDirectory + "/teapot/teapot.obj");
+        files.push_back(assetDirectory + "/Corvette-F3/Corvette-F3.obj");
+    }
+
+    WorkerPool workers(threads > 0 ? threads - 1 : 0);
+    printf("%u threads\n", workers.GetThreadCount());
+
+    bool identical = true;
+    try
+    {
+        for (const std::string& file : files)
+        {
+            identical = Run(file.substr(file.find_last_of("/\\") + 1), file, workers, minSeconds, true) && identical;
+        }
+
+        if (syntheticMegabytes > 0)
+        {
+            if (!WriteSyntheticObj(syntheticPath, syntheticMegabytes * 1024 * 1024))
+            {
+                fprintf(stderr, "Unable to write %s\n", syntheticPath.c_str());
+                return 1;
+            }
+
+            // Large enough that one run of each says enough.
+            identical = Run("synthetic", syntheticPath, workers, 0.0, naiveSynthetic) && identical;
+            if (!keep)
+            {
+                remove(syntheticPath.c_str());
+            }
+        }
+    }
+    catch (const std::exception& exception)
+    {
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    if (!identical)
+    {
+        fprintf(stderr, "The chunked parser produced a different mesh\n");
+        return 1;
+    }
+
+    return 0;
+}
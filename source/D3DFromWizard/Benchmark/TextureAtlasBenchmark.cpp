@@ -0,0 +1,364 @@
+//
+// TextureAtlasBenchmark.cpp - Packs the Murcielago's small diffuse maps into atlas pages and
+//                             reports occupancy, texture binds and material tables saved
+//
+
+#include "pch.h"
+#include "FbxReader.h"
+#include "HeadlessResourceDevice.h"
+#include "MaterialSystem.h"
+#include "TextureAtlas.h"
+#include "TgaReader.h"
+#include "WorkerPool.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#endif
+
+using namespace DX;
+
+namespace
+{
+    std::string ToLower(std::string text)
+    {
+        for (char& c : text)
+        {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    }
+
+    std::string GetFileName(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? path : path.substr(separator + 1);
+    }
+
+    // The directory's files by lower case name, since the model's paths disagree with the disk on case.
+    std::unordered_map<std::string, std::string> ListFiles(const std::string& directory)
+    {
+        std::unordered_map<std::string, std::string> files;
+#if defined(_WIN32)
+        WIN32_FIND_DATAA found;
+        HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+        if (search != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                files.emplace(ToLower(found.cFileName), directory + "\\" + found.cFileName);
+            } while (FindNextFileA(search, &found));
+            FindClose(search);
+        }
+#else
+        if (DIR* dir = opendir(directory.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                files.emplace(ToLower(entry->d_name), directory + "/" + entry->d_name);
+            }
+            closedir(dir);
+        }
+#endif
+        return files;
+    }
+
+    struct SourceTexture
+    {
+        std::string     name;           // Lower case file name.
+        TgaImage        image;
+        bool            compatible;     // Every subset samples it within [0, 1].
+    };
+
+    // Texture changes across draws in the given order, where each draw's texture is an object id.
+    uint32_t CountBinds(const std::vector<uint32_t>& objects)
+    {
+        uint32_t binds = 0;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            binds += i == 0 || objects[i] != objects[i - 1] ? 1 : 0;
+        }
+        return binds;
+    }
+
+    uint32_t CountSortedBinds(std::vector<uint32_t> objects)
+    {
+        std::sort(objects.begin(), objects.end());
+        return CountBinds(objects);
+    }
+
+    // Adds every texture and returns the table count, or zero if they did not fit.
+    uint32_t CountTables(const std::function<void(MaterialSystem&)>& addTextures, std::string& error)
+    {
+        MaterialSystem materials;
+        try
+        {
+            addTextures(materials);
+        }
+        catch (const std::exception& exception)
+        {
+            error = exception.what();
+            return 0;
+        }
+        return materials.GetTextureTableCount();
+    }
+
+    // Largest difference between each placed texture's own mips and its texels in the page's
+    // mips, which the grid and gutters should make zero for sizes on the grid.
+    uint32_t CompareMips(const TextureAtlas& atlas, const std::vector<SourceTexture>& sources, uint32_t& comparedTextures)
+    {
+        const uint32_t pageSize = atlas.settings.pageSize;
+        const uint32_t mipCount = atlas.settings.mipCount;
+        const uint32_t grid = 1u << (mipCount - 1);
+
+        std::vector<std::vector<uint8_t>> pageChains(atlas.pages.size());
+        for (size_t page = 0; page < atlas.pages.size(); ++page)
+        {
+            pageChains[page].resize(atlas.pages[page].size() * 2);
+            GenerateMipChain(atlas.pages[page].data(), pageSize, pageSize, mipCount, pageChains[page].data());
+        }
+
+        uint32_t worst = 0;
+        comparedTextures = 0;
+        for (const SourceTexture& source : sources)
+        {
+            AtlasPlacement placement;
+            if (!atlas.FindPlacement(source.name, placement) || source.image.width % grid || source.image.height % grid)
+            {
+                continue;
+            }
+            comparedTextures++;
+
+            std::vector<uint8_t> chain(source.image.pixels.size() * 2);
+            GenerateMipChain(source.image.pixels.data(), source.image.width, source.image.height, mipCount, chain.data());
+
+            size_t textureOffset = 0, pageOffset = 0;
+            for (uint32_t mip = 0; mip < mipCount; ++mip)
+            {
+                uint32_t width = source.image.width >> mip, height = source.image.height >> mip, size = pageSize >> mip;
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    const uint8_t* own = chain.data() + textureOffset + size_t(y) * width * 4;
+                    const uint8_t* packed = pageChains[placement.page].data() + pageOffset
+                        + ((size_t((placement.y >> mip) + y) * size) + (placement.x >> mip)) * 4;
+                    for (uint32_t i = 0; i < width * 4; ++i)
+                    {
+                        worst = std::max<uint32_t>(worst, static_cast<uint32_t>(abs(int(own[i]) - int(packed[i]))));
+                    }
+                }
+                textureOffset += size_t(width) * height * 4;
+                pageOffset += size_t(size) * size * 4;
+            }
+        }
+        return worst;
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardTextureAtlasBenchmark [options] [file.fbx]\n"
+            "  --assets <dir>          directory holding MURCIELAGO640.FBX and its TGAs (default %s)\n"
+            "  --page <texels>         atlas page size (default 1024)\n"
+            "  --max <texels>          largest texture side packed (default 256)\n"
+            "  --mips <n>              mips sampled from the pages (default 4)\n"
+            "  --threads <n>           worker pool threads, 0 for the hardware threads (default 0)\n",
+            BENCHMARK_ASSET_DIRECTORY);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    std::string modelPath;
+    TextureAtlasSettings settings;
+    uint32_t threads = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue)             assetDirectory = argv[++i];
+        else if (argument == "--page" && hasValue)          settings.pageSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--max" && hasValue)           settings.maxTextureSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--mips" && hasValue)          settings.mipCount = std::max<uint32_t>(1, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument.size() > 0 && argument[0] != '-') modelPath = argument;
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+    if (modelPath.empty())
+    {
+        modelPath = assetDirectory + "/MURCIELAGO640.FBX";
+    }
+
+    try
+    {
+        WorkerPool workers(threads > 0 ? threads - 1 : 0);
+        FbxModel model = LoadFbxModel(modelPath, &workers);
+        std::unordered_map<std::string, std::string> files = ListFiles(assetDirectory);
+
+        // The diffuse maps the subsets draw with, and whether their coordinates allow packing.
+        std::vector<SourceTexture> sources;
+        std::unordered_map<std::string, uint32_t> sourceIds;
+        std::vector<int32_t> subsetTextures(model.subsets.size(), -1);
+        for (size_t i = 0; i < model.subsets.size(); ++i)
+        {
+            const FbxSubset& subset = model.subsets[i];
+            if (subset.material < 0 || model.materials[subset.material].diffuseMap.empty())
+            {
+                continue;
+            }
+
+            std::string name = ToLower(GetFileName(model.materials[subset.material].diffuseMap));
+            auto file = files.find(name);
+            if (file == files.end())
+            {
+                continue;
+            }
+
+            auto id = sourceIds.emplace(name, static_cast<uint32_t>(sources.size()));
+            if (id.second)
+            {
+                sources.push_back(SourceTexture{ name, LoadTga(file->second), true });
+            }
+            subsetTextures[i] = id.first->second;
+            sources[id.first->second].compatible &= HasAtlasCompatibleTexcoords(model.mesh, subset.indexOffset, subset.indexCount);
+        }
+
+        std::vector<AtlasSourceTexture> packable;
+        for (const SourceTexture& source : sources)
+        {
+            if (source.compatible)
+            {
+                packable.push_back(AtlasSourceTexture{ source.name, source.image.width, source.image.height, source.image.pixels.data() });
+            }
+        }
+        TextureAtlas atlas = BuildTextureAtlas(packable, settings);
+
+        std::vector<AtlasMeshRange> ranges;
+        for (size_t i = 0; i < model.subsets.size(); ++i)
+        {
+            auto found = subsetTextures[i] >= 0 ? atlas.placements.find(sources[subsetTextures[i]].name) : atlas.placements.end();
+            ranges.push_back(AtlasMeshRange{ model.subsets[i].indexOffset, model.subsets[i].indexCount,
+                found != atlas.placements.end() ? &found->second : nullptr });
+        }
+        size_t verticesBefore = model.mesh.vertices.size();
+        uint32_t copies = RemapAtlasTexcoords(model.mesh, ranges);
+
+        // Every remapped coordinate should land on its own texture's rectangle.
+        uint32_t strayTexcoords = 0;
+        for (const AtlasMeshRange& range : ranges)
+        {
+            if (!range.placement)
+            {
+                continue;
+            }
+            for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+            {
+                const float* texcoord = model.mesh.vertices[model.mesh.indices[i]].texcoord;
+                for (int axis = 0; axis < 2; ++axis)
+                {
+                    float low = range.placement->uvOffset[axis] - 1.0f / 1024.0f * range.placement->uvScale[axis];
+                    float high = range.placement->uvOffset[axis] + (1.0f + 1.0f / 1024.0f) * range.placement->uvScale[axis];
+                    strayTexcoords += texcoord[axis] < low || texcoord[axis] > high ? 1 : 0;
+                }
+            }
+        }
+
+        uint32_t comparedTextures = 0;
+        uint32_t mipError = CompareMips(atlas, sources, comparedTextures);
+
+        // Material tables: one per texture size before, with the pages sharing one after.
+        std::string beforeError, afterError;
+        uint32_t tablesBefore = CountTables([&](MaterialSystem& materials)
+        {
+            for (const SourceTexture& source : sources)
+            {
+                materials.AddTexture(source.name, source.image.width, source.image.height, source.image.pixels);
+            }
+        }, beforeError);
+
+        std::vector<MaterialTexture> pageTextures;
+        std::vector<MaterialTexture> textures(sources.size());
+        MaterialSystem materials;
+        uint32_t tablesAfter = CountTables([&](MaterialSystem& counted)
+        {
+            for (MaterialSystem* target : { &counted, &materials })
+            {
+                pageTextures.clear();
+                for (size_t page = 0; page < atlas.pages.size(); ++page)
+                {
+                    pageTextures.push_back(target->AddTexture("atlas page " + std::to_string(page), settings.pageSize, settings.pageSize,
+                        atlas.pages[page], settings.mipCount));
+                }
+                for (size_t i = 0; i < sources.size(); ++i)
+                {
+                    AtlasPlacement placement;
+                    textures[i] = atlas.FindPlacement(sources[i].name, placement) ? pageTextures[placement.page]
+                        : target->AddTexture(sources[i].name, sources[i].image.width, sources[i].image.height, sources[i].image.pixels);
+                }
+            }
+        }, afterError);
+
+        // The atlased set goes through the registry to the device as the game would upload it.
+        ResourceRegistry registry;
+        HeadlessResourceDevice device;
+        ResourceUploadStatistics upload = tablesAfter ? materials.Commit(registry, device, &workers) : ResourceUploadStatistics{};
+
+        // Per frame, every textured subset drawn once: one texture object per source before,
+        // one per table after; the material system binds every table once either way.
+        std::vector<uint32_t> ownObjects, tableObjects;
+        for (size_t i = 0; i < model.subsets.size(); ++i)
+        {
+            if (subsetTextures[i] >= 0)
+            {
+                ownObjects.push_back(subsetTextures[i]);
+                tableObjects.push_back(textures[subsetTextures[i]] >> 16);
+            }
+        }
+
+        const TextureAtlasReport& report = atlas.report;
+        printf("%s: %zu subsets, %zu textured with %zu diffuse maps, %zu sampled within [0, 1]\n",
+            GetFileName(modelPath).c_str(), model.subsets.size(), ownObjects.size(), sources.size(), packable.size());
+        printf("atlas: %u textures on %u %ux%u pages in %.2f ms, %u mips; occupancy %.1f%% (%.1f%% with gutters)\n",
+            report.packedTextures, report.pages, settings.pageSize, settings.pageSize, report.packSeconds * 1000.0, settings.mipCount,
+            report.occupancy * 100.0, report.pageTexels ? 100.0 * report.cellTexels / report.pageTexels : 0.0);
+        printf("remap: %u vertices copied for shared corners (%zu -> %zu), %u coordinates off their rectangle\n",
+            copies, verticesBefore, model.mesh.vertices.size(), strayTexcoords);
+        printf("mips: %u textures compared through mip %u, largest texel difference %u\n",
+            comparedTextures, settings.mipCount - 1, mipError);
+        printf("texture binds per frame  in subset order %3u -> %3u   sorted by texture %3u -> %3u\n",
+            CountBinds(ownObjects), CountBinds(tableObjects), CountSortedBinds(ownObjects), CountSortedBinds(tableObjects));
+        if (tablesBefore)
+        {
+            printf("material tables          %u -> ", tablesBefore);
+        }
+        else
+        {
+            printf("material tables          more than %u (%s) -> ", c_materialTextureTables, beforeError.c_str());
+        }
+        if (tablesAfter)
+        {
+            printf("%u, uploaded %.1f MB in %.1f ms\n", tablesAfter, upload.uploadBytes / (1024.0 * 1024.0), upload.totalSeconds * 1000.0);
+        }
+        else
+        {
+            printf("more than %u (%s)\n", c_materialTextureTables, afterError.c_str());
+        }
+    }
+    catch (const std::exception& exception)
+    {
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,367 @@
+//
+// TextureStreamingBenchmark.cpp - Residency, budget pressure and time to sharp of the texture
+//                                 streamer on the Murcielago, against loading every mip up front
+//
+
+#include "pch.h"
+#include "FbxReader.h"
+#include "HeadlessStreamingTextureDevice.h"
+#include "MeshCooker.h"
+#include "TextureStreamer.h"
+#include "WorkerPool.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#endif
+
+using namespace DX;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const float c_fieldOfViewY = 3.14159265f / 4.0f;
+    const float c_viewportHeight = 1080.0f;
+
+    // A subset's draw: where it is and how densely its texture covers it.
+    struct TexturedSubset
+    {
+        uint32_t    texture;
+        float       uvDensity;
+        float       center[3];
+        float       radius;
+    };
+
+    double ToMegabytes(uint64_t bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    bool HasTgaExtension(const std::string& name)
+    {
+        if (name.size() < 4)
+        {
+            return false;
+        }
+        std::string extension = name.substr(name.size() - 4);
+        for (char& c : extension)
+        {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return extension == ".tga";
+    }
+
+    std::vector<std::string> ListTgaFiles(const std::string& directory)
+    {
+        std::vector<std::string> paths;
+#if defined(_WIN32)
+        WIN32_FIND_DATAA found;
+        HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+        if (search != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if (HasTgaExtension(found.cFileName))
+                {
+                    paths.push_back(directory + "\\" + found.cFileName);
+                }
+            } while (FindNextFileA(search, &found));
+            FindClose(search);
+        }
+#else
+        if (DIR* dir = opendir(directory.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                if (HasTgaExtension(entry->d_name))
+                {
+                    paths.push_back(directory + "/" + entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    // Each subset whose material's diffuse map is in the pack, with a bounding sphere.
+    std::vector<TexturedSubset> GetTexturedSubsets(const FbxModel& model, const TexturePack& pack)
+    {
+        std::vector<TexturedSubset> subsets;
+        for (const FbxSubset& subset : model.subsets)
+        {
+            uint32_t texture;
+            if (subset.material < 0 || subset.indexCount == 0 || !pack.FindTexture(model.materials[subset.material].diffuseMap, texture))
+            {
+                continue;
+            }
+
+            float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (uint32_t i = subset.indexOffset; i < subset.indexOffset + subset.indexCount; ++i)
+            {
+                const float* position = model.mesh.vertices[model.mesh.indices[i]].position;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    minimum[axis] = std::min(minimum[axis], position[axis]);
+                    maximum[axis] = std::max(maximum[axis], position[axis]);
+                }
+            }
+
+            TexturedSubset textured;
+            textured.texture = texture;
+            textured.uvDensity = ComputeUvDensity(model.mesh, subset.indexOffset, subset.indexCount);
+            float extent = 0.0f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                textured.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+                extent += (maximum[axis] - minimum[axis]) * (maximum[axis] - minimum[axis]);
+            }
+            textured.radius = 0.5f * sqrtf(extent);
+            subsets.push_back(textured);
+        }
+        return subsets;
+    }
+
+    void GetModelBounds(const MeshData& mesh, float center[3], float& radius)
+    {
+        float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (const MeshVertex& vertex : mesh.vertices)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+                maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+            }
+        }
+
+        float extent = 0.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+            extent += (maximum[axis] - minimum[axis]) * (maximum[axis] - minimum[axis]);
+        }
+        radius = 0.5f * sqrtf(extent);
+    }
+
+    // The camera flies in from far away while circling the car, circles it close up, then
+    // backs off. Returns its distance from the centre, in model radii, and its direction.
+    float GetCameraPath(float t, float direction[3])
+    {
+        float angle = t * 4.0f * 3.14159265f;
+        direction[0] = cosf(angle);
+        direction[1] = 0.35f;
+        direction[2] = sinf(angle);
+        float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            direction[axis] /= length;
+        }
+
+        if (t < 0.4f)
+        {
+            return 30.0f + (1.2f - 30.0f) * (t / 0.4f);
+        }
+        if (t < 0.8f)
+        {
+            return 1.2f;
+        }
+        return 1.2f + (8.0f - 1.2f) * ((t - 0.8f) / 0.2f);
+    }
+
+    void PrintUsage(FILE* file)
+    {
+        fprintf(file,
+            "usage: D3DFromWizardTextureStreamingBenchmark [options]\n"
+            "  --assets <dir>          directory holding MURCIELAGO640.FBX and its TGAs (default %s)\n"
+            "  --pack <file>           where to cook the texture pack (default TextureStreamingBenchmark.pack)\n"
+            "  --budget <MB>           streaming budget (default 6, a little under what the close-up orbit wants)\n"
+            "  --tail <texels>         largest mip always resident (default 64)\n"
+            "  --loads <n>             loads in flight (default 4)\n"
+            "  --frames <n>            frames along the camera path (default 600)\n"
+            "  --fps <n>               frame rate the frames are paced to, 0 for as fast as possible (default 60)\n"
+            "  --threads <n>           worker pool threads for cooking, 0 for the hardware threads (default 0)\n",
+            BENCHMARK_ASSET_DIRECTORY);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string assetDirectory = BENCHMARK_ASSET_DIRECTORY;
+    std::string packPath = "TextureStreamingBenchmark.pack";
+    double budgetMegabytes = 6.0;
+    TextureStreamerDesc desc;
+    uint32_t frames = 600;
+    double fps = 60.0;
+    uint32_t threads = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "--assets" && hasValue)             assetDirectory = argv[++i];
+        else if (argument == "--pack" && hasValue)          packPath = argv[++i];
+        else if (argument == "--budget" && hasValue)        budgetMegabytes = atof(argv[++i]);
+        else if (argument == "--tail" && hasValue)          desc.tailSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--loads" && hasValue)         desc.maxLoadsInFlight = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--frames" && hasValue)        frames = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if (argument == "--fps" && hasValue)           fps = atof(argv[++i]);
+        else if (argument == "--threads" && hasValue)       threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else
+        {
+            PrintUsage(argument == "--help" || argument == "-h" ? stdout : stderr);
+            return argument == "--help" || argument == "-h" ? 0 : 2;
+        }
+    }
+    desc.budgetBytes = static_cast<uint64_t>(budgetMegabytes * 1024.0 * 1024.0);
+
+    try
+    {
+        WorkerPool workers(threads > 0 ? threads - 1 : 0);
+
+        std::vector<std::string> sources = ListTgaFiles(assetDirectory);
+        Clock::time_point cookStart = Clock::now();
+        CookTexturePack(sources, packPath, &workers);
+        double cookSeconds = std::chrono::duration<double>(Clock::now() - cookStart).count();
+
+        TexturePack pack;
+        if (!pack.Open(packPath))
+        {
+            throw std::runtime_error("Unable to open the cooked pack " + packPath);
+        }
+
+        FbxModel model = LoadFbxModel(assetDirectory + "/MURCIELAGO640.FBX", &workers);
+        std::vector<TexturedSubset> subsets = GetTexturedSubsets(model, pack);
+        float modelCenter[3], modelRadius;
+        GetModelBounds(model.mesh, modelCenter, modelRadius);
+
+        HeadlessStreamingTextureDevice device;
+        TextureStreamer streamer(pack, desc);
+
+        uint64_t tailBytes = 0;
+        for (uint32_t i = 0; i < pack.GetTextureCount(); ++i)
+        {
+            const TexturePackEntry& entry = pack.GetTexture(i);
+            uint32_t tailMip = 0;
+            while (tailMip + 1 < entry.mipCount && (std::max(entry.width, entry.height) >> tailMip) > desc.tailSize)
+            {
+                ++tailMip;
+            }
+            tailBytes += entry.bytes - GetMipChainOffset(entry.width, entry.height, tailMip);
+        }
+
+        printf("%u textures cooked in %.0f ms (%u threads); %zu of %zu subsets textured; all mips %.1f MB, tails %.2f MB, budget %.1f MB\n",
+            pack.GetTextureCount(), cookSeconds * 1000.0, workers.GetThreadCount(), subsets.size(), model.subsets.size(),
+            ToMegabytes(pack.GetTotalBytes()), ToMegabytes(tailBytes), ToMegabytes(desc.budgetBytes));
+        printf("%6s %9s %8s %10s %10s %9s %7s %9s %9s\n", "frame", "distance", "visible", "resident", "wanted", "pressure", "sharp", "in flight", "deferred");
+
+        const float projectionScale = ComputeLodProjectionScale(c_fieldOfViewY, c_viewportHeight);
+        const std::chrono::duration<double> frameTime(fps > 0.0 ? 1.0 / fps : 0.0);
+        Clock::time_point nextFrame = Clock::now();
+
+        uint64_t peakResident = 0;
+        uint32_t pressuredFrames = 0, deferredLoads = 0;
+        double updateSeconds = 0.0, worstUpdateSeconds = 0.0;
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            float direction[3];
+            float distance = GetCameraPath(frames > 1 ? frame / float(frames - 1) : 0.0f, direction);
+            float camera[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                camera[axis] = modelCenter[axis] + direction[axis] * distance * modelRadius;
+            }
+
+            // Parts on the far side of the car are taken to be hidden by the near side.
+            streamer.BeginFrame();
+            uint32_t visible = 0;
+            for (const TexturedSubset& subset : subsets)
+            {
+                float toSubset[3], facing = 0.0f, length = 0.0f;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    toSubset[axis] = subset.center[axis] - camera[axis];
+                    facing += (subset.center[axis] - modelCenter[axis]) * direction[axis];
+                    length += toSubset[axis] * toSubset[axis];
+                }
+                if (facing < -0.25f * modelRadius)
+                {
+                    continue;
+                }
+
+                float subsetDistance = std::max(sqrtf(length) - subset.radius, 0.05f * modelRadius);
+                const TexturePackEntry& entry = pack.GetTexture(subset.texture);
+                streamer.RequestMip(subset.texture, ComputeRequiredMip(std::max(entry.width, entry.height), subset.uvDensity, subsetDistance, projectionScale));
+                visible++;
+            }
+
+            Clock::time_point updateStart = Clock::now();
+            streamer.Update(device);
+            double seconds = std::chrono::duration<double>(Clock::now() - updateStart).count();
+            updateSeconds += seconds;
+            worstUpdateSeconds = std::max(worstUpdateSeconds, seconds);
+
+            const TextureStreamingStatistics& stats = streamer.GetStatistics();
+            peakResident = std::max(peakResident, stats.residentBytes);
+            pressuredFrames += stats.budgetPressure > 1.0f ? 1 : 0;
+            deferredLoads += stats.deferredLoads;
+
+            if (frame % 60 == 0 || frame + 1 == frames)
+            {
+                printf("%6u %9.1f %8u %7.2f MB %7.2f MB %9.2f %3u/%-3u %9u %9u\n", frame, distance, visible,
+                    ToMegabytes(stats.residentBytes), ToMegabytes(stats.wantedBytes), stats.budgetPressure,
+                    stats.sharpTextures, stats.textures, stats.loadsInFlight, stats.deferredLoads);
+            }
+
+            if (fps > 0.0)
+            {
+                nextFrame += std::chrono::duration_cast<Clock::duration>(frameTime);
+                std::this_thread::sleep_until(nextFrame);
+            }
+            else
+            {
+                // Unpaced, the loader still needs a turn on machines with one core.
+                std::this_thread::yield();
+            }
+        }
+
+        const TextureStreamingStatistics& stats = streamer.GetStatistics();
+        HistogramSnapshot timeToSharp, framesToSharp;
+        streamer.GetTimeToSharp(timeToSharp);
+        streamer.GetFramesToSharp(framesToSharp);
+
+        printf("\nresident peak %.2f MB against %.1f MB for every mip up front (%.1fx less); %u of %u frames over budget,"
+            " %u loads deferred\n", ToMegabytes(peakResident), ToMegabytes(pack.GetTotalBytes()),
+            static_cast<double>(pack.GetTotalBytes()) / std::max<uint64_t>(peakResident, 1), pressuredFrames, frames, deferredLoads);
+        printf("%llu loads (%.1f MB), %llu evictions (%.1f MB); update %.3f ms mean, %.3f ms worst\n",
+            static_cast<unsigned long long>(stats.loads), ToMegabytes(stats.loadedBytes),
+            static_cast<unsigned long long>(stats.evictions), ToMegabytes(stats.evictedBytes),
+            updateSeconds * 1000.0 / std::max(frames, 1u), worstUpdateSeconds * 1000.0);
+        printf("time to sharp over %llu waits: p50 %.1f ms  p95 %.1f ms  p99 %.1f ms  max %.1f ms;  p50 %llu  p95 %llu  max %llu frames\n",
+            static_cast<unsigned long long>(timeToSharp.count),
+            timeToSharp.GetPercentile(0.5) / 1000.0, timeToSharp.GetPercentile(0.95) / 1000.0,
+            timeToSharp.GetPercentile(0.99) / 1000.0, timeToSharp.max / 1000.0,
+            static_cast<unsigned long long>(framesToSharp.GetPercentile(0.5)),
+            static_cast<unsigned long long>(framesToSharp.GetPercentile(0.95)),
+            static_cast<unsigned long long>(framesToSharp.max));
+    }
+    catch (const std::exception& exception)
+    {
+        remove(packPath.c_str());
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    remove(packPath.c_str());
+    return 0;
+}
@@ -0,0 +1,137 @@
+//
+// ClusterCulling.cpp - Per-meshlet frustum and normal cone culling on the CPU
+//
+
+#include "pch.h"
+#include "ClusterCulling.h"
+
+#include <math.h>
+#include <string.h>
+
+DX::Frustum DX::Frustum::FromViewProjection(const float m[4][4])
+{
+    // Column j of the matrix produces clip coordinate j.
+    auto column = [&](int j, float out[4])
+    {
+        out[0] = m[0][j];
+        out[1] = m[1][j];
+        out[2] = m[2][j];
+        out[3] = m[3][j];
+    };
+
+    float x[4], y[4], z[4], w[4];
+    column(0, x);
+    column(1, y);
+    column(2, z);
+    column(3, w);
+
+    Frustum frustum;
+    for (int i = 0; i < 4; ++i)
+    {
+        frustum.planes[0][i] = w[i] + x[i];     // Left
+        frustum.planes[1][i] = w[i] - x[i];     // Right
+        frustum.planes[2][i] = w[i] + y[i];     // Bottom
+        frustum.planes[3][i] = w[i] - y[i];     // Top
+        frustum.planes[4][i] = z[i];            // Near
+        frustum.planes[5][i] = w[i] - z[i];     // Far
+    }
+
+    for (int p = 0; p < 6; ++p)
+    {
+        float* plane = frustum.planes[p];
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            plane[0] /= length;
+            plane[1] /= length;
+            plane[2] /= length;
+            plane[3] /= length;
+        }
+    }
+
+    return frustum;
+}
+
+bool DX::Frustum::IntersectsSphere(const float center[3], float radius) const
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+        if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DX::ClusterCuller::ClusterCuller() :
+    m_statistics{}
+{
+}
+
+void DX::ClusterCuller::ResetStatistics()
+{
+    memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+void DX::ClusterCuller::Cull(
+    const MeshletData& data,
+    uint32_t firstMeshlet,
+    uint32_t meshletCount,
+    const Frustum& frustum,
+    const float cameraPosition[3],
+    std::vector<uint32_t>& visible)
+{
+    assert(firstMeshlet + meshletCount <= data.meshlets.size());
+
+    m_statistics.clusters += meshletCount;
+
+    for (uint32_t i = firstMeshlet; i < firstMeshlet + meshletCount; ++i)
+    {
+        const MeshletBounds& bounds = data.bounds[i];
+
+        if (!frustum.IntersectsSphere(bounds.center, bounds.radius))
+        {
+            m_statistics.frustumCulled++;
+            continue;
+        }
+
+        if (bounds.coneCutoff < 1.0f)
+        {
+            float view[3] =
+            {
+                bounds.coneApex[0] - cameraPosition[0],
+                bounds.coneApex[1] - cameraPosition[1],
+                bounds.coneApex[2] - cameraPosition[2]
+            };
+            float distance = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+            float facing = view[0] * bounds.coneAxis[0] + view[1] * bounds.coneAxis[1] + view[2] * bounds.coneAxis[2];
+
+            if (facing >= bounds.coneCutoff * distance)
+            {
+                m_statistics.backfaceCulled++;
+                continue;
+            }
+        }
+
+        visible.push_back(i);
+        m_statistics.visibleClusters++;
+        m_statistics.visibleTriangles += data.meshlets[i].triangleCount;
+    }
+}
+
+void DX::ClusterCuller::BuildCompactedIndices(const MeshletData& data, const std::vector<uint32_t>& visible, std::vector<uint32_t>& indices)
+{
+    for (uint32_t index : visible)
+    {
+        const Meshlet& meshlet = data.meshlets[index];
+        const uint32_t* vertices = &data.vertices[meshlet.vertexOffset];
+        const uint8_t* triangles = &data.triangles[meshlet.triangleOffset];
+
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+        {
+            indices.push_back(vertices[triangles[i]]);
+        }
+    }
+}
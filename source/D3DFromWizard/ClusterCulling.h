@@ -0,0 +1,60 @@
+//
+// ClusterCulling.h - Per-meshlet frustum and normal cone culling on the CPU
+//
+
+#pragma once
+
+#include "Meshlets.h"
+
+namespace DX
+{
+    // Six planes (ax + by + cz + d >= 0 inside) in the space the clusters are tested in.
+    struct Frustum
+    {
+        float planes[6][4];
+
+        // Extracts the planes of a row-vector view-projection matrix (as used with DirectXMath,
+        // clip = position * matrix) with a [0, 1] depth range.
+        static Frustum FromViewProjection(const float matrix[4][4]);
+
+        bool IntersectsSphere(const float center[3], float radius) const;
+    };
+
+    struct ClusterCullStatistics
+    {
+        uint32_t clusters;
+        uint32_t frustumCulled;
+        uint32_t backfaceCulled;
+        uint32_t visibleClusters;
+        uint32_t visibleTriangles;
+    };
+
+    // Rejects clusters outside the frustum or whose normal cone faces entirely away from the
+    // camera. The frustum and camera position must be in the mesh's object space; transforming
+    // the camera once per instance is far cheaper than transforming every cluster.
+    class ClusterCuller
+    {
+    public:
+        ClusterCuller();
+
+        // Writes the indices of the surviving meshlets (within [first, first + count)) to visible.
+        void Cull(
+            const MeshletData& data,
+            uint32_t firstMeshlet,
+            uint32_t meshletCount,
+            const Frustum& frustum,
+            const float cameraPosition[3],
+            std::vector<uint32_t>& visible);
+
+        // Expands the visible meshlets back into a triangle list that indexes the original
+        // vertex buffer, ready for upload or for the software rasterizer. Appends to indices,
+        // so several draws can share one list.
+        static void BuildCompactedIndices(const MeshletData& data, const std::vector<uint32_t>& visible, std::vector<uint32_t>& indices);
+
+        void ResetStatistics();
+        const ClusterCullStatistics& GetStatistics() const  { return m_statistics; }
+
+    private:
+        ClusterCullStatistics   m_statistics;
+    };
+}
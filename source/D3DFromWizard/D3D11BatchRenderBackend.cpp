@@ -0,0 +1,218 @@
+//
+// D3D11BatchRenderBackend.cpp - Batch render backend drawing into offscreen D3D11 targets
+//
+
+#include "pch.h"
+#include "D3D11BatchRenderBackend.h"
+#include "D3D11VertexLayout.h"
+#include "DeviceResources.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Lambert lighting with an ambient term, matching the headless rasterizer.
+    constexpr char c_batchShader[] =
+        "cbuffer BatchConstants\n"
+        "{\n"
+        "    row_major float4x4 worldViewProjection;\n"
+        "    float4 lightDirection;\n"
+        "};\n"
+        "struct VS_IN\n"
+        "{\n"
+        "    float3 pos    : POSITION;\n"
+        "    float3 normal : NORMAL;\n"
+        "    float2 uv     : TEXCOORD;\n"
+        "};\n"
+        "struct VS_OUT\n"
+        "{\n"
+        "    float4 pos       : SV_POSITION;\n"
+        "    float  intensity : TEXCOORD;\n"
+        "};\n"
+        "VS_OUT VS(VS_IN input)\n"
+        "{\n"
+        "    VS_OUT output;\n"
+        "    output.pos = mul(float4(input.pos, 1), worldViewProjection);\n"
+        "    output.intensity = 0.2 + 0.8 * saturate(dot(input.normal, lightDirection.xyz));\n"
+        "    return output;\n"
+        "}\n"
+        "float4 PS(VS_OUT input) : SV_Target\n"
+        "{\n"
+        "    return float4(float3(200, 200, 205) / 255 * input.intensity, 1);\n"
+        "}\n";
+
+    struct BatchConstants
+    {
+        float   worldViewProjection[4][4];
+        float   lightDirection[4];
+    };
+
+    static_assert(DX::ConstantBufferMatches<BatchConstants>(c_batchShader, "BatchConstants",
+        DX_CONSTANT_MEMBER(BatchConstants, worldViewProjection),
+        DX_CONSTANT_MEMBER(BatchConstants, lightDirection)), "BatchConstants does not match its cbuffer");
+
+    // Scenes are only drawn, so their vertices are uploaded quantized.
+    static_assert(DX::ShaderInputMatches(c_batchShader, "VS_IN", DX::c_quantizedMeshVertexLayout),
+        "VS_IN does not match QuantizedMeshVertex");
+    constexpr auto c_inputElements = DX::MakeInputElements(DX::c_quantizedMeshVertexLayout);
+
+    // Cornflower blue.
+    const float c_background[4] = { 0.392156899f, 0.584313750f, 0.929411829f, 1.0f };
+
+    DX::ShaderSource MakeBatchSource(const char* entryPoint, const char* target)
+    {
+        DX::ShaderSource source;
+        source.name = "BatchRender";
+        source.source = c_batchShader;
+        source.entryPoint = entryPoint;
+        source.target = target;
+        return source;
+    }
+};
+
+DX::D3D11BatchRenderBackend::D3D11BatchRenderBackend(ID3D11Device* device, ID3D11DeviceContext* context, D3D11PipelineCache& pipelineCache) :
+    m_device(device),
+    m_context(context),
+    m_sceneBytes(0)
+{
+    CD3D11_BUFFER_DESC constantsDesc(sizeof(BatchConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+    ThrowIfFailed(device->CreateBuffer(&constantsDesc, nullptr, m_constants.ReleaseAndGetAddressOf()));
+
+    ShaderSource vertexShader = MakeBatchSource("VS", "vs_4_0");
+    m_vertexShader = pipelineCache.GetVertexShader(vertexShader);
+    m_pixelShader = pipelineCache.GetPixelShader(MakeBatchSource("PS", "ps_4_0"));
+    m_inputLayout = pipelineCache.GetInputLayout(c_inputElements.elements, c_inputElements.GetCount(), vertexShader);
+
+    CD3D11_DEPTH_STENCIL_DESC depthDesc(D3D11_DEFAULT);
+    m_depthState = pipelineCache.GetDepthStencilState(depthDesc);
+
+    // Source meshes are not consistent about their winding.
+    CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+    rasterizerDesc.CullMode = D3D11_CULL_NONE;
+    m_rasterizerState = pipelineCache.GetRasterizerState(rasterizerDesc);
+
+    for (Target& target : m_targets)
+    {
+        target.width = target.height = 0;
+    }
+}
+
+uint32_t DX::D3D11BatchRenderBackend::AddScene(const MeshData& mesh)
+{
+    Scene scene;
+
+    std::vector<QuantizedMeshVertex> vertices(mesh.vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i] = QuantizeMeshVertex(mesh.vertices[i]);
+    }
+
+    CD3D11_BUFFER_DESC vertexDesc(static_cast<UINT>(vertices.size() * sizeof(QuantizedMeshVertex)), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+    D3D11_SUBRESOURCE_DATA vertexData = { vertices.data(), 0, 0 };
+    ThrowIfFailed(m_device->CreateBuffer(&vertexDesc, &vertexData, scene.vertexBuffer.ReleaseAndGetAddressOf()));
+
+    CD3D11_BUFFER_DESC indexDesc(static_cast<UINT>(mesh.indices.size() * sizeof(uint32_t)), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+    D3D11_SUBRESOURCE_DATA indexData = { mesh.indices.data(), 0, 0 };
+    ThrowIfFailed(m_device->CreateBuffer(&indexDesc, &indexData, scene.indexBuffer.ReleaseAndGetAddressOf()));
+
+    scene.indexCount = static_cast<UINT>(mesh.indices.size());
+    m_scenes.push_back(scene);
+
+    m_sceneBytes += vertexDesc.ByteWidth + indexDesc.ByteWidth;
+    m_sceneMemory.Track(MemoryCategory_DeviceBuffers, m_sceneBytes, "batch scenes");
+
+    return static_cast<uint32_t>(m_scenes.size() - 1);
+}
+
+void DX::D3D11BatchRenderBackend::Begin(uint32_t targetIndex, const BatchView& view)
+{
+    Target& target = m_targets[targetIndex];
+    if (target.width != view.width || target.height != view.height)
+    {
+        CreateTarget(target, view.width, view.height);
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    ThrowIfFailed(m_context->Map(m_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+    BatchConstants* constants = static_cast<BatchConstants*>(mapped.pData);
+    memcpy(constants->worldViewProjection, view.worldViewProjection, sizeof(constants->worldViewProjection));
+    memcpy(constants->lightDirection, view.lightDirection, sizeof(view.lightDirection));
+    constants->lightDirection[3] = 0.0f;
+    m_context->Unmap(m_constants.Get(), 0);
+
+    m_context->ClearRenderTargetView(target.renderTargetView.Get(), c_background);
+    m_context->ClearDepthStencilView(target.depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+    ID3D11RenderTargetView* renderTarget = target.renderTargetView.Get();
+    m_context->OMSetRenderTargets(1, &renderTarget, target.depthStencilView.Get());
+    CD3D11_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(view.width), static_cast<float>(view.height));
+    m_context->RSSetViewports(1, &viewport);
+    m_context->OMSetDepthStencilState(m_depthState, 0);
+    m_context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+    m_context->RSSetState(m_rasterizerState);
+
+    const Scene& scene = m_scenes[view.scene];
+    UINT stride = c_quantizedMeshVertexLayout.stride;
+    UINT offset = 0;
+    ID3D11Buffer* vertexBuffer = scene.vertexBuffer.Get();
+    m_context->IASetInputLayout(m_inputLayout);
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+    m_context->IASetIndexBuffer(scene.indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+
+    ID3D11Buffer* constantBuffer = m_constants.Get();
+    m_context->VSSetShader(m_vertexShader, nullptr, 0);
+    m_context->VSSetConstantBuffers(0, 1, &constantBuffer);
+    m_context->PSSetShader(m_pixelShader, nullptr, 0);
+
+    m_context->DrawIndexed(scene.indexCount, 0, 0);
+
+    m_context->CopyResource(target.staging.Get(), target.color.Get());
+}
+
+void DX::D3D11BatchRenderBackend::Flush()
+{
+    m_context->Flush();
+}
+
+bool DX::D3D11BatchRenderBackend::Map(uint32_t targetIndex, bool wait, const uint8_t*& pixels, uint32_t& rowPitch, PixelFormat& format)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = m_context->Map(m_targets[targetIndex].staging.Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+    {
+        return false;
+    }
+    ThrowIfFailed(hr);
+
+    pixels = static_cast<const uint8_t*>(mapped.pData);
+    rowPitch = mapped.RowPitch;
+    format = PixelFormat_Rgba8;
+    return true;
+}
+
+void DX::D3D11BatchRenderBackend::Unmap(uint32_t targetIndex)
+{
+    m_context->Unmap(m_targets[targetIndex].staging.Get(), 0);
+}
+
+void DX::D3D11BatchRenderBackend::CreateTarget(Target& target, uint32_t width, uint32_t height)
+{
+    target.width = width;
+    target.height = height;
+
+    CD3D11_TEXTURE2D_DESC colorDesc(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1, D3D11_BIND_RENDER_TARGET);
+    ThrowIfFailed(m_device->CreateTexture2D(&colorDesc, nullptr, target.color.ReleaseAndGetAddressOf()));
+    ThrowIfFailed(m_device->CreateRenderTargetView(target.color.Get(), nullptr, target.renderTargetView.ReleaseAndGetAddressOf()));
+
+    CD3D11_TEXTURE2D_DESC depthDesc(DXGI_FORMAT_D32_FLOAT, width, height, 1, 1, D3D11_BIND_DEPTH_STENCIL);
+    ThrowIfFailed(m_device->CreateTexture2D(&depthDesc, nullptr, target.depth.ReleaseAndGetAddressOf()));
+    CD3D11_DEPTH_STENCIL_VIEW_DESC depthViewDesc(D3D11_DSV_DIMENSION_TEXTURE2D);
+    ThrowIfFailed(m_device->CreateDepthStencilView(target.depth.Get(), &depthViewDesc, target.depthStencilView.ReleaseAndGetAddressOf()));
+
+    CD3D11_TEXTURE2D_DESC stagingDesc(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+    ThrowIfFailed(m_device->CreateTexture2D(&stagingDesc, nullptr, target.staging.ReleaseAndGetAddressOf()));
+
+    target.memory.Track(MemoryCategory_RenderTargets,
+        GetTextureBytes(colorDesc) + GetTextureBytes(depthDesc) + GetTextureBytes(stagingDesc), "batch target");
+}
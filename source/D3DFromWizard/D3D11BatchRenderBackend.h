@@ -0,0 +1,74 @@
+//
+// D3D11BatchRenderBackend.h - Batch render backend drawing into offscreen D3D11 targets
+//
+
+#pragma once
+
+#include "BatchRenderer.h"
+#include "D3D11PipelineCache.h"
+#include "MemoryTracker.h"
+
+namespace DX
+{
+    // Each target is a colour and depth texture plus a staging copy. Begin draws a job and
+    // queues the copy, so up to c_targetCount jobs are on the GPU at once; Map reads a copy back
+    // with DO_NOT_WAIT unless asked to wait. Targets are reallocated when a job's size differs
+    // from the last one drawn into them, so keep sizes uniform for the best throughput.
+    // Recreate on device lost.
+    class D3D11BatchRenderBackend : public IBatchRenderBackend
+    {
+    public:
+        static const uint32_t c_targetCount = 4;
+
+        D3D11BatchRenderBackend(ID3D11Device* device, ID3D11DeviceContext* context, D3D11PipelineCache& pipelineCache);
+
+        D3D11BatchRenderBackend(const D3D11BatchRenderBackend&) = delete;
+        D3D11BatchRenderBackend& operator=(const D3D11BatchRenderBackend&) = delete;
+
+        // IBatchRenderBackend
+        virtual uint32_t AddScene(const MeshData& mesh) override;
+        virtual uint32_t GetTargetCount() const override     { return c_targetCount; }
+        virtual void Begin(uint32_t target, const BatchView& view) override;
+        virtual void Flush() override;
+        virtual bool Map(uint32_t target, bool wait, const uint8_t*& pixels, uint32_t& rowPitch, PixelFormat& format) override;
+        virtual void Unmap(uint32_t target) override;
+
+    private:
+        struct Scene
+        {
+            Microsoft::WRL::ComPtr<ID3D11Buffer>            vertexBuffer;
+            Microsoft::WRL::ComPtr<ID3D11Buffer>            indexBuffer;
+            UINT                                            indexCount;
+        };
+
+        struct Target
+        {
+            uint32_t                                        width;
+            uint32_t                                        height;
+            Microsoft::WRL::ComPtr<ID3D11Texture2D>         color;
+            Microsoft::WRL::ComPtr<ID3D11RenderTargetView>  renderTargetView;
+            Microsoft::WRL::ComPtr<ID3D11Texture2D>         depth;
+            Microsoft::WRL::ComPtr<ID3D11DepthStencilView>  depthStencilView;
+            Microsoft::WRL::ComPtr<ID3D11Texture2D>         staging;
+            TrackedMemory                                   memory;
+        };
+
+        void CreateTarget(Target& target, uint32_t width, uint32_t height);
+
+        Microsoft::WRL::ComPtr<ID3D11Device>                m_device;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext>         m_context;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>                m_constants;
+
+        // Owned by the pipeline cache.
+        ID3D11VertexShader*                                 m_vertexShader;
+        ID3D11PixelShader*                                  m_pixelShader;
+        ID3D11InputLayout*                                  m_inputLayout;
+        ID3D11DepthStencilState*                            m_depthState;
+        ID3D11RasterizerState*                              m_rasterizerState;
+
+        std::vector<Scene>                                  m_scenes;
+        Target                                              m_targets[c_targetCount];
+        TrackedMemory                                       m_sceneMemory;
+        uint64_t                                            m_sceneBytes;
+    };
+}
@@ -0,0 +1,270 @@
+//
+// D3D11CommandSink.cpp - Translates render queue commands into immediate context calls
+//
+
+#include "pch.h"
+#include "D3D11CommandSink.h"
+
+using Microsoft::WRL::ComPtr;
+
+DX::D3D11CommandSink::D3D11CommandSink(ID3D11DeviceContext* context) :
+    m_context(context),
+    m_materialSystem(nullptr),
+    m_materialResources(nullptr)
+{
+}
+
+// Handles are 1-based so that zero can stand for "unbind".
+template<typename T>
+DX::StateHandle DX::D3D11CommandSink::Register(std::vector<ComPtr<T>>& table, T* object)
+{
+    if (!object)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        if (table[i].Get() == object)
+        {
+            return static_cast<StateHandle>(i + 1);
+        }
+    }
+
+    if (table.size() >= 0xFFFF)
+    {
+        throw std::out_of_range("Too many objects registered with the command sink");
+    }
+
+    table.emplace_back(object);
+    return static_cast<StateHandle>(table.size());
+}
+
+template<typename T>
+void DX::D3D11CommandSink::Replace(std::vector<ComPtr<T>>& table, StateHandle handle, T* object)
+{
+    if (handle == 0 || handle > table.size())
+    {
+        throw std::out_of_range("Replacing an unregistered command sink handle");
+    }
+
+    table[handle - 1] = object;
+}
+
+template<typename T>
+T* DX::D3D11CommandSink::Lookup(const std::vector<ComPtr<T>>& table, StateHandle handle)
+{
+    assert(handle <= table.size());
+    return handle ? table[handle - 1].Get() : nullptr;
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterInputLayout(ID3D11InputLayout* inputLayout)
+{
+    return Register(m_inputLayouts, inputLayout);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterVertexShader(ID3D11VertexShader* vertexShader)
+{
+    return Register(m_vertexShaders, vertexShader);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterPixelShader(ID3D11PixelShader* pixelShader)
+{
+    return Register(m_pixelShaders, pixelShader);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterBlendState(ID3D11BlendState* blendState)
+{
+    return Register(m_blendStates, blendState);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterDepthStencilState(ID3D11DepthStencilState* depthStencilState)
+{
+    return Register(m_depthStencilStates, depthStencilState);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterRasterizerState(ID3D11RasterizerState* rasterizerState)
+{
+    return Register(m_rasterizerStates, rasterizerState);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterBuffer(ID3D11Buffer* buffer)
+{
+    return Register(m_buffers, buffer);
+}
+
+DX::StateHandle DX::D3D11CommandSink::RegisterMaterial(const D3D11Material& material)
+{
+    if (m_materials.size() >= 0xFFFF)
+    {
+        throw std::out_of_range("Too many materials registered with the command sink");
+    }
+
+    m_materials.push_back(material);
+    return static_cast<StateHandle>(m_materials.size());
+}
+
+void DX::D3D11CommandSink::ReplaceInputLayout(StateHandle handle, ID3D11InputLayout* inputLayout)
+{
+    Replace(m_inputLayouts, handle, inputLayout);
+}
+
+void DX::D3D11CommandSink::ReplaceVertexShader(StateHandle handle, ID3D11VertexShader* vertexShader)
+{
+    Replace(m_vertexShaders, handle, vertexShader);
+}
+
+void DX::D3D11CommandSink::ReplacePixelShader(StateHandle handle, ID3D11PixelShader* pixelShader)
+{
+    Replace(m_pixelShaders, handle, pixelShader);
+}
+
+void DX::D3D11CommandSink::ReplaceBuffer(StateHandle handle, ID3D11Buffer* buffer)
+{
+    Replace(m_buffers, handle, buffer);
+}
+
+void DX::D3D11CommandSink::ReplaceMaterial(StateHandle handle, const D3D11Material& material)
+{
+    if (handle == 0 || handle > m_materials.size())
+    {
+        throw std::out_of_range("Replacing an unregistered command sink material");
+    }
+
+    m_materials[handle - 1] = material;
+}
+
+void DX::D3D11CommandSink::SetMaterialSystem(MaterialSystem* materials, const D3D11ResourceDevice* resources, ID3D11SamplerState* sampler)
+{
+    m_materialSystem = materials;
+    m_materialResources = resources;
+    m_materialSampler = sampler;
+
+    // Nothing of the system's is bound by this sink yet.
+    if (m_materialSystem)
+    {
+        m_materialSystem->InvalidateBindings();
+    }
+}
+
+// Releases every registered object. Handles handed out before this call are invalid afterwards.
+void DX::D3D11CommandSink::Reset()
+{
+    m_inputLayouts.clear();
+    m_vertexShaders.clear();
+    m_pixelShaders.clear();
+    m_blendStates.clear();
+    m_depthStencilStates.clear();
+    m_rasterizerStates.clear();
+    m_buffers.clear();
+    m_materials.clear();
+
+    m_materialSystem = nullptr;
+    m_materialResources = nullptr;
+    m_materialSampler.Reset();
+}
+
+void DX::D3D11CommandSink::SetInputLayout(StateHandle inputLayout)
+{
+    m_context->IASetInputLayout(Lookup(m_inputLayouts, inputLayout));
+}
+
+void DX::D3D11CommandSink::SetPrimitiveTopology(uint8_t topology)
+{
+    m_context->IASetPrimitiveTopology(static_cast<D3D11_PRIMITIVE_TOPOLOGY>(topology));
+}
+
+void DX::D3D11CommandSink::SetVertexShader(StateHandle vertexShader)
+{
+    m_context->VSSetShader(Lookup(m_vertexShaders, vertexShader), nullptr, 0);
+}
+
+void DX::D3D11CommandSink::SetPixelShader(StateHandle pixelShader)
+{
+    m_context->PSSetShader(Lookup(m_pixelShaders, pixelShader), nullptr, 0);
+}
+
+void DX::D3D11CommandSink::SetVertexBuffer(StateHandle vertexBuffer, uint32_t stride)
+{
+    ID3D11Buffer* buffer = Lookup(m_buffers, vertexBuffer);
+    UINT offset = 0;
+    m_context->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+}
+
+void DX::D3D11CommandSink::SetIndexBuffer(StateHandle indexBuffer)
+{
+    m_context->IASetIndexBuffer(Lookup(m_buffers, indexBuffer), DXGI_FORMAT_R32_UINT, 0);
+}
+
+void DX::D3D11CommandSink::SetMaterial(StateHandle material)
+{
+    if (m_materialSystem)
+    {
+        if (m_materialSystem->Select(material))
+        {
+            BindMaterialTables();
+        }
+        return;
+    }
+
+    ID3D11Buffer* constants = nullptr;
+    ID3D11ShaderResourceView* textures[D3D11Material::MaxTextures] = {};
+    ID3D11SamplerState* sampler = nullptr;
+
+    if (material)
+    {
+        assert(material <= m_materials.size());
+        const D3D11Material& bound = m_materials[material - 1];
+
+        constants = bound.constants.Get();
+        for (UINT i = 0; i < D3D11Material::MaxTextures; ++i)
+        {
+            textures[i] = bound.textures[i].Get();
+        }
+        sampler = bound.sampler.Get();
+    }
+
+    m_context->PSSetConstantBuffers(0, 1, &constants);
+    m_context->PSSetShaderResources(0, D3D11Material::MaxTextures, textures);
+    m_context->PSSetSamplers(0, 1, &sampler);
+}
+
+// Same slots as a D3D11Material's textures and sampler, which it replaces.
+void DX::D3D11CommandSink::BindMaterialTables()
+{
+    ID3D11ShaderResourceView* views[1 + c_materialTextureTables] = {};
+    views[0] = m_materialResources->GetShaderResourceView(m_materialSystem->GetParameterBuffer());
+    for (uint32_t table = 0; table < m_materialSystem->GetTextureTableCount(); ++table)
+    {
+        views[1 + table] = m_materialResources->GetShaderResourceView(m_materialSystem->GetTextureTable(table));
+    }
+
+    ID3D11SamplerState* sampler = m_materialSampler.Get();
+    m_context->PSSetShaderResources(0, _countof(views), views);
+    m_context->PSSetSamplers(0, 1, &sampler);
+}
+
+void DX::D3D11CommandSink::SetBlendState(StateHandle blendState)
+{
+    m_context->OMSetBlendState(Lookup(m_blendStates, blendState), nullptr, 0xFFFFFFFF);
+}
+
+void DX::D3D11CommandSink::SetDepthStencilState(StateHandle depthStencilState)
+{
+    m_context->OMSetDepthStencilState(Lookup(m_depthStencilStates, depthStencilState), 0);
+}
+
+void DX::D3D11CommandSink::SetRasterizerState(StateHandle rasterizerState)
+{
+    m_context->RSSetState(Lookup(m_rasterizerStates, rasterizerState));
+}
+
+void DX::D3D11CommandSink::DrawIndexed(const DrawPacket& packet)
+{
+    if (m_drawCallback)
+    {
+        m_drawCallback(m_context, packet);
+    }
+
+    m_context->DrawIndexed(packet.indexCount, packet.startIndex, packet.baseVertex);
+}
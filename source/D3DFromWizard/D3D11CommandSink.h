@@ -0,0 +1,103 @@
+//
+// D3D11CommandSink.h - Translates render queue commands into immediate context calls
+//
+
+#pragma once
+
+#include "D3D11ResourceDevice.h"
+#include "MaterialSystem.h"
+#include "RenderQueue.h"
+
+#include <functional>
+
+namespace DX
+{
+    // Pixel stage bindings that travel together as one material.
+    struct D3D11Material
+    {
+        static const UINT MaxTextures = 4;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer>                constants;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    textures[MaxTextures];
+        Microsoft::WRL::ComPtr<ID3D11SamplerState>          sampler;
+    };
+
+    // Owns the state tables that render queue handles index into and binds them on the
+    // immediate context. Registered objects live until Reset, which must be called on device lost.
+    class D3D11CommandSink : public IRenderCommandSink
+    {
+    public:
+        D3D11CommandSink(ID3D11DeviceContext* context);
+
+        StateHandle RegisterInputLayout(ID3D11InputLayout* inputLayout);
+        StateHandle RegisterVertexShader(ID3D11VertexShader* vertexShader);
+        StateHandle RegisterPixelShader(ID3D11PixelShader* pixelShader);
+        StateHandle RegisterBlendState(ID3D11BlendState* blendState);
+        StateHandle RegisterDepthStencilState(ID3D11DepthStencilState* depthStencilState);
+        StateHandle RegisterRasterizerState(ID3D11RasterizerState* rasterizerState);
+        StateHandle RegisterBuffer(ID3D11Buffer* buffer);
+        StateHandle RegisterMaterial(const D3D11Material& material);
+
+        // Swap the object behind an existing handle, keeping every queued sort key valid.
+        // Used by hot reload; call between frames and invalidate the render queue's state.
+        void ReplaceInputLayout(StateHandle handle, ID3D11InputLayout* inputLayout);
+        void ReplaceVertexShader(StateHandle handle, ID3D11VertexShader* vertexShader);
+        void ReplacePixelShader(StateHandle handle, ID3D11PixelShader* pixelShader);
+        void ReplaceBuffer(StateHandle handle, ID3D11Buffer* buffer);
+        void ReplaceMaterial(StateHandle handle, const D3D11Material& material);
+
+        // Switches material handles to ids into the material system. Selecting one binds nothing:
+        // the parameter buffer and texture tables are bound together when first needed and stay
+        // bound, and the draw callback passes DrawPacket::material to the shaders with the
+        // per-object data. Null goes back to registered D3D11Materials.
+        void SetMaterialSystem(MaterialSystem* materials, const D3D11ResourceDevice* resources, ID3D11SamplerState* sampler);
+
+        // Called before every draw so per-object data (selected by DrawPacket::userData) can be updated.
+        typedef std::function<void(ID3D11DeviceContext*, const DrawPacket&)> DrawCallback;
+        void SetDrawCallback(DrawCallback callback)                     { m_drawCallback = std::move(callback); }
+
+        void Reset();
+
+        // IRenderCommandSink
+        virtual void SetInputLayout(StateHandle inputLayout) override;
+        virtual void SetPrimitiveTopology(uint8_t topology) override;
+        virtual void SetVertexShader(StateHandle vertexShader) override;
+        virtual void SetPixelShader(StateHandle pixelShader) override;
+        virtual void SetVertexBuffer(StateHandle vertexBuffer, uint32_t stride) override;
+        virtual void SetIndexBuffer(StateHandle indexBuffer) override;
+        virtual void SetMaterial(StateHandle material) override;
+        virtual void SetBlendState(StateHandle blendState) override;
+        virtual void SetDepthStencilState(StateHandle depthStencilState) override;
+        virtual void SetRasterizerState(StateHandle rasterizerState) override;
+        virtual void DrawIndexed(const DrawPacket& packet) override;
+
+    private:
+        template<typename T>
+        static StateHandle Register(std::vector<Microsoft::WRL::ComPtr<T>>& table, T* object);
+
+        template<typename T>
+        static void Replace(std::vector<Microsoft::WRL::ComPtr<T>>& table, StateHandle handle, T* object);
+
+        template<typename T>
+        static T* Lookup(const std::vector<Microsoft::WRL::ComPtr<T>>& table, StateHandle handle);
+
+        void BindMaterialTables();
+
+        ID3D11DeviceContext*                                    m_context;
+
+        std::vector<Microsoft::WRL::ComPtr<ID3D11InputLayout>>          m_inputLayouts;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11VertexShader>>         m_vertexShaders;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11PixelShader>>          m_pixelShaders;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11BlendState>>           m_blendStates;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilState>>    m_depthStencilStates;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11RasterizerState>>      m_rasterizerStates;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>>               m_buffers;
+        std::vector<D3D11Material>                                      m_materials;
+
+        MaterialSystem*                                         m_materialSystem;
+        const D3D11ResourceDevice*                              m_materialResources;
+        Microsoft::WRL::ComPtr<ID3D11SamplerState>              m_materialSampler;
+
+        DrawCallback                                            m_drawCallback;
+    };
+}
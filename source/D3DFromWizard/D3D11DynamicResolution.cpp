@@ -0,0 +1,159 @@
+//
+// D3D11DynamicResolution.cpp - Scaled scene render target and the upscale pass to the back buffer
+//
+
+#include "pch.h"
+#include "D3D11DynamicResolution.h"
+#include "DeviceResources.h"
+#include "VertexLayout.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // One triangle covering the output. The texture coordinates are scaled to the rendered
+    // corner of the target and clamped half a texel inside it, so the bilinear filter never
+    // reads the stale pixels around it.
+    constexpr char c_upscaleShader[] =
+        "cbuffer UpscaleConstants\n"
+        "{\n"
+        "    float2 uvScale;\n"
+        "    float2 uvMax;\n"
+        "};\n"
+        "Texture2D scene;\n"
+        "SamplerState linearClamp;\n"
+        "struct VS_OUT\n"
+        "{\n"
+        "    float4 pos : SV_POSITION;\n"
+        "    float2 uv  : TEXCOORD;\n"
+        "};\n"
+        "VS_OUT VS(uint id : SV_VertexID)\n"
+        "{\n"
+        "    VS_OUT output;\n"
+        "    output.uv = float2((id << 1) & 2, id & 2);\n"
+        "    output.pos = float4(output.uv * float2(2, -2) + float2(-1, 1), 0, 1);\n"
+        "    return output;\n"
+        "}\n"
+        "float4 PS(VS_OUT input) : SV_Target\n"
+        "{\n"
+        "    return scene.SampleLevel(linearClamp, min(input.uv * uvScale, uvMax), 0);\n"
+        "}\n";
+
+    struct UpscaleConstants
+    {
+        float   uvScale[2];
+        float   uvMax[2];
+    };
+
+    static_assert(DX::ConstantBufferMatches<UpscaleConstants>(c_upscaleShader, "UpscaleConstants",
+        DX_CONSTANT_MEMBER(UpscaleConstants, uvScale),
+        DX_CONSTANT_MEMBER(UpscaleConstants, uvMax)), "UpscaleConstants does not match its cbuffer");
+
+    DX::ShaderSource MakeUpscaleSource(const char* entryPoint, const char* target)
+    {
+        DX::ShaderSource source;
+        source.name = "DynamicResolutionUpscale";
+        source.source = c_upscaleShader;
+        source.entryPoint = entryPoint;
+        source.target = target;
+        return source;
+    }
+};
+
+DX::D3D11ScaledRenderTarget::D3D11ScaledRenderTarget(ID3D11Device* device, D3D11PipelineCache& pipelineCache,
+    DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat, uint32_t width, uint32_t height) :
+    m_width(width),
+    m_height(height),
+    m_renderWidth(width),
+    m_renderHeight(height)
+{
+    CD3D11_TEXTURE2D_DESC colorDesc(colorFormat, width, height, 1, 1, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+    ThrowIfFailed(device->CreateTexture2D(&colorDesc, nullptr, m_color.ReleaseAndGetAddressOf()));
+    ThrowIfFailed(device->CreateRenderTargetView(m_color.Get(), nullptr, m_renderTargetView.ReleaseAndGetAddressOf()));
+    ThrowIfFailed(device->CreateShaderResourceView(m_color.Get(), nullptr, m_shaderResourceView.ReleaseAndGetAddressOf()));
+    m_colorMemory.Track(MemoryCategory_RenderTargets, GetTextureBytes(colorDesc), "scaled scene color");
+
+    CD3D11_TEXTURE2D_DESC depthDesc(depthFormat, width, height, 1, 1, D3D11_BIND_DEPTH_STENCIL);
+    ThrowIfFailed(device->CreateTexture2D(&depthDesc, nullptr, m_depth.ReleaseAndGetAddressOf()));
+    CD3D11_DEPTH_STENCIL_VIEW_DESC depthViewDesc(D3D11_DSV_DIMENSION_TEXTURE2D);
+    ThrowIfFailed(device->CreateDepthStencilView(m_depth.Get(), &depthViewDesc, m_depthStencilView.ReleaseAndGetAddressOf()));
+    m_depthMemory.Track(MemoryCategory_RenderTargets, GetTextureBytes(depthDesc), "scaled scene depth");
+
+    CD3D11_BUFFER_DESC constantsDesc(sizeof(UpscaleConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+    ThrowIfFailed(device->CreateBuffer(&constantsDesc, nullptr, m_constants.ReleaseAndGetAddressOf()));
+
+    m_vertexShader = pipelineCache.GetVertexShader(MakeUpscaleSource("VS", "vs_4_0"));
+    m_pixelShader = pipelineCache.GetPixelShader(MakeUpscaleSource("PS", "ps_4_0"));
+
+    // The default sampler is trilinear with clamped addressing.
+    CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+    m_sampler = pipelineCache.GetSamplerState(samplerDesc);
+
+    CD3D11_DEPTH_STENCIL_DESC depthStateDesc(D3D11_DEFAULT);
+    depthStateDesc.DepthEnable = FALSE;
+    depthStateDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    m_depthDisabled = pipelineCache.GetDepthStencilState(depthStateDesc);
+}
+
+void DX::D3D11ScaledRenderTarget::Begin(ID3D11DeviceContext* context, uint32_t width, uint32_t height, const float clearColor[4])
+{
+    assert(width <= m_width && height <= m_height);
+    m_renderWidth = width;
+    m_renderHeight = height;
+
+    // Only the rendered corner is ever read back, so clearing the whole target is wasted
+    // bandwidth at low scales; D3D11.1 can clear just the rectangle.
+    ID3D11DeviceContext1* context1 = nullptr;
+    if (SUCCEEDED(context->QueryInterface(IID_PPV_ARGS(&context1))))
+    {
+        D3D11_RECT rect = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+        context1->ClearView(m_renderTargetView.Get(), clearColor, &rect, 1);
+        context1->Release();
+    }
+    else
+    {
+        context->ClearRenderTargetView(m_renderTargetView.Get(), clearColor);
+    }
+    context->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+
+    ID3D11RenderTargetView* renderTarget = m_renderTargetView.Get();
+    context->OMSetRenderTargets(1, &renderTarget, m_depthStencilView.Get());
+
+    CD3D11_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
+    context->RSSetViewports(1, &viewport);
+}
+
+void DX::D3D11ScaledRenderTarget::Upscale(ID3D11DeviceContext* context, ID3D11RenderTargetView* outputView, const D3D11_VIEWPORT& outputViewport)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    ThrowIfFailed(context->Map(m_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+    UpscaleConstants* constants = static_cast<UpscaleConstants*>(mapped.pData);
+    constants->uvScale[0] = static_cast<float>(m_renderWidth) / m_width;
+    constants->uvScale[1] = static_cast<float>(m_renderHeight) / m_height;
+    constants->uvMax[0] = (m_renderWidth - 0.5f) / m_width;
+    constants->uvMax[1] = (m_renderHeight - 0.5f) / m_height;
+    context->Unmap(m_constants.Get(), 0);
+
+    context->OMSetRenderTargets(1, &outputView, nullptr);
+    context->RSSetViewports(1, &outputViewport);
+    context->OMSetDepthStencilState(m_depthDisabled, 0);
+    context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+    context->RSSetState(nullptr);
+
+    context->IASetInputLayout(nullptr);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    context->VSSetShader(m_vertexShader, nullptr, 0);
+    context->PSSetShader(m_pixelShader, nullptr, 0);
+
+    ID3D11Buffer* constantBuffer = m_constants.Get();
+    ID3D11ShaderResourceView* scene = m_shaderResourceView.Get();
+    context->PSSetConstantBuffers(0, 1, &constantBuffer);
+    context->PSSetShaderResources(0, 1, &scene);
+    context->PSSetSamplers(0, 1, &m_sampler);
+
+    context->Draw(3, 0);
+
+    // The target is bound for output again next frame; it cannot stay bound as an input.
+    ID3D11ShaderResourceView* nullView = nullptr;
+    context->PSSetShaderResources(0, 1, &nullView);
+}
@@ -0,0 +1,62 @@
+//
+// D3D11DynamicResolution.h - Scaled scene render target and the upscale pass to the back buffer
+//
+
+#pragma once
+
+#include "D3D11PipelineCache.h"
+#include "DynamicResolution.h"
+#include "MemoryTracker.h"
+
+namespace DX
+{
+    // Colour and depth targets allocated once at the controller's largest render size; each
+    // frame renders into the top left corner at the current size, so a change of scale never
+    // reallocates anything. Upscale stretches that corner over the output with a bilinear
+    // filter. Recreate on resize and on device lost.
+    class D3D11ScaledRenderTarget
+    {
+    public:
+        D3D11ScaledRenderTarget(ID3D11Device* device, D3D11PipelineCache& pipelineCache,
+            DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat, uint32_t width, uint32_t height);
+
+        D3D11ScaledRenderTarget(const D3D11ScaledRenderTarget&) = delete;
+        D3D11ScaledRenderTarget& operator=(const D3D11ScaledRenderTarget&) = delete;
+
+        // Clears and binds the targets with a viewport of the given size, which must fit the
+        // allocation.
+        void Begin(ID3D11DeviceContext* context, uint32_t width, uint32_t height, const float clearColor[4]);
+
+        // Draws the last Begin's region over outputView, filling outputViewport. Leaves
+        // outputView bound.
+        void Upscale(ID3D11DeviceContext* context, ID3D11RenderTargetView* outputView, const D3D11_VIEWPORT& outputViewport);
+
+        uint32_t GetWidth() const                                   { return m_width; }
+        uint32_t GetHeight() const                                  { return m_height; }
+        ID3D11RenderTargetView* GetRenderTargetView() const         { return m_renderTargetView.Get(); }
+        ID3D11DepthStencilView* GetDepthStencilView() const         { return m_depthStencilView.Get(); }
+        ID3D11ShaderResourceView* GetShaderResourceView() const     { return m_shaderResourceView.Get(); }
+
+    private:
+        uint32_t                                            m_width;
+        uint32_t                                            m_height;
+        uint32_t                                            m_renderWidth;
+        uint32_t                                            m_renderHeight;
+
+        Microsoft::WRL::ComPtr<ID3D11Texture2D>             m_color;
+        Microsoft::WRL::ComPtr<ID3D11RenderTargetView>      m_renderTargetView;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_shaderResourceView;
+        Microsoft::WRL::ComPtr<ID3D11Texture2D>             m_depth;
+        Microsoft::WRL::ComPtr<ID3D11DepthStencilView>      m_depthStencilView;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>                m_constants;
+
+        // Owned by the pipeline cache.
+        ID3D11VertexShader*                                 m_vertexShader;
+        ID3D11PixelShader*                                  m_pixelShader;
+        ID3D11SamplerState*                                 m_sampler;
+        ID3D11DepthStencilState*                            m_depthDisabled;
+
+        TrackedMemory                                       m_colorMemory;
+        TrackedMemory                                       m_depthMemory;
+    };
+}
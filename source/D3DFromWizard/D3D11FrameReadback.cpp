@@ -0,0 +1,117 @@
+//
+// D3D11FrameReadback.cpp - Reads rendered frames back through a ring of staging textures
+//
+
+#include "pch.h"
+#include "D3D11FrameReadback.h"
+#include "DeviceResources.h"
+
+namespace
+{
+    bool GetPixelFormat(DXGI_FORMAT format, DX::PixelFormat& pixelFormat)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            pixelFormat = DX::PixelFormat_Bgra8;
+            return true;
+
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            pixelFormat = DX::PixelFormat_Rgba8;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+};
+
+DX::D3D11FrameReadback::D3D11FrameReadback() :
+    m_first(0),
+    m_pendingCount(0),
+    m_desc{},
+    m_format(PixelFormat_Bgra8),
+    m_skipped(0)
+{
+}
+
+void DX::D3D11FrameReadback::Capture(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* source)
+{
+    D3D11_TEXTURE2D_DESC sourceDesc;
+    source->GetDesc(&sourceDesc);
+
+    PixelFormat format;
+    if (!GetPixelFormat(sourceDesc.Format, format) || sourceDesc.SampleDesc.Count != 1)
+    {
+        m_skipped++;
+        return;
+    }
+
+    if (sourceDesc.Width != m_desc.Width || sourceDesc.Height != m_desc.Height || sourceDesc.Format != m_desc.Format)
+    {
+        // Copies of the old size are still useful; only recreate once they have been read.
+        if (m_pendingCount > 0)
+        {
+            m_skipped++;
+            return;
+        }
+        CreateTextures(device, sourceDesc);
+        m_format = format;
+    }
+
+    if (m_pendingCount == c_frameCount)
+    {
+        m_skipped++;
+        return;
+    }
+
+    ID3D11Texture2D* texture = m_textures[(m_first + m_pendingCount) % c_frameCount].Get();
+    context->CopySubresourceRegion(texture, 0, 0, 0, 0, source, 0, nullptr);
+    m_pendingCount++;
+}
+
+void DX::D3D11FrameReadback::Collect(ID3D11DeviceContext* context, FrameCapture& capture, bool wait)
+{
+    while (m_pendingCount > 0)
+    {
+        ID3D11Texture2D* texture = m_textures[m_first].Get();
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = context->Map(texture, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            // Copies finish in order, so nothing after this one is ready either.
+            return;
+        }
+        ThrowIfFailed(hr);
+
+        capture.SubmitPixels(mapped.pData, m_desc.Width, m_desc.Height, mapped.RowPitch, m_format);
+        context->Unmap(texture, 0);
+
+        m_first = (m_first + 1) % c_frameCount;
+        m_pendingCount--;
+    }
+}
+
+void DX::D3D11FrameReadback::CreateTextures(ID3D11Device* device, const D3D11_TEXTURE2D_DESC& sourceDesc)
+{
+    m_desc = sourceDesc;
+    m_desc.MipLevels = 1;
+    m_desc.ArraySize = 1;
+    m_desc.Usage = D3D11_USAGE_STAGING;
+    m_desc.BindFlags = 0;
+    m_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    m_desc.MiscFlags = 0;
+
+    for (auto& texture : m_textures)
+    {
+        ThrowIfFailed(device->CreateTexture2D(&m_desc, nullptr, texture.ReleaseAndGetAddressOf()));
+    }
+    m_first = 0;
+
+    m_memory.Track(MemoryCategory_RenderTargets, GetTextureBytes(m_desc) * c_frameCount, "capture staging");
+}
@@ -0,0 +1,50 @@
+//
+// D3D11FrameReadback.h - Reads rendered frames back through a ring of staging textures
+//
+
+#pragma once
+
+#include "FrameCapture.h"
+#include "MemoryTracker.h"
+
+namespace DX
+{
+    // Capture copies a frame into the next free staging texture; Collect maps the oldest ones
+    // whose copies have finished, with DO_NOT_WAIT, and hands the mapped rows straight to a
+    // FrameCapture. A frame is usually collected c_frameCount - 1 frames after it was copied,
+    // so neither the CPU nor the GPU waits for the other. When every texture is still in
+    // flight the frame is skipped, not waited for.
+    //
+    // Only 8-bit RGBA and BGRA single-sample sources are read; anything else is skipped.
+    // Recreate on device lost.
+    class D3D11FrameReadback
+    {
+    public:
+        static const uint32_t c_frameCount = 4;
+
+        D3D11FrameReadback();
+
+        D3D11FrameReadback(const D3D11FrameReadback&) = delete;
+        D3D11FrameReadback& operator=(const D3D11FrameReadback&) = delete;
+
+        // Queues a copy of source. The staging textures follow its size and format.
+        void Capture(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* source);
+
+        // Submits every finished copy to capture, oldest first. With wait set it blocks until
+        // all queued copies are done, which is for the end of a capture.
+        void Collect(ID3D11DeviceContext* context, FrameCapture& capture, bool wait = false);
+
+        uint64_t GetSkippedFrames() const   { return m_skipped; }
+
+    private:
+        void CreateTextures(ID3D11Device* device, const D3D11_TEXTURE2D_DESC& sourceDesc);
+
+        Microsoft::WRL::ComPtr<ID3D11Texture2D>     m_textures[c_frameCount];
+        uint32_t                                    m_first;            // Oldest pending copy.
+        uint32_t                                    m_pendingCount;
+        D3D11_TEXTURE2D_DESC                        m_desc;
+        PixelFormat                                 m_format;
+        uint64_t                                    m_skipped;
+        TrackedMemory                               m_memory;
+    };
+}
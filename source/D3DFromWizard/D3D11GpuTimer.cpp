@@ -0,0 +1,137 @@
+//
+// D3D11GpuTimer.cpp - GPU scope timing with D3D11 timestamp queries
+//
+
+#include "pch.h"
+#include "D3D11GpuTimer.h"
+
+using Microsoft::WRL::ComPtr;
+
+DX::D3D11GpuTimer::D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context) :
+    m_context(context),
+    m_write(0),
+    m_read(0),
+    m_recording(false),
+    m_dropped(0)
+{
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+
+    for (Frame& frame : m_frames)
+    {
+        ThrowIfFailed(device->CreateQuery(&disjointDesc, frame.disjoint.ReleaseAndGetAddressOf()));
+        for (uint32_t i = 0; i < c_maxGpuTimerScopesPerFrame; ++i)
+        {
+            ThrowIfFailed(device->CreateQuery(&timestampDesc, frame.begin[i].ReleaseAndGetAddressOf()));
+            ThrowIfFailed(device->CreateQuery(&timestampDesc, frame.end[i].ReleaseAndGetAddressOf()));
+        }
+        frame.count = 0;
+        frame.pending = false;
+    }
+}
+
+void DX::D3D11GpuTimer::BeginFrame()
+{
+    m_open.clear();
+
+    Frame& frame = m_frames[m_write];
+    if (frame.pending)
+    {
+        // The GPU is more than c_frameCount frames behind; skip rather than wait for it.
+        m_recording = false;
+        m_dropped++;
+        return;
+    }
+
+    m_context->Begin(frame.disjoint.Get());
+    frame.count = 0;
+    m_recording = true;
+}
+
+void DX::D3D11GpuTimer::EndFrame()
+{
+    assert(m_open.empty());
+
+    if (!m_recording)
+    {
+        return;
+    }
+
+    Frame& frame = m_frames[m_write];
+    m_context->End(frame.disjoint.Get());
+    frame.pending = true;
+
+    m_write = (m_write + 1) % c_frameCount;
+    m_recording = false;
+}
+
+void DX::D3D11GpuTimer::BeginScope(uint32_t scope)
+{
+    Frame& frame = m_frames[m_write];
+    if (!m_recording || frame.count == c_maxGpuTimerScopesPerFrame)
+    {
+        m_open.push_back(c_untimed);
+        return;
+    }
+
+    uint32_t occurrence = frame.count++;
+    frame.scopes[occurrence] = scope;
+    m_context->End(frame.begin[occurrence].Get());
+    m_open.push_back(occurrence);
+}
+
+void DX::D3D11GpuTimer::EndScope(uint32_t scope)
+{
+    assert(!m_open.empty());
+
+    uint32_t occurrence = m_open.back();
+    m_open.pop_back();
+
+    if (occurrence != c_untimed)
+    {
+        Frame& frame = m_frames[m_write];
+        assert(frame.scopes[occurrence] == scope);
+        UNREFERENCED_PARAMETER(scope);
+        m_context->End(frame.end[occurrence].Get());
+    }
+}
+
+void DX::D3D11GpuTimer::CollectResults(FrameTelemetry& telemetry)
+{
+    // Frames finish in submission order, so stop at the first one that is not ready.
+    while (m_frames[m_read].pending)
+    {
+        Frame& frame = m_frames[m_read];
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        if (m_context->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        {
+            break;
+        }
+
+        // A disjoint frame (clock change, power event) has meaningless timestamps.
+        if (disjoint.Disjoint || disjoint.Frequency == 0)
+        {
+            m_dropped++;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < frame.count; ++i)
+            {
+                UINT64 begin, end;
+                if (m_context->GetData(frame.begin[i].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                    m_context->GetData(frame.end[i].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                    end < begin)
+                {
+                    continue;
+                }
+
+                double nanoseconds = static_cast<double>(end - begin) * 1e9 / static_cast<double>(disjoint.Frequency);
+                telemetry.RecordScope(frame.scopes[i], TelemetryDomain_Gpu, static_cast<uint64_t>(nanoseconds));
+            }
+        }
+
+        frame.pending = false;
+        m_read = (m_read + 1) % c_frameCount;
+    }
+}
@@ -0,0 +1,54 @@
+//
+// D3D11GpuTimer.h - GPU scope timing with D3D11 timestamp queries
+//
+
+#pragma once
+
+#include "GpuTimer.h"
+
+namespace DX
+{
+    // A ring of c_gpuTimerLatency + 1 frames of queries: a TIMESTAMP_DISJOINT query around
+    // each frame and a pair of TIMESTAMP queries around each scope. Results are fetched with
+    // D3D11_ASYNC_GETDATA_DONOTFLUSH and only once the frame's disjoint query is ready, so
+    // the CPU never waits on the GPU. If every slot is still in flight the frame is not timed.
+    // Recreate on device lost.
+    class D3D11GpuTimer : public IGpuTimer
+    {
+    public:
+        D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context);
+
+        virtual void BeginFrame() override;
+        virtual void EndFrame() override;
+        virtual void BeginScope(uint32_t scope) override;
+        virtual void EndScope(uint32_t scope) override;
+        virtual void CollectResults(FrameTelemetry& telemetry) override;
+        virtual uint64_t GetDroppedFrames() const override     { return m_dropped; }
+        virtual bool IsEmulated() const override                { return false; }
+
+    private:
+        static const uint32_t c_frameCount = c_gpuTimerLatency + 1;
+        static const uint32_t c_untimed = UINT32_MAX;
+
+        struct Frame
+        {
+            Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+            Microsoft::WRL::ComPtr<ID3D11Query> begin[c_maxGpuTimerScopesPerFrame];
+            Microsoft::WRL::ComPtr<ID3D11Query> end[c_maxGpuTimerScopesPerFrame];
+            uint32_t                            scopes[c_maxGpuTimerScopesPerFrame];
+            uint32_t                            count;
+            bool                                pending;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+
+        Frame                   m_frames[c_frameCount];
+        uint32_t                m_write;        // Slot of the frame being recorded.
+        uint32_t                m_read;         // Oldest slot that may be pending.
+        bool                    m_recording;
+
+        // Occurrence index of each open scope, or c_untimed.
+        std::vector<uint32_t>   m_open;
+        uint64_t                m_dropped;
+    };
+}
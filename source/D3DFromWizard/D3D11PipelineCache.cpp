@@ -0,0 +1,337 @@
+//
+// D3D11PipelineCache.cpp - Deduplicates shader and state objects created from the shader cache
+//
+
+#include "pch.h"
+#include "D3D11PipelineCache.h"
+#include "FileWatcher.h"
+#include "Hash.h"
+
+#include <d3dcompiler.h>
+#include <winver.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Resolves #include the way D3D_COMPILE_STANDARD_FILE_INCLUDE does, relative to the file
+    // that includes it, and records every file it opens so the shader cache can key on their
+    // contents. The files stay loaded until the compile is over.
+    class RecordingInclude : public ID3DInclude
+    {
+    public:
+        RecordingInclude(const std::string& sourceName, std::vector<DX::ShaderInclude>& includes) :
+            m_sourceName(sourceName),
+            m_includes(includes)
+        {
+        }
+
+        HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+        {
+            std::string path = fileName;
+            if (path.empty() || (path[0] != '/' && path[0] != '\\' && path.find(':') == std::string::npos))
+            {
+                auto parent = m_paths.find(parentData);
+                const std::string& including = parent != m_paths.end() ? parent->second : m_sourceName;
+                size_t separator = including.find_last_of("/\\");
+                path = (separator == std::string::npos ? std::string() : including.substr(0, separator + 1)) + path;
+            }
+            path = DX::NormalizePath(path);
+
+            FILE* file = nullptr;
+            if (fopen_s(&file, path.c_str(), "rb") != 0 || !file)
+            {
+                return E_FAIL;
+            }
+
+            auto contents = std::make_unique<std::vector<char>>();
+            char buffer[4096];
+            size_t read;
+            while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            {
+                contents->insert(contents->end(), buffer, buffer + read);
+            }
+            fclose(file);
+
+            // Compilers treat a null pointer as failure, so empty files get a valid one.
+            contents->push_back('\0');
+            *data = contents->data();
+            *bytes = static_cast<UINT>(contents->size() - 1);
+
+            bool recorded = false;
+            for (const DX::ShaderInclude& include : m_includes)
+            {
+                recorded |= include.path == path;
+            }
+            if (!recorded)
+            {
+                m_includes.push_back(DX::ShaderInclude{ path, DX::HashBytes(contents->data(), contents->size() - 1) });
+            }
+
+            m_paths[*data] = path;
+            m_files.push_back(std::move(contents));
+            return S_OK;
+        }
+
+        HRESULT __stdcall Close(LPCVOID) override
+        {
+            return S_OK;
+        }
+
+    private:
+        const std::string&                              m_sourceName;
+        std::vector<DX::ShaderInclude>&                 m_includes;
+        std::unordered_map<LPCVOID, std::string>        m_paths;
+        std::vector<std::unique_ptr<std::vector<char>>> m_files;
+    };
+};
+
+DX::D3D11PipelineCache::D3D11PipelineCache(ID3D11Device* device, ShaderCache& shaderCache) :
+    m_device(device),
+    m_shaderCache(shaderCache),
+    m_statistics{}
+{
+}
+
+// Shader lookups drop the lock while compiling and creating, so a hot reload on the worker
+// thread never stalls the main thread. If two threads race on one key the first insert wins.
+ID3D11VertexShader* DX::D3D11PipelineCache::GetVertexShader(const ShaderSource& source)
+{
+    uint64_t key = m_shaderCache.ComputeKey(source);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_vertexShaders.find(key);
+        if (it != m_vertexShaders.end())
+        {
+            m_statistics.hits++;
+            return it->second.Get();
+        }
+
+        m_statistics.misses++;
+    }
+
+    ShaderBytecode bytecode = m_shaderCache.GetBytecode(source);
+
+    ComPtr<ID3D11VertexShader> shader;
+    DX::ThrowIfFailed(m_device->CreateVertexShader(bytecode.data, bytecode.size, nullptr, shader.GetAddressOf()));
+
+    // A first compile can find includes the key did not cover yet.
+    key = m_shaderCache.ComputeKey(source);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_vertexShaders.emplace(key, shader).first->second.Get();
+}
+
+ID3D11PixelShader* DX::D3D11PipelineCache::GetPixelShader(const ShaderSource& source)
+{
+    uint64_t key = m_shaderCache.ComputeKey(source);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pixelShaders.find(key);
+        if (it != m_pixelShaders.end())
+        {
+            m_statistics.hits++;
+            return it->second.Get();
+        }
+
+        m_statistics.misses++;
+    }
+
+    ShaderBytecode bytecode = m_shaderCache.GetBytecode(source);
+
+    ComPtr<ID3D11PixelShader> shader;
+    DX::ThrowIfFailed(m_device->CreatePixelShader(bytecode.data, bytecode.size, nullptr, shader.GetAddressOf()));
+
+    // A first compile can find includes the key did not cover yet.
+    key = m_shaderCache.ComputeKey(source);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pixelShaders.emplace(key, shader).first->second.Get();
+}
+
+ID3D11InputLayout* DX::D3D11PipelineCache::GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const ShaderSource& vertexShader)
+{
+    // Semantic names are pointers, so hash their contents rather than the structs.
+    auto computeKey = [&]()
+    {
+        uint64_t key = m_shaderCache.ComputeKey(vertexShader);
+        for (UINT i = 0; i < elementCount; ++i)
+        {
+            const D3D11_INPUT_ELEMENT_DESC& element = elements[i];
+            key = HashString(element.SemanticName, key);
+            key = HashValue(element.SemanticIndex, key);
+            key = HashValue(element.Format, key);
+            key = HashValue(element.InputSlot, key);
+            key = HashValue(element.AlignedByteOffset, key);
+            key = HashValue(element.InputSlotClass, key);
+            key = HashValue(element.InstanceDataStepRate, key);
+        }
+        return key;
+    };
+    uint64_t key = computeKey();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_inputLayouts.find(key);
+        if (it != m_inputLayouts.end())
+        {
+            m_statistics.hits++;
+            return it->second.Get();
+        }
+
+        m_statistics.misses++;
+    }
+
+    ShaderBytecode bytecode = m_shaderCache.GetBytecode(vertexShader);
+
+    ComPtr<ID3D11InputLayout> inputLayout;
+    DX::ThrowIfFailed(m_device->CreateInputLayout(elements, elementCount, bytecode.data, bytecode.size, inputLayout.GetAddressOf()));
+
+    key = computeKey();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inputLayouts.emplace(key, inputLayout).first->second.Get();
+}
+
+// State descriptions are plain data, so a bytewise comparison identifies them exactly.
+// Callers should zero-initialize descriptions so padding does not defeat the match.
+// State objects are cheap to create, so the lock is simply held throughout.
+template<typename TDesc, typename TObject, typename TCreate>
+TObject* DX::D3D11PipelineCache::GetState(std::vector<StateEntry<TDesc, TObject>>& entries, const TDesc& desc, TCreate create)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : entries)
+    {
+        if (memcmp(&entry.desc, &desc, sizeof(TDesc)) == 0)
+        {
+            m_statistics.hits++;
+            return entry.object.Get();
+        }
+    }
+
+    m_statistics.misses++;
+
+    StateEntry<TDesc, TObject> entry;
+    entry.desc = desc;
+    DX::ThrowIfFailed(create(&desc, entry.object.GetAddressOf()));
+
+    entries.push_back(entry);
+    return entries.back().object.Get();
+}
+
+ID3D11BlendState* DX::D3D11PipelineCache::GetBlendState(const D3D11_BLEND_DESC& desc)
+{
+    return GetState(m_blendStates, desc, [&](const D3D11_BLEND_DESC* d, ID3D11BlendState** state)
+    {
+        return m_device->CreateBlendState(d, state);
+    });
+}
+
+ID3D11DepthStencilState* DX::D3D11PipelineCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    return GetState(m_depthStencilStates, desc, [&](const D3D11_DEPTH_STENCIL_DESC* d, ID3D11DepthStencilState** state)
+    {
+        return m_device->CreateDepthStencilState(d, state);
+    });
+}
+
+ID3D11RasterizerState* DX::D3D11PipelineCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+    return GetState(m_rasterizerStates, desc, [&](const D3D11_RASTERIZER_DESC* d, ID3D11RasterizerState** state)
+    {
+        return m_device->CreateRasterizerState(d, state);
+    });
+}
+
+ID3D11SamplerState* DX::D3D11PipelineCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+    return GetState(m_samplerStates, desc, [&](const D3D11_SAMPLER_DESC* d, ID3D11SamplerState** state)
+    {
+        return m_device->CreateSamplerState(d, state);
+    });
+}
+
+void DX::D3D11PipelineCache::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vertexShaders.clear();
+    m_pixelShaders.clear();
+    m_inputLayouts.clear();
+    m_blendStates.clear();
+    m_depthStencilStates.clear();
+    m_rasterizerStates.clear();
+    m_samplerStates.clear();
+}
+
+DX::ShaderCompileFunction DX::GetD3DShaderCompiler()
+{
+    return [](const ShaderSource& source, std::vector<uint8_t>& bytecode, std::vector<ShaderInclude>& includes, std::string& errors) -> bool
+    {
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (const ShaderMacro& macro : source.macros)
+        {
+            macros.push_back(D3D_SHADER_MACRO{ macro.name.c_str(), macro.definition.c_str() });
+        }
+        macros.push_back(D3D_SHADER_MACRO{ nullptr, nullptr });
+
+        RecordingInclude includeHandler(source.name, includes);
+
+        ComPtr<ID3DBlob> code;
+        ComPtr<ID3DBlob> messages;
+        HRESULT hr = D3DCompile(
+            source.source.data(),
+            source.source.size(),
+            source.name.c_str(),
+            macros.data(),
+            &includeHandler,
+            source.entryPoint.c_str(),
+            source.target.c_str(),
+            source.flags,
+            0,
+            code.GetAddressOf(),
+            messages.GetAddressOf());
+
+        if (messages)
+        {
+            errors.assign(static_cast<const char*>(messages->GetBufferPointer()), messages->GetBufferSize());
+        }
+
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(code->GetBufferPointer());
+        bytecode.assign(data, data + code->GetBufferSize());
+        return true;
+    };
+}
+
+// The file version of the compiler DLL this process loaded, which can be newer or older than
+// the headers the game was built against. Falls back to the headers' version if the DLL has
+// no version resource.
+uint64_t DX::GetD3DShaderCompilerId()
+{
+    uint64_t version = D3D_COMPILER_VERSION;
+
+    char path[MAX_PATH] = {};
+    HMODULE module = GetModuleHandleA(D3DCOMPILER_DLL_A);
+    DWORD handle = 0;
+    DWORD infoSize = module && GetModuleFileNameA(module, path, MAX_PATH) ? GetFileVersionInfoSizeA(path, &handle) : 0;
+    if (infoSize > 0)
+    {
+        std::vector<uint8_t> info(infoSize);
+        VS_FIXEDFILEINFO* fileInfo = nullptr;
+        UINT fileInfoSize = 0;
+        if (GetFileVersionInfoA(path, 0, infoSize, info.data())
+            && VerQueryValueA(info.data(), "\\", reinterpret_cast<void**>(&fileInfo), &fileInfoSize)
+            && fileInfoSize >= sizeof(VS_FIXEDFILEINFO))
+        {
+            version = (uint64_t(fileInfo->dwFileVersionMS) << 32) | fileInfo->dwFileVersionLS;
+        }
+    }
+
+    return HashString(D3DCOMPILER_DLL_A, HashValue(version));
+}
@@ -0,0 +1,73 @@
+//
+// D3D11PipelineCache.h - Deduplicates shader and state objects created from the shader cache
+//
+
+#pragma once
+
+#include "ShaderCache.h"
+
+#include <mutex>
+
+namespace DX
+{
+    struct PipelineCacheStatistics
+    {
+        uint32_t hits;
+        uint32_t misses;
+    };
+
+    // Direct3D 11 has no serializable pipeline state objects, so this caches the individual
+    // objects in memory: shaders by the shader cache's content key, input layouts by shader and
+    // element description, and fixed-function states by description. The bytecode behind the
+    // shaders is what gets persisted, through the ShaderCache. Lookups are thread safe.
+    class D3D11PipelineCache
+    {
+    public:
+        D3D11PipelineCache(ID3D11Device* device, ShaderCache& shaderCache);
+
+        ID3D11VertexShader* GetVertexShader(const ShaderSource& source);
+        ID3D11PixelShader* GetPixelShader(const ShaderSource& source);
+        ID3D11InputLayout* GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const ShaderSource& vertexShader);
+
+        ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& desc);
+        ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+        ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+        ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+        // Releases every cached object; required before the device goes away.
+        void Reset();
+
+        const PipelineCacheStatistics& GetStatistics() const   { return m_statistics; }
+
+    private:
+        template<typename TDesc, typename TObject>
+        struct StateEntry
+        {
+            TDesc                                   desc;
+            Microsoft::WRL::ComPtr<TObject>         object;
+        };
+
+        template<typename TDesc, typename TObject, typename TCreate>
+        TObject* GetState(std::vector<StateEntry<TDesc, TObject>>& entries, const TDesc& desc, TCreate create);
+
+        ID3D11Device*                                                           m_device;
+        ShaderCache&                                                            m_shaderCache;
+
+        std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D11VertexShader>> m_vertexShaders;
+        std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D11PixelShader>>  m_pixelShaders;
+        std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D11InputLayout>>  m_inputLayouts;
+
+        std::vector<StateEntry<D3D11_BLEND_DESC, ID3D11BlendState>>                 m_blendStates;
+        std::vector<StateEntry<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState>>  m_depthStencilStates;
+        std::vector<StateEntry<D3D11_RASTERIZER_DESC, ID3D11RasterizerState>>       m_rasterizerStates;
+        std::vector<StateEntry<D3D11_SAMPLER_DESC, ID3D11SamplerState>>             m_samplerStates;
+
+        PipelineCacheStatistics                                                 m_statistics;
+        std::mutex                                                              m_mutex;
+    };
+
+    // A ShaderCompileFunction backed by D3DCompile, and the id that ties cache files to the
+    // d3dcompiler DLL loaded at run time (version.lib).
+    ShaderCompileFunction GetD3DShaderCompiler();
+    uint64_t GetD3DShaderCompilerId();
+}
@@ -0,0 +1,122 @@
+//
+// D3D11ResourceDevice.cpp - Creates immutable D3D11 buffers and textures for the resource registry
+//
+
+#include "pch.h"
+#include "D3D11ResourceDevice.h"
+#include "DeviceResources.h"
+#include "MemoryTracker.h"
+
+using Microsoft::WRL::ComPtr;
+
+DX::D3D11ResourceDevice::D3D11ResourceDevice(ID3D11Device* device) :
+    m_device(device)
+{
+}
+
+DX::D3D11ResourceDevice::~D3D11ResourceDevice()
+{
+    for (size_t i = 0; i < m_resources.size(); ++i)
+    {
+        if (m_resources[i].buffer || m_resources[i].texture)
+        {
+            ReleaseResource(static_cast<ResourceHandle>(i + 1));
+        }
+    }
+}
+
+ID3D11Buffer* DX::D3D11ResourceDevice::GetBuffer(ResourceHandle handle) const
+{
+    const Resource* resource = Find(handle);
+    return resource ? resource->buffer.Get() : nullptr;
+}
+
+ID3D11Texture2D* DX::D3D11ResourceDevice::GetTexture(ResourceHandle handle) const
+{
+    const Resource* resource = Find(handle);
+    return resource ? resource->texture.Get() : nullptr;
+}
+
+ID3D11ShaderResourceView* DX::D3D11ResourceDevice::GetShaderResourceView(ResourceHandle handle) const
+{
+    const Resource* resource = Find(handle);
+    return resource ? resource->shaderResourceView.Get() : nullptr;
+}
+
+void DX::D3D11ResourceDevice::CreateResource(ResourceHandle handle, const ResourceDesc& desc, const ResourceSubresource* subresources, uint32_t subresourceCount)
+{
+    assert(handle != 0);
+
+    if (m_resources.size() < handle)
+    {
+        m_resources.resize(handle);
+    }
+
+    Resource& resource = m_resources[handle - 1];
+    assert(!resource.buffer && !resource.texture);
+
+    // Texture arrays can have more subresources than a single chain's mips.
+    D3D11_SUBRESOURCE_DATA chainData[D3D11_REQ_MIP_LEVELS];
+    std::vector<D3D11_SUBRESOURCE_DATA> arrayData;
+    D3D11_SUBRESOURCE_DATA* initialData = chainData;
+    if (subresourceCount > _countof(chainData))
+    {
+        arrayData.resize(subresourceCount);
+        initialData = arrayData.data();
+    }
+
+    for (uint32_t i = 0; i < subresourceCount; ++i)
+    {
+        initialData[i].pSysMem = subresources[i].data;
+        initialData[i].SysMemPitch = subresources[i].rowPitch;
+        initialData[i].SysMemSlicePitch = subresources[i].slicePitch;
+    }
+
+    if (desc.type == ResourceType_Buffer)
+    {
+        CD3D11_BUFFER_DESC bufferDesc(desc.byteWidth, desc.bindFlags, D3D11_USAGE_IMMUTABLE, 0,
+            desc.structureStride ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : 0, desc.structureStride);
+        ThrowIfFailed(m_device->CreateBuffer(&bufferDesc, initialData, resource.buffer.ReleaseAndGetAddressOf()));
+
+        if (desc.structureStride && (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE))
+        {
+            CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(resource.buffer.Get(), DXGI_FORMAT_UNKNOWN, 0, desc.byteWidth / desc.structureStride);
+            ThrowIfFailed(m_device->CreateShaderResourceView(resource.buffer.Get(), &viewDesc, resource.shaderResourceView.ReleaseAndGetAddressOf()));
+        }
+
+        resource.bytes = desc.byteWidth;
+        GetMemoryTracker().Allocate(MemoryCategory_DeviceBuffers, resource.bytes);
+    }
+    else
+    {
+        CD3D11_TEXTURE2D_DESC textureDesc(static_cast<DXGI_FORMAT>(desc.format), desc.width, desc.height,
+            desc.GetSliceCount(), desc.GetMipCount(), desc.bindFlags, D3D11_USAGE_IMMUTABLE);
+        ThrowIfFailed(m_device->CreateTexture2D(&textureDesc, initialData, resource.texture.ReleaseAndGetAddressOf()));
+
+        if (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE)
+        {
+            // An array of one slice still needs an array view for Texture2DArray in a shader.
+            CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(resource.texture.Get(),
+                desc.arraySize > 0 ? D3D11_SRV_DIMENSION_TEXTURE2DARRAY : D3D11_SRV_DIMENSION_TEXTURE2D);
+            ThrowIfFailed(m_device->CreateShaderResourceView(resource.texture.Get(), &viewDesc, resource.shaderResourceView.ReleaseAndGetAddressOf()));
+        }
+
+        resource.bytes = GetTextureBytes(textureDesc);
+        GetMemoryTracker().Allocate(MemoryCategory_DeviceTextures, resource.bytes);
+    }
+}
+
+void DX::D3D11ResourceDevice::ReleaseResource(ResourceHandle handle)
+{
+    assert(handle != 0 && handle <= m_resources.size());
+
+    Resource& resource = m_resources[handle - 1];
+    GetMemoryTracker().Free(resource.buffer ? MemoryCategory_DeviceBuffers : MemoryCategory_DeviceTextures, resource.bytes);
+
+    resource = Resource();
+}
+
+const DX::D3D11ResourceDevice::Resource* DX::D3D11ResourceDevice::Find(ResourceHandle handle) const
+{
+    return handle != 0 && handle <= m_resources.size() ? &m_resources[handle - 1] : nullptr;
+}
@@ -0,0 +1,45 @@
+//
+// D3D11ResourceDevice.h - Creates immutable D3D11 buffers and textures for the resource registry
+//
+
+#pragma once
+
+#include "ResourceRegistry.h"
+
+namespace DX
+{
+    // Owns the device objects behind registry handles. Recreate it, and call the registry's
+    // OnDeviceLost, whenever the device is lost.
+    class D3D11ResourceDevice : public IResourceDevice
+    {
+    public:
+        D3D11ResourceDevice(ID3D11Device* device);
+        ~D3D11ResourceDevice();
+
+        D3D11ResourceDevice(const D3D11ResourceDevice&) = delete;
+        D3D11ResourceDevice& operator=(const D3D11ResourceDevice&) = delete;
+
+        // Null until the handle has been uploaded.
+        ID3D11Buffer* GetBuffer(ResourceHandle handle) const;
+        ID3D11Texture2D* GetTexture(ResourceHandle handle) const;
+        ID3D11ShaderResourceView* GetShaderResourceView(ResourceHandle handle) const;
+
+        // IResourceDevice
+        virtual void CreateResource(ResourceHandle handle, const ResourceDesc& desc, const ResourceSubresource* subresources, uint32_t subresourceCount) override;
+        virtual void ReleaseResource(ResourceHandle handle) override;
+
+    private:
+        struct Resource
+        {
+            Microsoft::WRL::ComPtr<ID3D11Buffer>                buffer;
+            Microsoft::WRL::ComPtr<ID3D11Texture2D>             texture;
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    shaderResourceView;
+            uint64_t                                            bytes;
+        };
+
+        const Resource* Find(ResourceHandle handle) const;
+
+        Microsoft::WRL::ComPtr<ID3D11Device>    m_device;
+        std::vector<Resource>                   m_resources;    // Handle - 1.
+    };
+}
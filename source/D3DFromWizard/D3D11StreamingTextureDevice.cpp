@@ -0,0 +1,86 @@
+//
+// D3D11StreamingTextureDevice.cpp - Recreates D3D11 textures at their resident mips for the texture streamer
+//
+
+#include "pch.h"
+#include "D3D11StreamingTextureDevice.h"
+#include "DeviceResources.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    inline uint32_t MipSize(uint32_t size, uint32_t mip)
+    {
+        return std::max<uint32_t>(size >> mip, 1);
+    }
+};
+
+DX::D3D11StreamingTextureDevice::D3D11StreamingTextureDevice(ID3D11Device* device, ID3D11DeviceContext* context) :
+    m_device(device),
+    m_context(context)
+{
+}
+
+ID3D11ShaderResourceView* DX::D3D11StreamingTextureDevice::GetShaderResourceView(uint32_t texture) const
+{
+    return texture < m_textures.size() ? m_textures[texture].shaderResourceView.Get() : nullptr;
+}
+
+void DX::D3D11StreamingTextureDevice::UpdateTexture(uint32_t texture, const TexturePackEntry& entry, uint32_t firstMip,
+    const uint8_t* newMips, uint32_t newMipCount)
+{
+    assert(firstMip + newMipCount <= entry.mipCount);
+
+    if (m_textures.size() <= texture)
+    {
+        m_textures.resize(texture + 1);
+    }
+
+    Texture& current = m_textures[texture];
+    const uint32_t mipCount = entry.mipCount - firstMip;
+
+    CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT_R8G8B8A8_UNORM, MipSize(entry.width, firstMip), MipSize(entry.height, firstMip),
+        1, mipCount, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT);
+
+    // A whole chain, as tails are, is created with its data; otherwise the new mips are
+    // uploaded and the rest copied over.
+    D3D11_SUBRESOURCE_DATA initialData[D3D11_REQ_MIP_LEVELS];
+    const uint8_t* data = newMips;
+    for (uint32_t mip = 0; mip < newMipCount; ++mip)
+    {
+        uint32_t width = MipSize(entry.width, firstMip + mip);
+        uint32_t height = MipSize(entry.height, firstMip + mip);
+        initialData[mip].pSysMem = data;
+        initialData[mip].SysMemPitch = width * 4;
+        initialData[mip].SysMemSlicePitch = width * height * 4;
+        data += size_t(width) * height * 4;
+    }
+
+    ComPtr<ID3D11Texture2D> replacement;
+    ThrowIfFailed(m_device->CreateTexture2D(&textureDesc, newMipCount == mipCount ? initialData : nullptr, replacement.GetAddressOf()));
+
+    if (newMipCount < mipCount)
+    {
+        for (uint32_t mip = 0; mip < newMipCount; ++mip)
+        {
+            m_context->UpdateSubresource(replacement.Get(), mip, nullptr, initialData[mip].pSysMem, initialData[mip].SysMemPitch, 0);
+        }
+
+        assert(current.texture && current.firstMip <= firstMip + newMipCount);
+        for (uint32_t mip = newMipCount; mip < mipCount; ++mip)
+        {
+            m_context->CopySubresourceRegion(replacement.Get(), mip, 0, 0, 0,
+                current.texture.Get(), firstMip + mip - current.firstMip, nullptr);
+        }
+    }
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(replacement.Get(), D3D11_SRV_DIMENSION_TEXTURE2D);
+    ThrowIfFailed(m_device->CreateShaderResourceView(replacement.Get(), &viewDesc, current.shaderResourceView.ReleaseAndGetAddressOf()));
+
+    current.texture = replacement;
+    current.firstMip = firstMip;
+
+    // The same name per pack texture, so a device lost diff pairs each with its recreation.
+    current.memory.Track(MemoryCategory_DeviceTextures, GetTextureBytes(textureDesc), entry.name.c_str());
+}
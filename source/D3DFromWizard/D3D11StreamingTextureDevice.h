@@ -0,0 +1,45 @@
+//
+// D3D11StreamingTextureDevice.h - Recreates D3D11 textures at their resident mips for the texture streamer
+//
+
+#pragma once
+
+#include "MemoryTracker.h"
+#include "TextureStreamer.h"
+
+namespace DX
+{
+    // Owns a texture per streamed pack texture. Each update creates the texture at the size of
+    // its new top mip, uploads the loaded mips and copies the kept ones from the old texture on
+    // the GPU, so nothing is read back. Samplers see normalized coordinates, so the smaller
+    // texture is a drop-in replacement; rebind the view after Update. Recreate this, and call
+    // the streamer's OnDeviceLost, whenever the device is lost.
+    class D3D11StreamingTextureDevice : public IStreamingTextureDevice
+    {
+    public:
+        D3D11StreamingTextureDevice(ID3D11Device* device, ID3D11DeviceContext* context);
+
+        D3D11StreamingTextureDevice(const D3D11StreamingTextureDevice&) = delete;
+        D3D11StreamingTextureDevice& operator=(const D3D11StreamingTextureDevice&) = delete;
+
+        // Null until the streamer's first Update.
+        ID3D11ShaderResourceView* GetShaderResourceView(uint32_t texture) const;
+
+        // IStreamingTextureDevice
+        virtual void UpdateTexture(uint32_t texture, const TexturePackEntry& entry, uint32_t firstMip,
+            const uint8_t* newMips, uint32_t newMipCount) override;
+
+    private:
+        struct Texture
+        {
+            Microsoft::WRL::ComPtr<ID3D11Texture2D>             texture;
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    shaderResourceView;
+            uint32_t                                            firstMip;
+            TrackedMemory                                       memory;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D11Device>        m_device;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+        std::vector<Texture>                        m_textures;
+    };
+}
@@ -0,0 +1,48 @@
+//
+// D3D11VertexLayout.h - Direct3D 11 input element arrays built from VertexLayout at compile time
+//
+
+#pragma once
+
+#include "VertexLayout.h"
+
+namespace DX
+{
+    static_assert(static_cast<int>(VertexFormat_Float4) == DXGI_FORMAT_R32G32B32A32_FLOAT &&
+        static_cast<int>(VertexFormat_Float3) == DXGI_FORMAT_R32G32B32_FLOAT &&
+        static_cast<int>(VertexFormat_Half4) == DXGI_FORMAT_R16G16B16A16_FLOAT &&
+        static_cast<int>(VertexFormat_SNorm16x4) == DXGI_FORMAT_R16G16B16A16_SNORM &&
+        static_cast<int>(VertexFormat_Float2) == DXGI_FORMAT_R32G32_FLOAT &&
+        static_cast<int>(VertexFormat_UNorm8x4) == DXGI_FORMAT_R8G8B8A8_UNORM &&
+        static_cast<int>(VertexFormat_SNorm8x4) == DXGI_FORMAT_R8G8B8A8_SNORM &&
+        static_cast<int>(VertexFormat_Half2) == DXGI_FORMAT_R16G16_FLOAT &&
+        static_cast<int>(VertexFormat_SNorm16x2) == DXGI_FORMAT_R16G16_SNORM &&
+        static_cast<int>(VertexFormat_Float1) == DXGI_FORMAT_R32_FLOAT, "VertexFormat values must be the DXGI_FORMAT they stand for");
+
+    template<size_t Count>
+    struct D3D11InputElements
+    {
+        D3D11_INPUT_ELEMENT_DESC    elements[Count];
+
+        UINT GetCount() const       { return static_cast<UINT>(Count); }
+    };
+
+    // Per-vertex data from one input slot.
+    template<typename Vertex, size_t Count>
+    constexpr D3D11InputElements<Count> MakeInputElements(const VertexLayout<Vertex, Count>& layout, UINT inputSlot = 0)
+    {
+        D3D11InputElements<Count> result = {};
+        for (size_t i = 0; i < Count; ++i)
+        {
+            D3D11_INPUT_ELEMENT_DESC& element = result.elements[i];
+            element.SemanticName = layout.elements[i].semantic;
+            element.SemanticIndex = layout.elements[i].semanticIndex;
+            element.Format = static_cast<DXGI_FORMAT>(layout.elements[i].format);
+            element.InputSlot = inputSlot;
+            element.AlignedByteOffset = layout.elements[i].offset;
+            element.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+            element.InstanceDataStepRate = 0;
+        }
+        return result;
+    }
+}
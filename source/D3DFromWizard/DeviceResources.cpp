@@ -12,6 +12,54 @@ using Microsoft::WRL::ComPtr;
 
 namespace
 {
+    inline uint32_t BitsPerPixel(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+            return 128;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            return 64;
+
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_D16_UNORM:
+            return 16;
+
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_A8_UNORM:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return 8;
+
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+            return 4;
+
+        default:
+            // 8 bit RGBA, 10 bit RGB, 32 bit single channel and the packed depth formats.
+            return 32;
+        }
+    }
+
+    inline bool IsBlockCompressed(DXGI_FORMAT format)
+    {
+        return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM)
+            || (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
 #if defined(_DEBUG)
     // Check for SDK Layer support.
     inline bool SdkLayersAvailable()
@@ -226,6 +274,7 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
     m_d3dDepthStencilView.Reset();
     m_renderTarget.Reset();
     m_depthStencil.Reset();
+    m_depthStencilMemory.Release();
     m_d3dContext->Flush();
 
     // Determine the render target size in pixels.
@@ -335,6 +384,10 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
     // Create a render target view of the swap chain back buffer.
     DX::ThrowIfFailed(m_swapChain->GetBuffer(0, IID_PPV_ARGS(m_renderTarget.ReleaseAndGetAddressOf())));
 
+    D3D11_TEXTURE2D_DESC backBufferDesc;
+    m_renderTarget->GetDesc(&backBufferDesc);
+    m_swapChainMemory.Track(MemoryCategory_RenderTargets, GetTextureBytes(backBufferDesc) * m_backBufferCount, "swap chain");
+
     DX::ThrowIfFailed(m_d3dDevice->CreateRenderTargetView(
         m_renderTarget.Get(),
         nullptr,
@@ -359,6 +412,8 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
             m_depthStencil.ReleaseAndGetAddressOf()
             ));
 
+        m_depthStencilMemory.Track(MemoryCategory_RenderTargets, GetTextureBytes(depthStencilDesc), "depth stencil");
+
         CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc(D3D11_DSV_DIMENSION_TEXTURE2D);
         DX::ThrowIfFailed(m_d3dDevice->CreateDepthStencilView(
             m_depthStencil.Get(),
@@ -376,6 +431,28 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
         );
 }
 
+uint64_t DX::GetTextureBytes(const D3D11_TEXTURE2D_DESC& desc)
+{
+    const uint64_t bits = BitsPerPixel(desc.Format);
+    const bool blocks = IsBlockCompressed(desc.Format);
+
+    uint64_t bytes = 0;
+    UINT width = desc.Width;
+    UINT height = desc.Height;
+    UINT mipLevels = desc.MipLevels ? desc.MipLevels : 1;
+    for (UINT mip = 0; mip < mipLevels; ++mip)
+    {
+        // Block compressed mips are padded to whole 4x4 blocks.
+        uint64_t texels = blocks ? uint64_t((width + 3) / 4) * ((height + 3) / 4) * 16 : uint64_t(width) * height;
+        bytes += texels * bits / 8;
+
+        width = std::max<UINT>(width / 2, 1);
+        height = std::max<UINT>(height / 2, 1);
+    }
+
+    return bytes * std::max<UINT>(desc.ArraySize, 1) * std::max<UINT>(desc.SampleDesc.Count, 1);
+}
+
 // This method is called when the Win32 window is created (or re-created).
 void DX::DeviceResources::SetWindow(HWND window, int width, int height)
 {
@@ -417,6 +494,8 @@ void DX::DeviceResources::HandleDeviceLost()
     m_depthStencil.Reset();
     m_swapChain.Reset();
     m_swapChain1.Reset();
+    m_swapChainMemory.Release();
+    m_depthStencilMemory.Release();
     m_d3dContext.Reset();
     m_d3dContext1.Reset();
     m_d3dAnnotation.Reset();
@@ -444,12 +523,13 @@ void DX::DeviceResources::HandleDeviceLost()
 }
 
 // Present the contents of the swap chain to the screen.
-void DX::DeviceResources::Present() 
+void DX::DeviceResources::Present(UINT syncInterval)
 {
-    // The first argument instructs DXGI to block until VSync, putting the application
+    // A sync interval of 1 instructs DXGI to block until VSync, putting the application
     // to sleep until the next VSync. This ensures we don't waste any cycles rendering
-    // frames that will never be displayed to the screen.
-    HRESULT hr = m_swapChain->Present(1, 0);
+    // frames that will never be displayed to the screen. The frame pacer passes 0 when it
+    // limits the rate itself or runs uncapped.
+    HRESULT hr = m_swapChain->Present(syncInterval, 0);
 
     if (m_d3dContext1)
     {
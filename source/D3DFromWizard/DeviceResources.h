@@ -4,8 +4,13 @@
 
 #pragma once
 
+#include "MemoryTracker.h"
+
 namespace DX
 {
+    // Approximate video memory for a texture and its mip chain, for memory tracking.
+    uint64_t GetTextureBytes(const D3D11_TEXTURE2D_DESC& desc);
+
     // Provides an interface for an application that owns DeviceResources to be notified of the device being lost or created.
     interface IDeviceNotify
     {
@@ -28,7 +33,7 @@ namespace DX
         bool WindowSizeChanged(int width, int height);
         void HandleDeviceLost();
         void RegisterDeviceNotify(IDeviceNotify* deviceNotify) { m_deviceNotify = deviceNotify; }
-        void Present();
+        void Present(UINT syncInterval = 1);
 
         // Device Accessors.
         RECT GetOutputSize() const { return m_outputSize; }
@@ -105,6 +110,10 @@ namespace DX
         D3D_FEATURE_LEVEL                               m_d3dFeatureLevel;
         RECT                                            m_outputSize;
 
+        // Memory tracking for the window size dependent buffers.
+        TrackedMemory                                   m_swapChainMemory;
+        TrackedMemory                                   m_depthStencilMemory;
+
         // The IDeviceNotify can be held directly as it owns the DeviceResources.
         IDeviceNotify*                                  m_deviceNotify;
     };
@@ -0,0 +1,122 @@
+//
+// DynamicResolution.cpp - Picks the scene's render resolution each frame from measured frame times
+//
+
+#include "pch.h"
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+namespace
+{
+    // A single hitch (a page fault, a shader compile) should not halve the resolution, so the
+    // error of one measurement is limited to this.
+    const double c_maxError = 0.5;
+
+    // The scale only moves once the controller wants it a whole step away, so it
+    // does not flicker between two neighbouring sizes.
+    const float c_hysteresisSteps = 1.0f;
+};
+
+DX::DynamicResolutionController::DynamicResolutionController()
+{
+    SetDesc(GetDefaultDesc(1.0 / 60.0));
+}
+
+DX::DynamicResolutionDesc DX::DynamicResolutionController::GetDefaultDesc(double targetFrameSeconds)
+{
+    DynamicResolutionDesc desc;
+    desc.targetFrameSeconds = targetFrameSeconds;
+    desc.headroom = 0.9;
+    desc.minScale = 0.5f;
+    desc.maxScale = 1.0f;
+    desc.scaleStep = 1.0f / 32.0f;
+    desc.proportionalGain = 0.2;
+    desc.integralGain = 0.1;
+    desc.derivativeGain = 0.02;
+    return desc;
+}
+
+void DX::DynamicResolutionController::SetDesc(const DynamicResolutionDesc& desc)
+{
+    assert(desc.targetFrameSeconds > 0.0 && desc.headroom > 0.0);
+    assert(desc.minScale > 0.0f && desc.minScale <= desc.maxScale && desc.scaleStep > 0.0f);
+
+    m_desc = desc;
+    Reset();
+}
+
+void DX::DynamicResolutionController::Reset()
+{
+    m_scale = m_desc.maxScale;
+    m_area = double(m_scale) * m_scale;
+    m_error[0] = m_error[1] = 0.0;
+    ResetStatistics();
+}
+
+float DX::DynamicResolutionController::Update(double frameSeconds)
+{
+    m_statistics.frames++;
+    m_statistics.framesOverBudget += frameSeconds > m_desc.targetFrameSeconds;
+    m_statistics.scaleSum += m_scale;
+    m_statistics.lowestScale = std::min(m_statistics.lowestScale, m_scale);
+
+    double budget = m_desc.targetFrameSeconds * m_desc.headroom;
+    double error = std::min(std::max((budget - frameSeconds) / budget, -c_maxError), c_maxError);
+
+    double change = m_desc.proportionalGain * (error - m_error[0])
+        + m_desc.integralGain * error
+        + m_desc.derivativeGain * (error - 2.0 * m_error[0] + m_error[1]);
+    m_error[1] = m_error[0];
+    m_error[0] = error;
+
+    double minArea = double(m_desc.minScale) * m_desc.minScale;
+    double maxArea = double(m_desc.maxScale) * m_desc.maxScale;
+    m_area = std::min(std::max(m_area * (1.0 + change), minArea), maxArea);
+
+    float wanted = static_cast<float>(sqrt(m_area));
+    if (fabsf(wanted - m_scale) >= c_hysteresisSteps * m_desc.scaleStep)
+    {
+        float scale = floorf(wanted / m_desc.scaleStep + 0.5f) * m_desc.scaleStep;
+        scale = std::min(std::max(scale, m_desc.minScale), m_desc.maxScale);
+        if (scale != m_scale)
+        {
+            m_scale = scale;
+            m_statistics.scaleChanges++;
+        }
+    }
+
+    return m_scale;
+}
+
+void DX::DynamicResolutionController::GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+{
+    width = ScaleSize(outputWidth, m_scale);
+    height = ScaleSize(outputHeight, m_scale);
+}
+
+void DX::DynamicResolutionController::GetMaxRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+{
+    width = ScaleSize(outputWidth, m_desc.maxScale);
+    height = ScaleSize(outputHeight, m_desc.maxScale);
+}
+
+void DX::DynamicResolutionController::ResetStatistics()
+{
+    m_statistics = DynamicResolutionStatistics{};
+    m_statistics.lowestScale = m_scale;
+}
+
+// Rounded to the alignment, except that full size (or more) stays exact so that an unscaled
+// frame matches the output pixel for pixel. Never decreases as the scale grows.
+uint32_t DX::DynamicResolutionController::ScaleSize(uint32_t size, float scale)
+{
+    uint32_t scaled = static_cast<uint32_t>(size * scale + 0.5f);
+    if (scale >= 1.0f || scaled >= size)
+    {
+        return std::max(static_cast<uint32_t>(size * std::max(scale, 1.0f) + 0.5f), 1u);
+    }
+
+    scaled = (scaled + c_dynamicResolutionAlignment / 2) / c_dynamicResolutionAlignment * c_dynamicResolutionAlignment;
+    return std::max(std::min(scaled, size), std::min(size, c_dynamicResolutionAlignment));
+}
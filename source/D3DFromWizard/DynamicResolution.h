@@ -0,0 +1,83 @@
+//
+// DynamicResolution.h - Picks the scene's render resolution each frame from measured frame times
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace DX
+{
+    // Render sizes are rounded to this many pixels, which keeps the upscale filter's
+    // footprint aligned and stops a one pixel change from counting as a new size.
+    const uint32_t c_dynamicResolutionAlignment = 8;
+
+    struct DynamicResolutionDesc
+    {
+        double      targetFrameSeconds;     // Budget for the work that scales with resolution.
+        double      headroom;               // Aim for this fraction of the budget, e.g. 0.9.
+        float       minScale;               // Per axis, relative to the output size.
+        float       maxScale;
+        float       scaleStep;              // Scales are multiples of this.
+
+        // Gains of the controller, which works on the rendered area, in units of the
+        // normalized budget error (budget - time) / budget.
+        double      proportionalGain;
+        double      integralGain;
+        double      derivativeGain;
+    };
+
+    struct DynamicResolutionStatistics
+    {
+        uint64_t    frames;
+        uint64_t    framesOverBudget;       // Measured time above targetFrameSeconds.
+        uint64_t    scaleChanges;
+        double      scaleSum;               // Over all frames; divide by frames for the mean.
+        float       lowestScale;
+    };
+
+    // A PID controller in velocity form: every measurement adjusts the rendered area by
+    //   kp * (e - e') + ki * e + kd * (e - 2e' + e'')
+    // of itself, so the output never winds up against the scale limits. Area rather than the
+    // per-axis scale is controlled because the cost of a frame grows with it.
+    //
+    // There is no clock inside; the output depends only on the sequence of measured times,
+    // so a benchmark that feeds it a recorded or simulated sequence reproduces a run exactly.
+    // Measurements may arrive frames late (GPU timestamps do); keep the gains small enough
+    // for that delay, as the defaults are for c_gpuTimerLatency.
+    class DynamicResolutionController
+    {
+    public:
+        DynamicResolutionController();
+
+        static DynamicResolutionDesc GetDefaultDesc(double targetFrameSeconds);
+
+        void SetDesc(const DynamicResolutionDesc& desc);
+        const DynamicResolutionDesc& GetDesc() const            { return m_desc; }
+
+        // Back to full scale with no history, e.g. after a resize or a scene change.
+        void Reset();
+
+        // Feeds one frame's measured time and returns the scale for the next frame.
+        float Update(double frameSeconds);
+
+        float GetScale() const                                  { return m_scale; }
+
+        // The render size at the current scale, and the largest the controller can ask for;
+        // allocate targets at the largest size once and render into a corner of them.
+        void GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+        void GetMaxRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+
+        const DynamicResolutionStatistics& GetStatistics() const    { return m_statistics; }
+        void ResetStatistics();
+
+    private:
+        static uint32_t ScaleSize(uint32_t size, float scale);
+
+        DynamicResolutionDesc       m_desc;
+        double                      m_area;         // Unquantized, relative to the output.
+        double                      m_error[2];     // Previous two errors, newest first.
+        float                       m_scale;
+        DynamicResolutionStatistics m_statistics;
+    };
+}
@@ -0,0 +1,404 @@
+//
+// EntityWorld.cpp - Entities stored by archetype in fixed size chunks of component arrays
+//
+
+#include "pch.h"
+#include "EntityWorld.h"
+
+namespace
+{
+    struct ComponentRegistry
+    {
+        std::mutex          mutex;
+        DX::ComponentInfo   types[DX::c_maxComponentTypes];
+        uint32_t            count;
+    };
+
+    ComponentRegistry& GetRegistry()
+    {
+        static ComponentRegistry registry = {};
+        return registry;
+    }
+
+    inline size_t AlignArray(size_t offset)
+    {
+        return (offset + DX::c_entityArrayAlignment - 1) & ~(DX::c_entityArrayAlignment - 1);
+    }
+};
+
+DX::ComponentId DX::RegisterComponentType(const char* name, uint32_t size, uint32_t alignment)
+{
+    ComponentRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (registry.count == c_maxComponentTypes)
+    {
+        throw std::runtime_error(std::string("too many component types registering ") + name);
+    }
+
+    registry.types[registry.count] = ComponentInfo{ name, size, alignment };
+    return registry.count++;
+}
+
+const DX::ComponentInfo& DX::GetComponentInfo(ComponentId id)
+{
+    assert(id < GetRegistry().count);
+    return GetRegistry().types[id];
+}
+
+#pragma region EntityCommandBuffer
+void DX::EntityCommandBuffer::DestroyEntity(Entity entity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Append(Command_Destroy, entity, 0, nullptr, 0);
+}
+
+void DX::EntityCommandBuffer::Append(CommandType type, Entity entity, ComponentId component, const void* data, size_t size)
+{
+    m_commands.push_back(Command{ type, entity, component, static_cast<uint32_t>(m_data.size()) });
+
+    if (size > 0)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+}
+
+void DX::EntityCommandBuffer::Playback(EntityWorld& world)
+{
+    assert(world.m_iterating == 0);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entity created = {};
+    for (const Command& command : m_commands)
+    {
+        const uint8_t* data = m_data.data() + command.dataOffset;
+
+        switch (command.type)
+        {
+        case Command_Create:
+        {
+            ComponentMask mask;
+            memcpy(&mask, data, sizeof(mask));
+            created = world.AllocateEntity(world.GetArchetype(mask));
+            break;
+        }
+
+        case Command_SetCreated:
+            world.SetComponentData(created, command.component, data);
+            break;
+
+        case Command_Destroy:
+            if (world.IsAlive(command.entity))
+                world.DestroyEntity(command.entity);
+            break;
+
+        case Command_Add:
+            if (world.IsAlive(command.entity))
+                world.AddComponentData(command.entity, command.component, data);
+            break;
+
+        case Command_Remove:
+            if (world.IsAlive(command.entity))
+                world.RemoveComponentData(command.entity, command.component);
+            break;
+        }
+    }
+
+    m_commands.clear();
+    m_data.clear();
+}
+#pragma endregion
+
+#pragma region EntityWorld
+DX::EntityWorld::EntityWorld() :
+    m_liveEntities(0),
+    m_iterating(0)
+{
+}
+
+DX::EntityWorld::~EntityWorld()
+{
+    for (size_t i = GetChunkCount(); i > 0; --i)
+    {
+        GetMemoryTracker().Free(MemoryCategory_Entities, c_entityChunkSize);
+    }
+}
+
+void DX::EntityWorld::DestroyEntity(Entity entity)
+{
+    assert(m_iterating == 0);
+
+    const EntityRecord* found = FindRecord(entity);
+    if (!found)
+    {
+        return;
+    }
+
+    EntityRecord& record = m_records[entity.index];
+    RemoveRow(record.archetype, record.chunk, record.row);
+
+    // Handles to the old generation go stale; zero stays reserved for null.
+    record.archetype = nullptr;
+    record.generation = record.generation + 1 != 0 ? record.generation + 1 : 1;
+
+    m_freeIndices.push_back(entity.index);
+    m_liveEntities--;
+}
+
+bool DX::EntityWorld::IsAlive(Entity entity) const
+{
+    return FindRecord(entity) != nullptr;
+}
+
+size_t DX::EntityWorld::GetChunkCount() const
+{
+    size_t count = 0;
+    for (auto& archetype : m_archetypes)
+    {
+        count += archetype->chunks.size();
+    }
+    return count;
+}
+
+DX::EntityArchetype* DX::EntityWorld::GetArchetype(ComponentMask mask)
+{
+    auto found = m_archetypesByMask.find(mask);
+    if (found != m_archetypesByMask.end())
+    {
+        return found->second;
+    }
+
+    assert(m_iterating == 0);
+
+    std::unique_ptr<EntityArchetype> archetype(new EntityArchetype());
+    archetype->mask = mask;
+
+    memset(archetype->slots, -1, sizeof(archetype->slots));
+    memset(archetype->addEdges, 0, sizeof(archetype->addEdges));
+    memset(archetype->removeEdges, 0, sizeof(archetype->removeEdges));
+
+    size_t bytesPerEntity = sizeof(Entity);
+    for (ComponentId id = 0; id < c_maxComponentTypes; ++id)
+    {
+        if (mask & (ComponentMask(1) << id))
+        {
+            archetype->slots[id] = static_cast<int8_t>(archetype->components.size());
+            archetype->components.push_back(id);
+            bytesPerEntity += GetComponentInfo(id).size;
+        }
+    }
+
+    // Leave room for aligning the start of every array.
+    size_t padding = c_entityArrayAlignment * (archetype->components.size() + 1);
+    archetype->capacity = static_cast<uint32_t>((c_entityChunkSize - padding) / bytesPerEntity);
+    if (archetype->capacity == 0)
+    {
+        throw std::runtime_error("entity components do not fit in a chunk");
+    }
+
+    size_t offset = AlignArray(archetype->capacity * sizeof(Entity));
+    for (ComponentId id : archetype->components)
+    {
+        archetype->offsets.push_back(static_cast<uint32_t>(offset));
+        offset = AlignArray(offset + archetype->capacity * GetComponentInfo(id).size);
+    }
+    assert(offset <= c_entityChunkSize);
+
+    EntityArchetype* result = archetype.get();
+    m_archetypes.push_back(std::move(archetype));
+    m_archetypesByMask[mask] = result;
+    return result;
+}
+
+DX::EntityArchetype* DX::EntityWorld::GetAddTarget(EntityArchetype* archetype, ComponentId id)
+{
+    if (!archetype->addEdges[id])
+    {
+        archetype->addEdges[id] = GetArchetype(archetype->mask | (ComponentMask(1) << id));
+    }
+    return archetype->addEdges[id];
+}
+
+DX::EntityArchetype* DX::EntityWorld::GetRemoveTarget(EntityArchetype* archetype, ComponentId id)
+{
+    if (!archetype->removeEdges[id])
+    {
+        archetype->removeEdges[id] = GetArchetype(archetype->mask & ~(ComponentMask(1) << id));
+    }
+    return archetype->removeEdges[id];
+}
+
+DX::Entity DX::EntityWorld::AllocateEntity(EntityArchetype* archetype)
+{
+    assert(m_iterating == 0);
+
+    uint32_t index;
+    if (!m_freeIndices.empty())
+    {
+        index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(m_records.size());
+        m_records.push_back(EntityRecord{ nullptr, 0, 0, 1 });
+    }
+
+    Entity entity = { index, m_records[index].generation };
+    InsertRow(archetype, entity);
+
+    m_liveEntities++;
+    return entity;
+}
+
+void DX::EntityWorld::InsertRow(EntityArchetype* archetype, Entity entity)
+{
+    if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->capacity)
+    {
+        EntityChunk chunk;
+        chunk.storage.reset(new EntityChunk::Storage);
+        GetMemoryTracker().Allocate(MemoryCategory_Entities, c_entityChunkSize);
+        chunk.count = 0;
+        archetype->chunks.push_back(std::move(chunk));
+    }
+
+    EntityChunk& chunk = archetype->chunks.back();
+    uint32_t row = chunk.count++;
+    chunk.GetEntities()[row] = entity;
+
+    EntityRecord& record = m_records[entity.index];
+    record.archetype = archetype;
+    record.chunk = static_cast<uint32_t>(archetype->chunks.size() - 1);
+    record.row = row;
+}
+
+void DX::EntityWorld::RemoveRow(EntityArchetype* archetype, uint32_t chunkIndex, uint32_t row)
+{
+    uint32_t lastChunkIndex = static_cast<uint32_t>(archetype->chunks.size() - 1);
+    EntityChunk& lastChunk = archetype->chunks[lastChunkIndex];
+    uint32_t lastRow = lastChunk.count - 1;
+
+    if (chunkIndex != lastChunkIndex || row != lastRow)
+    {
+        EntityChunk& chunk = archetype->chunks[chunkIndex];
+
+        Entity moved = lastChunk.GetEntities()[lastRow];
+        chunk.GetEntities()[row] = moved;
+
+        for (ComponentId id : archetype->components)
+        {
+            uint32_t size = GetComponentInfo(id).size;
+            memcpy(static_cast<uint8_t*>(archetype->GetArray(chunk, id)) + row * size,
+                static_cast<uint8_t*>(archetype->GetArray(lastChunk, id)) + lastRow * size, size);
+        }
+
+        m_records[moved.index].chunk = chunkIndex;
+        m_records[moved.index].row = row;
+    }
+
+    if (--lastChunk.count == 0)
+    {
+        archetype->chunks.pop_back();
+        GetMemoryTracker().Free(MemoryCategory_Entities, c_entityChunkSize);
+    }
+}
+
+void DX::EntityWorld::MoveEntity(Entity entity, EntityArchetype* target)
+{
+    assert(m_iterating == 0);
+
+    EntityRecord source = m_records[entity.index];
+    InsertRow(target, entity);
+
+    const EntityRecord& destination = m_records[entity.index];
+    const EntityChunk& sourceChunk = source.archetype->chunks[source.chunk];
+    const EntityChunk& targetChunk = target->chunks[destination.chunk];
+
+    for (ComponentId id : target->components)
+    {
+        if (source.archetype->slots[id] < 0)
+            continue;
+
+        uint32_t size = GetComponentInfo(id).size;
+        memcpy(static_cast<uint8_t*>(target->GetArray(targetChunk, id)) + destination.row * size,
+            static_cast<uint8_t*>(source.archetype->GetArray(sourceChunk, id)) + source.row * size, size);
+    }
+
+    RemoveRow(source.archetype, source.chunk, source.row);
+}
+
+const DX::EntityWorld::EntityRecord* DX::EntityWorld::FindRecord(Entity entity) const
+{
+    if (entity.index >= m_records.size())
+    {
+        return nullptr;
+    }
+
+    const EntityRecord& record = m_records[entity.index];
+    return record.archetype && record.generation == entity.generation ? &record : nullptr;
+}
+
+void* DX::EntityWorld::GetComponentData(Entity entity, ComponentId id)
+{
+    const EntityRecord* record = FindRecord(entity);
+    if (!record || record->archetype->slots[id] < 0)
+    {
+        return nullptr;
+    }
+
+    const EntityChunk& chunk = record->archetype->chunks[record->chunk];
+    return static_cast<uint8_t*>(record->archetype->GetArray(chunk, id)) + record->row * GetComponentInfo(id).size;
+}
+
+void DX::EntityWorld::SetComponentData(Entity entity, ComponentId id, const void* data)
+{
+    void* component = GetComponentData(entity, id);
+    assert(component);
+    memcpy(component, data, GetComponentInfo(id).size);
+}
+
+void DX::EntityWorld::AddComponentData(Entity entity, ComponentId id, const void* data)
+{
+    const EntityRecord* record = FindRecord(entity);
+    if (!record)
+    {
+        return;
+    }
+
+    if (record->archetype->slots[id] < 0)
+    {
+        MoveEntity(entity, GetAddTarget(record->archetype, id));
+    }
+
+    SetComponentData(entity, id, data);
+}
+
+void DX::EntityWorld::RemoveComponentData(Entity entity, ComponentId id)
+{
+    const EntityRecord* record = FindRecord(entity);
+    if (!record || record->archetype->slots[id] < 0)
+    {
+        return;
+    }
+
+    MoveEntity(entity, GetRemoveTarget(record->archetype, id));
+}
+
+void DX::EntityWorld::GatherChunks(ComponentMask mask)
+{
+    m_chunkScratch.clear();
+
+    for (auto& archetype : m_archetypes)
+    {
+        if ((archetype->mask & mask) != mask)
+            continue;
+
+        for (auto& chunk : archetype->chunks)
+        {
+            m_chunkScratch.push_back(ChunkReference{ archetype.get(), &chunk });
+        }
+    }
+}
+#pragma endregion
@@ -0,0 +1,347 @@
+//
+// EntityWorld.h - Entities stored by archetype in fixed size chunks of component arrays
+//
+
+#pragma once
+
+#include "MemoryTracker.h"
+#include "WorkerPool.h"
+
+#include <mutex>
+#include <stdint.h>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // Chunk size: small enough that a chunk is one unit of parallel work and stays in L2
+    // while it is updated, large enough that per chunk overhead disappears.
+    const size_t c_entityChunkSize = 16 * 1024;
+
+    // Arrays inside a chunk start on this boundary so systems can use aligned SIMD loads.
+    const size_t c_entityArrayAlignment = 16;
+
+    const uint32_t c_maxComponentTypes = 64;
+
+    typedef uint32_t ComponentId;
+    typedef uint64_t ComponentMask;
+
+    struct Entity
+    {
+        uint32_t index;
+        uint32_t generation;        // Zero is never live, so a value-initialized Entity is null.
+
+        bool IsNull() const                             { return generation == 0; }
+        bool operator==(const Entity& other) const      { return index == other.index && generation == other.generation; }
+        bool operator!=(const Entity& other) const      { return !(*this == other); }
+    };
+
+    struct ComponentInfo
+    {
+        const char* name;
+        uint32_t    size;
+        uint32_t    alignment;
+    };
+
+    // Component ids are handed out on first use and shared by every world in the process.
+    // Throws once c_maxComponentTypes types exist.
+    ComponentId RegisterComponentType(const char* name, uint32_t size, uint32_t alignment);
+    const ComponentInfo& GetComponentInfo(ComponentId id);
+
+    template<typename Component>
+    struct ComponentType
+    {
+        static_assert(std::is_trivially_copyable<Component>::value, "components are moved between chunks with memcpy");
+        static_assert(alignof(Component) <= c_entityArrayAlignment, "component alignment exceeds the chunk array alignment");
+
+        static ComponentId GetId()
+        {
+            static const ComponentId id = RegisterComponentType(typeid(Component).name(), sizeof(Component), alignof(Component));
+            return id;
+        }
+    };
+
+    // T and const T are the same component.
+    template<typename T>
+    ComponentId GetComponentId()
+    {
+        return ComponentType<typename std::remove_const<T>::type>::GetId();
+    }
+
+    template<typename... Ts>
+    ComponentMask GetComponentMask()
+    {
+        ComponentMask mask = 0;
+        int expand[] = { 0, (mask |= ComponentMask(1) << GetComponentId<Ts>(), 0)... };
+        (void)expand;
+        return mask;
+    }
+
+    // One block of c_entityChunkSize bytes: the entity handles, then one array per component
+    // type of the archetype, each capacity elements long.
+    struct EntityChunk
+    {
+        struct alignas(c_entityArrayAlignment) Storage
+        {
+            uint8_t bytes[c_entityChunkSize];
+        };
+
+        std::unique_ptr<Storage>    storage;
+        uint32_t                    count;
+
+        Entity* GetEntities() const                     { return reinterpret_cast<Entity*>(storage->bytes); }
+    };
+
+    // Every entity with exactly the same set of component types lives in the same archetype.
+    struct EntityArchetype
+    {
+        ComponentMask               mask;
+        std::vector<ComponentId>    components;
+        std::vector<uint32_t>       offsets;            // Byte offset of each component's array in a chunk.
+        int8_t                      slots[c_maxComponentTypes];     // Index into components, or -1.
+        uint32_t                    capacity;           // Entities per chunk.
+
+        // Chunks before the last are full; removal moves the last entity into the hole.
+        std::vector<EntityChunk>    chunks;
+
+        // Archetype reached by adding or removing each component type, filled in on first use.
+        EntityArchetype*            addEdges[c_maxComponentTypes];
+        EntityArchetype*            removeEdges[c_maxComponentTypes];
+
+        void* GetArray(const EntityChunk& chunk, ComponentId id) const
+        {
+            return chunk.storage->bytes + offsets[slots[id]];
+        }
+    };
+
+    class EntityWorld;
+
+    // Records structural changes (creating and destroying entities, adding and removing
+    // components) to be made later, when nothing is iterating over the chunks. Recording is
+    // thread safe, so systems running on worker threads can share one buffer.
+    class EntityCommandBuffer
+    {
+    public:
+        EntityCommandBuffer() = default;
+
+        EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+        EntityCommandBuffer& operator=(const EntityCommandBuffer&) = delete;
+
+        template<typename... Ts>
+        void CreateEntity(const Ts&... components)
+        {
+            ComponentMask mask = GetComponentMask<Ts...>();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Append(Command_Create, Entity{}, 0, &mask, sizeof(mask));
+            int expand[] = { 0, (Append(Command_SetCreated, Entity{}, GetComponentId<Ts>(), &components, sizeof(Ts)), 0)... };
+            (void)expand;
+        }
+
+        void DestroyEntity(Entity entity);
+
+        // Overwrites the component if the entity already has one.
+        template<typename T>
+        void AddComponent(Entity entity, const T& component)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Append(Command_Add, entity, GetComponentId<T>(), &component, sizeof(T));
+        }
+
+        template<typename T>
+        void RemoveComponent(Entity entity)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Append(Command_Remove, entity, GetComponentId<T>(), nullptr, 0);
+        }
+
+        bool IsEmpty() const                            { return m_commands.empty(); }
+
+        // Applies the commands in recording order and clears the buffer. Commands on entities
+        // that no longer exist, e.g. destroyed twice, are skipped.
+        void Playback(EntityWorld& world);
+
+    private:
+        enum CommandType
+        {
+            Command_Create,
+            Command_SetCreated,     // Component of the entity made by the preceding Command_Create.
+            Command_Destroy,
+            Command_Add,
+            Command_Remove,
+        };
+
+        struct Command
+        {
+            CommandType type;
+            Entity      entity;
+            ComponentId component;
+            uint32_t    dataOffset;
+        };
+
+        void Append(CommandType type, Entity entity, ComponentId component, const void* data, size_t size);
+
+        std::mutex              m_mutex;
+        std::vector<Command>    m_commands;
+        std::vector<uint8_t>    m_data;
+    };
+
+    // Archetype based entity storage. Components are plain data, stored structure-of-arrays in
+    // 16 KB chunks, so a system reads only the arrays it asks for, front to back, and chunks
+    // can be updated on different threads without sharing cache lines.
+    //
+    // Chunks are charged to MemoryCategory_Entities.
+    //
+    // Structural changes move entities between chunks. They may be made directly from the
+    // main thread between iterations, or recorded into GetCommandBuffer() at any time and
+    // applied by PlaybackCommands() at the end of the frame.
+    class EntityWorld
+    {
+    public:
+        EntityWorld();
+        ~EntityWorld();
+
+        EntityWorld(const EntityWorld&) = delete;
+        EntityWorld& operator=(const EntityWorld&) = delete;
+
+        template<typename... Ts>
+        Entity CreateEntity(const Ts&... components)
+        {
+            Entity entity = AllocateEntity(GetArchetype(GetComponentMask<Ts...>()));
+            int expand[] = { 0, (SetComponentData(entity, GetComponentId<Ts>(), &components), 0)... };
+            (void)expand;
+            return entity;
+        }
+
+        void DestroyEntity(Entity entity);
+        bool IsAlive(Entity entity) const;
+
+        template<typename T>
+        void AddComponent(Entity entity, const T& component)
+        {
+            AddComponentData(entity, GetComponentId<T>(), &component);
+        }
+
+        template<typename T>
+        void RemoveComponent(Entity entity)
+        {
+            RemoveComponentData(entity, GetComponentId<T>());
+        }
+
+        // Null if the entity is dead or lacks the component. Valid until the next structural change.
+        template<typename T>
+        T* GetComponent(Entity entity)
+        {
+            return static_cast<T*>(GetComponentData(entity, GetComponentId<T>()));
+        }
+
+        // Calls function(count, entities, arrays...) for every chunk holding entities that have
+        // all of the components Ts (and possibly others). Declare read-only components const.
+        template<typename... Ts, typename Function>
+        void ForEachChunk(Function function)
+        {
+            IterationScope scope(*this);
+
+            ComponentMask mask = GetComponentMask<Ts...>();
+            for (auto& archetype : m_archetypes)
+            {
+                if ((archetype->mask & mask) != mask)
+                    continue;
+
+                for (auto& chunk : archetype->chunks)
+                {
+                    function(chunk.count, static_cast<const Entity*>(chunk.GetEntities()),
+                        static_cast<Ts*>(archetype->GetArray(chunk, GetComponentId<Ts>()))...);
+                }
+            }
+        }
+
+        // As ForEachChunk, with the chunks spread over the pool's threads. Each call sees one
+        // chunk, so writes to its own arrays need no synchronization; structural changes go
+        // through the command buffer.
+        template<typename... Ts, typename Function>
+        void ParallelForEachChunk(WorkerPool& pool, Function function)
+        {
+            IterationScope scope(*this);
+
+            GatherChunks(GetComponentMask<Ts...>());
+            pool.ParallelFor(static_cast<uint32_t>(m_chunkScratch.size()), [&](uint32_t i)
+            {
+                const EntityArchetype* archetype = m_chunkScratch[i].archetype;
+                const EntityChunk& chunk = *m_chunkScratch[i].chunk;
+
+                function(chunk.count, static_cast<const Entity*>(chunk.GetEntities()),
+                    static_cast<Ts*>(archetype->GetArray(chunk, GetComponentId<Ts>()))...);
+            });
+        }
+
+        EntityCommandBuffer& GetCommandBuffer()         { return m_commandBuffer; }
+        void PlaybackCommands()                         { m_commandBuffer.Playback(*this); }
+
+        uint32_t GetEntityCount() const                 { return m_liveEntities; }
+        size_t GetArchetypeCount() const                { return m_archetypes.size(); }
+        size_t GetChunkCount() const;
+
+    private:
+        friend class EntityCommandBuffer;
+
+        struct EntityRecord
+        {
+            EntityArchetype*    archetype;      // Null while the index is free.
+            uint32_t            chunk;
+            uint32_t            row;
+            uint32_t            generation;
+        };
+
+        struct ChunkReference
+        {
+            const EntityArchetype*  archetype;
+            const EntityChunk*      chunk;
+        };
+
+        // Structural changes assert that no iteration is in progress.
+        struct IterationScope
+        {
+            explicit IterationScope(EntityWorld& world) : world(world)     { world.m_iterating++; }
+            ~IterationScope()                                               { world.m_iterating--; }
+            EntityWorld& world;
+        };
+
+        EntityArchetype* GetArchetype(ComponentMask mask);
+        EntityArchetype* GetAddTarget(EntityArchetype* archetype, ComponentId id);
+        EntityArchetype* GetRemoveTarget(EntityArchetype* archetype, ComponentId id);
+
+        // Creates an entity with uninitialized components in archetype.
+        Entity AllocateEntity(EntityArchetype* archetype);
+
+        // Appends a row for entity to archetype and points its record at it.
+        void InsertRow(EntityArchetype* archetype, Entity entity);
+
+        // Fills the hole at (chunk, row) with the archetype's last entity.
+        void RemoveRow(EntityArchetype* archetype, uint32_t chunk, uint32_t row);
+
+        // Moves entity to another archetype, copying the components both have in common.
+        void MoveEntity(Entity entity, EntityArchetype* target);
+
+        const EntityRecord* FindRecord(Entity entity) const;
+        void* GetComponentData(Entity entity, ComponentId id);
+        void SetComponentData(Entity entity, ComponentId id, const void* data);
+        void AddComponentData(Entity entity, ComponentId id, const void* data);
+        void RemoveComponentData(Entity entity, ComponentId id);
+
+        void GatherChunks(ComponentMask mask);
+
+        std::vector<std::unique_ptr<EntityArchetype>>           m_archetypes;
+        std::unordered_map<ComponentMask, EntityArchetype*>     m_archetypesByMask;
+
+        std::vector<EntityRecord>                               m_records;
+        std::vector<uint32_t>                                   m_freeIndices;
+        uint32_t                                                m_liveEntities;
+
+        EntityCommandBuffer                                     m_commandBuffer;
+        std::vector<ChunkReference>                             m_chunkScratch;
+        int                                                     m_iterating;
+    };
+}
@@ -0,0 +1,1421 @@
+//
+// FbxReader.cpp - Streaming binary FBX reader over a memory mapped file
+//
+
+#include "pch.h"
+#include "FbxReader.h"
+#include "Inflate.h"
+#include "MeshLoader.h"
+
+#include <chrono>
+#include <functional>
+#include <math.h>
+#include <unordered_map>
+
+using namespace DX;
+
+namespace
+{
+    const char c_fbxMagic[] = "Kaydara FBX Binary  ";
+    const size_t c_fbxHeaderSize = 27;      // Magic with its terminator, 0x1a 0x00, version.
+    const uint32_t c_wideHeaderVersion = 7500;
+
+    // Deflate cannot expand data by more than this, so a compressed array claiming a larger
+    // decoded size is corrupt; checked before allocating what the header asks for.
+    const uint64_t c_maxInflateRatio = 1032;
+
+    template<typename T>
+    T ReadValue(const uint8_t* data)
+    {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    [[noreturn]] void ThrowCorrupt(const char* what)
+    {
+        throw std::runtime_error(std::string("Corrupt FBX ") + what);
+    }
+
+    template<typename Target, typename Source>
+    void ConvertArray(const uint8_t* data, uint32_t count, Target* values)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            values[i] = static_cast<Target>(ReadValue<Source>(data + i * sizeof(Source)));
+        }
+    }
+
+    // Inflates if needed and converts each element to Target.
+    template<typename Target>
+    bool ReadNumericArray(const FbxProperty& property, std::vector<Target>& values)
+    {
+        if (!property.IsArray() || property.type == FbxPropertyType_BoolArray)
+        {
+            return false;
+        }
+
+        size_t bytes = static_cast<size_t>(property.arrayLength) * property.GetElementSize();
+        const uint8_t* data = property.data;
+        std::vector<uint8_t> inflated;
+        if (property.compressed)
+        {
+            if (static_cast<uint64_t>(property.arrayLength) * property.GetElementSize() > static_cast<uint64_t>(property.size) * c_maxInflateRatio)
+            {
+                return false;
+            }
+            inflated.resize(bytes);
+            if (!InflateZlib(property.data, property.size, inflated.data(), bytes))
+            {
+                return false;
+            }
+            data = inflated.data();
+        }
+        else if (property.size != bytes)
+        {
+            return false;
+        }
+
+        values.resize(property.arrayLength);
+        switch (property.type)
+        {
+        case FbxPropertyType_FloatArray:    ConvertArray<Target, float>(data, property.arrayLength, values.data()); break;
+        case FbxPropertyType_DoubleArray:   ConvertArray<Target, double>(data, property.arrayLength, values.data()); break;
+        case FbxPropertyType_Int32Array:    ConvertArray<Target, int32_t>(data, property.arrayLength, values.data()); break;
+        default:                            ConvertArray<Target, int64_t>(data, property.arrayLength, values.data()); break;
+        }
+        return true;
+    }
+}
+
+bool DX::FbxRecord::NameIs(const char* text) const
+{
+    return strlen(text) == nameLength && memcmp(name, text, nameLength) == 0;
+}
+
+bool DX::FbxProperty::IsArray() const
+{
+    return type == FbxPropertyType_FloatArray || type == FbxPropertyType_DoubleArray || type == FbxPropertyType_Int64Array ||
+        type == FbxPropertyType_Int32Array || type == FbxPropertyType_BoolArray;
+}
+
+bool DX::FbxProperty::IsNumber() const
+{
+    return type == FbxPropertyType_Int16 || type == FbxPropertyType_Bool || type == FbxPropertyType_Int32 ||
+        type == FbxPropertyType_Float || type == FbxPropertyType_Double || type == FbxPropertyType_Int64;
+}
+
+uint32_t DX::FbxProperty::GetElementSize() const
+{
+    switch (type)
+    {
+    case FbxPropertyType_FloatArray:
+    case FbxPropertyType_Int32Array:    return 4;
+    case FbxPropertyType_DoubleArray:
+    case FbxPropertyType_Int64Array:    return 8;
+    case FbxPropertyType_BoolArray:     return 1;
+    default:                            return 0;
+    }
+}
+
+std::string DX::FbxProperty::GetString() const
+{
+    return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+bool DX::FbxProperty::StringIs(const char* text) const
+{
+    return type == FbxPropertyType_String && strlen(text) == size && memcmp(data, text, size) == 0;
+}
+
+bool DX::FbxProperty::ReadArray(std::vector<double>& values) const
+{
+    return ReadNumericArray(*this, values);
+}
+
+bool DX::FbxProperty::ReadArray(std::vector<int32_t>& values) const
+{
+    return ReadNumericArray(*this, values);
+}
+
+DX::FbxRecordCursor::FbxRecordCursor(const uint8_t* fileBegin, const uint8_t* begin, const uint8_t* end, bool wideHeaders) :
+    m_fileBegin(fileBegin),
+    m_next(begin),
+    m_end(end),
+    m_wideHeaders(wideHeaders)
+{
+}
+
+bool DX::FbxRecordCursor::Next(FbxRecord& record)
+{
+    size_t headerSize = m_wideHeaders ? 25 : 13;
+    if (static_cast<size_t>(m_end - m_next) < headerSize)
+    {
+        return false;
+    }
+
+    uint64_t endOffset, propertyCount, propertyBytes;
+    if (m_wideHeaders)
+    {
+        endOffset = ReadValue<uint64_t>(m_next);
+        propertyCount = ReadValue<uint64_t>(m_next + 8);
+        propertyBytes = ReadValue<uint64_t>(m_next + 16);
+    }
+    else
+    {
+        endOffset = ReadValue<uint32_t>(m_next);
+        propertyCount = ReadValue<uint32_t>(m_next + 4);
+        propertyBytes = ReadValue<uint32_t>(m_next + 8);
+    }
+    uint32_t nameLength = m_next[headerSize - 1];
+
+    // A record of zeros ends the run.
+    if (endOffset == 0)
+    {
+        m_next = m_end;
+        return false;
+    }
+
+    const uint8_t* recordEnd = m_fileBegin + endOffset;
+    const uint8_t* name = m_next + headerSize;
+    if (endOffset > static_cast<uint64_t>(m_end - m_fileBegin) || recordEnd < name + nameLength ||
+        propertyBytes > static_cast<uint64_t>(recordEnd - name - nameLength) || propertyCount > propertyBytes)
+    {
+        ThrowCorrupt("record");
+    }
+
+    record.name = reinterpret_cast<const char*>(name);
+    record.nameLength = nameLength;
+    record.propertyCount = static_cast<uint32_t>(propertyCount);
+    record.properties = name + nameLength;
+    record.propertiesEnd = record.properties + propertyBytes;
+    record.children = record.propertiesEnd;
+    record.end = recordEnd;
+
+    m_next = recordEnd;
+    return true;
+}
+
+DX::FbxRecordCursor DX::FbxRecordCursor::GetChildren(const FbxRecord& record) const
+{
+    return FbxRecordCursor(m_fileBegin, record.children, record.end, m_wideHeaders);
+}
+
+bool DX::FbxRecordCursor::FindChild(const FbxRecord& record, const char* name, FbxRecord& child) const
+{
+    FbxRecordCursor children = GetChildren(record);
+    while (children.Next(child))
+    {
+        if (child.NameIs(name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+DX::FbxPropertyCursor::FbxPropertyCursor(const FbxRecord& record) :
+    m_next(record.properties),
+    m_end(record.propertiesEnd),
+    m_remaining(record.propertyCount)
+{
+}
+
+bool DX::FbxPropertyCursor::Next(FbxProperty& property)
+{
+    if (m_remaining == 0)
+    {
+        return false;
+    }
+    if (m_next == m_end)
+    {
+        ThrowCorrupt("property list");
+    }
+
+    property = {};
+    property.type = static_cast<FbxPropertyType>(*m_next++);
+    size_t available = m_end - m_next;
+
+    auto need = [&](size_t bytes)
+    {
+        if (bytes > available)
+        {
+            ThrowCorrupt("property");
+        }
+    };
+
+    size_t size = 0;
+    switch (property.type)
+    {
+    case FbxPropertyType_Int16:     need(size = 2); property.integer = ReadValue<int16_t>(m_next); property.number = static_cast<double>(property.integer); break;
+    case FbxPropertyType_Bool:      need(size = 1); property.integer = *m_next != 0; property.number = static_cast<double>(property.integer); break;
+    case FbxPropertyType_Int32:     need(size = 4); property.integer = ReadValue<int32_t>(m_next); property.number = static_cast<double>(property.integer); break;
+    case FbxPropertyType_Int64:     need(size = 8); property.integer = ReadValue<int64_t>(m_next); property.number = static_cast<double>(property.integer); break;
+    case FbxPropertyType_Float:     need(size = 4); property.number = ReadValue<float>(m_next); break;
+    case FbxPropertyType_Double:    need(size = 8); property.number = ReadValue<double>(m_next); break;
+
+    case FbxPropertyType_FloatArray:
+    case FbxPropertyType_DoubleArray:
+    case FbxPropertyType_Int64Array:
+    case FbxPropertyType_Int32Array:
+    case FbxPropertyType_BoolArray:
+    {
+        need(12);
+        property.arrayLength = ReadValue<uint32_t>(m_next);
+        uint32_t encoding = ReadValue<uint32_t>(m_next + 4);
+        property.size = ReadValue<uint32_t>(m_next + 8);
+        property.compressed = encoding == 1;
+        property.data = m_next + 12;
+        size = 12 + static_cast<size_t>(property.size);
+        need(size);
+        if (encoding > 1 || (!property.compressed && property.size != static_cast<uint64_t>(property.arrayLength) * property.GetElementSize()))
+        {
+            ThrowCorrupt("array");
+        }
+        break;
+    }
+
+    case FbxPropertyType_String:
+    case FbxPropertyType_Raw:
+        need(4);
+        property.size = ReadValue<uint32_t>(m_next);
+        property.data = m_next + 4;
+        size = 4 + static_cast<size_t>(property.size);
+        need(size);
+        break;
+
+    default:
+        ThrowCorrupt("property type");
+    }
+
+    m_next += size;
+    m_remaining--;
+    return true;
+}
+
+DX::FbxFile::FbxFile(const std::string& path) :
+    m_version(0)
+{
+    if (!m_file.Open(path))
+    {
+        throw std::runtime_error("Unable to open " + path);
+    }
+
+    const uint8_t* data = m_file.GetData();
+    if (m_file.GetSize() < c_fbxHeaderSize || memcmp(data, c_fbxMagic, sizeof(c_fbxMagic)) != 0)
+    {
+        throw std::runtime_error("Not a binary FBX file: " + path);
+    }
+    m_version = ReadValue<uint32_t>(data + 23);
+}
+
+DX::FbxRecordCursor DX::FbxFile::GetRecords() const
+{
+    const uint8_t* data = m_file.GetData();
+    return FbxRecordCursor(data, data + c_fbxHeaderSize, data + m_file.GetSize(), m_version >= c_wideHeaderVersion);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const double c_degreesToRadians = 3.14159265358979323846 / 180.0;
+
+    // Model hierarchies deeper than this are taken to be cyclic.
+    const uint32_t c_maxModelDepth = 64;
+
+    // An affine transform for column vectors, p' = m * p, with the translation in column 3.
+    struct Affine
+    {
+        double m[3][4];
+    };
+
+    Affine MakeIdentity()
+    {
+        Affine result = {};
+        result.m[0][0] = result.m[1][1] = result.m[2][2] = 1.0;
+        return result;
+    }
+
+    Affine Multiply(const Affine& a, const Affine& b)
+    {
+        Affine result;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] + a.m[row][2] * b.m[2][column] +
+                    (column == 3 ? a.m[row][3] : 0.0);
+            }
+        }
+        return result;
+    }
+
+    Affine MakeTranslation(const double offset[3], double sign = 1.0)
+    {
+        Affine result = MakeIdentity();
+        for (int i = 0; i < 3; ++i)
+        {
+            result.m[i][3] = offset[i] * sign;
+        }
+        return result;
+    }
+
+    Affine MakeScaling(const double scale[3])
+    {
+        Affine result = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            result.m[i][i] = scale[i];
+        }
+        return result;
+    }
+
+    // FBX rotation orders name the axes in the order they are applied: XYZ is Rz * Ry * Rx.
+    // inverse gives the transpose, as PostRotation needs.
+    Affine MakeRotation(const double degrees[3], int64_t order, bool inverse = false)
+    {
+        static const uint8_t c_axisOrders[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 2, 0 }, { 1, 0, 2 }, { 2, 0, 1 }, { 2, 1, 0 } };
+        const uint8_t* axes = c_axisOrders[order >= 0 && order < 6 ? order : 0];
+
+        Affine result = MakeIdentity();
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t axis = axes[i];
+            double angle = degrees[axis] * c_degreesToRadians;
+            double c = cos(angle), s = sin(angle);
+            uint32_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+            Affine rotation = MakeIdentity();
+            rotation.m[u][u] = c;
+            rotation.m[u][v] = -s;
+            rotation.m[v][u] = s;
+            rotation.m[v][v] = c;
+            result = Multiply(rotation, result);
+        }
+
+        if (inverse)
+        {
+            for (int row = 0; row < 3; ++row)
+            {
+                for (int column = row + 1; column < 3; ++column)
+                {
+                    std::swap(result.m[row][column], result.m[column][row]);
+                }
+            }
+        }
+        return result;
+    }
+
+    double Determinant(const Affine& a)
+    {
+        return a.m[0][0] * (a.m[1][1] * a.m[2][2] - a.m[1][2] * a.m[2][1]) -
+            a.m[0][1] * (a.m[1][0] * a.m[2][2] - a.m[1][2] * a.m[2][0]) +
+            a.m[0][2] * (a.m[1][0] * a.m[2][1] - a.m[1][1] * a.m[2][0]);
+    }
+
+    // The cofactor matrix: the inverse transpose times the determinant. Normals only need
+    // their direction, and the cofactors keep it even for a singular scale.
+    Affine MakeNormalTransform(const Affine& a)
+    {
+        Affine result = {};
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                int r0 = (row + 1) % 3, r1 = (row + 2) % 3, c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+                result.m[row][column] = a.m[r0][c0] * a.m[r1][c1] - a.m[r0][c1] * a.m[r1][c0];
+            }
+        }
+        return result;
+    }
+
+    void TransformPoint(const Affine& a, const double* point, float* result)
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            result[row] = static_cast<float>(a.m[row][0] * point[0] + a.m[row][1] * point[1] + a.m[row][2] * point[2] + a.m[row][3]);
+        }
+    }
+
+    void TransformNormal(const Affine& a, const double* normal, float* result)
+    {
+        double transformed[3];
+        for (int row = 0; row < 3; ++row)
+        {
+            transformed[row] = a.m[row][0] * normal[0] + a.m[row][1] * normal[1] + a.m[row][2] * normal[2];
+        }
+        double length = sqrt(transformed[0] * transformed[0] + transformed[1] * transformed[1] + transformed[2] * transformed[2]);
+        double scale = length > 0.0 ? 1.0 / length : 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            result[i] = static_cast<float>(transformed[i] * scale);
+        }
+    }
+
+    // FBX 7 objects are known by a 64-bit id, FBX 6 ones by name. Either way the key is the
+    // bytes of the first property.
+    std::string GetObjectKey(const FbxProperty& property)
+    {
+        if (property.type == FbxPropertyType_Int64)
+        {
+            return std::string(reinterpret_cast<const char*>(&property.integer), sizeof(property.integer));
+        }
+        return property.type == FbxPropertyType_String ? property.GetString() : std::string();
+    }
+
+    std::string GetObjectKey(const FbxRecord& record)
+    {
+        FbxPropertyCursor properties(record);
+        FbxProperty property;
+        return properties.Next(property) ? GetObjectKey(property) : std::string();
+    }
+
+    // Object names read "name\0\1Class" in FBX 7 and "Class::name" in FBX 6.
+    std::string GetObjectName(const FbxRecord& record)
+    {
+        FbxPropertyCursor properties(record);
+        FbxProperty property;
+        while (properties.Next(property))
+        {
+            if (property.type == FbxPropertyType_String)
+            {
+                std::string name = property.GetString();
+                size_t separator = name.find(std::string("\0\1", 2));
+                if (separator != std::string::npos)
+                {
+                    return name.substr(0, separator);
+                }
+                separator = name.find("::");
+                return separator == std::string::npos ? name : name.substr(separator + 2);
+            }
+        }
+        return std::string();
+    }
+
+    // The first string property of a child record, e.g. MappingInformationType.
+    std::string GetChildString(const FbxRecordCursor& cursor, const FbxRecord& record, const char* name)
+    {
+        FbxRecord child;
+        FbxProperty property;
+        if (cursor.FindChild(record, name, child))
+        {
+            FbxPropertyCursor properties(child);
+            if (properties.Next(property) && property.type == FbxPropertyType_String)
+            {
+                return property.GetString();
+            }
+        }
+        return std::string();
+    }
+
+    // Calls visit(name, values) for every entry of an object's Properties70 (P records, values
+    // after name, type, label and flags) or Properties60 (Property records, without a label).
+    template<typename Visit>
+    void ForEachObjectProperty(const FbxRecordCursor& cursor, const FbxRecord& object, Visit visit)
+    {
+        FbxRecord table, entry;
+        bool modern = cursor.FindChild(object, "Properties70", table);
+        if (!modern && !cursor.FindChild(object, "Properties60", table))
+        {
+            return;
+        }
+
+        FbxRecordCursor entries = cursor.GetChildren(table);
+        while (entries.Next(entry))
+        {
+            FbxPropertyCursor values(entry);
+            FbxProperty name, skipped;
+            if (!values.Next(name) || name.type != FbxPropertyType_String)
+            {
+                continue;
+            }
+            for (int i = 0; i < (modern ? 3 : 2) && values.Next(skipped); ++i)
+            {
+            }
+            visit(name, values);
+        }
+    }
+
+    // Reads up to count numbers; the rest of values keeps its defaults.
+    void ReadNumbers(FbxPropertyCursor& values, double* numbers, int count)
+    {
+        FbxProperty property;
+        for (int i = 0; i < count && values.Next(property) && property.IsNumber(); ++i)
+        {
+            numbers[i] = property.number;
+        }
+    }
+
+    enum LayerMapping
+    {
+        LayerMapping_None,
+        LayerMapping_PolygonVertex,
+        LayerMapping_ControlPoint,
+        LayerMapping_Polygon,
+        LayerMapping_AllSame,
+    };
+
+    // A LayerElementNormal, LayerElementUV or LayerElementMaterial: values, optionally indexed,
+    // one per polygon corner, control point, polygon or for the whole mesh.
+    struct LayerSource
+    {
+        LayerMapping    mapping;
+        bool            indexed;
+        FbxRecord       values;
+        FbxRecord       indices;
+    };
+
+    struct GeometrySource
+    {
+        std::string             key;
+        FbxRecord               vertices;
+        FbxRecord               polygonVertexIndex;
+        LayerSource             normals;
+        LayerSource             texcoords;
+        LayerSource             materials;
+        int32_t                 textureId;          // FBX 6 LayerElementTexture, -1 for none.
+
+        std::vector<double>     positionData;
+        std::vector<int32_t>    polygonData;
+        std::vector<double>     normalData;
+        std::vector<int32_t>    normalIndexData;
+        std::vector<double>     texcoordData;
+        std::vector<int32_t>    texcoordIndexData;
+        std::vector<int32_t>    materialData;
+    };
+
+    struct ModelSource
+    {
+        std::string             key;
+        double                  translation[3];
+        double                  rotation[3];
+        double                  scaling[3];
+        double                  rotationOffset[3];
+        double                  rotationPivot[3];
+        double                  scalingOffset[3];
+        double                  scalingPivot[3];
+        double                  preRotation[3];
+        double                  postRotation[3];
+        double                  geometricTranslation[3];
+        double                  geometricRotation[3];
+        double                  geometricScaling[3];
+        int64_t                 rotationOrder;
+        bool                    rotationActive;
+
+        std::string             parent;
+        std::vector<uint32_t>   materials;          // Global indices, in connection order.
+        std::vector<std::string> textures;          // Keys, in connection order.
+    };
+
+    // Scene conversion from GlobalSettings: which file axis becomes x, y and z.
+    struct AxisSystem
+    {
+        int64_t axis[3];
+        double  sign[3];
+    };
+
+    // What one pass over the records finds: references into the file, nothing decoded.
+    struct SceneSource
+    {
+        AxisSystem                                      axes;
+        std::vector<GeometrySource>                     geometries;
+        std::vector<ModelSource>                        models;
+        std::vector<FbxMaterial>                        materials;
+        std::unordered_map<std::string, uint32_t>       geometryIndices;
+        std::unordered_map<std::string, uint32_t>       modelIndices;
+        std::unordered_map<std::string, uint32_t>       materialIndices;
+        std::unordered_map<std::string, std::string>    textureFiles;
+        std::vector<std::pair<uint32_t, uint32_t>>      instances;      // Geometry, model.
+    };
+
+    LayerMapping ParseMapping(const std::string& mapping)
+    {
+        if (mapping == "ByPolygonVertex")                               return LayerMapping_PolygonVertex;
+        if (mapping == "ByVertice" || mapping == "ByVertex" || mapping == "ByControlPoint")  return LayerMapping_ControlPoint;
+        if (mapping == "ByPolygon")                                     return LayerMapping_Polygon;
+        if (mapping == "AllSame")                                       return LayerMapping_AllSame;
+        return LayerMapping_None;
+    }
+
+    // Takes the first layer of each kind, which is the one Layer 0 names.
+    void ReadLayer(const FbxRecordCursor& cursor, const FbxRecord& element, const char* valuesName, const char* indicesName, LayerSource& layer)
+    {
+        if (layer.mapping != LayerMapping_None)
+        {
+            return;
+        }
+
+        FbxRecord values;
+        if (!cursor.FindChild(element, valuesName, values))
+        {
+            return;
+        }
+
+        layer.mapping = ParseMapping(GetChildString(cursor, element, "MappingInformationType"));
+        layer.values = values;
+        std::string reference = GetChildString(cursor, element, "ReferenceInformationType");
+        layer.indexed = indicesName && (reference == "IndexToDirect" || reference == "Index") && cursor.FindChild(element, indicesName, layer.indices);
+    }
+
+    bool ReadGeometry(const FbxRecordCursor& cursor, const FbxRecord& record, const std::string& key, GeometrySource& geometry)
+    {
+        geometry = {};
+        geometry.key = key;
+        geometry.textureId = -1;
+        if (!cursor.FindChild(record, "Vertices", geometry.vertices) || !cursor.FindChild(record, "PolygonVertexIndex", geometry.polygonVertexIndex))
+        {
+            return false;
+        }
+
+        FbxRecordCursor children = cursor.GetChildren(record);
+        FbxRecord child;
+        while (children.Next(child))
+        {
+            if (child.NameIs("LayerElementNormal"))
+            {
+                ReadLayer(cursor, child, "Normals", "NormalsIndex", geometry.normals);
+            }
+            else if (child.NameIs("LayerElementUV"))
+            {
+                ReadLayer(cursor, child, "UV", "UVIndex", geometry.texcoords);
+            }
+            else if (child.NameIs("LayerElementMaterial"))
+            {
+                ReadLayer(cursor, child, "Materials", nullptr, geometry.materials);
+            }
+            else if (child.NameIs("LayerElementTexture") && geometry.textureId < 0)
+            {
+                FbxRecord textureId;
+                FbxProperty property;
+                if (cursor.FindChild(child, "TextureId", textureId) && FbxPropertyCursor(textureId).Next(property) && property.IsNumber())
+                {
+                    geometry.textureId = static_cast<int32_t>(property.integer);
+                }
+            }
+        }
+        return true;
+    }
+
+    void ReadModel(const FbxRecordCursor& cursor, const FbxRecord& record, const std::string& key, ModelSource& model)
+    {
+        model = {};
+        model.key = key;
+        for (int i = 0; i < 3; ++i)
+        {
+            model.scaling[i] = model.geometricScaling[i] = 1.0;
+        }
+
+        ForEachObjectProperty(cursor, record, [&](const FbxProperty& name, FbxPropertyCursor& values)
+        {
+            if (name.StringIs("Lcl Translation"))           ReadNumbers(values, model.translation, 3);
+            else if (name.StringIs("Lcl Rotation"))         ReadNumbers(values, model.rotation, 3);
+            else if (name.StringIs("Lcl Scaling"))          ReadNumbers(values, model.scaling, 3);
+            else if (name.StringIs("RotationOffset"))       ReadNumbers(values, model.rotationOffset, 3);
+            else if (name.StringIs("RotationPivot"))        ReadNumbers(values, model.rotationPivot, 3);
+            else if (name.StringIs("ScalingOffset"))        ReadNumbers(values, model.scalingOffset, 3);
+            else if (name.StringIs("ScalingPivot"))         ReadNumbers(values, model.scalingPivot, 3);
+            else if (name.StringIs("PreRotation"))          ReadNumbers(values, model.preRotation, 3);
+            else if (name.StringIs("PostRotation"))         ReadNumbers(values, model.postRotation, 3);
+            else if (name.StringIs("GeometricTranslation")) ReadNumbers(values, model.geometricTranslation, 3);
+            else if (name.StringIs("GeometricRotation"))    ReadNumbers(values, model.geometricRotation, 3);
+            else if (name.StringIs("GeometricScaling"))     ReadNumbers(values, model.geometricScaling, 3);
+            else if (name.StringIs("RotationOrder") || name.StringIs("RotationActive"))
+            {
+                double value = 0.0;
+                ReadNumbers(values, &value, 1);
+                if (name.StringIs("RotationOrder"))
+                    model.rotationOrder = static_cast<int64_t>(value);
+                else
+                    model.rotationActive = value != 0.0;
+            }
+        });
+    }
+
+    FbxMaterial ReadMaterial(const FbxRecordCursor& cursor, const FbxRecord& record)
+    {
+        FbxMaterial material = {};
+        material.name = GetObjectName(record);
+
+        double diffuse[3] = { 1.0, 1.0, 1.0 }, diffuseFactor = 1.0;
+        double specular[3] = {}, specularFactor = 1.0;
+        double exponent = 0.0, opacity = -1.0, transparency = 0.0;
+        ForEachObjectProperty(cursor, record, [&](const FbxProperty& name, FbxPropertyCursor& values)
+        {
+            if (name.StringIs("DiffuseColor"))                                      ReadNumbers(values, diffuse, 3);
+            else if (name.StringIs("DiffuseFactor"))                                ReadNumbers(values, &diffuseFactor, 1);
+            else if (name.StringIs("SpecularColor"))                                ReadNumbers(values, specular, 3);
+            else if (name.StringIs("SpecularFactor"))                               ReadNumbers(values, &specularFactor, 1);
+            else if (name.StringIs("ShininessExponent") || name.StringIs("Shininess"))  ReadNumbers(values, &exponent, 1);
+            else if (name.StringIs("Opacity"))                                      ReadNumbers(values, &opacity, 1);
+            else if (name.StringIs("TransparencyFactor"))                           ReadNumbers(values, &transparency, 1);
+        });
+
+        for (int i = 0; i < 3; ++i)
+        {
+            material.diffuse[i] = static_cast<float>(diffuse[i] * diffuseFactor);
+            material.specular[i] = static_cast<float>(specular[i] * specularFactor);
+        }
+        material.specularExponent = static_cast<float>(exponent);
+
+        // Opacity is what Maya and 3ds Max write when they know it; TransparencyFactor alone
+        // is often left at 1 on opaque materials, so it only counts without Opacity.
+        material.opacity = static_cast<float>(opacity >= 0.0 ? opacity : 1.0 - transparency);
+        return material;
+    }
+
+    std::string ReadTextureFile(const FbxRecordCursor& cursor, const FbxRecord& record)
+    {
+        std::string file = GetChildString(cursor, record, "RelativeFilename");
+        return file.empty() ? GetChildString(cursor, record, "FileName") : file;
+    }
+
+    AxisSystem ReadAxisSystem(const FbxRecordCursor& cursor, const FbxRecord& record)
+    {
+        // Y up, Z toward the viewer and X to the right, as this project uses.
+        double values[6] = { 1.0, 1.0, 2.0, 1.0, 0.0, 1.0 };
+        ForEachObjectProperty(cursor, record, [&](const FbxProperty& name, FbxPropertyCursor& properties)
+        {
+            static const char* const c_names[6] = { "UpAxis", "UpAxisSign", "FrontAxis", "FrontAxisSign", "CoordAxis", "CoordAxisSign" };
+            for (int i = 0; i < 6; ++i)
+            {
+                if (name.StringIs(c_names[i]))
+                {
+                    ReadNumbers(properties, &values[i], 1);
+                }
+            }
+        });
+
+        AxisSystem axes;
+        axes.axis[0] = static_cast<int64_t>(values[4]);
+        axes.axis[1] = static_cast<int64_t>(values[0]);
+        axes.axis[2] = static_cast<int64_t>(values[2]);
+        axes.sign[0] = values[5] < 0.0 ? -1.0 : 1.0;
+        axes.sign[1] = values[1] < 0.0 ? -1.0 : 1.0;
+        axes.sign[2] = values[3] < 0.0 ? -1.0 : 1.0;
+
+        // Anything but a permutation of the axes is ignored.
+        bool used[3] = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            if (axes.axis[i] < 0 || axes.axis[i] > 2 || used[axes.axis[i]])
+            {
+                return AxisSystem{ { 0, 1, 2 }, { 1.0, 1.0, 1.0 } };
+            }
+            used[axes.axis[i]] = true;
+        }
+        return axes;
+    }
+
+    void ReadObjects(const FbxRecordCursor& cursor, const FbxRecord& objects, SceneSource& scene)
+    {
+        FbxRecordCursor children = cursor.GetChildren(objects);
+        FbxRecord record;
+        while (children.Next(record))
+        {
+            if (record.NameIs("Geometry"))
+            {
+                GeometrySource geometry;
+                std::string key = GetObjectKey(record);
+                if (ReadGeometry(cursor, record, key, geometry))
+                {
+                    scene.geometryIndices[key] = static_cast<uint32_t>(scene.geometries.size());
+                    scene.geometries.push_back(std::move(geometry));
+                }
+            }
+            else if (record.NameIs("Model"))
+            {
+                std::string key = GetObjectKey(record);
+                scene.modelIndices[key] = static_cast<uint32_t>(scene.models.size());
+                scene.models.emplace_back();
+                ReadModel(cursor, record, key, scene.models.back());
+
+                // FBX 6 keeps the mesh inside its model.
+                GeometrySource geometry;
+                if (ReadGeometry(cursor, record, key, geometry))
+                {
+                    scene.instances.emplace_back(static_cast<uint32_t>(scene.geometries.size()), static_cast<uint32_t>(scene.models.size() - 1));
+                    scene.geometries.push_back(std::move(geometry));
+                }
+            }
+            else if (record.NameIs("Material"))
+            {
+                scene.materialIndices[GetObjectKey(record)] = static_cast<uint32_t>(scene.materials.size());
+                scene.materials.push_back(ReadMaterial(cursor, record));
+            }
+            else if (record.NameIs("Texture"))
+            {
+                scene.textureFiles[GetObjectKey(record)] = ReadTextureFile(cursor, record);
+            }
+            else if (record.NameIs("GlobalSettings"))
+            {
+                scene.axes = ReadAxisSystem(cursor, record);
+            }
+        }
+    }
+
+    // C records in FBX 7, Connect in FBX 6: type, child, parent and for OP the parent property.
+    void ReadConnections(const FbxRecordCursor& cursor, const FbxRecord& connections, SceneSource& scene)
+    {
+        FbxRecordCursor children = cursor.GetChildren(connections);
+        FbxRecord record;
+        while (children.Next(record))
+        {
+            FbxPropertyCursor properties(record);
+            FbxProperty type, child, parent, property;
+            if (!properties.Next(type) || !properties.Next(child) || !properties.Next(parent))
+            {
+                continue;
+            }
+
+            std::string childKey = GetObjectKey(child);
+            std::string parentKey = GetObjectKey(parent);
+            auto parentModel = scene.modelIndices.find(parentKey);
+
+            if (type.StringIs("OP"))
+            {
+                auto material = scene.materialIndices.find(parentKey);
+                auto texture = scene.textureFiles.find(childKey);
+                if (material != scene.materialIndices.end() && texture != scene.textureFiles.end() &&
+                    properties.Next(property) && property.StringIs("DiffuseColor"))
+                {
+                    scene.materials[material->second].diffuseMap = texture->second;
+                }
+            }
+            else if (parentModel != scene.modelIndices.end())
+            {
+                ModelSource& model = scene.models[parentModel->second];
+                auto geometry = scene.geometryIndices.find(childKey);
+                auto material = scene.materialIndices.find(childKey);
+                if (geometry != scene.geometryIndices.end())
+                {
+                    scene.instances.emplace_back(geometry->second, parentModel->second);
+                }
+                else if (material != scene.materialIndices.end())
+                {
+                    model.materials.push_back(material->second);
+                }
+                else if (scene.textureFiles.count(childKey))
+                {
+                    model.textures.push_back(childKey);
+                }
+                else if (scene.modelIndices.count(childKey))
+                {
+                    scene.models[scene.modelIndices[childKey]].parent = parentKey;
+                }
+            }
+        }
+    }
+
+    // T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1, as the FBX SDK
+    // documents it. Without RotationActive the pre and post rotations do not apply.
+    Affine MakeLocalTransform(const ModelSource& model)
+    {
+        static const double c_zero[3] = {};
+        const double* preRotation = model.rotationActive ? model.preRotation : c_zero;
+        const double* postRotation = model.rotationActive ? model.postRotation : c_zero;
+        int64_t order = model.rotationActive ? model.rotationOrder : 0;
+
+        Affine result = MakeTranslation(model.translation);
+        result = Multiply(result, MakeTranslation(model.rotationOffset));
+        result = Multiply(result, MakeTranslation(model.rotationPivot));
+        result = Multiply(result, MakeRotation(preRotation, 0));
+        result = Multiply(result, MakeRotation(model.rotation, order));
+        result = Multiply(result, MakeRotation(postRotation, 0, true));
+        result = Multiply(result, MakeTranslation(model.rotationPivot, -1.0));
+        result = Multiply(result, MakeTranslation(model.scalingOffset));
+        result = Multiply(result, MakeTranslation(model.scalingPivot));
+        result = Multiply(result, MakeScaling(model.scaling));
+        return Multiply(result, MakeTranslation(model.scalingPivot, -1.0));
+    }
+
+    // File space to this project's, then the model and its parents, then the geometric
+    // transform, which applies to the mesh alone.
+    Affine MakeMeshTransform(const SceneSource& scene, uint32_t modelIndex)
+    {
+        const ModelSource& model = scene.models[modelIndex];
+
+        Affine world = MakeIdentity();
+        const ModelSource* node = &model;
+        for (uint32_t depth = 0; node && depth < c_maxModelDepth; ++depth)
+        {
+            world = Multiply(MakeLocalTransform(*node), world);
+            auto parent = scene.modelIndices.find(node->parent);
+            node = parent == scene.modelIndices.end() ? nullptr : &scene.models[parent->second];
+        }
+
+        Affine axes = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            axes.m[i][scene.axes.axis[i]] = scene.axes.sign[i];
+        }
+
+        Affine geometric = Multiply(MakeTranslation(model.geometricTranslation), MakeRotation(model.geometricRotation, 0));
+        geometric = Multiply(geometric, MakeScaling(model.geometricScaling));
+        return Multiply(Multiply(axes, world), geometric);
+    }
+
+    // Arrays are a single array property in FBX 7, and one number property per element in
+    // FBX 6. Throws std::runtime_error if the record is malformed.
+    template<typename T>
+    bool DecodeArray(const FbxRecord& record, std::vector<T>& values)
+    {
+        FbxPropertyCursor properties(record);
+        FbxProperty property;
+        if (!properties.Next(property))
+        {
+            values.clear();
+            return true;
+        }
+        if (property.IsArray())
+        {
+            return property.ReadArray(values);
+        }
+
+        values.resize(record.propertyCount);
+        size_t count = 0;
+        do
+        {
+            if (!property.IsNumber())
+            {
+                return false;
+            }
+            values[count++] = property.type == FbxPropertyType_Float || property.type == FbxPropertyType_Double ?
+                static_cast<T>(property.number) : static_cast<T>(property.integer);
+        } while (properties.Next(property));
+        return count == values.size();
+    }
+
+    struct ArrayJob
+    {
+        const FbxRecord*        record;
+        std::vector<double>*    numbers;
+        std::vector<int32_t>*   integers;
+        size_t                  bytes;
+        size_t                  compressedBytes;
+        size_t                  decodedBytes;
+        bool                    failed;
+    };
+
+    void AddJob(std::vector<ArrayJob>& jobs, const FbxRecord& record, std::vector<double>* numbers, std::vector<int32_t>* integers)
+    {
+        ArrayJob job = {};
+        job.record = &record;
+        job.numbers = numbers;
+        job.integers = integers;
+        job.bytes = record.propertiesEnd - record.properties;
+        jobs.push_back(job);
+    }
+
+    void RunJob(ArrayJob& job)
+    {
+        try
+        {
+            FbxProperty property;
+            FbxPropertyCursor properties(*job.record);
+            if (job.record->propertyCount == 1 && properties.Next(property) && property.compressed)
+            {
+                job.compressedBytes = property.size;
+            }
+
+            job.failed = job.numbers ? !DecodeArray(*job.record, *job.numbers) : !DecodeArray(*job.record, *job.integers);
+            job.decodedBytes = job.numbers ? job.numbers->size() * sizeof(double) : job.integers->size() * sizeof(int32_t);
+        }
+        catch (const std::exception&)
+        {
+            job.failed = true;
+        }
+    }
+
+    size_t HashVertex(const MeshVertex& vertex)
+    {
+        static_assert(sizeof(MeshVertex) == 32, "HashVertex reads MeshVertex as eight words");
+        uint32_t words[8];
+        memcpy(words, &vertex, sizeof(words));
+        uint64_t hash = 0;
+        for (uint32_t word : words)
+        {
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
+
+    // Shares vertices that are identical to the bit, numbering them in order of first use.
+    class VertexTable
+    {
+    public:
+        explicit VertexTable(size_t expected) : m_slots(std::max<size_t>(64, NextPowerOfTwo(expected * 2)), UINT32_MAX) {}
+
+        uint32_t Insert(const MeshVertex& vertex, std::vector<MeshVertex>& vertices)
+        {
+            size_t mask = m_slots.size() - 1;
+            for (size_t slot = HashVertex(vertex) & mask;; slot = (slot + 1) & mask)
+            {
+                uint32_t index = m_slots[slot];
+                if (index == UINT32_MAX)
+                {
+                    index = static_cast<uint32_t>(vertices.size());
+                    m_slots[slot] = index;
+                    vertices.push_back(vertex);
+                    if (vertices.size() * 2 > m_slots.size())
+                    {
+                        Grow(vertices);
+                    }
+                    return index;
+                }
+                if (memcmp(&vertices[index], &vertex, sizeof(MeshVertex)) == 0)
+                {
+                    return index;
+                }
+            }
+        }
+
+    private:
+        static size_t NextPowerOfTwo(size_t value)
+        {
+            size_t result = 1;
+            while (result < value)
+            {
+                result *= 2;
+            }
+            return result;
+        }
+
+        void Grow(const std::vector<MeshVertex>& vertices)
+        {
+            m_slots.assign(m_slots.size() * 2, UINT32_MAX);
+            size_t mask = m_slots.size() - 1;
+            for (uint32_t index = 0; index < vertices.size(); ++index)
+            {
+                size_t slot = HashVertex(vertices[index]) & mask;
+                while (m_slots[slot] != UINT32_MAX)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                m_slots[slot] = index;
+            }
+        }
+
+        std::vector<uint32_t> m_slots;
+    };
+
+    // The element of a layer a polygon corner uses, or -1.
+    int64_t GetLayerElement(const LayerSource& layer, const std::vector<int32_t>& indices, size_t corner, size_t controlPoint, size_t polygon)
+    {
+        size_t element;
+        switch (layer.mapping)
+        {
+        case LayerMapping_PolygonVertex:    element = corner; break;
+        case LayerMapping_ControlPoint:     element = controlPoint; break;
+        case LayerMapping_Polygon:          element = polygon; break;
+        case LayerMapping_AllSame:          element = 0; break;
+        default:                            return -1;
+        }
+
+        if (!layer.indexed)
+        {
+            return static_cast<int64_t>(element);
+        }
+        return element < indices.size() ? indices[element] : -1;
+    }
+
+    // One instance of a geometry, built on its own; triangles are grouped by material in
+    // order of first use.
+    struct MeshPiece
+    {
+        MeshData                                            mesh;
+        std::vector<std::pair<int32_t, std::vector<uint32_t>>> groups;
+        bool                                                failed;
+    };
+
+    void BuildPiece(const SceneSource& scene, const GeometrySource& geometry, uint32_t modelIndex, MeshPiece& piece)
+    {
+        const ModelSource& model = scene.models[modelIndex];
+        Affine transform = MakeMeshTransform(scene, modelIndex);
+        Affine normalTransform = MakeNormalTransform(transform);
+        bool flip = Determinant(transform) < 0.0;
+
+        size_t controlPoints = geometry.positionData.size() / 3;
+        const std::vector<int32_t>& polygons = geometry.polygonData;
+        bool hasNormals = geometry.normals.mapping != LayerMapping_None;
+
+        VertexTable table(polygons.size());
+        std::vector<uint32_t> polygon;
+        size_t polygonIndex = 0;
+        int32_t groupMaterial = INT32_MIN;
+        std::vector<uint32_t>* group = nullptr;
+
+        for (size_t corner = 0; corner < polygons.size(); ++corner)
+        {
+            int32_t value = polygons[corner];
+            bool last = value < 0;
+            size_t controlPoint = static_cast<size_t>(last ? ~value : value);
+            if (controlPoint >= controlPoints)
+            {
+                piece.failed = true;
+                return;
+            }
+
+            MeshVertex vertex = {};
+            TransformPoint(transform, &geometry.positionData[controlPoint * 3], vertex.position);
+
+            int64_t normal = GetLayerElement(geometry.normals, geometry.normalIndexData, corner, controlPoint, polygonIndex);
+            if (normal >= 0 && static_cast<size_t>(normal) * 3 + 2 < geometry.normalData.size())
+            {
+                TransformNormal(normalTransform, &geometry.normalData[normal * 3], vertex.normal);
+            }
+
+            int64_t texcoord = GetLayerElement(geometry.texcoords, geometry.texcoordIndexData, corner, controlPoint, polygonIndex);
+            if (texcoord >= 0 && static_cast<size_t>(texcoord) * 2 + 1 < geometry.texcoordData.size())
+            {
+                vertex.texcoord[0] = static_cast<float>(geometry.texcoordData[texcoord * 2]);
+                vertex.texcoord[1] = static_cast<float>(1.0 - geometry.texcoordData[texcoord * 2 + 1]);
+            }
+
+            polygon.push_back(table.Insert(vertex, piece.mesh.vertices));
+            if (!last)
+            {
+                continue;
+            }
+
+            int64_t materialElement = GetLayerElement(geometry.materials, geometry.materialData, corner, controlPoint, polygonIndex);
+            int32_t material = -1;
+            if (materialElement >= 0 && static_cast<size_t>(materialElement) < geometry.materialData.size())
+            {
+                int32_t local = geometry.materialData[materialElement];
+                material = local >= 0 && static_cast<size_t>(local) < model.materials.size() ? static_cast<int32_t>(model.materials[local]) : -1;
+            }
+            else if (!model.materials.empty())
+            {
+                material = static_cast<int32_t>(model.materials[0]);
+            }
+
+            if (material != groupMaterial)
+            {
+                groupMaterial = material;
+                group = nullptr;
+                for (auto& existing : piece.groups)
+                {
+                    if (existing.first == material)
+                    {
+                        group = &existing.second;
+                    }
+                }
+                if (!group)
+                {
+                    piece.groups.emplace_back(material, std::vector<uint32_t>());
+                    group = &piece.groups.back().second;
+                }
+            }
+
+            for (size_t i = 2; i < polygon.size(); ++i)
+            {
+                group->push_back(polygon[0]);
+                group->push_back(polygon[flip ? i : i - 1]);
+                group->push_back(polygon[flip ? i - 1 : i]);
+            }
+            polygon.clear();
+            polygonIndex++;
+        }
+
+        if (!hasNormals)
+        {
+            for (auto& existing : piece.groups)
+            {
+                piece.mesh.indices.insert(piece.mesh.indices.end(), existing.second.begin(), existing.second.end());
+            }
+            ComputeVertexNormals(piece.mesh);
+            piece.mesh.indices.clear();
+        }
+    }
+
+    void ParallelFor(WorkerPool* workers, uint32_t count, const std::function<void(uint32_t)>& function)
+    {
+        if (workers)
+        {
+            workers->ParallelFor(count, function);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                function(i);
+            }
+        }
+    }
+
+    double SecondsSince(Clock::time_point& start)
+    {
+        Clock::time_point now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - start).count();
+        start = now;
+        return seconds;
+    }
+}
+
+DX::FbxModel DX::LoadFbxModel(const std::string& path, WorkerPool* workers, FbxLoadStatistics* statistics)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point phase = start;
+    FbxLoadStatistics stats = {};
+
+    FbxFile file(path);
+    stats.fileBytes = file.GetSize();
+
+    // One pass over the records, keeping references to the arrays meshes use. GlobalSettings
+    // is a top-level record in FBX 7 and inside Objects in FBX 6.
+    SceneSource scene = {};
+    scene.axes = AxisSystem{ { 0, 1, 2 }, { 1.0, 1.0, 1.0 } };
+    FbxRecordCursor records = file.GetRecords();
+    FbxRecordCursor cursor = records;
+    FbxRecord record, connections = {};
+    bool hasConnections = false;
+    while (records.Next(record))
+    {
+        if (record.NameIs("Objects"))
+        {
+            ReadObjects(cursor, record, scene);
+        }
+        else if (record.NameIs("GlobalSettings"))
+        {
+            scene.axes = ReadAxisSystem(cursor, record);
+        }
+        else if (record.NameIs("Connections"))
+        {
+            connections = record;
+            hasConnections = true;
+        }
+    }
+    if (hasConnections)
+    {
+        ReadConnections(cursor, connections, scene);
+    }
+
+    // A geometry no model uses is not drawn.
+    std::vector<bool> used(scene.geometries.size(), false);
+    for (const auto& instance : scene.instances)
+    {
+        used[instance.first] = true;
+    }
+
+    // FBX 6 models name their diffuse texture through LayerElementTexture instead.
+    for (const auto& instance : scene.instances)
+    {
+        const GeometrySource& geometry = scene.geometries[instance.first];
+        const ModelSource& model = scene.models[instance.second];
+        if (geometry.textureId >= 0 && static_cast<size_t>(geometry.textureId) < model.textures.size())
+        {
+            for (uint32_t material : model.materials)
+            {
+                if (scene.materials[material].diffuseMap.empty())
+                {
+                    scene.materials[material].diffuseMap = scene.textureFiles[model.textures[geometry.textureId]];
+                }
+            }
+        }
+    }
+    stats.scanSeconds = SecondsSince(phase);
+
+    // Decoding, largest arrays first so that the last ones to finish are short.
+    std::vector<ArrayJob> jobs;
+    for (size_t i = 0; i < scene.geometries.size(); ++i)
+    {
+        GeometrySource& geometry = scene.geometries[i];
+        if (!used[i])
+        {
+            continue;
+        }
+        AddJob(jobs, geometry.vertices, &geometry.positionData, nullptr);
+        AddJob(jobs, geometry.polygonVertexIndex, nullptr, &geometry.polygonData);
+        if (geometry.normals.mapping != LayerMapping_None)
+        {
+            AddJob(jobs, geometry.normals.values, &geometry.normalData, nullptr);
+            if (geometry.normals.indexed)
+                AddJob(jobs, geometry.normals.indices, nullptr, &geometry.normalIndexData);
+        }
+        if (geometry.texcoords.mapping != LayerMapping_None)
+        {
+            AddJob(jobs, geometry.texcoords.values, &geometry.texcoordData, nullptr);
+            if (geometry.texcoords.indexed)
+                AddJob(jobs, geometry.texcoords.indices, nullptr, &geometry.texcoordIndexData);
+        }
+        if (geometry.materials.mapping != LayerMapping_None)
+        {
+            AddJob(jobs, geometry.materials.values, nullptr, &geometry.materialData);
+        }
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const ArrayJob& a, const ArrayJob& b) { return a.bytes > b.bytes; });
+
+    ParallelFor(workers, static_cast<uint32_t>(jobs.size()), [&](uint32_t i) { RunJob(jobs[i]); });
+    for (const ArrayJob& job : jobs)
+    {
+        if (job.failed)
+        {
+            throw std::runtime_error("Corrupt FBX array " + std::string(job.record->name, job.record->nameLength) + " in " + path);
+        }
+        stats.compressedBytes += job.compressedBytes;
+        stats.decodedBytes += job.decodedBytes;
+    }
+    stats.arrays = static_cast<uint32_t>(jobs.size());
+    stats.geometries = static_cast<uint32_t>(scene.instances.size());
+    stats.inflateSeconds = SecondsSince(phase);
+
+    // Each instance on its own, then joined in file order.
+    std::vector<MeshPiece> pieces(scene.instances.size());
+    ParallelFor(workers, static_cast<uint32_t>(pieces.size()), [&](uint32_t i)
+    {
+        BuildPiece(scene, scene.geometries[scene.instances[i].first], scene.instances[i].second, pieces[i]);
+    });
+    scene.geometries.clear();
+
+    FbxModel model;
+    model.mesh.name = path;
+    model.materials = std::move(scene.materials);
+    for (MeshPiece& piece : pieces)
+    {
+        if (piece.failed)
+        {
+            throw std::runtime_error("Invalid vertex index in " + path);
+        }
+
+        // Each piece is released once it is in, so the mesh is held about twice at most.
+        uint32_t baseVertex = static_cast<uint32_t>(model.mesh.vertices.size());
+        if (baseVertex == 0)
+        {
+            model.mesh.vertices.swap(piece.mesh.vertices);
+        }
+        else
+        {
+            model.mesh.vertices.insert(model.mesh.vertices.end(), piece.mesh.vertices.begin(), piece.mesh.vertices.end());
+        }
+        piece.mesh = MeshData();
+
+        for (auto& group : piece.groups)
+        {
+            uint32_t offset = static_cast<uint32_t>(model.mesh.indices.size());
+            for (uint32_t index : group.second)
+            {
+                model.mesh.indices.push_back(baseVertex + index);
+            }
+
+            uint32_t count = static_cast<uint32_t>(group.second.size());
+            if (!model.subsets.empty() && model.subsets.back().material == group.first)
+            {
+                model.subsets.back().indexCount += count;
+            }
+            else if (count > 0)
+            {
+                model.subsets.push_back(FbxSubset{ offset, count, group.first });
+            }
+            group.second = std::vector<uint32_t>();
+        }
+    }
+    stats.buildSeconds = SecondsSince(phase);
+    stats.totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (statistics)
+    {
+        *statistics = stats;
+    }
+    return model;
+}
@@ -0,0 +1,169 @@
+//
+// FbxReader.h - Streaming binary FBX reader over a memory mapped file
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "WorkerPool.h"
+
+namespace DX
+{
+    // One node record, in place in the file. Nothing is copied or decoded until asked for.
+    struct FbxRecord
+    {
+        const char*     name;
+        uint32_t        nameLength;
+        uint32_t        propertyCount;
+        const uint8_t*  properties;
+        const uint8_t*  propertiesEnd;
+        const uint8_t*  children;           // Equal to end when the record has none.
+        const uint8_t*  end;
+
+        bool NameIs(const char* text) const;
+    };
+
+    // Property type codes, as they appear in the file.
+    enum FbxPropertyType : char
+    {
+        FbxPropertyType_Int16 = 'Y',
+        FbxPropertyType_Bool = 'C',
+        FbxPropertyType_Int32 = 'I',
+        FbxPropertyType_Float = 'F',
+        FbxPropertyType_Double = 'D',
+        FbxPropertyType_Int64 = 'L',
+        FbxPropertyType_FloatArray = 'f',
+        FbxPropertyType_DoubleArray = 'd',
+        FbxPropertyType_Int64Array = 'l',
+        FbxPropertyType_Int32Array = 'i',
+        FbxPropertyType_BoolArray = 'b',
+        FbxPropertyType_String = 'S',
+        FbxPropertyType_Raw = 'R',
+    };
+
+    // A property, in place. Scalars are decoded; strings point into the file; arrays say where
+    // their elements are and whether they are zlib compressed.
+    struct FbxProperty
+    {
+        FbxPropertyType type;
+        int64_t         integer;            // Int16, Bool, Int32 and Int64.
+        double          number;             // Float and Double, and the integers converted.
+        const uint8_t*  data;               // String and raw bytes, or array contents.
+        uint32_t        size;               // Bytes at data.
+        uint32_t        arrayLength;        // Elements, for arrays.
+        bool            compressed;         // Array contents are a zlib stream.
+
+        bool IsArray() const;
+        bool IsNumber() const;
+        uint32_t GetElementSize() const;    // For arrays.
+        std::string GetString() const;
+        bool StringIs(const char* text) const;
+
+        // Copies the elements of a numeric array into values, converting as needed and
+        // inflating if compressed. Returns false if the property is not a numeric array or
+        // its contents are corrupt.
+        bool ReadArray(std::vector<double>& values) const;
+        bool ReadArray(std::vector<int32_t>& values) const;
+    };
+
+    // Steps through a run of sibling records. Throws std::runtime_error on a record that does
+    // not fit inside its parent.
+    class FbxRecordCursor
+    {
+    public:
+        // Record end offsets count from fileBegin.
+        FbxRecordCursor(const uint8_t* fileBegin, const uint8_t* begin, const uint8_t* end, bool wideHeaders);
+
+        // Moves to the next record, returning false at the end of the run.
+        bool Next(FbxRecord& record);
+
+        FbxRecordCursor GetChildren(const FbxRecord& record) const;
+
+        // The first child with the given name; false if there is none.
+        bool FindChild(const FbxRecord& record, const char* name, FbxRecord& child) const;
+
+    private:
+        const uint8_t*  m_fileBegin;
+        const uint8_t*  m_next;
+        const uint8_t*  m_end;
+        bool            m_wideHeaders;      // 64-bit offsets and counts, from version 7500.
+    };
+
+    // Steps through the properties of a record. Throws std::runtime_error on a property that
+    // does not fit inside the record.
+    class FbxPropertyCursor
+    {
+    public:
+        explicit FbxPropertyCursor(const FbxRecord& record);
+
+        bool Next(FbxProperty& property);
+
+    private:
+        const uint8_t*  m_next;
+        const uint8_t*  m_end;
+        uint32_t        m_remaining;
+    };
+
+    // The file, mapped, with its header checked. Throws std::runtime_error if the file cannot
+    // be read or is not binary FBX.
+    class FbxFile
+    {
+    public:
+        explicit FbxFile(const std::string& path);
+
+        uint32_t GetVersion() const             { return m_version; }
+        size_t GetSize() const                  { return m_file.GetSize(); }
+
+        // The top-level records: FBXHeaderExtension, GlobalSettings, Objects, Connections and so on.
+        FbxRecordCursor GetRecords() const;
+
+    private:
+        MappedFile  m_file;
+        uint32_t    m_version;
+    };
+
+    struct FbxMaterial
+    {
+        std::string     name;
+        float           diffuse[3];
+        float           specular[3];
+        float           specularExponent;
+        float           opacity;
+        std::string     diffuseMap;         // As the texture's RelativeFilename gives it.
+    };
+
+    // A run of triangles drawn with one material.
+    struct FbxSubset
+    {
+        uint32_t        indexOffset;
+        uint32_t        indexCount;
+        int32_t         material;           // Into FbxModel::materials; -1 for none.
+    };
+
+    struct FbxModel
+    {
+        MeshData                    mesh;
+        std::vector<FbxMaterial>    materials;
+        std::vector<FbxSubset>      subsets;
+    };
+
+    struct FbxLoadStatistics
+    {
+        size_t      fileBytes;
+        size_t      compressedBytes;    // Of the arrays that were read.
+        size_t      decodedBytes;       // The same arrays, inflated.
+        uint32_t    arrays;
+        uint32_t    geometries;
+        double      scanSeconds;        // Walking the records and picking out what is needed.
+        double      inflateSeconds;
+        double      buildSeconds;
+        double      totalSeconds;
+    };
+
+    // Reads every mesh in the file into one, with its model transforms applied and the axes
+    // the file's GlobalSettings describe converted to this project's Y-up. Handles FBX 6
+    // (meshes inside Model records) and FBX 7 (Geometry records linked by Connections). Only
+    // the arrays meshes use are decoded, on the pool when there is one.
+    FbxModel LoadFbxModel(const std::string& path, WorkerPool* workers = nullptr, FbxLoadStatistics* statistics = nullptr);
+}
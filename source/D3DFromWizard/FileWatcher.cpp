@@ -0,0 +1,313 @@
+//
+// FileWatcher.cpp - Reports files modified under a set of directories
+//
+
+#include "pch.h"
+#include "FileWatcher.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <ctype.h>
+#include <string.h>
+
+std::string DX::NormalizePath(const std::string& path)
+{
+    std::string result = path;
+    for (char& c : result)
+    {
+        if (c == '\\')
+        {
+            c = '/';
+        }
+#if defined(_WIN32)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+#endif
+    }
+
+    while (result.size() > 1 && result.back() == '/')
+    {
+        result.pop_back();
+    }
+
+    return result;
+}
+
+#if defined(_WIN32)
+
+namespace
+{
+    std::wstring Widen(const std::string& value)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, nullptr, 0);
+        std::wstring result(length > 0 ? length - 1 : 0, L'\0');
+        if (length > 1)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, &result[0], length);
+        }
+        return result;
+    }
+
+    std::string Narrow(const wchar_t* value, size_t count)
+    {
+        int length = WideCharToMultiByte(CP_UTF8, 0, value, static_cast<int>(count), nullptr, 0, nullptr, nullptr);
+        std::string result(length, '\0');
+        if (length > 0)
+        {
+            WideCharToMultiByte(CP_UTF8, 0, value, static_cast<int>(count), &result[0], length, nullptr, nullptr);
+        }
+        return result;
+    }
+
+    const DWORD c_notifyFilter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+};
+
+struct DX::FileWatcher::Watch
+{
+    std::string     directory;
+    HANDLE          handle;
+    OVERLAPPED      overlapped;
+    DWORD           buffer[8192];
+
+    bool Issue()
+    {
+        return ReadDirectoryChangesW(handle, buffer, sizeof(buffer), TRUE, c_notifyFilter, nullptr, &overlapped, nullptr) != 0;
+    }
+};
+
+DX::FileWatcher::FileWatcher()
+{
+}
+
+DX::FileWatcher::~FileWatcher()
+{
+    for (Watch* watch : m_watches)
+    {
+        CancelIoEx(watch->handle, &watch->overlapped);
+        DWORD bytes = 0;
+        GetOverlappedResult(watch->handle, &watch->overlapped, &bytes, TRUE);
+        CloseHandle(watch->handle);
+        CloseHandle(watch->overlapped.hEvent);
+        delete watch;
+    }
+}
+
+bool DX::FileWatcher::AddDirectory(const std::string& directory)
+{
+    if (m_events.size() >= MAXIMUM_WAIT_OBJECTS)
+    {
+        return false;
+    }
+
+    HANDLE handle = CreateFileW(Widen(directory).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    std::unique_ptr<Watch> watch(new Watch());
+    watch->directory = NormalizePath(directory);
+    watch->handle = handle;
+    watch->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    if (!watch->overlapped.hEvent || !watch->Issue())
+    {
+        if (watch->overlapped.hEvent)
+        {
+            CloseHandle(watch->overlapped.hEvent);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+
+    m_events.push_back(watch->overlapped.hEvent);
+    m_watches.push_back(watch.release());
+    return true;
+}
+
+bool DX::FileWatcher::WaitForChanges(uint32_t timeoutMilliseconds, std::vector<std::string>& changedPaths)
+{
+    if (m_events.empty())
+    {
+        Sleep(timeoutMilliseconds);
+        return false;
+    }
+
+    DWORD result = WaitForMultipleObjects(static_cast<DWORD>(m_events.size()), m_events.data(), FALSE, timeoutMilliseconds);
+    if (result == WAIT_TIMEOUT || result == WAIT_FAILED)
+    {
+        return false;
+    }
+
+    bool found = false;
+    for (Watch* watch : m_watches)
+    {
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(watch->handle, &watch->overlapped, &bytes, FALSE))
+        {
+            continue;
+        }
+
+        // Zero bytes means the buffer overflowed and the individual changes were lost.
+        const uint8_t* cursor = reinterpret_cast<const uint8_t*>(watch->buffer);
+        while (bytes > 0)
+        {
+            auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(cursor);
+
+            if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                std::string name = Narrow(info->FileName, info->FileNameLength / sizeof(wchar_t));
+                changedPaths.push_back(NormalizePath(watch->directory + "/" + name));
+                found = true;
+            }
+
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            cursor += info->NextEntryOffset;
+        }
+
+        ResetEvent(watch->overlapped.hEvent);
+        watch->Issue();
+    }
+
+    return found;
+}
+
+#else
+
+struct DX::FileWatcher::Watch
+{
+    std::string     directory;
+    int             descriptor;
+};
+
+DX::FileWatcher::FileWatcher() :
+    m_inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+}
+
+DX::FileWatcher::~FileWatcher()
+{
+    for (Watch* watch : m_watches)
+    {
+        delete watch;
+    }
+
+    if (m_inotify >= 0)
+    {
+        close(m_inotify);
+    }
+}
+
+// inotify is not recursive, so every subdirectory gets its own watch.
+bool DX::FileWatcher::AddDirectory(const std::string& directory)
+{
+    if (m_inotify < 0)
+    {
+        return false;
+    }
+
+    int descriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    Watch* watch = new Watch();
+    watch->directory = NormalizePath(directory);
+    watch->descriptor = descriptor;
+    m_watches.push_back(watch);
+
+    if (DIR* dir = opendir(directory.c_str()))
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            if (entry->d_type == DT_DIR && strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            {
+                AddDirectory(watch->directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+
+    return true;
+}
+
+bool DX::FileWatcher::WaitForChanges(uint32_t timeoutMilliseconds, std::vector<std::string>& changedPaths)
+{
+    if (m_inotify < 0)
+    {
+        usleep(timeoutMilliseconds * 1000);
+        return false;
+    }
+
+    pollfd descriptor = { m_inotify, POLLIN, 0 };
+    if (poll(&descriptor, 1, static_cast<int>(timeoutMilliseconds)) <= 0)
+    {
+        return false;
+    }
+
+    bool found = false;
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    for (;;)
+    {
+        ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            break;
+        }
+
+        for (char* cursor = buffer; cursor < buffer + length; )
+        {
+            auto event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            std::string directory;
+            for (const Watch* watch : m_watches)
+            {
+                if (watch->descriptor == event->wd)
+                {
+                    directory = watch->directory;
+                    break;
+                }
+            }
+
+            if (directory.empty())
+            {
+                continue;
+            }
+
+            std::string path = directory + "/" + event->name;
+
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    AddDirectory(path);
+                }
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                changedPaths.push_back(path);
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+#endif
@@ -0,0 +1,46 @@
+//
+// FileWatcher.h - Reports files modified under a set of directories
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Uses ReadDirectoryChangesW on Windows and inotify on Linux. Not thread safe; the hot
+    // reloader owns one and only touches it from its worker thread.
+    class FileWatcher
+    {
+    public:
+        FileWatcher();
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        // Watches directory and everything below it. Returns false if it cannot be watched.
+        bool AddDirectory(const std::string& directory);
+
+        // Blocks for up to timeoutMilliseconds for changes and appends the normalized paths of
+        // files that were written, created or renamed into place. Returns true if any were found.
+        bool WaitForChanges(uint32_t timeoutMilliseconds, std::vector<std::string>& changedPaths);
+
+    private:
+        struct Watch;
+
+        std::vector<Watch*> m_watches;
+
+#if defined(_WIN32)
+        std::vector<HANDLE> m_events;
+#else
+        int                 m_inotify;
+#endif
+    };
+
+    // Forward slashes, no trailing slash, lower case on case-insensitive file systems.
+    // Used as the key when matching change notifications to registered assets.
+    std::string NormalizePath(const std::string& path);
+}
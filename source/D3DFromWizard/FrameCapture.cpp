@@ -0,0 +1,394 @@
+//
+// FrameCapture.cpp - Streams captured frames to disk as raw RGBA, PNG files or a Y4M video
+//
+
+#include "pch.h"
+#include "FrameCapture.h"
+#include "Platform.h"
+
+#include <chrono>
+
+namespace
+{
+    inline double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+bool DX::ParseCaptureFormat(const char* name, CaptureFormat& format)
+{
+    if (strcmp(name, "raw") == 0)       format = CaptureFormat_Raw;
+    else if (strcmp(name, "png") == 0)  format = CaptureFormat_Png;
+    else if (strcmp(name, "y4m") == 0)  format = CaptureFormat_Y4m;
+    else                                return false;
+    return true;
+}
+
+DX::FrameCapture::FrameCapture() :
+    m_capturing(false),
+    m_file(nullptr),
+    m_streamWidth(0),
+    m_streamHeight(0),
+    m_headerPending(false),
+    m_stopping(false),
+    m_nextSequence(0),
+    m_writeSequence(0),
+    m_statistics{}
+{
+    for (Slot& slot : m_slots)
+    {
+        slot.state = SlotState_Free;
+    }
+}
+
+DX::FrameCapture::~FrameCapture()
+{
+    Stop();
+}
+
+bool DX::FrameCapture::Start(const CaptureDesc& desc)
+{
+    Stop();
+
+    if (desc.format != CaptureFormat_Png && (fopen_s(&m_file, desc.path.c_str(), "wb") != 0 || !m_file))
+    {
+        m_file = nullptr;
+        return false;
+    }
+
+    m_desc = desc;
+    m_streamWidth = m_streamHeight = 0;
+    m_headerPending = desc.format == CaptureFormat_Y4m;
+    m_stopping = false;
+    m_nextSequence = m_writeSequence = 0;
+    m_statistics = FrameCaptureStatistics{};
+
+    for (uint32_t i = 0; i < desc.encodeThreads; ++i)
+    {
+        m_encoders.emplace_back(&FrameCapture::EncodeMain, this, i);
+    }
+    if (desc.encodeThreads > 0)
+    {
+        m_writer = std::thread(&FrameCapture::WriterMain, this);
+    }
+
+    m_capturing = true;
+    return true;
+}
+
+void DX::FrameCapture::Stop()
+{
+    if (!m_capturing)
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_drained.wait(lock, [this] { return m_writeSequence == m_nextSequence; });
+        m_stopping = true;
+    }
+    m_encodeWake.notify_all();
+    m_writeWake.notify_all();
+
+    for (std::thread& encoder : m_encoders)
+    {
+        encoder.join();
+    }
+    m_encoders.clear();
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+
+    for (Slot& slot : m_slots)
+    {
+        slot.state = SlotState_Free;
+        std::vector<uint8_t>().swap(slot.pixels);
+        std::vector<uint8_t>().swap(slot.encoded);
+    }
+    m_memory.Release();
+
+    m_capturing = false;
+}
+
+bool DX::FrameCapture::SubmitPixels(const void* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+    const char* path)
+{
+    if (!m_capturing)
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Streams have one size; the first frame decides it.
+    bool accepted = true;
+    if (m_desc.format != CaptureFormat_Png)
+    {
+        if (m_streamWidth == 0)
+        {
+            m_streamWidth = width;
+            m_streamHeight = height;
+        }
+        accepted = width == m_streamWidth && height == m_streamHeight;
+    }
+
+    Slot* slot = nullptr;
+    if (accepted)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto findFree = [&]
+        {
+            for (Slot& candidate : m_slots)
+            {
+                if (candidate.state == SlotState_Free)
+                {
+                    slot = &candidate;
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        if (m_desc.waitWhenFull)
+            m_drained.wait(lock, findFree);
+        else
+            findFree();
+
+        if (slot)
+        {
+            slot->state = SlotState_Filling;
+        }
+    }
+
+    if (slot)
+    {
+        size_t rowBytes = size_t(width) * 4;
+        size_t capacity = slot->pixels.capacity();
+        slot->pixels.resize(rowBytes * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            memcpy(slot->pixels.data() + y * rowBytes, static_cast<const uint8_t*>(pixels) + size_t(y) * rowPitch, rowBytes);
+        }
+        slot->width = width;
+        slot->height = height;
+        slot->format = format;
+        slot->path = path ? path : "";
+
+        if (slot->pixels.capacity() != capacity)
+        {
+            UpdateMemoryTracking();
+        }
+    }
+
+    if (slot && m_desc.encodeThreads == 0)
+    {
+        slot->sequence = m_nextSequence++;
+
+        auto encodeStart = std::chrono::steady_clock::now();
+        Encode(*slot);
+        double encodeSeconds = SecondsSince(encodeStart);
+
+        auto writeStart = std::chrono::steady_clock::now();
+        bool written = Write(*slot);
+        double writeSeconds = SecondsSince(writeStart);
+
+        if (m_desc.onWritten)
+        {
+            m_desc.onWritten(slot->sequence, written);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.encodeSeconds += encodeSeconds;
+        m_statistics.writeSeconds += writeSeconds;
+        m_statistics.written += written;
+        m_statistics.dropped += !written;
+        m_statistics.bytesWritten += written ? slot->encoded.size() : 0;
+        m_writeSequence++;
+        slot->state = SlotState_Free;
+    }
+    else if (slot)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot->sequence = m_nextSequence++;
+        slot->state = SlotState_Queued;
+        m_encodeWake.notify_one();
+    }
+
+    double seconds = SecondsSince(start);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.submitted++;
+    m_statistics.dropped += !slot;
+    m_statistics.submitSeconds += seconds;
+    m_statistics.maxSubmitSeconds = std::max(m_statistics.maxSubmitSeconds, seconds);
+    return slot != nullptr;
+}
+
+DX::FrameCaptureStatistics DX::FrameCapture::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void DX::FrameCapture::EncodeMain(uint32_t index)
+{
+    char name[32];
+    sprintf_s(name, "Capture encode %u", index);
+    SetCurrentThreadName(name);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        // Oldest first, so the writer is not kept waiting on a frame that was passed over.
+        Slot* slot = nullptr;
+        m_encodeWake.wait(lock, [&]
+        {
+            for (Slot& candidate : m_slots)
+            {
+                if (candidate.state == SlotState_Queued && (!slot || candidate.sequence < slot->sequence))
+                    slot = &candidate;
+            }
+            return slot || m_stopping;
+        });
+
+        if (!slot)
+        {
+            return;
+        }
+
+        slot->state = SlotState_Encoding;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        Encode(*slot);
+        double seconds = SecondsSince(start);
+
+        lock.lock();
+        slot->state = SlotState_Encoded;
+        m_statistics.encodeSeconds += seconds;
+        m_writeWake.notify_one();
+    }
+}
+
+void DX::FrameCapture::WriterMain()
+{
+    SetCurrentThreadName("Capture writer");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        Slot* slot = nullptr;
+        m_writeWake.wait(lock, [&]
+        {
+            for (Slot& candidate : m_slots)
+            {
+                if (candidate.state == SlotState_Encoded && candidate.sequence == m_writeSequence)
+                    slot = &candidate;
+            }
+            return slot || m_stopping;
+        });
+
+        if (!slot)
+        {
+            return;
+        }
+
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        bool written = Write(*slot);
+        double seconds = SecondsSince(start);
+
+        if (m_desc.onWritten)
+        {
+            m_desc.onWritten(slot->sequence, written);
+        }
+
+        lock.lock();
+        m_statistics.writeSeconds += seconds;
+        m_statistics.written += written;
+        m_statistics.dropped += !written;
+        m_statistics.bytesWritten += written ? slot->encoded.size() : 0;
+        slot->state = SlotState_Free;
+        m_writeSequence++;
+        m_drained.notify_all();
+    }
+}
+
+void DX::FrameCapture::Encode(Slot& slot)
+{
+    slot.encoded.clear();
+
+    uint32_t rowPitch = slot.width * 4;
+    switch (m_desc.format)
+    {
+    case CaptureFormat_Raw:
+        ConvertToRgba(slot.pixels.data(), slot.width, slot.height, rowPitch, slot.format, slot.encoded);
+        break;
+
+    case CaptureFormat_Png:
+        EncodePng(slot.pixels.data(), slot.width, slot.height, rowPitch, slot.format, slot.encoded);
+        break;
+
+    case CaptureFormat_Y4m:
+        EncodeY4mFrame(slot.pixels.data(), slot.width, slot.height, rowPitch, slot.format, slot.encoded);
+        break;
+    }
+}
+
+// Only ever called for one frame at a time, in sequence order.
+bool DX::FrameCapture::Write(Slot& slot)
+{
+    if (m_desc.format == CaptureFormat_Png)
+    {
+        std::string path = slot.path;
+        if (path.empty())
+        {
+            char suffix[32];
+            sprintf_s(suffix, "%06llu.png", static_cast<unsigned long long>(slot.sequence));
+            path = m_desc.path + suffix;
+        }
+
+        FILE* file = nullptr;
+        if (fopen_s(&file, path.c_str(), "wb") != 0 || !file)
+        {
+            return false;
+        }
+
+        bool written = fwrite(slot.encoded.data(), 1, slot.encoded.size(), file) == slot.encoded.size();
+        return fclose(file) == 0 && written;
+    }
+
+    if (m_headerPending)
+    {
+        std::vector<uint8_t> header;
+        EncodeY4mHeader(m_streamWidth, m_streamHeight, m_desc.framesPerSecond, header);
+        if (fwrite(header.data(), 1, header.size(), m_file) != header.size())
+        {
+            return false;
+        }
+        m_headerPending = false;
+    }
+
+    return fwrite(slot.encoded.data(), 1, slot.encoded.size(), m_file) == slot.encoded.size();
+}
+
+// The frame buffers only grow on the submitting thread, which is the only one to call this.
+void DX::FrameCapture::UpdateMemoryTracking()
+{
+    uint64_t bytes = 0;
+    for (const Slot& slot : m_slots)
+    {
+        bytes += slot.pixels.capacity();
+    }
+    m_memory.Track(MemoryCategory_General, bytes, "frame capture");
+}
@@ -0,0 +1,146 @@
+//
+// FrameCapture.h - Streams captured frames to disk as raw RGBA, PNG files or a Y4M video
+//
+
+#pragma once
+
+#include "ImageEncoding.h"
+#include "MemoryTracker.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace DX
+{
+    enum CaptureFormat
+    {
+        CaptureFormat_Raw,      // One file of tightly packed RGBA frames.
+        CaptureFormat_Png,      // One file per frame.
+        CaptureFormat_Y4m,      // One YUV4MPEG2 4:2:0 stream, which ffmpeg and most players read.
+    };
+
+    // "raw", "png" or "y4m".
+    bool ParseCaptureFormat(const char* name, CaptureFormat& format);
+
+    // Frames waiting for or going through the encoders. Frames beyond this are dropped rather
+    // than making the game wait.
+    const uint32_t c_maxQueuedCaptureFrames = 8;
+
+    struct CaptureDesc
+    {
+        // Raw and Y4M: the output file. PNG: a prefix, frames go to <path>000000.png onwards.
+        std::string     path;
+        CaptureFormat   format;
+        uint32_t        framesPerSecond;    // Written into the Y4M header.
+
+        // Threads converting and compressing frames. Zero encodes and writes each frame on the
+        // submitting thread, which is only useful as a baseline.
+        uint32_t        encodeThreads;
+
+        // Offline rendering: SubmitPixels waits for a free buffer instead of dropping the frame.
+        bool            waitWhenFull;
+
+        // Optional. Called on the writing thread once a frame is on disk, or failed to get there,
+        // with the frame's position among the accepted frames.
+        std::function<void(uint64_t sequence, bool written)> onWritten;
+    };
+
+    struct FrameCaptureStatistics
+    {
+        uint64_t    submitted;
+        uint64_t    written;
+        uint64_t    dropped;            // Queue full, a size change in a raw or Y4M stream, or a failed write.
+        uint64_t    bytesWritten;
+        double      submitSeconds;      // On the submitting thread: the cost to the game.
+        double      maxSubmitSeconds;
+        double      encodeSeconds;      // Summed over the encode threads.
+        double      writeSeconds;
+    };
+
+    // A pipeline of three stages: the game thread copies pixels into one of a fixed set of
+    // frame buffers, encode threads convert and compress them in any order, and one writer
+    // thread puts them on disk in submission order. Nothing is allocated per frame once the
+    // buffers have grown to the frame size.
+    //
+    // Pixels come from wherever the backend can read them without waiting: a mapped staging
+    // texture from D3D11FrameReadback, or the headless CPU framebuffer directly.
+    class FrameCapture
+    {
+    public:
+        FrameCapture();
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        // Opens the output; false if it cannot be created. Stops any capture in progress.
+        bool Start(const CaptureDesc& desc);
+
+        // Encodes and writes everything submitted so far, then closes the output and frees the
+        // frame buffers.
+        void Stop();
+
+        bool IsCapturing() const                { return m_capturing; }
+
+        // Copies a frame into the pipeline and returns at once. Returns false if it was dropped.
+        // A PNG capture writes the frame to path if one is given, instead of the next numbered
+        // file.
+        bool SubmitPixels(const void* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+            const char* path = nullptr);
+
+        FrameCaptureStatistics GetStatistics() const;
+
+    private:
+        enum SlotState
+        {
+            SlotState_Free,
+            SlotState_Filling,
+            SlotState_Queued,
+            SlotState_Encoding,
+            SlotState_Encoded,
+        };
+
+        struct Slot
+        {
+            SlotState               state;
+            uint64_t                sequence;
+            uint32_t                width;
+            uint32_t                height;
+            PixelFormat             format;
+            std::string             path;       // Empty for a numbered file.
+            std::vector<uint8_t>    pixels;     // Tightly packed.
+            std::vector<uint8_t>    encoded;
+        };
+
+        void EncodeMain(uint32_t index);
+        void WriterMain();
+        void Encode(Slot& slot);
+        bool Write(Slot& slot);
+        void UpdateMemoryTracking();
+
+        CaptureDesc                 m_desc;
+        bool                        m_capturing;
+        FILE*                       m_file;             // Raw and Y4M.
+        uint32_t                    m_streamWidth;      // Fixed by the first frame of a stream.
+        uint32_t                    m_streamHeight;
+        bool                        m_headerPending;    // Y4M.
+
+        std::vector<std::thread>    m_encoders;
+        std::thread                 m_writer;
+        mutable std::mutex          m_mutex;
+        std::condition_variable     m_encodeWake;
+        std::condition_variable     m_writeWake;
+        std::condition_variable     m_drained;          // A frame was written and its buffer freed.
+        bool                        m_stopping;
+
+        Slot                        m_slots[c_maxQueuedCaptureFrames];
+        uint64_t                    m_nextSequence;     // Given to the next submitted frame.
+        uint64_t                    m_writeSequence;    // Next frame to write.
+
+        FrameCaptureStatistics      m_statistics;
+        TrackedMemory               m_memory;
+    };
+}
@@ -0,0 +1,295 @@
+//
+// FramePacer.cpp - Frame rate limiting, latency reduction and input-to-present measurement
+//
+
+#include "pch.h"
+#include "FramePacer.h"
+
+#include <math.h>
+#include <thread>
+
+#if defined(_WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+    // Weight of the newest sample in the smoothed work and refresh estimates.
+    const double c_smoothing = 0.1;
+
+    // A present this far past its deadline counts as a missed frame.
+    const double c_missTolerance = 0.0005;
+
+    inline double ToSeconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    inline uint64_t ToNanoseconds(std::chrono::steady_clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    inline std::chrono::steady_clock::duration FromSeconds(double seconds)
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    }
+};
+
+DX::PreciseWaiter::PreciseWaiter() :
+    m_wakeLatency(0.001)
+{
+#if defined(_WIN32)
+    // High resolution timers exist from Windows 10 1803; older systems fall back to Sleep.
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+DX::PreciseWaiter::~PreciseWaiter()
+{
+#if defined(_WIN32)
+    if (m_timer)
+    {
+        CloseHandle(m_timer);
+    }
+#endif
+}
+
+void DX::PreciseWaiter::Sleep(Clock::duration duration)
+{
+#if defined(_WIN32)
+    if (m_timer)
+    {
+        LARGE_INTEGER due;
+        due.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 100);
+        if (SetWaitableTimer(m_timer, &due, 0, nullptr, nullptr, FALSE))
+        {
+            WaitForSingleObject(m_timer, INFINITE);
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_for(duration);
+}
+
+void DX::PreciseWaiter::WaitUntil(Clock::time_point deadline, double& sleepSeconds, double& spinSeconds)
+{
+    auto now = Clock::now();
+    double remaining = ToSeconds(deadline - now);
+
+    if (remaining > m_wakeLatency)
+    {
+        double requested = remaining - m_wakeLatency;
+        Sleep(FromSeconds(requested));
+
+        auto woke = Clock::now();
+        double slept = ToSeconds(woke - now);
+        sleepSeconds += slept;
+
+        // Grow quickly when woken late so the next wait does not overshoot, shrink slowly.
+        double oversleep = std::max(slept - requested, 0.0);
+        double rate = oversleep > m_wakeLatency ? 0.5 : 0.05;
+        m_wakeLatency += rate * (oversleep - m_wakeLatency);
+        m_wakeLatency = std::max(m_wakeLatency, 0.00005);
+
+        now = woke;
+    }
+
+    auto spinStart = now;
+    while (now < deadline)
+    {
+        std::this_thread::yield();
+        now = Clock::now();
+    }
+
+    spinSeconds += ToSeconds(now - spinStart);
+}
+
+DX::FramePacer::FramePacer() :
+    m_mode(FramePacing_VSync),
+    m_lowLatency(false),
+    m_targetPeriod(1.0 / 60.0),
+    m_safetyMargin(0.001),
+    m_hasDeadline(false),
+    m_hasLastPresent(false),
+    m_frameStartReady(false),
+    m_workAverage(0.0),
+    m_workDeviation(0.0),
+    m_hasWorkEstimate(false),
+    m_presentPeriod(1.0 / 60.0),
+    m_hasPendingInput(false),
+    m_hasFrameInput(false),
+    m_statistics{}
+{
+    m_frameStart = Clock::now();
+}
+
+void DX::FramePacer::SetTargetFramesPerSecond(double framesPerSecond)
+{
+    m_targetPeriod = framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0;
+    m_hasDeadline = false;
+}
+
+void DX::FramePacer::OnInput()
+{
+    OnInput(Clock::now());
+}
+
+void DX::FramePacer::OnInput(Clock::time_point timestamp)
+{
+    if (!m_hasPendingInput || timestamp < m_pendingInput)
+    {
+        m_pendingInput = timestamp;
+        m_hasPendingInput = true;
+    }
+}
+
+DX::FramePacer::Clock::time_point DX::FramePacer::NextDeadline(Clock::time_point now) const
+{
+    if (m_mode == FramePacing_FixedRate)
+    {
+        return m_deadline;
+    }
+
+    // Extrapolate the vertical blank phase from the last present that DXGI blocked on.
+    auto period = FromSeconds(m_presentPeriod);
+    auto deadline = m_lastPresent + period;
+    while (deadline < now)
+    {
+        deadline += period;
+    }
+    return deadline;
+}
+
+bool DX::FramePacer::WaitForFrameStart()
+{
+    if (m_frameStartReady)
+    {
+        return false;
+    }
+
+    m_frameStartReady = true;
+
+    auto now = Clock::now();
+
+    if (m_mode == FramePacing_FixedRate && (!m_hasDeadline || m_targetPeriod <= 0.0))
+    {
+        m_deadline = now + FromSeconds(m_targetPeriod);
+        m_hasDeadline = true;
+    }
+
+    bool canPredict = (m_mode == FramePacing_FixedRate && m_targetPeriod > 0.0)
+        || (m_mode == FramePacing_VSync && m_hasLastPresent);
+
+    if (!m_lowLatency || !canPredict)
+    {
+        return false;
+    }
+
+    double work = m_workAverage + 2.0 * m_workDeviation + m_safetyMargin;
+    auto start = NextDeadline(now) - FromSeconds(work);
+    if (start <= now)
+    {
+        return false;
+    }
+
+    m_waiter.WaitUntil(start, m_statistics.sleepSeconds, m_statistics.spinSeconds);
+    return true;
+}
+
+void DX::FramePacer::BeginFrame()
+{
+    WaitForFrameStart();
+    m_frameStartReady = false;
+
+    m_frameStart = Clock::now();
+
+    m_hasFrameInput = m_hasPendingInput;
+    m_frameInput = m_pendingInput;
+    m_hasPendingInput = false;
+}
+
+void DX::FramePacer::WaitForPresent()
+{
+    auto now = Clock::now();
+
+    double work = ToSeconds(now - m_frameStart);
+    if (!m_hasWorkEstimate)
+    {
+        m_workAverage = work;
+        m_hasWorkEstimate = true;
+    }
+    else
+    {
+        m_workDeviation += c_smoothing * (fabs(work - m_workAverage) - m_workDeviation);
+        m_workAverage += c_smoothing * (work - m_workAverage);
+    }
+    m_statistics.predictedWorkSeconds = m_workAverage + 2.0 * m_workDeviation;
+
+    if (m_mode == FramePacing_FixedRate && m_targetPeriod > 0.0)
+    {
+        if (now < m_deadline)
+        {
+            m_waiter.WaitUntil(m_deadline, m_statistics.sleepSeconds, m_statistics.spinSeconds);
+        }
+        else if (ToSeconds(now - m_deadline) > c_missTolerance)
+        {
+            m_statistics.missedDeadlines++;
+        }
+    }
+}
+
+void DX::FramePacer::EndFrame()
+{
+    auto now = Clock::now();
+
+    if (m_hasLastPresent)
+    {
+        double interval = ToSeconds(now - m_lastPresent);
+        m_frameInterval.Record(ToNanoseconds(now - m_lastPresent));
+
+        // Only presents that actually blocked say anything about the refresh period; skip
+        // frames that ran long and straddled several blanks.
+        if (m_mode == FramePacing_VSync && interval < 1.5 * m_presentPeriod)
+        {
+            m_presentPeriod += c_smoothing * (interval - m_presentPeriod);
+        }
+    }
+
+    m_lastPresent = now;
+    m_hasLastPresent = true;
+
+    if (m_hasFrameInput)
+    {
+        m_inputLatency.Record(ToNanoseconds(now - m_frameInput));
+        m_hasFrameInput = false;
+    }
+
+    if (m_mode == FramePacing_FixedRate && m_hasDeadline)
+    {
+        // Keep a steady cadence, but do not try to catch up after falling a whole frame behind.
+        auto period = FromSeconds(m_targetPeriod);
+        m_deadline += period;
+        if (m_deadline < now)
+        {
+            m_deadline = now + period;
+        }
+    }
+
+    m_statistics.frames++;
+}
+
+void DX::FramePacer::Resynchronize()
+{
+    m_hasDeadline = false;
+    m_hasLastPresent = false;
+    m_frameStartReady = false;
+}
+
+void DX::FramePacer::ResetStatistics()
+{
+    m_inputLatency.Reset();
+    m_frameInterval.Reset();
+
+    m_statistics = FramePacerStatistics{};
+}
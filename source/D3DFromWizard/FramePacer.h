@@ -0,0 +1,139 @@
+//
+// FramePacer.h - Frame rate limiting, latency reduction and input-to-present measurement
+//
+
+#pragma once
+
+#include "Histogram.h"
+
+#include <chrono>
+
+namespace DX
+{
+    enum FramePacingMode
+    {
+        FramePacing_Uncapped,       // Present(0, 0), never wait.
+        FramePacing_VSync,          // Present(1, 0), DXGI blocks until the vertical blank.
+        FramePacing_FixedRate,      // Present(0, 0) on a fixed deadline kept by this class.
+    };
+
+    struct FramePacerStatistics
+    {
+        uint64_t    frames;
+        uint64_t    missedDeadlines;    // Fixed rate frames that presented after their deadline.
+        double      sleepSeconds;       // Time given back to the OS while waiting.
+        double      spinSeconds;        // Time burned spinning after the last sleep.
+        double      predictedWorkSeconds;
+    };
+
+    // Sleeps through most of a wait and spins for the remainder, learning how late the OS
+    // wakes the thread so the spin stays as short as possible.
+    class PreciseWaiter
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        PreciseWaiter();
+        ~PreciseWaiter();
+
+        PreciseWaiter(const PreciseWaiter&) = delete;
+        PreciseWaiter& operator=(const PreciseWaiter&) = delete;
+
+        void WaitUntil(Clock::time_point deadline, double& sleepSeconds, double& spinSeconds);
+
+    private:
+        void Sleep(Clock::duration duration);
+
+        double  m_wakeLatency;      // Estimated oversleep, in seconds.
+
+#if defined(_WIN32)
+        HANDLE  m_timer;
+#endif
+    };
+
+    // Call BeginFrame before Update, WaitForPresent immediately before Present and EndFrame
+    // immediately after it. Only std::chrono is used, so pacing and the latency figures work
+    // the same without a window or swap chain.
+    //
+    // In low latency mode the frame is held back until just enough time remains to do the
+    // predicted amount of work before the next deadline (the fixed rate deadline, or the next
+    // vertical blank extrapolated from earlier presents). A message loop should call
+    // WaitForFrameStart, drain its queue, then run the frame, so input that arrives during the
+    // wait is seen by this frame's Update rather than the next one.
+    class FramePacer
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        FramePacer();
+
+        void SetMode(FramePacingMode mode)                  { m_mode = mode; }
+        FramePacingMode GetMode() const                     { return m_mode; }
+
+        void SetTargetFramesPerSecond(double framesPerSecond);
+        void SetLowLatency(bool enable)                     { m_lowLatency = enable; }
+
+        // Extra time left on top of the predicted work in low latency mode.
+        void SetSafetyMarginSeconds(double seconds)         { m_safetyMargin = seconds; }
+
+        // The sync interval to pass to Present for the current mode.
+        uint32_t GetSyncInterval() const                    { return m_mode == FramePacing_VSync ? 1 : 0; }
+
+        // Records the arrival of user input. The oldest input not yet consumed by a frame is
+        // what the input-to-present latency of that frame is measured from.
+        void OnInput();
+        void OnInput(Clock::time_point timestamp);
+
+        // Returns true if it waited, in which case pending input should be processed before
+        // BeginFrame. Further calls return false until the frame has begun.
+        bool WaitForFrameStart();
+
+        // Waits if WaitForFrameStart was not called, then starts timing the frame.
+        void BeginFrame();
+        void WaitForPresent();
+        void EndFrame();
+
+        // Forget the deadline and vertical blank phase, e.g. after a resize or a long stall.
+        void Resynchronize();
+
+        // In nanoseconds.
+        const Histogram& GetInputLatency() const            { return m_inputLatency; }
+        const Histogram& GetFrameInterval() const           { return m_frameInterval; }
+        const FramePacerStatistics& GetStatistics() const   { return m_statistics; }
+        void ResetStatistics();
+
+    private:
+        Clock::time_point NextDeadline(Clock::time_point now) const;
+
+        FramePacingMode         m_mode;
+        bool                    m_lowLatency;
+        double                  m_targetPeriod;
+        double                  m_safetyMargin;
+
+        PreciseWaiter           m_waiter;
+
+        Clock::time_point       m_frameStart;
+        Clock::time_point       m_lastPresent;
+        Clock::time_point       m_deadline;
+        bool                    m_hasDeadline;
+        bool                    m_hasLastPresent;
+        bool                    m_frameStartReady;
+
+        // Smoothed duration of BeginFrame -> WaitForPresent and its mean deviation.
+        double                  m_workAverage;
+        double                  m_workDeviation;
+        bool                    m_hasWorkEstimate;
+
+        // Smoothed interval between presents, used as the refresh period in vsync mode.
+        double                  m_presentPeriod;
+
+        Clock::time_point       m_pendingInput;
+        Clock::time_point       m_frameInput;
+        bool                    m_hasPendingInput;
+        bool                    m_hasFrameInput;
+
+        Histogram               m_inputLatency;
+        Histogram               m_frameInterval;
+        FramePacerStatistics    m_statistics;
+    };
+}
@@ -0,0 +1,579 @@
+//
+// FrameTelemetry.cpp - Per-frame timing histograms, hitch counting and periodic export
+//
+
+#include "pch.h"
+#include "FrameTelemetry.h"
+#include "Platform.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+
+namespace
+{
+    // Weight of the newest frame in the average hitches are measured against.
+    const double c_frameSmoothing = 0.05;
+
+    // How long a dump may wait for a socket reader that stopped reading before it is dropped,
+    // so a stuck dashboard can never hold up StopDump.
+    const int c_socketSendTimeoutMilliseconds = 100;
+
+    const char* c_channelNames[DX::TelemetryChannel_Count] =
+    {
+        "update",
+        "render",
+        "present",
+        "frame",
+    };
+
+    const char* c_domainNames[DX::TelemetryDomain_Count] =
+    {
+        "cpu",
+        "gpu",
+    };
+
+    const char* GetDomainName(int domain, bool gpuEmulated)
+    {
+        return domain == DX::TelemetryDomain_Gpu && gpuEmulated ? "gpu-emulated" : c_domainNames[domain];
+    }
+
+    inline double ToSeconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    inline double NanosecondsToMilliseconds(uint64_t nanoseconds)
+    {
+        return static_cast<double>(nanoseconds) * 1e-6;
+    }
+
+    DX::TelemetryChannelSummary Summarize(const DX::HistogramSnapshot& snapshot)
+    {
+        DX::TelemetryChannelSummary summary;
+        summary.count = snapshot.count;
+        summary.mean = snapshot.GetMean() * 1e-6;
+        summary.p50 = NanosecondsToMilliseconds(snapshot.GetPercentile(0.50));
+        summary.p95 = NanosecondsToMilliseconds(snapshot.GetPercentile(0.95));
+        summary.p99 = NanosecondsToMilliseconds(snapshot.GetPercentile(0.99));
+        summary.max = NanosecondsToMilliseconds(snapshot.max);
+        return summary;
+    }
+};
+
+const char* DX::GetTelemetryChannelName(TelemetryChannel channel)
+{
+    return channel < TelemetryChannel_Count ? c_channelNames[channel] : "unknown";
+}
+
+DX::FrameTelemetry::FrameTelemetry() :
+    m_scopeCount(0),
+    m_gpuEmulated(false),
+    m_hasLastFrame(false),
+    m_averageFrame(0.0),
+    m_hitchMultiple(2.0),
+    m_hitchMinimum(0.004),
+    m_dumpStopping(false),
+    m_dumpInterval(std::chrono::seconds(1)),
+    m_dumpFormat(TelemetryFormat_Json),
+    m_dumpFile(nullptr),
+    m_dumpHeaderPending(false),
+    m_socket(-1)
+{
+    m_created = Clock::now();
+    Reset();
+
+    for (auto& scope : m_latestScope)
+    {
+        for (std::atomic<uint64_t>& latest : scope)
+        {
+            latest = 0;
+        }
+    }
+
+    for (Histogram& histogram : m_interval.channels)
+    {
+        histogram.Reset();
+    }
+    m_interval.frames = 0;
+    m_interval.hitches = 0;
+    m_interval.updates = 0;
+}
+
+DX::FrameTelemetry::~FrameTelemetry()
+{
+    StopDump();
+}
+
+void DX::FrameTelemetry::Record(TelemetryChannel channel, Clock::duration duration)
+{
+    uint64_t nanoseconds = static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0));
+    m_total.channels[channel].Record(nanoseconds);
+    m_interval.channels[channel].Record(nanoseconds);
+}
+
+void DX::FrameTelemetry::RecordUpdates(uint32_t updates)
+{
+    m_total.updates.fetch_add(updates, std::memory_order_relaxed);
+    m_interval.updates.fetch_add(updates, std::memory_order_relaxed);
+}
+
+uint32_t DX::FrameTelemetry::RegisterScope(const char* name)
+{
+    uint32_t count = m_scopeCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (strncmp(m_scopeNames[i], name, c_maxTelemetryScopeName - 1) == 0)
+        {
+            return i;
+        }
+    }
+
+    if (count == c_maxTelemetryScopes)
+    {
+        throw std::runtime_error(std::string("too many telemetry scopes registering ") + name);
+    }
+
+    strncpy(m_scopeNames[count], name, c_maxTelemetryScopeName - 1);
+    m_scopeNames[count][c_maxTelemetryScopeName - 1] = '\0';
+
+    for (int domain = 0; domain < TelemetryDomain_Count; ++domain)
+    {
+        m_total.scopes[count][domain].reset(new Histogram());
+        m_interval.scopes[count][domain].reset(new Histogram());
+    }
+
+    // Readers on other threads see the name and histograms once they see the new count.
+    m_scopeCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+void DX::FrameTelemetry::RecordScope(uint32_t scope, TelemetryDomain domain, uint64_t nanoseconds)
+{
+    assert(scope < m_scopeCount.load(std::memory_order_relaxed));
+    m_total.scopes[scope][domain]->Record(nanoseconds);
+    m_interval.scopes[scope][domain]->Record(nanoseconds);
+    m_latestScope[scope][domain].store(nanoseconds, std::memory_order_relaxed);
+}
+
+void DX::FrameTelemetry::RecordScope(uint32_t scope, TelemetryDomain domain, Clock::duration duration)
+{
+    RecordScope(scope, domain, static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0)));
+}
+
+double DX::FrameTelemetry::GetLatestScopeSeconds(uint32_t scope, TelemetryDomain domain) const
+{
+    assert(scope < m_scopeCount.load(std::memory_order_relaxed));
+    return m_latestScope[scope][domain].load(std::memory_order_relaxed) * 1.0e-9;
+}
+
+void DX::FrameTelemetry::MarkFrame()
+{
+    auto now = Clock::now();
+
+    if (m_hasLastFrame)
+    {
+        auto duration = now - m_lastFrame;
+        Record(TelemetryChannel_Frame, duration);
+
+        double seconds = ToSeconds(duration);
+        if (m_averageFrame > 0.0 && seconds > m_hitchMultiple * m_averageFrame && seconds > m_hitchMinimum)
+        {
+            m_total.hitches.fetch_add(1, std::memory_order_relaxed);
+            m_interval.hitches.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        m_averageFrame = m_averageFrame > 0.0 ? m_averageFrame + c_frameSmoothing * (seconds - m_averageFrame) : seconds;
+
+        m_total.frames.fetch_add(1, std::memory_order_relaxed);
+        m_interval.frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_lastFrame = now;
+    m_hasLastFrame = true;
+}
+
+void DX::FrameTelemetry::SetHitchThreshold(double hitchMultiple, double hitchMinimumSeconds)
+{
+    m_hitchMultiple = hitchMultiple;
+    m_hitchMinimum = hitchMinimumSeconds;
+}
+
+DX::TelemetrySummary DX::FrameTelemetry::GetSummary() const
+{
+    TelemetrySummary summary = {};
+    auto now = Clock::now();
+    summary.time = ToSeconds(now - m_created);
+    summary.interval = ToSeconds(now - m_resetTime);
+    summary.frames = m_total.frames.load(std::memory_order_relaxed);
+    summary.hitches = m_total.hitches.load(std::memory_order_relaxed);
+    summary.updates = m_total.updates.load(std::memory_order_relaxed);
+
+    HistogramSnapshot snapshot;
+    for (int i = 0; i < TelemetryChannel_Count; ++i)
+    {
+        m_total.channels[i].TakeSnapshot(snapshot);
+        summary.channels[i] = Summarize(snapshot);
+    }
+
+    summary.scopeCount = m_scopeCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < summary.scopeCount; ++i)
+    {
+        memcpy(summary.scopes[i].name, m_scopeNames[i], c_maxTelemetryScopeName);
+        for (int domain = 0; domain < TelemetryDomain_Count; ++domain)
+        {
+            m_total.scopes[i][domain]->TakeSnapshot(snapshot);
+            summary.scopes[i].domains[domain] = Summarize(snapshot);
+        }
+    }
+    summary.gpuEmulated = m_gpuEmulated.load(std::memory_order_relaxed);
+
+    return summary;
+}
+
+// Clears the whole-run figures, e.g. at the end of a warm-up. Not safe against concurrent Record.
+void DX::FrameTelemetry::Reset()
+{
+    for (Histogram& histogram : m_total.channels)
+    {
+        histogram.Reset();
+    }
+
+    uint32_t scopeCount = m_scopeCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < scopeCount; ++i)
+    {
+        for (auto& histogram : m_total.scopes[i])
+        {
+            histogram->Reset();
+        }
+    }
+
+    m_total.frames = 0;
+    m_total.hitches = 0;
+    m_total.updates = 0;
+    m_resetTime = Clock::now();
+}
+
+std::string DX::FrameTelemetry::FormatJson(const TelemetrySummary& summary)
+{
+    char buffer[256];
+    sprintf_s(buffer, "{\"time\":%.3f,\"interval\":%.3f,\"frames\":%llu,\"hitches\":%llu,\"updates\":%llu,\"channels\":{",
+        summary.time, summary.interval, static_cast<unsigned long long>(summary.frames),
+        static_cast<unsigned long long>(summary.hitches), static_cast<unsigned long long>(summary.updates));
+
+    std::string text = buffer;
+    for (int i = 0; i < TelemetryChannel_Count; ++i)
+    {
+        const TelemetryChannelSummary& channel = summary.channels[i];
+        sprintf_s(buffer, "%s\"%s\":{\"count\":%llu,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            i ? "," : "", c_channelNames[i], static_cast<unsigned long long>(channel.count),
+            channel.mean, channel.p50, channel.p95, channel.p99, channel.max);
+        text += buffer;
+    }
+    text += "}";
+
+    if (summary.scopeCount > 0)
+    {
+        text += ",\"scopes\":{";
+        for (uint32_t i = 0; i < summary.scopeCount; ++i)
+        {
+            const TelemetryScopeSummary& scope = summary.scopes[i];
+            text += i ? ",\"" : "\"";
+            text += scope.name;
+            text += "\":{";
+            for (int domain = 0; domain < TelemetryDomain_Count; ++domain)
+            {
+                const TelemetryChannelSummary& channel = scope.domains[domain];
+                sprintf_s(buffer, "%s\"%s\":{\"count\":%llu,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+                    domain ? "," : "", GetDomainName(domain, summary.gpuEmulated), static_cast<unsigned long long>(channel.count),
+                    channel.mean, channel.p50, channel.p95, channel.p99, channel.max);
+                text += buffer;
+            }
+            text += "}";
+        }
+        text += "}";
+    }
+
+    text += "}\n";
+    return text;
+}
+
+std::string DX::FrameTelemetry::FormatCsv(const TelemetrySummary& summary, bool header)
+{
+    std::string text;
+    if (header)
+    {
+        text = "time,interval,frames,hitches,updates,channel,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    }
+
+    char buffer[256];
+    for (int i = 0; i < TelemetryChannel_Count; ++i)
+    {
+        const TelemetryChannelSummary& channel = summary.channels[i];
+        sprintf_s(buffer, "%.3f,%.3f,%llu,%llu,%llu,%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+            summary.time, summary.interval, static_cast<unsigned long long>(summary.frames),
+            static_cast<unsigned long long>(summary.hitches), static_cast<unsigned long long>(summary.updates),
+            c_channelNames[i], static_cast<unsigned long long>(channel.count),
+            channel.mean, channel.p50, channel.p95, channel.p99, channel.max);
+        text += buffer;
+    }
+
+    // Scopes are extra rows named <scope>.<domain>.
+    for (uint32_t i = 0; i < summary.scopeCount; ++i)
+    {
+        for (int domain = 0; domain < TelemetryDomain_Count; ++domain)
+        {
+            const TelemetryChannelSummary& channel = summary.scopes[i].domains[domain];
+            sprintf_s(buffer, "%.3f,%.3f,%llu,%llu,%llu,%s.%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                summary.time, summary.interval, static_cast<unsigned long long>(summary.frames),
+                static_cast<unsigned long long>(summary.hitches), static_cast<unsigned long long>(summary.updates),
+                summary.scopes[i].name, GetDomainName(domain, summary.gpuEmulated), static_cast<unsigned long long>(channel.count),
+                channel.mean, channel.p50, channel.p95, channel.p99, channel.max);
+            text += buffer;
+        }
+    }
+
+    return text;
+}
+
+bool DX::FrameTelemetry::StartFileDump(const std::string& path, TelemetryFormat format, double intervalSeconds)
+{
+    StopDump();
+
+    FILE* file = nullptr;
+    if (fopen_s(&file, path.c_str(), "ab") != 0 || !file)
+    {
+        return false;
+    }
+
+    // Only a new (empty) CSV file gets a header, so appended runs stay one table.
+    fseek(file, 0, SEEK_END);
+    m_dumpHeaderPending = (format == TelemetryFormat_Csv && ftell(file) == 0);
+    m_dumpFile = file;
+    m_dumpFormat = format;
+
+    StartDump(intervalSeconds);
+    return true;
+}
+
+bool DX::FrameTelemetry::StartSocketDump(const std::string& socketPath, double intervalSeconds)
+{
+#if defined(_WIN32)
+    UNREFERENCED_PARAMETER(socketPath);
+    UNREFERENCED_PARAMETER(intervalSeconds);
+    return false;
+#else
+    StopDump();
+
+    sockaddr_un address;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+
+    m_socketPath = socketPath;
+    m_dumpFormat = TelemetryFormat_Json;
+
+    // The reader may not be listening yet; the dump thread keeps trying.
+    ConnectSocket();
+
+    StartDump(intervalSeconds);
+    return true;
+#endif
+}
+
+void DX::FrameTelemetry::StartDump(double intervalSeconds)
+{
+    m_dumpInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(intervalSeconds, 0.01)));
+    m_dumpStopping = false;
+
+    // Start the first interval now rather than at construction.
+    HistogramSnapshot discard;
+    for (Histogram& histogram : m_interval.channels)
+    {
+        histogram.TakeIntervalSnapshot(discard);
+    }
+    uint32_t scopeCount = m_scopeCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < scopeCount; ++i)
+    {
+        for (auto& histogram : m_interval.scopes[i])
+        {
+            histogram->TakeIntervalSnapshot(discard);
+        }
+    }
+    m_interval.frames = 0;
+    m_interval.hitches = 0;
+    m_interval.updates = 0;
+
+    m_dumpThread = std::thread(&FrameTelemetry::DumpMain, this);
+}
+
+void DX::FrameTelemetry::StopDump()
+{
+    if (m_dumpThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_dumpMutex);
+            m_dumpStopping = true;
+        }
+        m_dumpWake.notify_all();
+        m_dumpThread.join();
+    }
+
+    if (m_dumpFile)
+    {
+        fclose(m_dumpFile);
+        m_dumpFile = nullptr;
+    }
+
+    CloseSocket();
+    m_socketPath.clear();
+}
+
+void DX::FrameTelemetry::DumpMain()
+{
+    SetCurrentThreadName("Telemetry dump");
+
+    auto intervalStart = Clock::now();
+    HistogramSnapshot snapshot;
+
+    for (;;)
+    {
+        // A final dump on stop covers the partial interval. The lock covers the wait and taking
+        // the summary; formatting and I/O run without it so StopDump is never held up by them.
+        bool stopping;
+        TelemetrySummary summary = {};
+        {
+            std::unique_lock<std::mutex> lock(m_dumpMutex);
+            stopping = m_dumpWake.wait_until(lock, intervalStart + m_dumpInterval, [this]() { return m_dumpStopping; });
+
+            auto now = Clock::now();
+            summary.time = ToSeconds(now - m_created);
+            summary.interval = ToSeconds(now - intervalStart);
+            summary.frames = m_interval.frames.exchange(0, std::memory_order_relaxed);
+            summary.hitches = m_interval.hitches.exchange(0, std::memory_order_relaxed);
+            summary.updates = m_interval.updates.exchange(0, std::memory_order_relaxed);
+
+            for (int i = 0; i < TelemetryChannel_Count; ++i)
+            {
+                m_interval.channels[i].TakeIntervalSnapshot(snapshot);
+                summary.channels[i] = Summarize(snapshot);
+            }
+
+            summary.scopeCount = m_scopeCount.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < summary.scopeCount; ++i)
+            {
+                memcpy(summary.scopes[i].name, m_scopeNames[i], c_maxTelemetryScopeName);
+                for (int domain = 0; domain < TelemetryDomain_Count; ++domain)
+                {
+                    m_interval.scopes[i][domain]->TakeIntervalSnapshot(snapshot);
+                    summary.scopes[i].domains[domain] = Summarize(snapshot);
+                }
+            }
+            summary.gpuEmulated = m_gpuEmulated.load(std::memory_order_relaxed);
+
+            intervalStart = now;
+        }
+
+        if (m_dumpFormat == TelemetryFormat_Csv)
+        {
+            WriteDump(FormatCsv(summary, m_dumpHeaderPending));
+            m_dumpHeaderPending = false;
+        }
+        else
+        {
+            WriteDump(FormatJson(summary));
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+    }
+}
+
+void DX::FrameTelemetry::WriteDump(const std::string& text)
+{
+    if (m_dumpFile)
+    {
+        fwrite(text.data(), 1, text.size(), m_dumpFile);
+        fflush(m_dumpFile);
+        return;
+    }
+
+#if !defined(_WIN32)
+    if (m_socketPath.empty() || (m_socket < 0 && !ConnectSocket()))
+    {
+        return;
+    }
+
+    const char* data = text.data();
+    size_t remaining = text.size();
+    while (remaining > 0)
+    {
+        ssize_t sent = send(m_socket, data, remaining, MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && remaining == text.size())
+        {
+            // The reader is connected but not keeping up; drop this dump whole.
+            return;
+        }
+        if (sent <= 0)
+        {
+            // The reader went away, or stalled part way through a line that can no longer be
+            // completed; drop this dump and reconnect next time.
+            CloseSocket();
+            return;
+        }
+        data += sent;
+        remaining -= static_cast<size_t>(sent);
+    }
+#endif
+}
+
+bool DX::FrameTelemetry::ConnectSocket()
+{
+#if defined(_WIN32)
+    return false;
+#else
+    CloseSocket();
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, m_socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    timeval timeout = {};
+    timeout.tv_sec = c_socketSendTimeoutMilliseconds / 1000;
+    timeout.tv_usec = (c_socketSendTimeoutMilliseconds % 1000) * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0 ||
+        connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    m_socket = fd;
+    return true;
+#endif
+}
+
+void DX::FrameTelemetry::CloseSocket()
+{
+#if !defined(_WIN32)
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+#endif
+}
@@ -0,0 +1,182 @@
+//
+// FrameTelemetry.h - Per-frame timing histograms, hitch counting and periodic export
+//
+
+#pragma once
+
+#include "Histogram.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+namespace DX
+{
+    enum TelemetryChannel
+    {
+        TelemetryChannel_Update,    // All Update calls made by one Tick.
+        TelemetryChannel_Render,    // Render up to, but not including, the present.
+        TelemetryChannel_Present,   // Frame pacer wait plus Present.
+        TelemetryChannel_Frame,     // Start of one frame to the start of the next.
+        TelemetryChannel_Count
+    };
+
+    const char* GetTelemetryChannelName(TelemetryChannel channel);
+
+    // Where a named scope's time was spent. The CPU side is measured around the code that
+    // records the work, the GPU side is reported by an IGpuTimer frames later.
+    enum TelemetryDomain
+    {
+        TelemetryDomain_Cpu,
+        TelemetryDomain_Gpu,
+        TelemetryDomain_Count
+    };
+
+    const uint32_t c_maxTelemetryScopes = 16;
+    const size_t c_maxTelemetryScopeName = 32;
+
+    // Durations in milliseconds.
+    struct TelemetryChannelSummary
+    {
+        uint64_t    count;
+        double      mean;
+        double      p50;
+        double      p95;
+        double      p99;
+        double      max;
+    };
+
+    struct TelemetryScopeSummary
+    {
+        char                        name[c_maxTelemetryScopeName];
+        TelemetryChannelSummary     domains[TelemetryDomain_Count];
+    };
+
+    struct TelemetrySummary
+    {
+        double                      time;       // Seconds since the telemetry was created.
+        double                      interval;   // Seconds covered by this summary.
+        uint64_t                    frames;
+        uint64_t                    hitches;
+        uint64_t                    updates;
+        TelemetryChannelSummary     channels[TelemetryChannel_Count];
+        uint32_t                    scopeCount;
+        TelemetryScopeSummary       scopes[c_maxTelemetryScopes];
+        bool                        gpuEmulated;    // The GPU domain holds emulated times.
+    };
+
+    enum TelemetryFormat
+    {
+        TelemetryFormat_Csv,        // One row per channel per dump, with a header.
+        TelemetryFormat_Json,       // One JSON object per line per dump.
+    };
+
+    // Frame timings go into two sets of lock-free histograms: one covering the whole run, for
+    // GetSummary, and one that the dump thread drains every interval. Recording never blocks,
+    // so the dump thread's file or socket I/O cannot stall a frame.
+    //
+    // A hitch is a frame that took longer than hitchMultiple times the recent average and at
+    // least hitchMinimumSeconds. Record, RecordScope and RecordUpdates may be called from any
+    // thread; MarkFrame and RegisterScope from the game loop only.
+    //
+    // Named scopes break the render channel down further. Each keeps a CPU and a GPU
+    // histogram under the same name, so the cost of recording a pass and of executing it are
+    // reported side by side.
+    class FrameTelemetry
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        FrameTelemetry();
+        ~FrameTelemetry();
+
+        FrameTelemetry(const FrameTelemetry&) = delete;
+        FrameTelemetry& operator=(const FrameTelemetry&) = delete;
+
+        void Record(TelemetryChannel channel, Clock::duration duration);
+        void Record(TelemetryChannel channel, Clock::time_point start)  { Record(channel, Clock::now() - start); }
+        void RecordUpdates(uint32_t updates);
+
+        // Returns the scope's index; registering a name again returns the same index. Throws
+        // once c_maxTelemetryScopes names exist.
+        uint32_t RegisterScope(const char* name);
+        void RecordScope(uint32_t scope, TelemetryDomain domain, uint64_t nanoseconds);
+        void RecordScope(uint32_t scope, TelemetryDomain domain, Clock::duration duration);
+
+        // The newest time recorded for a scope, zero before the first; for feedback loops
+        // such as dynamic resolution. GPU times are c_gpuTimerLatency frames old.
+        double GetLatestScopeSeconds(uint32_t scope, TelemetryDomain domain) const;
+
+        // Marks the GPU domain as CPU time standing in for GPU time, e.g. HeadlessGpuTimer's.
+        // Summaries then name it "gpu-emulated" rather than "gpu", so the two never get
+        // compared by accident.
+        void SetGpuEmulated(bool emulated)  { m_gpuEmulated.store(emulated, std::memory_order_relaxed); }
+
+        // Call at the start of every frame; records the frame channel and detects hitches.
+        void MarkFrame();
+
+        void SetHitchThreshold(double hitchMultiple, double hitchMinimumSeconds);
+
+        // Everything recorded since construction or the last Reset.
+        TelemetrySummary GetSummary() const;
+        void Reset();
+
+        // Appends a summary of each interval to a file, or streams JSON lines to a listening
+        // UNIX domain socket (reconnecting if the reader goes away, and dropping dumps a reader
+        // that stopped reading does not take in time). Only one dump runs at a time; starting
+        // another replaces it.
+        bool StartFileDump(const std::string& path, TelemetryFormat format, double intervalSeconds);
+        bool StartSocketDump(const std::string& socketPath, double intervalSeconds);
+        void StopDump();
+
+        static std::string FormatJson(const TelemetrySummary& summary);
+        static std::string FormatCsv(const TelemetrySummary& summary, bool header);
+
+    private:
+        struct Counters
+        {
+            Histogram               channels[TelemetryChannel_Count];
+            // Allocated by RegisterScope, before the scope count that publishes them is raised.
+            std::unique_ptr<Histogram>  scopes[c_maxTelemetryScopes][TelemetryDomain_Count];
+            std::atomic<uint64_t>   frames;
+            std::atomic<uint64_t>   hitches;
+            std::atomic<uint64_t>   updates;
+        };
+
+        void StartDump(double intervalSeconds);
+        void DumpMain();
+        void WriteDump(const std::string& text);
+        bool ConnectSocket();
+        void CloseSocket();
+
+        Counters                    m_total;
+        Counters                    m_interval;
+        std::atomic<uint32_t>       m_scopeCount;
+        std::atomic<uint64_t>       m_latestScope[c_maxTelemetryScopes][TelemetryDomain_Count];    // Nanoseconds.
+        char                        m_scopeNames[c_maxTelemetryScopes][c_maxTelemetryScopeName];
+        std::atomic<bool>           m_gpuEmulated;
+        Clock::time_point           m_created;
+        Clock::time_point           m_resetTime;
+
+        Clock::time_point           m_lastFrame;
+        bool                        m_hasLastFrame;
+        double                      m_averageFrame;
+        double                      m_hitchMultiple;
+        double                      m_hitchMinimum;
+
+        // Dump thread state.
+        std::thread                 m_dumpThread;
+        std::mutex                  m_dumpMutex;
+        std::condition_variable     m_dumpWake;
+        bool                        m_dumpStopping;
+        Clock::duration             m_dumpInterval;
+        TelemetryFormat             m_dumpFormat;
+        FILE*                       m_dumpFile;
+        bool                        m_dumpHeaderPending;
+        std::string                 m_socketPath;
+        int                         m_socket;
+    };
+}
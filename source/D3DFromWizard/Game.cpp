@@ -5,34 +5,235 @@
 #include "pch.h"
 #include "Game.h"
 
+#include <chrono>
+
+#if defined(_WIN32)
+#include "D3D11VertexLayout.h"
+
+#include <fstream>
+#include <iterator>
+#endif
+
 extern void ExitGame();
 
+#if defined(_WIN32)
 using namespace DirectX;
 
 using Microsoft::WRL::ComPtr;
+#endif
 
-Game::Game()
+namespace
 {
+#if defined(_WIN32)
+    const char* c_shaderCachePath = "ShaderCache.bin";
+#endif
+    const char* c_shaderDirectory = "shaders";
+
+    // Vertical field of view of the camera projection (XM_PIDIV4).
+    const float c_fieldOfViewY = 3.14159265f / 4.0f;
+
+    // Depth range of the camera projection.
+    const float c_nearPlane = 0.1f;
+    const float c_farPlane = 1000.0f;
+
+    // Frame rate written into Y4M captures, and the threads encoding captured frames.
+    const uint32_t c_captureFramesPerSecond = 60;
+    const uint32_t c_captureEncodeThreads = 2;
+
+    // PNG compression takes longer than rendering a job, so batches keep more threads on it.
+    const uint32_t c_batchEncodeThreads = 4;
+
+    // Preset scene instances cycle through these materials, then through the pixel shaders in
+    // shaders/Scene.hlsl, so drawing the scene also exercises state sorting.
+    const uint32_t c_sceneMaterialCount = 8;
+    const char* const c_scenePixelShaders[] = { "PSDiffuse", "PSSpecular", "PSBanded" };
+
+    // D3D11_BIND_VERTEX_BUFFER and D3D11_BIND_INDEX_BUFFER, which Linux builds lack.
+    const uint32_t c_bindVertexBuffer = 0x1;
+    const uint32_t c_bindIndexBuffer = 0x2;
+
+#if defined(_WIN32)
+    const char* c_sceneShaderPath = "shaders/Scene.hlsl";
+
+    // Must match the cbuffer in shaders/Scene.hlsl.
+    struct SceneConstants
+    {
+        float       worldViewProjection[4][4];
+        float       world[4][4];
+        float       lightDirection[4];
+        uint32_t    material;
+        uint32_t    padding[3];
+    };
+
+    // World space, towards the light: above, to the right and in front of the grid.
+    const float c_sceneLightDirection[4] = { 0.371391f, 0.742781f, -0.557086f, 0.0f };
+
+    constexpr auto c_sceneInputElements = DX::MakeInputElements(DX::c_meshVertexLayout);
+
+    DX::ShaderSource ReadShaderSource(const char* path, const char* entryPoint, const char* target)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error(std::string("Unable to read ") + path);
+        }
+
+        DX::ShaderSource source;
+        source.name = path;
+        source.source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        source.entryPoint = entryPoint;
+        source.target = target;
+        return source;
+    }
+
+    // The scene's shaders from the pipeline cache, and every file they included.
+    struct SceneShaders
+    {
+        ID3D11VertexShader*                 vertexShader;
+        ID3D11InputLayout*                  inputLayout;
+        std::vector<ID3D11PixelShader*>     pixelShaders;
+        std::vector<std::string>            includes;
+    };
+
+    // Thread safe, so the hot reloader can call it on its worker. Throws std::runtime_error if
+    // the shader file cannot be read or does not compile.
+    SceneShaders CompileSceneShaders(DX::D3D11PipelineCache& pipelineCache, const DX::ShaderCache& shaderCache)
+    {
+        std::vector<DX::ShaderSource> sources;
+        sources.push_back(ReadShaderSource(c_sceneShaderPath, "VS", "vs_5_0"));
+        for (const char* entryPoint : c_scenePixelShaders)
+        {
+            sources.push_back(ReadShaderSource(c_sceneShaderPath, entryPoint, "ps_5_0"));
+        }
+
+        SceneShaders shaders = {};
+        shaders.vertexShader = pipelineCache.GetVertexShader(sources[0]);
+        shaders.inputLayout = pipelineCache.GetInputLayout(c_sceneInputElements.elements, c_sceneInputElements.GetCount(), sources[0]);
+        for (size_t i = 1; i < sources.size(); ++i)
+        {
+            shaders.pixelShaders.push_back(pipelineCache.GetPixelShader(sources[i]));
+        }
+
+        for (const DX::ShaderSource& source : sources)
+        {
+            for (const DX::ShaderInclude& include : shaderCache.GetIncludes(source))
+            {
+                if (std::find(shaders.includes.begin(), shaders.includes.end(), include.path) == shaders.includes.end())
+                {
+                    shaders.includes.push_back(include.path);
+                }
+            }
+        }
+        return shaders;
+    }
+#endif
+};
+
+Game::Game() :
+#if !defined(_WIN32)
+    m_outputWidth(0),
+    m_outputHeight(0),
+#endif
+    m_sceneVertices(0),
+    m_sceneIndices(0),
+#if defined(_WIN32)
+    m_sceneVertexBuffer(0),
+    m_sceneIndexBuffer(0),
+#endif
+    m_lodProjectionScale(1.0f)
+{
+#if defined(_WIN32)
+    m_clearScope = m_telemetry.RegisterScope("clear");
+#endif
+    m_renderScope = m_telemetry.RegisterScope("render");
+#if defined(_WIN32)
+    m_upscaleScope = m_telemetry.RegisterScope("upscale");
+#endif
+    m_captureScope = m_telemetry.RegisterScope("capture");
+
+#if defined(_WIN32)
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_shaderCache.SetCompiler(DX::GetD3DShaderCompiler(), DX::GetD3DShaderCompilerId());
+#endif
 }
 
 // Initialize the Direct3D resources required to run.
-void Game::Initialize(HWND window, int width, int height)
+void Game::Initialize(DX::NativeWindowHandle window, int width, int height)
 {
+#if defined(_WIN32)
     m_deviceResources->SetWindow(window, width, height);
 
     m_deviceResources->CreateDeviceResources();
+
+    // A warm start maps the previous run's shader cache instead of compiling everything.
+    auto startupStart = std::chrono::steady_clock::now();
+    bool warmStart = m_shaderCache.Load(c_shaderCachePath);
+
     CreateDeviceDependentResources();
 
+    if (m_shaderCache.IsDirty())
+    {
+        m_shaderCache.Save(c_shaderCachePath);
+    }
+
+    {
+        double startupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startupStart).count();
+        const DX::ShaderCacheStatistics& stats = m_shaderCache.GetStatistics();
+
+        char buff[256] = {};
+        sprintf_s(buff, "Shader cache (%s start): %u hits, %u misses, load %.2f ms, compile %.2f ms, device resources %.2f ms\n",
+            warmStart ? "warm" : "cold", stats.hits, stats.misses, stats.loadSeconds * 1000.0, stats.compileSeconds * 1000.0, startupSeconds * 1000.0);
+        DX::OutputDebugMessage(buff);
+    }
+
     m_deviceResources->CreateWindowSizeDependentResources();
     CreateWindowSizeDependentResources();
+#else
+    // Headless: there is no device, and no display refresh for Present to wait on, so frames
+    // are paced to a fixed rate instead of vsync.
+    (void)window;
+    m_outputWidth = std::max(width, 1);
+    m_outputHeight = std::max(height, 1);
+
+    CreateDeviceDependentResources();
+    CreateWindowSizeDependentResources();
+
+    m_framePacer.SetMode(DX::FramePacing_FixedRate);
+    m_framePacer.SetTargetFramesPerSecond(60);
+#endif
+
+    // Edited shaders are recompiled off the main thread and swapped in at the start of a frame.
+    m_hotReloader.Watch(c_shaderDirectory);
+    m_hotReloader.Start();
+
+    // TODO: Change the frame pacing if you want something other than vsync, e.g. a 120 FPS cap
+    // with the start of each frame delayed to cut input latency:
+    /*
+    m_framePacer.SetMode(DX::FramePacing_FixedRate);
+    m_framePacer.SetTargetFramesPerSecond(120);
+    m_framePacer.SetLowLatency(true);
+    */
+
+    // TODO: Export frame timings for dashboards, e.g. once a second as JSON lines:
+    /*
+    m_telemetry.StartFileDump("telemetry.jsonl", DX::TelemetryFormat_Json, 1.0);
+    */
+
+    // TODO: Set memory budgets to be warned when a category grows past what the target can afford:
+    /*
+    DX::GetMemoryTracker().SetBudget(DX::MemoryCategory_RenderTargets, 256 * 1024 * 1024);
+    DX::GetMemoryTracker().SetBudget(DX::MemoryCategory_DeviceTextures, 512 * 1024 * 1024);
+    */
 
     // TODO: Change the timer settings if you want something other than the default variable timestep mode.
     // e.g. for 60 FPS fixed timestep update logic, call:
     /*
     m_timer.SetFixedTimeStep(true);
     m_timer.SetTargetElapsedSeconds(1.0 / 60);
+    m_timer.SetMaxUpdatesPerTick(4);
+    m_timer.SetMinSimulationQuality(0.5f);
     */
 }
 
@@ -40,21 +241,54 @@ void Game::Initialize(HWND window, int width, int height)
 // Executes the basic game loop.
 void Game::Tick()
 {
+    // Swaps only happen here, between frames, so a frame never sees half a reload.
+    if (m_hotReloader.ApplyPendingReloads() > 0)
+    {
+        m_renderQueue.InvalidateState();
+    }
+
+    m_telemetry.MarkFrame();
+    m_framePacer.BeginFrame();
+
+    auto updateStart = DX::FrameTelemetry::Clock::now();
+
     m_timer.Tick([&]()
     {
         Update(m_timer);
     });
 
+    m_telemetry.Record(DX::TelemetryChannel_Update, updateStart);
+    m_telemetry.RecordUpdates(m_timer.GetMetrics().lastTickUpdates);
+
     Render();
 }
 
+bool Game::WaitForNextFrame()
+{
+    return m_framePacer.WaitForFrameStart();
+}
+
 // Updates the world.
 void Game::Update(DX::StepTimer const& timer)
 {
     float elapsedTime = float(timer.GetElapsedSeconds());
 
-    // TODO: Add your game logic here.
-    elapsedTime;
+    // TODO: Add your game logic here, as systems over the components of m_entities, e.g.
+    /*
+    m_entities.ParallelForEachChunk<Position, const Velocity>(m_workers,
+        [=](uint32_t count, const DX::Entity*, Position* positions, const Velocity* velocities)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            positions[i].x += velocities[i].x * elapsedTime;
+        }
+    });
+    */
+    (void)elapsedTime;
+
+    // Entities created, destroyed or changed by the systems above through
+    // m_entities.GetCommandBuffer() are moved between chunks here, after every system has run.
+    m_entities.PlaybackCommands();
 }
 #pragma endregion
 
@@ -68,40 +302,125 @@ void Game::Render()
         return;
     }
 
+    auto renderStart = DX::FrameTelemetry::Clock::now();
+    m_gpuTimer->BeginFrame();
+
+    // The scene resolution follows the newest render time of the CPU or the GPU, whichever is
+    // slower. TODO: Change the budget with m_dynamicResolution.SetDesc, e.g. for a 120 FPS cap.
+    m_dynamicResolution.Update(std::max(m_telemetry.GetLatestScopeSeconds(m_renderScope, DX::TelemetryDomain_Cpu),
+        m_telemetry.GetLatestScopeSeconds(m_renderScope, DX::TelemetryDomain_Gpu)));
+
+#if defined(_WIN32)
     Clear();
 
     m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
+#endif
+    {
+        // Each PIX scope is also timed on the CPU and the GPU; the times appear under the
+        // scope's name in the telemetry. Add scopes with m_telemetry.RegisterScope.
+        DX::ScopedFrameTimer scopeTimer(m_telemetry, m_gpuTimer.get(), m_renderScope);
+
+#if defined(_WIN32)
+        auto context = m_deviceResources->GetD3DDeviceContext();
+
+        // TODO: Add your rendering code here. The scene target is bound with a viewport of
+        // m_dynamicResolution's render size.
+        // With lights in m_lights, assign them to clusters before drawing with them, e.g.
+        //   m_lightClusters.Build(m_lights.data(), static_cast<uint32_t>(m_lights.size()), view, &m_workers);
+        // then upload GetClusters() and GetLightIndices() for shaders/ClusteredLighting.hlsli.
+        // For cooked meshes pick the index range with DX::SelectLod(mesh, distance, m_lodProjectionScale).
+        // In fixed timestep mode, blend the previous and current simulation state by m_timer.GetInterpolationAlpha().
+        context;
+#endif
+
+        // A preset scene culls its instances and their clusters, and queues draws of what is left.
+        if (m_scene)
+        {
+#if defined(_WIN32)
+            auto viewport = m_deviceResources->GetScreenViewport();
+            float aspectRatio = viewport.Width / viewport.Height;
+#else
+            float aspectRatio = static_cast<float>(m_outputWidth) / static_cast<float>(m_outputHeight);
+#endif
+            m_scene->Render(m_timer.GetFrameCount(), aspectRatio, m_lodProjectionScale, m_renderQueue);
+#if defined(_WIN32)
+            ID3D11Buffer* constants = m_sceneConstants.Get();
+            context->VSSetConstantBuffers(0, 1, &constants);
+            context->PSSetConstantBuffers(0, 1, &constants);
+#endif
+        }
+
+        // Draw packets queued above are sorted by state and issued with redundant bindings removed.
+        // m_materials counts material switches and the binds they needed.
+        m_materials.BeginFrame();
+#if !defined(_WIN32)
+        m_commandSink->ResetStatistics();
+#endif
+        m_renderQueue.Submit(*m_commandSink);
+    }
+#if defined(_WIN32)
+    {
+        DX::ScopedFrameTimer scopeTimer(m_telemetry, m_gpuTimer.get(), m_upscaleScope);
+        m_sceneTarget->Upscale(m_deviceResources->GetD3DDeviceContext(), m_deviceResources->GetRenderTargetView(), m_deviceResources->GetScreenViewport());
 
-    // TODO: Add your rendering code here.
-    context;
+        // The upscale pass changed bindings behind the queue's back.
+        m_renderQueue.InvalidateState();
+        m_materials.InvalidateBindings();
+    }
 
     m_deviceResources->PIXEndEvent();
+#endif
+
+    if (m_capture.IsCapturing())
+    {
+        // The copy is queued behind this frame's rendering and read back frames later, so
+        // neither side waits; the pixels are encoded on the capture threads.
+        DX::ScopedFrameTimer scopeTimer(m_telemetry, m_gpuTimer.get(), m_captureScope);
+#if defined(_WIN32)
+        auto context = m_deviceResources->GetD3DDeviceContext();
+        m_frameReadback->Capture(m_deviceResources->GetD3DDevice(), context, m_deviceResources->GetRenderTarget());
+        m_frameReadback->Collect(context, m_capture);
+#else
+        // Cornflower blue, in RGBA byte order.
+        std::fill(m_framebuffer.begin(), m_framebuffer.end(), 0xffed9564u);
+        m_capture.SubmitPixels(m_framebuffer.data(), m_outputWidth, m_outputHeight, m_outputWidth * 4, DX::PixelFormat_Rgba8);
+#endif
+    }
+
+    // GPU times arrive a few frames late; they are recorded as they come in.
+    m_gpuTimer->EndFrame();
+    m_gpuTimer->CollectResults(m_telemetry);
+
+    m_telemetry.Record(DX::TelemetryChannel_Render, renderStart);
 
     // Show the new frame.
-    m_deviceResources->Present();
+    auto presentStart = DX::FrameTelemetry::Clock::now();
+    m_framePacer.WaitForPresent();
+#if defined(_WIN32)
+    m_deviceResources->Present(m_framePacer.GetSyncInterval());
+#endif
+    m_framePacer.EndFrame();
+    m_telemetry.Record(DX::TelemetryChannel_Present, presentStart);
 }
 
-// Helper method to clear the back buffers.
+#if defined(_WIN32)
+// Helper method to clear the scene target and set it up at this frame's resolution. The
+// upscale pass covers the whole back buffer, so that needs no clear.
 void Game::Clear()
 {
+    DX::ScopedFrameTimer scopeTimer(m_telemetry, m_gpuTimer.get(), m_clearScope);
     m_deviceResources->PIXBeginEvent(L"Clear");
 
-    // Clear the views.
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    auto renderTarget = m_deviceResources->GetRenderTargetView();
-    auto depthStencil = m_deviceResources->GetDepthStencilView();
-
-    context->ClearRenderTargetView(renderTarget, Colors::CornflowerBlue);
-    context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-    context->OMSetRenderTargets(1, &renderTarget, depthStencil);
-
-    // Set the viewport.
     auto viewport = m_deviceResources->GetScreenViewport();
-    context->RSSetViewports(1, &viewport);
+    uint32_t width, height;
+    m_dynamicResolution.GetRenderSize(static_cast<uint32_t>(viewport.Width), static_cast<uint32_t>(viewport.Height), width, height);
+
+    // Clear the views and set the viewport.
+    m_sceneTarget->Begin(m_deviceResources->GetD3DDeviceContext(), width, height, Colors::CornflowerBlue);
 
     m_deviceResources->PIXEndEvent();
 }
+#endif
 #pragma endregion
 
 #pragma region Message Handlers
@@ -124,20 +443,45 @@ void Game::OnSuspending()
 void Game::OnResuming()
 {
     m_timer.ResetElapsedTime();
+    m_framePacer.Resynchronize();
 
     // TODO: Game is being power-resumed (or returning from minimize).
 }
 
 void Game::OnWindowSizeChanged(int width, int height)
 {
+#if defined(_WIN32)
     if (!m_deviceResources->WindowSizeChanged(width, height))
         return;
+#else
+    m_outputWidth = std::max(width, 1);
+    m_outputHeight = std::max(height, 1);
+#endif
 
     CreateWindowSizeDependentResources();
+    m_framePacer.Resynchronize();
 
     // TODO: Game window is being resized.
 }
 
+void Game::OnInput()
+{
+    m_framePacer.OnInput();
+}
+
+void Game::OnRunModeChanged(DX::RunMode mode)
+{
+    // Benchmark runs measure how fast frames can go, so the pacer must not hold them back.
+    if (mode == DX::RunMode_Benchmark)
+    {
+        m_framePacer.SetMode(DX::FramePacing_Uncapped);
+    }
+
+    // Neither the first frame nor the pacer's deadlines should cover time spent in the old mode.
+    m_timer.ResetElapsedTime();
+    m_framePacer.Resynchronize();
+}
+
 // Properties
 void Game::GetDefaultSize(int& width, int& height) const
 {
@@ -145,33 +489,386 @@ void Game::GetDefaultSize(int& width, int& height) const
     width = 1024;
     height = 768;
 }
+
+bool Game::StartCapture(const char* path, DX::CaptureFormat format)
+{
+    DX::CaptureDesc desc;
+    desc.path = path;
+    desc.format = format;
+    desc.framesPerSecond = c_captureFramesPerSecond;
+    desc.encodeThreads = c_captureEncodeThreads;
+    desc.waitWhenFull = false;
+    return m_capture.Start(desc);
+}
+
+void Game::StopCapture()
+{
+    if (!m_capture.IsCapturing())
+        return;
+
+#if defined(_WIN32)
+    if (m_frameReadback)
+    {
+        m_frameReadback->Collect(m_deviceResources->GetD3DDeviceContext(), m_capture, true);
+    }
+#endif
+    m_capture.Stop();
+
+    DX::FrameCaptureStatistics stats = m_capture.GetStatistics();
+    double submitted = static_cast<double>(std::max<uint64_t>(stats.submitted, 1));
+
+    char buff[256] = {};
+    sprintf_s(buff, "Capture: %llu frames written, %llu dropped, %.1f MB, %.3f ms per frame on the game thread (max %.3f ms)\n",
+        static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.dropped), stats.bytesWritten / (1024.0 * 1024.0),
+        stats.submitSeconds * 1000.0 / submitted, stats.maxSubmitSeconds * 1000.0);
+    DX::OutputDebugMessage(buff);
+}
+
+bool Game::RunBatch(const std::vector<DX::BatchJob>& jobs, const std::string& assetDirectory)
+{
+#if defined(_WIN32)
+    DX::D3D11BatchRenderBackend backend(m_deviceResources->GetD3DDevice(), m_deviceResources->GetD3DDeviceContext(), *m_pipelineCache);
+#else
+    DX::HeadlessBatchRenderBackend backend(&m_workers);
+#endif
+    DX::BatchRenderer renderer(backend);
+
+    auto loadStart = std::chrono::steady_clock::now();
+    std::string error;
+    bool loaded = renderer.LoadScenes(jobs, assetDirectory, error);
+    if (!loaded)
+    {
+        DX::OutputDebugMessage(error.c_str());
+    }
+
+    {
+        double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+        char buff[128] = {};
+        sprintf_s(buff, "Batch: %zu jobs, scenes loaded in %.2f ms\n", jobs.size(), loadSeconds * 1000.0);
+        DX::OutputDebugMessage(buff);
+    }
+
+    DX::BatchStatistics stats = renderer.Run(jobs, c_batchEncodeThreads);
+    DX::OutputDebugMessage(DX::FormatBatchStatistics(stats).c_str());
+
+    // The backend drew with its own bindings.
+    m_renderQueue.InvalidateState();
+
+    return loaded && stats.failed == 0;
+}
+
+DX::PresetSceneLoadStatistics Game::LoadScene(const DX::PresetSceneDesc& desc, const std::string& assetDirectory)
+{
+    std::string meshPath = DX::GetPresetSceneMeshPath(desc, assetDirectory);
+    DX::PresetSceneLoadStatistics statistics = {};
+    m_scene = std::make_unique<DX::PresetScene>(desc, DX::CookPresetSceneMesh(meshPath, &statistics));
+
+    if (m_sceneMaterials.empty())
+    {
+        for (uint32_t i = 0; i < c_sceneMaterialCount; ++i)
+        {
+            DX::MaterialParameters parameters = DX::MaterialParameters::Default();
+            parameters.diffuse[0] = (i + 1.0f) / c_sceneMaterialCount;
+            m_sceneMaterials.push_back(m_materials.AddMaterial("scene " + std::to_string(i), parameters));
+        }
+        m_materials.Commit(m_resourceRegistry, *m_resourceDevice, &m_workers);
+    }
+
+    UploadSceneMesh();
+    CreateSceneResources();
+
+    // Saving the mesh again recooks it on the hot reload worker; the scene switches to it and
+    // its vertices are uploaded behind the same handle. Directories are only watched while the
+    // reloader is stopped, which also drops anything the previous scene had pending.
+    m_hotReloader.Stop();
+    if (!m_sceneMeshPath.empty())
+    {
+        m_hotReloader.Unregister(m_sceneMeshPath);
+    }
+    std::string directory = meshPath.substr(0, meshPath.find_last_of("/\\"));
+    if (directory != m_sceneMeshPath.substr(0, m_sceneMeshPath.find_last_of("/\\")))
+    {
+        m_hotReloader.Watch(directory);
+    }
+    m_sceneMeshPath = meshPath;
+    m_hotReloader.Register(meshPath, [this](const std::string& path)
+    {
+        auto mesh = std::make_shared<DX::CookedMesh>(DX::CookPresetSceneMesh(path));
+        return [this, mesh]()
+        {
+            m_scene->SetMesh(std::move(*mesh));
+            UploadSceneMesh();
+#if defined(_WIN32)
+            m_commandSink->ReplaceBuffer(m_sceneVertexBuffer, m_resourceDevice->GetBuffer(m_sceneVertices));
+            m_commandSink->ReplaceBuffer(m_sceneIndexBuffer, m_resourceDevice->GetBuffer(m_sceneIndices));
+#endif
+        };
+    });
+    m_hotReloader.Start();
+
+    return statistics;
+}
 #pragma endregion
 
 #pragma region Direct3D Resources
 // These are the resources that depend on the device.
 void Game::CreateDeviceDependentResources()
 {
+#if !defined(_WIN32)
+    m_commandSink = std::make_unique<DX::HeadlessCommandSink>();
+    m_gpuTimer = std::make_unique<DX::HeadlessGpuTimer>();
+    m_telemetry.SetGpuEmulated(m_gpuTimer->IsEmulated());
+    m_renderQueue.InvalidateState();
+
+    m_resourceDevice = std::make_unique<DX::HeadlessResourceDevice>();
+    m_resourceRegistry.Upload(*m_resourceDevice, &m_workers);
+
+    m_materials.Commit(m_resourceRegistry, *m_resourceDevice, &m_workers);
+    m_commandSink->SetMaterialSystem(&m_materials);
+
+    if (m_scene)
+    {
+        CreateSceneResources();
+    }
+#else
     auto device = m_deviceResources->GetD3DDevice();
 
+    m_commandSink = std::make_unique<DX::D3D11CommandSink>(m_deviceResources->GetD3DDeviceContext());
+    m_gpuTimer = std::make_unique<DX::D3D11GpuTimer>(device, m_deviceResources->GetD3DDeviceContext());
+    m_telemetry.SetGpuEmulated(m_gpuTimer->IsEmulated());
+    m_renderQueue.InvalidateState();
+
+    // Shaders and states come from m_pipelineCache, e.g.
+    // m_pipelineCache->GetVertexShader(source) for a DX::ShaderSource read from shaders/*.vs.
+    m_pipelineCache = std::make_unique<DX::D3D11PipelineCache>(device, m_shaderCache);
+
+    // Everything in m_resourceRegistry is uploaded here, at startup and again after device
+    // lost, from the images it keeps; nothing is read from disk. Register assets once, in
+    // Initialize, e.g.
+    //   m_texture = m_resourceRegistry.Add("stone.rgba",
+    //       DX::ResourceDesc::Texture2D(D3D11_BIND_SHADER_RESOURCE, 512, 512, 0, DXGI_FORMAT_R8G8B8A8_UNORM, 4),
+    //       DX::ResourceEncoding_GenerateMips, ReadFile("stone.rgba"));
+    // then bind m_resourceDevice->GetShaderResourceView(m_texture).
+    m_resourceDevice = std::make_unique<DX::D3D11ResourceDevice>(device);
+    m_resourceRegistry.Upload(*m_resourceDevice, &m_workers);
+
+    // Materials live in the registry too. Add them with their textures in Initialize, e.g.
+    //   DX::ObjModel model = DX::LoadObjModel("car.obj", &m_workers);
+    //   m_carMaterials = DX::AddMaterials(m_materials, model.materials, resolveTexture);
+    // and each subset draws with packet.material = m_carMaterials[subset.material]. Shaders
+    // include shaders/Materials.hlsli and read the id from the per-object constants, which the
+    // command sink's draw callback fills from DrawPacket::material.
+    m_materials.Commit(m_resourceRegistry, *m_resourceDevice, &m_workers);
+    {
+        CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+        samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+        samplerDesc.MaxAnisotropy = 8;
+        samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+        samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+        m_commandSink->SetMaterialSystem(&m_materials, m_resourceDevice.get(), m_pipelineCache->GetSamplerState(samplerDesc));
+    }
+
+    // Staging textures are created on the first captured frame.
+    m_frameReadback = std::make_unique<DX::D3D11FrameReadback>();
+
+    if (m_scene)
+    {
+        CreateSceneResources();
+    }
+
     // TODO: Initialize device dependent objects here (independent of window size).
     device;
+#endif
+}
+
+void Game::UploadSceneMesh()
+{
+    if (m_sceneVertices)
+    {
+        m_resourceRegistry.Remove(m_sceneVertices, m_resourceDevice.get());
+        m_resourceRegistry.Remove(m_sceneIndices, m_resourceDevice.get());
+    }
+
+    const std::vector<DX::MeshVertex>& vertices = m_scene->GetMesh().vertices;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(vertices.data());
+    size_t size = vertices.size() * sizeof(DX::MeshVertex);
+    m_sceneVertices = m_resourceRegistry.Add("scene vertices", DX::ResourceDesc::Buffer(c_bindVertexBuffer, static_cast<uint32_t>(size)),
+        DX::ResourceEncoding_Raw, std::vector<uint8_t>(data, data + size));
+
+    const std::vector<uint32_t>& indices = m_scene->GetClusterIndices();
+    data = reinterpret_cast<const uint8_t*>(indices.data());
+    size = indices.size() * sizeof(uint32_t);
+    m_sceneIndices = m_resourceRegistry.Add("scene cluster indices", DX::ResourceDesc::Buffer(c_bindIndexBuffer, static_cast<uint32_t>(size)),
+        DX::ResourceEncoding_Raw, std::vector<uint8_t>(data, data + size));
+
+    m_resourceRegistry.Upload(*m_resourceDevice, &m_workers);
+}
+
+void Game::CreateSceneResources()
+{
+    DX::PresetSceneBindings bindings = {};
+    bindings.state.topology = 4;    // D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+    for (DX::MaterialId material : m_sceneMaterials)
+    {
+        bindings.materials.push_back(static_cast<DX::StateHandle>(material));
+    }
+
+#if defined(_WIN32)
+    auto device = m_deviceResources->GetD3DDevice();
+
+    SceneShaders shaders = CompileSceneShaders(*m_pipelineCache, m_shaderCache);
+    bindings.state.vertexShader = m_commandSink->RegisterVertexShader(shaders.vertexShader);
+    bindings.state.inputLayout = m_commandSink->RegisterInputLayout(shaders.inputLayout);
+    for (ID3D11PixelShader* pixelShader : shaders.pixelShaders)
+    {
+        bindings.pixelShaders.push_back(m_commandSink->RegisterPixelShader(pixelShader));
+    }
+
+    // Editing the shader file, or any file it includes, recompiles it on the hot reload worker
+    // and puts the new shaders behind the same handles.
+    m_hotReloader.SetDependencies(c_sceneShaderPath, shaders.includes);
+    m_hotReloader.Register(c_sceneShaderPath, [this, bindings](const std::string&)
+    {
+        SceneShaders shaders = CompileSceneShaders(*m_pipelineCache, m_shaderCache);
+        m_hotReloader.SetDependencies(c_sceneShaderPath, shaders.includes);
+        return [this, bindings, shaders]()
+        {
+            m_commandSink->ReplaceVertexShader(bindings.state.vertexShader, shaders.vertexShader);
+            m_commandSink->ReplaceInputLayout(bindings.state.inputLayout, shaders.inputLayout);
+            for (size_t i = 0; i < shaders.pixelShaders.size(); ++i)
+            {
+                m_commandSink->ReplacePixelShader(bindings.pixelShaders[i], shaders.pixelShaders[i]);
+            }
+        };
+    });
+
+    CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+    bindings.state.blendState = m_commandSink->RegisterBlendState(m_pipelineCache->GetBlendState(blendDesc));
+    CD3D11_DEPTH_STENCIL_DESC depthDesc(D3D11_DEFAULT);
+    bindings.state.depthStencilState = m_commandSink->RegisterDepthStencilState(m_pipelineCache->GetDepthStencilState(depthDesc));
+
+    // Source meshes are not consistent about their winding.
+    CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+    rasterizerDesc.CullMode = D3D11_CULL_NONE;
+    bindings.state.rasterizerState = m_commandSink->RegisterRasterizerState(m_pipelineCache->GetRasterizerState(rasterizerDesc));
+
+    m_sceneVertexBuffer = m_commandSink->RegisterBuffer(m_resourceDevice->GetBuffer(m_sceneVertices));
+    bindings.vertexBuffer = m_sceneVertexBuffer;
+    m_sceneIndexBuffer = m_commandSink->RegisterBuffer(m_resourceDevice->GetBuffer(m_sceneIndices));
+    bindings.indexBuffer = m_sceneIndexBuffer;
+
+    // Per-object constants, written before each draw for the instance it draws.
+    CD3D11_BUFFER_DESC constantsDesc(sizeof(SceneConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+    DX::ThrowIfFailed(device->CreateBuffer(&constantsDesc, nullptr, m_sceneConstants.ReleaseAndGetAddressOf()));
+    m_commandSink->SetDrawCallback([this](ID3D11DeviceContext* context, const DX::DrawPacket& packet)
+    {
+        SceneConstants constants = {};
+        m_scene->GetInstanceMatrices(packet.userData, constants.world, constants.worldViewProjection);
+        memcpy(constants.lightDirection, c_sceneLightDirection, sizeof(constants.lightDirection));
+        constants.material = packet.material;
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        DX::ThrowIfFailed(context->Map(m_sceneConstants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+        memcpy(mapped.pData, &constants, sizeof(constants));
+        context->Unmap(m_sceneConstants.Get(), 0);
+    });
+#else
+    // The headless sink only counts what it is asked to bind, so any non-zero handles do.
+    bindings.state.inputLayout = 1;
+    bindings.state.vertexShader = 1;
+    bindings.state.blendState = 1;
+    bindings.state.depthStencilState = 1;
+    bindings.state.rasterizerState = 1;
+    for (size_t i = 0; i < _countof(c_scenePixelShaders); ++i)
+    {
+        bindings.pixelShaders.push_back(static_cast<DX::StateHandle>(i + 1));
+    }
+    bindings.vertexBuffer = 1;
+    bindings.indexBuffer = 1;
+#endif
+
+    m_scene->SetBindings(bindings);
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
 void Game::CreateWindowSizeDependentResources()
 {
+    // Level of detail selection works in pixels, so it depends on the output height.
+#if defined(_WIN32)
+    auto viewport = m_deviceResources->GetScreenViewport();
+    m_lodProjectionScale = DX::ComputeLodProjectionScale(c_fieldOfViewY, viewport.Height);
+
+    // The scene target is allocated at the largest scale, so scale changes never reallocate.
+    uint32_t sceneWidth, sceneHeight;
+    m_dynamicResolution.GetMaxRenderSize(static_cast<uint32_t>(viewport.Width), static_cast<uint32_t>(viewport.Height), sceneWidth, sceneHeight);
+    m_sceneTarget.reset();
+    m_sceneTarget = std::make_unique<DX::D3D11ScaledRenderTarget>(m_deviceResources->GetD3DDevice(), *m_pipelineCache,
+        m_deviceResources->GetBackBufferFormat(), m_deviceResources->GetDepthBufferFormat(), sceneWidth, sceneHeight);
+    m_dynamicResolution.Reset();
+#else
+    m_lodProjectionScale = DX::ComputeLodProjectionScale(c_fieldOfViewY, static_cast<float>(m_outputHeight));
+
+    m_framebuffer.resize(size_t(m_outputWidth) * m_outputHeight);
+#endif
+
+    // The light grid covers the camera frustum.
+#if defined(_WIN32)
+    float aspectRatio = viewport.Width / viewport.Height;
+#else
+    float aspectRatio = static_cast<float>(m_outputWidth) / static_cast<float>(std::max(m_outputHeight, 1));
+#endif
+    m_lightClusters.SetGrid(DX::LightGridDesc{ c_fieldOfViewY, aspectRatio, c_nearPlane, c_farPlane });
+
     // TODO: Initialize windows-size dependent objects here.
 }
 
+#if defined(_WIN32)
 void Game::OnDeviceLost()
 {
+    m_memoryBeforeDeviceLost = DX::GetMemoryTracker().TakeSnapshot();
+
+    // Rebuilds in flight hold objects from the lost device; drop them.
+    m_hotReloader.Stop();
+
+    m_renderQueue.Clear();
+    m_commandSink.reset();
+    m_gpuTimer.reset();
+    m_sceneTarget.reset();
+    m_frameReadback.reset();
+    m_pipelineCache.reset();
+    m_sceneConstants.Reset();
+
+    m_resourceDevice.reset();
+    m_resourceRegistry.OnDeviceLost();
+
     // TODO: Add Direct3D resource cleanup here.
 }
 
 void Game::OnDeviceRestored()
 {
+    auto restoreStart = std::chrono::steady_clock::now();
+
     CreateDeviceDependentResources();
 
+    {
+        double restoreSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - restoreStart).count();
+
+        char buff[128] = {};
+        sprintf_s(buff, "Device restored: %u resources in %.2f ms\n", m_resourceRegistry.GetResourceCount(), restoreSeconds * 1000.0);
+        DX::OutputDebugMessage(buff);
+    }
+
     CreateWindowSizeDependentResources();
+
+    m_hotReloader.Start();
+
+    // Everything released on device lost should have come back the same size.
+    DX::MemorySnapshotDiff diff = DX::DiffMemorySnapshots(m_memoryBeforeDeviceLost, DX::GetMemoryTracker().TakeSnapshot());
+    if (!diff.IsEmpty())
+    {
+        DX::OutputDebugMessage(("Memory changed across device lost:\n" + DX::FormatMemorySnapshotDiff(diff)).c_str());
+    }
 }
+#endif
 #pragma endregion
@@ -4,51 +4,218 @@
 
 #pragma once
 
-#include "DeviceResources.h"
+#include "BatchRenderer.h"
+#include "DynamicResolution.h"
+#include "EntityWorld.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "FrameTelemetry.h"
+#include "GpuTimer.h"
+#include "HotReloader.h"
+#include "LightClustering.h"
+#include "MaterialSystem.h"
+#include "MemoryTracker.h"
+#include "MeshCooker.h"
+#include "Platform.h"
+#include "PresetScene.h"
+#include "RenderQueue.h"
+#include "ResourceRegistry.h"
+#include "RunLoop.h"
 #include "StepTimer.h"
 
+#if defined(_WIN32)
+#include "D3D11BatchRenderBackend.h"
+#include "D3D11CommandSink.h"
+#include "D3D11DynamicResolution.h"
+#include "D3D11FrameReadback.h"
+#include "D3D11GpuTimer.h"
+#include "D3D11PipelineCache.h"
+#include "D3D11ResourceDevice.h"
+#include "DeviceResources.h"
+#include "ShaderCache.h"
+#else
+#include "HeadlessBatchRenderBackend.h"
+#include "HeadlessCommandSink.h"
+#include "HeadlessResourceDevice.h"
+#endif
+
 
 // A basic game implementation that creates a D3D11 device and
-// provides a game loop.
-class Game : public DX::IDeviceNotify
+// provides a game loop. Without Direct3D (Linux builds) it runs
+// headless: the same loop, with draws going to a recording sink.
+class Game :
+#if defined(_WIN32)
+    public DX::IDeviceNotify,
+#endif
+    public DX::IRunLoopHandler
 {
 public:
 
     Game();
 
     // Initialization and management
-    void Initialize(HWND window, int width, int height);
+    void Initialize(DX::NativeWindowHandle window, int width, int height);
 
-    // Basic game loop
-    void Tick();
+    // Basic game loop (IRunLoopHandler)
+    virtual void Tick() override;
 
+    // Holds the next frame back when the frame pacer asks for it. Returns true if it waited,
+    // in which case the caller should process pending messages before calling Tick.
+    virtual bool WaitForNextFrame() override;
+
+    virtual void OnRunModeChanged(DX::RunMode mode) override;
+
+#if defined(_WIN32)
     // IDeviceNotify
     virtual void OnDeviceLost() override;
     virtual void OnDeviceRestored() override;
+#endif
 
-    // Messages
-    void OnActivated();
-    void OnDeactivated();
-    void OnSuspending();
-    void OnResuming();
-    void OnWindowSizeChanged(int width, int height);
+    // Messages (IPlatformEventHandler)
+    virtual void OnActivated() override;
+    virtual void OnDeactivated() override;
+    virtual void OnSuspending() override;
+    virtual void OnResuming() override;
+    virtual void OnWindowSizeChanged(int width, int height) override;
+    virtual void OnInput() override;
 
     // Properties
     void GetDefaultSize( int& width, int& height ) const;
 
+    // Frame capture. Frames are read back a few frames late and encoded on worker threads;
+    // StopCapture writes the ones still in flight and reports the capture statistics.
+    bool StartCapture(const char* path, DX::CaptureFormat format);
+    void StopCapture();
+
+    // Offline rendering, instead of running the game loop: loads the scenes the jobs name once,
+    // renders every job into offscreen targets and writes the images. Returns false if any
+    // scene could not be loaded or any image could not be written.
+    bool RunBatch(const std::vector<DX::BatchJob>& jobs, const std::string& assetDirectory);
+
+    // Draws a preset scene every frame from now on, its mesh read from under assetDirectory.
+    // Call after Initialize. Throws std::runtime_error if the mesh cannot be loaded.
+    DX::PresetSceneLoadStatistics LoadScene(const DX::PresetSceneDesc& desc, const std::string& assetDirectory);
+
+    // For benchmarks driving Tick themselves: the telemetry, and what the last frame drew.
+    DX::FrameTelemetry& GetTelemetry()                          { return m_telemetry; }
+    const DX::PresetScene* GetScene() const                     { return m_scene.get(); }
+    const DX::MaterialSystem& GetMaterials() const              { return m_materials; }
+#if !defined(_WIN32)
+    const DX::HeadlessCommandStatistics& GetCommandStatistics() const { return m_commandSink->GetStatistics(); }
+#endif
+
 private:
 
     void Update(DX::StepTimer const& timer);
     void Render();
 
+#if defined(_WIN32)
     void Clear();
+#endif
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 
+    // Registers the scene mesh's vertices and indices, and what the scene draws with, on the
+    // current device.
+    void UploadSceneMesh();
+    void CreateSceneResources();
+
+#if defined(_WIN32)
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
+#else
+    // Output size; there is no swap chain to ask.
+    int                                     m_outputWidth;
+    int                                     m_outputHeight;
+#endif
 
     // Rendering loop timer.
     DX::StepTimer                           m_timer;
+
+    // Frame rate limiting and input-to-present latency.
+    DX::FramePacer                          m_framePacer;
+
+    // Update, render, present and frame time histograms, plus CPU and GPU time per scope.
+    DX::FrameTelemetry                      m_telemetry;
+    std::unique_ptr<DX::IGpuTimer>          m_gpuTimer;
+#if defined(_WIN32)
+    uint32_t                                m_clearScope;
+#endif
+    uint32_t                                m_renderScope;
+#if defined(_WIN32)
+    uint32_t                                m_upscaleScope;
+#endif
+    uint32_t                                m_captureScope;
+
+    // Draw submission.
+    DX::RenderQueue                         m_renderQueue;
+#if defined(_WIN32)
+    std::unique_ptr<DX::D3D11CommandSink>   m_commandSink;
+
+    // Compiled shaders persist between runs; pipeline objects are rebuilt from them per device.
+    DX::ShaderCache                         m_shaderCache;
+    std::unique_ptr<DX::D3D11PipelineCache> m_pipelineCache;
+
+    // The scene is drawn at a resolution picked per frame, then upscaled to the back buffer.
+    std::unique_ptr<DX::D3D11ScaledRenderTarget> m_sceneTarget;
+
+    // Memory just before the device was lost, compared once it is restored to find leaks.
+    DX::MemorySnapshot                      m_memoryBeforeDeviceLost;
+#else
+    std::unique_ptr<DX::HeadlessCommandSink> m_commandSink;
+#endif
+
+    // Streams presented frames to disk while capturing.
+    DX::FrameCapture                        m_capture;
+#if defined(_WIN32)
+    std::unique_ptr<DX::D3D11FrameReadback> m_frameReadback;
+#else
+    // What a software renderer would draw into; captured directly, as there is nothing to
+    // read back. Only filled while capturing.
+    std::vector<uint32_t>                   m_framebuffer;
+#endif
+
+    // Picks the scene resolution from the measured render time.
+    DX::DynamicResolutionController         m_dynamicResolution;
+
+    // Buffers and textures are kept as CPU-side images and uploaded again to a new device.
+    DX::ResourceRegistry                    m_resourceRegistry;
+#if defined(_WIN32)
+    std::unique_ptr<DX::D3D11ResourceDevice> m_resourceDevice;
+#else
+    std::unique_ptr<DX::HeadlessResourceDevice> m_resourceDevice;
+#endif
+
+    // Every material's parameters in one buffer and their textures in shared arrays, bound
+    // once per frame; draws pick theirs by DrawPacket::material.
+    DX::MaterialSystem                      m_materials;
+
+    // Game state, updated by systems that iterate over component chunks on the worker threads.
+    DX::WorkerPool                          m_workers;
+    DX::EntityWorld                         m_entities;
+
+    // Point and spot lights, assigned to view-space clusters every frame for shading.
+    std::vector<DX::Light>                  m_lights;
+    DX::LightClusterBuilder                 m_lightClusters;
+
+    // The preset scene, if one is loaded. Its vertices and cluster indices are registry
+    // resources, uploaded once per mesh.
+    std::unique_ptr<DX::PresetScene>        m_scene;
+    std::string                             m_sceneMeshPath;
+    DX::ResourceHandle                      m_sceneVertices;
+    DX::ResourceHandle                      m_sceneIndices;
+    std::vector<DX::MaterialId>             m_sceneMaterials;
+#if defined(_WIN32)
+    DX::StateHandle                         m_sceneVertexBuffer;
+    DX::StateHandle                         m_sceneIndexBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>    m_sceneConstants;
+#endif
+
+    // Converts level of detail errors into pixels for the current output size.
+    float                                   m_lodProjectionScale;
+
+    // Rebuilds edited shaders in the background. Declared last so its worker stops before
+    // anything its rebuild functions refer to is destroyed.
+    DX::HotReloader                         m_hotReloader;
 };
\ No newline at end of file
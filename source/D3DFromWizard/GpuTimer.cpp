@@ -0,0 +1,71 @@
+//
+// GpuTimer.cpp - Per-scope GPU timing reported into the frame telemetry
+//
+
+#include "pch.h"
+#include "GpuTimer.h"
+
+DX::HeadlessGpuTimer::HeadlessGpuTimer() :
+    m_frameIndex(0),
+    m_collectedIndex(0),
+    m_dropped(0)
+{
+}
+
+void DX::HeadlessGpuTimer::BeginFrame()
+{
+    // Without a CollectResults every frame the oldest unreported frame gets overwritten.
+    const uint64_t slots = _countof(m_frames);
+    if (m_frameIndex - m_collectedIndex >= slots)
+    {
+        m_dropped += m_frameIndex - slots + 1 - m_collectedIndex;
+        m_collectedIndex = m_frameIndex - slots + 1;
+    }
+
+    Frame& frame = m_frames[m_frameIndex % _countof(m_frames)];
+    frame.samples.clear();
+    frame.index = m_frameIndex;
+
+    m_open.clear();
+}
+
+void DX::HeadlessGpuTimer::EndFrame()
+{
+    assert(m_open.empty());
+    m_frameIndex++;
+}
+
+void DX::HeadlessGpuTimer::BeginScope(uint32_t scope)
+{
+    m_open.push_back(OpenScope{ scope, FrameTelemetry::Clock::now() });
+}
+
+void DX::HeadlessGpuTimer::EndScope(uint32_t scope)
+{
+    assert(!m_open.empty() && m_open.back().scope == scope);
+
+    auto duration = FrameTelemetry::Clock::now() - m_open.back().start;
+    m_open.pop_back();
+
+    Frame& frame = m_frames[m_frameIndex % _countof(m_frames)];
+    if (frame.samples.size() < c_maxGpuTimerScopesPerFrame)
+    {
+        frame.samples.push_back(Sample{ scope, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) });
+    }
+}
+
+void DX::HeadlessGpuTimer::CollectResults(FrameTelemetry& telemetry)
+{
+    // Only frames at least c_gpuTimerLatency old are "finished".
+    while (m_collectedIndex + c_gpuTimerLatency <= m_frameIndex)
+    {
+        const Frame& frame = m_frames[m_collectedIndex % _countof(m_frames)];
+        assert(frame.index == m_collectedIndex);
+
+        for (const Sample& sample : frame.samples)
+        {
+            telemetry.RecordScope(sample.scope, TelemetryDomain_Gpu, sample.nanoseconds);
+        }
+        m_collectedIndex++;
+    }
+}
@@ -0,0 +1,118 @@
+//
+// GpuTimer.h - Per-scope GPU timing reported into the frame telemetry
+//
+
+#pragma once
+
+#include "FrameTelemetry.h"
+
+#include <vector>
+
+namespace DX
+{
+    // Results are read back this many frames after they were recorded, by which time the GPU
+    // has normally finished them, so collecting never waits for it.
+    const uint32_t c_gpuTimerLatency = 3;
+
+    // Scope occurrences timed per frame; beyond this a frame's extra scopes are not timed.
+    const uint32_t c_maxGpuTimerScopesPerFrame = 32;
+
+    // Measures how long the GPU spends on each scope of a frame. Scope ids come from
+    // FrameTelemetry::RegisterScope; scopes may nest and repeat within a frame. Every call
+    // is made from the render thread.
+    interface IGpuTimer
+    {
+        virtual ~IGpuTimer() {}
+
+        virtual void BeginFrame() = 0;
+        virtual void EndFrame() = 0;
+
+        virtual void BeginScope(uint32_t scope) = 0;
+        virtual void EndScope(uint32_t scope) = 0;
+
+        // Records the GPU time of every frame whose results have arrived into telemetry.
+        // Never blocks; frames that are not finished yet are left for a later call.
+        virtual void CollectResults(FrameTelemetry& telemetry) = 0;
+
+        // Frames dropped because the GPU fell too far behind or timestamps were unreliable.
+        virtual uint64_t GetDroppedFrames() const = 0;
+
+        // True when the times are not GPU timestamps; see FrameTelemetry::SetGpuEmulated.
+        virtual bool IsEmulated() const = 0;
+    };
+
+    // Emulates GPU timing where there is no GPU. The command sink executes the work inline
+    // on the render thread, so the time spent between BeginScope and EndScope stands in for
+    // the GPU time; it is held back c_gpuTimerLatency frames, like D3D11GpuTimer's results,
+    // so reports line up the same way on both backends. The times are CPU times all the same,
+    // so they are reported as emulated and are not comparable with D3D11GpuTimer's.
+    class HeadlessGpuTimer : public IGpuTimer
+    {
+    public:
+        HeadlessGpuTimer();
+
+        virtual void BeginFrame() override;
+        virtual void EndFrame() override;
+        virtual void BeginScope(uint32_t scope) override;
+        virtual void EndScope(uint32_t scope) override;
+        virtual void CollectResults(FrameTelemetry& telemetry) override;
+        virtual uint64_t GetDroppedFrames() const override     { return m_dropped; }
+        virtual bool IsEmulated() const override                { return true; }
+
+    private:
+        struct Sample
+        {
+            uint32_t    scope;
+            uint64_t    nanoseconds;
+        };
+
+        struct Frame
+        {
+            std::vector<Sample>     samples;
+            uint64_t                index;
+        };
+
+        struct OpenScope
+        {
+            uint32_t                    scope;
+            FrameTelemetry::Clock::time_point start;
+        };
+
+        Frame                   m_frames[c_gpuTimerLatency + 1];
+        std::vector<OpenScope>  m_open;
+        uint64_t                m_frameIndex;       // Frames begun so far.
+        uint64_t                m_collectedIndex;   // Frames reported so far.
+        uint64_t                m_dropped;
+    };
+
+    // Times a block on the CPU and the GPU under one telemetry scope. gpuTimer may be null.
+    class ScopedFrameTimer
+    {
+    public:
+        ScopedFrameTimer(FrameTelemetry& telemetry, IGpuTimer* gpuTimer, uint32_t scope) :
+            m_telemetry(telemetry),
+            m_gpuTimer(gpuTimer),
+            m_scope(scope),
+            m_start(FrameTelemetry::Clock::now())
+        {
+            if (m_gpuTimer)
+                m_gpuTimer->BeginScope(m_scope);
+        }
+
+        ~ScopedFrameTimer()
+        {
+            if (m_gpuTimer)
+                m_gpuTimer->EndScope(m_scope);
+            m_telemetry.RecordScope(m_scope, TelemetryDomain_Cpu, FrameTelemetry::Clock::now() - m_start);
+        }
+
+        ScopedFrameTimer(const ScopedFrameTimer&) = delete;
+        ScopedFrameTimer& operator=(const ScopedFrameTimer&) = delete;
+
+    private:
+        FrameTelemetry&                     m_telemetry;
+        IGpuTimer*                          m_gpuTimer;
+        uint32_t                            m_scope;
+        FrameTelemetry::Clock::time_point   m_start;
+    };
+}
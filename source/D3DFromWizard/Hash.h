@@ -0,0 +1,40 @@
+//
+// Hash.h - Content hashing helpers
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+namespace DX
+{
+    const uint64_t c_hashSeed = 14695981039346656037ull;
+
+    // 64-bit FNV-1a. Used for cache keys, not for anything adversarial.
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = c_hashSeed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Includes the length so that consecutive strings cannot run into each other.
+    inline uint64_t HashString(const std::string& value, uint64_t hash = c_hashSeed)
+    {
+        uint64_t size = value.size();
+        hash = HashBytes(&size, sizeof(size), hash);
+        return HashBytes(value.data(), value.size(), hash);
+    }
+
+    template<typename T>
+    inline uint64_t HashValue(const T& value, uint64_t hash = c_hashSeed)
+    {
+        return HashBytes(&value, sizeof(value), hash);
+    }
+}
@@ -0,0 +1,222 @@
+//
+// HeadlessBatchRenderBackend.cpp - Batch render backend that rasterizes on the CPU
+//
+
+#include "pch.h"
+#include "HeadlessBatchRenderBackend.h"
+
+#include <math.h>
+
+namespace
+{
+    // Cornflower blue and a light grey, in RGBA byte order.
+    const uint32_t c_background = 0xffed9564u;
+    const float c_surface[3] = { 200.0f, 200.0f, 205.0f };
+
+    const float c_ambient = 0.2f;
+
+    inline float Edge(const float* a, const float* b, float x, float y)
+    {
+        return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+    }
+};
+
+DX::HeadlessBatchRenderBackend::HeadlessBatchRenderBackend(WorkerPool* workers) :
+    m_workers(workers)
+{
+    m_targets.resize(workers ? workers->GetThreadCount() : 1);
+    for (Target& target : m_targets)
+    {
+        target.pending = false;
+    }
+}
+
+uint32_t DX::HeadlessBatchRenderBackend::AddScene(const MeshData& mesh)
+{
+    m_scenes.push_back(mesh);
+    UpdateMemoryTracking();
+    return static_cast<uint32_t>(m_scenes.size() - 1);
+}
+
+uint32_t DX::HeadlessBatchRenderBackend::GetTargetCount() const
+{
+    return static_cast<uint32_t>(m_targets.size());
+}
+
+void DX::HeadlessBatchRenderBackend::Begin(uint32_t target, const BatchView& view)
+{
+    m_targets[target].view = view;
+    m_targets[target].pending = true;
+}
+
+void DX::HeadlessBatchRenderBackend::Flush()
+{
+    std::vector<Target*> pending;
+    for (Target& target : m_targets)
+    {
+        if (target.pending)
+        {
+            pending.push_back(&target);
+        }
+    }
+
+    auto render = [&](uint32_t index)
+    {
+        Render(*pending[index]);
+        pending[index]->pending = false;
+    };
+
+    if (m_workers)
+    {
+        m_workers->ParallelFor(static_cast<uint32_t>(pending.size()), render);
+    }
+    else
+    {
+        for (uint32_t index = 0; index < pending.size(); ++index)
+        {
+            render(index);
+        }
+    }
+
+    UpdateMemoryTracking();
+}
+
+bool DX::HeadlessBatchRenderBackend::Map(uint32_t target, bool wait, const uint8_t*& pixels, uint32_t& rowPitch, PixelFormat& format)
+{
+    // Everything begun has been rendered by Flush.
+    (void)wait;
+    assert(!m_targets[target].pending);
+
+    pixels = reinterpret_cast<const uint8_t*>(m_targets[target].color.data());
+    rowPitch = m_targets[target].view.width * 4;
+    format = PixelFormat_Rgba8;
+    return true;
+}
+
+void DX::HeadlessBatchRenderBackend::Unmap(uint32_t target)
+{
+    (void)target;
+}
+
+void DX::HeadlessBatchRenderBackend::Render(Target& target) const
+{
+    const BatchView& view = target.view;
+    const MeshData& mesh = m_scenes[view.scene];
+    const uint32_t width = view.width;
+    const uint32_t height = view.height;
+
+    target.color.assign(size_t(width) * height, c_background);
+    target.depth.assign(size_t(width) * height, 1.0f);
+
+    // Transform and light every vertex once. A negative depth marks a vertex in front of the
+    // near plane.
+    const float (*m)[4] = view.worldViewProjection;
+    target.vertices.resize(mesh.vertices.size() * 4);
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const float* p = mesh.vertices[i].position;
+        const float* n = mesh.vertices[i].normal;
+        float x = p[0] * m[0][0] + p[1] * m[1][0] + p[2] * m[2][0] + m[3][0];
+        float y = p[0] * m[0][1] + p[1] * m[1][1] + p[2] * m[2][1] + m[3][1];
+        float z = p[0] * m[0][2] + p[1] * m[1][2] + p[2] * m[2][2] + m[3][2];
+        float w = p[0] * m[0][3] + p[1] * m[1][3] + p[2] * m[2][3] + m[3][3];
+
+        float* out = &target.vertices[i * 4];
+        if (z < 0.0f || w <= 0.0f)
+        {
+            out[2] = -1.0f;
+            continue;
+        }
+        out[0] = (x / w * 0.5f + 0.5f) * width;
+        out[1] = (0.5f - y / w * 0.5f) * height;
+        out[2] = z / w;
+
+        float diffuse = n[0] * view.lightDirection[0] + n[1] * view.lightDirection[1] + n[2] * view.lightDirection[2];
+        out[3] = c_ambient + (1.0f - c_ambient) * std::max(diffuse, 0.0f);
+    }
+
+    // Both windings are drawn, as source meshes are not consistent about theirs.
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const float* v0 = &target.vertices[mesh.indices[i] * 4];
+        const float* v1 = &target.vertices[mesh.indices[i + 1] * 4];
+        const float* v2 = &target.vertices[mesh.indices[i + 2] * 4];
+        if (v0[2] < 0.0f || v1[2] < 0.0f || v2[2] < 0.0f)
+        {
+            continue;
+        }
+
+        float area = Edge(v0, v1, v2[0], v2[1]);
+        if (fabsf(area) < 1e-8f)
+        {
+            continue;
+        }
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        int minX = std::max(static_cast<int>(floorf(std::min(v0[0], std::min(v1[0], v2[0])))), 0);
+        int maxX = std::min(static_cast<int>(ceilf(std::max(v0[0], std::max(v1[0], v2[0])))), static_cast<int>(width) - 1);
+        int minY = std::max(static_cast<int>(floorf(std::min(v0[1], std::min(v1[1], v2[1])))), 0);
+        int maxY = std::min(static_cast<int>(ceilf(std::max(v0[1], std::max(v1[1], v2[1])))), static_cast<int>(height) - 1);
+        if (minX > maxX || minY > maxY)
+        {
+            continue;
+        }
+
+        // Edge functions at the first pixel centre, stepped across the bounding box.
+        float inverseArea = 1.0f / area;
+        float startX = minX + 0.5f, startY = minY + 0.5f;
+        float row0 = Edge(v1, v2, startX, startY), row1 = Edge(v2, v0, startX, startY), row2 = Edge(v0, v1, startX, startY);
+        float stepX0 = v1[1] - v2[1], stepX1 = v2[1] - v0[1], stepX2 = v0[1] - v1[1];
+        float stepY0 = v2[0] - v1[0], stepY1 = v0[0] - v2[0], stepY2 = v1[0] - v0[0];
+
+        for (int y = minY; y <= maxY; ++y, row0 += stepY0, row1 += stepY1, row2 += stepY2)
+        {
+            float e0 = row0, e1 = row1, e2 = row2;
+            uint32_t* color = target.color.data() + size_t(y) * width;
+            float* depth = target.depth.data() + size_t(y) * width;
+            for (int x = minX; x <= maxX; ++x, e0 += stepX0, e1 += stepX1, e2 += stepX2)
+            {
+                if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+                {
+                    continue;
+                }
+
+                float b0 = e0 * inverseArea, b1 = e1 * inverseArea, b2 = e2 * inverseArea;
+                float z = b0 * v0[2] + b1 * v1[2] + b2 * v2[2];
+                if (z >= depth[x])
+                {
+                    continue;
+                }
+                depth[x] = z;
+
+                float intensity = b0 * v0[3] + b1 * v1[3] + b2 * v2[3];
+                uint32_t r = static_cast<uint32_t>(std::min(c_surface[0] * intensity, 255.0f));
+                uint32_t g = static_cast<uint32_t>(std::min(c_surface[1] * intensity, 255.0f));
+                uint32_t b = static_cast<uint32_t>(std::min(c_surface[2] * intensity, 255.0f));
+                color[x] = 0xff000000u | (b << 16) | (g << 8) | r;
+            }
+        }
+    }
+}
+
+void DX::HeadlessBatchRenderBackend::UpdateMemoryTracking()
+{
+    uint64_t sceneBytes = 0;
+    for (const MeshData& mesh : m_scenes)
+    {
+        sceneBytes += mesh.vertices.capacity() * sizeof(MeshVertex) + mesh.indices.capacity() * sizeof(uint32_t);
+    }
+    m_sceneMemory.Track(MemoryCategory_Meshes, sceneBytes, "batch scenes");
+
+    uint64_t targetBytes = 0;
+    for (const Target& target : m_targets)
+    {
+        targetBytes += target.color.capacity() * sizeof(uint32_t) + target.depth.capacity() * sizeof(float) +
+            target.vertices.capacity() * sizeof(float);
+    }
+    m_targetMemory.Track(MemoryCategory_RenderTargets, targetBytes, "batch targets");
+}
@@ -0,0 +1,56 @@
+//
+// HeadlessBatchRenderBackend.h - Batch render backend that rasterizes on the CPU
+//
+
+#pragma once
+
+#include "BatchRenderer.h"
+#include "MemoryTracker.h"
+#include "WorkerPool.h"
+
+namespace DX
+{
+    // Stands in for the D3D11 batch backend where there is no GPU: a depth-buffered triangle
+    // rasterizer with Gouraud-shaded Lambert lighting, enough for turntable previews. It has one
+    // target per pool thread, and Flush rasterizes the jobs begun since the last one in
+    // parallel, so Map never has to wait.
+    //
+    // Triangles crossing the near plane are dropped rather than clipped; BatchRenderer puts the
+    // near plane at the front of the bounding sphere, so this only happens with the camera
+    // inside it.
+    class HeadlessBatchRenderBackend : public IBatchRenderBackend
+    {
+    public:
+        explicit HeadlessBatchRenderBackend(WorkerPool* workers);
+
+        HeadlessBatchRenderBackend(const HeadlessBatchRenderBackend&) = delete;
+        HeadlessBatchRenderBackend& operator=(const HeadlessBatchRenderBackend&) = delete;
+
+        // IBatchRenderBackend
+        virtual uint32_t AddScene(const MeshData& mesh) override;
+        virtual uint32_t GetTargetCount() const override;
+        virtual void Begin(uint32_t target, const BatchView& view) override;
+        virtual void Flush() override;
+        virtual bool Map(uint32_t target, bool wait, const uint8_t*& pixels, uint32_t& rowPitch, PixelFormat& format) override;
+        virtual void Unmap(uint32_t target) override;
+
+    private:
+        struct Target
+        {
+            BatchView               view;
+            bool                    pending;
+            std::vector<uint32_t>   color;      // RGBA.
+            std::vector<float>      depth;
+            std::vector<float>      vertices;   // Per vertex: screen x, y, depth, intensity.
+        };
+
+        void Render(Target& target) const;
+        void UpdateMemoryTracking();
+
+        WorkerPool*                 m_workers;
+        std::vector<MeshData>       m_scenes;
+        std::vector<Target>         m_targets;
+        TrackedMemory               m_sceneMemory;
+        TrackedMemory               m_targetMemory;
+    };
+}
@@ -0,0 +1,85 @@
+//
+// HeadlessCommandSink.cpp - Render queue sink that records the command stream without a device
+//
+
+#include "pch.h"
+#include "HeadlessCommandSink.h"
+
+DX::HeadlessCommandSink::HeadlessCommandSink() :
+    m_statistics{},
+    m_materials(nullptr)
+{
+}
+
+void DX::HeadlessCommandSink::ResetStatistics()
+{
+    m_statistics = HeadlessCommandStatistics{};
+}
+
+void DX::HeadlessCommandSink::SetMaterialSystem(MaterialSystem* materials)
+{
+    m_materials = materials;
+    if (m_materials)
+    {
+        m_materials->InvalidateBindings();
+    }
+}
+
+void DX::HeadlessCommandSink::SetInputLayout(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetPrimitiveTopology(uint8_t)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetVertexShader(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetPixelShader(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetVertexBuffer(StateHandle, uint32_t)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetIndexBuffer(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetMaterial(StateHandle material)
+{
+    if (!m_materials || m_materials->Select(material))
+    {
+        m_statistics.bindings++;
+    }
+}
+
+void DX::HeadlessCommandSink::SetBlendState(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetDepthStencilState(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::SetRasterizerState(StateHandle)
+{
+    m_statistics.bindings++;
+}
+
+void DX::HeadlessCommandSink::DrawIndexed(const DrawPacket& packet)
+{
+    m_statistics.draws++;
+    m_statistics.indices += packet.indexCount;
+}
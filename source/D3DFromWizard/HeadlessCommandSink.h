@@ -0,0 +1,50 @@
+//
+// HeadlessCommandSink.h - Render queue sink that records the command stream without a device
+//
+
+#pragma once
+
+#include "MaterialSystem.h"
+#include "RenderQueue.h"
+
+namespace DX
+{
+    struct HeadlessCommandStatistics
+    {
+        uint32_t bindings;
+        uint32_t draws;
+        uint64_t indices;
+    };
+
+    // Stands in for D3D11CommandSink where there is no GPU (benchmarks, Linux builds). It only
+    // counts what it is asked to do, so the CPU cost measured is that of producing the stream.
+    class HeadlessCommandSink : public IRenderCommandSink
+    {
+    public:
+        HeadlessCommandSink();
+
+        void ResetStatistics();
+        const HeadlessCommandStatistics& GetStatistics() const  { return m_statistics; }
+
+        // Material handles become ids into the material system, and only binding its tables
+        // counts as a binding. Null goes back to counting every material change.
+        void SetMaterialSystem(MaterialSystem* materials);
+
+        // IRenderCommandSink
+        virtual void SetInputLayout(StateHandle inputLayout) override;
+        virtual void SetPrimitiveTopology(uint8_t topology) override;
+        virtual void SetVertexShader(StateHandle vertexShader) override;
+        virtual void SetPixelShader(StateHandle pixelShader) override;
+        virtual void SetVertexBuffer(StateHandle vertexBuffer, uint32_t stride) override;
+        virtual void SetIndexBuffer(StateHandle indexBuffer) override;
+        virtual void SetMaterial(StateHandle material) override;
+        virtual void SetBlendState(StateHandle blendState) override;
+        virtual void SetDepthStencilState(StateHandle depthStencilState) override;
+        virtual void SetRasterizerState(StateHandle rasterizerState) override;
+        virtual void DrawIndexed(const DrawPacket& packet) override;
+
+    private:
+        HeadlessCommandStatistics   m_statistics;
+        MaterialSystem*             m_materials;
+    };
+}
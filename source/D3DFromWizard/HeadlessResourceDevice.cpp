@@ -0,0 +1,99 @@
+//
+// HeadlessResourceDevice.cpp - Resource device that keeps uploads in system memory
+//
+
+#include "pch.h"
+#include "HeadlessResourceDevice.h"
+#include "Hash.h"
+#include "MemoryTracker.h"
+
+namespace
+{
+    inline DX::MemoryCategory GetCategory(DX::ResourceType type)
+    {
+        return type == DX::ResourceType_Buffer ? DX::MemoryCategory_DeviceBuffers : DX::MemoryCategory_DeviceTextures;
+    }
+};
+
+DX::HeadlessResourceDevice::HeadlessResourceDevice() :
+    m_statistics{}
+{
+}
+
+DX::HeadlessResourceDevice::~HeadlessResourceDevice()
+{
+    ReleaseAll();
+}
+
+void DX::HeadlessResourceDevice::SimulateDeviceRemoved()
+{
+    ReleaseAll();
+    m_statistics.deviceRemovals++;
+}
+
+void DX::HeadlessResourceDevice::ReleaseAll()
+{
+    for (size_t i = 0; i < m_resources.size(); ++i)
+    {
+        if (!m_resources[i].data.empty())
+        {
+            ReleaseResource(static_cast<ResourceHandle>(i + 1));
+        }
+    }
+
+    m_resources.clear();
+}
+
+uint64_t DX::HeadlessResourceDevice::ComputeChecksum() const
+{
+    uint64_t hash = c_hashSeed;
+    for (const Resource& resource : m_resources)
+    {
+        hash = HashValue(resource.data.size(), hash);
+        hash = HashBytes(resource.data.data(), resource.data.size(), hash);
+    }
+    return hash;
+}
+
+void DX::HeadlessResourceDevice::CreateResource(ResourceHandle handle, const ResourceDesc& desc, const ResourceSubresource* subresources, uint32_t subresourceCount)
+{
+    assert(handle != 0);
+
+    if (m_resources.size() < handle)
+    {
+        m_resources.resize(handle);
+    }
+
+    Resource& resource = m_resources[handle - 1];
+    assert(resource.data.empty());
+
+    resource.type = desc.type;
+    resource.data.reserve(desc.GetUploadBytes());
+
+    for (uint32_t i = 0; i < subresourceCount; ++i)
+    {
+        const uint8_t* data = static_cast<const uint8_t*>(subresources[i].data);
+        resource.data.insert(resource.data.end(), data, data + subresources[i].slicePitch);
+    }
+    assert(resource.data.size() == desc.GetUploadBytes());
+
+    GetMemoryTracker().Allocate(GetCategory(resource.type), resource.data.size());
+
+    m_statistics.liveResources++;
+    m_statistics.liveBytes += resource.data.size();
+    m_statistics.uploadedBytes += resource.data.size();
+}
+
+void DX::HeadlessResourceDevice::ReleaseResource(ResourceHandle handle)
+{
+    assert(handle != 0 && handle <= m_resources.size());
+
+    Resource& resource = m_resources[handle - 1];
+    GetMemoryTracker().Free(GetCategory(resource.type), resource.data.size());
+
+    m_statistics.liveResources--;
+    m_statistics.liveBytes -= resource.data.size();
+
+    resource.data.clear();
+    resource.data.shrink_to_fit();
+}
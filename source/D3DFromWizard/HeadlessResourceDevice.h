@@ -0,0 +1,56 @@
+//
+// HeadlessResourceDevice.h - Resource device that keeps uploads in system memory
+//
+
+#pragma once
+
+#include "ResourceRegistry.h"
+
+namespace DX
+{
+    struct HeadlessResourceStatistics
+    {
+        uint32_t    liveResources;
+        uint64_t    liveBytes;
+        uint64_t    uploadedBytes;      // Since construction, across device removals.
+        uint32_t    deviceRemovals;
+    };
+
+    // Stands in for the D3D11 resource device where there is no GPU. Every upload is copied,
+    // as a driver would copy it into a staging area, so restore timings include that cost.
+    class HeadlessResourceDevice : public IResourceDevice
+    {
+    public:
+        HeadlessResourceDevice();
+        ~HeadlessResourceDevice();
+
+        HeadlessResourceDevice(const HeadlessResourceDevice&) = delete;
+        HeadlessResourceDevice& operator=(const HeadlessResourceDevice&) = delete;
+
+        // Drops every resource, as a removed device would. The object then stands in for
+        // the recreated device.
+        void SimulateDeviceRemoved();
+
+        // Hash of every live resource's contents in handle order, to check that a restore
+        // rebuilt exactly what was there before.
+        uint64_t ComputeChecksum() const;
+
+        const HeadlessResourceStatistics& GetStatistics() const     { return m_statistics; }
+
+        // IResourceDevice
+        virtual void CreateResource(ResourceHandle handle, const ResourceDesc& desc, const ResourceSubresource* subresources, uint32_t subresourceCount) override;
+        virtual void ReleaseResource(ResourceHandle handle) override;
+
+    private:
+        struct Resource
+        {
+            ResourceType            type;
+            std::vector<uint8_t>    data;
+        };
+
+        void ReleaseAll();
+
+        std::vector<Resource>           m_resources;    // Handle - 1; empty data while free.
+        HeadlessResourceStatistics      m_statistics;
+    };
+}
@@ -0,0 +1,81 @@
+//
+// HeadlessStreamingTextureDevice.cpp - Streaming texture device that keeps mips in system memory
+//
+
+#include "pch.h"
+#include "HeadlessStreamingTextureDevice.h"
+#include "MemoryTracker.h"
+
+DX::HeadlessStreamingTextureDevice::HeadlessStreamingTextureDevice() :
+    m_statistics{}
+{
+}
+
+DX::HeadlessStreamingTextureDevice::~HeadlessStreamingTextureDevice()
+{
+    ReleaseAll();
+}
+
+void DX::HeadlessStreamingTextureDevice::SimulateDeviceRemoved()
+{
+    ReleaseAll();
+}
+
+void DX::HeadlessStreamingTextureDevice::ReleaseAll()
+{
+    for (Texture& texture : m_textures)
+    {
+        GetMemoryTracker().Free(MemoryCategory_DeviceTextures, texture.data.size());
+    }
+
+    m_textures.clear();
+    m_statistics.liveTextures = 0;
+    m_statistics.liveBytes = 0;
+}
+
+uint32_t DX::HeadlessStreamingTextureDevice::GetFirstMip(uint32_t texture) const
+{
+    return texture < m_textures.size() ? m_textures[texture].firstMip : TextureStreamer::c_notResident;
+}
+
+void DX::HeadlessStreamingTextureDevice::UpdateTexture(uint32_t texture, const TexturePackEntry& entry, uint32_t firstMip,
+    const uint8_t* newMips, uint32_t newMipCount)
+{
+    assert(firstMip + newMipCount <= entry.mipCount);
+
+    if (m_textures.size() <= texture)
+    {
+        m_textures.resize(texture + 1, Texture{ TextureStreamer::c_notResident, std::vector<uint8_t>() });
+    }
+
+    Texture& current = m_textures[texture];
+    const size_t chainStart = GetMipChainOffset(entry.width, entry.height, firstMip);
+    const size_t keptStart = GetMipChainOffset(entry.width, entry.height, firstMip + newMipCount);
+
+    std::vector<uint8_t> data(entry.bytes - chainStart);
+    if (newMipCount > 0)
+    {
+        memcpy(data.data(), newMips, keptStart - chainStart);
+    }
+
+    // The kept mips, from where they sit in the current object.
+    if (firstMip + newMipCount < entry.mipCount)
+    {
+        assert(current.firstMip <= firstMip + newMipCount);
+        size_t offset = keptStart - GetMipChainOffset(entry.width, entry.height, current.firstMip);
+        memcpy(data.data() + keptStart - chainStart, current.data.data() + offset, entry.bytes - keptStart);
+        m_statistics.copiedBytes += entry.bytes - keptStart;
+    }
+
+    GetMemoryTracker().Free(MemoryCategory_DeviceTextures, current.data.size());
+    GetMemoryTracker().Allocate(MemoryCategory_DeviceTextures, data.size());
+
+    m_statistics.liveTextures += current.data.empty() ? 1 : 0;
+    m_statistics.liveBytes += data.size();
+    m_statistics.liveBytes -= current.data.size();
+    m_statistics.uploadedBytes += keptStart - chainStart;
+    m_statistics.updates++;
+
+    current.firstMip = firstMip;
+    current.data.swap(data);
+}
@@ -0,0 +1,56 @@
+//
+// HeadlessStreamingTextureDevice.h - Streaming texture device that keeps mips in system memory
+//
+
+#pragma once
+
+#include "TextureStreamer.h"
+
+namespace DX
+{
+    struct HeadlessStreamingTextureStatistics
+    {
+        uint32_t    liveTextures;
+        uint64_t    liveBytes;
+        uint64_t    uploadedBytes;      // Since construction: tails and loaded mips.
+        uint64_t    copiedBytes;        // Kept mips copied into a texture's new object.
+        uint32_t    updates;
+    };
+
+    // Stands in for the D3D11 streaming device where there is no GPU. Each update builds the
+    // texture's new object as the D3D11 device does, uploading the new mips and copying the
+    // kept ones, so streaming timings include that cost.
+    class HeadlessStreamingTextureDevice : public IStreamingTextureDevice
+    {
+    public:
+        HeadlessStreamingTextureDevice();
+        ~HeadlessStreamingTextureDevice();
+
+        HeadlessStreamingTextureDevice(const HeadlessStreamingTextureDevice&) = delete;
+        HeadlessStreamingTextureDevice& operator=(const HeadlessStreamingTextureDevice&) = delete;
+
+        // Drops every texture, as a removed device would; follow with the streamer's OnDeviceLost.
+        void SimulateDeviceRemoved();
+
+        // c_notResident if the texture has no object.
+        uint32_t GetFirstMip(uint32_t texture) const;
+
+        const HeadlessStreamingTextureStatistics& GetStatistics() const     { return m_statistics; }
+
+        // IStreamingTextureDevice
+        virtual void UpdateTexture(uint32_t texture, const TexturePackEntry& entry, uint32_t firstMip,
+            const uint8_t* newMips, uint32_t newMipCount) override;
+
+    private:
+        struct Texture
+        {
+            uint32_t                firstMip;
+            std::vector<uint8_t>    data;
+        };
+
+        void ReleaseAll();
+
+        std::vector<Texture>                    m_textures;
+        HeadlessStreamingTextureStatistics      m_statistics;
+    };
+}
@@ -0,0 +1,138 @@
+//
+// Histogram.cpp - Fixed-size, lock-free log-linear histogram of integer values
+//
+
+#include "pch.h"
+#include "Histogram.h"
+
+#include <math.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    const uint32_t c_subBucketCount = 1u << DX::Histogram::c_subBucketBits;
+    const uint32_t c_subBucketHalf = c_subBucketCount / 2;
+    const uint64_t c_maxValue = (uint64_t(1) << DX::Histogram::c_maxValueBits) - 1;
+
+    inline uint32_t HighestBit(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+};
+
+DX::Histogram::Histogram()
+{
+    Reset();
+}
+
+uint32_t DX::Histogram::BucketIndex(uint64_t value)
+{
+    if (value < c_subBucketCount)
+    {
+        return static_cast<uint32_t>(value);
+    }
+
+    value = std::min(value, c_maxValue);
+
+    // Shift the value down until it lands in the upper half of the sub-buckets.
+    uint32_t shift = HighestBit(value) - (c_subBucketBits - 1);
+    uint32_t subBucket = static_cast<uint32_t>(value >> shift) - c_subBucketHalf;
+    return c_subBucketCount + (shift - 1) * c_subBucketHalf + subBucket;
+}
+
+uint64_t DX::Histogram::BucketHighestValue(uint32_t index)
+{
+    if (index < c_subBucketCount)
+    {
+        return index;
+    }
+
+    uint32_t shift = (index - c_subBucketCount) / c_subBucketHalf + 1;
+    uint64_t subBucket = (index - c_subBucketCount) % c_subBucketHalf + c_subBucketHalf;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void DX::Histogram::Record(uint64_t value)
+{
+    m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void DX::Histogram::TakeSnapshot(HistogramSnapshot& snapshot) const
+{
+    snapshot.buckets.resize(c_bucketCount);
+    snapshot.count = 0;
+
+    // The count is rebuilt from the buckets so it always agrees with them.
+    for (uint32_t i = 0; i < c_bucketCount; ++i)
+    {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+
+    snapshot.sum = m_sum.load(std::memory_order_relaxed);
+    snapshot.max = m_max.load(std::memory_order_relaxed);
+}
+
+void DX::Histogram::TakeIntervalSnapshot(HistogramSnapshot& snapshot)
+{
+    snapshot.buckets.resize(c_bucketCount);
+    snapshot.count = 0;
+
+    for (uint32_t i = 0; i < c_bucketCount; ++i)
+    {
+        snapshot.buckets[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+
+    snapshot.sum = m_sum.exchange(0, std::memory_order_relaxed);
+    snapshot.max = m_max.exchange(0, std::memory_order_relaxed);
+}
+
+void DX::Histogram::Reset()
+{
+    for (auto& bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t DX::HistogramSnapshot::GetPercentile(double fraction) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(ceil(fraction * count));
+    target = std::max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            return std::min(Histogram::BucketHighestValue(i), max);
+        }
+    }
+
+    return max;
+}
@@ -0,0 +1,65 @@
+//
+// Histogram.h - Fixed-size, lock-free log-linear histogram of integer values
+//
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // A point-in-time copy of a Histogram, for computing percentiles without racing writers.
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t>   buckets;
+        uint64_t                count;
+        uint64_t                sum;
+        uint64_t                max;
+
+        // Highest value equivalent to the bucket holding the given fraction (0..1) of samples.
+        uint64_t GetPercentile(double fraction) const;
+        double GetMean() const  { return count ? static_cast<double>(sum) / count : 0.0; }
+    };
+
+    // HDR-histogram style buckets: values below 128 are exact, above that every power of two
+    // is split into 64 linear sub-buckets, so any recorded value is off by at most 1/64 (1.6%).
+    // Values up to 2^40 are tracked (18 minutes in nanoseconds); larger ones are clamped.
+    //
+    // Record is wait-free (a handful of relaxed atomic adds) and may be called from any number
+    // of threads while another thread takes snapshots.
+    class Histogram
+    {
+    public:
+        static const uint32_t c_subBucketBits = 7;
+        static const uint32_t c_maxValueBits = 40;
+        static const uint32_t c_bucketCount = (1u << c_subBucketBits) + (c_maxValueBits - c_subBucketBits) * (1u << (c_subBucketBits - 1));
+
+        Histogram();
+
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+        void Record(uint64_t value);
+
+        // Copies the counts. Safe against concurrent Record, though a sample recorded during
+        // the copy may be missing from the sum or max while present in the buckets.
+        void TakeSnapshot(HistogramSnapshot& snapshot) const;
+
+        // Copies the counts and zeroes them, so consecutive snapshots cover consecutive
+        // intervals and no sample is counted twice or lost.
+        void TakeIntervalSnapshot(HistogramSnapshot& snapshot);
+
+        // Not safe against concurrent Record.
+        void Reset();
+
+        static uint32_t BucketIndex(uint64_t value);
+        static uint64_t BucketHighestValue(uint32_t index);
+
+    private:
+        std::atomic<uint64_t>   m_buckets[c_bucketCount];
+        std::atomic<uint64_t>   m_sum;
+        std::atomic<uint64_t>   m_max;
+    };
+}
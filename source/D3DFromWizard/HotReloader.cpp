@@ -0,0 +1,231 @@
+//
+// HotReloader.cpp - Rebuilds changed assets on a worker thread and swaps them in between frames
+//
+
+#include "pch.h"
+#include "HotReloader.h"
+#include "Platform.h"
+
+#include <chrono>
+
+namespace
+{
+    // Editors often write a file several times when saving; wait for it to settle.
+    const auto c_debounce = std::chrono::milliseconds(100);
+    const uint32_t c_pollMilliseconds = 50;
+
+    void LogMessage(const std::string& message)
+    {
+        DX::OutputDebugMessage(message.c_str());
+    }
+};
+
+DX::HotReloader::HotReloader() :
+    m_stopping(false),
+    m_statistics{}
+{
+}
+
+DX::HotReloader::~HotReloader()
+{
+    Stop();
+}
+
+bool DX::HotReloader::Watch(const std::string& directory)
+{
+    assert(!m_worker.joinable());
+    return m_watcher.AddDirectory(directory);
+}
+
+void DX::HotReloader::Register(const std::string& path, HotReloadRebuildFunction rebuild)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rebuilds[NormalizePath(path)] = std::move(rebuild);
+}
+
+void DX::HotReloader::Unregister(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rebuilds.erase(NormalizePath(path));
+    m_dependencies.erase(NormalizePath(path));
+}
+
+void DX::HotReloader::SetDependencies(const std::string& path, const std::vector<std::string>& dependencies)
+{
+    std::vector<std::string> normalized;
+    normalized.reserve(dependencies.size());
+    for (const std::string& dependency : dependencies)
+    {
+        normalized.push_back(NormalizePath(dependency));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dependencies[NormalizePath(path)] = std::move(normalized);
+}
+
+void DX::HotReloader::Start()
+{
+    if (m_worker.joinable())
+    {
+        return;
+    }
+
+    m_stopping = false;
+    m_worker = std::thread(&HotReloader::WorkerMain, this);
+}
+
+void DX::HotReloader::Stop()
+{
+    if (m_worker.joinable())
+    {
+        m_stopping = true;
+        m_worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.clear();
+}
+
+size_t DX::HotReloader::ApplyPendingReloads()
+{
+    std::vector<HotReloadInstallFunction> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.empty())
+        {
+            return 0;
+        }
+        pending.swap(m_pending);
+    }
+
+    for (const HotReloadInstallFunction& install : pending)
+    {
+        install();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.installs += static_cast<uint32_t>(pending.size());
+    return pending.size();
+}
+
+DX::HotReloadStatistics DX::HotReloader::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void DX::HotReloader::WorkerMain()
+{
+    SetCurrentThreadName("Hot reload");
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::unordered_map<std::string, Clock::time_point> changed;
+    std::vector<std::string> paths;
+    std::vector<std::string> rebuilds;
+
+    while (!m_stopping)
+    {
+        paths.clear();
+        m_watcher.WaitForChanges(c_pollMilliseconds, paths);
+
+        auto now = Clock::now();
+        for (const std::string& path : paths)
+        {
+            changed[NormalizePath(path)] = now;
+        }
+
+        for (auto it = changed.begin(); it != changed.end() && !m_stopping; )
+        {
+            if (now - it->second < c_debounce)
+            {
+                ++it;
+                continue;
+            }
+
+            GetRebuildPaths(it->first, rebuilds);
+            it = changed.erase(it);
+        }
+
+        // Every file that settled this pass is handled together, so a save touching a shader
+        // and one of its includes rebuilds it once.
+        for (const std::string& path : rebuilds)
+        {
+            if (m_stopping)
+            {
+                break;
+            }
+            Rebuild(path);
+        }
+        rebuilds.clear();
+    }
+}
+
+void DX::HotReloader::GetRebuildPaths(const std::string& changedPath, std::vector<std::string>& paths) const
+{
+    auto add = [&paths](const std::string& path)
+    {
+        if (std::find(paths.begin(), paths.end(), path) == paths.end())
+        {
+            paths.push_back(path);
+        }
+    };
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_rebuilds.count(changedPath))
+    {
+        add(changedPath);
+    }
+    for (const auto& entry : m_dependencies)
+    {
+        if (std::find(entry.second.begin(), entry.second.end(), changedPath) != entry.second.end())
+        {
+            add(entry.first);
+        }
+    }
+}
+
+void DX::HotReloader::Rebuild(const std::string& path)
+{
+    HotReloadRebuildFunction rebuild;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_rebuilds.find(path);
+        if (it == m_rebuilds.end())
+        {
+            return;
+        }
+        rebuild = it->second;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    HotReloadInstallFunction install;
+    std::string error;
+    try
+    {
+        install = rebuild(path);
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.rebuilds++;
+    m_statistics.lastRebuildSeconds = seconds;
+
+    if (!error.empty())
+    {
+        m_statistics.failures++;
+        LogMessage("Hot reload of " + path + " failed, keeping the previous version:\n" + error + "\n");
+        return;
+    }
+
+    if (install)
+    {
+        m_pending.push_back(std::move(install));
+    }
+}
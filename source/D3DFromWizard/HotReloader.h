@@ -0,0 +1,82 @@
+//
+// HotReloader.h - Rebuilds changed assets on a worker thread and swaps them in between frames
+//
+
+#pragma once
+
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace DX
+{
+    struct HotReloadStatistics
+    {
+        uint32_t    rebuilds;
+        uint32_t    failures;
+        uint32_t    installs;
+        double      lastRebuildSeconds;
+    };
+
+    // Runs on the main thread between frames and publishes a rebuilt asset, usually by
+    // replacing the object behind an existing command sink handle.
+    typedef std::function<void()> HotReloadInstallFunction;
+
+    // Runs on the worker thread. Does the expensive part (reading, compiling, creating
+    // device objects; ID3D11Device is free threaded) and returns the install step, or throws.
+    typedef std::function<HotReloadInstallFunction(const std::string& path)> HotReloadRebuildFunction;
+
+    // Watches directories for writes and rebuilds the registered files that changed, or that
+    // depend on a file that changed. Nothing is torn down: the device and every unrelated
+    // resource stay as they are, and a failed rebuild simply keeps the previous version.
+    class HotReloader
+    {
+    public:
+        HotReloader();
+        ~HotReloader();
+
+        HotReloader(const HotReloader&) = delete;
+        HotReloader& operator=(const HotReloader&) = delete;
+
+        // Must be called while stopped.
+        bool Watch(const std::string& directory);
+
+        // May be called at any time. Re-registering a path replaces its rebuild function.
+        void Register(const std::string& path, HotReloadRebuildFunction rebuild);
+        void Unregister(const std::string& path);
+
+        // Rebuilds path when any of dependencies changes as well, e.g. the files a shader
+        // included. Replaces the previous list; may be called from path's rebuild function.
+        void SetDependencies(const std::string& path, const std::vector<std::string>& dependencies);
+
+        void Start();
+
+        // Waits for an in-flight rebuild and discards anything not yet installed. Call before
+        // the objects the rebuild functions refer to are released, e.g. on device lost.
+        void Stop();
+
+        // Call once per frame before any rendering. Returns the number of assets swapped in.
+        size_t ApplyPendingReloads();
+
+        HotReloadStatistics GetStatistics() const;
+
+    private:
+        void WorkerMain();
+        void GetRebuildPaths(const std::string& changedPath, std::vector<std::string>& paths) const;
+        void Rebuild(const std::string& path);
+
+        FileWatcher                                                     m_watcher;
+        std::thread                                                     m_worker;
+        std::atomic<bool>                                               m_stopping;
+
+        mutable std::mutex                                              m_mutex;
+        std::unordered_map<std::string, HotReloadRebuildFunction>       m_rebuilds;
+        std::unordered_map<std::string, std::vector<std::string>>       m_dependencies;
+        std::vector<HotReloadInstallFunction>                           m_pending;
+        HotReloadStatistics                                             m_statistics;
+    };
+}
@@ -0,0 +1,513 @@
+//
+// ImageEncoding.cpp - PNG and Y4M encoding of 8-bit RGBA images, without external libraries
+//
+
+#include "pch.h"
+#include "ImageEncoding.h"
+#include "Inflate.h"
+
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    const uint32_t c_windowSize = 32768;
+    const uint32_t c_minMatch = 3;
+    const uint32_t c_maxMatch = 258;
+    const uint32_t c_hashBits = 15;
+
+    // Candidates tried per position, and the match length above which the positions inside a
+    // match are not added to the hash chains (flat areas give many of these).
+    const uint32_t c_maxChain = 8;
+    const uint32_t c_maxInsertLength = 32;
+
+    // A match this long ends the search, as zlib's nice_length does.
+    const uint32_t c_goodMatch = 64;
+
+    const uint16_t c_lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t c_lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t c_distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t c_distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // The fixed Huffman codes of RFC 1951 3.2.6, bit reversed for an LSB-first writer, and
+    // lookups from match lengths and distances to their codes.
+    struct DeflateTables
+    {
+        DeflateTables()
+        {
+            for (uint32_t symbol = 0; symbol < 288; ++symbol)
+            {
+                uint32_t code, length;
+                if (symbol < 144)       { code = 0x30 + symbol; length = 8; }
+                else if (symbol < 256)  { code = 0x190 + symbol - 144; length = 9; }
+                else if (symbol < 280)  { code = symbol - 256; length = 7; }
+                else                    { code = 0xc0 + symbol - 280; length = 8; }
+
+                literalCodes[symbol] = static_cast<uint16_t>(Reverse(code, length));
+                literalLengths[symbol] = static_cast<uint8_t>(length);
+            }
+
+            for (uint32_t code = 0; code < 30; ++code)
+            {
+                distanceCodes[code] = static_cast<uint8_t>(Reverse(code, 5));
+            }
+
+            for (uint32_t code = 0; code < 29; ++code)
+            {
+                uint32_t end = code == 28 ? c_maxMatch + 1 : c_lengthBase[code + 1];
+                for (uint32_t length = c_lengthBase[code]; length < end; ++length)
+                {
+                    lengthToCode[length] = static_cast<uint8_t>(code);
+                }
+            }
+
+            // As in zlib: distances up to 256 directly, larger ones by their top bits.
+            for (uint32_t code = 0; code < 30; ++code)
+            {
+                uint32_t end = code == 29 ? c_windowSize + 1 : c_distanceBase[code + 1];
+                for (uint32_t distance = c_distanceBase[code]; distance < end; ++distance)
+                {
+                    if (distance <= 256)
+                        smallDistanceToCode[distance - 1] = static_cast<uint8_t>(code);
+                    else
+                        largeDistanceToCode[(distance - 1) >> 7] = static_cast<uint8_t>(code);
+                }
+            }
+        }
+
+        static uint32_t Reverse(uint32_t code, uint32_t length)
+        {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                reversed |= ((code >> i) & 1) << (length - 1 - i);
+            }
+            return reversed;
+        }
+
+        uint32_t DistanceCode(uint32_t distance) const
+        {
+            return distance <= 256 ? smallDistanceToCode[distance - 1] : largeDistanceToCode[(distance - 1) >> 7];
+        }
+
+        uint16_t    literalCodes[288];
+        uint8_t     literalLengths[288];
+        uint8_t     distanceCodes[30];
+        uint8_t     lengthToCode[c_maxMatch + 1];
+        uint8_t     smallDistanceToCode[256];
+        uint8_t     largeDistanceToCode[256];
+    };
+
+    const DeflateTables& GetDeflateTables()
+    {
+        static const DeflateTables tables;
+        return tables;
+    }
+
+    // Writes LSB first into a buffer sized for the worst case, 32 bits at a time.
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* output) : m_output(output), m_bits(0), m_count(0) {}
+
+        // count is at most 16.
+        void Put(uint32_t value, uint32_t count)
+        {
+            m_bits |= uint64_t(value) << m_count;
+            m_count += count;
+            if (m_count >= 32)
+            {
+                m_output[0] = static_cast<uint8_t>(m_bits);
+                m_output[1] = static_cast<uint8_t>(m_bits >> 8);
+                m_output[2] = static_cast<uint8_t>(m_bits >> 16);
+                m_output[3] = static_cast<uint8_t>(m_bits >> 24);
+                m_output += 4;
+                m_bits >>= 32;
+                m_count -= 32;
+            }
+        }
+
+        // Returns the end of the output.
+        uint8_t* Flush()
+        {
+            for (; m_count > 0; m_count -= std::min(m_count, 8u))
+            {
+                *m_output++ = static_cast<uint8_t>(m_bits);
+                m_bits >>= 8;
+            }
+            return m_output;
+        }
+
+    private:
+        uint8_t*    m_output;
+        uint64_t    m_bits;
+        uint32_t    m_count;
+    };
+
+    inline uint32_t Hash3(const uint8_t* data)
+    {
+        uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+        return (value * 2654435761u) >> (32 - c_hashBits);
+    }
+
+    // Length of the common prefix of a and b, up to maxLength, eight bytes at a time.
+    inline uint32_t MatchLength(const uint8_t* a, const uint8_t* b, uint32_t maxLength)
+    {
+        uint32_t length = 0;
+        while (length + 8 <= maxLength)
+        {
+            uint64_t x, y;
+            memcpy(&x, a + length, 8);
+            memcpy(&y, b + length, 8);
+            if (uint64_t difference = x ^ y)
+            {
+                // Little endian: the first differing byte holds the lowest set bit.
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward64(&index, difference);
+                return length + index / 8;
+#else
+                return length + __builtin_ctzll(difference) / 8;
+#endif
+            }
+            length += 8;
+        }
+        while (length < maxLength && a[length] == b[length])
+        {
+            ++length;
+        }
+        return length;
+    }
+
+    // One final block with the fixed codes.
+    void Deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+    {
+        const DeflateTables& tables = GetDeflateTables();
+
+        // Nine bits for the longest literal code, plus the block header and end code.
+        size_t start = output.size();
+        output.resize(start + size / 8 * 9 + 16);
+        BitWriter writer(output.data() + start);
+        writer.Put(1, 1);   // BFINAL
+        writer.Put(1, 2);   // BTYPE = fixed Huffman
+
+        std::vector<int32_t> head(size_t(1) << c_hashBits, -1);
+        std::vector<int32_t> previous(c_windowSize, -1);
+
+        auto insert = [&](size_t position)
+        {
+            uint32_t hash = Hash3(data + position);
+            previous[position & (c_windowSize - 1)] = head[hash];
+            head[hash] = static_cast<int32_t>(position);
+        };
+
+        size_t position = 0;
+        while (position < size)
+        {
+            uint32_t bestLength = 0;
+            uint32_t bestDistance = 0;
+
+            if (position + c_minMatch <= size)
+            {
+                uint32_t maxLength = static_cast<uint32_t>(std::min<size_t>(c_maxMatch, size - position));
+                int32_t candidate = head[Hash3(data + position)];
+                for (uint32_t chain = 0; chain < c_maxChain && candidate >= 0 && position - candidate <= c_windowSize; ++chain)
+                {
+                    const uint8_t* a = data + candidate;
+                    const uint8_t* b = data + position;
+                    if (a[bestLength] == b[bestLength])
+                    {
+                        uint32_t length = MatchLength(a, b, maxLength);
+                        if (length > bestLength)
+                        {
+                            bestLength = length;
+                            bestDistance = static_cast<uint32_t>(position - candidate);
+                            if (length >= c_goodMatch || length == maxLength)
+                                break;
+                        }
+                    }
+
+                    // Slots are reused as the window slides; only follow links backwards.
+                    int32_t next = previous[candidate & (c_windowSize - 1)];
+                    if (next >= candidate)
+                        break;
+                    candidate = next;
+                }
+
+                insert(position);
+            }
+
+            if (bestLength >= c_minMatch)
+            {
+                uint32_t lengthCode = tables.lengthToCode[bestLength];
+                uint32_t symbol = 257 + lengthCode;
+                writer.Put(tables.literalCodes[symbol], tables.literalLengths[symbol]);
+                writer.Put(bestLength - c_lengthBase[lengthCode], c_lengthExtra[lengthCode]);
+
+                uint32_t distanceCode = tables.DistanceCode(bestDistance);
+                writer.Put(tables.distanceCodes[distanceCode], 5);
+                writer.Put(bestDistance - c_distanceBase[distanceCode], c_distanceExtra[distanceCode]);
+
+                if (bestLength <= c_maxInsertLength)
+                {
+                    for (size_t i = position + 1; i < position + bestLength && i + c_minMatch <= size; ++i)
+                    {
+                        insert(i);
+                    }
+                }
+                position += bestLength;
+            }
+            else
+            {
+                writer.Put(tables.literalCodes[data[position]], tables.literalLengths[data[position]]);
+                ++position;
+            }
+        }
+
+        writer.Put(tables.literalCodes[256], tables.literalLengths[256]);
+        output.resize(writer.Flush() - output.data());
+    }
+
+    uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        struct Table
+        {
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t value = i;
+                    for (uint32_t bit = 0; bit < 8; ++bit)
+                    {
+                        value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                    }
+                    entries[i] = value;
+                }
+            }
+            uint32_t entries[256];
+        };
+        static const Table table;
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void PutBigEndian(std::vector<uint8_t>& output, uint32_t value)
+    {
+        output.push_back(static_cast<uint8_t>(value >> 24));
+        output.push_back(static_cast<uint8_t>(value >> 16));
+        output.push_back(static_cast<uint8_t>(value >> 8));
+        output.push_back(static_cast<uint8_t>(value));
+    }
+
+    void PutChunk(std::vector<uint8_t>& png, const char type[4], const uint8_t* data, size_t size)
+    {
+        PutBigEndian(png, static_cast<uint32_t>(size));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        PutBigEndian(png, Crc32(png.data() + start, size + 4));
+    }
+
+    inline void LoadRgb(const uint8_t* pixel, DX::PixelFormat format, uint32_t& r, uint32_t& g, uint32_t& b)
+    {
+        if (format == DX::PixelFormat_Bgra8)
+        {
+            r = pixel[2]; g = pixel[1]; b = pixel[0];
+        }
+        else
+        {
+            r = pixel[0]; g = pixel[1]; b = pixel[2];
+        }
+    }
+
+    inline uint8_t Paeth(uint8_t left, uint8_t up, uint8_t upLeft)
+    {
+        int p = left + up - upLeft;
+        int pa = abs(p - left), pb = abs(p - up), pc = abs(p - upLeft);
+        return pa <= pb && pa <= pc ? left : pb <= pc ? up : upLeft;
+    }
+};
+
+void DX::EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+    std::vector<uint8_t>& png)
+{
+    const size_t rowBytes = size_t(width) * 3;
+
+    // Each row: the filter type, then the row filtered with it.
+    std::vector<uint8_t> filtered((rowBytes + 1) * height);
+
+    std::vector<uint8_t> rows(rowBytes * 2 + 6, 0);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        // Three zero bytes to the left of each row stand for the missing left pixel.
+        uint8_t* current = rows.data() + 3 + (y & 1) * (rowBytes + 3);
+        const uint8_t* previous = rows.data() + 3 + ((y + 1) & 1) * (rowBytes + 3);
+
+        const uint8_t* source = pixels + size_t(y) * rowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t r, g, b;
+            LoadRgb(source + x * 4, format, r, g, b);
+            current[x * 3 + 0] = static_cast<uint8_t>(r);
+            current[x * 3 + 1] = static_cast<uint8_t>(g);
+            current[x * 3 + 2] = static_cast<uint8_t>(b);
+        }
+
+        // Sub, Up, Average and Paeth; the one with the smallest residuals usually compresses
+        // best. Paeth is only tried when the cheaper three leave much behind.
+        uint32_t sums[4] = {};
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            sums[0] += abs(static_cast<int8_t>(current[i] - current[i - 3]));
+            sums[1] += abs(static_cast<int8_t>(current[i] - previous[i]));
+            sums[2] += abs(static_cast<int8_t>(current[i] - ((current[i - 3] + previous[i]) >> 1)));
+        }
+        sums[3] = UINT32_MAX;
+        if (std::min(sums[0], std::min(sums[1], sums[2])) > rowBytes / 4)
+        {
+            sums[3] = 0;
+            for (size_t i = 0; i < rowBytes; ++i)
+            {
+                sums[3] += abs(static_cast<int8_t>(current[i] - Paeth(current[i - 3], previous[i], previous[i - 3])));
+            }
+        }
+
+        uint32_t best = static_cast<uint32_t>(std::min_element(sums, sums + 4) - sums);
+        uint8_t* output = filtered.data() + y * (rowBytes + 1);
+        *output++ = static_cast<uint8_t>(best + 1);
+        switch (best)
+        {
+        case 0:
+            for (size_t i = 0; i < rowBytes; ++i)
+                output[i] = static_cast<uint8_t>(current[i] - current[i - 3]);
+            break;
+        case 1:
+            for (size_t i = 0; i < rowBytes; ++i)
+                output[i] = static_cast<uint8_t>(current[i] - previous[i]);
+            break;
+        case 2:
+            for (size_t i = 0; i < rowBytes; ++i)
+                output[i] = static_cast<uint8_t>(current[i] - ((current[i - 3] + previous[i]) >> 1));
+            break;
+        default:
+            for (size_t i = 0; i < rowBytes; ++i)
+                output[i] = static_cast<uint8_t>(current[i] - Paeth(current[i - 3], previous[i], previous[i - 3]));
+            break;
+        }
+    }
+
+    // zlib stream: header (deflate, 32K window, no dictionary), data, Adler-32.
+    std::vector<uint8_t> compressed;
+    compressed.reserve(filtered.size() / 4 + 64);
+    compressed.push_back(0x78);
+    compressed.push_back(0x01);
+    Deflate(filtered.data(), filtered.size(), compressed);
+    PutBigEndian(compressed, Adler32(filtered.data(), filtered.size()));
+
+    static const uint8_t c_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    png.insert(png.end(), c_signature, c_signature + 8);
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    header.push_back(8);    // Bit depth.
+    header.push_back(2);    // Colour type: RGB.
+    header.push_back(0);    // Deflate.
+    header.push_back(0);    // Adaptive filtering.
+    header.push_back(0);    // Not interlaced.
+    PutChunk(png, "IHDR", header.data(), header.size());
+    PutChunk(png, "IDAT", compressed.data(), compressed.size());
+    PutChunk(png, "IEND", nullptr, 0);
+}
+
+void DX::EncodeY4mHeader(uint32_t width, uint32_t height, uint32_t framesPerSecond, std::vector<uint8_t>& y4m)
+{
+    char header[128];
+    int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+    y4m.insert(y4m.end(), header, header + length);
+}
+
+void DX::EncodeY4mFrame(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+    std::vector<uint8_t>& y4m)
+{
+    static const char c_frame[] = "FRAME\n";
+    y4m.insert(y4m.end(), c_frame, c_frame + 6);
+
+    const uint32_t chromaWidth = (width + 1) / 2;
+    const uint32_t chromaHeight = (height + 1) / 2;
+    size_t lumaStart = y4m.size();
+    size_t uStart = lumaStart + size_t(width) * height;
+    size_t vStart = uStart + size_t(chromaWidth) * chromaHeight;
+    y4m.resize(vStart + size_t(chromaWidth) * chromaHeight);
+
+    uint8_t* luma = y4m.data() + lumaStart;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* source = pixels + size_t(y) * rowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t r, g, b;
+            LoadRgb(source + x * 4, format, r, g, b);
+            *luma++ = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    // Odd edges repeat the last row or column.
+    uint8_t* u = y4m.data() + uStart;
+    uint8_t* v = y4m.data() + vStart;
+    for (uint32_t cy = 0; cy < chromaHeight; ++cy)
+    {
+        const uint8_t* row0 = pixels + size_t(cy * 2) * rowPitch;
+        const uint8_t* row1 = pixels + size_t(std::min(cy * 2 + 1, height - 1)) * rowPitch;
+        for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+        {
+            uint32_t x0 = cx * 2 * 4, x1 = std::min(cx * 2 + 1, width - 1) * 4;
+            int r = 0, g = 0, b = 0;
+            for (const uint8_t* pixel : { row0 + x0, row0 + x1, row1 + x0, row1 + x1 })
+            {
+                uint32_t pr, pg, pb;
+                LoadRgb(pixel, format, pr, pg, pb);
+                r += pr; g += pg; b += pb;
+            }
+            r = (r + 2) >> 2; g = (g + 2) >> 2; b = (b + 2) >> 2;
+
+            *u++ = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            *v++ = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+void DX::ConvertToRgba(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+    std::vector<uint8_t>& rgba)
+{
+    size_t start = rgba.size();
+    rgba.resize(start + size_t(width) * height * 4);
+    uint8_t* destination = rgba.data() + start;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* source = pixels + size_t(y) * rowPitch;
+        if (format == PixelFormat_Rgba8)
+        {
+            memcpy(destination, source, size_t(width) * 4);
+            destination += size_t(width) * 4;
+            continue;
+        }
+
+        for (uint32_t x = 0; x < width; ++x, source += 4, destination += 4)
+        {
+            destination[0] = source[2];
+            destination[1] = source[1];
+            destination[2] = source[0];
+            destination[3] = source[3];
+        }
+    }
+}
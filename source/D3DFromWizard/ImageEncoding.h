@@ -0,0 +1,38 @@
+//
+// ImageEncoding.h - PNG and Y4M encoding of 8-bit RGBA images, without external libraries
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Byte order of four-byte pixels; BGRA is what swap chains usually hold.
+    enum PixelFormat
+    {
+        PixelFormat_Rgba8,
+        PixelFormat_Bgra8,
+    };
+
+    // rowPitch is in bytes. Alpha is dropped: the file is 8-bit RGB, as the alpha of a back
+    // buffer means nothing.
+    //
+    // Rows are filtered with whichever PNG filter gives the smallest sum of residuals, then
+    // compressed with a short-chain LZ77 and the fixed Huffman codes: larger files than
+    // zlib's default level, in much less time, which is what capturing while playing needs.
+    void EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+        std::vector<uint8_t>& png);
+
+    // The YUV4MPEG2 stream header for 4:2:0 frames. Width and height need not be even.
+    void EncodeY4mHeader(uint32_t width, uint32_t height, uint32_t framesPerSecond, std::vector<uint8_t>& y4m);
+
+    // Appends one FRAME: BT.601 limited range, chroma averaged over 2x2 blocks.
+    void EncodeY4mFrame(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+        std::vector<uint8_t>& y4m);
+
+    // Appends the pixels as tightly packed RGBA.
+    void ConvertToRgba(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, PixelFormat format,
+        std::vector<uint8_t>& rgba);
+}
@@ -0,0 +1,468 @@
+//
+// Inflate.cpp - zlib and deflate decoding, without external libraries
+//
+
+#include "pch.h"
+#include "Inflate.h"
+
+namespace
+{
+    const uint16_t c_lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t c_lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t c_distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t c_distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // The order code length code lengths are sent in, RFC 1951 3.2.7.
+    const uint8_t c_codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Codes up to this long decode with one lookup; longer ones, which are rare, by search.
+    const uint32_t c_fastBits = 10;
+    const uint32_t c_maxCodeLength = 15;
+
+    uint32_t Reverse(uint32_t code, uint32_t length)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        }
+        return reversed;
+    }
+
+    // Reads LSB first, keeping at least 56 bits buffered after a refill. Past the end of the
+    // input it reads zeros and remembers how many, so a truncated stream is caught by
+    // IsOverrun rather than by bounds checks on every read.
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t size) : m_next(data), m_end(data + size), m_bits(0), m_count(0), m_padding(0) {}
+
+        void Refill()
+        {
+            if (m_end - m_next >= 8)
+            {
+                uint64_t word;
+                memcpy(&word, m_next, 8);
+                m_bits |= word << m_count;
+                m_next += (63 - m_count) >> 3;
+                m_count |= 56;
+                return;
+            }
+
+            while (m_count <= 56)
+            {
+                uint64_t byte = 0;
+                if (m_next < m_end)
+                {
+                    byte = *m_next++;
+                }
+                else
+                {
+                    ++m_padding;
+                }
+                m_bits |= byte << m_count;
+                m_count += 8;
+            }
+        }
+
+        // count is at most 56 less what was taken since the last refill.
+        uint32_t Peek(uint32_t count) const     { return static_cast<uint32_t>(m_bits & ((uint64_t(1) << count) - 1)); }
+        void Skip(uint32_t count)               { m_bits >>= count; m_count -= count; }
+
+        uint32_t Take(uint32_t count)
+        {
+            uint32_t value = Peek(count);
+            Skip(count);
+            return value;
+        }
+
+        // Drops bits up to the next byte boundary, then hands out the rest of the input.
+        // Returns null if fewer than size bytes are left.
+        const uint8_t* TakeBytes(size_t size)
+        {
+            Skip(m_count & 7);
+            const uint8_t* buffered = m_next - m_count / 8;
+            m_bits = 0;
+            m_count = 0;
+            if (m_padding > 0 || static_cast<size_t>(m_end - buffered) < size)
+            {
+                m_next = m_end;
+                m_padding = 1;
+                return nullptr;
+            }
+            m_next = buffered + size;
+            return buffered;
+        }
+
+        bool IsOverrun() const                  { return m_padding * 8 > m_count; }
+
+    private:
+        const uint8_t*  m_next;
+        const uint8_t*  m_end;
+        uint64_t        m_bits;
+        uint32_t        m_count;
+        uint32_t        m_padding;
+    };
+
+    // A canonical Huffman code. fast holds (length << 9 | symbol) for every c_fastBits pattern
+    // whose code is that short, zero otherwise; longer codes are found by comparing the
+    // bit-reversed input against the last code of each length, as stb_image does.
+    class HuffmanCode
+    {
+    public:
+        // Returns false for an over-subscribed set of lengths. Incomplete sets are allowed, as
+        // a single distance code is.
+        bool Build(const uint8_t* lengths, uint32_t count)
+        {
+            uint32_t counts[c_maxCodeLength + 1] = {};
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                counts[lengths[i]]++;
+            }
+            counts[0] = 0;
+
+            memset(m_fast, 0, sizeof(m_fast));
+            uint32_t code = 0;
+            uint32_t symbols = 0;
+            uint32_t nextCode[c_maxCodeLength + 1];
+            for (uint32_t length = 1; length <= c_maxCodeLength; ++length)
+            {
+                nextCode[length] = code;
+                m_firstCode[length] = static_cast<uint16_t>(code);
+                m_firstSymbol[length] = static_cast<uint16_t>(symbols);
+                code += counts[length];
+                if (counts[length] > 0 && code - 1 >= (1u << length))
+                {
+                    return false;
+                }
+                m_maxCode[length] = code << (16 - length);
+                code <<= 1;
+                symbols += counts[length];
+            }
+            m_maxCode[c_maxCodeLength + 1] = 0x10000;
+            m_symbolCount = symbols;
+
+            for (uint32_t symbol = 0; symbol < count; ++symbol)
+            {
+                uint32_t length = lengths[symbol];
+                if (length == 0)
+                {
+                    continue;
+                }
+
+                uint32_t index = m_firstSymbol[length] + nextCode[length] - m_firstCode[length];
+                m_symbols[index] = static_cast<uint16_t>(symbol);
+                m_lengths[index] = static_cast<uint8_t>(length);
+
+                if (length <= c_fastBits)
+                {
+                    uint16_t entry = static_cast<uint16_t>(length << 9 | symbol);
+                    for (uint32_t pattern = Reverse(nextCode[length], length); pattern < (1u << c_fastBits); pattern += 1u << length)
+                    {
+                        m_fast[pattern] = entry;
+                    }
+                }
+                nextCode[length]++;
+            }
+            return true;
+        }
+
+        // Returns the symbol, or -1 for a pattern no code starts with. At least 15 bits must
+        // be buffered.
+        int Decode(BitReader& reader) const
+        {
+            uint16_t entry = m_fast[reader.Peek(c_fastBits)];
+            if (entry != 0)
+            {
+                reader.Skip(entry >> 9);
+                return entry & 511;
+            }
+
+            uint32_t reversed = Reverse16(reader.Peek(16));
+            uint32_t length = c_fastBits + 1;
+            while (reversed >= m_maxCode[length])
+            {
+                ++length;
+            }
+            if (length > c_maxCodeLength)
+            {
+                return -1;
+            }
+
+            uint32_t index = (reversed >> (16 - length)) - m_firstCode[length] + m_firstSymbol[length];
+            if (index >= m_symbolCount || m_lengths[index] != length)
+            {
+                return -1;
+            }
+            reader.Skip(length);
+            return m_symbols[index];
+        }
+
+    private:
+        static uint32_t Reverse16(uint32_t value)
+        {
+            value = ((value & 0xaaaa) >> 1) | ((value & 0x5555) << 1);
+            value = ((value & 0xcccc) >> 2) | ((value & 0x3333) << 2);
+            value = ((value & 0xf0f0) >> 4) | ((value & 0x0f0f) << 4);
+            value = ((value & 0xff00) >> 8) | ((value & 0x00ff) << 8);
+            return value;
+        }
+
+        uint16_t    m_fast[1 << c_fastBits];
+        uint32_t    m_maxCode[c_maxCodeLength + 2];
+        uint16_t    m_firstCode[c_maxCodeLength + 1];
+        uint16_t    m_firstSymbol[c_maxCodeLength + 1];
+        uint16_t    m_symbols[288];
+        uint8_t     m_lengths[288];
+        uint32_t    m_symbolCount;
+    };
+
+    bool BuildFixedCodes(HuffmanCode& literals, HuffmanCode& distances)
+    {
+        uint8_t lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        uint8_t distanceLengths[30];
+        memset(distanceLengths, 5, sizeof(distanceLengths));
+        return literals.Build(lengths, 288) && distances.Build(distanceLengths, 30);
+    }
+
+    bool ReadDynamicCodes(BitReader& reader, HuffmanCode& literals, HuffmanCode& distances)
+    {
+        reader.Refill();
+        uint32_t literalCount = reader.Take(5) + 257;
+        uint32_t distanceCount = reader.Take(5) + 1;
+        uint32_t codeLengthCount = reader.Take(4) + 4;
+        if (literalCount > 286 || distanceCount > 30)
+        {
+            return false;
+        }
+
+        uint8_t codeLengthLengths[19] = {};
+        for (uint32_t i = 0; i < codeLengthCount; ++i)
+        {
+            reader.Refill();
+            codeLengthLengths[c_codeLengthOrder[i]] = static_cast<uint8_t>(reader.Take(3));
+        }
+
+        HuffmanCode codeLengths;
+        if (!codeLengths.Build(codeLengthLengths, 19))
+        {
+            return false;
+        }
+
+        // Literal and distance lengths form one sequence; repeats may cross from one to the other.
+        uint8_t lengths[286 + 30];
+        uint32_t total = literalCount + distanceCount;
+        for (uint32_t i = 0; i < total; )
+        {
+            reader.Refill();
+            int symbol = codeLengths.Decode(reader);
+            if (symbol < 0 || reader.IsOverrun())
+            {
+                return false;
+            }
+
+            if (symbol < 16)
+            {
+                lengths[i++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            uint32_t repeat;
+            if (symbol == 16)
+            {
+                if (i == 0)
+                {
+                    return false;
+                }
+                value = lengths[i - 1];
+                repeat = 3 + reader.Take(2);
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + reader.Take(3);
+            }
+            else
+            {
+                repeat = 11 + reader.Take(7);
+            }
+
+            if (repeat > total - i)
+            {
+                return false;
+            }
+            memset(lengths + i, value, repeat);
+            i += repeat;
+        }
+
+        // A block must be able to end.
+        return lengths[256] != 0 && literals.Build(lengths, literalCount) && distances.Build(lengths + literalCount, distanceCount);
+    }
+
+    bool InflateBlock(BitReader& reader, const HuffmanCode& literals, const HuffmanCode& distances,
+        uint8_t* output, size_t outputSize, size_t& position)
+    {
+        for (;;)
+        {
+            // 15 bits of literal/length code, 5 extra, 15 of distance code and 13 extra fit
+            // in the 56 one refill guarantees.
+            reader.Refill();
+            int symbol = literals.Decode(reader);
+            if (symbol < 0)
+            {
+                return false;
+            }
+
+            if (symbol < 256)
+            {
+                if (position == outputSize)
+                {
+                    return false;
+                }
+                output[position++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            if (symbol == 256)
+            {
+                return !reader.IsOverrun();
+            }
+
+            symbol -= 257;
+            if (symbol >= 29)
+            {
+                return false;
+            }
+            uint32_t length = c_lengthBase[symbol] + reader.Take(c_lengthExtra[symbol]);
+
+            int distanceSymbol = distances.Decode(reader);
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+            {
+                return false;
+            }
+            uint32_t distance = c_distanceBase[distanceSymbol] + reader.Take(c_distanceExtra[distanceSymbol]);
+
+            if (distance > position || length > outputSize - position || reader.IsOverrun())
+            {
+                return false;
+            }
+
+            uint8_t* target = output + position;
+            const uint8_t* source = target - distance;
+            if (distance >= length)
+            {
+                memcpy(target, source, length);
+            }
+            else
+            {
+                // Overlapping: the copy repeats the last distance bytes.
+                for (uint32_t i = 0; i < length; ++i)
+                {
+                    target[i] = source[i];
+                }
+            }
+            position += length;
+        }
+    }
+}
+
+uint32_t DX::Adler32(const uint8_t* data, size_t size)
+{
+    // 5552 is the most bytes that can be summed before the 32-bit sums could overflow.
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        size_t block = std::min<size_t>(size, 5552);
+        size -= block;
+        while (block--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+bool DX::Inflate(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, size_t& written)
+{
+    BitReader reader(data, size);
+    HuffmanCode literals, distances;
+    size_t position = 0;
+    written = 0;
+
+    for (bool final = false; !final; )
+    {
+        reader.Refill();
+        final = reader.Take(1) != 0;
+        uint32_t type = reader.Take(2);
+
+        if (type == 0)
+        {
+            const uint8_t* header = reader.TakeBytes(4);
+            if (!header)
+            {
+                return false;
+            }
+            uint32_t length = header[0] | header[1] << 8;
+            uint32_t complement = header[2] | header[3] << 8;
+            if ((length ^ 0xffff) != complement || length > outputSize - position)
+            {
+                return false;
+            }
+
+            const uint8_t* stored = reader.TakeBytes(length);
+            if (!stored)
+            {
+                return false;
+            }
+            memcpy(output + position, stored, length);
+            position += length;
+        }
+        else if (type == 1)
+        {
+            if (!BuildFixedCodes(literals, distances) || !InflateBlock(reader, literals, distances, output, outputSize, position))
+            {
+                return false;
+            }
+        }
+        else if (type == 2)
+        {
+            if (!ReadDynamicCodes(reader, literals, distances) || !InflateBlock(reader, literals, distances, output, outputSize, position))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    written = position;
+    return !reader.IsOverrun();
+}
+
+bool DX::InflateZlib(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+{
+    // CMF and FLG: deflate with at most a 32K window, no preset dictionary, and the check bits.
+    if (size < 6 || (data[0] & 0x0f) != 8 || (data[0] >> 4) > 7 || (data[1] & 0x20) != 0 || (data[0] << 8 | data[1]) % 31 != 0)
+    {
+        return false;
+    }
+
+    size_t written;
+    if (!Inflate(data + 2, size - 6, output, outputSize, written) || written != outputSize)
+    {
+        return false;
+    }
+
+    const uint8_t* trailer = data + size - 4;
+    uint32_t checksum = uint32_t(trailer[0]) << 24 | uint32_t(trailer[1]) << 16 | uint32_t(trailer[2]) << 8 | trailer[3];
+    return Adler32(output, outputSize) == checksum;
+}
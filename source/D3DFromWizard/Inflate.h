@@ -0,0 +1,23 @@
+//
+// Inflate.h - zlib and deflate decoding, without external libraries
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DX
+{
+    // The zlib checksum (RFC 1950), shared by the inflater and the PNG encoder.
+    uint32_t Adler32(const uint8_t* data, size_t size);
+
+    // Decodes a raw deflate stream (RFC 1951) into output and sets written to its size. Returns
+    // false if the stream is malformed, ends early or does not fit in outputSize bytes.
+    bool Inflate(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, size_t& written);
+
+    // Decodes a zlib stream (RFC 1950) whose decoded size is known up front, as it is for FBX
+    // arrays and PNG rows. Returns false unless the stream is well formed, decodes to exactly
+    // outputSize bytes and passes its Adler-32 check.
+    bool InflateZlib(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize);
+}
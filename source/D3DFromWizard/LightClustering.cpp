@@ -0,0 +1,446 @@
+//
+// LightClustering.cpp - Assigns point and spot lights to a view-space froxel grid for shading
+//
+
+#include "pch.h"
+#include "LightClustering.h"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LIGHT_CLUSTERING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t c_tilesPerSlice = DX::c_lightGridTilesX * DX::c_lightGridTilesY;
+
+    // Lights per task when computing bounds; a multiple of four.
+    const uint32_t c_boundsBlockSize = 256;
+
+    // Spot cones wider than this are bounded by the sphere around their cap, narrower ones by
+    // the sphere through the apex and the cap's rim.
+    const float c_cosQuarterPi = 0.70710678f;
+
+#if defined(LIGHT_CLUSTERING_SSE2)
+    inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // count - mask adds one in every lane where the comparison held.
+    inline __m128i CountIf(__m128i count, __m128 mask)
+    {
+        return _mm_sub_epi32(count, _mm_castps_si128(mask));
+    }
+#endif
+};
+
+DX::LightClusterBuilder::LightClusterBuilder() :
+    m_sliceScale(0),
+    m_sliceBias(0),
+    m_simd(true),
+    m_lightCount(0),
+    m_slices(c_lightGridSlices),
+    m_clusters(c_lightGridClusters),
+    m_statistics{}
+{
+    SetGrid(LightGridDesc{ 3.14159265f / 4.0f, 16.0f / 9.0f, 0.1f, 100.0f });
+}
+
+void DX::LightClusterBuilder::SetGrid(const LightGridDesc& desc)
+{
+    assert(desc.nearZ > 0.0f && desc.farZ > desc.nearZ);
+    m_grid = desc;
+
+    float logDepthRange = logf(desc.farZ / desc.nearZ);
+    m_sliceScale = c_lightGridSlices / logDepthRange;
+    m_sliceBias = -m_sliceScale * logf(desc.nearZ);
+
+    float tanHalfY = tanf(desc.fovAngleY * 0.5f);
+    float tanHalfX = tanHalfY * desc.aspectRatio;
+
+    for (uint32_t k = 0; k <= c_lightGridTilesX; ++k)
+    {
+        float t = tanHalfX * (-1.0f + 2.0f * k / c_lightGridTilesX);
+        float norm = 1.0f / sqrtf(1.0f + t * t);
+        m_planeAX[k] = norm;
+        m_planeBX[k] = -t * norm;
+    }
+
+    // Row zero is at the top of the screen, as in SV_Position.
+    for (uint32_t k = 0; k <= c_lightGridTilesY; ++k)
+    {
+        float t = tanHalfY * (1.0f - 2.0f * k / c_lightGridTilesY);
+        float norm = 1.0f / sqrtf(1.0f + t * t);
+        m_planeAY[k] = -norm;
+        m_planeBY[k] = t * norm;
+    }
+}
+
+void DX::LightClusterBuilder::Build(const Light* lights, uint32_t count, const float view[4][4], WorkerPool* pool)
+{
+    GatherLights(lights, std::min(count, c_maxClusteredLights));
+
+    auto run = [pool](uint32_t tasks, const std::function<void(uint32_t)>& task)
+    {
+        if (pool)
+        {
+            pool->ParallelFor(tasks, task);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < tasks; ++i)
+            {
+                task(i);
+            }
+        }
+    };
+
+    uint32_t blocks = (m_lightCount + c_boundsBlockSize - 1) / c_boundsBlockSize;
+    run(blocks, [this, view](uint32_t block)
+    {
+        uint32_t first = block * c_boundsBlockSize;
+        uint32_t count = std::min(c_boundsBlockSize, m_lightCount - first);
+        if (m_simd)
+            ComputeBoundsSimd(first, count, view);
+        else
+            ComputeBounds(first, count, view);
+    });
+
+    run(c_lightGridSlices, [this](uint32_t slice) { BinSlice(slice); });
+
+    // Pack the slices' lists into one, slice after slice.
+    m_statistics = LightClusterStatistics{};
+    m_statistics.lights = m_lightCount;
+
+    uint32_t base = 0;
+    for (uint32_t slice = 0; slice < c_lightGridSlices; ++slice)
+    {
+        const SliceBins& bins = m_slices[slice];
+        for (uint32_t tile = 0; tile < c_tilesPerSlice; ++tile)
+        {
+            m_clusters[slice * c_tilesPerSlice + tile] = LightClusterRange{ base + bins.offsets[tile], bins.counts[tile] };
+
+            m_statistics.occupiedClusters += bins.counts[tile] != 0;
+            m_statistics.maxLightsPerCluster = std::max(m_statistics.maxLightsPerCluster, bins.counts[tile]);
+        }
+        base += static_cast<uint32_t>(bins.indices.size());
+    }
+
+    m_lightIndices.resize(base);
+    run(c_lightGridSlices, [this](uint32_t slice)
+    {
+        const SliceBins& bins = m_slices[slice];
+        if (!bins.indices.empty())
+        {
+            uint32_t offset = m_clusters[slice * c_tilesPerSlice].offset;
+            memcpy(m_lightIndices.data() + offset, bins.indices.data(), bins.indices.size() * sizeof(uint16_t));
+        }
+    });
+
+    m_statistics.lightClusterPairs = base;
+    for (uint32_t i = 0; i < m_lightCount; ++i)
+    {
+        m_statistics.visibleLights += m_sliceMin[i] <= m_sliceMax[i];
+    }
+}
+
+int32_t DX::LightClusterBuilder::FindCluster(const float viewPosition[3]) const
+{
+    float z = viewPosition[2];
+    if (z < m_grid.nearZ || z > m_grid.farZ)
+    {
+        return -1;
+    }
+
+    float tanHalfY = tanf(m_grid.fovAngleY * 0.5f);
+    float tanHalfX = tanHalfY * m_grid.aspectRatio;
+    float x = viewPosition[0] / (z * tanHalfX);
+    float y = viewPosition[1] / (z * tanHalfY);
+    if (fabsf(x) > 1.0f || fabsf(y) > 1.0f)
+    {
+        return -1;
+    }
+
+    uint32_t tileX = std::min(static_cast<uint32_t>((x + 1.0f) * 0.5f * c_lightGridTilesX), c_lightGridTilesX - 1);
+    uint32_t tileY = std::min(static_cast<uint32_t>((1.0f - y) * 0.5f * c_lightGridTilesY), c_lightGridTilesY - 1);
+    return static_cast<int32_t>(GetClusterIndex(tileX, tileY, GetSlice(z)));
+}
+
+void DX::LightClusterBuilder::GatherLights(const Light* lights, uint32_t count)
+{
+    m_lightCount = count;
+
+    size_t padded = (count + 3) & ~3u;
+    for (std::vector<float>* array : { &m_positionX, &m_positionY, &m_positionZ, &m_directionX, &m_directionY, &m_directionZ,
+        &m_range, &m_cosAngle, &m_sinAngle, &m_spot })
+    {
+        array->assign(padded, 0.0f);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Light& light = lights[i];
+        m_positionX[i] = light.position[0];
+        m_positionY[i] = light.position[1];
+        m_positionZ[i] = light.position[2];
+        m_range[i] = light.range;
+
+        if (light.type == LightType_Spot)
+        {
+            m_directionX[i] = light.direction[0];
+            m_directionY[i] = light.direction[1];
+            m_directionZ[i] = light.direction[2];
+            m_cosAngle[i] = cosf(light.spotAngle);
+            m_sinAngle[i] = sinf(light.spotAngle);
+            m_spot[i] = 1.0f;
+        }
+        else
+        {
+            m_cosAngle[i] = 1.0f;
+        }
+    }
+
+    // Padding lanes never fall in a slice.
+    m_sliceMin.assign(padded, 1);
+    m_sliceMax.assign(padded, 0);
+    m_bounds.resize(padded);
+}
+
+// For every light: transform to view space, find the bounding sphere, then count the tile
+// boundary planes the sphere lies wholly beyond (the first tile it can touch) and the planes
+// it is not wholly before (one past the last). The planes pass through the eye, so while the
+// sphere is in front of it the plane distances fall monotonically across the screen.
+void DX::LightClusterBuilder::ComputeBounds(uint32_t first, uint32_t count, const float view[4][4])
+{
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        float px = m_positionX[i], py = m_positionY[i], pz = m_positionZ[i];
+        float cx = px * view[0][0] + py * view[1][0] + pz * view[2][0] + view[3][0];
+        float cy = px * view[0][1] + py * view[1][1] + pz * view[2][1] + view[3][1];
+        float cz = px * view[0][2] + py * view[1][2] + pz * view[2][2] + view[3][2];
+
+        float range = m_range[i];
+        float radius = range;
+        if (m_spot[i] != 0.0f)
+        {
+            float dx = m_directionX[i], dy = m_directionY[i], dz = m_directionZ[i];
+            float vx = dx * view[0][0] + dy * view[1][0] + dz * view[2][0];
+            float vy = dx * view[0][1] + dy * view[1][1] + dz * view[2][1];
+            float vz = dx * view[0][2] + dy * view[1][2] + dz * view[2][2];
+
+            float offset;
+            if (m_cosAngle[i] <= c_cosQuarterPi)
+            {
+                offset = range * m_cosAngle[i];
+                radius = range * m_sinAngle[i];
+            }
+            else
+            {
+                offset = range * 0.5f / m_cosAngle[i];
+                radius = offset;
+            }
+
+            cx += vx * offset;
+            cy += vy * offset;
+            cz += vz * offset;
+        }
+
+        uint32_t minX = 0, endX = 0, minY = 0, endY = 0;
+        for (uint32_t k = 0; k <= c_lightGridTilesX; ++k)
+        {
+            float s = m_planeAX[k] * cx + m_planeBX[k] * cz;
+            minX += k > 0 && s > radius;
+            endX += k < c_lightGridTilesX && s >= -radius;
+        }
+        for (uint32_t k = 0; k <= c_lightGridTilesY; ++k)
+        {
+            float s = m_planeAY[k] * cy + m_planeBY[k] * cz;
+            minY += k > 0 && s > radius;
+            endY += k < c_lightGridTilesY && s >= -radius;
+        }
+
+        FinishBounds(i, cz, radius, minX, endX, minY, endY);
+    }
+}
+
+void DX::LightClusterBuilder::ComputeBoundsSimd(uint32_t first, uint32_t count, const float view[4][4])
+{
+#if defined(LIGHT_CLUSTERING_SSE2)
+    const __m128 v00 = _mm_set1_ps(view[0][0]), v01 = _mm_set1_ps(view[0][1]), v02 = _mm_set1_ps(view[0][2]);
+    const __m128 v10 = _mm_set1_ps(view[1][0]), v11 = _mm_set1_ps(view[1][1]), v12 = _mm_set1_ps(view[1][2]);
+    const __m128 v20 = _mm_set1_ps(view[2][0]), v21 = _mm_set1_ps(view[2][1]), v22 = _mm_set1_ps(view[2][2]);
+    const __m128 v30 = _mm_set1_ps(view[3][0]), v31 = _mm_set1_ps(view[3][1]), v32 = _mm_set1_ps(view[3][2]);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 cosQuarterPi = _mm_set1_ps(c_cosQuarterPi);
+
+    for (uint32_t i = first; i < first + count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(&m_positionX[i]);
+        __m128 py = _mm_loadu_ps(&m_positionY[i]);
+        __m128 pz = _mm_loadu_ps(&m_positionZ[i]);
+        __m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, v00), _mm_mul_ps(py, v10)), _mm_mul_ps(pz, v20)), v30);
+        __m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, v01), _mm_mul_ps(py, v11)), _mm_mul_ps(pz, v21)), v31);
+        __m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, v02), _mm_mul_ps(py, v12)), _mm_mul_ps(pz, v22)), v32);
+
+        __m128 dx = _mm_loadu_ps(&m_directionX[i]);
+        __m128 dy = _mm_loadu_ps(&m_directionY[i]);
+        __m128 dz = _mm_loadu_ps(&m_directionZ[i]);
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, v00), _mm_mul_ps(dy, v10)), _mm_mul_ps(dz, v20));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, v01), _mm_mul_ps(dy, v11)), _mm_mul_ps(dz, v21));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, v02), _mm_mul_ps(dy, v12)), _mm_mul_ps(dz, v22));
+
+        __m128 range = _mm_loadu_ps(&m_range[i]);
+        __m128 cosAngle = _mm_loadu_ps(&m_cosAngle[i]);
+        __m128 spot = _mm_cmpneq_ps(_mm_loadu_ps(&m_spot[i]), zero);
+        __m128 wide = _mm_cmple_ps(cosAngle, cosQuarterPi);
+
+        __m128 narrowOffset = _mm_div_ps(_mm_mul_ps(range, half), cosAngle);
+        __m128 offset = Select(wide, _mm_mul_ps(range, cosAngle), narrowOffset);
+        __m128 radius = Select(wide, _mm_mul_ps(range, _mm_loadu_ps(&m_sinAngle[i])), narrowOffset);
+        offset = _mm_and_ps(spot, offset);
+        radius = Select(spot, radius, range);
+
+        cx = _mm_add_ps(cx, _mm_mul_ps(vx, offset));
+        cy = _mm_add_ps(cy, _mm_mul_ps(vy, offset));
+        cz = _mm_add_ps(cz, _mm_mul_ps(vz, offset));
+
+        __m128 negativeRadius = _mm_sub_ps(zero, radius);
+        __m128i minX = _mm_setzero_si128(), endX = _mm_setzero_si128();
+        for (uint32_t k = 0; k <= c_lightGridTilesX; ++k)
+        {
+            __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planeAX[k]), cx), _mm_mul_ps(_mm_set1_ps(m_planeBX[k]), cz));
+            if (k > 0)
+                minX = CountIf(minX, _mm_cmpgt_ps(s, radius));
+            if (k < c_lightGridTilesX)
+                endX = CountIf(endX, _mm_cmpge_ps(s, negativeRadius));
+        }
+
+        __m128i minY = _mm_setzero_si128(), endY = _mm_setzero_si128();
+        for (uint32_t k = 0; k <= c_lightGridTilesY; ++k)
+        {
+            __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planeAY[k]), cy), _mm_mul_ps(_mm_set1_ps(m_planeBY[k]), cz));
+            if (k > 0)
+                minY = CountIf(minY, _mm_cmpgt_ps(s, radius));
+            if (k < c_lightGridTilesY)
+                endY = CountIf(endY, _mm_cmpge_ps(s, negativeRadius));
+        }
+
+        alignas(16) float depths[4], radii[4];
+        alignas(16) uint32_t minXs[4], endXs[4], minYs[4], endYs[4];
+        _mm_store_ps(depths, cz);
+        _mm_store_ps(radii, radius);
+        _mm_store_si128(reinterpret_cast<__m128i*>(minXs), minX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(endXs), endX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(minYs), minY);
+        _mm_store_si128(reinterpret_cast<__m128i*>(endYs), endY);
+
+        for (uint32_t lane = 0; lane < 4 && i + lane < first + count; ++lane)
+        {
+            FinishBounds(i + lane, depths[lane], radii[lane], minXs[lane], endXs[lane], minYs[lane], endYs[lane]);
+        }
+    }
+#else
+    ComputeBounds(first, count, view);
+#endif
+}
+
+void DX::LightClusterBuilder::FinishBounds(uint32_t light, float cz, float radius, uint32_t minX, uint32_t endX, uint32_t minY, uint32_t endY)
+{
+    float zMin = cz - radius;
+    float zMax = cz + radius;
+
+    // A sphere around the eye can reach every tile, and the plane counts assume it is in front.
+    if (zMin <= 0.0f)
+    {
+        minX = minY = 0;
+        endX = c_lightGridTilesX;
+        endY = c_lightGridTilesY;
+    }
+
+    if (zMax < m_grid.nearZ || zMin > m_grid.farZ || minX >= endX || minY >= endY)
+    {
+        m_sliceMin[light] = 1;
+        m_sliceMax[light] = 0;
+        return;
+    }
+
+    m_sliceMin[light] = static_cast<int32_t>(GetSlice(std::max(zMin, m_grid.nearZ)));
+    m_sliceMax[light] = static_cast<int32_t>(GetSlice(std::min(zMax, m_grid.farZ)));
+    m_bounds[light] = LightBounds{ static_cast<uint16_t>(minX), static_cast<uint16_t>(endX - 1),
+        static_cast<uint16_t>(minY), static_cast<uint16_t>(endY - 1) };
+}
+
+// Counting sort of the slice's light-tile pairs by tile, so each tile's lights end up
+// contiguous and in input order.
+void DX::LightClusterBuilder::BinSlice(uint32_t slice)
+{
+    SliceBins& bins = m_slices[slice];
+    bins.candidates.clear();
+
+#if defined(LIGHT_CLUSTERING_SSE2)
+    const __m128i sliceIndex = _mm_set1_epi32(static_cast<int32_t>(slice));
+    for (uint32_t i = 0; i < m_lightCount; i += 4)
+    {
+        __m128i outside = _mm_or_si128(
+            _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_sliceMin[i])), sliceIndex),
+            _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_sliceMax[i])), sliceIndex));
+
+        int inside = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+        for (uint32_t lane = 0; inside != 0; ++lane, inside >>= 1)
+        {
+            if (inside & 1)
+                bins.candidates.push_back(static_cast<uint16_t>(i + lane));
+        }
+    }
+#else
+    for (uint32_t i = 0; i < m_lightCount; ++i)
+    {
+        if (m_sliceMin[i] <= static_cast<int32_t>(slice) && m_sliceMax[i] >= static_cast<int32_t>(slice))
+            bins.candidates.push_back(static_cast<uint16_t>(i));
+    }
+#endif
+
+    memset(bins.counts, 0, sizeof(bins.counts));
+    for (uint16_t light : bins.candidates)
+    {
+        const LightBounds& bounds = m_bounds[light];
+        for (uint32_t y = bounds.tileMinY; y <= bounds.tileMaxY; ++y)
+        {
+            for (uint32_t x = bounds.tileMinX; x <= bounds.tileMaxX; ++x)
+            {
+                bins.counts[y * c_lightGridTilesX + x]++;
+            }
+        }
+    }
+
+    uint32_t cursor[c_tilesPerSlice];
+    uint32_t total = 0;
+    for (uint32_t tile = 0; tile < c_tilesPerSlice; ++tile)
+    {
+        bins.offsets[tile] = cursor[tile] = total;
+        total += bins.counts[tile];
+    }
+
+    bins.indices.resize(total);
+    for (uint16_t light : bins.candidates)
+    {
+        const LightBounds& bounds = m_bounds[light];
+        for (uint32_t y = bounds.tileMinY; y <= bounds.tileMaxY; ++y)
+        {
+            for (uint32_t x = bounds.tileMinX; x <= bounds.tileMaxX; ++x)
+            {
+                bins.indices[cursor[y * c_lightGridTilesX + x]++] = light;
+            }
+        }
+    }
+}
+
+uint32_t DX::LightClusterBuilder::GetSlice(float z) const
+{
+    float slice = floorf(logf(z) * m_sliceScale + m_sliceBias);
+    return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(c_lightGridSlices - 1)));
+}
@@ -0,0 +1,154 @@
+//
+// LightClustering.h - Assigns point and spot lights to a view-space froxel grid for shading
+//
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace DX
+{
+    // Grid dimensions; shaders/ClusteredLighting.hlsli must agree. Tiles split the screen,
+    // slices split view depth exponentially so clusters stay roughly cubic.
+    const uint32_t c_lightGridTilesX = 16;
+    const uint32_t c_lightGridTilesY = 8;
+    const uint32_t c_lightGridSlices = 24;
+    const uint32_t c_lightGridClusters = c_lightGridTilesX * c_lightGridTilesY * c_lightGridSlices;
+
+    // Light indices are 16 bit in the shading lists.
+    const uint32_t c_maxClusteredLights = 4096;
+
+    enum LightType
+    {
+        LightType_Point,
+        LightType_Spot,
+    };
+
+    struct Light
+    {
+        float       position[3];        // World space.
+        float       range;              // Distance at which the light has faded to nothing.
+        float       direction[3];       // Spot lights only, unit length.
+        float       spotAngle;          // Half angle of the outer cone in radians, below pi / 2.
+        float       color[3];
+        LightType   type;
+    };
+
+    // Matches the uint2 per cluster read by the shader: the cluster's lights are
+    // indices[offset, offset + count).
+    struct LightClusterRange
+    {
+        uint32_t    offset;
+        uint32_t    count;
+    };
+
+    struct LightGridDesc
+    {
+        float       fovAngleY;
+        float       aspectRatio;
+        float       nearZ;
+        float       farZ;
+    };
+
+    struct LightClusterStatistics
+    {
+        uint32_t    lights;
+        uint32_t    visibleLights;      // Touching at least one cluster.
+        uint32_t    lightClusterPairs;  // Length of the index list.
+        uint32_t    occupiedClusters;
+        uint32_t    maxLightsPerCluster;
+    };
+
+    // Builds the per-cluster light lists every frame. Each light's bounding sphere is moved to
+    // view space and turned into a conservative range of tiles and slices, four lights at a
+    // time with SSE2 where available; the slices are then filled in parallel on the worker
+    // pool and packed into one index list.
+    class LightClusterBuilder
+    {
+    public:
+        LightClusterBuilder();
+
+        void SetGrid(const LightGridDesc& desc);
+
+        // For comparison in benchmarks; the results are identical either way.
+        void SetSimdEnabled(bool enabled)       { m_simd = enabled; }
+
+        // view is the row-vector world-to-view matrix (DirectXMath convention, +z forward).
+        // Lights beyond c_maxClusteredLights are ignored. A null pool builds on the calling thread.
+        void Build(const Light* lights, uint32_t count, const float view[4][4], WorkerPool* pool);
+
+        // Cluster holding a view-space position, as the shader computes it; -1 outside the grid.
+        int32_t FindCluster(const float viewPosition[3]) const;
+
+        static uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice)
+        {
+            return (slice * c_lightGridTilesY + tileY) * c_lightGridTilesX + tileX;
+        }
+
+        const std::vector<LightClusterRange>& GetClusters() const   { return m_clusters; }
+        const std::vector<uint16_t>& GetLightIndices() const        { return m_lightIndices; }
+        const LightClusterStatistics& GetStatistics() const         { return m_statistics; }
+
+        // Shader constants for converting depth to a slice: floor(log(z) * scale + bias).
+        float GetSliceScale() const             { return m_sliceScale; }
+        float GetSliceBias() const              { return m_sliceBias; }
+
+    private:
+        // View-space bounds of one light, in input order.
+        struct LightBounds
+        {
+            uint16_t    tileMinX;
+            uint16_t    tileMaxX;
+            uint16_t    tileMinY;
+            uint16_t    tileMaxY;
+        };
+
+        struct SliceBins
+        {
+            std::vector<uint16_t>   candidates;
+            std::vector<uint16_t>   indices;
+            uint32_t                offsets[c_lightGridTilesX * c_lightGridTilesY];
+            uint32_t                counts[c_lightGridTilesX * c_lightGridTilesY];
+        };
+
+        void GatherLights(const Light* lights, uint32_t count);
+        void ComputeBounds(uint32_t first, uint32_t count, const float view[4][4]);
+        void ComputeBoundsSimd(uint32_t first, uint32_t count, const float view[4][4]);
+        // Tiles [minX, endX) by [minY, endY) come from counting the boundary planes the
+        // sphere lies wholly beyond or touches; see ComputeBounds.
+        void FinishBounds(uint32_t light, float cz, float radius, uint32_t minX, uint32_t endX, uint32_t minY, uint32_t endY);
+        void BinSlice(uint32_t slice);
+        uint32_t GetSlice(float z) const;
+
+        LightGridDesc                   m_grid;
+        float                           m_sliceScale;
+        float                           m_sliceBias;
+        bool                            m_simd;
+
+        // Tile boundary planes through the eye, s = a * x + b * z (or y), positive towards
+        // higher tile numbers. c_lightGridTilesX + 1 and c_lightGridTilesY + 1 of them.
+        float                           m_planeAX[c_lightGridTilesX + 1];
+        float                           m_planeBX[c_lightGridTilesX + 1];
+        float                           m_planeAY[c_lightGridTilesY + 1];
+        float                           m_planeBY[c_lightGridTilesY + 1];
+
+        // Lights in structure-of-arrays form, padded to a multiple of four.
+        uint32_t                        m_lightCount;
+        std::vector<float>              m_positionX, m_positionY, m_positionZ;
+        std::vector<float>              m_directionX, m_directionY, m_directionZ;
+        std::vector<float>              m_range, m_cosAngle, m_sinAngle, m_spot;
+
+        // Per light results: inclusive slice range (empty when min > max) and tile range.
+        std::vector<int32_t>            m_sliceMin;
+        std::vector<int32_t>            m_sliceMax;
+        std::vector<LightBounds>        m_bounds;
+
+        std::vector<SliceBins>          m_slices;
+        std::vector<LightClusterRange>  m_clusters;
+        std::vector<uint16_t>           m_lightIndices;
+        LightClusterStatistics          m_statistics;
+    };
+}
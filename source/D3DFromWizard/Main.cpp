@@ -4,260 +4,201 @@
 
 #include "pch.h"
 #include "Game.h"
+#include "RunLoop.h"
 
-using namespace DirectX;
+#include <stdexcept>
+#include <string>
 
 namespace
 {
     std::unique_ptr<Game> g_game;
-};
-
-LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
+    std::unique_ptr<DX::IPlatformWindow> g_window;
 
-// Indicates to hybrid graphics systems to prefer the discrete part by default
-extern "C"
-{
-    __declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
-    __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
-}
-
-// Entry point
-int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
-{
-    UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
+    struct RunOptions
+    {
+        uint64_t            maxFrames = 0;          // Zero runs until the window closes.
+        bool                benchmark = false;      // Tick as fast as possible, even in the background.
 
-    if (!XMVerifyCPUSupport())
-        return 1;
+        const char*         capturePath = nullptr;  // Capture every frame if set.
+        DX::CaptureFormat   captureFormat = DX::CaptureFormat_Y4m;
 
-    HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
-    if (FAILED(hr))
-        return 1;
+        // Render the jobs listed in this file and exit, instead of running the game loop.
+        const char*         batchPath = nullptr;
+        std::string         assetDirectory = ".";
 
-    g_game = std::make_unique<Game>();
+        // Draw this preset scene (see DX::GetPresetScenes), with its mesh under assetDirectory.
+        const char*         sceneName = nullptr;
+    };
 
-    // Register class and create window
+    int RunGame(const RunOptions& options)
     {
-        // Register class
-        WNDCLASSEX wcex;
-        wcex.cbSize = sizeof(WNDCLASSEX);
-        wcex.style = CS_HREDRAW | CS_VREDRAW;
-        wcex.lpfnWndProc = WndProc;
-        wcex.cbClsExtra = 0;
-        wcex.cbWndExtra = 0;
-        wcex.hInstance = hInstance;
-        wcex.hIcon = LoadIcon(hInstance, L"IDI_ICON");
-        wcex.hCursor = LoadCursor(nullptr, IDC_ARROW);
-        wcex.hbrBackground = (HBRUSH) (COLOR_WINDOW + 1);
-        wcex.lpszMenuName = nullptr;
-        wcex.lpszClassName = L"D3DFromWizardWindowClass";
-        wcex.hIconSm = LoadIcon(wcex.hInstance, L"IDI_ICON");
-        if (!RegisterClassEx(&wcex))
-            return 1;
-
-        // Create window
-        int w, h;
-        g_game->GetDefaultSize(w, h);
-
-        RECT rc;
-        rc.top = 0;
-        rc.left = 0;
-        rc.right = static_cast<LONG>(w); 
-        rc.bottom = static_cast<LONG>(h);
+        std::vector<DX::BatchJob> batchJobs;
+        if (options.batchPath)
+        {
+            std::string error;
+            if (!DX::LoadBatchJobs(options.batchPath, batchJobs, error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
 
-        AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
+        if (!DX::InitializePlatform())
+            return 1;
 
-        HWND hwnd = CreateWindowEx(0, L"D3DFromWizardWindowClass", L"D3DFromWizard", WS_OVERLAPPEDWINDOW,
-            CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr, nullptr, hInstance,
-            nullptr);
-        // TODO: Change to CreateWindowEx(WS_EX_TOPMOST, L"D3DFromWizardWindowClass", L"D3DFromWizard", WS_POPUP,
-        // to default to fullscreen.
+        g_game = std::make_unique<Game>();
 
-        if (!hwnd)
+        // Create window
+        DX::PlatformWindowDesc desc = {};
+        desc.title = "D3DFromWizard";
+        g_game->GetDefaultSize(desc.width, desc.height);
+        desc.minWidth = 320;
+        desc.minHeight = 200;
+
+        g_window = DX::CreatePlatformWindow(desc);
+        if (!g_window)
             return 1;
 
-        ShowWindow(hwnd, nCmdShow);
-        // TODO: Change nCmdShow to SW_SHOWMAXIMIZED to default to fullscreen.
+        int width, height;
+        g_window->GetClientSize(width, height);
 
-        SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(g_game.get()) );
+        g_game->Initialize(g_window->GetNativeHandle(), width, height);
 
-        GetClientRect(hwnd, &rc);
+        if (options.batchPath)
+        {
+            bool succeeded = g_game->RunBatch(batchJobs, options.assetDirectory);
 
-        g_game->Initialize(hwnd, rc.right - rc.left, rc.bottom - rc.top);
-    }
+            g_game.reset();
+            g_window.reset();
+            DX::ShutdownPlatform();
+            return succeeded ? 0 : 1;
+        }
 
-    // Main message loop
-    MSG msg = { 0 };
-    while (WM_QUIT != msg.message)
-    {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+        if (options.sceneName)
         {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+            const DX::PresetSceneDesc* scene = DX::FindPresetScene(options.sceneName);
+            try
+            {
+                if (!scene)
+                {
+                    throw std::runtime_error(std::string("Unknown scene ") + options.sceneName);
+                }
+                g_game->LoadScene(*scene, options.assetDirectory);
+            }
+            catch (const std::exception& exception)
+            {
+                fprintf(stderr, "%s\n", exception.what());
+                g_game.reset();
+                g_window.reset();
+                DX::ShutdownPlatform();
+                return 1;
+            }
         }
-        else
+
+        if (options.capturePath && !g_game->StartCapture(options.capturePath, options.captureFormat))
         {
-            g_game->Tick();
+            fprintf(stderr, "Cannot capture to %s\n", options.capturePath);
         }
-    }
 
-    g_game.reset();
+        // Main message loop
+        DX::RunLoop runLoop;
+        runLoop.SetBenchmarkMode(options.benchmark);
+
+        int exitCode = runLoop.Run(*g_window, *g_game, options.maxFrames);
+
+        g_game->StopCapture();
+
+        DX::OutputDebugMessage(runLoop.FormatStatistics().c_str());
+        DX::OutputDebugMessage(DX::FormatMemorySnapshot(DX::GetMemoryTracker().TakeSnapshot()).c_str());
+
+        g_game.reset();
+        g_window.reset();
+
+        DX::ShutdownPlatform();
+
+        return exitCode;
+    }
+};
 
-    CoUninitialize();
+#if defined(_WIN32)
 
-    return (int) msg.wParam;
+// Indicates to hybrid graphics systems to prefer the discrete part by default
+extern "C"
+{
+    __declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
+    __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 }
 
-// Windows procedure
-LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+// Entry point
+int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
-    PAINTSTRUCT ps;
-    HDC hdc;
+    UNREFERENCED_PARAMETER(hInstance);
+    UNREFERENCED_PARAMETER(hPrevInstance);
+    UNREFERENCED_PARAMETER(lpCmdLine);
+    UNREFERENCED_PARAMETER(nCmdShow);
 
-    static bool s_in_sizemove = false;
-    static bool s_in_suspend = false;
-    static bool s_minimized = false;
-    static bool s_fullscreen = false;
-    // TODO: Set s_fullscreen to true if defaulting to fullscreen.
+    return RunGame(RunOptions());
+}
 
-    auto game = reinterpret_cast<Game*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+#else
 
-    switch (message)
-    {
-    case WM_PAINT:
-        hdc = BeginPaint(hWnd, &ps);
-        EndPaint(hWnd, &ps);
-        break;
+// Entry point. --frames <n> exits after n frames and --benchmark removes the frame rate cap,
+// for profiling runs. --capture <path> streams the frames to disk, as a Y4M video unless
+// --capture-format picks raw RGBA or PNG files (path is then a prefix). --batch <jobs> renders
+// the images a job file lists (see DX::LoadBatchJobs), with meshes found under --assets <dir>.
+// --scene <name> draws a preset scene (see DX::GetPresetScenes) with its mesh under --assets.
+int main(int argc, char** argv)
+{
+    RunOptions options;
 
-    case WM_SIZE:
-        if (wParam == SIZE_MINIMIZED)
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--frames" && i + 1 < argc)
         {
-            if (!s_minimized)
-            {
-                s_minimized = true;
-                if (!s_in_suspend && game)
-                    game->OnSuspending();
-                s_in_suspend = true;
-            }
+            options.maxFrames = strtoull(argv[++i], nullptr, 10);
         }
-        else if (s_minimized)
+        else if (argument == "--benchmark")
         {
-            s_minimized = false;
-            if (s_in_suspend && game)
-                game->OnResuming();
-            s_in_suspend = false;
+            options.benchmark = true;
         }
-        else if (!s_in_sizemove && game)
+        else if (argument == "--capture" && i + 1 < argc)
         {
-            game->OnWindowSizeChanged(LOWORD(lParam), HIWORD(lParam));
+            options.capturePath = argv[++i];
         }
-        break;
-
-    case WM_ENTERSIZEMOVE:
-        s_in_sizemove = true;
-        break;
-
-    case WM_EXITSIZEMOVE:
-        s_in_sizemove = false;
-        if (game)
+        else if (argument == "--capture-format" && i + 1 < argc && DX::ParseCaptureFormat(argv[i + 1], options.captureFormat))
         {
-            RECT rc;
-            GetClientRect(hWnd, &rc);
-
-            game->OnWindowSizeChanged(rc.right - rc.left, rc.bottom - rc.top);
+            ++i;
         }
-        break;
-
-    case WM_GETMINMAXINFO:
+        else if (argument == "--batch" && i + 1 < argc)
         {
-            auto info = reinterpret_cast<MINMAXINFO*>(lParam);
-            info->ptMinTrackSize.x = 320;
-            info->ptMinTrackSize.y = 200;
+            options.batchPath = argv[++i];
         }
-        break;
-
-    case WM_ACTIVATEAPP:
-        if (game)
+        else if (argument == "--assets" && i + 1 < argc)
         {
-            if (wParam)
-            {
-                game->OnActivated();
-            }
-            else
-            {
-                game->OnDeactivated();
-            }
+            options.assetDirectory = argv[++i];
         }
-        break;
-
-    case WM_POWERBROADCAST:
-        switch (wParam)
+        else if (argument == "--scene" && i + 1 < argc)
         {
-        case PBT_APMQUERYSUSPEND:
-            if (!s_in_suspend && game)
-                game->OnSuspending();
-            s_in_suspend = true;
-            return TRUE;
-
-        case PBT_APMRESUMESUSPEND:
-            if (!s_minimized)
-            {
-                if (s_in_suspend && game)
-                    game->OnResuming();
-                s_in_suspend = false;
-            }
-            return TRUE;
+            options.sceneName = argv[++i];
         }
-        break;
-
-    case WM_DESTROY:
-        PostQuitMessage(0);
-        break;
-
-    case WM_SYSKEYDOWN:
-        if (wParam == VK_RETURN && (lParam & 0x60000000) == 0x20000000)
+        else
         {
-            // Implements the classic ALT+ENTER fullscreen toggle
-            if (s_fullscreen)
-            {
-                SetWindowLongPtr(hWnd, GWL_STYLE, WS_OVERLAPPEDWINDOW);
-                SetWindowLongPtr(hWnd, GWL_EXSTYLE, 0);
-
-                int width = 1024;
-                int height = 768;
-                if (game)
-                    game->GetDefaultSize(width, height);
-
-                ShowWindow(hWnd, SW_SHOWNORMAL);
-
-                SetWindowPos(hWnd, HWND_TOP, 0, 0, width, height, SWP_NOMOVE | SWP_NOZORDER | SWP_FRAMECHANGED);
-            }
-            else
-            {
-                SetWindowLongPtr(hWnd, GWL_STYLE, 0);
-                SetWindowLongPtr(hWnd, GWL_EXSTYLE, WS_EX_TOPMOST);
-
-                SetWindowPos(hWnd, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_FRAMECHANGED);
-
-                ShowWindow(hWnd, SW_SHOWMAXIMIZED);
-            }
-
-            s_fullscreen = !s_fullscreen;
+            fprintf(stderr, "usage: %s [--frames <n>] [--benchmark] [--capture <path>] [--capture-format raw|png|y4m]\n"
+                "       [--scene <name> [--assets <dir>]]\n"
+                "       %s --batch <jobs> [--assets <dir>]\n", argv[0], argv[0]);
+            return 1;
         }
-        break;
-
-    case WM_MENUCHAR:
-        // A menu is active and the user presses a key that does not correspond
-        // to any mnemonic or accelerator key. Ignore so we don't produce an error beep.
-        return MAKELRESULT(0, MNC_CLOSE);
     }
 
-    return DefWindowProc(hWnd, message, wParam, lParam);
+    return RunGame(options);
 }
 
+#endif
 
 // Exit helper
 void ExitGame()
 {
-    PostQuitMessage(0);
-}
\ No newline at end of file
+    if (g_window)
+        g_window->Close();
+}
@@ -0,0 +1,178 @@
+//
+// MappedFile.cpp - Read-only memory mapped file
+//
+
+#include "pch.h"
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+
+namespace
+{
+    std::wstring Widen(const std::string& path)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring result(length > 0 ? length - 1 : 0, L'\0');
+        if (length > 1)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &result[0], length);
+        }
+        return result;
+    }
+};
+
+DX::MappedFile::MappedFile() :
+    m_data(nullptr),
+    m_size(0),
+    m_open(false),
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr)
+{
+}
+
+DX::MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool DX::MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    m_file = CreateFileW(Widen(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        Close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+    m_open = true;
+
+    if (m_size == 0)
+    {
+        return true;
+    }
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void DX::MappedFile::Close()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+
+    m_size = 0;
+    m_open = false;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DX::MappedFile::MappedFile() :
+    m_data(nullptr),
+    m_size(0),
+    m_open(false),
+    m_file(-1)
+{
+}
+
+DX::MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool DX::MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    m_file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_file < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(m_file, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        Close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(status.st_size);
+    m_open = true;
+
+    if (m_size == 0)
+    {
+        return true;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(data);
+    return true;
+}
+
+void DX::MappedFile::Close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        m_data = nullptr;
+    }
+
+    if (m_file >= 0)
+    {
+        close(m_file);
+        m_file = -1;
+    }
+
+    m_size = 0;
+    m_open = false;
+}
+
+#endif
@@ -0,0 +1,44 @@
+//
+// MappedFile.h - Read-only memory mapped file
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace DX
+{
+    // Maps a whole file read-only. Pages are brought in by the OS on first touch, so opening
+    // a large cache or asset file costs nothing until its contents are actually used.
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Returns false if the file does not exist or cannot be mapped. Empty files open
+        // successfully with a null data pointer.
+        bool Open(const std::string& path);
+        void Close();
+
+        bool IsOpen() const                 { return m_open; }
+        const uint8_t* GetData() const      { return m_data; }
+        size_t GetSize() const              { return m_size; }
+
+    private:
+        const uint8_t*  m_data;
+        size_t          m_size;
+        bool            m_open;
+
+#if defined(_WIN32)
+        HANDLE          m_file;
+        HANDLE          m_mapping;
+#else
+        int             m_file;
+#endif
+    };
+}
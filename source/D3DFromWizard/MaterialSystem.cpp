@@ -0,0 +1,257 @@
+//
+// MaterialSystem.cpp - Material parameters packed into one structured buffer, with textures
+//                      grouped into shared texture arrays, so changing material binds nothing
+//
+
+#include "pch.h"
+#include "MaterialSystem.h"
+
+using namespace DX;
+
+namespace
+{
+    // D3D11_BIND_SHADER_RESOURCE and DXGI_FORMAT_R8G8B8A8_UNORM, which Linux builds lack.
+    const uint32_t c_bindShaderResource = 0x8;
+    const uint32_t c_formatR8G8B8A8Unorm = 28;
+
+    MaterialTexture MakeTexture(uint32_t table, uint32_t slice)
+    {
+        return (table << 16) | slice;
+    }
+
+    MaterialParameters MakeParameters(const float diffuse[3], const float specular[3], float specularExponent, float opacity)
+    {
+        MaterialParameters parameters = MaterialParameters::Default();
+        memcpy(parameters.diffuse, diffuse, sizeof(parameters.diffuse));
+        memcpy(parameters.specular, specular, sizeof(parameters.specular));
+        parameters.specularExponent = specularExponent;
+        parameters.opacity = opacity;
+        if (opacity < 1.0f)
+        {
+            parameters.flags |= MaterialFlags_Transparent;
+        }
+        return parameters;
+    }
+
+    MaterialTexture ResolveMap(const std::string& path, const MaterialTextureResolver& resolveTexture)
+    {
+        return path.empty() || !resolveTexture ? c_noMaterialTexture : resolveTexture(path);
+    }
+};
+
+MaterialParameters DX::MaterialParameters::Default()
+{
+    MaterialParameters parameters = {};
+    for (int i = 0; i < 3; ++i)
+    {
+        parameters.diffuse[i] = 1.0f;
+    }
+    parameters.opacity = 1.0f;
+    parameters.specularExponent = 1.0f;
+    parameters.diffuseMap = c_noMaterialTexture;
+    parameters.normalMap = c_noMaterialTexture;
+    parameters.specularMap = c_noMaterialTexture;
+    return parameters;
+}
+
+DX::MaterialSystem::MaterialSystem() :
+    m_parametersChanged(true),
+    m_parameterBuffer(0),
+    m_bound(false),
+    m_statistics{}
+{
+    m_parameters.push_back(MaterialParameters::Default());
+}
+
+MaterialTexture DX::MaterialSystem::AddTexture(const std::string& name, uint32_t width, uint32_t height, std::vector<uint8_t> image, uint32_t mipLevels)
+{
+    auto found = m_textures.find(name);
+    if (found != m_textures.end())
+    {
+        return found->second;
+    }
+
+    if (width == 0 || height == 0 || image.size() != size_t(width) * height * 4)
+    {
+        throw std::runtime_error("texture image size does not match its description: " + name);
+    }
+
+    // Only tables that have not been committed can take more slices.
+    uint32_t table = 0;
+    for (; table < m_tables.size(); ++table)
+    {
+        const TextureTable& candidate = m_tables[table];
+        if (!candidate.resource && candidate.width == width && candidate.height == height && candidate.mipLevels == mipLevels
+            && candidate.slices < c_materialTextureSlices)
+        {
+            break;
+        }
+    }
+
+    if (table == m_tables.size())
+    {
+        if (m_tables.size() == c_materialTextureTables)
+        {
+            throw std::runtime_error("every material texture table is in use: " + name);
+        }
+
+        TextureTable added = {};
+        added.width = width;
+        added.height = height;
+        added.mipLevels = mipLevels;
+        m_tables.push_back(std::move(added));
+    }
+
+    TextureTable& target = m_tables[table];
+    if (target.pendingImage.empty())
+    {
+        target.pendingImage = std::move(image);
+    }
+    else
+    {
+        target.pendingImage.insert(target.pendingImage.end(), image.begin(), image.end());
+    }
+
+    MaterialTexture texture = MakeTexture(table, target.slices++);
+    m_textures.emplace(name, texture);
+    return texture;
+}
+
+MaterialTexture DX::MaterialSystem::FindTexture(const std::string& name) const
+{
+    auto found = m_textures.find(name);
+    return found != m_textures.end() ? found->second : c_noMaterialTexture;
+}
+
+MaterialId DX::MaterialSystem::AddMaterial(const std::string& name, const MaterialParameters& parameters)
+{
+    if (m_parameters.size() >= c_maxMaterials)
+    {
+        throw std::runtime_error("too many materials: " + name);
+    }
+
+    MaterialId material = static_cast<MaterialId>(m_parameters.size());
+    m_parameters.push_back(parameters);
+    m_materialIds.emplace(name, material);
+    m_parametersChanged = true;
+    return material;
+}
+
+bool DX::MaterialSystem::FindMaterial(const std::string& name, MaterialId& material) const
+{
+    auto found = m_materialIds.find(name);
+    if (found == m_materialIds.end())
+    {
+        return false;
+    }
+
+    material = found->second;
+    return true;
+}
+
+const MaterialParameters& DX::MaterialSystem::GetParameters(MaterialId material) const
+{
+    assert(material < m_parameters.size());
+    return m_parameters[material];
+}
+
+void DX::MaterialSystem::SetParameters(MaterialId material, const MaterialParameters& parameters)
+{
+    assert(material < m_parameters.size());
+    m_parameters[material] = parameters;
+    m_parametersChanged = true;
+}
+
+ResourceUploadStatistics DX::MaterialSystem::Commit(ResourceRegistry& registry, IResourceDevice& device, WorkerPool* pool)
+{
+    char name[64];
+    for (uint32_t table = 0; table < m_tables.size(); ++table)
+    {
+        TextureTable& pending = m_tables[table];
+        if (pending.resource)
+        {
+            continue;
+        }
+
+        // The registry generates each slice's mips as it uploads, and again after device lost.
+        sprintf_s(name, "material texture table %u (%ux%u)", table, pending.width, pending.height);
+        pending.resource = registry.Add(name,
+            ResourceDesc::Texture2DArray(c_bindShaderResource, pending.width, pending.height, pending.slices, pending.mipLevels, c_formatR8G8B8A8Unorm, 4),
+            ResourceEncoding_GenerateMips, std::move(pending.pendingImage));
+        pending.pendingImage = std::vector<uint8_t>();
+
+        // Its slot was bound empty.
+        m_bound = false;
+    }
+
+    // The buffer is immutable, so an edit replaces it whole. It is a few bytes per material,
+    // and parameters change far less often than they are drawn with.
+    if (m_parametersChanged)
+    {
+        if (m_parameterBuffer)
+        {
+            registry.Remove(m_parameterBuffer, &device);
+        }
+
+        std::vector<uint8_t> image(m_parameters.size() * sizeof(MaterialParameters));
+        memcpy(image.data(), m_parameters.data(), image.size());
+        m_parameterBuffer = registry.Add("material parameters",
+            ResourceDesc::StructuredBuffer(c_bindShaderResource, sizeof(MaterialParameters), static_cast<uint32_t>(m_parameters.size())),
+            ResourceEncoding_Raw, std::move(image));
+        m_parametersChanged = false;
+
+        // The view the sink bound belongs to the old buffer.
+        m_bound = false;
+    }
+
+    return registry.Upload(device, pool);
+}
+
+ResourceHandle DX::MaterialSystem::GetTextureTable(uint32_t table) const
+{
+    return table < m_tables.size() ? m_tables[table].resource : 0;
+}
+
+bool DX::MaterialSystem::Select(MaterialId material)
+{
+    assert(material < m_parameters.size());
+    (void)material;
+
+    m_statistics.switches++;
+    if (m_bound)
+    {
+        return false;
+    }
+
+    m_bound = true;
+    m_statistics.binds++;
+    return true;
+}
+
+std::vector<MaterialId> DX::AddMaterials(MaterialSystem& materials, const std::vector<ObjMaterial>& source, const MaterialTextureResolver& resolveTexture)
+{
+    std::vector<MaterialId> ids;
+    ids.reserve(source.size());
+    for (const ObjMaterial& material : source)
+    {
+        MaterialParameters parameters = MakeParameters(material.diffuse, material.specular, material.specularExponent, material.opacity);
+        memcpy(parameters.ambient, material.ambient, sizeof(parameters.ambient));
+        parameters.diffuseMap = ResolveMap(material.diffuseMap, resolveTexture);
+        parameters.normalMap = ResolveMap(material.normalMap, resolveTexture);
+        ids.push_back(materials.AddMaterial(material.name, parameters));
+    }
+    return ids;
+}
+
+std::vector<MaterialId> DX::AddMaterials(MaterialSystem& materials, const std::vector<FbxMaterial>& source, const MaterialTextureResolver& resolveTexture)
+{
+    std::vector<MaterialId> ids;
+    ids.reserve(source.size());
+    for (const FbxMaterial& material : source)
+    {
+        MaterialParameters parameters = MakeParameters(material.diffuse, material.specular, material.specularExponent, material.opacity);
+        parameters.diffuseMap = ResolveMap(material.diffuseMap, resolveTexture);
+        ids.push_back(materials.AddMaterial(material.name, parameters));
+    }
+    return ids;
+}
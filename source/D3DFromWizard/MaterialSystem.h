@@ -0,0 +1,157 @@
+//
+// MaterialSystem.h - Material parameters packed into one structured buffer, with textures
+//                    grouped into shared texture arrays, so changing material binds nothing
+//
+
+#pragma once
+
+#include "FbxReader.h"
+#include "ObjParser.h"
+#include "ResourceRegistry.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // Index into the parameter buffer, and what DrawPacket::material holds for a material
+    // system sink. Material 0 always exists: opaque white and untextured.
+    typedef uint32_t MaterialId;
+
+    // A texture as a slice of a texture table: the table in the high 16 bits, the slice in the low.
+    typedef uint32_t MaterialTexture;
+    const MaterialTexture c_noMaterialTexture = 0xFFFFFFFF;
+
+    // Texture tables are 8 bit RGBA arrays, each holding textures of one size and bound to a
+    // shader resource slot of its own. shaders/Materials.hlsli must agree.
+    const uint32_t c_materialTextureTables = 8;
+    const uint32_t c_materialTextureSlices = 2048;     // D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+
+    // Ids travel in the 16 bit DrawPacket::material.
+    const uint32_t c_maxMaterials = 0x10000;
+
+    enum MaterialFlags : uint32_t
+    {
+        MaterialFlags_None = 0,
+        MaterialFlags_Transparent = 1,      // Opacity below one; draw in a blended layer.
+        MaterialFlags_TwoSided = 2,
+    };
+
+    // One element of the parameter buffer; MaterialParameters in shaders/Materials.hlsli.
+    // Structured buffer elements are packed without the 16 byte registers of a cbuffer.
+    struct MaterialParameters
+    {
+        float           diffuse[3];
+        float           opacity;
+        float           specular[3];
+        float           specularExponent;
+        float           ambient[3];
+        float           alphaCutoff;        // Texels with less alpha are discarded; zero for none.
+        MaterialTexture diffuseMap;
+        MaterialTexture normalMap;
+        MaterialTexture specularMap;
+        uint32_t        flags;              // MaterialFlags.
+
+        // Opaque white, untextured.
+        static MaterialParameters Default();
+    };
+
+    static_assert(sizeof(MaterialParameters) == 64, "MaterialParameters must match its HLSL struct");
+
+    // Per-frame counters, reset by BeginFrame. Without a material system every switch is a bind;
+    // with one, binds are only needed when the sink's state was lost.
+    struct MaterialFrameStatistics
+    {
+        uint32_t    switches;               // Draws whose material differs from the draw before.
+        uint32_t    binds;                  // Times the parameter buffer and tables were bound.
+    };
+
+    // Owns every material's parameters and the textures they sample. Materials and textures are
+    // added while loading, then Commit hands them to the resource registry, which uploads them
+    // and restores them after device lost like any other resource. The sink binds the parameter
+    // buffer and every table together and leaves them bound; a draw selects its material with
+    // its id alone.
+    class MaterialSystem
+    {
+    public:
+        MaterialSystem();
+
+        MaterialSystem(const MaterialSystem&) = delete;
+        MaterialSystem& operator=(const MaterialSystem&) = delete;
+
+        // Adds an 8 bit RGBA image as a slice of the table for its size and mip count; a name
+        // that was added before returns the same texture. Atlas pages pass their settings'
+        // mipCount, so no mip past the gutters is sampled; zero is the full chain. Throws
+        // std::runtime_error when every table is in use.
+        MaterialTexture AddTexture(const std::string& name, uint32_t width, uint32_t height, std::vector<uint8_t> image, uint32_t mipLevels = 0);
+        MaterialTexture FindTexture(const std::string& name) const;
+
+        // Names need not be unique; FindMaterial returns the first material with the name.
+        // Throws std::runtime_error past c_maxMaterials.
+        MaterialId AddMaterial(const std::string& name, const MaterialParameters& parameters);
+        bool FindMaterial(const std::string& name, MaterialId& material) const;
+
+        const MaterialParameters& GetParameters(MaterialId material) const;
+        void SetParameters(MaterialId material, const MaterialParameters& parameters);
+        uint32_t GetMaterialCount() const               { return static_cast<uint32_t>(m_parameters.size()); }
+
+        // Registers the textures added since the last commit as new tables and, if any parameters
+        // changed, a new parameter buffer, then uploads them. Tables are immutable once
+        // committed, so textures added later start tables of their own: add everything a level
+        // needs before committing it.
+        ResourceUploadStatistics Commit(ResourceRegistry& registry, IResourceDevice& device, WorkerPool* pool);
+
+        // Zero until committed, and for unused tables.
+        ResourceHandle GetParameterBuffer() const       { return m_parameterBuffer; }
+        ResourceHandle GetTextureTable(uint32_t table) const;
+        uint32_t GetTextureTableCount() const           { return static_cast<uint32_t>(m_tables.size()); }
+
+        // Starts a frame's counters.
+        void BeginFrame()                               { m_statistics = MaterialFrameStatistics{}; }
+
+        // Called by a sink for each material change. Returns true when the parameter buffer and
+        // tables need binding: on the first call, and the first after InvalidateBindings or a
+        // commit that added a table or replaced the parameter buffer.
+        bool Select(MaterialId material);
+
+        // The sink's bindings are gone: it is new, or something else changed the pixel stage's
+        // resources. Call it wherever the render queue's InvalidateState is called.
+        void InvalidateBindings()                       { m_bound = false; }
+
+        const MaterialFrameStatistics& GetFrameStatistics() const  { return m_statistics; }
+
+    private:
+        struct TextureTable
+        {
+            uint32_t                width;
+            uint32_t                height;
+            uint32_t                mipLevels;
+            std::vector<uint8_t>    pendingImage;   // Top mips of every slice, until committed.
+            uint32_t                slices;
+            ResourceHandle          resource;       // Zero until committed.
+        };
+
+        std::vector<MaterialParameters>                 m_parameters;
+        std::unordered_map<std::string, MaterialId>     m_materialIds;
+        bool                                            m_parametersChanged;
+        ResourceHandle                                  m_parameterBuffer;
+
+        std::vector<TextureTable>                       m_tables;
+        std::unordered_map<std::string, MaterialTexture> m_textures;
+
+        bool                                            m_bound;
+        MaterialFrameStatistics                         m_statistics;
+    };
+
+    // Resolves a texture map path from a material file, as it is written there, to a texture;
+    // typically by decoding the file and passing it to AddTexture. c_noMaterialTexture leaves
+    // the map out.
+    typedef std::function<MaterialTexture(const std::string& path)> MaterialTextureResolver;
+
+    // Adds a loaded model's materials, returning each one's id in the model's order. Subsets
+    // draw with ids[subset.material], or material 0 when the subset has none.
+    std::vector<MaterialId> AddMaterials(MaterialSystem& materials, const std::vector<ObjMaterial>& source, const MaterialTextureResolver& resolveTexture);
+    std::vector<MaterialId> AddMaterials(MaterialSystem& materials, const std::vector<FbxMaterial>& source, const MaterialTextureResolver& resolveTexture);
+}
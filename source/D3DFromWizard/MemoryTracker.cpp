@@ -0,0 +1,305 @@
+//
+// MemoryTracker.cpp - Live and peak memory per category, budgets and leak-finding snapshots
+//
+
+#include "pch.h"
+#include "MemoryTracker.h"
+#include "Platform.h"
+
+#include <map>
+
+namespace
+{
+    const char* c_categoryNames[DX::MemoryCategory_Count] =
+    {
+        "general",
+        "entities",
+        "meshes",
+        "shaders",
+        "render queue",
+        "resource images",
+        "render targets",
+        "device buffers",
+        "device textures",
+    };
+
+    inline double ToMegabytes(double bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+};
+
+const char* DX::GetMemoryCategoryName(MemoryCategory category)
+{
+    return category < MemoryCategory_Count ? c_categoryNames[category] : "unknown";
+}
+
+DX::MemoryTracker::MemoryTracker() :
+    m_nextId(1)
+{
+    for (Category& category : m_categories)
+    {
+        category.liveBytes = 0;
+        category.peakBytes = 0;
+        category.liveAllocations = 0;
+        category.totalAllocations = 0;
+        category.budgetBytes = 0;
+        category.budgetWarnings = 0;
+    }
+}
+
+void DX::MemoryTracker::Allocate(MemoryCategory category, uint64_t bytes)
+{
+    Category& counters = m_categories[category];
+
+    uint64_t live = counters.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+
+    // Warn on the allocation that crosses the budget, not on every one above it.
+    uint64_t budget = counters.budgetBytes.load(std::memory_order_relaxed);
+    if (budget > 0 && live > budget && live - bytes <= budget)
+    {
+        counters.budgetWarnings.fetch_add(1, std::memory_order_relaxed);
+
+        char buffer[128];
+        sprintf_s(buffer, "Memory budget exceeded: %s %.1f MB of %.1f MB\n",
+            c_categoryNames[category], ToMegabytes(static_cast<double>(live)), ToMegabytes(static_cast<double>(budget)));
+        OutputDebugMessage(buffer);
+    }
+}
+
+void DX::MemoryTracker::Free(MemoryCategory category, uint64_t bytes)
+{
+    Category& counters = m_categories[category];
+
+    uint64_t live = counters.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    assert(live >= bytes);
+    (void)live;
+    counters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+uint64_t DX::MemoryTracker::RegisterResource(MemoryCategory category, uint64_t bytes, const char* name)
+{
+    Allocate(category, bytes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t id = m_nextId++;
+    m_resources[id] = MemoryResourceRecord{ id, category, bytes, name };
+    return id;
+}
+
+void DX::MemoryTracker::UnregisterResource(uint64_t id)
+{
+    MemoryResourceRecord record;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_resources.find(id);
+        if (found == m_resources.end())
+        {
+            assert(false);
+            return;
+        }
+        record = std::move(found->second);
+        m_resources.erase(found);
+    }
+
+    Free(record.category, record.bytes);
+}
+
+void DX::MemoryTracker::SetBudget(MemoryCategory category, uint64_t bytes)
+{
+    m_categories[category].budgetBytes.store(bytes, std::memory_order_relaxed);
+}
+
+DX::MemoryCategoryStatistics DX::MemoryTracker::GetStatistics(MemoryCategory category) const
+{
+    const Category& counters = m_categories[category];
+
+    MemoryCategoryStatistics statistics;
+    statistics.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+    statistics.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    statistics.liveAllocations = counters.liveAllocations.load(std::memory_order_relaxed);
+    statistics.totalAllocations = counters.totalAllocations.load(std::memory_order_relaxed);
+    statistics.budgetBytes = counters.budgetBytes.load(std::memory_order_relaxed);
+    statistics.budgetWarnings = counters.budgetWarnings.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+DX::MemorySnapshot DX::MemoryTracker::TakeSnapshot() const
+{
+    MemorySnapshot snapshot;
+    for (int i = 0; i < MemoryCategory_Count; ++i)
+    {
+        snapshot.categories[i] = GetStatistics(static_cast<MemoryCategory>(i));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        snapshot.resources.reserve(m_resources.size());
+        for (auto& resource : m_resources)
+        {
+            snapshot.resources.push_back(resource.second);
+        }
+    }
+
+    std::sort(snapshot.resources.begin(), snapshot.resources.end(),
+        [](const MemoryResourceRecord& a, const MemoryResourceRecord& b) { return a.id < b.id; });
+    return snapshot;
+}
+
+DX::MemoryTracker& DX::GetMemoryTracker()
+{
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+bool DX::MemorySnapshotDiff::IsEmpty() const
+{
+    for (int i = 0; i < MemoryCategory_Count; ++i)
+    {
+        if (liveBytes[i] != 0 || liveAllocations[i] != 0)
+            return false;
+    }
+    return resources.empty();
+}
+
+// Resources are matched by category and name rather than id: a device restore recreates
+// them all, and what matters is whether the same set came back.
+DX::MemorySnapshotDiff DX::DiffMemorySnapshots(const MemorySnapshot& before, const MemorySnapshot& after)
+{
+    MemorySnapshotDiff diff;
+    for (int i = 0; i < MemoryCategory_Count; ++i)
+    {
+        diff.liveBytes[i] = static_cast<int64_t>(after.categories[i].liveBytes - before.categories[i].liveBytes);
+        diff.liveAllocations[i] = static_cast<int64_t>(after.categories[i].liveAllocations - before.categories[i].liveAllocations);
+    }
+
+    std::map<std::pair<int, std::string>, MemoryResourceChange> changes;
+    auto accumulate = [&changes](const MemoryResourceRecord& resource, int64_t sign)
+    {
+        auto key = std::make_pair(static_cast<int>(resource.category), resource.name);
+        auto inserted = changes.insert(std::make_pair(key, MemoryResourceChange{ resource.category, resource.name, 0, 0 }));
+        inserted.first->second.count += sign;
+        inserted.first->second.bytes += sign * static_cast<int64_t>(resource.bytes);
+    };
+
+    for (const MemoryResourceRecord& resource : before.resources)
+    {
+        accumulate(resource, -1);
+    }
+    for (const MemoryResourceRecord& resource : after.resources)
+    {
+        accumulate(resource, 1);
+    }
+
+    for (auto& change : changes)
+    {
+        if (change.second.count != 0 || change.second.bytes != 0)
+        {
+            diff.resources.push_back(change.second);
+        }
+    }
+    return diff;
+}
+
+std::string DX::FormatMemorySnapshot(const MemorySnapshot& snapshot)
+{
+    std::string text;
+    char buffer[192];
+
+    for (int i = 0; i < MemoryCategory_Count; ++i)
+    {
+        const MemoryCategoryStatistics& category = snapshot.categories[i];
+        if (category.totalAllocations == 0)
+            continue;
+
+        sprintf_s(buffer, "%-16s live %8.2f MB (%llu allocations), peak %8.2f MB",
+            c_categoryNames[i], ToMegabytes(static_cast<double>(category.liveBytes)),
+            static_cast<unsigned long long>(category.liveAllocations), ToMegabytes(static_cast<double>(category.peakBytes)));
+        text += buffer;
+
+        if (category.budgetBytes > 0)
+        {
+            sprintf_s(buffer, ", budget %.2f MB, %llu warnings",
+                ToMegabytes(static_cast<double>(category.budgetBytes)), static_cast<unsigned long long>(category.budgetWarnings));
+            text += buffer;
+        }
+        text += "\n";
+    }
+
+    for (const MemoryResourceRecord& resource : snapshot.resources)
+    {
+        sprintf_s(buffer, "  %s: %s %.2f MB\n",
+            c_categoryNames[resource.category], resource.name.c_str(), ToMegabytes(static_cast<double>(resource.bytes)));
+        text += buffer;
+    }
+
+    return text;
+}
+
+std::string DX::FormatMemorySnapshotDiff(const MemorySnapshotDiff& diff)
+{
+    if (diff.IsEmpty())
+    {
+        return "No memory changes\n";
+    }
+
+    std::string text;
+    char buffer[192];
+
+    for (int i = 0; i < MemoryCategory_Count; ++i)
+    {
+        if (diff.liveBytes[i] == 0 && diff.liveAllocations[i] == 0)
+            continue;
+
+        sprintf_s(buffer, "%-16s %+10.2f MB, %+lld allocations\n",
+            c_categoryNames[i], ToMegabytes(static_cast<double>(diff.liveBytes[i])), static_cast<long long>(diff.liveAllocations[i]));
+        text += buffer;
+    }
+
+    for (const MemoryResourceChange& change : diff.resources)
+    {
+        sprintf_s(buffer, "  %s: %s %+lld (%+.2f MB)\n",
+            c_categoryNames[change.category], change.name.c_str(), static_cast<long long>(change.count),
+            ToMegabytes(static_cast<double>(change.bytes)));
+        text += buffer;
+    }
+
+    return text;
+}
+
+DX::TrackedMemory& DX::TrackedMemory::operator=(TrackedMemory&& other)
+{
+    if (this != &other)
+    {
+        Release();
+        m_id = other.m_id;
+        m_bytes = other.m_bytes;
+        other.m_id = 0;
+        other.m_bytes = 0;
+    }
+    return *this;
+}
+
+void DX::TrackedMemory::Track(MemoryCategory category, uint64_t bytes, const char* name)
+{
+    Release();
+    m_id = GetMemoryTracker().RegisterResource(category, bytes, name);
+    m_bytes = bytes;
+}
+
+void DX::TrackedMemory::Release()
+{
+    if (m_id != 0)
+    {
+        GetMemoryTracker().UnregisterResource(m_id);
+        m_id = 0;
+        m_bytes = 0;
+    }
+}
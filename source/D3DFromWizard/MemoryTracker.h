@@ -0,0 +1,185 @@
+//
+// MemoryTracker.h - Live and peak memory per category, budgets and leak-finding snapshots
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    enum MemoryCategory
+    {
+        MemoryCategory_General,
+        MemoryCategory_Entities,        // Entity chunks.
+        MemoryCategory_Meshes,          // CPU-side mesh data.
+        MemoryCategory_Shaders,         // Shader cache file and compiled bytecode.
+        MemoryCategory_RenderQueue,     // Draw packets and sort buffers.
+        MemoryCategory_ResourceImages,  // CPU copies of device resources kept for device lost.
+        MemoryCategory_RenderTargets,   // Swap chain buffers, depth buffers, render textures.
+        MemoryCategory_DeviceBuffers,   // Vertex, index and constant buffers.
+        MemoryCategory_DeviceTextures,  // Texture assets.
+        MemoryCategory_Count
+    };
+
+    const char* GetMemoryCategoryName(MemoryCategory category);
+
+    struct MemoryCategoryStatistics
+    {
+        uint64_t    liveBytes;
+        uint64_t    peakBytes;
+        uint64_t    liveAllocations;
+        uint64_t    totalAllocations;
+        uint64_t    budgetBytes;        // Zero for no budget.
+        uint64_t    budgetWarnings;     // Times liveBytes went over the budget.
+    };
+
+    // A resource registered by name, e.g. "swap chain"; see TrackedMemory.
+    struct MemoryResourceRecord
+    {
+        uint64_t        id;
+        MemoryCategory  category;
+        uint64_t        bytes;
+        std::string     name;
+    };
+
+    struct MemorySnapshot
+    {
+        MemoryCategoryStatistics            categories[MemoryCategory_Count];
+        std::vector<MemoryResourceRecord>   resources;      // Sorted by id.
+    };
+
+    // Net change between two snapshots for one resource name.
+    struct MemoryResourceChange
+    {
+        MemoryCategory  category;
+        std::string     name;
+        int64_t         count;
+        int64_t         bytes;
+    };
+
+    struct MemorySnapshotDiff
+    {
+        int64_t                             liveBytes[MemoryCategory_Count];
+        int64_t                             liveAllocations[MemoryCategory_Count];
+        std::vector<MemoryResourceChange>   resources;      // Only names whose count or size changed.
+
+        bool IsEmpty() const;
+    };
+
+    // Counts bytes by category. Anonymous allocations (heap blocks, arena pages) only move the
+    // counters and are lock-free; named resources are also kept in a table, so a snapshot can
+    // say which ones are still alive. Budgets are soft: going over one prints a warning once per
+    // crossing and counts it, nothing fails.
+    class MemoryTracker
+    {
+    public:
+        MemoryTracker();
+
+        MemoryTracker(const MemoryTracker&) = delete;
+        MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+        void Allocate(MemoryCategory category, uint64_t bytes);
+        void Free(MemoryCategory category, uint64_t bytes);
+
+        // Returns an id for UnregisterResource; never zero.
+        uint64_t RegisterResource(MemoryCategory category, uint64_t bytes, const char* name);
+        void UnregisterResource(uint64_t id);
+
+        void SetBudget(MemoryCategory category, uint64_t bytes);
+
+        MemoryCategoryStatistics GetStatistics(MemoryCategory category) const;
+        MemorySnapshot TakeSnapshot() const;
+
+    private:
+        struct Category
+        {
+            std::atomic<uint64_t>   liveBytes;
+            std::atomic<uint64_t>   peakBytes;
+            std::atomic<uint64_t>   liveAllocations;
+            std::atomic<uint64_t>   totalAllocations;
+            std::atomic<uint64_t>   budgetBytes;
+            std::atomic<uint64_t>   budgetWarnings;
+        };
+
+        Category                                            m_categories[MemoryCategory_Count];
+
+        mutable std::mutex                                  m_mutex;
+        std::unordered_map<uint64_t, MemoryResourceRecord>  m_resources;
+        uint64_t                                            m_nextId;
+    };
+
+    // The process-wide tracker everything reports to.
+    MemoryTracker& GetMemoryTracker();
+
+    // What changed from before to after, e.g. across a device lost and restore, where every
+    // named resource should have been recreated with the same size.
+    MemorySnapshotDiff DiffMemorySnapshots(const MemorySnapshot& before, const MemorySnapshot& after);
+
+    std::string FormatMemorySnapshot(const MemorySnapshot& snapshot);
+    std::string FormatMemorySnapshotDiff(const MemorySnapshotDiff& diff);
+
+    // Keeps one named resource registered for as long as it is held. Track again when the
+    // resource is recreated with a new size; Release (or destruction) when it goes away.
+    class TrackedMemory
+    {
+    public:
+        TrackedMemory() : m_id(0), m_bytes(0) {}
+        ~TrackedMemory()                                { Release(); }
+
+        TrackedMemory(TrackedMemory&& other) : m_id(other.m_id), m_bytes(other.m_bytes)    { other.m_id = 0; other.m_bytes = 0; }
+        TrackedMemory& operator=(TrackedMemory&& other);
+
+        TrackedMemory(const TrackedMemory&) = delete;
+        TrackedMemory& operator=(const TrackedMemory&) = delete;
+
+        void Track(MemoryCategory category, uint64_t bytes, const char* name);
+        void Release();
+
+        uint64_t GetBytes() const                       { return m_bytes; }
+
+    private:
+        uint64_t    m_id;
+        uint64_t    m_bytes;
+    };
+
+    // Standard library allocator that charges a container's heap blocks to a category, e.g.
+    // std::vector<MeshVertex, TrackingAllocator<MeshVertex, MemoryCategory_Meshes>>.
+    template<typename T, MemoryCategory Category>
+    struct TrackingAllocator
+    {
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind { typedef TrackingAllocator<U, Category> other; };
+
+        TrackingAllocator() = default;
+
+        template<typename U>
+        TrackingAllocator(const TrackingAllocator<U, Category>&) {}
+
+        T* allocate(size_t count)
+        {
+            T* memory = std::allocator<T>().allocate(count);
+            GetMemoryTracker().Allocate(Category, count * sizeof(T));
+            return memory;
+        }
+
+        void deallocate(T* memory, size_t count)
+        {
+            GetMemoryTracker().Free(Category, count * sizeof(T));
+            std::allocator<T>().deallocate(memory, count);
+        }
+
+        template<typename U>
+        bool operator==(const TrackingAllocator<U, Category>&) const    { return true; }
+        template<typename U>
+        bool operator!=(const TrackingAllocator<U, Category>&) const    { return false; }
+    };
+}
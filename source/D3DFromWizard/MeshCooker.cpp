@@ -0,0 +1,190 @@
+//
+// MeshCooker.cpp - Turns source meshes into render-ready data (level of detail chains)
+//
+
+#include "pch.h"
+#include "MeshCooker.h"
+
+#include <chrono>
+#include <float.h>
+
+namespace
+{
+    // Center of the bounding box and the radius that encloses every vertex around it.
+    void ComputeBoundingSphere(const std::vector<DX::MeshVertex>& vertices, float center[3], float& radius)
+    {
+        float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (const DX::MeshVertex& vertex : vertices)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+                maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+            }
+        }
+
+        radius = 0.0f;
+        if (vertices.empty())
+        {
+            center[0] = center[1] = center[2] = 0.0f;
+            return;
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        }
+
+        float radiusSquared = 0.0f;
+        for (const DX::MeshVertex& vertex : vertices)
+        {
+            float dx = vertex.position[0] - center[0];
+            float dy = vertex.position[1] - center[1];
+            float dz = vertex.position[2] - center[2];
+            radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+        }
+        radius = sqrtf(radiusSquared);
+    }
+};
+
+DX::MeshCooker::MeshCooker(const MeshCookSettings& settings) :
+    m_settings(settings)
+{
+}
+
+DX::CookedMesh DX::MeshCooker::Cook(const MeshData& mesh)
+{
+    CookedMesh cooked;
+    cooked.name = mesh.name;
+    cooked.vertices = mesh.vertices;
+    ComputeBoundingSphere(cooked.vertices, cooked.boundingCenter, cooked.boundingRadius);
+
+    MeshCookReport report;
+    report.name = mesh.name;
+    report.sourceTriangles = mesh.GetTriangleCount();
+    report.simplifySeconds = 0.0;
+    report.meshletSeconds = 0.0;
+
+    BuildLodChain(mesh, cooked, report);
+
+    if (m_settings.buildMeshlets)
+    {
+        BuildMeshletsForLods(cooked, report);
+    }
+
+    m_reports.push_back(report);
+    return cooked;
+}
+
+// Each level is simplified from the previous one, which is much cheaper than starting from the
+// source every time. The quadrics restart for every level, so errors are accumulated to stay
+// conservative.
+void DX::MeshCooker::BuildLodChain(const MeshData& mesh, CookedMesh& cooked, MeshCookReport& report)
+{
+    const float extent = ComputeMeshExtent(mesh);
+
+    std::vector<uint32_t> current = mesh.indices;
+    float accumulatedError = 0.0f;
+
+    auto append = [&](const std::vector<uint32_t>& lodIndices, float relativeError)
+    {
+        MeshLod lod;
+        lod.indexOffset = static_cast<uint32_t>(cooked.indices.size());
+        lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+        lod.meshletOffset = 0;
+        lod.meshletCount = 0;
+        lod.error = relativeError * extent;
+
+        cooked.indices.insert(cooked.indices.end(), lodIndices.begin(), lodIndices.end());
+        cooked.lods.push_back(lod);
+
+        report.lodTriangles.push_back(lodIndices.size() / 3);
+        report.lodErrors.push_back(lod.error);
+    };
+
+    append(current, 0.0f);
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (cooked.lods.size() < m_settings.maxLods)
+    {
+        size_t targetTriangles = static_cast<size_t>(current.size() / 3 * m_settings.reductionPerLod);
+        if (targetTriangles < m_settings.minTriangles)
+        {
+            break;
+        }
+
+        float error = 0.0f;
+        std::vector<uint32_t> next = SimplifyMesh(mesh, current, targetTriangles * 3, m_settings.maxError, m_settings.simplify, &error);
+
+        // Stop once the simplifier can no longer make meaningful progress within the error budget.
+        if (next.empty() || next.size() > current.size() * 9 / 10)
+        {
+            break;
+        }
+
+        accumulatedError += error;
+        append(next, accumulatedError);
+        current.swap(next);
+    }
+
+    report.simplifySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DX::MeshCooker::BuildMeshletsForLods(CookedMesh& cooked, MeshCookReport& report)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (MeshLod& lod : cooked.lods)
+    {
+        lod.meshletOffset = static_cast<uint32_t>(cooked.meshlets.meshlets.size());
+
+        BuildMeshlets(cooked.vertices, cooked.indices.data() + lod.indexOffset, lod.indexCount, cooked.meshlets,
+            m_settings.meshletMaxVertices, m_settings.meshletMaxTriangles);
+
+        lod.meshletCount = static_cast<uint32_t>(cooked.meshlets.meshlets.size()) - lod.meshletOffset;
+        report.lodMeshlets.push_back(lod.meshletCount);
+    }
+
+    report.meshletSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DX::MeshCooker::PrintReports(FILE* file) const
+{
+    for (const MeshCookReport& report : m_reports)
+    {
+        double trianglesPerSecond = report.simplifySeconds > 0.0 ? report.sourceTriangles / report.simplifySeconds : 0.0;
+
+        fprintf(file, "%s: %zu triangles, %zu levels, simplified in %.2f ms (%.2f Mtri/s)\n",
+            report.name.c_str(),
+            report.sourceTriangles,
+            report.lodTriangles.size(),
+            report.simplifySeconds * 1000.0,
+            trianglesPerSecond / 1e6);
+
+        for (size_t i = 0; i < report.lodTriangles.size(); ++i)
+        {
+            double reduction = report.sourceTriangles ? 100.0 * (1.0 - double(report.lodTriangles[i]) / report.sourceTriangles) : 0.0;
+
+            fprintf(file, "  LOD%zu: %zu triangles (-%.1f%%), error %g",
+                i,
+                report.lodTriangles[i],
+                reduction,
+                report.lodErrors[i]);
+
+            if (i < report.lodMeshlets.size())
+            {
+                fprintf(file, ", %zu meshlets", report.lodMeshlets[i]);
+            }
+
+            fprintf(file, "\n");
+        }
+
+        if (!report.lodMeshlets.empty())
+        {
+            fprintf(file, "  meshlets built in %.2f ms\n", report.meshletSeconds * 1000.0);
+        }
+    }
+}
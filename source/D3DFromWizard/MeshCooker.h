@@ -0,0 +1,125 @@
+//
+// MeshCooker.h - Turns source meshes into render-ready data (level of detail chains)
+//
+
+#pragma once
+
+#include "MeshData.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace DX
+{
+    // One level of detail. All levels share the cooked vertex buffer and live back to back
+    // in one index buffer, so switching level only changes the draw's index range.
+    struct MeshLod
+    {
+        uint32_t    indexOffset;
+        uint32_t    indexCount;
+        uint32_t    meshletOffset;  // Range of this level in CookedMesh::meshlets.
+        uint32_t    meshletCount;
+        float       error;          // World-space geometric error of this level.
+    };
+
+    struct CookedMesh
+    {
+        std::string             name;
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t>   indices;
+        std::vector<MeshLod>    lods;
+        MeshletData             meshlets;
+        float                   boundingCenter[3];
+        float                   boundingRadius;
+
+        // Heap bytes held by the arrays, for memory tracking.
+        size_t GetMemoryBytes() const
+        {
+            return vertices.capacity() * sizeof(MeshVertex) + indices.capacity() * sizeof(uint32_t)
+                + lods.capacity() * sizeof(MeshLod)
+                + meshlets.meshlets.capacity() * sizeof(Meshlet) + meshlets.bounds.capacity() * sizeof(MeshletBounds)
+                + meshlets.vertices.capacity() * sizeof(uint32_t) + meshlets.triangles.capacity();
+        }
+    };
+
+    struct MeshCookSettings
+    {
+        MeshCookSettings() :
+            maxLods(8),
+            reductionPerLod(0.5f),
+            minTriangles(64),
+            maxError(0.05f),
+            buildMeshlets(true),
+            meshletMaxVertices(c_meshletMaxVertices),
+            meshletMaxTriangles(c_meshletMaxTriangles)
+        {
+        }
+
+        uint32_t            maxLods;
+        float               reductionPerLod;    // Triangle count of each level relative to the previous one.
+        uint32_t            minTriangles;       // Stop once a level would drop below this.
+        float               maxError;           // Largest relative error any level may introduce.
+        SimplifySettings    simplify;
+
+        // Split every level into clusters for cluster culling.
+        bool                buildMeshlets;
+        uint32_t            meshletMaxVertices;
+        uint32_t            meshletMaxTriangles;
+    };
+
+    // What the cooker did to one asset.
+    struct MeshCookReport
+    {
+        std::string             name;
+        size_t                  sourceTriangles;
+        std::vector<size_t>     lodTriangles;
+        std::vector<float>      lodErrors;
+        std::vector<size_t>     lodMeshlets;
+        double                  simplifySeconds;
+        double                  meshletSeconds;
+    };
+
+    class MeshCooker
+    {
+    public:
+        MeshCooker(const MeshCookSettings& settings = MeshCookSettings());
+
+        CookedMesh Cook(const MeshData& mesh);
+
+        const std::vector<MeshCookReport>& GetReports() const   { return m_reports; }
+        void PrintReports(FILE* file) const;
+
+    private:
+        void BuildLodChain(const MeshData& mesh, CookedMesh& cooked, MeshCookReport& report);
+        void BuildMeshletsForLods(CookedMesh& cooked, MeshCookReport& report);
+
+        MeshCookSettings            m_settings;
+        std::vector<MeshCookReport> m_reports;
+    };
+
+    // Pixels per world unit at distance 1 for a perspective projection.
+    inline float ComputeLodProjectionScale(float fovAngleY, float viewportHeight)
+    {
+        return viewportHeight / (2.0f * tanf(fovAngleY * 0.5f));
+    }
+
+    // Picks the coarsest level whose error projects to no more than thresholdPixels on screen.
+    inline size_t SelectLod(const CookedMesh& mesh, float distance, float projectionScale, float thresholdPixels = 1.0f)
+    {
+        // The bounding sphere surface is the closest the error can get to the camera.
+        float nearest = std::max(distance - mesh.boundingRadius, 1e-4f);
+
+        size_t selected = 0;
+        for (size_t i = 1; i < mesh.lods.size(); ++i)
+        {
+            if (mesh.lods[i].error * projectionScale / nearest > thresholdPixels)
+            {
+                break;
+            }
+            selected = i;
+        }
+        return selected;
+    }
+}
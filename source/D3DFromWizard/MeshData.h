@@ -0,0 +1,62 @@
+//
+// MeshData.h - CPU-side mesh representation shared by the mesh cooker and loaders
+//
+
+#pragma once
+
+#include "VertexLayout.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Matches the POSITION/NORMAL/TEXCOORD layout used by the example shaders.
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float texcoord[2];
+    };
+
+    constexpr auto c_meshVertexLayout = MakeVertexLayout<MeshVertex>(
+        DX_VERTEX_ELEMENT(MeshVertex, position, "POSITION", 0),
+        DX_VERTEX_ELEMENT(MeshVertex, normal, "NORMAL", 0),
+        DX_VERTEX_ELEMENT(MeshVertex, texcoord, "TEXCOORD", 0));
+    DX_CHECK_VERTEX_LAYOUT(c_meshVertexLayout);
+
+    // MeshVertex in 24 bytes instead of 32, for vertex buffers that are only drawn. The normal's
+    // w is zero, and texture coordinates keep about three decimal digits.
+    struct QuantizedMeshVertex
+    {
+        float       position[3];
+        SNorm16x4   normal;
+        Half2       texcoord;
+    };
+
+    constexpr auto c_quantizedMeshVertexLayout = MakeVertexLayout<QuantizedMeshVertex>(
+        DX_VERTEX_ELEMENT(QuantizedMeshVertex, position, "POSITION", 0),
+        DX_VERTEX_ELEMENT(QuantizedMeshVertex, normal, "NORMAL", 0),
+        DX_VERTEX_ELEMENT(QuantizedMeshVertex, texcoord, "TEXCOORD", 0));
+    DX_CHECK_VERTEX_LAYOUT(c_quantizedMeshVertexLayout);
+
+    inline QuantizedMeshVertex QuantizeMeshVertex(const MeshVertex& vertex)
+    {
+        QuantizedMeshVertex quantized;
+        EncodeVertexAttribute(vertex.position, 3, quantized.position);
+        EncodeVertexAttribute(vertex.normal, 3, quantized.normal);
+        EncodeVertexAttribute(vertex.texcoord, 2, quantized.texcoord);
+        return quantized;
+    }
+
+    // An indexed triangle list.
+    struct MeshData
+    {
+        std::string             name;
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t>   indices;
+
+        size_t GetTriangleCount() const         { return indices.size() / 3; }
+    };
+}
@@ -0,0 +1,257 @@
+//
+// MeshLoader.cpp - Reads source meshes (Wavefront OBJ, 3D Studio, binary FBX) into MeshData
+//
+
+#include "pch.h"
+#include "MeshLoader.h"
+#include "FbxReader.h"
+#include "ObjParser.h"
+
+#include <ctype.h>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    // 3DS chunk ids used here.
+    const uint16_t c_chunkMain = 0x4D4D;
+    const uint16_t c_chunkEditor = 0x3D3D;
+    const uint16_t c_chunkObject = 0x4000;
+    const uint16_t c_chunkTriangleMesh = 0x4100;
+    const uint16_t c_chunkVertices = 0x4110;
+    const uint16_t c_chunkFaces = 0x4120;
+    const uint16_t c_chunkTexcoords = 0x4140;
+
+    const size_t c_chunkHeaderSize = 6;
+
+    template<typename T>
+    T ReadValue(const std::vector<uint8_t>& data, size_t offset)
+    {
+        T value;
+        memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+
+    // Appends one triangle mesh chunk (vertices, faces and texture coordinates) to mesh.
+    void Read3dsTriangleMesh(const std::vector<uint8_t>& data, size_t begin, size_t end, DX::MeshData& mesh)
+    {
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<uint16_t> faces;
+
+        for (size_t offset = begin; offset + c_chunkHeaderSize <= end; )
+        {
+            uint16_t id = ReadValue<uint16_t>(data, offset);
+            uint32_t length = ReadValue<uint32_t>(data, offset + 2);
+            if (length < c_chunkHeaderSize || length > end - offset)
+            {
+                break;
+            }
+
+            size_t body = offset + c_chunkHeaderSize;
+            size_t bodyEnd = offset + length;
+
+            if (id == c_chunkVertices && body + 2 <= bodyEnd)
+            {
+                uint16_t count = ReadValue<uint16_t>(data, body);
+                if (body + 2 + count * 12u <= bodyEnd)
+                {
+                    positions.resize(count * 3u);
+                    memcpy(positions.data(), data.data() + body + 2, count * 12u);
+                }
+            }
+            else if (id == c_chunkTexcoords && body + 2 <= bodyEnd)
+            {
+                uint16_t count = ReadValue<uint16_t>(data, body);
+                if (body + 2 + count * 8u <= bodyEnd)
+                {
+                    texcoords.resize(count * 2u);
+                    memcpy(texcoords.data(), data.data() + body + 2, count * 8u);
+                }
+            }
+            else if (id == c_chunkFaces && body + 2 <= bodyEnd)
+            {
+                // Each face is three indices and a flags word; material and smoothing group
+                // sub-chunks follow and are not needed here.
+                uint16_t count = ReadValue<uint16_t>(data, body);
+                if (body + 2 + count * 8u <= bodyEnd)
+                {
+                    faces.resize(count * 4u);
+                    memcpy(faces.data(), data.data() + body + 2, count * 8u);
+                }
+            }
+
+            offset = bodyEnd;
+        }
+
+        size_t vertexCount = positions.size() / 3;
+        uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            DX::MeshVertex vertex = {};
+            vertex.position[0] = positions[i * 3 + 0];
+            vertex.position[1] = positions[i * 3 + 2];
+            vertex.position[2] = -positions[i * 3 + 1];
+
+            if (texcoords.size() == vertexCount * 2)
+            {
+                vertex.texcoord[0] = texcoords[i * 2 + 0];
+                vertex.texcoord[1] = 1.0f - texcoords[i * 2 + 1];
+            }
+
+            mesh.vertices.push_back(vertex);
+        }
+
+        for (size_t i = 0; i + 3 < faces.size(); i += 4)
+        {
+            if (faces[i] >= vertexCount || faces[i + 1] >= vertexCount || faces[i + 2] >= vertexCount)
+            {
+                continue;
+            }
+
+            mesh.indices.push_back(baseVertex + faces[i]);
+            mesh.indices.push_back(baseVertex + faces[i + 1]);
+            mesh.indices.push_back(baseVertex + faces[i + 2]);
+        }
+    }
+
+    // Walks the chunk tree, descending only into chunks that can contain meshes.
+    void Read3dsChunks(const std::vector<uint8_t>& data, size_t begin, size_t end, DX::MeshData& mesh)
+    {
+        for (size_t offset = begin; offset + c_chunkHeaderSize <= end; )
+        {
+            uint16_t id = ReadValue<uint16_t>(data, offset);
+            uint32_t length = ReadValue<uint32_t>(data, offset + 2);
+            if (length < c_chunkHeaderSize || length > end - offset)
+            {
+                break;
+            }
+
+            size_t body = offset + c_chunkHeaderSize;
+            size_t bodyEnd = offset + length;
+
+            if (id == c_chunkMain || id == c_chunkEditor)
+            {
+                Read3dsChunks(data, body, bodyEnd, mesh);
+            }
+            else if (id == c_chunkObject)
+            {
+                // The object name is a zero-terminated string ahead of the sub-chunks.
+                size_t name = body;
+                while (name < bodyEnd && data[name] != 0)
+                {
+                    ++name;
+                }
+                Read3dsChunks(data, name + 1, bodyEnd, mesh);
+            }
+            else if (id == c_chunkTriangleMesh)
+            {
+                Read3dsTriangleMesh(data, body, bodyEnd, mesh);
+            }
+
+            offset = bodyEnd;
+        }
+    }
+};
+
+DX::MeshData DX::LoadObj(const std::string& path)
+{
+    return LoadObjModel(path).mesh;
+}
+
+DX::MeshData DX::Load3ds(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + path);
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < c_chunkHeaderSize || ReadValue<uint16_t>(data, 0) != c_chunkMain)
+    {
+        throw std::runtime_error("Not a 3DS file: " + path);
+    }
+
+    MeshData mesh;
+    mesh.name = path;
+    Read3dsChunks(data, 0, data.size(), mesh);
+
+    ComputeVertexNormals(mesh);
+    return mesh;
+}
+
+DX::MeshData DX::LoadFbx(const std::string& path)
+{
+    return LoadFbxModel(path).mesh;
+}
+
+DX::MeshData DX::LoadMesh(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    for (char& c : extension)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    if (extension == "obj")
+    {
+        return LoadObj(path);
+    }
+    if (extension == "3ds")
+    {
+        return Load3ds(path);
+    }
+    if (extension == "fbx")
+    {
+        return LoadFbx(path);
+    }
+
+    throw std::runtime_error("Unsupported mesh format: " + path);
+}
+
+void DX::ComputeVertexNormals(MeshData& mesh)
+{
+    for (MeshVertex& vertex : mesh.vertices)
+    {
+        vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+    }
+
+    // The unnormalized cross product weights each face by its area.
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        MeshVertex& a = mesh.vertices[mesh.indices[i]];
+        MeshVertex& b = mesh.vertices[mesh.indices[i + 1]];
+        MeshVertex& c = mesh.vertices[mesh.indices[i + 2]];
+
+        float e1[3] = { b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2] };
+        float e2[3] = { c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2] };
+        float n[3] =
+        {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+        };
+
+        for (int k = 0; k < 3; ++k)
+        {
+            a.normal[k] += n[k];
+            b.normal[k] += n[k];
+            c.normal[k] += n[k];
+        }
+    }
+
+    for (MeshVertex& vertex : mesh.vertices)
+    {
+        float length = sqrtf(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+        if (length > 0.0f)
+        {
+            vertex.normal[0] /= length;
+            vertex.normal[1] /= length;
+            vertex.normal[2] /= length;
+        }
+    }
+}
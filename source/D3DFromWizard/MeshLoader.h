@@ -0,0 +1,31 @@
+//
+// MeshLoader.h - Reads source meshes (Wavefront OBJ, 3D Studio, binary FBX) into MeshData
+//
+
+#pragma once
+
+#include "MeshData.h"
+
+namespace DX
+{
+    // Polygons are fanned into triangles and vertices are shared wherever position, normal
+    // and texture coordinate all match. Throws std::runtime_error if the file cannot be read.
+    // Parses on the calling thread; LoadObjModel in ObjParser.h takes a pool and also
+    // returns the materials.
+    MeshData LoadObj(const std::string& path);
+
+    // Every object in the file is merged into one mesh. 3DS stores no normals, so smooth
+    // normals are generated; positions are converted from Z-up to the Y-up used elsewhere.
+    MeshData Load3ds(const std::string& path);
+
+    // Every mesh in the file is merged into one, with its model transforms applied and the
+    // file's axes converted to Y-up. LoadFbxModel in FbxReader.h takes a pool and also
+    // returns the materials.
+    MeshData LoadFbx(const std::string& path);
+
+    // Picks the loader from the file extension.
+    MeshData LoadMesh(const std::string& path);
+
+    // Area-weighted vertex normals, overwriting whatever the vertices held.
+    void ComputeVertexNormals(MeshData& mesh);
+}
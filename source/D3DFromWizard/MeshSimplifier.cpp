@@ -0,0 +1,766 @@
+//
+// MeshSimplifier.cpp - Quadric error metric mesh simplification with attribute preservation
+//
+// Vertices are collapsed onto one of their neighbours (so no new vertices are ever created and
+// every level of detail can share the source vertex buffer). Each collapse is scored with a
+// geometric quadric (Garland & Heckbert) accumulated per position, plus attribute quadrics
+// (Hoppe) accumulated per vertex that measure how far normals and texture coordinates drift.
+// Vertices on open borders and attribute seams may only slide along that border or seam.
+//
+
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+    // Normal xyz and texcoord uv.
+    const int c_attributeCount = 5;
+
+    struct Vector3
+    {
+        float x, y, z;
+    };
+
+    inline Vector3 Subtract(const Vector3& a, const Vector3& b)    { return Vector3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline float Dot(const Vector3& a, const Vector3& b)            { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vector3 Cross(const Vector3& a, const Vector3& b)
+    {
+        return Vector3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    inline float Normalize(Vector3& v)
+    {
+        float length = sqrtf(Dot(v, v));
+        if (length > 0.0f)
+        {
+            v.x /= length;
+            v.y /= length;
+            v.z /= length;
+        }
+        return length;
+    }
+
+    // Symmetric 3x3 matrix A, vector b and scalar c of the quadric p'Ap + 2b'p + c, plus the
+    // total weight so errors can be normalized back to squared distances.
+    struct Quadric
+    {
+        float a00, a11, a22, a01, a02, a12;
+        float b0, b1, b2;
+        float c;
+        float w;
+    };
+
+    struct AttributeQuadric
+    {
+        Quadric q;
+        float   g[c_attributeCount][4];
+    };
+
+    inline void Add(Quadric& q, const Quadric& r)
+    {
+        q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+        q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+        q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+        q.c += r.c;
+        q.w += r.w;
+    }
+
+    inline void Add(AttributeQuadric& q, const AttributeQuadric& r)
+    {
+        Add(q.q, r.q);
+        for (int k = 0; k < c_attributeCount; ++k)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                q.g[k][j] += r.g[k][j];
+            }
+        }
+    }
+
+    // Accumulates w * (n.p + d)^2.
+    inline void AddPlane(Quadric& q, const Vector3& n, float d, float w)
+    {
+        q.a00 += w * n.x * n.x; q.a11 += w * n.y * n.y; q.a22 += w * n.z * n.z;
+        q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z; q.a12 += w * n.y * n.z;
+        q.b0 += w * n.x * d; q.b1 += w * n.y * d; q.b2 += w * n.z * d;
+        q.c += w * d * d;
+    }
+
+    inline float Evaluate(const Quadric& q, const Vector3& p)
+    {
+        float rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z + 2.0f * q.b0;
+        float ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z + 2.0f * q.b1;
+        float rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z + 2.0f * q.b2;
+        return rx * p.x + ry * p.y + rz * p.z + q.c;
+    }
+
+    inline float Error(const Quadric& q, const Vector3& p)
+    {
+        return q.w > 0.0f ? fabsf(Evaluate(q, p)) / q.w : 0.0f;
+    }
+
+    // Every attribute is modelled as a linear function g.p + d over each triangle; the error is
+    // the weighted squared difference between that function and the attribute kept at p.
+    inline float Error(const AttributeQuadric& q, const Vector3& p, const float* attributes)
+    {
+        float r = Evaluate(q.q, p);
+        for (int k = 0; k < c_attributeCount; ++k)
+        {
+            const float* g = q.g[k];
+            float a = attributes[k];
+            r += -2.0f * a * (g[0] * p.x + g[1] * p.y + g[2] * p.z + g[3]) + q.q.w * a * a;
+        }
+        return q.q.w > 0.0f ? fabsf(r) / q.q.w : 0.0f;
+    }
+
+    enum VertexKind
+    {
+        Kind_Manifold,  // Interior vertex, can collapse anywhere.
+        Kind_Border,    // On an open border, can only collapse along it.
+        Kind_Seam,      // Two vertices sharing a position along an attribute seam; collapse as a pair.
+        Kind_Locked,    // Anything more complex; never moves.
+        Kind_Count
+    };
+
+    // c_canCollapse[from][to]
+    const bool c_canCollapse[Kind_Count][Kind_Count] =
+    {
+        { true,  true,  true,  true  },
+        { false, true,  false, false },
+        { false, false, true,  false },
+        { false, false, false, false },
+    };
+
+    // Outgoing directed edges per vertex.
+    struct EdgeAdjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> targets;
+
+        void Build(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+        {
+            offsets.assign(vertexCount + 1, 0);
+            targets.resize(indexCount);
+
+            for (size_t i = 0; i < indexCount; ++i)
+            {
+                offsets[indices[i] + 1]++;
+            }
+
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                offsets[v + 1] += offsets[v];
+            }
+
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                for (int e = 0; e < 3; ++e)
+                {
+                    uint32_t a = indices[i + e];
+                    uint32_t b = indices[i + (e + 1) % 3];
+                    targets[fill[a]++] = b;
+                }
+            }
+        }
+
+        bool HasEdge(uint32_t a, uint32_t b) const
+        {
+            for (uint32_t i = offsets[a]; i < offsets[a + 1]; ++i)
+            {
+                if (targets[i] == b)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t    from;
+        uint32_t    to;
+        float       error;
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const DX::MeshData& mesh, const DX::SimplifySettings& settings) :
+            m_mesh(mesh),
+            m_settings(settings),
+            m_vertexCount(mesh.vertices.size())
+        {
+            BuildPositions();
+            BuildAttributes();
+            BuildPositionGroups();
+        }
+
+        std::vector<uint32_t> Run(const std::vector<uint32_t>& source, size_t targetIndexCount, float targetError, float* resultError);
+
+    private:
+        void BuildPositions();
+        void BuildAttributes();
+        void BuildPositionGroups();
+        void ClassifyVertices(const std::vector<uint32_t>& indices);
+        void BuildQuadrics(const std::vector<uint32_t>& indices);
+        void BuildTriangleFans(const uint32_t* indices, size_t indexCount);
+        float CollapseCost(uint32_t from, uint32_t to) const;
+        bool FlipsTriangles(uint32_t from, uint32_t to, const uint32_t* indices) const;
+
+        const DX::MeshData&             m_mesh;
+        DX::SimplifySettings            m_settings;
+        size_t                          m_vertexCount;
+
+        // Positions scaled into the unit cube so errors are relative to the mesh extent.
+        std::vector<Vector3>            m_positions;
+        std::vector<float>              m_attributes;
+
+        // m_remap[v] is the first vertex with v's position; m_wedge links all vertices at one position in a ring.
+        std::vector<uint32_t>           m_remap;
+        std::vector<uint32_t>           m_wedge;
+        std::vector<uint8_t>            m_kinds;
+
+        std::vector<Quadric>            m_vertexQuadrics;       // Indexed by m_remap[v].
+        std::vector<AttributeQuadric>   m_attributeQuadrics;    // Indexed by v.
+
+        EdgeAdjacency                   m_adjacency;
+        std::vector<uint32_t>           m_fanOffsets;
+        std::vector<uint32_t>           m_fanTriangles;
+    };
+
+    void Simplifier::BuildPositions()
+    {
+        float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (const DX::MeshVertex& vertex : m_mesh.vertices)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+                maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+            }
+        }
+
+        float extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+        float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+        m_positions.resize(m_vertexCount);
+        for (size_t v = 0; v < m_vertexCount; ++v)
+        {
+            const float* position = m_mesh.vertices[v].position;
+            m_positions[v] = Vector3{ (position[0] - minimum[0]) * scale, (position[1] - minimum[1]) * scale, (position[2] - minimum[2]) * scale };
+        }
+    }
+
+    void Simplifier::BuildAttributes()
+    {
+        m_attributes.resize(m_vertexCount * c_attributeCount);
+        for (size_t v = 0; v < m_vertexCount; ++v)
+        {
+            const DX::MeshVertex& vertex = m_mesh.vertices[v];
+            float* attributes = &m_attributes[v * c_attributeCount];
+
+            attributes[0] = vertex.normal[0] * m_settings.normalWeight;
+            attributes[1] = vertex.normal[1] * m_settings.normalWeight;
+            attributes[2] = vertex.normal[2] * m_settings.normalWeight;
+            attributes[3] = vertex.texcoord[0] * m_settings.texcoordWeight;
+            attributes[4] = vertex.texcoord[1] * m_settings.texcoordWeight;
+        }
+    }
+
+    // Finds vertices that share a position bit-for-bit; these are the wedges of an attribute seam.
+    void Simplifier::BuildPositionGroups()
+    {
+        std::vector<uint32_t> order(m_vertexCount);
+        for (size_t v = 0; v < m_vertexCount; ++v)
+        {
+            order[v] = static_cast<uint32_t>(v);
+        }
+
+        auto less = [&](uint32_t a, uint32_t b)
+        {
+            const float* pa = m_mesh.vertices[a].position;
+            const float* pb = m_mesh.vertices[b].position;
+            if (pa[0] != pb[0]) return pa[0] < pb[0];
+            if (pa[1] != pb[1]) return pa[1] < pb[1];
+            if (pa[2] != pb[2]) return pa[2] < pb[2];
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        m_remap.resize(m_vertexCount);
+        m_wedge.resize(m_vertexCount);
+
+        for (size_t begin = 0; begin < m_vertexCount; )
+        {
+            size_t end = begin + 1;
+            const float* first = m_mesh.vertices[order[begin]].position;
+            while (end < m_vertexCount)
+            {
+                const float* next = m_mesh.vertices[order[end]].position;
+                if (next[0] != first[0] || next[1] != first[1] || next[2] != first[2])
+                {
+                    break;
+                }
+                ++end;
+            }
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                m_remap[order[i]] = order[begin];
+                m_wedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+            }
+
+            begin = end;
+        }
+    }
+
+    void Simplifier::ClassifyVertices(const std::vector<uint32_t>& indices)
+    {
+        const uint32_t none = ~0u;
+
+        // For every vertex, the single open edge leaving/entering it, none, or the vertex
+        // itself as a marker for "more than one".
+        std::vector<uint32_t> openOut(m_vertexCount, none);
+        std::vector<uint32_t> openIn(m_vertexCount, none);
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t a = indices[i + e];
+                uint32_t b = indices[i + (e + 1) % 3];
+
+                if (!m_adjacency.HasEdge(b, a))
+                {
+                    openOut[a] = (openOut[a] == none) ? b : a;
+                    openIn[b] = (openIn[b] == none) ? a : b;
+                }
+            }
+        }
+
+        m_kinds.assign(m_vertexCount, Kind_Locked);
+        for (uint32_t v = 0; v < m_vertexCount; ++v)
+        {
+            uint32_t w = m_wedge[v];
+
+            if (w == v)
+            {
+                if (openOut[v] == none && openIn[v] == none)
+                {
+                    m_kinds[v] = Kind_Manifold;
+                }
+                else if (openOut[v] != none && openOut[v] != v && openIn[v] != none && openIn[v] != v)
+                {
+                    m_kinds[v] = Kind_Border;
+                }
+            }
+            else if (m_wedge[w] == v)
+            {
+                // Exactly two wedges. It is a seam if each has one open edge in and out and
+                // those edges meet the same positions from opposite sides.
+                bool simple = openOut[v] != none && openOut[v] != v && openIn[v] != none && openIn[v] != v
+                    && openOut[w] != none && openOut[w] != w && openIn[w] != none && openIn[w] != w;
+
+                if (simple && m_remap[openIn[v]] == m_remap[openOut[w]] && m_remap[openOut[v]] == m_remap[openIn[w]])
+                {
+                    m_kinds[v] = Kind_Seam;
+                }
+            }
+        }
+    }
+
+    void Simplifier::BuildQuadrics(const std::vector<uint32_t>& indices)
+    {
+        m_vertexQuadrics.assign(m_vertexCount, Quadric{});
+        m_attributeQuadrics.assign(m_vertexCount, AttributeQuadric{});
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            uint32_t i0 = indices[i + 0];
+            uint32_t i1 = indices[i + 1];
+            uint32_t i2 = indices[i + 2];
+
+            const Vector3& p0 = m_positions[i0];
+            Vector3 e1 = Subtract(m_positions[i1], p0);
+            Vector3 e2 = Subtract(m_positions[i2], p0);
+
+            Vector3 normal = Cross(e1, e2);
+            float area = Normalize(normal);
+            if (area == 0.0f)
+            {
+                continue;
+            }
+
+            Quadric plane = {};
+            AddPlane(plane, normal, -Dot(normal, p0), area);
+            plane.w = area;
+
+            Add(m_vertexQuadrics[m_remap[i0]], plane);
+            Add(m_vertexQuadrics[m_remap[i1]], plane);
+            Add(m_vertexQuadrics[m_remap[i2]], plane);
+
+            // Attribute gradients over the triangle.
+            float d00 = Dot(e1, e1);
+            float d01 = Dot(e1, e2);
+            float d11 = Dot(e2, e2);
+            float denominator = d00 * d11 - d01 * d01;
+
+            if (denominator != 0.0f)
+            {
+                float inverse = 1.0f / denominator;
+                Vector3 u{ (d11 * e1.x - d01 * e2.x) * inverse, (d11 * e1.y - d01 * e2.y) * inverse, (d11 * e1.z - d01 * e2.z) * inverse };
+                Vector3 t{ (d00 * e2.x - d01 * e1.x) * inverse, (d00 * e2.y - d01 * e1.y) * inverse, (d00 * e2.z - d01 * e1.z) * inverse };
+
+                AttributeQuadric quadric = {};
+                quadric.q.w = area;
+
+                const float* a0 = &m_attributes[i0 * c_attributeCount];
+                const float* a1 = &m_attributes[i1 * c_attributeCount];
+                const float* a2 = &m_attributes[i2 * c_attributeCount];
+
+                for (int k = 0; k < c_attributeCount; ++k)
+                {
+                    float delta1 = a1[k] - a0[k];
+                    float delta2 = a2[k] - a0[k];
+
+                    Vector3 gradient{ delta1 * u.x + delta2 * t.x, delta1 * u.y + delta2 * t.y, delta1 * u.z + delta2 * t.z };
+                    float offset = a0[k] - Dot(gradient, p0);
+
+                    AddPlane(quadric.q, gradient, offset, area);
+
+                    quadric.g[k][0] = gradient.x * area;
+                    quadric.g[k][1] = gradient.y * area;
+                    quadric.g[k][2] = gradient.z * area;
+                    quadric.g[k][3] = offset * area;
+                }
+
+                Add(m_attributeQuadrics[i0], quadric);
+                Add(m_attributeQuadrics[i1], quadric);
+                Add(m_attributeQuadrics[i2], quadric);
+            }
+
+            // Open borders and seams get a perpendicular plane per edge so they keep their shape.
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t a = indices[i + e];
+                uint32_t b = indices[i + (e + 1) % 3];
+                uint8_t kind = m_kinds[a];
+
+                if ((kind != Kind_Border && kind != Kind_Seam) || m_adjacency.HasEdge(b, a))
+                {
+                    continue;
+                }
+
+                Vector3 edge = Subtract(m_positions[b], m_positions[a]);
+                float length = sqrtf(Dot(edge, edge));
+                Vector3 edgeNormal = Cross(edge, normal);
+                Normalize(edgeNormal);
+
+                float weight = length * length * m_settings.borderWeight;
+                Quadric edgePlane = {};
+                AddPlane(edgePlane, edgeNormal, -Dot(edgeNormal, m_positions[a]), weight);
+                edgePlane.w = weight;
+
+                Add(m_vertexQuadrics[m_remap[a]], edgePlane);
+                Add(m_vertexQuadrics[m_remap[b]], edgePlane);
+            }
+        }
+    }
+
+    // Triangles touching each position, for the flip test.
+    void Simplifier::BuildTriangleFans(const uint32_t* indices, size_t indexCount)
+    {
+        m_fanOffsets.assign(m_vertexCount + 1, 0);
+        m_fanTriangles.resize(indexCount);
+
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            m_fanOffsets[m_remap[indices[i]] + 1]++;
+        }
+
+        for (size_t v = 0; v < m_vertexCount; ++v)
+        {
+            m_fanOffsets[v + 1] += m_fanOffsets[v];
+        }
+
+        std::vector<uint32_t> fill(m_fanOffsets.begin(), m_fanOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            m_fanTriangles[fill[m_remap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    float Simplifier::CollapseCost(uint32_t from, uint32_t to) const
+    {
+        const Vector3& target = m_positions[to];
+
+        float error = Error(m_vertexQuadrics[m_remap[from]], target);
+        error += Error(m_attributeQuadrics[from], target, &m_attributes[to * c_attributeCount]);
+
+        if (m_kinds[from] == Kind_Seam)
+        {
+            uint32_t fromSibling = m_wedge[from];
+            uint32_t toSibling = m_wedge[to];
+            error += Error(m_attributeQuadrics[fromSibling], target, &m_attributes[toSibling * c_attributeCount]);
+        }
+
+        return error;
+    }
+
+    // Rejects collapses that would turn a surviving triangle around.
+    bool Simplifier::FlipsTriangles(uint32_t from, uint32_t to, const uint32_t* indices) const
+    {
+        uint32_t fromPosition = m_remap[from];
+        uint32_t toPosition = m_remap[to];
+        const Vector3& target = m_positions[to];
+
+        for (uint32_t i = m_fanOffsets[fromPosition]; i < m_fanOffsets[fromPosition + 1]; ++i)
+        {
+            const uint32_t* triangle = &indices[m_fanTriangles[i] * 3];
+
+            uint32_t r0 = m_remap[triangle[0]];
+            uint32_t r1 = m_remap[triangle[1]];
+            uint32_t r2 = m_remap[triangle[2]];
+
+            // Triangles on the collapsed edge disappear.
+            if (r0 == toPosition || r1 == toPosition || r2 == toPosition)
+            {
+                continue;
+            }
+
+            Vector3 p[3] = { m_positions[triangle[0]], m_positions[triangle[1]], m_positions[triangle[2]] };
+            Vector3 before = Cross(Subtract(p[1], p[0]), Subtract(p[2], p[0]));
+
+            if (r0 == fromPosition) p[0] = target;
+            if (r1 == fromPosition) p[1] = target;
+            if (r2 == fromPosition) p[2] = target;
+
+            Vector3 after = Cross(Subtract(p[1], p[0]), Subtract(p[2], p[0]));
+
+            if (Dot(before, after) <= 0.25f * sqrtf(Dot(before, before) * Dot(after, after)))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<uint32_t> Simplifier::Run(const std::vector<uint32_t>& source, size_t targetIndexCount, float targetError, float* resultError)
+    {
+        std::vector<uint32_t> indices = source;
+
+        m_adjacency.Build(indices.data(), indices.size(), m_vertexCount);
+        ClassifyVertices(indices);
+        BuildQuadrics(indices);
+
+        std::vector<Collapse> candidates;
+        std::vector<uint32_t> collapseRemap(m_vertexCount);
+        std::vector<uint8_t> collapseLocked(m_vertexCount);
+
+        const float errorLimit = targetError * targetError;
+        float worstError = 0.0f;
+
+        while (indices.size() > targetIndexCount)
+        {
+            m_adjacency.Build(indices.data(), indices.size(), m_vertexCount);
+            BuildTriangleFans(indices.data(), indices.size());
+
+            // Score every edge once, in whichever direction is allowed and cheaper.
+            candidates.clear();
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (int e = 0; e < 3; ++e)
+                {
+                    uint32_t i0 = indices[i + e];
+                    uint32_t i1 = indices[i + (e + 1) % 3];
+                    uint8_t k0 = m_kinds[i0];
+                    uint8_t k1 = m_kinds[i1];
+
+                    if (!c_canCollapse[k0][k1] && !c_canCollapse[k1][k0])
+                    {
+                        continue;
+                    }
+
+                    bool hasOpposite = m_adjacency.HasEdge(i1, i0);
+
+                    // Borders and seams may only move along their open edges.
+                    if (k0 == k1 && (k0 == Kind_Border || k0 == Kind_Seam) && hasOpposite)
+                    {
+                        continue;
+                    }
+
+                    // Interior edges are seen from both triangles; score them once.
+                    if (hasOpposite && m_remap[i1] > m_remap[i0])
+                    {
+                        continue;
+                    }
+
+                    float error01 = c_canCollapse[k0][k1] ? CollapseCost(i0, i1) : FLT_MAX;
+                    float error10 = c_canCollapse[k1][k0] ? CollapseCost(i1, i0) : FLT_MAX;
+
+                    if (error01 <= error10)
+                    {
+                        candidates.push_back(Collapse{ i0, i1, error01 });
+                    }
+                    else
+                    {
+                        candidates.push_back(Collapse{ i1, i0, error10 });
+                    }
+                }
+            }
+
+            if (candidates.empty())
+            {
+                break;
+            }
+
+            std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            // Roughly two triangles go away per collapse. Collapses far more expensive than the
+            // one that would meet the goal are left for a later pass, when costs are fresh.
+            size_t triangleGoal = (indices.size() - targetIndexCount) / 3;
+            size_t edgeGoal = std::min(candidates.size() - 1, triangleGoal / 2 + triangleGoal / 4);
+            float errorGoal = candidates[edgeGoal].error * 1.5f;
+
+            for (uint32_t v = 0; v < m_vertexCount; ++v)
+            {
+                collapseRemap[v] = v;
+            }
+            std::fill(collapseLocked.begin(), collapseLocked.end(), uint8_t(0));
+
+            size_t triangleCollapses = 0;
+            size_t collapses = 0;
+
+            for (const Collapse& collapse : candidates)
+            {
+                if (collapse.error > errorLimit || triangleCollapses >= triangleGoal)
+                {
+                    break;
+                }
+
+                if (collapse.error > errorGoal && triangleCollapses > triangleGoal / 10)
+                {
+                    break;
+                }
+
+                uint32_t fromPosition = m_remap[collapse.from];
+                uint32_t toPosition = m_remap[collapse.to];
+
+                if (collapseLocked[fromPosition] || collapseLocked[toPosition])
+                {
+                    continue;
+                }
+
+                if (FlipsTriangles(collapse.from, collapse.to, indices.data()))
+                {
+                    continue;
+                }
+
+                uint8_t kind = m_kinds[collapse.from];
+                if (kind == Kind_Seam)
+                {
+                    uint32_t fromSibling = m_wedge[collapse.from];
+                    uint32_t toSibling = m_wedge[collapse.to];
+
+                    collapseRemap[collapse.from] = collapse.to;
+                    collapseRemap[fromSibling] = toSibling;
+
+                    Add(m_attributeQuadrics[collapse.to], m_attributeQuadrics[collapse.from]);
+                    Add(m_attributeQuadrics[toSibling], m_attributeQuadrics[fromSibling]);
+                }
+                else
+                {
+                    collapseRemap[collapse.from] = collapse.to;
+                    Add(m_attributeQuadrics[collapse.to], m_attributeQuadrics[collapse.from]);
+                }
+
+                Add(m_vertexQuadrics[toPosition], m_vertexQuadrics[fromPosition]);
+
+                collapseLocked[fromPosition] = 1;
+                collapseLocked[toPosition] = 1;
+
+                triangleCollapses += (kind == Kind_Border) ? 1 : 2;
+                worstError = std::max(worstError, collapse.error);
+                ++collapses;
+            }
+
+            if (collapses == 0)
+            {
+                break;
+            }
+
+            // Apply the pass and drop triangles that became degenerate.
+            size_t write = 0;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                uint32_t a = collapseRemap[indices[i + 0]];
+                uint32_t b = collapseRemap[indices[i + 1]];
+                uint32_t c = collapseRemap[indices[i + 2]];
+
+                uint32_t ra = m_remap[a];
+                uint32_t rb = m_remap[b];
+                uint32_t rc = m_remap[c];
+
+                if (ra != rb && rb != rc && rc != ra)
+                {
+                    indices[write + 0] = a;
+                    indices[write + 1] = b;
+                    indices[write + 2] = c;
+                    write += 3;
+                }
+            }
+            indices.resize(write);
+        }
+
+        if (resultError)
+        {
+            *resultError = sqrtf(worstError);
+        }
+
+        return indices;
+    }
+};
+
+std::vector<uint32_t> DX::SimplifyMesh(
+    const MeshData& mesh,
+    const std::vector<uint32_t>& indices,
+    size_t targetIndexCount,
+    float targetError,
+    const SimplifySettings& settings,
+    float* resultError)
+{
+    assert(indices.size() % 3 == 0);
+
+    Simplifier simplifier(mesh, settings);
+    return simplifier.Run(indices, targetIndexCount, targetError, resultError);
+}
+
+float DX::ComputeMeshExtent(const MeshData& mesh)
+{
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+            maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+        }
+    }
+
+    if (mesh.vertices.empty())
+    {
+        return 0.0f;
+    }
+
+    return std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+}
@@ -0,0 +1,45 @@
+//
+// MeshSimplifier.h - Quadric error metric mesh simplification with attribute preservation
+//
+
+#pragma once
+
+#include "MeshData.h"
+
+namespace DX
+{
+    struct SimplifySettings
+    {
+        SimplifySettings() :
+            normalWeight(0.5f),
+            texcoordWeight(1.0f),
+            borderWeight(10.0f)
+        {
+        }
+
+        // How strongly attribute deviation counts against a collapse, relative to geometric error.
+        float normalWeight;
+        float texcoordWeight;
+
+        // Extra weight on the planes that keep open borders in place.
+        float borderWeight;
+    };
+
+    // Simplifies the triangle list in indices (which reference mesh.vertices) down towards
+    // targetIndexCount, never exceeding targetError. The vertex buffer is left untouched so
+    // every level of detail can share it; only a new index list is returned.
+    //
+    // Errors are relative to the mesh extent (1.0 is the size of the bounding box), so they
+    // can be converted to world units by multiplying with the extent. The error of the
+    // result is written to resultError when it is not null.
+    std::vector<uint32_t> SimplifyMesh(
+        const MeshData& mesh,
+        const std::vector<uint32_t>& indices,
+        size_t targetIndexCount,
+        float targetError,
+        const SimplifySettings& settings = SimplifySettings(),
+        float* resultError = nullptr);
+
+    // Returns the largest side of the mesh's axis aligned bounding box.
+    float ComputeMeshExtent(const MeshData& mesh);
+}
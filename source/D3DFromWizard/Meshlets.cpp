@@ -0,0 +1,308 @@
+//
+// Meshlets.cpp - Splits triangle lists into small clusters with culling bounds
+//
+
+#include "pch.h"
+#include "Meshlets.h"
+
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+    const uint32_t c_none = ~0u;
+
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float normal[3])
+    {
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    inline float Normalize(float v[3])
+    {
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f)
+        {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+        return length;
+    }
+
+    inline float Dot(const float* a, const float* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    DX::MeshletBounds ComputeBounds(const std::vector<DX::MeshVertex>& vertices, const DX::MeshletData& data, const DX::Meshlet& meshlet)
+    {
+        DX::MeshletBounds bounds = {};
+
+        const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+        const uint8_t* meshletTriangles = &data.triangles[meshlet.triangleOffset];
+
+        // Sphere around the box center.
+        float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const float* p = vertices[meshletVertices[i]].position;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                minimum[axis] = std::min(minimum[axis], p[axis]);
+                maximum[axis] = std::max(maximum[axis], p[axis]);
+            }
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        }
+
+        float radiusSquared = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const float* p = vertices[meshletVertices[i]].position;
+            float d[3] = { p[0] - bounds.center[0], p[1] - bounds.center[1], p[2] - bounds.center[2] };
+            radiusSquared = std::max(radiusSquared, Dot(d, d));
+        }
+        bounds.radius = sqrtf(radiusSquared);
+
+        // Normal cone: the axis is the average facing, the cutoff comes from the widest deviation.
+        std::vector<float> normals(meshlet.triangleCount * 3);
+        float axis[3] = {};
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const uint8_t* triangle = &meshletTriangles[t * 3];
+            float* normal = &normals[t * 3];
+
+            TriangleNormal(
+                vertices[meshletVertices[triangle[0]]].position,
+                vertices[meshletVertices[triangle[1]]].position,
+                vertices[meshletVertices[triangle[2]]].position,
+                normal);
+            Normalize(normal);
+
+            axis[0] += normal[0];
+            axis[1] += normal[1];
+            axis[2] += normal[2];
+        }
+
+        bounds.coneCutoff = 1.0f;
+        if (Normalize(axis) == 0.0f)
+        {
+            return bounds;
+        }
+
+        float minimumDot = 1.0f;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const float* normal = &normals[t * 3];
+            if (normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f)
+            {
+                minimumDot = std::min(minimumDot, Dot(normal, axis));
+            }
+        }
+
+        // Normals spread over (nearly) a hemisphere, the cone can never reject anything.
+        if (minimumDot <= 0.1f)
+        {
+            return bounds;
+        }
+
+        // Move the apex back along the axis until every triangle plane is in front of it.
+        float maximumT = 0.0f;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const float* normal = &normals[t * 3];
+            const float* p0 = vertices[meshletVertices[meshletTriangles[t * 3]]].position;
+
+            float toCenter[3] = { bounds.center[0] - p0[0], bounds.center[1] - p0[1], bounds.center[2] - p0[2] };
+            float dn = Dot(axis, normal);
+            if (dn > 0.0f)
+            {
+                maximumT = std::max(maximumT, Dot(toCenter, normal) / dn);
+            }
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds.coneAxis[i] = axis[i];
+            bounds.coneApex[i] = bounds.center[i] - axis[i] * maximumT;
+        }
+        bounds.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+
+        return bounds;
+    }
+};
+
+void DX::BuildMeshlets(
+    const std::vector<MeshVertex>& vertices,
+    const uint32_t* indices,
+    size_t indexCount,
+    MeshletData& output,
+    uint32_t maxVertices,
+    uint32_t maxTriangles)
+{
+    assert(indexCount % 3 == 0);
+    assert(maxVertices >= 3 && maxVertices <= 256);
+    assert(maxTriangles >= 1);
+
+    const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+    const size_t vertexCount = vertices.size();
+
+    // Triangles around each vertex.
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> localIndex(vertexCount, c_none);
+    uint32_t nextSeed = 0;
+
+    for (;;)
+    {
+        while (nextSeed < triangleCount && emitted[nextSeed])
+        {
+            ++nextSeed;
+        }
+
+        if (nextSeed == triangleCount)
+        {
+            break;
+        }
+
+        Meshlet meshlet = {};
+        meshlet.vertexOffset = static_cast<uint32_t>(output.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(output.triangles.size());
+
+        float centroid[3] = {};
+        uint32_t triangle = nextSeed;
+
+        while (triangle != c_none)
+        {
+            const uint32_t* corners = &indices[triangle * 3];
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = corners[c];
+                if (localIndex[v] == c_none)
+                {
+                    localIndex[v] = meshlet.vertexCount++;
+                    output.vertices.push_back(v);
+
+                    const float* p = vertices[v].position;
+                    centroid[0] += p[0];
+                    centroid[1] += p[1];
+                    centroid[2] += p[2];
+                }
+                output.triangles.push_back(static_cast<uint8_t>(localIndex[v]));
+            }
+
+            emitted[triangle] = 1;
+            meshlet.triangleCount++;
+
+            if (meshlet.triangleCount == maxTriangles)
+            {
+                break;
+            }
+
+            // Grow through connected triangles, preferring the ones that add the fewest new
+            // vertices and then the ones closest to the cluster's center.
+            float center[3] = { centroid[0] / meshlet.vertexCount, centroid[1] / meshlet.vertexCount, centroid[2] / meshlet.vertexCount };
+            uint32_t best = c_none;
+            uint32_t bestNewVertices = 4;
+            float bestDistance = FLT_MAX;
+
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                uint32_t v = output.vertices[meshlet.vertexOffset + i];
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+                {
+                    uint32_t candidate = adjacency[a];
+                    if (emitted[candidate])
+                    {
+                        continue;
+                    }
+
+                    const uint32_t* candidateCorners = &indices[candidate * 3];
+                    uint32_t newVertices = (localIndex[candidateCorners[0]] == c_none)
+                        + (localIndex[candidateCorners[1]] == c_none)
+                        + (localIndex[candidateCorners[2]] == c_none);
+
+                    if (meshlet.vertexCount + newVertices > maxVertices || newVertices > bestNewVertices)
+                    {
+                        continue;
+                    }
+
+                    float distance = 0.0f;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        float d = (vertices[candidateCorners[0]].position[axis] + vertices[candidateCorners[1]].position[axis]
+                            + vertices[candidateCorners[2]].position[axis]) / 3.0f - center[axis];
+                        distance += d * d;
+                    }
+
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        best = candidate;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            // Nothing connected fits; keep filling with the next unused triangle in index order
+            // so disconnected pieces do not each end up in a nearly empty meshlet.
+            if (best == c_none)
+            {
+                while (nextSeed < triangleCount && emitted[nextSeed])
+                {
+                    ++nextSeed;
+                }
+
+                if (nextSeed < triangleCount)
+                {
+                    const uint32_t* seedCorners = &indices[nextSeed * 3];
+                    uint32_t newVertices = (localIndex[seedCorners[0]] == c_none)
+                        + (localIndex[seedCorners[1]] == c_none)
+                        + (localIndex[seedCorners[2]] == c_none);
+
+                    if (meshlet.vertexCount + newVertices <= maxVertices)
+                    {
+                        best = nextSeed;
+                    }
+                }
+            }
+
+            triangle = best;
+        }
+
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            localIndex[output.vertices[meshlet.vertexOffset + i]] = c_none;
+        }
+
+        output.meshlets.push_back(meshlet);
+        output.bounds.push_back(ComputeBounds(vertices, output, meshlet));
+    }
+}
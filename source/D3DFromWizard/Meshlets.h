@@ -0,0 +1,53 @@
+//
+// Meshlets.h - Splits triangle lists into small clusters with culling bounds
+//
+
+#pragma once
+
+#include "MeshData.h"
+
+namespace DX
+{
+    // A cluster of at most maxVertices unique vertices and maxTriangles triangles. Triangles
+    // are stored as 8-bit indices into the meshlet's own vertex list.
+    struct Meshlet
+    {
+        uint32_t    vertexOffset;       // Into MeshletData::vertices.
+        uint32_t    triangleOffset;     // Into MeshletData::triangles, in bytes (3 per triangle).
+        uint32_t    vertexCount;
+        uint32_t    triangleCount;
+    };
+
+    // Bounding sphere and normal cone of a meshlet. The meshlet is entirely back-facing when
+    // dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff; a cutoff of 1 or more
+    // means the normals are too spread for the cone to ever reject it.
+    struct MeshletBounds
+    {
+        float       center[3];
+        float       radius;
+        float       coneApex[3];
+        float       coneAxis[3];
+        float       coneCutoff;
+    };
+
+    struct MeshletData
+    {
+        std::vector<Meshlet>        meshlets;
+        std::vector<MeshletBounds>  bounds;
+        std::vector<uint32_t>       vertices;   // Indices into the source vertex buffer.
+        std::vector<uint8_t>        triangles;
+    };
+
+    const uint32_t c_meshletMaxVertices = 64;
+    const uint32_t c_meshletMaxTriangles = 124;
+
+    // Appends meshlets for the triangle list to output. Triangles are grown greedily from
+    // connected neighbours so meshlets stay compact, which keeps spheres tight and cones narrow.
+    void BuildMeshlets(
+        const std::vector<MeshVertex>& vertices,
+        const uint32_t* indices,
+        size_t indexCount,
+        MeshletData& output,
+        uint32_t maxVertices = c_meshletMaxVertices,
+        uint32_t maxTriangles = c_meshletMaxTriangles);
+}
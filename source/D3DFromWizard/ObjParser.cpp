@@ -0,0 +1,875 @@
+//
+// ObjParser.cpp - Parallel Wavefront OBJ and MTL reader
+//
+
+#include "pch.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "MeshLoader.h"
+
+#include <chrono>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Below this a chunk is not worth a thread.
+    const size_t c_minChunkBytes = 256 * 1024;
+
+    // More chunks than threads, so a chunk of long face lines does not hold up the rest.
+    const uint32_t c_chunksPerThread = 4;
+
+    const double c_powersOfTen[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool IsDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    inline const char* SkipBlanks(const char* cursor, const char* end)
+    {
+        while (cursor < end && IsBlank(*cursor))
+        {
+            ++cursor;
+        }
+        return cursor;
+    }
+
+    inline const char* SkipToken(const char* cursor, const char* end)
+    {
+        while (cursor < end && !IsBlank(*cursor))
+        {
+            ++cursor;
+        }
+        return cursor;
+    }
+
+    // The end of the line at cursor, before its '\n'.
+    inline const char* FindLineEnd(const char* cursor, const char* end)
+    {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        return newline ? newline : end;
+    }
+
+    inline const char* NextLine(const char* lineEnd, const char* end)
+    {
+        return lineEnd < end ? lineEnd + 1 : end;
+    }
+
+    // Eight ASCII digits at once, SWAR style: the check and the conversion each take a few
+    // integer operations on one 64-bit load instead of eight dependent multiply-adds.
+    inline uint64_t LoadEight(const char* cursor)
+    {
+        uint64_t value;
+        memcpy(&value, cursor, sizeof(value));
+        return value;
+    }
+
+    inline bool IsEightDigits(uint64_t value)
+    {
+        return (((value & 0xF0F0F0F0F0F0F0F0ull) | (((value + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+            0x3333333333333333ull);
+    }
+
+    inline uint32_t ParseEightDigits(uint64_t value)
+    {
+        const uint64_t mask = 0x000000FF000000FFull;
+        const uint64_t multiplier1 = 0x000F424000000064ull;     // 100 + (1000000 << 32)
+        const uint64_t multiplier2 = 0x0000271000000001ull;     // 1 + (10000 << 32)
+        value -= 0x3030303030303030ull;
+        value = (value * 10) + (value >> 8);
+        value = (((value & mask) * multiplier1) + (((value >> 16) & mask) * multiplier2)) >> 32;
+        return static_cast<uint32_t>(value);
+    }
+
+    // Accumulates digits into mantissa and returns past them. Only the low 64 bits survive
+    // more than 19 digits, which the caller detects from the count.
+    inline const char* ReadDigits(const char* cursor, const char* end, uint64_t& mantissa)
+    {
+        while (end - cursor >= 8)
+        {
+            uint64_t eight = LoadEight(cursor);
+            if (!IsEightDigits(eight))
+            {
+                break;
+            }
+            mantissa = mantissa * 100000000u + ParseEightDigits(eight);
+            cursor += 8;
+        }
+        while (cursor < end && IsDigit(*cursor))
+        {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*cursor - '0');
+            ++cursor;
+        }
+        return cursor;
+    }
+
+    // As strtol, within a token: an optional sign and decimal digits, or zero if there are none.
+    inline const char* ReadInteger(const char* cursor, const char* end, int& value)
+    {
+        const char* begin = cursor;
+        bool negative = false;
+        if (cursor < end && (*cursor == '-' || *cursor == '+'))
+        {
+            negative = *cursor == '-';
+            ++cursor;
+        }
+
+        const char* digits = cursor;
+        int64_t magnitude = 0;
+        while (cursor < end && IsDigit(*cursor))
+        {
+            magnitude = std::min<int64_t>(magnitude * 10 + (*cursor - '0'), INT32_MAX + int64_t(1));
+            ++cursor;
+        }
+        if (cursor == digits)
+        {
+            value = 0;
+            return begin;
+        }
+
+        magnitude = negative ? -magnitude : std::min<int64_t>(magnitude, INT32_MAX);
+        value = static_cast<int>(std::max<int64_t>(magnitude, INT32_MIN));
+        return cursor;
+    }
+
+    // OBJ indices are 1-based; negative ones count back from the elements defined so far.
+    // Returns -1 for "absent".
+    inline int ResolveIndex(int index, uint32_t count)
+    {
+        if (index > 0)
+        {
+            return index - 1;
+        }
+        if (index < 0)
+        {
+            return static_cast<int>(count) + index;
+        }
+        return -1;
+    }
+
+    enum LineType
+    {
+        LineType_Other,
+        LineType_Position,
+        LineType_Normal,
+        LineType_Texcoord,
+        LineType_Face,
+        LineType_UseMaterial,
+        LineType_MaterialLibrary,
+    };
+
+    // Reads the keyword at the start of a line and leaves cursor just past it.
+    inline LineType ReadKeyword(const char*& cursor, const char* lineEnd)
+    {
+        cursor = SkipBlanks(cursor, lineEnd);
+        const char* keyword = cursor;
+        cursor = SkipToken(cursor, lineEnd);
+
+        switch (cursor - keyword)
+        {
+        case 1:
+            return keyword[0] == 'v' ? LineType_Position : keyword[0] == 'f' ? LineType_Face : LineType_Other;
+        case 2:
+            return keyword[0] != 'v' ? LineType_Other :
+                keyword[1] == 'n' ? LineType_Normal : keyword[1] == 't' ? LineType_Texcoord : LineType_Other;
+        case 6:
+            return memcmp(keyword, "usemtl", 6) == 0 ? LineType_UseMaterial :
+                memcmp(keyword, "mtllib", 6) == 0 ? LineType_MaterialLibrary : LineType_Other;
+        default:
+            return LineType_Other;
+        }
+    }
+
+    // Up to count blank separated numbers; the rest stay as they were.
+    inline void ReadFloats(const char* cursor, const char* lineEnd, float* values, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            cursor = SkipBlanks(cursor, lineEnd);
+            if (!DX::ParseObjFloat(cursor, lineEnd, values[i]))
+            {
+                return;
+            }
+        }
+    }
+
+    // The rest of the line without surrounding blanks.
+    inline std::string ReadRest(const char* cursor, const char* lineEnd)
+    {
+        cursor = SkipBlanks(cursor, lineEnd);
+        while (lineEnd > cursor && IsBlank(lineEnd[-1]))
+        {
+            --lineEnd;
+        }
+        return std::string(cursor, lineEnd);
+    }
+
+    // Resolved, 0-based indices of one face corner; -1 where absent. Texture coordinate and
+    // normal indices may be out of range, in which case the vertex has zeros there.
+    struct ObjCorner
+    {
+        int32_t position;
+        int32_t texcoord;
+        int32_t normal;
+
+        bool operator==(const ObjCorner& other) const
+        {
+            return position == other.position && texcoord == other.texcoord && normal == other.normal;
+        }
+    };
+
+    const uint32_t c_emptySlot = UINT32_MAX;
+
+    // Numbers corners in order of first insertion. Open addressing over indices into the
+    // corner array, so the table itself is one uint32_t per slot.
+    class CornerTable
+    {
+    public:
+        explicit CornerTable(size_t expected)
+        {
+            size_t capacity = 64;
+            while (capacity < expected * 2)
+            {
+                capacity *= 2;
+            }
+            m_slots.assign(capacity, c_emptySlot);
+        }
+
+        uint32_t Insert(const ObjCorner& corner, std::vector<ObjCorner>& corners)
+        {
+            size_t mask = m_slots.size() - 1;
+            for (size_t slot = Hash(corner) & mask;; slot = (slot + 1) & mask)
+            {
+                uint32_t index = m_slots[slot];
+                if (index == c_emptySlot)
+                {
+                    index = static_cast<uint32_t>(corners.size());
+                    m_slots[slot] = index;
+                    corners.push_back(corner);
+                    if (corners.size() * 2 > m_slots.size())
+                    {
+                        Grow(corners);
+                    }
+                    return index;
+                }
+                if (corners[index] == corner)
+                {
+                    return index;
+                }
+            }
+        }
+
+    private:
+        static size_t Hash(const ObjCorner& corner)
+        {
+            uint64_t hash = static_cast<uint32_t>(corner.position) * 0x9E3779B97F4A7C15ull;
+            hash ^= static_cast<uint32_t>(corner.texcoord) * 0xC2B2AE3D27D4EB4Full;
+            hash ^= static_cast<uint32_t>(corner.normal) * 0x165667B19E3779F9ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+
+        void Grow(const std::vector<ObjCorner>& corners)
+        {
+            m_slots.assign(m_slots.size() * 2, c_emptySlot);
+            size_t mask = m_slots.size() - 1;
+            for (uint32_t index = 0; index < corners.size(); ++index)
+            {
+                size_t slot = Hash(corners[index]) & mask;
+                while (m_slots[slot] != c_emptySlot)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                m_slots[slot] = index;
+            }
+        }
+
+        std::vector<uint32_t> m_slots;
+    };
+
+    struct MaterialChange
+    {
+        uint32_t        indexOffset;        // In the chunk's indices.
+        std::string     name;
+    };
+
+    struct ObjChunk
+    {
+        const char*                 begin;
+        const char*                 end;
+
+        // Elements the chunk defines, and those defined before it.
+        uint32_t                    lineCount;
+        uint32_t                    positionCount;
+        uint32_t                    normalCount;
+        uint32_t                    texcoordCount;
+        uint32_t                    lineBase;
+        uint32_t                    positionBase;
+        uint32_t                    normalBase;
+        uint32_t                    texcoordBase;
+
+        std::vector<ObjCorner>      corners;        // Distinct within the chunk, in order of first use.
+        std::vector<uint32_t>       indices;        // Into corners.
+        std::vector<MaterialChange> materials;
+        std::vector<std::string>    libraries;
+
+        std::vector<uint32_t>       remap;          // corners to mesh vertices.
+        uint32_t                    indexBase;
+
+        uint32_t                    errorLine;      // Zero if the chunk parsed.
+    };
+
+    void CountChunk(ObjChunk& chunk)
+    {
+        chunk.lineCount = chunk.positionCount = chunk.normalCount = chunk.texcoordCount = 0;
+        for (const char* line = chunk.begin, *lineEnd; line < chunk.end; line = NextLine(lineEnd, chunk.end))
+        {
+            lineEnd = FindLineEnd(line, chunk.end);
+            const char* cursor = line;
+            switch (ReadKeyword(cursor, lineEnd))
+            {
+            case LineType_Position:     chunk.positionCount++; break;
+            case LineType_Normal:       chunk.normalCount++; break;
+            case LineType_Texcoord:     chunk.texcoordCount++; break;
+            default:                    break;
+            }
+            chunk.lineCount++;
+        }
+    }
+
+    // Fills in the chunk's elements in the shared arrays, resolves its faces against the
+    // elements defined before each line and numbers their distinct corners.
+    void ParseChunk(ObjChunk& chunk, float* positions, float* normals, float* texcoords)
+    {
+        uint32_t positionCount = chunk.positionBase;
+        uint32_t normalCount = chunk.normalBase;
+        uint32_t texcoordCount = chunk.texcoordBase;
+
+        // Meshes share each vertex between about six triangles.
+        CornerTable table((chunk.end - chunk.begin) / 64);
+        std::vector<uint32_t> polygon;
+
+        uint32_t lineNumber = chunk.lineBase;
+        chunk.errorLine = 0;
+        for (const char* line = chunk.begin, *lineEnd; line < chunk.end; line = NextLine(lineEnd, chunk.end))
+        {
+            lineEnd = FindLineEnd(line, chunk.end);
+            const char* cursor = line;
+            lineNumber++;
+
+            switch (ReadKeyword(cursor, lineEnd))
+            {
+            case LineType_Position:
+                ReadFloats(cursor, lineEnd, positions + size_t(positionCount++) * 3, 3);
+                break;
+
+            case LineType_Normal:
+                ReadFloats(cursor, lineEnd, normals + size_t(normalCount++) * 3, 3);
+                break;
+
+            case LineType_Texcoord:
+                ReadFloats(cursor, lineEnd, texcoords + size_t(texcoordCount++) * 2, 2);
+                break;
+
+            case LineType_Face:
+                polygon.clear();
+                for (cursor = SkipBlanks(cursor, lineEnd); cursor < lineEnd; cursor = SkipBlanks(cursor, lineEnd))
+                {
+                    // "v", "v/t", "v//n" or "v/t/n".
+                    const char* tokenEnd = SkipToken(cursor, lineEnd);
+                    int p = 0, t = 0, n = 0;
+                    const char* at = ReadInteger(cursor, tokenEnd, p);
+                    if (at < tokenEnd && *at == '/')
+                    {
+                        ++at;
+                        if (at < tokenEnd && *at != '/')
+                        {
+                            at = ReadInteger(at, tokenEnd, t);
+                        }
+                        if (at < tokenEnd && *at == '/')
+                        {
+                            ReadInteger(at + 1, tokenEnd, n);
+                        }
+                    }
+                    cursor = tokenEnd;
+
+                    ObjCorner corner;
+                    corner.position = ResolveIndex(p, positionCount);
+                    corner.texcoord = ResolveIndex(t, texcoordCount);
+                    corner.normal = ResolveIndex(n, normalCount);
+                    if (corner.position < 0 || static_cast<uint32_t>(corner.position) >= positionCount)
+                    {
+                        chunk.errorLine = lineNumber;
+                        return;
+                    }
+
+                    polygon.push_back(table.Insert(corner, chunk.corners));
+                }
+
+                for (size_t i = 2; i < polygon.size(); ++i)
+                {
+                    chunk.indices.push_back(polygon[0]);
+                    chunk.indices.push_back(polygon[i - 1]);
+                    chunk.indices.push_back(polygon[i]);
+                }
+                break;
+
+            case LineType_UseMaterial:
+                chunk.materials.push_back({ static_cast<uint32_t>(chunk.indices.size()), ReadRest(cursor, lineEnd) });
+                break;
+
+            case LineType_MaterialLibrary:
+                for (cursor = SkipBlanks(cursor, lineEnd); cursor < lineEnd; cursor = SkipBlanks(cursor, lineEnd))
+                {
+                    const char* tokenEnd = SkipToken(cursor, lineEnd);
+                    chunk.libraries.emplace_back(cursor, tokenEnd);
+                    cursor = tokenEnd;
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    void ParallelFor(DX::WorkerPool* workers, uint32_t count, const std::function<void(uint32_t)>& function)
+    {
+        if (workers)
+        {
+            workers->ParallelFor(count, function);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                function(i);
+            }
+        }
+    }
+
+    double SecondsSince(Clock::time_point& start)
+    {
+        Clock::time_point now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - start).count();
+        start = now;
+        return seconds;
+    }
+
+    DX::ObjMaterial MakeDefaultMaterial(const std::string& name)
+    {
+        DX::ObjMaterial material;
+        material.name = name;
+        for (int i = 0; i < 3; ++i)
+        {
+            material.ambient[i] = 0.0f;
+            material.diffuse[i] = 1.0f;
+            material.specular[i] = 0.0f;
+        }
+        material.specularExponent = 0.0f;
+        material.opacity = 1.0f;
+        return material;
+    }
+};
+
+bool DX::ParseObjFloat(const char*& cursor, const char* end, float& value)
+{
+    const char* at = cursor;
+    bool negative = false;
+    if (at < end && (*at == '-' || *at == '+'))
+    {
+        negative = *at == '-';
+        ++at;
+    }
+
+    uint64_t mantissa = 0;
+    const char* integer = at;
+    at = ReadDigits(at, end, mantissa);
+    ptrdiff_t digits = at - integer;
+
+    int64_t exponent = 0;
+    if (at < end && *at == '.')
+    {
+        const char* fraction = ++at;
+        at = ReadDigits(at, end, mantissa);
+        exponent = -(at - fraction);
+        digits += at - fraction;
+    }
+    if (digits == 0)
+    {
+        return false;
+    }
+
+    // An exponent without digits is not part of the number.
+    if (at < end && (*at == 'e' || *at == 'E'))
+    {
+        const char* exponentAt = at + 1;
+        bool negativeExponent = false;
+        if (exponentAt < end && (*exponentAt == '-' || *exponentAt == '+'))
+        {
+            negativeExponent = *exponentAt == '-';
+            ++exponentAt;
+        }
+        if (exponentAt < end && IsDigit(*exponentAt))
+        {
+            int64_t explicitExponent = 0;
+            while (exponentAt < end && IsDigit(*exponentAt))
+            {
+                explicitExponent = std::min<int64_t>(explicitExponent * 10 + (*exponentAt - '0'), 100000);
+                ++exponentAt;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            at = exponentAt;
+        }
+    }
+
+    // Clinger's fast path: with both the mantissa and the power of ten exact in a double, one
+    // multiply or divide rounds correctly. Rounding that double to float again only goes
+    // wrong when it lands exactly halfway between two floats, and that is left to strtof, as
+    // are long mantissas, large exponents and anything outside the normal float range.
+    if (digits <= 19 && mantissa == 0)
+    {
+        value = negative ? -0.0f : 0.0f;
+        cursor = at;
+        return true;
+    }
+    if (digits <= 19 && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / c_powersOfTen[-exponent] : result * c_powersOfTen[exponent];
+
+        uint64_t bits;
+        memcpy(&bits, &result, sizeof(bits));
+        if (result >= FLT_MIN && result <= FLT_MAX && (bits & 0x1FFFFFFFull) != 0x10000000ull)
+        {
+            value = static_cast<float>(negative ? -result : result);
+            cursor = at;
+            return true;
+        }
+    }
+
+    std::string text(cursor, at);
+    value = strtof(text.c_str(), nullptr);
+    cursor = at;
+    return true;
+}
+
+DX::ObjModel DX::ParseObj(const char* text, size_t size, WorkerPool* workers, ObjParseStatistics* statistics)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point phase = start;
+    ObjParseStatistics stats = {};
+    stats.bytes = size;
+
+    // Line-aligned chunks.
+    uint32_t chunkCount = 1;
+    if (workers && workers->GetThreadCount() > 1)
+    {
+        size_t byBytes = std::max<size_t>(size / c_minChunkBytes, 1);
+        chunkCount = static_cast<uint32_t>(std::min<size_t>(workers->GetThreadCount() * c_chunksPerThread, byBytes));
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* end = text + size;
+    const char* begin = text;
+    for (uint32_t i = 0; i < chunkCount; ++i)
+    {
+        const char* chunkEnd = i + 1 == chunkCount ? end : std::max(begin, text + size * (i + 1) / chunkCount);
+        if (chunkEnd < end)
+        {
+            chunkEnd = NextLine(FindLineEnd(chunkEnd, end), end);
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = chunkEnd;
+        begin = chunkEnd;
+    }
+    stats.chunks = chunkCount;
+
+    // Counting first lets every chunk write its elements straight into place and resolve
+    // relative indices, which depend on everything before them.
+    ParallelFor(workers, chunkCount, [&](uint32_t i) { CountChunk(chunks[i]); });
+
+    uint64_t lineCount = 0, positionCount = 0, normalCount = 0, texcoordCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.lineBase = static_cast<uint32_t>(lineCount);
+        chunk.positionBase = static_cast<uint32_t>(positionCount);
+        chunk.normalBase = static_cast<uint32_t>(normalCount);
+        chunk.texcoordBase = static_cast<uint32_t>(texcoordCount);
+        lineCount += chunk.lineCount;
+        positionCount += chunk.positionCount;
+        normalCount += chunk.normalCount;
+        texcoordCount += chunk.texcoordCount;
+    }
+    if (positionCount > INT32_MAX || normalCount > INT32_MAX || texcoordCount > INT32_MAX)
+    {
+        throw std::runtime_error("Too many vertices in OBJ text");
+    }
+    stats.countSeconds = SecondsSince(phase);
+
+    std::vector<float> positions(positionCount * 3, 0.0f);
+    std::vector<float> normals(normalCount * 3, 0.0f);
+    std::vector<float> texcoords(texcoordCount * 2, 0.0f);
+    ParallelFor(workers, chunkCount, [&](uint32_t i)
+    {
+        ParseChunk(chunks[i], positions.data(), normals.data(), texcoords.data());
+    });
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.errorLine)
+        {
+            throw std::runtime_error("Invalid vertex index on line " + std::to_string(chunk.errorLine));
+        }
+    }
+    stats.parseSeconds = SecondsSince(phase);
+
+    // Merging the chunks' corners in chunk order numbers the vertices exactly as one pass
+    // over the file would, and only touches each chunk's distinct corners.
+    size_t cornerCount = 0;
+    for (const ObjChunk& chunk : chunks)
+    {
+        cornerCount += chunk.corners.size();
+    }
+
+    std::vector<ObjCorner> corners;
+    corners.reserve(cornerCount);
+    CornerTable table(cornerCount);
+    uint64_t indexCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.remap.resize(chunk.corners.size());
+        for (size_t i = 0; i < chunk.corners.size(); ++i)
+        {
+            chunk.remap[i] = table.Insert(chunk.corners[i], corners);
+        }
+        chunk.indexBase = static_cast<uint32_t>(indexCount);
+        indexCount += chunk.indices.size();
+    }
+    if (indexCount > UINT32_MAX)
+    {
+        throw std::runtime_error("Too many triangles in OBJ text");
+    }
+
+    ObjModel model;
+    std::vector<std::string> materialNames;
+    int32_t material = -1;
+    uint32_t subsetStart = 0;
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const MaterialChange& change : chunk.materials)
+        {
+            uint32_t offset = chunk.indexBase + change.indexOffset;
+            if (offset > subsetStart)
+            {
+                model.subsets.push_back({ subsetStart, offset - subsetStart, material });
+                subsetStart = offset;
+            }
+
+            auto it = std::find(materialNames.begin(), materialNames.end(), change.name);
+            material = static_cast<int32_t>(it - materialNames.begin());
+            if (it == materialNames.end())
+            {
+                materialNames.push_back(change.name);
+                model.materials.push_back(MakeDefaultMaterial(change.name));
+            }
+        }
+        model.materialLibraries.insert(model.materialLibraries.end(), chunk.libraries.begin(), chunk.libraries.end());
+    }
+    if (indexCount > subsetStart)
+    {
+        model.subsets.push_back({ subsetStart, static_cast<uint32_t>(indexCount) - subsetStart, material });
+    }
+
+    // Switching back and forth between materials is not a new subset unless a triangle was
+    // drawn in between.
+    size_t merged = 0;
+    for (size_t i = 0; i < model.subsets.size(); ++i)
+    {
+        if (merged > 0 && model.subsets[merged - 1].material == model.subsets[i].material)
+        {
+            model.subsets[merged - 1].indexCount += model.subsets[i].indexCount;
+        }
+        else
+        {
+            model.subsets[merged++] = model.subsets[i];
+        }
+    }
+    model.subsets.resize(merged);
+    stats.mergeSeconds = SecondsSince(phase);
+
+    // Vertices and indices in parallel, each chunk's and each range's destination known.
+    MeshData& mesh = model.mesh;
+    mesh.vertices.resize(corners.size());
+    mesh.indices.resize(static_cast<size_t>(indexCount));
+
+    uint32_t ranges = std::max<uint32_t>(chunkCount, 1);
+    ParallelFor(workers, ranges + chunkCount, [&](uint32_t task)
+    {
+        if (task >= ranges)
+        {
+            const ObjChunk& chunk = chunks[task - ranges];
+            uint32_t* indices = mesh.indices.data() + chunk.indexBase;
+            for (size_t i = 0; i < chunk.indices.size(); ++i)
+            {
+                indices[i] = chunk.remap[chunk.indices[i]];
+            }
+            return;
+        }
+
+        size_t first = corners.size() * task / ranges;
+        size_t last = corners.size() * (task + 1) / ranges;
+        for (size_t i = first; i < last; ++i)
+        {
+            const ObjCorner& corner = corners[i];
+            MeshVertex& vertex = mesh.vertices[i];
+            memcpy(vertex.position, &positions[size_t(corner.position) * 3], sizeof(vertex.position));
+            if (corner.normal >= 0 && static_cast<uint64_t>(corner.normal) < normalCount)
+            {
+                memcpy(vertex.normal, &normals[size_t(corner.normal) * 3], sizeof(vertex.normal));
+            }
+            else
+            {
+                vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+            }
+            if (corner.texcoord >= 0 && static_cast<uint64_t>(corner.texcoord) < texcoordCount)
+            {
+                vertex.texcoord[0] = texcoords[size_t(corner.texcoord) * 2];
+                vertex.texcoord[1] = 1.0f - texcoords[size_t(corner.texcoord) * 2 + 1];
+            }
+            else
+            {
+                vertex.texcoord[0] = vertex.texcoord[1] = 0.0f;
+            }
+        }
+    });
+
+    if (normalCount == 0)
+    {
+        ComputeVertexNormals(mesh);
+    }
+    stats.buildSeconds = SecondsSince(phase);
+    stats.totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (statistics)
+    {
+        *statistics = stats;
+    }
+    return model;
+}
+
+std::vector<DX::ObjMaterial> DX::ParseMtl(const char* text, size_t size)
+{
+    std::vector<ObjMaterial> materials;
+    const char* end = text + size;
+    for (const char* line = text, *lineEnd; line < end; line = NextLine(lineEnd, end))
+    {
+        lineEnd = FindLineEnd(line, end);
+        const char* keyword = SkipBlanks(line, lineEnd);
+        const char* cursor = SkipToken(keyword, lineEnd);
+        std::string name(keyword, cursor);
+
+        if (name == "newmtl")
+        {
+            materials.push_back(MakeDefaultMaterial(ReadRest(cursor, lineEnd)));
+            continue;
+        }
+        if (materials.empty())
+        {
+            continue;
+        }
+
+        ObjMaterial& material = materials.back();
+        if (name == "Ka")
+        {
+            ReadFloats(cursor, lineEnd, material.ambient, 3);
+        }
+        else if (name == "Kd")
+        {
+            ReadFloats(cursor, lineEnd, material.diffuse, 3);
+        }
+        else if (name == "Ks")
+        {
+            ReadFloats(cursor, lineEnd, material.specular, 3);
+        }
+        else if (name == "Ns")
+        {
+            ReadFloats(cursor, lineEnd, &material.specularExponent, 1);
+        }
+        else if (name == "d")
+        {
+            ReadFloats(cursor, lineEnd, &material.opacity, 1);
+        }
+        else if (name == "Tr")
+        {
+            float transparency = 1.0f - material.opacity;
+            ReadFloats(cursor, lineEnd, &transparency, 1);
+            material.opacity = 1.0f - transparency;
+        }
+        else if (name == "map_Kd")
+        {
+            material.diffuseMap = ReadRest(cursor, lineEnd);
+        }
+        else if (name == "bump" || name == "map_bump" || name == "map_Bump")
+        {
+            material.normalMap = ReadRest(cursor, lineEnd);
+        }
+    }
+    return materials;
+}
+
+DX::ObjModel DX::LoadObjModel(const std::string& path, WorkerPool* workers, ObjParseStatistics* statistics)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        throw std::runtime_error("Unable to open " + path);
+    }
+
+    ObjModel model;
+    try
+    {
+        model = ParseObj(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), workers, statistics);
+    }
+    catch (const std::runtime_error& error)
+    {
+        throw std::runtime_error(std::string(error.what()) + " of " + path);
+    }
+    model.mesh.name = path;
+
+    size_t slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    for (const std::string& library : model.materialLibraries)
+    {
+        MappedFile mtl;
+        if (!mtl.Open(directory + library))
+        {
+            continue;
+        }
+
+        for (const ObjMaterial& defined : ParseMtl(reinterpret_cast<const char*>(mtl.GetData()), mtl.GetSize()))
+        {
+            for (ObjMaterial& material : model.materials)
+            {
+                if (material.name == defined.name)
+                {
+                    material = defined;
+                }
+            }
+        }
+    }
+
+    return model;
+}
@@ -0,0 +1,68 @@
+//
+// ObjParser.h - Parallel Wavefront OBJ and MTL reader
+//
+
+#pragma once
+
+#include "MeshData.h"
+#include "WorkerPool.h"
+
+namespace DX
+{
+    struct ObjMaterial
+    {
+        std::string     name;
+        float           ambient[3];         // Ka
+        float           diffuse[3];         // Kd
+        float           specular[3];        // Ks
+        float           specularExponent;   // Ns
+        float           opacity;            // d, or 1 - Tr
+        std::string     diffuseMap;         // map_Kd, relative to the MTL file.
+        std::string     normalMap;          // bump or map_bump
+    };
+
+    // A run of triangles drawn with one material, in file order.
+    struct ObjSubset
+    {
+        uint32_t        indexOffset;
+        uint32_t        indexCount;
+        int32_t         material;           // Into ObjModel::materials; -1 before the first usemtl.
+    };
+
+    struct ObjModel
+    {
+        MeshData                    mesh;
+        std::vector<ObjMaterial>    materials;              // Every name usemtl gives, in order of first use.
+        std::vector<ObjSubset>      subsets;
+        std::vector<std::string>    materialLibraries;      // As mtllib gives them.
+    };
+
+    struct ObjParseStatistics
+    {
+        size_t      bytes;
+        uint32_t    chunks;
+        double      countSeconds;       // Finding how many elements each chunk defines.
+        double      parseSeconds;       // Numbers, face corners and per-chunk vertex sharing.
+        double      mergeSeconds;       // Sharing vertices across chunks, in file order.
+        double      buildSeconds;       // Vertices and indices of the mesh.
+        double      totalSeconds;
+    };
+
+    // Splits the text into line-aligned chunks, parses them on the pool and merges the results.
+    // The mesh is exactly what a line by line reader produces: polygons fanned into triangles
+    // and vertices shared wherever position, normal and texture coordinate indices all match,
+    // numbered in order of first use. Throws std::runtime_error naming the line of an invalid
+    // position index. A null pool parses on the calling thread.
+    ObjModel ParseObj(const char* text, size_t size, WorkerPool* workers, ObjParseStatistics* statistics = nullptr);
+
+    std::vector<ObjMaterial> ParseMtl(const char* text, size_t size);
+
+    // Maps the file, parses it and fills in the materials from every library it names, read
+    // from the same directory. Materials no library defines keep ParseObj's defaults: white,
+    // opaque and untextured. Throws std::runtime_error if the OBJ file cannot be read.
+    ObjModel LoadObjModel(const std::string& path, WorkerPool* workers = nullptr, ObjParseStatistics* statistics = nullptr);
+
+    // Reads a decimal number as strtof would, correctly rounded, and moves cursor past it.
+    // Returns false, leaving cursor alone, if there is no number at cursor.
+    bool ParseObjFloat(const char*& cursor, const char* end, float& value);
+}
@@ -0,0 +1,90 @@
+//
+// Platform.h - Operating system services used by the game loop: window and event source,
+//              clock, threads and debug output
+//
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+
+namespace DX
+{
+#if defined(_WIN32)
+    typedef HWND NativeWindowHandle;
+#else
+    typedef void* NativeWindowHandle;
+#endif
+
+    // One-time process setup and teardown (COM, CPU feature checks). Initialize returns false
+    // if the game cannot run on this machine.
+    bool InitializePlatform();
+    void ShutdownPlatform();
+
+    // Monotonic high resolution clock, QueryPerformanceCounter on Windows and CLOCK_MONOTONIC
+    // elsewhere. The frequency is constant for the life of the process.
+    uint64_t GetPerformanceCounter();
+    uint64_t GetPerformanceFrequency();
+
+    // User plus kernel time consumed by all threads of the process so far.
+    double GetProcessCpuSeconds();
+
+    // Names the calling thread for debuggers and profilers. Linux truncates names to 15 characters.
+    void SetCurrentThreadName(const char* name);
+
+    // Debugger output on Windows, stderr elsewhere.
+    void OutputDebugMessage(const char* message);
+
+    // Receives what happens to the window. Implemented by the game.
+    interface IPlatformEventHandler
+    {
+        virtual void OnActivated() = 0;
+        virtual void OnDeactivated() = 0;
+        virtual void OnSuspending() = 0;
+        virtual void OnResuming() = 0;
+        virtual void OnWindowSizeChanged(int width, int height) = 0;
+        virtual void OnInput() = 0;
+    };
+
+    struct PlatformWindowDesc
+    {
+        const char* title;
+        int         width;          // Client area size.
+        int         height;
+        int         minWidth;       // Smallest client area the user may resize to.
+        int         minHeight;
+    };
+
+    // The game's window and the source of its events. The Win32 window is a regular top-level
+    // window; the Linux one is headless (no X11 or Wayland) and turns signals into events:
+    // SIGINT and SIGTERM close it, SIGTSTP suspends and stops the process, SIGCONT resumes.
+    // SIGUSR1 and SIGUSR2 suspend and resume without stopping the process.
+    interface IPlatformWindow
+    {
+        virtual ~IPlatformWindow() {}
+
+        // Null for headless windows.
+        virtual NativeWindowHandle GetNativeHandle() const = 0;
+        virtual void GetClientSize(int& width, int& height) const = 0;
+
+        // Events go to this handler from the next ProcessEvents on. Pass null to detach.
+        virtual void SetEventHandler(IPlatformEventHandler* handler) = 0;
+
+        // Dispatches every pending event without blocking. Returns false once the window has
+        // been closed and the game should exit.
+        virtual bool ProcessEvents() = 0;
+
+        // Blocks until an event is pending or timeoutSeconds have passed, without using the
+        // CPU. A negative timeout waits for an event indefinitely. Follow with ProcessEvents.
+        virtual void WaitForEvents(double timeoutSeconds) = 0;
+
+        // Asks the window to close; ProcessEvents returns false afterwards.
+        virtual void Close() = 0;
+
+        // Exit code for the process once the window has closed.
+        virtual int GetExitCode() const = 0;
+    };
+
+    // Returns null if the window could not be created.
+    std::unique_ptr<IPlatformWindow> CreatePlatformWindow(const PlatformWindowDesc& desc);
+}
@@ -0,0 +1,299 @@
+//
+// PlatformLinux.cpp - Platform services and a headless window on Linux
+//
+
+#include "pch.h"
+#include "Platform.h"
+
+#if !defined(_WIN32)
+
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    const int c_handledSignals[] = { SIGINT, SIGTERM, SIGTSTP, SIGCONT, SIGUSR1, SIGUSR2 };
+
+    // The handled signals stay blocked on every thread, so none of them can interrupt a worker
+    // or the main thread halfway through a frame. The main thread takes them synchronously in
+    // HeadlessWindow::ProcessEvents, or through OnSignal while WaitForEvents unblocks them for
+    // the length of its ppoll. The flags are therefore only ever touched by the main thread.
+    volatile sig_atomic_t s_closeRequested;
+    volatile sig_atomic_t s_stopRequested;
+    volatile sig_atomic_t s_pauseRequested;
+    volatile sig_atomic_t s_unpauseRequested;
+
+    sigset_t GetHandledSignals()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        for (int signal : c_handledSignals)
+        {
+            sigaddset(&signals, signal);
+        }
+        return signals;
+    }
+
+    // Only stores flags: no library calls, so errno is left alone.
+    extern "C" void OnSignal(int signal)
+    {
+        switch (signal)
+        {
+        case SIGINT:
+        case SIGTERM:
+            s_closeRequested = 1;
+            break;
+
+        case SIGTSTP:
+            s_stopRequested = 1;
+            break;
+
+        case SIGCONT:
+            // Nothing to do beyond waking the loop.
+            break;
+
+        case SIGUSR1:
+            s_pauseRequested = 1;
+            break;
+
+        case SIGUSR2:
+            s_unpauseRequested = 1;
+            break;
+        }
+    }
+
+    // A window without a display. There is nothing to draw into, so the game renders into its
+    // headless command sink; the size is fixed at creation. Ctrl+Z suspends the game before
+    // the process stops and resumes it when continued, like minimizing a Win32 window;
+    // SIGUSR1/SIGUSR2 do the same while leaving the process running.
+    class HeadlessWindow : public DX::IPlatformWindow
+    {
+    public:
+        explicit HeadlessWindow(const DX::PlatformWindowDesc& desc) :
+            m_handler(nullptr),
+            m_width(desc.width),
+            m_height(desc.height),
+            m_activated(false),
+            m_paused(false),
+            m_closed(false),
+            m_previousActions{}
+        {
+            s_closeRequested = 0;
+            s_stopRequested = 0;
+            s_pauseRequested = 0;
+            s_unpauseRequested = 0;
+
+            // InitializePlatform has already blocked them for every thread it preceded; this
+            // covers a window created without it.
+            sigset_t signals = GetHandledSignals();
+            pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+            struct sigaction action = {};
+            action.sa_handler = OnSignal;
+            sigemptyset(&action.sa_mask);
+            for (size_t i = 0; i < _countof(c_handledSignals); ++i)
+            {
+                sigaction(c_handledSignals[i], &action, &m_previousActions[i]);
+            }
+        }
+
+        virtual ~HeadlessWindow()
+        {
+            for (size_t i = 0; i < _countof(c_handledSignals); ++i)
+            {
+                sigaction(c_handledSignals[i], &m_previousActions[i], nullptr);
+            }
+        }
+
+        virtual DX::NativeWindowHandle GetNativeHandle() const override
+        {
+            return nullptr;
+        }
+
+        virtual void GetClientSize(int& width, int& height) const override
+        {
+            width = m_width;
+            height = m_height;
+        }
+
+        virtual void SetEventHandler(DX::IPlatformEventHandler* handler) override
+        {
+            m_handler = handler;
+        }
+
+        virtual bool ProcessEvents() override
+        {
+            TakePendingSignals();
+
+            if (m_closed || s_closeRequested)
+            {
+                m_closed = true;
+                return false;
+            }
+
+            // A headless window counts as focused from the start.
+            if (!m_activated && m_handler)
+            {
+                m_activated = true;
+                m_handler->OnActivated();
+            }
+
+            if (s_pauseRequested)
+            {
+                s_pauseRequested = 0;
+                SetPaused(true);
+            }
+
+            if (s_stopRequested)
+            {
+                s_stopRequested = 0;
+
+                bool wasPaused = m_paused;
+                SetPaused(true);
+
+                // Stop for real now that the game has had its chance; SIGCONT resumes here.
+                fflush(stdout);
+                fflush(stderr);
+                raise(SIGSTOP);
+
+                if (!wasPaused)
+                {
+                    s_unpauseRequested = 1;
+                }
+            }
+
+            if (s_unpauseRequested)
+            {
+                s_unpauseRequested = 0;
+                SetPaused(false);
+            }
+
+            return true;
+        }
+
+        virtual void WaitForEvents(double timeoutSeconds) override
+        {
+            timespec timeout;
+            timespec* timeoutPointer = nullptr;
+            if (timeoutSeconds >= 0.0)
+            {
+                double whole = floor(timeoutSeconds);
+                timeout.tv_sec = static_cast<time_t>(whole);
+                timeout.tv_nsec = static_cast<long>((timeoutSeconds - whole) * 1e9);
+                timeoutPointer = &timeout;
+            }
+
+            // Unblocking the signals only for the wait closes the gap between the flags being
+            // checked and the wait starting: one that arrived in between, or is still pending,
+            // interrupts it at once. OnSignal then runs here, on the main thread.
+            sigset_t waitMask;
+            pthread_sigmask(SIG_BLOCK, nullptr, &waitMask);
+            for (int signal : c_handledSignals)
+            {
+                sigdelset(&waitMask, signal);
+            }
+            ppoll(nullptr, 0, timeoutPointer, &waitMask);
+        }
+
+        virtual void Close() override
+        {
+            m_closed = true;
+        }
+
+        virtual int GetExitCode() const override
+        {
+            return 0;
+        }
+
+    private:
+        void SetPaused(bool paused)
+        {
+            if (paused == m_paused)
+                return;
+
+            m_paused = paused;
+            if (m_handler)
+            {
+                if (paused)
+                    m_handler->OnSuspending();
+                else
+                    m_handler->OnResuming();
+            }
+        }
+
+        // Takes the signals that arrived while blocked, without running any handler.
+        void TakePendingSignals()
+        {
+            sigset_t signals = GetHandledSignals();
+            timespec immediately = {};
+            int signal;
+            while ((signal = sigtimedwait(&signals, nullptr, &immediately)) > 0)
+            {
+                OnSignal(signal);
+            }
+        }
+
+        DX::IPlatformEventHandler*  m_handler;
+        int                         m_width;
+        int                         m_height;
+        bool                        m_activated;
+        bool                        m_paused;
+        bool                        m_closed;
+
+        struct sigaction            m_previousActions[_countof(c_handledSignals)];
+    };
+}
+
+// Runs before the game starts any thread, so every thread inherits the blocked signals.
+bool DX::InitializePlatform()
+{
+    sigset_t signals = GetHandledSignals();
+    return pthread_sigmask(SIG_BLOCK, &signals, nullptr) == 0;
+}
+
+void DX::ShutdownPlatform()
+{
+}
+
+uint64_t DX::GetPerformanceCounter()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+uint64_t DX::GetPerformanceFrequency()
+{
+    return 1000000000ull;
+}
+
+double DX::GetProcessCpuSeconds()
+{
+    timespec used;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &used);
+    return static_cast<double>(used.tv_sec) + static_cast<double>(used.tv_nsec) * 1e-9;
+}
+
+void DX::SetCurrentThreadName(const char* name)
+{
+    // The kernel limit is 16 bytes including the terminator; longer names are rejected outright.
+    char truncated[16] = {};
+    strncpy(truncated, name, sizeof(truncated) - 1);
+    pthread_setname_np(pthread_self(), truncated);
+}
+
+void DX::OutputDebugMessage(const char* message)
+{
+    fputs(message, stderr);
+}
+
+std::unique_ptr<DX::IPlatformWindow> DX::CreatePlatformWindow(const PlatformWindowDesc& desc)
+{
+    return std::unique_ptr<IPlatformWindow>(new HeadlessWindow(desc));
+}
+
+#endif
@@ -0,0 +1,445 @@
+//
+// PlatformWin32.cpp - Platform services and the top-level window on Windows
+//
+
+#include "pch.h"
+#include "Platform.h"
+
+#if defined(_WIN32)
+
+#include <string>
+
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    const wchar_t* c_windowClassName = L"D3DFromWizardWindowClass";
+
+    typedef HRESULT (WINAPI *SetThreadDescriptionFunction)(HANDLE, PCWSTR);
+
+    std::wstring Widen(const char* text)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, nullptr, 0);
+        std::wstring result(length > 0 ? length - 1 : 0, L'\0');
+        if (length > 1)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, text, -1, &result[0], length);
+        }
+        return result;
+    }
+
+    class Win32Window : public DX::IPlatformWindow
+    {
+    public:
+        explicit Win32Window(const DX::PlatformWindowDesc& desc) :
+            m_hwnd(nullptr),
+            m_timer(nullptr),
+            m_handler(nullptr),
+            m_desc(desc),
+            m_inSizeMove(false),
+            m_inSuspend(false),
+            m_minimized(false),
+            m_fullscreen(false),
+            m_closed(false),
+            m_exitCode(0)
+        {
+            // TODO: Set m_fullscreen to true if defaulting to fullscreen.
+
+            // Bounds WaitForEvents. High resolution timers exist from Windows 10 1803; older
+            // systems get a regular one, good to the scheduler tick.
+            m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            if (!m_timer)
+            {
+                m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+            }
+        }
+
+        virtual ~Win32Window()
+        {
+            if (m_hwnd)
+            {
+                SetWindowLongPtr(m_hwnd, GWLP_USERDATA, 0);
+                DestroyWindow(m_hwnd);
+            }
+
+            if (m_timer)
+            {
+                CloseHandle(m_timer);
+            }
+        }
+
+        bool Create()
+        {
+            HINSTANCE instance = GetModuleHandle(nullptr);
+
+            // Register class
+            WNDCLASSEX wcex;
+            wcex.cbSize = sizeof(WNDCLASSEX);
+            wcex.style = CS_HREDRAW | CS_VREDRAW;
+            wcex.lpfnWndProc = WndProc;
+            wcex.cbClsExtra = 0;
+            wcex.cbWndExtra = 0;
+            wcex.hInstance = instance;
+            wcex.hIcon = LoadIcon(instance, L"IDI_ICON");
+            wcex.hCursor = LoadCursor(nullptr, IDC_ARROW);
+            wcex.hbrBackground = (HBRUSH) (COLOR_WINDOW + 1);
+            wcex.lpszMenuName = nullptr;
+            wcex.lpszClassName = c_windowClassName;
+            wcex.hIconSm = LoadIcon(wcex.hInstance, L"IDI_ICON");
+            if (!RegisterClassEx(&wcex) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+                return false;
+
+            // Create window
+            RECT rc;
+            rc.top = 0;
+            rc.left = 0;
+            rc.right = static_cast<LONG>(m_desc.width);
+            rc.bottom = static_cast<LONG>(m_desc.height);
+
+            AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
+
+            m_hwnd = CreateWindowEx(0, c_windowClassName, Widen(m_desc.title).c_str(), WS_OVERLAPPEDWINDOW,
+                CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr, nullptr, instance,
+                nullptr);
+            // TODO: Change to CreateWindowEx(WS_EX_TOPMOST, c_windowClassName, title, WS_POPUP,
+            // to default to fullscreen.
+
+            if (!m_hwnd)
+                return false;
+
+            ShowWindow(m_hwnd, SW_SHOWDEFAULT);
+            // TODO: Change SW_SHOWDEFAULT to SW_SHOWMAXIMIZED to default to fullscreen.
+
+            // Messages sent while the window was being shown are not forwarded; the game has
+            // not been initialized yet.
+            SetWindowLongPtr(m_hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+            return true;
+        }
+
+        virtual DX::NativeWindowHandle GetNativeHandle() const override
+        {
+            return m_hwnd;
+        }
+
+        virtual void GetClientSize(int& width, int& height) const override
+        {
+            RECT rc;
+            GetClientRect(m_hwnd, &rc);
+            width = rc.right - rc.left;
+            height = rc.bottom - rc.top;
+        }
+
+        virtual void SetEventHandler(DX::IPlatformEventHandler* handler) override
+        {
+            m_handler = handler;
+        }
+
+        virtual bool ProcessEvents() override
+        {
+            MSG msg = { 0 };
+            while (!m_closed && PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                if (msg.message == WM_QUIT)
+                {
+                    m_closed = true;
+                    m_exitCode = static_cast<int>(msg.wParam);
+                    break;
+                }
+
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+            return !m_closed;
+        }
+
+        virtual void WaitForEvents(double timeoutSeconds) override
+        {
+            if (timeoutSeconds < 0.0)
+            {
+                MsgWaitForMultipleObjectsEx(0, nullptr, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                return;
+            }
+
+            LARGE_INTEGER due;
+            due.QuadPart = -static_cast<LONGLONG>(timeoutSeconds * 1e7);
+            if (m_timer && SetWaitableTimer(m_timer, &due, 0, nullptr, nullptr, FALSE))
+            {
+                MsgWaitForMultipleObjectsEx(1, &m_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                CancelWaitableTimer(m_timer);
+            }
+            else
+            {
+                MsgWaitForMultipleObjectsEx(0, nullptr, static_cast<DWORD>(timeoutSeconds * 1000.0), QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            }
+        }
+
+        virtual void Close() override
+        {
+            PostQuitMessage(0);
+        }
+
+        virtual int GetExitCode() const override
+        {
+            return m_exitCode;
+        }
+
+    private:
+        static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+        {
+            auto window = reinterpret_cast<Win32Window*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+            if (window)
+            {
+                LRESULT result = 0;
+                if (window->HandleMessage(message, wParam, lParam, result))
+                {
+                    return result;
+                }
+            }
+
+            return DefWindowProc(hWnd, message, wParam, lParam);
+        }
+
+        // Returns true if the message has been fully handled and result should be returned.
+        bool HandleMessage(UINT message, WPARAM wParam, LPARAM lParam, LRESULT& result)
+        {
+            PAINTSTRUCT ps;
+            HDC hdc;
+
+            auto game = m_handler;
+
+            switch (message)
+            {
+            case WM_PAINT:
+                hdc = BeginPaint(m_hwnd, &ps);
+                EndPaint(m_hwnd, &ps);
+                break;
+
+            case WM_SIZE:
+                if (wParam == SIZE_MINIMIZED)
+                {
+                    if (!m_minimized)
+                    {
+                        m_minimized = true;
+                        if (!m_inSuspend && game)
+                            game->OnSuspending();
+                        m_inSuspend = true;
+                    }
+                }
+                else if (m_minimized)
+                {
+                    m_minimized = false;
+                    if (m_inSuspend && game)
+                        game->OnResuming();
+                    m_inSuspend = false;
+                }
+                else if (!m_inSizeMove && game)
+                {
+                    game->OnWindowSizeChanged(LOWORD(lParam), HIWORD(lParam));
+                }
+                break;
+
+            case WM_ENTERSIZEMOVE:
+                m_inSizeMove = true;
+                break;
+
+            case WM_EXITSIZEMOVE:
+                m_inSizeMove = false;
+                if (game)
+                {
+                    int width, height;
+                    GetClientSize(width, height);
+
+                    game->OnWindowSizeChanged(width, height);
+                }
+                break;
+
+            case WM_GETMINMAXINFO:
+                {
+                    auto info = reinterpret_cast<MINMAXINFO*>(lParam);
+                    info->ptMinTrackSize.x = m_desc.minWidth;
+                    info->ptMinTrackSize.y = m_desc.minHeight;
+                }
+                break;
+
+            case WM_ACTIVATEAPP:
+                if (game)
+                {
+                    if (wParam)
+                    {
+                        game->OnActivated();
+                    }
+                    else
+                    {
+                        game->OnDeactivated();
+                    }
+                }
+                break;
+
+            case WM_POWERBROADCAST:
+                switch (wParam)
+                {
+                case PBT_APMQUERYSUSPEND:
+                    if (!m_inSuspend && game)
+                        game->OnSuspending();
+                    m_inSuspend = true;
+                    result = TRUE;
+                    return true;
+
+                case PBT_APMRESUMESUSPEND:
+                    if (!m_minimized)
+                    {
+                        if (m_inSuspend && game)
+                            game->OnResuming();
+                        m_inSuspend = false;
+                    }
+                    result = TRUE;
+                    return true;
+                }
+                break;
+
+            case WM_DESTROY:
+                PostQuitMessage(0);
+                break;
+
+            case WM_SYSKEYDOWN:
+                if (wParam == VK_RETURN && (lParam & 0x60000000) == 0x20000000)
+                {
+                    // Implements the classic ALT+ENTER fullscreen toggle
+                    if (m_fullscreen)
+                    {
+                        SetWindowLongPtr(m_hwnd, GWL_STYLE, WS_OVERLAPPEDWINDOW);
+                        SetWindowLongPtr(m_hwnd, GWL_EXSTYLE, 0);
+
+                        ShowWindow(m_hwnd, SW_SHOWNORMAL);
+
+                        SetWindowPos(m_hwnd, HWND_TOP, 0, 0, m_desc.width, m_desc.height, SWP_NOMOVE | SWP_NOZORDER | SWP_FRAMECHANGED);
+                    }
+                    else
+                    {
+                        SetWindowLongPtr(m_hwnd, GWL_STYLE, 0);
+                        SetWindowLongPtr(m_hwnd, GWL_EXSTYLE, WS_EX_TOPMOST);
+
+                        SetWindowPos(m_hwnd, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_FRAMECHANGED);
+
+                        ShowWindow(m_hwnd, SW_SHOWMAXIMIZED);
+                    }
+
+                    m_fullscreen = !m_fullscreen;
+                }
+                break;
+
+            case WM_KEYDOWN:
+            case WM_MOUSEMOVE:
+            case WM_LBUTTONDOWN:
+            case WM_RBUTTONDOWN:
+            case WM_MBUTTONDOWN:
+            case WM_MOUSEWHEEL:
+                if (game)
+                    game->OnInput();
+                break;
+
+            case WM_MENUCHAR:
+                // A menu is active and the user presses a key that does not correspond
+                // to any mnemonic or accelerator key. Ignore so we don't produce an error beep.
+                result = MAKELRESULT(0, MNC_CLOSE);
+                return true;
+            }
+
+            return false;
+        }
+
+        HWND                            m_hwnd;
+        HANDLE                          m_timer;
+        DX::IPlatformEventHandler*      m_handler;
+        DX::PlatformWindowDesc          m_desc;
+        bool                            m_inSizeMove;
+        bool                            m_inSuspend;
+        bool                            m_minimized;
+        bool                            m_fullscreen;
+        bool                            m_closed;
+        int                             m_exitCode;
+    };
+};
+
+bool DX::InitializePlatform()
+{
+    if (!XMVerifyCPUSupport())
+        return false;
+
+    HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
+    if (FAILED(hr))
+        return false;
+
+    return true;
+}
+
+void DX::ShutdownPlatform()
+{
+    CoUninitialize();
+}
+
+uint64_t DX::GetPerformanceCounter()
+{
+    // Cannot fail on Windows XP and later.
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<uint64_t>(counter.QuadPart);
+}
+
+uint64_t DX::GetPerformanceFrequency()
+{
+    static const uint64_t s_frequency = []()
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<uint64_t>(frequency.QuadPart);
+    }();
+    return s_frequency;
+}
+
+double DX::GetProcessCpuSeconds()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0.0;
+    }
+
+    // FILETIME counts 100 ns intervals.
+    ULARGE_INTEGER kernelTime = { kernel.dwLowDateTime, kernel.dwHighDateTime };
+    ULARGE_INTEGER userTime = { user.dwLowDateTime, user.dwHighDateTime };
+    return static_cast<double>(kernelTime.QuadPart + userTime.QuadPart) * 1e-7;
+}
+
+void DX::SetCurrentThreadName(const char* name)
+{
+    // SetThreadDescription exists from Windows 10 1607; look it up so older systems still start.
+    static auto s_setThreadDescription = reinterpret_cast<SetThreadDescriptionFunction>(
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+
+    if (s_setThreadDescription)
+    {
+        s_setThreadDescription(GetCurrentThread(), Widen(name).c_str());
+    }
+}
+
+void DX::OutputDebugMessage(const char* message)
+{
+    OutputDebugStringA(message);
+}
+
+std::unique_ptr<DX::IPlatformWindow> DX::CreatePlatformWindow(const PlatformWindowDesc& desc)
+{
+    auto window = std::make_unique<Win32Window>(desc);
+    if (!window->Create())
+    {
+        return nullptr;
+    }
+    return std::move(window);
+}
+
+#endif
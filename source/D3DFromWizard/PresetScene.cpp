@@ -0,0 +1,275 @@
+//
+// PresetScene.cpp - Grids of instanced sample meshes, culled per cluster and drawn through the
+//                   render queue as runs of visible clusters
+//
+
+#include "pch.h"
+#include "PresetScene.h"
+#include "MeshLoader.h"
+#include "SampleScenes.h"
+
+#include <chrono>
+#include <math.h>
+#include <random>
+
+using namespace DX;
+
+namespace
+{
+    const PresetSceneDesc c_presets[] =
+    {
+        // name                 mesh            cols  rows  spacing  yaw    distance  height
+        { "teapot-grid",        "teapot",       32,   32,   2.5f,    false, 0.9f,     0.35f },
+        { "corvette-instances", "corvette",     16,   16,   2.2f,    true,  0.9f,     0.3f },
+        { "murcielago-hero",    "murcielago",   1,    1,    1.0f,    false, 2.5f,     0.4f },
+    };
+
+    const float c_fovAngleY = 0.785398163f;
+    const uint32_t c_orbitFrames = 600;         // Frames per camera revolution.
+
+    // Runs of visible clusters separated by at most this many culled ones are drawn as one, so
+    // an instance costs a few draws rather than one per gap.
+    const uint32_t c_maxMergedGap = 4;
+
+    inline double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+const PresetSceneDesc* DX::GetPresetScenes(size_t& count)
+{
+    count = _countof(c_presets);
+    return c_presets;
+}
+
+const PresetSceneDesc* DX::FindPresetScene(const std::string& name)
+{
+    for (const auto& preset : c_presets)
+    {
+        if (name == preset.name)
+        {
+            return &preset;
+        }
+    }
+    return nullptr;
+}
+
+std::string DX::GetPresetSceneMeshPath(const PresetSceneDesc& desc, const std::string& assetDirectory)
+{
+    const SampleMesh* sample = FindSampleMesh(desc.mesh);
+    return assetDirectory + "/" + (sample ? sample->path : desc.mesh);
+}
+
+DX::CookedMesh DX::CookPresetSceneMesh(const std::string& path, PresetSceneLoadStatistics* statistics)
+{
+    auto start = std::chrono::steady_clock::now();
+    MeshData source = LoadMesh(path);
+    double loadMilliseconds = ElapsedMilliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    MeshCooker cooker;
+    CookedMesh mesh = cooker.Cook(source);
+
+    if (statistics)
+    {
+        statistics->sourceTriangles = source.GetTriangleCount();
+        statistics->loadMilliseconds = loadMilliseconds;
+        statistics->cookMilliseconds = ElapsedMilliseconds(start);
+    }
+    return mesh;
+}
+
+DX::PresetScene::PresetScene(const PresetSceneDesc& desc, CookedMesh mesh) :
+    m_desc(desc),
+    m_sceneRadius(0.0f),
+    m_bindings{},
+    m_viewProjection{},
+    m_statistics{}
+{
+    SetMesh(std::move(mesh));
+}
+
+void DX::PresetScene::SetMesh(CookedMesh mesh)
+{
+    m_mesh = std::move(mesh);
+    m_meshMemory.Track(MemoryCategory_Meshes, m_mesh.GetMemoryBytes(), "preset scene mesh");
+    BuildClusterIndices();
+    LayOutInstances();
+}
+
+void DX::PresetScene::BuildClusterIndices()
+{
+    const std::vector<Meshlet>& meshlets = m_mesh.meshlets.meshlets;
+    std::vector<uint32_t> all(meshlets.size());
+    m_clusterStarts.resize(meshlets.size() + 1);
+    m_clusterStarts[0] = 0;
+    for (uint32_t i = 0; i < meshlets.size(); ++i)
+    {
+        all[i] = i;
+        m_clusterStarts[i + 1] = m_clusterStarts[i] + meshlets[i].triangleCount * 3;
+    }
+
+    // A new list rather than a cleared one, so a smaller mesh gives its memory back.
+    std::vector<uint32_t> indices;
+    indices.reserve(m_clusterStarts.back());
+    ClusterCuller::BuildCompactedIndices(m_mesh.meshlets, all, indices);
+    m_clusterIndices.swap(indices);
+    m_clusterIndexMemory.Track(MemoryCategory_Meshes,
+        (m_clusterIndices.capacity() + m_clusterStarts.capacity()) * sizeof(uint32_t), "preset scene cluster indices");
+}
+
+void DX::PresetScene::LayOutInstances()
+{
+    // Every instance is normalised to a unit bounding radius so the presets share camera settings.
+    float scale = 1.0f / std::max(m_mesh.boundingRadius, 1e-6f);
+    float pitch = m_desc.spacing;
+    float halfWidth = 0.5f * pitch * (m_desc.columns - 1);
+    float halfDepth = 0.5f * pitch * (m_desc.rows - 1);
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    m_instances.clear();
+    m_instances.reserve(m_desc.columns * m_desc.rows);
+    for (uint32_t row = 0; row < m_desc.rows; ++row)
+    {
+        for (uint32_t column = 0; column < m_desc.columns; ++column)
+        {
+            Instance instance = {};
+            instance.scale = scale;
+            instance.yaw = m_desc.randomYaw ? angle(random) : 0.0f;
+
+            // Place the bounding sphere centre, not the mesh origin, on the grid.
+            float offset[3] = { column * pitch - halfWidth, 0.0f, row * pitch - halfDepth };
+            float c = cosf(instance.yaw);
+            float s = sinf(instance.yaw);
+            const float* center = m_mesh.boundingCenter;
+            instance.position[0] = offset[0] - scale * (center[0] * c + center[2] * s);
+            instance.position[1] = offset[1] - scale * center[1];
+            instance.position[2] = offset[2] - scale * (center[2] * c - center[0] * s);
+            memcpy(instance.center, offset, sizeof(offset));
+            BuildWorldMatrix(instance.scale, instance.yaw, instance.position, instance.world);
+
+            m_instances.push_back(instance);
+        }
+    }
+
+    m_sceneRadius = sqrtf(halfWidth * halfWidth + halfDepth * halfDepth) + 1.0f;
+}
+
+void DX::PresetScene::Render(uint64_t frameIndex, float aspectRatio, float projectionScale, RenderQueue& queue)
+{
+    float orbit = 6.2831853f * (frameIndex % c_orbitFrames) / c_orbitFrames;
+    float distance = m_desc.cameraDistance * m_sceneRadius;
+    // The grid is centred on the origin.
+    const float target[3] = {};
+    float eye[3] =
+    {
+        distance * cosf(orbit),
+        m_desc.cameraHeight * m_sceneRadius,
+        distance * sinf(orbit)
+    };
+
+    float view[4][4];
+    float projection[4][4];
+    BuildLookAtMatrix(eye, target, view);
+    BuildPerspectiveMatrix(c_fovAngleY, aspectRatio, 0.01f, 4.0f * m_sceneRadius + distance, projection);
+    MultiplyMatrices(view, projection, m_viewProjection);
+    Frustum worldFrustum = Frustum::FromViewProjection(m_viewProjection);
+
+    m_culler.ResetStatistics();
+    m_statistics = PresetSceneStatistics{};
+
+    size_t materialCount = std::max<size_t>(m_bindings.materials.size(), 1);
+    size_t pixelShaderCount = std::max<size_t>(m_bindings.pixelShaders.size(), 1);
+
+    for (const auto& instance : m_instances)
+    {
+        const float* center = instance.center;
+        if (!worldFrustum.IntersectsSphere(center, instance.scale * m_mesh.boundingRadius))
+        {
+            continue;
+        }
+
+        float dx = center[0] - eye[0];
+        float dy = center[1] - eye[1];
+        float dz = center[2] - eye[2];
+        float depth = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        // Errors are in object space, so compare at the equivalent object-space distance.
+        size_t lod = SelectLod(m_mesh, depth / instance.scale, projectionScale);
+        const MeshLod& level = m_mesh.lods[lod];
+
+        // Test the clusters in object space: transform the frustum and camera into it once.
+        float worldViewProjection[4][4];
+        MultiplyMatrices(instance.world, m_viewProjection, worldViewProjection);
+        Frustum objectFrustum = Frustum::FromViewProjection(worldViewProjection);
+
+        float c = cosf(instance.yaw);
+        float s = sinf(instance.yaw);
+        float relative[3] =
+        {
+            (eye[0] - instance.position[0]) / instance.scale,
+            (eye[1] - instance.position[1]) / instance.scale,
+            (eye[2] - instance.position[2]) / instance.scale
+        };
+        float objectEye[3] =
+        {
+            relative[0] * c - relative[2] * s,
+            relative[1],
+            relative[0] * s + relative[2] * c
+        };
+
+        m_visibleMeshlets.clear();
+        m_culler.Cull(m_mesh.meshlets, level.meshletOffset, level.meshletCount, objectFrustum, objectEye, m_visibleMeshlets);
+        if (m_visibleMeshlets.empty())
+        {
+            continue;
+        }
+
+        m_statistics.visibleInstances++;
+        m_statistics.lodTriangles += level.indexCount / 3;
+
+        uint32_t index = static_cast<uint32_t>(&instance - m_instances.data());
+
+        DrawPacket packet = {};
+        packet.state = m_bindings.state;
+        packet.state.pixelShader = m_bindings.pixelShaders.empty() ? 0 : m_bindings.pixelShaders[(index / materialCount) % pixelShaderCount];
+        packet.material = m_bindings.materials.empty() ? 0 : m_bindings.materials[index % materialCount];
+        packet.vertexBuffer = m_bindings.vertexBuffer;
+        packet.indexBuffer = m_bindings.indexBuffer;
+        packet.vertexStride = sizeof(MeshVertex);
+        packet.depth = depth;
+        packet.userData = index;
+
+        // Culling keeps meshlet order, so neighbouring visible clusters are adjacent in the
+        // cluster index list.
+        for (size_t run = 0; run < m_visibleMeshlets.size(); )
+        {
+            uint32_t first = m_visibleMeshlets[run];
+            uint32_t last = first;
+            for (++run; run < m_visibleMeshlets.size() && m_visibleMeshlets[run] - last <= c_maxMergedGap + 1; ++run)
+            {
+                last = m_visibleMeshlets[run];
+            }
+
+            packet.startIndex = m_clusterStarts[first];
+            packet.indexCount = m_clusterStarts[last + 1] - m_clusterStarts[first];
+            queue.Add(packet);
+
+            m_statistics.drawnTriangles += packet.indexCount / 3;
+            m_statistics.draws++;
+        }
+    }
+
+    const ClusterCullStatistics& cull = m_culler.GetStatistics();
+    m_statistics.visibleClusters = cull.visibleClusters;
+    m_statistics.visibleTriangles = cull.visibleTriangles;
+}
+
+void DX::PresetScene::GetInstanceMatrices(uint32_t instance, float world[4][4], float worldViewProjection[4][4]) const
+{
+    memcpy(world, m_instances[instance].world, sizeof(float) * 16);
+    MultiplyMatrices(m_instances[instance].world, m_viewProjection, worldViewProjection);
+}
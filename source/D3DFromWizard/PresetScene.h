@@ -0,0 +1,133 @@
+//
+// PresetScene.h - Grids of instanced sample meshes, culled per cluster and drawn through the
+//                 render queue as runs of visible clusters
+//
+
+#pragma once
+
+#include "ClusterCulling.h"
+#include "MemoryTracker.h"
+#include "MeshCooker.h"
+#include "RenderQueue.h"
+
+namespace DX
+{
+    struct PresetSceneDesc
+    {
+        const char* name;
+        const char* mesh;               // A sample mesh name (see GetSampleMeshes), or a path in the asset directory.
+        uint32_t    columns;            // Instances are laid out on a columns x rows grid.
+        uint32_t    rows;
+        float       spacing;            // Grid spacing in bounding radii.
+        bool        randomYaw;
+        float       cameraDistance;     // Orbit radius in scene radii.
+        float       cameraHeight;       // Orbit height in scene radii.
+    };
+
+    // teapot-grid, corvette-instances and murcielago-hero.
+    const PresetSceneDesc* GetPresetScenes(size_t& count);
+    const PresetSceneDesc* FindPresetScene(const std::string& name);
+
+    // The file a preset's mesh is read from.
+    std::string GetPresetSceneMeshPath(const PresetSceneDesc& desc, const std::string& assetDirectory);
+
+    struct PresetSceneLoadStatistics
+    {
+        size_t  sourceTriangles;
+        double  loadMilliseconds;
+        double  cookMilliseconds;
+    };
+
+    // Loads a mesh file and cooks it with level of detail chains and meshlets. Throws
+    // std::runtime_error if the file cannot be read.
+    CookedMesh CookPresetSceneMesh(const std::string& path, PresetSceneLoadStatistics* statistics = nullptr);
+
+    // What the sink has registered for the scene. Instances take materials in turn, and move
+    // on to the next pixel shader after every material has been used once.
+    struct PresetSceneBindings
+    {
+        PipelineState               state;          // Everything but the pixel shader.
+        std::vector<StateHandle>    pixelShaders;
+        std::vector<StateHandle>    materials;
+        StateHandle                 vertexBuffer;   // GetMesh().vertices.
+        StateHandle                 indexBuffer;    // GetClusterIndices().
+    };
+
+    // Per frame, after culling.
+    struct PresetSceneStatistics
+    {
+        uint32_t    visibleInstances;
+        uint32_t    visibleClusters;
+        uint32_t    visibleTriangles;   // In the clusters that survived culling.
+        uint32_t    drawnTriangles;     // Those plus the culled clusters merged draws step over.
+        uint32_t    lodTriangles;       // In the levels the visible instances selected, before cluster culling.
+        uint32_t    draws;
+    };
+
+    // A camera orbiting a grid of instances of one cooked mesh. Every frame each instance is
+    // frustum culled, picks its level of detail and has that level's clusters culled. Every
+    // cluster of every level is expanded into one index list once per mesh, in meshlet order,
+    // so the clusters that survive are ranges of that list: each instance queues one draw per
+    // run of visible clusters, and nothing is rebuilt or uploaded per frame. The camera path
+    // depends only on the frame index, so runs are reproducible.
+    class PresetScene
+    {
+    public:
+        PresetScene(const PresetSceneDesc& desc, CookedMesh mesh);
+
+        PresetScene(const PresetScene&) = delete;
+        PresetScene& operator=(const PresetScene&) = delete;
+
+        // Replaces the mesh, laying the instances out again for its bounds. The vertex and
+        // index buffers behind the bindings must be replaced with it.
+        void SetMesh(CookedMesh mesh);
+
+        void SetBindings(const PresetSceneBindings& bindings)   { m_bindings = bindings; }
+
+        // Culls the scene as seen on frameIndex and adds the draws of the visible instances to
+        // queue. DrawPacket::userData is the instance, for GetInstanceMatrices.
+        void Render(uint64_t frameIndex, float aspectRatio, float projectionScale, RenderQueue& queue);
+
+        // The mesh's clusters as one triangle list into GetMesh().vertices, which the draws
+        // index. Changes only with the mesh.
+        const std::vector<uint32_t>& GetClusterIndices() const  { return m_clusterIndices; }
+
+        // The instance's transforms as of the last Render: row vectors, D3D clip space.
+        void GetInstanceMatrices(uint32_t instance, float world[4][4], float worldViewProjection[4][4]) const;
+
+        const PresetSceneDesc& GetDesc() const                  { return m_desc; }
+        const CookedMesh& GetMesh() const                       { return m_mesh; }
+        uint32_t GetInstanceCount() const                       { return static_cast<uint32_t>(m_instances.size()); }
+        const PresetSceneStatistics& GetStatistics() const      { return m_statistics; }
+
+    private:
+        struct Instance
+        {
+            float       world[4][4];
+            float       position[3];
+            float       center[3];      // World-space bounding sphere centre.
+            float       yaw;
+            float       scale;
+        };
+
+        void LayOutInstances();
+        void BuildClusterIndices();
+
+        PresetSceneDesc         m_desc;
+        CookedMesh              m_mesh;
+        TrackedMemory           m_meshMemory;
+        std::vector<Instance>   m_instances;
+        float                   m_sceneRadius;
+        PresetSceneBindings     m_bindings;
+
+        float                   m_viewProjection[4][4];
+        ClusterCuller           m_culler;
+        std::vector<uint32_t>   m_visibleMeshlets;
+
+        // Every meshlet's triangles in meshlet order, and where each one's start, plus the end.
+        std::vector<uint32_t>   m_clusterIndices;
+        std::vector<uint32_t>   m_clusterStarts;
+        TrackedMemory           m_clusterIndexMemory;
+        PresetSceneStatistics   m_statistics;
+    };
+}
@@ -0,0 +1,253 @@
+//
+// RenderQueue.cpp - Collects draw packets, radix-sorts them by pipeline state and
+//                   filters redundant state changes before they reach the context
+//
+
+#include "pch.h"
+#include "RenderQueue.h"
+
+#include <string.h>
+
+namespace
+{
+    // Sort key layout, most significant first. Shader changes are the most expensive
+    // so they get the highest bits; depth only orders packets that share everything else.
+    //   layer:4 | program:10 | fixed function:10 | material:12 | vertex buffer:12 | depth:16
+    const int c_layerShift          = 60;
+    const int c_programShift        = 50;
+    const int c_fixedFunctionShift  = 40;
+    const int c_materialShift       = 28;
+    const int c_vertexBufferShift   = 16;
+
+    const int c_radixBits           = 8;
+    const int c_radixBuckets        = 1 << c_radixBits;
+    const int c_radixPasses         = 64 / c_radixBits;
+
+    // Non-negative IEEE floats order the same as their bit patterns, so the top
+    // 16 bits make a cheap monotonic depth bucket.
+    inline uint64_t QuantizeDepth(float depth)
+    {
+        if (!(depth > 0.0f))
+        {
+            return 0;
+        }
+
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 16;
+    }
+
+    // Ids are only an ordering hint; wrapping them costs batching, never correctness,
+    // because the filter compares the real handles.
+    inline uint64_t Field(uint64_t value, int bits, int shift)
+    {
+        return (value & ((uint64_t(1) << bits) - 1)) << shift;
+    }
+};
+
+DX::RenderQueue::RenderQueue() :
+    m_boundValid(false),
+    m_statistics{}
+{
+}
+
+void DX::RenderQueue::Add(const DrawPacket& packet)
+{
+    m_keys.push_back(BuildSortKey(packet));
+    m_packets.push_back(packet);
+}
+
+void DX::RenderQueue::Clear()
+{
+    m_packets.clear();
+    m_keys.clear();
+}
+
+void DX::RenderQueue::InvalidateState()
+{
+    m_boundValid = false;
+}
+
+uint64_t DX::RenderQueue::BuildSortKey(const DrawPacket& packet)
+{
+    return Field(packet.layer, 4, c_layerShift)
+        | Field(InternProgram(packet.state), 10, c_programShift)
+        | Field(InternFixedFunction(packet.state), 10, c_fixedFunctionShift)
+        | Field(packet.material, 12, c_materialShift)
+        | Field(packet.vertexBuffer, 12, c_vertexBufferShift)
+        | QuantizeDepth(packet.depth);
+}
+
+// The input layout is grouped with the shaders because it is bound to the vertex shader signature.
+uint16_t DX::RenderQueue::InternProgram(const PipelineState& state)
+{
+    uint64_t key = uint64_t(state.vertexShader)
+        | (uint64_t(state.pixelShader) << 16)
+        | (uint64_t(state.inputLayout) << 32);
+
+    auto it = m_programIds.find(key);
+    if (it != m_programIds.end())
+    {
+        return it->second;
+    }
+
+    uint16_t id = static_cast<uint16_t>(m_programIds.size());
+    m_programIds.emplace(key, id);
+    return id;
+}
+
+uint16_t DX::RenderQueue::InternFixedFunction(const PipelineState& state)
+{
+    uint64_t key = uint64_t(state.blendState)
+        | (uint64_t(state.depthStencilState) << 16)
+        | (uint64_t(state.rasterizerState) << 32)
+        | (uint64_t(state.topology) << 48);
+
+    auto it = m_fixedFunctionIds.find(key);
+    if (it != m_fixedFunctionIds.end())
+    {
+        return it->second;
+    }
+
+    uint16_t id = static_cast<uint16_t>(m_fixedFunctionIds.size());
+    m_fixedFunctionIds.emplace(key, id);
+    return id;
+}
+
+// LSD radix sort of (key, index) pairs, 8 bits per pass. All histograms are built in a
+// single sweep and passes where every key shares the same digit are skipped, which in
+// practice removes most of the upper layer/program passes.
+void DX::RenderQueue::SortPackets()
+{
+    const uint32_t count = static_cast<uint32_t>(m_keys.size());
+
+    m_order.resize(count);
+    m_orderScratch.resize(count);
+    m_keyScratch.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_order[i] = i;
+    }
+
+    uint32_t histograms[c_radixPasses][c_radixBuckets] = {};
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t key = m_keys[i];
+        for (int pass = 0; pass < c_radixPasses; ++pass)
+        {
+            histograms[pass][(key >> (pass * c_radixBits)) & (c_radixBuckets - 1)]++;
+        }
+    }
+
+    uint64_t* keys = m_keys.data();
+    uint64_t* keysOut = m_keyScratch.data();
+    uint32_t* order = m_order.data();
+    uint32_t* orderOut = m_orderScratch.data();
+
+    for (int pass = 0; pass < c_radixPasses; ++pass)
+    {
+        uint32_t* histogram = histograms[pass];
+        int shift = pass * c_radixBits;
+
+        // Every key has the same digit here, the pass would be a plain copy.
+        if (histogram[(keys[0] >> shift) & (c_radixBuckets - 1)] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < c_radixBuckets; ++bucket)
+        {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t destination = histogram[(keys[i] >> shift) & (c_radixBuckets - 1)]++;
+            keysOut[destination] = keys[i];
+            orderOut[destination] = order[i];
+        }
+
+        std::swap(keys, keysOut);
+        std::swap(order, orderOut);
+    }
+
+    // The sorted order may have ended up in the scratch buffer.
+    if (order != m_order.data())
+    {
+        m_order.swap(m_orderScratch);
+    }
+}
+
+void DX::RenderQueue::Submit(IRenderCommandSink& sink)
+{
+    memset(&m_statistics, 0, sizeof(m_statistics));
+    m_statistics.packets = static_cast<uint32_t>(m_packets.size());
+
+    if (m_packets.empty())
+    {
+        return;
+    }
+
+    SortPackets();
+
+    if (!m_boundValid)
+    {
+        // Nothing is known about the context, so the first packet binds everything.
+        memset(m_bound, 0xFF, sizeof(m_bound));
+        m_boundValid = true;
+    }
+
+    auto changed = [&](StateSlot slot, uint32_t value) -> bool
+    {
+        if (m_bound[slot] == value)
+        {
+            m_statistics.elided[slot]++;
+            return false;
+        }
+
+        m_bound[slot] = value;
+        m_statistics.issued[slot]++;
+        return true;
+    };
+
+    for (uint32_t index : m_order)
+    {
+        const DrawPacket& packet = m_packets[index];
+        const PipelineState& state = packet.state;
+
+        if (changed(StateSlot_VertexShader, state.vertexShader))
+            sink.SetVertexShader(state.vertexShader);
+        if (changed(StateSlot_PixelShader, state.pixelShader))
+            sink.SetPixelShader(state.pixelShader);
+        if (changed(StateSlot_InputLayout, state.inputLayout))
+            sink.SetInputLayout(state.inputLayout);
+        if (changed(StateSlot_Topology, state.topology))
+            sink.SetPrimitiveTopology(state.topology);
+        if (changed(StateSlot_BlendState, state.blendState))
+            sink.SetBlendState(state.blendState);
+        if (changed(StateSlot_DepthStencilState, state.depthStencilState))
+            sink.SetDepthStencilState(state.depthStencilState);
+        if (changed(StateSlot_RasterizerState, state.rasterizerState))
+            sink.SetRasterizerState(state.rasterizerState);
+        if (changed(StateSlot_Material, packet.material))
+            sink.SetMaterial(packet.material);
+        if (changed(StateSlot_VertexBuffer, packet.vertexBuffer | (uint32_t(packet.vertexStride) << 16)))
+            sink.SetVertexBuffer(packet.vertexBuffer, packet.vertexStride);
+        if (changed(StateSlot_IndexBuffer, packet.indexBuffer))
+            sink.SetIndexBuffer(packet.indexBuffer);
+
+        sink.DrawIndexed(packet);
+    }
+
+    for (int slot = 0; slot < StateSlot_Count; ++slot)
+    {
+        m_statistics.stateChangesIssued += m_statistics.issued[slot];
+        m_statistics.stateChangesElided += m_statistics.elided[slot];
+    }
+
+    Clear();
+}
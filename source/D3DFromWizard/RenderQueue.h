@@ -0,0 +1,140 @@
+//
+// RenderQueue.h - Collects draw packets, radix-sorts them by pipeline state and
+//                 filters redundant state changes before they reach the context
+//
+
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // Handles index the state tables owned by a command sink. Zero always means "nothing bound".
+    typedef uint16_t StateHandle;
+
+    // Bindable pipeline state referenced by a draw packet.
+    struct PipelineState
+    {
+        StateHandle inputLayout;
+        StateHandle vertexShader;
+        StateHandle pixelShader;
+        StateHandle blendState;
+        StateHandle depthStencilState;
+        StateHandle rasterizerState;
+        uint8_t     topology;           // D3D11_PRIMITIVE_TOPOLOGY value
+    };
+
+    // A single indexed draw and everything it needs bound.
+    struct DrawPacket
+    {
+        PipelineState   state;
+        StateHandle     material;       // Constant buffer, shader resources and samplers for the pixel stage.
+        StateHandle     vertexBuffer;
+        StateHandle     indexBuffer;
+        uint16_t        vertexStride;
+        uint8_t         layer;          // Coarse ordering bucket (opaque before transparent etc.), 0-15.
+        float           depth;          // View-space depth used to order packets that share all state.
+        uint32_t        indexCount;
+        uint32_t        startIndex;
+        int32_t         baseVertex;
+        uint32_t        userData;       // Passed through to the sink untouched (e.g. per-object constants slot).
+    };
+
+    // The state categories tracked by the redundancy filter.
+    enum StateSlot
+    {
+        StateSlot_InputLayout,
+        StateSlot_Topology,
+        StateSlot_VertexShader,
+        StateSlot_PixelShader,
+        StateSlot_VertexBuffer,
+        StateSlot_IndexBuffer,
+        StateSlot_Material,
+        StateSlot_BlendState,
+        StateSlot_DepthStencilState,
+        StateSlot_RasterizerState,
+        StateSlot_Count
+    };
+
+    // Receives the filtered command stream. Implemented by each backend; the D3D11 one
+    // translates handles into immediate context calls, a headless one can simply record them.
+    interface IRenderCommandSink
+    {
+        virtual void SetInputLayout(StateHandle inputLayout) = 0;
+        virtual void SetPrimitiveTopology(uint8_t topology) = 0;
+        virtual void SetVertexShader(StateHandle vertexShader) = 0;
+        virtual void SetPixelShader(StateHandle pixelShader) = 0;
+        virtual void SetVertexBuffer(StateHandle vertexBuffer, uint32_t stride) = 0;
+        virtual void SetIndexBuffer(StateHandle indexBuffer) = 0;
+        virtual void SetMaterial(StateHandle material) = 0;
+        virtual void SetBlendState(StateHandle blendState) = 0;
+        virtual void SetDepthStencilState(StateHandle depthStencilState) = 0;
+        virtual void SetRasterizerState(StateHandle rasterizerState) = 0;
+        virtual void DrawIndexed(const DrawPacket& packet) = 0;
+    };
+
+    // Per-frame counters, reset by every Submit.
+    struct RenderQueueStatistics
+    {
+        uint32_t packets;
+        uint32_t stateChangesIssued;
+        uint32_t stateChangesElided;
+        uint32_t issued[StateSlot_Count];
+        uint32_t elided[StateSlot_Count];
+    };
+
+    // Collects draw packets for a frame and submits them in state-sorted order.
+    class RenderQueue
+    {
+    public:
+        RenderQueue();
+
+        // Adds a packet to the current frame.
+        void Add(const DrawPacket& packet);
+
+        // Sorts the collected packets, issues them to the sink with redundant bindings removed and
+        // empties the queue. Statistics for the submitted frame are available afterwards.
+        void Submit(IRenderCommandSink& sink);
+
+        // Discards collected packets without submitting them.
+        void Clear();
+
+        // Forget what the sink has bound; call when something other than the queue touched the context.
+        void InvalidateState();
+
+        size_t GetPacketCount() const                               { return m_packets.size(); }
+        const RenderQueueStatistics& GetFrameStatistics() const     { return m_statistics; }
+
+    private:
+        uint64_t BuildSortKey(const DrawPacket& packet);
+        uint16_t InternProgram(const PipelineState& state);
+        uint16_t InternFixedFunction(const PipelineState& state);
+        void SortPackets();
+
+        template<typename T>
+        using Array = std::vector<T, TrackingAllocator<T, MemoryCategory_RenderQueue>>;
+
+        // Collected packets and their sort keys; m_keys[i] belongs to m_packets[i].
+        Array<DrawPacket>                       m_packets;
+        Array<uint64_t>                         m_keys;
+
+        // Radix sort scratch, kept between frames so a steady-state frame does not allocate.
+        Array<uint32_t>                         m_order;
+        Array<uint32_t>                         m_orderScratch;
+        Array<uint64_t>                         m_keyScratch;
+
+        // Pipeline combinations are interned into small ids so they fit into the sort key.
+        std::unordered_map<uint64_t, uint16_t>  m_programIds;
+        std::unordered_map<uint64_t, uint16_t>  m_fixedFunctionIds;
+
+        // What the sink currently has bound, used to elide redundant calls.
+        uint32_t                                m_bound[StateSlot_Count];
+        bool                                    m_boundValid;
+
+        RenderQueueStatistics                   m_statistics;
+    };
+}
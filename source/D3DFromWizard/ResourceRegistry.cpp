@@ -0,0 +1,389 @@
+//
+// ResourceRegistry.cpp - CPU-side images of device resources, uploaded again after device lost
+//
+
+#include "pch.h"
+#include "ResourceRegistry.h"
+#include "MemoryTracker.h"
+
+#include <chrono>
+
+namespace
+{
+    inline double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    inline uint32_t MipSize(uint32_t size, uint32_t mip)
+    {
+        return std::max<uint32_t>(size >> mip, 1);
+    }
+
+    // 2x2 box filter of 8 bit RGBA.
+    void Downsample(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* target, uint32_t width, uint32_t height)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const uint8_t* row0 = source + size_t(std::min(y * 2, sourceHeight - 1)) * sourceWidth * 4;
+            const uint8_t* row1 = source + size_t(std::min(y * 2 + 1, sourceHeight - 1)) * sourceWidth * 4;
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint32_t x0 = std::min(x * 2, sourceWidth - 1) * 4;
+                uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1) * 4;
+
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    *target++ = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+};
+
+void DX::GenerateMipChain(const uint8_t* image, uint32_t width, uint32_t height, uint32_t mipCount, uint8_t* chain)
+{
+    memcpy(chain, image, size_t(width) * height * 4);
+
+    const uint8_t* source = chain;
+    uint8_t* target = chain + size_t(width) * height * 4;
+    for (uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        uint32_t mipWidth = MipSize(width, mip);
+        uint32_t mipHeight = MipSize(height, mip);
+        Downsample(source, MipSize(width, mip - 1), MipSize(height, mip - 1), target, mipWidth, mipHeight);
+
+        source = target;
+        target += size_t(mipWidth) * mipHeight * 4;
+    }
+}
+
+#pragma region ResourceDesc
+DX::ResourceDesc DX::ResourceDesc::Buffer(uint32_t bindFlags, uint32_t byteWidth)
+{
+    ResourceDesc desc = {};
+    desc.type = ResourceType_Buffer;
+    desc.bindFlags = bindFlags;
+    desc.byteWidth = byteWidth;
+    return desc;
+}
+
+DX::ResourceDesc DX::ResourceDesc::StructuredBuffer(uint32_t bindFlags, uint32_t structureStride, uint32_t elementCount)
+{
+    ResourceDesc desc = Buffer(bindFlags, structureStride * elementCount);
+    desc.structureStride = structureStride;
+    return desc;
+}
+
+DX::ResourceDesc DX::ResourceDesc::Texture2D(uint32_t bindFlags, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t format, uint32_t bytesPerTexel)
+{
+    ResourceDesc desc = {};
+    desc.type = ResourceType_Texture2D;
+    desc.bindFlags = bindFlags;
+    desc.width = width;
+    desc.height = height;
+    desc.mipLevels = mipLevels;
+    desc.format = format;
+    desc.bytesPerTexel = bytesPerTexel;
+    return desc;
+}
+
+DX::ResourceDesc DX::ResourceDesc::Texture2DArray(uint32_t bindFlags, uint32_t width, uint32_t height, uint32_t arraySize, uint32_t mipLevels, uint32_t format, uint32_t bytesPerTexel)
+{
+    ResourceDesc desc = Texture2D(bindFlags, width, height, mipLevels, format, bytesPerTexel);
+    desc.arraySize = arraySize;
+    return desc;
+}
+
+uint32_t DX::ResourceDesc::GetMipCount() const
+{
+    if (mipLevels != 0)
+    {
+        return mipLevels;
+    }
+
+    uint32_t count = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+size_t DX::ResourceDesc::GetUploadBytes() const
+{
+    if (type == ResourceType_Buffer)
+    {
+        return byteWidth;
+    }
+
+    size_t bytes = 0;
+    for (uint32_t mip = 0; mip < GetMipCount(); ++mip)
+    {
+        bytes += size_t(MipSize(width, mip)) * MipSize(height, mip) * bytesPerTexel;
+    }
+    return bytes * GetSliceCount();
+}
+#pragma endregion
+
+#pragma region ResourceRegistry
+DX::ResourceRegistry::ResourceRegistry() :
+    m_liveCount(0),
+    m_imageBytes(0)
+{
+}
+
+DX::ResourceRegistry::~ResourceRegistry()
+{
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.live && !entry.ownedImage.empty())
+        {
+            GetMemoryTracker().Free(MemoryCategory_ResourceImages, entry.ownedImage.size());
+        }
+    }
+}
+
+DX::ResourceHandle DX::ResourceRegistry::Add(const char* name, const ResourceDesc& desc, ResourceEncoding encoding, std::vector<uint8_t> image)
+{
+    Entry entry;
+    entry.name = name;
+    entry.desc = desc;
+    entry.encoding = encoding;
+    entry.ownedImage = std::move(image);
+    entry.image = entry.ownedImage.data();
+    entry.imageSize = entry.ownedImage.size();
+    return Insert(std::move(entry));
+}
+
+DX::ResourceHandle DX::ResourceRegistry::AddMapped(const char* name, const ResourceDesc& desc, ResourceEncoding encoding,
+    std::shared_ptr<MappedFile> file, size_t offset, size_t size)
+{
+    if (!file || offset > file->GetSize() || size > file->GetSize() - offset)
+    {
+        throw std::runtime_error(std::string("resource image outside its mapped file: ") + name);
+    }
+
+    Entry entry;
+    entry.name = name;
+    entry.desc = desc;
+    entry.encoding = encoding;
+    entry.image = file->GetData() + offset;
+    entry.imageSize = size;
+    entry.file = std::move(file);
+    return Insert(std::move(entry));
+}
+
+DX::ResourceHandle DX::ResourceRegistry::Insert(Entry&& entry)
+{
+    size_t expected = entry.desc.GetUploadBytes();
+    if (entry.encoding == ResourceEncoding_GenerateMips)
+    {
+        if (entry.desc.type != ResourceType_Texture2D || entry.desc.bytesPerTexel != 4)
+        {
+            throw std::runtime_error("mips can only be generated for 8 bit RGBA textures: " + entry.name);
+        }
+        expected = size_t(entry.desc.width) * entry.desc.height * 4 * entry.desc.GetSliceCount();
+    }
+
+    if (entry.imageSize != expected)
+    {
+        throw std::runtime_error("resource image size does not match its description: " + entry.name);
+    }
+
+    entry.live = true;
+    entry.uploaded = false;
+
+    if (!entry.ownedImage.empty())
+    {
+        GetMemoryTracker().Allocate(MemoryCategory_ResourceImages, entry.ownedImage.size());
+        m_imageBytes += entry.ownedImage.size();
+    }
+
+    ResourceHandle handle;
+    if (!m_freeHandles.empty())
+    {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_entries[handle - 1] = std::move(entry);
+    }
+    else
+    {
+        m_entries.push_back(std::move(entry));
+        handle = static_cast<ResourceHandle>(m_entries.size());
+    }
+
+    m_liveCount++;
+    return handle;
+}
+
+void DX::ResourceRegistry::Remove(ResourceHandle handle, IResourceDevice* device)
+{
+    Entry& entry = GetEntry(handle);
+
+    if (entry.uploaded && device)
+    {
+        device->ReleaseResource(handle);
+    }
+
+    if (!entry.ownedImage.empty())
+    {
+        GetMemoryTracker().Free(MemoryCategory_ResourceImages, entry.ownedImage.size());
+        m_imageBytes -= entry.ownedImage.size();
+    }
+
+    entry = Entry();
+    entry.live = false;
+    entry.uploaded = false;
+    m_freeHandles.push_back(handle);
+    m_liveCount--;
+}
+
+DX::ResourceUploadStatistics DX::ResourceRegistry::Upload(IResourceDevice& device, WorkerPool* pool)
+{
+    auto start = std::chrono::steady_clock::now();
+    ResourceUploadStatistics statistics = {};
+
+    std::vector<ResourceSubresource> subresources;
+    ResourceHandle next = 1;
+    const ResourceHandle end = static_cast<ResourceHandle>(m_entries.size()) + 1;
+
+    while (next != end)
+    {
+        // Gather a batch of pending resources worth up to c_resourceUploadBatchBytes of
+        // upload data, or a single resource larger than that.
+        m_batch.clear();
+        size_t batchBytes = 0;
+        for (; next != end && (m_batch.empty() || batchBytes < c_resourceUploadBatchBytes); ++next)
+        {
+            const Entry& entry = m_entries[next - 1];
+            if (entry.live && !entry.uploaded)
+            {
+                m_batch.push_back(next);
+                batchBytes += entry.desc.GetUploadBytes();
+            }
+        }
+
+        if (m_batch.empty())
+        {
+            break;
+        }
+
+        if (m_decoded.size() < m_batch.size())
+        {
+            m_decoded.resize(m_batch.size());
+        }
+
+        auto decodeStart = std::chrono::steady_clock::now();
+        auto decode = [this](uint32_t i) { Decode(m_entries[m_batch[i] - 1], m_decoded[i]); };
+        if (pool)
+        {
+            pool->ParallelFor(static_cast<uint32_t>(m_batch.size()), decode);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < m_batch.size(); ++i)
+            {
+                decode(i);
+            }
+        }
+        statistics.decodeSeconds += SecondsSince(decodeStart);
+
+        auto createStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < m_batch.size(); ++i)
+        {
+            Entry& entry = m_entries[m_batch[i] - 1];
+            const ResourceDesc& desc = entry.desc;
+            const uint8_t* data = entry.encoding == ResourceEncoding_Raw ? entry.image : m_decoded[i].data();
+
+            subresources.clear();
+            if (desc.type == ResourceType_Buffer)
+            {
+                subresources.push_back(ResourceSubresource{ data, desc.byteWidth, desc.byteWidth });
+            }
+            else
+            {
+                for (uint32_t slice = 0; slice < desc.GetSliceCount(); ++slice)
+                {
+                    for (uint32_t mip = 0; mip < desc.GetMipCount(); ++mip)
+                    {
+                        uint32_t rowPitch = MipSize(desc.width, mip) * desc.bytesPerTexel;
+                        uint32_t slicePitch = rowPitch * MipSize(desc.height, mip);
+                        subresources.push_back(ResourceSubresource{ data, rowPitch, slicePitch });
+                        data += slicePitch;
+                    }
+                }
+            }
+
+            device.CreateResource(m_batch[i], desc, subresources.data(), static_cast<uint32_t>(subresources.size()));
+            entry.uploaded = true;
+
+            statistics.resources++;
+            statistics.imageBytes += entry.imageSize;
+            statistics.uploadBytes += desc.GetUploadBytes();
+        }
+        statistics.createSeconds += SecondsSince(createStart);
+        statistics.batches++;
+    }
+
+    // Decoded data is only needed until the device has copied it.
+    for (std::vector<uint8_t>& decoded : m_decoded)
+    {
+        decoded.clear();
+        decoded.shrink_to_fit();
+    }
+
+    statistics.totalSeconds = SecondsSince(start);
+    return statistics;
+}
+
+void DX::ResourceRegistry::OnDeviceLost()
+{
+    for (Entry& entry : m_entries)
+    {
+        entry.uploaded = false;
+    }
+}
+
+const DX::ResourceDesc& DX::ResourceRegistry::GetDesc(ResourceHandle handle) const
+{
+    return GetEntry(handle).desc;
+}
+
+const std::string& DX::ResourceRegistry::GetName(ResourceHandle handle) const
+{
+    return GetEntry(handle).name;
+}
+
+DX::ResourceRegistry::Entry& DX::ResourceRegistry::GetEntry(ResourceHandle handle)
+{
+    assert(handle != 0 && handle <= m_entries.size() && m_entries[handle - 1].live);
+    return m_entries[handle - 1];
+}
+
+const DX::ResourceRegistry::Entry& DX::ResourceRegistry::GetEntry(ResourceHandle handle) const
+{
+    assert(handle != 0 && handle <= m_entries.size() && m_entries[handle - 1].live);
+    return m_entries[handle - 1];
+}
+
+void DX::ResourceRegistry::Decode(const Entry& entry, std::vector<uint8_t>& decoded)
+{
+    if (entry.encoding == ResourceEncoding_Raw)
+    {
+        return;
+    }
+
+    const ResourceDesc& desc = entry.desc;
+    decoded.resize(desc.GetUploadBytes());
+
+    // Each slice's chain follows the one before it.
+    const size_t topBytes = size_t(desc.width) * desc.height * 4;
+    const size_t chainBytes = decoded.size() / desc.GetSliceCount();
+    for (uint32_t slice = 0; slice < desc.GetSliceCount(); ++slice)
+    {
+        GenerateMipChain(entry.image + slice * topBytes, desc.width, desc.height, desc.GetMipCount(), decoded.data() + slice * chainBytes);
+    }
+}
+#pragma endregion
@@ -0,0 +1,162 @@
+//
+// ResourceRegistry.h - CPU-side images of device resources, uploaded again after device lost
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Zero is never a registered resource.
+    typedef uint32_t ResourceHandle;
+
+    // Images decoded per upload batch before they are handed to the device, which bounds the
+    // scratch memory a restore needs.
+    const size_t c_resourceUploadBatchBytes = 32 * 1024 * 1024;
+
+    enum ResourceType
+    {
+        ResourceType_Buffer,
+        ResourceType_Texture2D,
+    };
+
+    // How the registered image relates to the data the device is given.
+    enum ResourceEncoding
+    {
+        ResourceEncoding_Raw,           // Exactly the subresource data: a buffer, or every mip tightly packed.
+        ResourceEncoding_GenerateMips,  // The top mip of an 8 bit RGBA texture, or of each slice in turn; the
+                                        // chains are box filtered on upload.
+    };
+
+    // Writes the full mip chain of an 8 bit RGBA image to chain, tightly packed from the top
+    // mip down: the image itself, then each mip box filtered from the one above it. An odd or
+    // unit dimension repeats its last texel.
+    void GenerateMipChain(const uint8_t* image, uint32_t width, uint32_t height, uint32_t mipCount, uint8_t* chain);
+
+    struct ResourceDesc
+    {
+        ResourceType    type;
+        uint32_t        bindFlags;      // D3D11_BIND_* value.
+        uint32_t        byteWidth;      // Buffers only.
+        uint32_t        structureStride;// Structured buffers only; zero for other buffers.
+        uint32_t        width;          // Textures only, as are the rest.
+        uint32_t        height;
+        uint32_t        arraySize;      // Zero for a single texture, else the slices of a texture array.
+        uint32_t        mipLevels;      // Zero for the full chain.
+        uint32_t        format;         // DXGI_FORMAT value.
+        uint32_t        bytesPerTexel;  // Uncompressed formats only.
+
+        static ResourceDesc Buffer(uint32_t bindFlags, uint32_t byteWidth);
+        static ResourceDesc StructuredBuffer(uint32_t bindFlags, uint32_t structureStride, uint32_t elementCount);
+        static ResourceDesc Texture2D(uint32_t bindFlags, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t format, uint32_t bytesPerTexel);
+        static ResourceDesc Texture2DArray(uint32_t bindFlags, uint32_t width, uint32_t height, uint32_t arraySize, uint32_t mipLevels, uint32_t format, uint32_t bytesPerTexel);
+
+        uint32_t GetMipCount() const;
+        uint32_t GetSliceCount() const                  { return arraySize > 0 ? arraySize : 1; }
+
+        // Subresources are ordered as D3D11 numbers them: every mip of the first slice, then
+        // every mip of the next.
+        uint32_t GetSubresourceCount() const            { return type == ResourceType_Buffer ? 1 : GetMipCount() * GetSliceCount(); }
+
+        // Bytes of every subresource, tightly packed.
+        size_t GetUploadBytes() const;
+    };
+
+    struct ResourceSubresource
+    {
+        const void* data;
+        uint32_t    rowPitch;
+        uint32_t    slicePitch;
+    };
+
+    // The device side: implemented by each backend. Calls come from the thread running Upload.
+    interface IResourceDevice
+    {
+        virtual void CreateResource(ResourceHandle handle, const ResourceDesc& desc, const ResourceSubresource* subresources, uint32_t subresourceCount) = 0;
+        virtual void ReleaseResource(ResourceHandle handle) = 0;
+    };
+
+    struct ResourceUploadStatistics
+    {
+        uint32_t    resources;
+        uint32_t    batches;
+        uint64_t    imageBytes;         // Read from the registered images.
+        uint64_t    uploadBytes;        // Given to the device after decoding.
+        double      decodeSeconds;
+        double      createSeconds;
+        double      totalSeconds;
+    };
+
+    // Keeps a compact image of every device resource for as long as the resource is needed, so
+    // a lost device is rebuilt from memory (or from the pages of a mapped cooked file) instead
+    // of by loading and decoding every asset again. Upload decodes a batch of images on the
+    // worker pool, then creates the batch's resources on the calling thread.
+    class ResourceRegistry
+    {
+    public:
+        ResourceRegistry();
+        ~ResourceRegistry();
+
+        ResourceRegistry(const ResourceRegistry&) = delete;
+        ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+        // Throws std::runtime_error if the image does not match the description.
+        ResourceHandle Add(const char* name, const ResourceDesc& desc, ResourceEncoding encoding, std::vector<uint8_t> image);
+
+        // The image is read from the mapped file in place; the registry keeps the file open.
+        ResourceHandle AddMapped(const char* name, const ResourceDesc& desc, ResourceEncoding encoding,
+            std::shared_ptr<MappedFile> file, size_t offset, size_t size);
+
+        // Releases the device object if it was uploaded.
+        void Remove(ResourceHandle handle, IResourceDevice* device);
+
+        // Creates every resource that has not been uploaded to the current device. A null pool
+        // decodes on the calling thread.
+        ResourceUploadStatistics Upload(IResourceDevice& device, WorkerPool* pool);
+
+        // Marks every resource as needing upload; the device objects are already gone.
+        void OnDeviceLost();
+
+        const ResourceDesc& GetDesc(ResourceHandle handle) const;
+        const std::string& GetName(ResourceHandle handle) const;
+        uint32_t GetResourceCount() const               { return m_liveCount; }
+        uint64_t GetImageBytes() const                  { return m_imageBytes; }
+
+    private:
+        struct Entry
+        {
+            std::string                 name;
+            ResourceDesc                desc;
+            ResourceEncoding            encoding;
+            std::vector<uint8_t>        ownedImage;
+            std::shared_ptr<MappedFile> file;
+            const uint8_t*              image;
+            size_t                      imageSize;
+            bool                        live;
+            bool                        uploaded;
+        };
+
+        ResourceHandle Insert(Entry&& entry);
+        Entry& GetEntry(ResourceHandle handle);
+        const Entry& GetEntry(ResourceHandle handle) const;
+
+        // Fills decoded with the upload data of entry if it is not the image itself.
+        static void Decode(const Entry& entry, std::vector<uint8_t>& decoded);
+
+        std::vector<Entry>                  m_entries;      // Handle - 1.
+        std::vector<ResourceHandle>         m_freeHandles;
+        uint32_t                            m_liveCount;
+        uint64_t                            m_imageBytes;   // Owned images; mapped ones belong to the file.
+
+        // Per batch scratch.
+        std::vector<ResourceHandle>         m_batch;
+        std::vector<std::vector<uint8_t>>   m_decoded;
+    };
+}
@@ -0,0 +1,216 @@
+//
+// RunLoop.cpp - Drives the game from platform events with a tick policy per run mode
+//
+
+#include "pch.h"
+#include "RunLoop.h"
+
+namespace
+{
+    const char* c_modeNames[DX::RunMode_Count] =
+    {
+        "foreground",
+        "background",
+        "suspended",
+        "benchmark",
+    };
+
+    inline double ToSeconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    inline std::chrono::steady_clock::duration FromSeconds(double seconds)
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    }
+};
+
+const char* DX::GetRunModeName(RunMode mode)
+{
+    return mode < RunMode_Count ? c_modeNames[mode] : "unknown";
+}
+
+DX::RunLoop::RunLoop() :
+    m_benchmark(false),
+    m_handler(nullptr),
+    m_active(true),
+    m_suspended(false),
+    m_mode(RunMode_Foreground),
+    m_modeCpuStart(0.0),
+    m_statistics{}
+{
+    m_policies[RunMode_Foreground] = TickPolicy{ true, 0.0 };
+    m_policies[RunMode_Background] = TickPolicy{ true, 1.0 / 10.0 };
+    m_policies[RunMode_Suspended] = TickPolicy{ false, 0.0 };
+    m_policies[RunMode_Benchmark] = TickPolicy{ true, 0.0 };
+}
+
+void DX::RunLoop::SetTickPolicy(RunMode mode, const TickPolicy& policy)
+{
+    m_policies[mode] = policy;
+}
+
+int DX::RunLoop::Run(IPlatformWindow& window, IRunLoopHandler& handler, uint64_t maxTicks)
+{
+    m_handler = &handler;
+    window.SetEventHandler(this);
+
+    m_mode = SelectMode();
+    m_modeWallStart = Clock::now();
+    m_modeCpuStart = GetProcessCpuSeconds();
+    handler.OnRunModeChanged(m_mode);
+
+    uint64_t ticks = 0;
+    auto nextTick = Clock::now();
+
+    while (window.ProcessEvents())
+    {
+        RunMode mode = SelectMode();
+        if (mode != m_mode)
+        {
+            EnterMode(mode);
+            nextTick = Clock::now();
+        }
+
+        const TickPolicy& policy = m_policies[m_mode];
+        RunModeStatistics& statistics = m_statistics.modes[m_mode];
+
+        if (!policy.tick)
+        {
+            statistics.waits++;
+            window.WaitForEvents(-1.0);
+            continue;
+        }
+
+        if (m_mode != RunMode_Benchmark)
+        {
+            auto now = Clock::now();
+            if (now < nextTick)
+            {
+                statistics.waits++;
+                window.WaitForEvents(ToSeconds(nextTick - now));
+                continue;
+            }
+
+            // Events that arrived while the frame pacer waited are handled above first.
+            if (handler.WaitForNextFrame())
+            {
+                continue;
+            }
+        }
+
+        auto tickStart = Clock::now();
+        handler.Tick();
+        statistics.ticks++;
+
+        nextTick = tickStart + FromSeconds(policy.minInterval);
+
+        if (maxTicks && ++ticks >= maxTicks)
+        {
+            break;
+        }
+    }
+
+    AccountTime();
+
+    window.SetEventHandler(nullptr);
+    m_handler = nullptr;
+
+    return window.GetExitCode();
+}
+
+std::string DX::RunLoop::FormatStatistics() const
+{
+    std::string text;
+    for (int i = 0; i < RunMode_Count; ++i)
+    {
+        const RunModeStatistics& mode = m_statistics.modes[i];
+        if (mode.wallSeconds <= 0.0)
+        {
+            continue;
+        }
+
+        char buffer[192];
+        sprintf_s(buffer, "Run loop %s: %.2f s, CPU %.1f%%, %llu ticks (%.1f/s), %llu waits\n",
+            c_modeNames[i], mode.wallSeconds, mode.GetCpuUsage() * 100.0,
+            static_cast<unsigned long long>(mode.ticks), mode.ticks / mode.wallSeconds,
+            static_cast<unsigned long long>(mode.waits));
+        text += buffer;
+    }
+    return text;
+}
+
+void DX::RunLoop::OnActivated()
+{
+    m_active = true;
+    if (m_handler)
+        m_handler->OnActivated();
+}
+
+void DX::RunLoop::OnDeactivated()
+{
+    m_active = false;
+    if (m_handler)
+        m_handler->OnDeactivated();
+}
+
+void DX::RunLoop::OnSuspending()
+{
+    m_suspended = true;
+    if (m_handler)
+        m_handler->OnSuspending();
+}
+
+void DX::RunLoop::OnResuming()
+{
+    m_suspended = false;
+    if (m_handler)
+        m_handler->OnResuming();
+}
+
+void DX::RunLoop::OnWindowSizeChanged(int width, int height)
+{
+    if (m_handler)
+        m_handler->OnWindowSizeChanged(width, height);
+}
+
+void DX::RunLoop::OnInput()
+{
+    if (m_handler)
+        m_handler->OnInput();
+}
+
+DX::RunMode DX::RunLoop::SelectMode() const
+{
+    if (m_benchmark)
+        return RunMode_Benchmark;
+
+    if (m_suspended)
+        return RunMode_Suspended;
+
+    return m_active ? RunMode_Foreground : RunMode_Background;
+}
+
+void DX::RunLoop::EnterMode(RunMode mode)
+{
+    AccountTime();
+
+    m_mode = mode;
+    if (m_handler)
+        m_handler->OnRunModeChanged(mode);
+}
+
+// Charges the time since the last mode change to the current mode.
+void DX::RunLoop::AccountTime()
+{
+    auto now = Clock::now();
+    double cpu = GetProcessCpuSeconds();
+
+    RunModeStatistics& statistics = m_statistics.modes[m_mode];
+    statistics.wallSeconds += ToSeconds(now - m_modeWallStart);
+    statistics.cpuSeconds += cpu - m_modeCpuStart;
+
+    m_modeWallStart = now;
+    m_modeCpuStart = cpu;
+}
@@ -0,0 +1,112 @@
+//
+// RunLoop.h - Drives the game from platform events with a tick policy per run mode
+//
+
+#pragma once
+
+#include "Platform.h"
+
+#include <chrono>
+#include <string>
+
+namespace DX
+{
+    enum RunMode
+    {
+        RunMode_Foreground,     // Active window: tick every frame, paced by the frame pacer.
+        RunMode_Background,     // Another window has focus: tick at a low rate.
+        RunMode_Suspended,      // Minimized or power-suspended: no ticks, sleep until an event.
+        RunMode_Benchmark,      // Tick flat out and never sleep, whatever the window does.
+        RunMode_Count
+    };
+
+    const char* GetRunModeName(RunMode mode);
+
+    struct TickPolicy
+    {
+        bool    tick;           // False to skip ticking altogether and sleep until an event arrives.
+        double  minInterval;    // Seconds between the starts of consecutive ticks; 0 for no limit.
+    };
+
+    struct RunModeStatistics
+    {
+        double      wallSeconds;
+        double      cpuSeconds;     // Process CPU time, all threads.
+        uint64_t    ticks;
+        uint64_t    waits;          // Times the loop slept waiting for events.
+
+        // Average number of cores kept busy while in this mode.
+        double GetCpuUsage() const      { return wallSeconds > 0.0 ? cpuSeconds / wallSeconds : 0.0; }
+    };
+
+    struct RunLoopStatistics
+    {
+        RunModeStatistics modes[RunMode_Count];
+    };
+
+    // The game side of the loop. Event notifications arrive through IPlatformEventHandler.
+    interface IRunLoopHandler : public IPlatformEventHandler
+    {
+        // Returns true if it held the frame back, in which case events are processed again
+        // before Tick is called.
+        virtual bool WaitForNextFrame() = 0;
+        virtual void Tick() = 0;
+
+        // Called before the first tick in a new mode.
+        virtual void OnRunModeChanged(RunMode mode) = 0;
+    };
+
+    // Replaces the classic "tick whenever the message queue is empty" loop, which keeps a core
+    // busy even while the game is minimized. The mode follows the window's activation and
+    // suspension events; between ticks the loop blocks in IPlatformWindow::WaitForEvents, so a
+    // suspended game uses no CPU and a background one only what its low tick rate needs.
+    class RunLoop : private IPlatformEventHandler
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        RunLoop();
+
+        void SetTickPolicy(RunMode mode, const TickPolicy& policy);
+        const TickPolicy& GetTickPolicy(RunMode mode) const     { return m_policies[mode]; }
+
+        // Benchmark mode overrides every other mode for the whole run.
+        void SetBenchmarkMode(bool benchmark)                   { m_benchmark = benchmark; }
+
+        // Runs until the window closes, or until maxTicks ticks if that is not zero. Returns
+        // the window's exit code.
+        int Run(IPlatformWindow& window, IRunLoopHandler& handler, uint64_t maxTicks = 0);
+
+        RunMode GetMode() const                                 { return m_mode; }
+        const RunLoopStatistics& GetStatistics() const          { return m_statistics; }
+
+        // One line per mode that was entered: time, CPU usage and tick rate.
+        std::string FormatStatistics() const;
+
+    private:
+        // IPlatformEventHandler: tracks the mode, then forwards to the game.
+        virtual void OnActivated() override;
+        virtual void OnDeactivated() override;
+        virtual void OnSuspending() override;
+        virtual void OnResuming() override;
+        virtual void OnWindowSizeChanged(int width, int height) override;
+        virtual void OnInput() override;
+
+        RunMode SelectMode() const;
+        void EnterMode(RunMode mode);
+        void AccountTime();
+
+        TickPolicy          m_policies[RunMode_Count];
+        bool                m_benchmark;
+
+        IRunLoopHandler*    m_handler;
+        bool                m_active;
+        bool                m_suspended;
+
+        RunMode             m_mode;
+        Clock::time_point   m_modeWallStart;
+        double              m_modeCpuStart;
+
+        RunLoopStatistics   m_statistics;
+    };
+}
@@ -0,0 +1,129 @@
+//
+// SampleScenes.h - The sample meshes the batch renderer and benchmarks draw, and the camera
+//                  math that frames them
+//
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+namespace DX
+{
+    struct SampleMesh
+    {
+        const char* name;
+        const char* path;           // Relative to the asset directory.
+    };
+
+    // teapot, corvette and murcielago.
+    inline const SampleMesh* GetSampleMeshes(size_t& count)
+    {
+        static const SampleMesh s_meshes[] =
+        {
+            { "teapot",         "teapot/teapot.obj" },
+            { "corvette",       "Corvette-F3/Corvette-F3.obj" },
+            { "murcielago",     "MURCIELAGO640.3ds" },
+        };
+
+        count = sizeof(s_meshes) / sizeof(s_meshes[0]);
+        return s_meshes;
+    }
+
+    // Null if name is not a sample mesh.
+    inline const SampleMesh* FindSampleMesh(const std::string& name)
+    {
+        size_t count;
+        const SampleMesh* meshes = GetSampleMeshes(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (name == meshes[i].name)
+            {
+                return &meshes[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Matrices are row vector, as DirectXMath builds them (clip = position * matrix), so
+    // they can go to the shaders as they are or be swapped for XMMATRIX where that exists.
+    inline void MultiplyMatrices(const float a[4][4], const float b[4][4], float result[4][4])
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                result[row][column] =
+                    a[row][0] * b[0][column] +
+                    a[row][1] * b[1][column] +
+                    a[row][2] * b[2][column] +
+                    a[row][3] * b[3][column];
+            }
+        }
+    }
+
+    // Scale * rotation about Y * translation, as XMMatrixAffineTransformation would build.
+    inline void BuildWorldMatrix(float scale, float yaw, const float position[3], float world[4][4])
+    {
+        float c = cosf(yaw);
+        float s = sinf(yaw);
+
+        world[0][0] = c * scale;  world[0][1] = 0.0f;   world[0][2] = -s * scale; world[0][3] = 0.0f;
+        world[1][0] = 0.0f;       world[1][1] = scale;  world[1][2] = 0.0f;       world[1][3] = 0.0f;
+        world[2][0] = s * scale;  world[2][1] = 0.0f;   world[2][2] = c * scale;  world[2][3] = 0.0f;
+        world[3][0] = position[0]; world[3][1] = position[1]; world[3][2] = position[2]; world[3][3] = 1.0f;
+    }
+
+    // Matches XMMatrixLookAtLH with up = (0, 1, 0). Looking straight up or down picks an
+    // arbitrary roll.
+    inline void BuildLookAtMatrix(const float eye[3], const float at[3], float view[4][4])
+    {
+        float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+        float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+        z[0] /= length; z[1] /= length; z[2] /= length;
+
+        // x = normalize(cross(up, z)).
+        float x[3] = { z[2], 0.0f, -z[0] };
+        length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+        if (length < 1e-6f)
+        {
+            x[0] = 1.0f; x[2] = 0.0f; length = 1.0f;
+        }
+        x[0] /= length; x[2] /= length;
+
+        float y[3] =
+        {
+            z[1] * x[2] - z[2] * x[1],
+            z[2] * x[0] - z[0] * x[2],
+            z[0] * x[1] - z[1] * x[0]
+        };
+
+        for (int i = 0; i < 3; ++i)
+        {
+            view[i][0] = x[i];
+            view[i][1] = y[i];
+            view[i][2] = z[i];
+            view[i][3] = 0.0f;
+        }
+        view[3][0] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+        view[3][1] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+        view[3][2] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+        view[3][3] = 1.0f;
+    }
+
+    // Matches XMMatrixPerspectiveFovLH: [0, 1] depth.
+    inline void BuildPerspectiveMatrix(float fovAngleY, float aspectRatio, float nearZ, float farZ, float projection[4][4])
+    {
+        float yScale = 1.0f / tanf(fovAngleY * 0.5f);
+        float range = farZ / (farZ - nearZ);
+
+        memset(projection, 0, sizeof(float) * 16);
+        projection[0][0] = yScale / aspectRatio;
+        projection[1][1] = yScale;
+        projection[2][2] = range;
+        projection[2][3] = 1.0f;
+        projection[3][2] = -range * nearZ;
+    }
+}
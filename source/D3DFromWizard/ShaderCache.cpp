@@ -0,0 +1,409 @@
+//
+// ShaderCache.cpp - Content-hash keyed cache of compiled shader bytecode, persisted to disk
+//
+
+#include "pch.h"
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <string.h>
+
+namespace
+{
+    // File layout: header, entry table, then blobs aligned to c_blobAlignment. Each entry has
+    // a bytecode blob and an include blob: per include, its content hash, path length and path.
+    const uint32_t c_fileMagic = 0x43485344; // 'DSHC'
+    const uint32_t c_fileVersion = 2;
+    const uint64_t c_blobAlignment = 16;
+
+    struct FileHeader
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint64_t    compilerId;
+        uint64_t    entryCount;
+    };
+
+    struct FileEntry
+    {
+        uint64_t    key;
+        uint64_t    sourceKey;
+        uint64_t    offset;
+        uint64_t    size;
+        uint64_t    includesOffset;
+        uint64_t    includesSize;
+    };
+
+    inline double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Zero if the file cannot be read, which never matches a hash the compiler recorded.
+    uint64_t HashFileContents(const std::string& path)
+    {
+        DX::MappedFile file;
+        if (!file.Open(path))
+        {
+            return 0;
+        }
+        return DX::HashBytes(file.GetData(), file.GetSize());
+    }
+
+    inline uint64_t AddIncludeToKey(uint64_t key, const std::string& path, uint64_t contentHash)
+    {
+        return DX::HashValue(contentHash, DX::HashString(path, key));
+    }
+
+    std::vector<uint8_t> SerializeIncludes(const std::vector<DX::ShaderInclude>& includes)
+    {
+        std::vector<uint8_t> data;
+        for (const DX::ShaderInclude& include : includes)
+        {
+            uint32_t length = static_cast<uint32_t>(include.path.size());
+            size_t position = data.size();
+            data.resize(position + sizeof(uint64_t) + sizeof(uint32_t) + length);
+            memcpy(&data[position], &include.contentHash, sizeof(uint64_t));
+            memcpy(&data[position + sizeof(uint64_t)], &length, sizeof(uint32_t));
+            memcpy(&data[position + sizeof(uint64_t) + sizeof(uint32_t)], include.path.data(), length);
+        }
+        return data;
+    }
+
+    bool DeserializeIncludes(const uint8_t* data, size_t size, std::vector<DX::ShaderInclude>& includes)
+    {
+        const size_t headerSize = sizeof(uint64_t) + sizeof(uint32_t);
+        for (size_t position = 0; position < size; )
+        {
+            if (size - position < headerSize)
+            {
+                return false;
+            }
+
+            DX::ShaderInclude include;
+            uint32_t length;
+            memcpy(&include.contentHash, data + position, sizeof(uint64_t));
+            memcpy(&length, data + position + sizeof(uint64_t), sizeof(uint32_t));
+            position += headerSize;
+
+            if (size - position < length)
+            {
+                return false;
+            }
+            include.path.assign(reinterpret_cast<const char*>(data + position), length);
+            position += length;
+            includes.push_back(std::move(include));
+        }
+        return true;
+    }
+};
+
+DX::ShaderCache::ShaderCache() :
+    m_compilerId(0),
+    m_dirty(false),
+    m_statistics{}
+{
+}
+
+void DX::ShaderCache::SetCompiler(ShaderCompileFunction compiler, uint64_t compilerId)
+{
+    if (compilerId != m_compilerId)
+    {
+        Clear();
+    }
+
+    m_compiler = std::move(compiler);
+    m_compilerId = compilerId;
+}
+
+void DX::ShaderCache::Clear()
+{
+    m_entries.clear();
+    m_sources.clear();
+    m_ownedBlobs.clear();
+    m_file.Close();
+    m_dirty = false;
+    m_memory.Release();
+}
+
+void DX::ShaderCache::UpdateMemoryTracking()
+{
+    uint64_t bytes = m_file.IsOpen() ? m_file.GetSize() : 0;
+    for (const auto& blob : m_ownedBlobs)
+    {
+        bytes += blob->capacity();
+    }
+
+    if (bytes == 0)
+    {
+        m_memory.Release();
+    }
+    else if (bytes != m_memory.GetBytes())
+    {
+        m_memory.Track(MemoryCategory_Shaders, bytes, "shader cache");
+    }
+}
+
+uint64_t DX::ShaderCache::ComputeSourceKey(const ShaderSource& source) const
+{
+    uint64_t hash = HashValue(m_compilerId);
+    hash = HashString(source.source, hash);
+    hash = HashString(source.entryPoint, hash);
+    hash = HashString(source.target, hash);
+    hash = HashValue(source.flags, hash);
+
+    for (const ShaderMacro& macro : source.macros)
+    {
+        hash = HashString(macro.name, hash);
+        hash = HashString(macro.definition, hash);
+    }
+
+    return hash;
+}
+
+uint64_t DX::ShaderCache::ComputeKey(const ShaderSource& source) const
+{
+    uint64_t key = ComputeSourceKey(source);
+    std::vector<ShaderInclude> includes = GetIncludes(source);
+
+    // Files are read outside the lock; an include edited meanwhile only costs a recompile.
+    for (const ShaderInclude& include : includes)
+    {
+        key = AddIncludeToKey(key, include.path, HashFileContents(include.path));
+    }
+
+    return key;
+}
+
+std::vector<DX::ShaderInclude> DX::ShaderCache::GetIncludes(const ShaderSource& source) const
+{
+    uint64_t sourceKey = ComputeSourceKey(source);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sources.find(sourceKey);
+    return it != m_sources.end() ? it->second.includes : std::vector<ShaderInclude>();
+}
+
+bool DX::ShaderCache::Load(const std::string& path)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Clear();
+
+    if (!m_file.Open(path) || m_file.GetSize() < sizeof(FileHeader))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const uint8_t* data = m_file.GetData();
+    const size_t size = m_file.GetSize();
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != c_fileMagic || header.version != c_fileVersion || header.compilerId != m_compilerId
+        || header.entryCount > (size - sizeof(FileHeader)) / sizeof(FileEntry))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const uint8_t* table = data + sizeof(FileHeader);
+    for (uint64_t i = 0; i < header.entryCount; ++i)
+    {
+        FileEntry entry;
+        memcpy(&entry, table + i * sizeof(FileEntry), sizeof(entry));
+
+        SourceEntry source;
+        source.key = entry.key;
+
+        if (entry.offset > size || entry.size > size - entry.offset
+            || entry.includesOffset > size || entry.includesSize > size - entry.includesOffset
+            || !DeserializeIncludes(data + entry.includesOffset, static_cast<size_t>(entry.includesSize), source.includes))
+        {
+            // A truncated file is treated as no cache at all.
+            Clear();
+            return false;
+        }
+
+        m_entries[entry.key] = ShaderBytecode{ data + entry.offset, static_cast<size_t>(entry.size) };
+        m_sources[entry.sourceKey] = std::move(source);
+        m_statistics.bytesLoaded += entry.size;
+    }
+
+    m_statistics.entriesLoaded = static_cast<uint32_t>(header.entryCount);
+    m_statistics.loadSeconds += SecondsSince(start);
+    UpdateMemoryTracking();
+    return true;
+}
+
+void DX::ShaderCache::Save(const std::string& path)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string temporaryPath = path + ".tmp";
+
+    FILE* file = nullptr;
+    if (fopen_s(&file, temporaryPath.c_str(), "wb") != 0 || !file)
+    {
+        throw std::runtime_error("Unable to write shader cache " + temporaryPath);
+    }
+
+    // Every entry belongs to exactly one source; see GetBytecode.
+    FileHeader header = {};
+    header.magic = c_fileMagic;
+    header.version = c_fileVersion;
+    header.compilerId = m_compilerId;
+    header.entryCount = m_sources.size();
+
+    struct Blob
+    {
+        uint64_t    offset;
+        const void* data;
+        size_t      size;
+    };
+
+    std::vector<FileEntry> table;
+    std::vector<Blob> blobs;
+    std::vector<std::vector<uint8_t>> includeBlobs;
+    table.reserve(m_sources.size());
+    includeBlobs.reserve(m_sources.size());
+
+    uint64_t offset = sizeof(FileHeader) + m_sources.size() * sizeof(FileEntry);
+    auto addBlob = [&](const void* data, size_t size)
+    {
+        offset = (offset + c_blobAlignment - 1) & ~(c_blobAlignment - 1);
+        blobs.push_back(Blob{ offset, data, size });
+        offset += size;
+        return blobs.back().offset;
+    };
+
+    for (const auto& source : m_sources)
+    {
+        const ShaderBytecode& bytecode = m_entries[source.second.key];
+        includeBlobs.push_back(SerializeIncludes(source.second.includes));
+
+        FileEntry entry = {};
+        entry.key = source.second.key;
+        entry.sourceKey = source.first;
+        entry.size = bytecode.size;
+        entry.offset = addBlob(bytecode.data, bytecode.size);
+        entry.includesSize = includeBlobs.back().size();
+        entry.includesOffset = addBlob(includeBlobs.back().data(), includeBlobs.back().size());
+        table.push_back(entry);
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && (table.empty() || fwrite(table.data(), sizeof(FileEntry), table.size(), file) == table.size());
+
+    uint64_t position = sizeof(FileHeader) + table.size() * sizeof(FileEntry);
+    static const uint8_t s_padding[c_blobAlignment] = {};
+
+    for (const Blob& blob : blobs)
+    {
+        if (!written)
+        {
+            break;
+        }
+
+        if (blob.offset > position)
+        {
+            written = fwrite(s_padding, 1, static_cast<size_t>(blob.offset - position), file) == blob.offset - position;
+        }
+
+        written = written && (blob.size == 0 || fwrite(blob.data, 1, blob.size, file) == blob.size);
+        position = blob.offset + blob.size;
+    }
+
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        remove(temporaryPath.c_str());
+        throw std::runtime_error("Unable to write shader cache " + temporaryPath);
+    }
+
+    // The old file is still mapped; pull its blobs into memory so it can be replaced.
+    if (m_file.IsOpen())
+    {
+        for (auto& entry : m_entries)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(entry.second.data);
+            if (bytes >= m_file.GetData() && bytes < m_file.GetData() + m_file.GetSize())
+            {
+                m_ownedBlobs.push_back(std::make_unique<std::vector<uint8_t>>(bytes, bytes + entry.second.size));
+                entry.second.data = m_ownedBlobs.back()->data();
+            }
+        }
+        m_file.Close();
+    }
+
+    remove(path.c_str());
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to replace shader cache " + path);
+    }
+
+    m_dirty = false;
+    m_statistics.saveSeconds += SecondsSince(start);
+    UpdateMemoryTracking();
+}
+
+DX::ShaderBytecode DX::ShaderCache::GetBytecode(const ShaderSource& source)
+{
+    uint64_t key = ComputeKey(source);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+        m_statistics.hits++;
+        return it->second;
+    }
+
+    m_statistics.misses++;
+
+    if (!m_compiler)
+    {
+        throw std::runtime_error("Shader cache miss with no compiler set: " + source.name);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto bytecode = std::make_unique<std::vector<uint8_t>>();
+    std::vector<ShaderInclude> includes;
+    std::string errors;
+    if (!m_compiler(source, *bytecode, includes, errors))
+    {
+        throw std::runtime_error("Failed to compile " + source.name + " (" + source.entryPoint + "):\n" + errors);
+    }
+
+    m_statistics.compileSeconds += SecondsSince(start);
+
+    // Keyed on the includes as the compiler read them. The source's previous entry was built
+    // from older includes and can never be hit again, so it is dropped rather than saved.
+    uint64_t sourceKey = ComputeSourceKey(source);
+    key = sourceKey;
+    for (const ShaderInclude& include : includes)
+    {
+        key = AddIncludeToKey(key, include.path, include.contentHash);
+    }
+
+    auto previous = m_sources.find(sourceKey);
+    if (previous != m_sources.end() && previous->second.key != key)
+    {
+        m_entries.erase(previous->second.key);
+    }
+    m_sources[sourceKey] = SourceEntry{ key, std::move(includes) };
+
+    ShaderBytecode result = { bytecode->data(), bytecode->size() };
+    m_ownedBlobs.push_back(std::move(bytecode));
+    m_entries[key] = result;
+    m_dirty = true;
+    UpdateMemoryTracking();
+
+    return result;
+}
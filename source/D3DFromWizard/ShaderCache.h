@@ -0,0 +1,129 @@
+//
+// ShaderCache.h - Content-hash keyed cache of compiled shader bytecode, persisted to disk
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include "MemoryTracker.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    struct ShaderMacro
+    {
+        std::string name;
+        std::string definition;
+    };
+
+    // Everything that influences the compiled bytecode.
+    struct ShaderSource
+    {
+        ShaderSource() : flags(0) {}
+
+        std::string                 name;           // Used for #line information and error messages.
+        std::string                 source;
+        std::string                 entryPoint;
+        std::string                 target;         // e.g. "vs_4_0", "ps_4_0"
+        std::vector<ShaderMacro>    macros;
+        uint32_t                    flags;
+    };
+
+    struct ShaderBytecode
+    {
+        const void* data;
+        size_t      size;
+    };
+
+    // A file the compiler read through #include, by its normalized path (see NormalizePath),
+    // with HashBytes of the contents it read.
+    struct ShaderInclude
+    {
+        std::string path;
+        uint64_t    contentHash;
+    };
+
+    // Compiles a shader, listing every file it included; returns false and fills errors on failure.
+    typedef std::function<bool(const ShaderSource& source, std::vector<uint8_t>& bytecode, std::vector<ShaderInclude>& includes, std::string& errors)> ShaderCompileFunction;
+
+    struct ShaderCacheStatistics
+    {
+        uint32_t    hits;
+        uint32_t    misses;
+        uint32_t    entriesLoaded;
+        uint64_t    bytesLoaded;
+        double      loadSeconds;
+        double      compileSeconds;
+        double      saveSeconds;
+    };
+
+    // Maps the content hash of a ShaderSource (plus the compiler identity) to bytecode.
+    // The files a source included when it was last compiled are remembered with it, and
+    // their current contents are hashed into its key, so editing an include misses the cache
+    // even across runs. A cache file is memory mapped on Load and its blobs are handed out in
+    // place; only shaders compiled this run are held in memory until the next Save. Load,
+    // Save and GetBytecode are serialized so the hot reloader can compile on its worker thread.
+    class ShaderCache
+    {
+    public:
+        ShaderCache();
+
+        // compilerId must change whenever the compiler would produce different bytecode
+        // for the same input, so stale caches are discarded instead of being used.
+        void SetCompiler(ShaderCompileFunction compiler, uint64_t compilerId);
+
+        // Returns false (and leaves the cache empty) if the file is missing, from another
+        // compiler or corrupt. That is not an error; it simply means a cold start.
+        bool Load(const std::string& path);
+
+        // Writes every entry to path. Bytecode pointers returned earlier are invalidated.
+        void Save(const std::string& path);
+
+        // Returns cached bytecode or compiles it. Throws std::runtime_error with the
+        // compiler output if compilation fails. The pointer stays valid until Load or Save.
+        ShaderBytecode GetBytecode(const ShaderSource& source);
+
+        // Reads the files the source included the last time it was compiled. A source that has
+        // not been compiled yet is keyed on its own text, so look it up again after GetBytecode.
+        uint64_t ComputeKey(const ShaderSource& source) const;
+
+        // The files the source included when it was last compiled; empty if it never was.
+        std::vector<ShaderInclude> GetIncludes(const ShaderSource& source) const;
+
+        bool IsDirty() const                                    { return m_dirty; }
+        size_t GetEntryCount() const                            { return m_entries.size(); }
+        const ShaderCacheStatistics& GetStatistics() const      { return m_statistics; }
+
+    private:
+        // What a source key resolved to when it was last compiled.
+        struct SourceEntry
+        {
+            uint64_t                    key;
+            std::vector<ShaderInclude>  includes;
+        };
+
+        void Clear();
+        uint64_t ComputeSourceKey(const ShaderSource& source) const;
+
+        // Charges the mapped file and the owned blobs to MemoryCategory_Shaders.
+        void UpdateMemoryTracking();
+
+        ShaderCompileFunction                                   m_compiler;
+        uint64_t                                                m_compilerId;
+
+        MappedFile                                              m_file;
+        std::unordered_map<uint64_t, ShaderBytecode>            m_entries;
+        std::unordered_map<uint64_t, SourceEntry>               m_sources;
+        std::vector<std::unique_ptr<std::vector<uint8_t>>>      m_ownedBlobs;
+        bool                                                    m_dirty;
+        TrackedMemory                                           m_memory;
+
+        ShaderCacheStatistics                                   m_statistics;
+        mutable std::mutex                                      m_mutex;
+    };
+}
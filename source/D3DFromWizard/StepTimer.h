@@ -4,11 +4,30 @@
 
 #pragma once
 
-#include <exception>
+#include "Platform.h"
+
+#include <algorithm>
+#include <cstdlib>
 #include <stdint.h>
 
 namespace DX
 {
+    // What happened to fixed timestep updates, for spotting a simulation that cannot keep up.
+    struct StepTimerMetrics
+    {
+        static const uint32_t MaxTrackedUpdates = 8;
+
+        uint64_t totalUpdates;
+        uint64_t droppedTicks;          // Time thrown away by the delta clamp and the update cap.
+        uint32_t droppingTicks;         // Ticks that threw time away.
+        uint32_t cappedTicks;           // Ticks that hit the update cap.
+        uint32_t lastTickUpdates;
+        uint32_t maxTickUpdates;
+
+        // updatesPerTick[n] counts ticks that ran n updates; the last entry collects the rest.
+        uint32_t updatesPerTick[MaxTrackedUpdates];
+    };
+
     // Helper class for animation and simulation timing.
     class StepTimer
     {
@@ -22,20 +41,18 @@ namespace DX
             m_framesThisSecond(0),
             m_qpcSecondCounter(0),
             m_isFixedTimeStep(false),
-            m_targetElapsedTicks(TicksPerSecond / 60)
+            m_targetElapsedTicks(TicksPerSecond / 60),
+            m_maxUpdatesPerTick(0),
+            m_simulationQuality(1.0f),
+            m_minSimulationQuality(1.0f),
+            m_ticksWithoutPressure(0),
+            m_metrics{}
         {
-            if (!QueryPerformanceFrequency(&m_qpcFrequency))
-            {
-                throw std::exception( "QueryPerformanceFrequency" );
-            }
-
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception( "QueryPerformanceCounter" );
-            }
+            m_qpcFrequency = GetPerformanceFrequency();
+            m_qpcLastTime = GetPerformanceCounter();
 
             // Initialize max delta to 1/10 of a second.
-            m_qpcMaxDelta = m_qpcFrequency.QuadPart / 10;
+            m_qpcMaxDelta = m_qpcFrequency / 10;
         }
 
         // Get elapsed time since the previous Update call.
@@ -59,6 +76,28 @@ namespace DX
         void SetTargetElapsedTicks(uint64_t targetElapsed)	{ m_targetElapsedTicks = targetElapsed; }
         void SetTargetElapsedSeconds(double targetElapsed)	{ m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
 
+        // Limit the catch-up Update calls a single Tick may make in fixed timestep mode (0 means
+        // no limit). Without a limit, an Update slower than the timestep makes every following
+        // Tick run more of them; with one, the backlog beyond the limit is dropped instead.
+        void SetMaxUpdatesPerTick(uint32_t maxUpdates)		{ m_maxUpdatesPerTick = maxUpdates; }
+
+        // Allow the timer to lower GetSimulationQuality (down to minQuality) while ticks keep
+        // hitting the update limit, and to raise it back once they stop. Update code can use it
+        // to cut solver iterations, AI frequency and the like. 1 disables scaling.
+        void SetMinSimulationQuality(float minQuality)		{ m_minSimulationQuality = minQuality; m_simulationQuality = std::max(m_simulationQuality, minQuality); }
+        float GetSimulationQuality() const					{ return m_simulationQuality; }
+
+        // How far between the last fixed update and the next one the current time is, in [0, 1).
+        // Render state should be interpolated from the previous update by this much. Always 1 in
+        // variable timestep mode.
+        double GetInterpolationAlpha() const
+        {
+            return m_isFixedTimeStep && m_targetElapsedTicks ? static_cast<double>(m_leftOverTicks) / m_targetElapsedTicks : 1.0;
+        }
+
+        const StepTimerMetrics& GetMetrics() const			{ return m_metrics; }
+        void ResetMetrics()									{ m_metrics = StepTimerMetrics{}; }
+
         // Integer format represents time using 10,000,000 ticks per second.
         static const uint64_t TicksPerSecond = 10000000;
 
@@ -71,10 +110,7 @@ namespace DX
 
         void ResetElapsedTime()
         {
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception("QueryPerformanceCounter");
-            }
+            m_qpcLastTime = GetPerformanceCounter();
 
             m_leftOverTicks = 0;
             m_framesPerSecond = 0;
@@ -87,27 +123,26 @@ namespace DX
         void Tick(const TUpdate& update)
         {
             // Query the current time.
-            LARGE_INTEGER currentTime;
+            uint64_t currentTime = GetPerformanceCounter();
 
-            if (!QueryPerformanceCounter(&currentTime))
-            {
-                throw std::exception( "QueryPerformanceCounter" );
-            }
-
-            uint64_t timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
+            uint64_t timeDelta = currentTime - m_qpcLastTime;
 
             m_qpcLastTime = currentTime;
             m_qpcSecondCounter += timeDelta;
 
+            uint64_t droppedTicks = 0;
+            bool capped = false;
+
             // Clamp excessively large time deltas (e.g. after paused in the debugger).
             if (timeDelta > m_qpcMaxDelta)
             {
+                droppedTicks = static_cast<uint64_t>(static_cast<double>(timeDelta - m_qpcMaxDelta) * TicksPerSecond / m_qpcFrequency);
                 timeDelta = m_qpcMaxDelta;
             }
 
             // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
             timeDelta *= TicksPerSecond;
-            timeDelta /= m_qpcFrequency.QuadPart;
+            timeDelta /= m_qpcFrequency;
 
             uint32_t lastFrameCount = m_frameCount;
 
@@ -122,13 +157,24 @@ namespace DX
                 // accumulate enough tiny errors that it would drop a frame. It is better to just round 
                 // small deviations down to zero to leave things running smoothly.
 
-                if (abs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks)) < TicksPerSecond / 4000)
+                if (std::abs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks)) < static_cast<int64_t>(TicksPerSecond / 4000))
                 {
                     timeDelta = m_targetElapsedTicks;
                 }
 
                 m_leftOverTicks += timeDelta;
 
+                // Drop whole steps beyond the limit but keep the fraction, so interpolation
+                // and the phase of later steps are unaffected.
+                if (m_maxUpdatesPerTick && m_leftOverTicks >= m_targetElapsedTicks * (m_maxUpdatesPerTick + 1))
+                {
+                    uint64_t excess = m_leftOverTicks - m_targetElapsedTicks * m_maxUpdatesPerTick;
+                    uint64_t dropped = excess - excess % m_targetElapsedTicks;
+                    m_leftOverTicks -= dropped;
+                    droppedTicks += dropped;
+                    capped = true;
+                }
+
                 while (m_leftOverTicks >= m_targetElapsedTicks)
                 {
                     m_elapsedTicks = m_targetElapsedTicks;
@@ -138,6 +184,8 @@ namespace DX
 
                     update();
                 }
+
+                UpdateSimulationQuality(capped);
             }
             else
             {
@@ -150,24 +198,64 @@ namespace DX
                 update();
             }
 
+            RecordTick(m_frameCount - lastFrameCount, droppedTicks, capped);
+
             // Track the current framerate.
             if (m_frameCount != lastFrameCount)
             {
                 m_framesThisSecond++;
             }
 
-            if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency.QuadPart))
+            if (m_qpcSecondCounter >= m_qpcFrequency)
             {
                 m_framesPerSecond = m_framesThisSecond;
                 m_framesThisSecond = 0;
-                m_qpcSecondCounter %= m_qpcFrequency.QuadPart;
+                m_qpcSecondCounter %= m_qpcFrequency;
             }
         }
 
     private:
-        // Source timing data uses QPC units.
-        LARGE_INTEGER m_qpcFrequency;
-        LARGE_INTEGER m_qpcLastTime;
+        void UpdateSimulationQuality(bool capped)
+        {
+            // Back off quickly under load, recover slowly so quality does not oscillate.
+            const float decrease = 0.8f;
+            const float increase = 0.05f;
+            const uint32_t recoveryTicks = 30;
+
+            if (capped)
+            {
+                m_simulationQuality = std::max(m_simulationQuality * decrease, m_minSimulationQuality);
+                m_ticksWithoutPressure = 0;
+            }
+            else if (++m_ticksWithoutPressure >= recoveryTicks)
+            {
+                m_simulationQuality = std::min(m_simulationQuality + increase, 1.0f);
+                m_ticksWithoutPressure = 0;
+            }
+        }
+
+        void RecordTick(uint32_t updates, uint64_t droppedTicks, bool capped)
+        {
+            m_metrics.totalUpdates += updates;
+            m_metrics.lastTickUpdates = updates;
+            m_metrics.maxTickUpdates = std::max(m_metrics.maxTickUpdates, updates);
+            m_metrics.updatesPerTick[std::min(updates, StepTimerMetrics::MaxTrackedUpdates - 1)]++;
+
+            if (capped)
+            {
+                m_metrics.cappedTicks++;
+            }
+
+            if (droppedTicks)
+            {
+                m_metrics.droppedTicks += droppedTicks;
+                m_metrics.droppingTicks++;
+            }
+        }
+
+        // Source timing data uses QPC units (the platform performance counter).
+        uint64_t m_qpcFrequency;
+        uint64_t m_qpcLastTime;
         uint64_t m_qpcMaxDelta;
 
         // Derived timing data uses a canonical tick format.
@@ -184,5 +272,13 @@ namespace DX
         // Members for configuring fixed timestep mode.
         bool m_isFixedTimeStep;
         uint64_t m_targetElapsedTicks;
+
+        // Members for limiting catch-up in fixed timestep mode.
+        uint32_t m_maxUpdatesPerTick;
+        float m_simulationQuality;
+        float m_minSimulationQuality;
+        uint32_t m_ticksWithoutPressure;
+
+        StepTimerMetrics m_metrics;
     };
 }
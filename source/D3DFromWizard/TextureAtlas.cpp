@@ -0,0 +1,225 @@
+//
+// TextureAtlas.cpp - Packs small textures into guttered atlas pages and remaps mesh texture
+//                    coordinates to match
+//
+
+#include "pch.h"
+#include "TextureAtlas.h"
+
+#include <chrono>
+
+using namespace DX;
+
+namespace
+{
+    // Texture coordinates this far outside [0, 1] are taken as rounding, not tiling.
+    const float c_texcoordTolerance = 1.0f / 1024.0f;
+
+    inline uint32_t AlignUp(uint32_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Copies the texture into its cell, repeating its edge texels out to the cell's edges.
+    void FillCell(const AtlasSourceTexture& texture, uint32_t gutter, uint32_t cellWidth, uint32_t cellHeight,
+        uint8_t* page, uint32_t pageSize, uint32_t cellX, uint32_t cellY)
+    {
+        const size_t rowBytes = size_t(texture.width) * 4;
+        for (uint32_t y = 0; y < cellHeight; ++y)
+        {
+            uint32_t sourceY = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(int64_t(y) - gutter, 0), texture.height - 1));
+            const uint8_t* source = texture.pixels + sourceY * rowBytes;
+            uint8_t* target = page + (size_t(cellY + y) * pageSize + cellX) * 4;
+
+            for (uint32_t x = 0; x < gutter; ++x)
+            {
+                memcpy(target + x * 4, source, 4);
+            }
+            memcpy(target + gutter * 4, source, rowBytes);
+            for (uint32_t x = gutter + texture.width; x < cellWidth; ++x)
+            {
+                memcpy(target + x * 4, source + rowBytes - 4, 4);
+            }
+        }
+    }
+};
+
+bool DX::TextureAtlas::FindPlacement(const std::string& name, AtlasPlacement& placement) const
+{
+    auto found = placements.find(name);
+    if (found == placements.end())
+    {
+        return false;
+    }
+
+    placement = found->second;
+    return true;
+}
+
+TextureAtlas DX::BuildTextureAtlas(const std::vector<AtlasSourceTexture>& textures, const TextureAtlasSettings& settings)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    TextureAtlas atlas;
+    atlas.settings = settings;
+    atlas.report = TextureAtlasReport{};
+    atlas.report.sourceTextures = static_cast<uint32_t>(textures.size());
+
+    // The grid keeps every texture's corner on a texel of the last mip, and the gutter keeps
+    // a texel of that mip between neighbours.
+    const uint32_t grid = 1u << (std::max(settings.mipCount, 1u) - 1);
+    const uint32_t gutter = grid;
+    auto cellWidth = [&](const AtlasSourceTexture& texture) { return AlignUp(texture.width + 2 * gutter, grid); };
+    auto cellHeight = [&](const AtlasSourceTexture& texture) { return AlignUp(texture.height + 2 * gutter, grid); };
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < textures.size(); ++i)
+    {
+        const AtlasSourceTexture& texture = textures[i];
+        if (texture.width > 0 && texture.height > 0 && std::max(texture.width, texture.height) <= settings.maxTextureSize
+            && cellWidth(texture) <= settings.pageSize && cellHeight(texture) <= settings.pageSize)
+        {
+            order.push_back(i);
+        }
+    }
+
+    // Tallest first keeps each shelf's wasted height small.
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        if (cellHeight(textures[a]) != cellHeight(textures[b]))
+        {
+            return cellHeight(textures[a]) > cellHeight(textures[b]);
+        }
+        return cellWidth(textures[a]) != cellWidth(textures[b]) ? cellWidth(textures[a]) > cellWidth(textures[b]) : a < b;
+    });
+
+    const size_t pageBytes = size_t(settings.pageSize) * settings.pageSize * 4;
+    uint32_t shelfX = 0, shelfY = 0, shelfHeight = 0;
+    for (uint32_t index : order)
+    {
+        const AtlasSourceTexture& texture = textures[index];
+        if (atlas.placements.count(texture.name))
+        {
+            continue;
+        }
+
+        const uint32_t width = cellWidth(texture);
+        const uint32_t height = cellHeight(texture);
+        if (shelfX + width > settings.pageSize)
+        {
+            shelfY += shelfHeight;
+            shelfX = shelfHeight = 0;
+        }
+        if (atlas.pages.empty() || shelfY + height > settings.pageSize)
+        {
+            atlas.pages.emplace_back(pageBytes);
+            shelfX = shelfY = shelfHeight = 0;
+        }
+
+        const uint32_t page = static_cast<uint32_t>(atlas.pages.size() - 1);
+        FillCell(texture, gutter, width, height, atlas.pages[page].data(), settings.pageSize, shelfX, shelfY);
+
+        AtlasPlacement placement;
+        placement.page = page;
+        placement.x = shelfX + gutter;
+        placement.y = shelfY + gutter;
+        placement.width = texture.width;
+        placement.height = texture.height;
+        placement.uvScale[0] = static_cast<float>(texture.width) / settings.pageSize;
+        placement.uvScale[1] = static_cast<float>(texture.height) / settings.pageSize;
+        placement.uvOffset[0] = static_cast<float>(placement.x) / settings.pageSize;
+        placement.uvOffset[1] = static_cast<float>(placement.y) / settings.pageSize;
+        atlas.placements.emplace(texture.name, placement);
+
+        shelfX += width;
+        shelfHeight = std::max(shelfHeight, height);
+
+        atlas.report.packedTextures++;
+        atlas.report.textureTexels += uint64_t(texture.width) * texture.height;
+        atlas.report.cellTexels += uint64_t(width) * height;
+    }
+
+    atlas.report.pages = static_cast<uint32_t>(atlas.pages.size());
+    atlas.report.pageTexels = uint64_t(atlas.report.pages) * settings.pageSize * settings.pageSize;
+    atlas.report.occupancy = atlas.report.pageTexels ? static_cast<float>(static_cast<double>(atlas.report.textureTexels) / atlas.report.pageTexels) : 0.0f;
+    atlas.report.packSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return atlas;
+}
+
+bool DX::HasAtlasCompatibleTexcoords(const MeshData& mesh, uint32_t indexOffset, uint32_t indexCount)
+{
+    for (uint32_t i = indexOffset; i < indexOffset + indexCount; ++i)
+    {
+        const float* texcoord = mesh.vertices[mesh.indices[i]].texcoord;
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            if (texcoord[axis] < -c_texcoordTolerance || texcoord[axis] > 1.0f + c_texcoordTolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t DX::RemapAtlasTexcoords(MeshData& mesh, const std::vector<AtlasMeshRange>& ranges)
+{
+    const uint32_t c_unclaimed = 0xFFFFFFFF;
+
+    // Placements by small id; zero keeps the texture coordinates.
+    std::vector<const AtlasPlacement*> placements(1, nullptr);
+    std::unordered_map<const AtlasPlacement*, uint32_t> placementIds;
+    placementIds.emplace(nullptr, 0);
+
+    // Each vertex belongs to the first range that uses it; later ranges with another
+    // placement get a copy, one per vertex and placement.
+    std::vector<uint32_t> owners(mesh.vertices.size(), c_unclaimed);
+    std::unordered_map<uint64_t, uint32_t> copies;
+    uint32_t copyCount = 0;
+
+    for (const AtlasMeshRange& range : ranges)
+    {
+        auto inserted = placementIds.emplace(range.placement, static_cast<uint32_t>(placements.size()));
+        if (inserted.second)
+        {
+            placements.push_back(range.placement);
+        }
+        const uint32_t id = inserted.first->second;
+
+        for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+        {
+            uint32_t vertex = mesh.indices[i];
+            if (owners[vertex] == c_unclaimed)
+            {
+                owners[vertex] = id;
+            }
+            else if (owners[vertex] != id)
+            {
+                auto copy = copies.emplace((uint64_t(vertex) << 32) | id, static_cast<uint32_t>(mesh.vertices.size()));
+                if (copy.second)
+                {
+                    MeshVertex duplicate = mesh.vertices[vertex];
+                    mesh.vertices.push_back(duplicate);
+                    owners.push_back(id);
+                    copyCount++;
+                }
+                mesh.indices[i] = copy.first->second;
+            }
+        }
+    }
+
+    for (size_t vertex = 0; vertex < mesh.vertices.size(); ++vertex)
+    {
+        const AtlasPlacement* placement = owners[vertex] != c_unclaimed ? placements[owners[vertex]] : nullptr;
+        if (placement)
+        {
+            float* texcoord = mesh.vertices[vertex].texcoord;
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                texcoord[axis] = texcoord[axis] * placement->uvScale[axis] + placement->uvOffset[axis];
+            }
+        }
+    }
+
+    return copyCount;
+}
@@ -0,0 +1,103 @@
+//
+// TextureAtlas.h - Packs small textures into guttered atlas pages and remaps mesh texture
+//                  coordinates to match
+//
+
+#pragma once
+
+#include "MeshData.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    struct TextureAtlasSettings
+    {
+        TextureAtlasSettings() :
+            pageSize(1024),
+            maxTextureSize(256),
+            mipCount(4)
+        {
+        }
+
+        uint32_t    pageSize;           // Pages are square and all one size, so they form one texture array.
+        uint32_t    maxTextureSize;     // Textures with a larger side are left on their own.
+
+        // Mips each page is sampled with. Textures sit on a grid of 2^(mipCount - 1) texels
+        // with a gutter that wide around them, so the last mip still has a texel of gutter
+        // and no mip blends one texture into its neighbour.
+        uint32_t    mipCount;
+    };
+
+    // An 8 bit RGBA image, top row first, to be packed.
+    struct AtlasSourceTexture
+    {
+        std::string     name;
+        uint32_t        width;
+        uint32_t        height;
+        const uint8_t*  pixels;
+    };
+
+    // Where a texture went: its texels start at (x, y) on the page, inside its gutter. A
+    // texture coordinate uv in the source becomes uv * uvScale + uvOffset on the page.
+    struct AtlasPlacement
+    {
+        uint32_t    page;
+        uint32_t    x;
+        uint32_t    y;
+        uint32_t    width;
+        uint32_t    height;
+        float       uvScale[2];
+        float       uvOffset[2];
+    };
+
+    struct TextureAtlasReport
+    {
+        uint32_t    sourceTextures;
+        uint32_t    packedTextures;
+        uint32_t    pages;
+        uint64_t    textureTexels;      // Of the packed textures themselves.
+        uint64_t    cellTexels;         // The same with their gutters and grid padding.
+        uint64_t    pageTexels;
+        float       occupancy;          // textureTexels / pageTexels.
+        double      packSeconds;
+    };
+
+    struct TextureAtlas
+    {
+        TextureAtlasSettings                            settings;
+        std::vector<std::vector<uint8_t>>               pages;          // Top mips, 8 bit RGBA; box filter for the rest.
+        std::unordered_map<std::string, AtlasPlacement> placements;     // By source name.
+        TextureAtlasReport                              report;
+
+        // False for textures that were left on their own.
+        bool FindPlacement(const std::string& name, AtlasPlacement& placement) const;
+    };
+
+    // Shelf packs every texture no larger than maxTextureSize, tallest first, opening pages as
+    // they fill. Gutters repeat the texture's edge texels, so sampling near an edge behaves as
+    // clamp addressing would. Only pack textures sampled within [0, 1]: tiling cannot survive
+    // being moved onto a page (see HasAtlasCompatibleTexcoords).
+    TextureAtlas BuildTextureAtlas(const std::vector<AtlasSourceTexture>& textures, const TextureAtlasSettings& settings = TextureAtlasSettings());
+
+    // True when every texture coordinate the triangles use is within [0, 1], give or take
+    // a rounding error.
+    bool HasAtlasCompatibleTexcoords(const MeshData& mesh, uint32_t indexOffset, uint32_t indexCount);
+
+    // A run of triangles and the placement of the texture it samples; null keeps its texture
+    // coordinates.
+    struct AtlasMeshRange
+    {
+        uint32_t                indexOffset;
+        uint32_t                indexCount;
+        const AtlasPlacement*   placement;
+    };
+
+    // Moves the texture coordinates of each range onto its placement. List every range the
+    // mesh draws: a vertex shared by ranges with different placements is duplicated for the
+    // later ones and their indices are pointed at the copy. Returns the number of copies.
+    uint32_t RemapAtlasTexcoords(MeshData& mesh, const std::vector<AtlasMeshRange>& ranges);
+}
@@ -0,0 +1,280 @@
+//
+// TexturePack.cpp - Cooked file of 8 bit RGBA textures with their full mip chains, read mapped
+//
+
+#include "pch.h"
+#include "TexturePack.h"
+#include "ResourceRegistry.h"
+#include "TgaReader.h"
+
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+    // File layout: header, entry table, names, then each chain aligned to c_chainAlignment.
+    const uint32_t c_fileMagic = 0x50585444; // 'DTXP'
+    const uint32_t c_fileVersion = 1;
+    const uint64_t c_chainAlignment = 4096;
+
+    struct FileHeader
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    textureCount;
+        uint32_t    namesBytes;
+    };
+
+    struct FileEntry
+    {
+        uint64_t    offset;
+        uint64_t    bytes;
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    mipCount;
+        uint32_t    nameOffset;     // Into the names, which follow the table.
+        uint32_t    nameLength;
+        uint32_t    reserved;
+    };
+
+    inline uint32_t MipSize(uint32_t size, uint32_t mip)
+    {
+        return std::max<uint32_t>(size >> mip, 1);
+    }
+
+    inline uint32_t GetMipCount(uint32_t width, uint32_t height)
+    {
+        uint32_t mipCount = 1;
+        while ((std::max(width, height) >> mipCount) > 0)
+        {
+            ++mipCount;
+        }
+        return mipCount;
+    }
+
+    std::string GetFileName(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? path : path.substr(separator + 1);
+    }
+
+    std::string ToLower(std::string text)
+    {
+        for (char& c : text)
+        {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    }
+};
+
+size_t DX::GetMipChainOffset(uint32_t width, uint32_t height, uint32_t mip)
+{
+    size_t offset = 0;
+    for (uint32_t level = 0; level < mip; ++level)
+    {
+        offset += size_t(MipSize(width, level)) * MipSize(height, level) * 4;
+    }
+    return offset;
+}
+
+void DX::CookTexturePack(const std::vector<std::string>& sourcePaths, const std::string& packPath, WorkerPool* pool)
+{
+    struct Cooked
+    {
+        std::string             name;
+        uint32_t                width;
+        uint32_t                height;
+        uint32_t                mipCount;
+        std::vector<uint8_t>    chain;
+        std::string             error;
+    };
+
+    std::vector<Cooked> cooked(sourcePaths.size());
+    auto cook = [&](uint32_t i)
+    {
+        Cooked& target = cooked[i];
+        try
+        {
+            TgaImage image = LoadTga(sourcePaths[i]);
+            target.name = GetFileName(sourcePaths[i]);
+            target.width = image.width;
+            target.height = image.height;
+            target.mipCount = GetMipCount(image.width, image.height);
+            target.chain.resize(GetMipChainOffset(image.width, image.height, target.mipCount));
+            GenerateMipChain(image.pixels.data(), image.width, image.height, target.mipCount, target.chain.data());
+        }
+        catch (const std::exception& exception)
+        {
+            target.error = exception.what();
+        }
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(static_cast<uint32_t>(cooked.size()), cook);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < cooked.size(); ++i)
+        {
+            cook(i);
+        }
+    }
+
+    for (const Cooked& texture : cooked)
+    {
+        if (!texture.error.empty())
+        {
+            throw std::runtime_error(texture.error);
+        }
+    }
+
+    FileHeader header = {};
+    header.magic = c_fileMagic;
+    header.version = c_fileVersion;
+    header.textureCount = static_cast<uint32_t>(cooked.size());
+
+    std::string names;
+    std::vector<FileEntry> table(cooked.size());
+    for (size_t i = 0; i < cooked.size(); ++i)
+    {
+        table[i].nameOffset = static_cast<uint32_t>(names.size());
+        table[i].nameLength = static_cast<uint32_t>(cooked[i].name.size());
+        names += cooked[i].name;
+    }
+    header.namesBytes = static_cast<uint32_t>(names.size());
+
+    uint64_t offset = sizeof(FileHeader) + table.size() * sizeof(FileEntry) + names.size();
+    for (size_t i = 0; i < cooked.size(); ++i)
+    {
+        offset = (offset + c_chainAlignment - 1) & ~(c_chainAlignment - 1);
+        table[i].offset = offset;
+        table[i].bytes = cooked[i].chain.size();
+        table[i].width = cooked[i].width;
+        table[i].height = cooked[i].height;
+        table[i].mipCount = cooked[i].mipCount;
+        offset += cooked[i].chain.size();
+    }
+
+    std::string temporaryPath = packPath + ".tmp";
+    FILE* file = nullptr;
+    if (fopen_s(&file, temporaryPath.c_str(), "wb") != 0 || !file)
+    {
+        throw std::runtime_error("Unable to write texture pack " + temporaryPath);
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && (table.empty() || fwrite(table.data(), sizeof(FileEntry), table.size(), file) == table.size())
+        && fwrite(names.data(), 1, names.size(), file) == names.size();
+
+    uint64_t position = sizeof(FileHeader) + table.size() * sizeof(FileEntry) + names.size();
+    static const uint8_t s_padding[c_chainAlignment] = {};
+
+    for (size_t i = 0; i < table.size() && written; ++i)
+    {
+        if (table[i].offset > position)
+        {
+            written = fwrite(s_padding, 1, static_cast<size_t>(table[i].offset - position), file) == table[i].offset - position;
+        }
+
+        written = written && fwrite(cooked[i].chain.data(), 1, cooked[i].chain.size(), file) == cooked[i].chain.size();
+        position = table[i].offset + table[i].bytes;
+    }
+
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+        remove(temporaryPath.c_str());
+        throw std::runtime_error("Unable to write texture pack " + temporaryPath);
+    }
+
+    remove(packPath.c_str());
+    if (rename(temporaryPath.c_str(), packPath.c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to replace texture pack " + packPath);
+    }
+}
+
+bool DX::TexturePack::Open(const std::string& path)
+{
+    m_entries.clear();
+    m_names.clear();
+
+    if (!m_file.Open(path) || m_file.GetSize() < sizeof(FileHeader))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const uint8_t* data = m_file.GetData();
+    const size_t size = m_file.GetSize();
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    size_t namesOffset = sizeof(FileHeader) + size_t(header.textureCount) * sizeof(FileEntry);
+    if (header.magic != c_fileMagic || header.version != c_fileVersion
+        || header.textureCount > (size - sizeof(FileHeader)) / sizeof(FileEntry)
+        || header.namesBytes > size - namesOffset)
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const char* names = reinterpret_cast<const char*>(data + namesOffset);
+    for (uint32_t i = 0; i < header.textureCount; ++i)
+    {
+        FileEntry entry;
+        memcpy(&entry, data + sizeof(FileHeader) + i * sizeof(FileEntry), sizeof(entry));
+
+        // A truncated or inconsistent pack is treated as no pack at all.
+        bool valid = entry.width > 0 && entry.height > 0 && entry.mipCount == GetMipCount(entry.width, entry.height)
+            && entry.bytes == GetMipChainOffset(entry.width, entry.height, entry.mipCount)
+            && entry.offset <= size && entry.bytes <= size - entry.offset
+            && entry.nameOffset <= header.namesBytes && entry.nameLength <= header.namesBytes - entry.nameOffset;
+        if (!valid)
+        {
+            m_entries.clear();
+            m_names.clear();
+            m_file.Close();
+            return false;
+        }
+
+        TexturePackEntry texture;
+        texture.name.assign(names + entry.nameOffset, entry.nameLength);
+        texture.width = entry.width;
+        texture.height = entry.height;
+        texture.mipCount = entry.mipCount;
+        texture.data = data + entry.offset;
+        texture.bytes = static_cast<size_t>(entry.bytes);
+
+        m_names.emplace(ToLower(texture.name), i);
+        m_entries.push_back(std::move(texture));
+    }
+
+    return true;
+}
+
+bool DX::TexturePack::FindTexture(const std::string& path, uint32_t& texture) const
+{
+    auto found = m_names.find(ToLower(GetFileName(path)));
+    if (found == m_names.end())
+    {
+        return false;
+    }
+
+    texture = found->second;
+    return true;
+}
+
+uint64_t DX::TexturePack::GetTotalBytes() const
+{
+    uint64_t bytes = 0;
+    for (const TexturePackEntry& entry : m_entries)
+    {
+        bytes += entry.bytes;
+    }
+    return bytes;
+}
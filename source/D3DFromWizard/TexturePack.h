@@ -0,0 +1,65 @@
+//
+// TexturePack.h - Cooked file of 8 bit RGBA textures with their full mip chains, read mapped
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+    // One texture's full chain, every mip tightly packed from the top down, in the mapping.
+    struct TexturePackEntry
+    {
+        std::string     name;           // Source file name, without its directory.
+        uint32_t        width;
+        uint32_t        height;
+        uint32_t        mipCount;       // Down to 1x1.
+        const uint8_t*  data;
+        size_t          bytes;
+    };
+
+    // Byte offset of mip from the start of a tightly packed 8 bit RGBA chain; mip == mipCount
+    // gives the size of the whole chain.
+    size_t GetMipChainOffset(uint32_t width, uint32_t height, uint32_t mip);
+
+    // Decodes each TGA on the pool, builds its mip chain and writes the pack. Every chain
+    // starts on a page boundary so a mip range maps in without touching its neighbours.
+    // Throws std::runtime_error if a source cannot be decoded or the pack cannot be written.
+    void CookTexturePack(const std::vector<std::string>& sourcePaths, const std::string& packPath, WorkerPool* pool);
+
+    // A cooked pack, mapped. Opening reads only the header and the entry table; mip data is
+    // paged in by whoever reads it first, which the texture streamer does off the render thread.
+    class TexturePack
+    {
+    public:
+        TexturePack() {}
+
+        TexturePack(const TexturePack&) = delete;
+        TexturePack& operator=(const TexturePack&) = delete;
+
+        // Returns false if the file is missing, truncated or not a pack of this version.
+        bool Open(const std::string& path);
+
+        uint32_t GetTextureCount() const                            { return static_cast<uint32_t>(m_entries.size()); }
+        const TexturePackEntry& GetTexture(uint32_t texture) const  { return m_entries[texture]; }
+
+        // Looks a texture up by a path as a material file writes it: the directory is ignored
+        // and so is case, since model files rarely agree with the disk on either.
+        bool FindTexture(const std::string& path, uint32_t& texture) const;
+
+        // Every texture's full chain; what loading everything up front would cost.
+        uint64_t GetTotalBytes() const;
+
+    private:
+        MappedFile                                  m_file;
+        std::vector<TexturePackEntry>               m_entries;
+        std::unordered_map<std::string, uint32_t>   m_names;        // Lower case.
+    };
+}
@@ -0,0 +1,417 @@
+//
+// TextureStreamer.cpp - Keeps each texture's mips resident down to what the screen needs, under
+//                       a memory budget, loading finer mips on a thread of its own
+//
+
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "Platform.h"
+
+#include <cfloat>
+
+using namespace DX;
+
+namespace
+{
+    // The first mip no larger than tailSize, or the 1x1 mip.
+    uint32_t GetTailMip(const TexturePackEntry& entry, uint32_t tailSize)
+    {
+        uint32_t mip = 0;
+        while (mip + 1 < entry.mipCount && (std::max(entry.width, entry.height) >> mip) > tailSize)
+        {
+            ++mip;
+        }
+        return mip;
+    }
+
+    inline void Subtract(const float a[3], const float b[3], float result[3])
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            result[i] = a[i] - b[i];
+        }
+    }
+};
+
+DX::TextureStreamer::TextureStreamer(const TexturePack& pack, const TextureStreamerDesc& desc) :
+    m_pack(pack),
+    m_desc(desc),
+    m_frame(0),
+    m_residentBytes(0),
+    m_loadingBytes(0),
+    m_loadsInFlight(0),
+    m_statistics{},
+    m_generation(0),
+    m_stopping(false)
+{
+    m_textures.resize(pack.GetTextureCount());
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        Texture& texture = m_textures[i];
+        texture.tailMip = GetTailMip(pack.GetTexture(i), desc.tailSize);
+        texture.residentMip = c_notResident;
+        texture.wantedMip = texture.tailMip;
+        texture.requestedMip = FLT_MAX;
+        texture.requested = false;
+        texture.lastUsedFrame = 0;
+        texture.loading = false;
+        texture.waiting = false;
+        texture.waitingSinceFrame = 0;
+    }
+
+    m_loader = std::thread(&TextureStreamer::LoaderMain, this);
+}
+
+DX::TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_loader.join();
+}
+
+void DX::TextureStreamer::BeginFrame()
+{
+    m_frame++;
+    for (Texture& texture : m_textures)
+    {
+        texture.requestedMip = FLT_MAX;
+        texture.requested = false;
+    }
+}
+
+void DX::TextureStreamer::RequestMip(uint32_t texture, float mip)
+{
+    assert(texture < m_textures.size());
+
+    Texture& target = m_textures[texture];
+    target.requestedMip = std::min(target.requestedMip, mip);
+    target.requested = true;
+}
+
+void DX::TextureStreamer::Update(IStreamingTextureDevice& device)
+{
+    // Tails, for new textures and after device lost. They are a few kilobytes each, read
+    // straight from the pack.
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        Texture& texture = m_textures[i];
+        if (texture.residentMip == c_notResident)
+        {
+            const TexturePackEntry& entry = m_pack.GetTexture(i);
+            device.UpdateTexture(i, entry, texture.tailMip, entry.data + GetMipChainOffset(entry.width, entry.height, texture.tailMip),
+                entry.mipCount - texture.tailMip);
+            texture.residentMip = texture.tailMip;
+            m_residentBytes += GetChainBytes(i, texture.tailMip);
+        }
+    }
+
+    // What this frame needs.
+    for (Texture& texture : m_textures)
+    {
+        if (texture.requested)
+        {
+            float mip = std::min(std::max(texture.requestedMip, 0.0f), static_cast<float>(texture.tailMip));
+            texture.wantedMip = static_cast<uint32_t>(mip);
+            texture.lastUsedFrame = m_frame;
+        }
+        else
+        {
+            texture.wantedMip = texture.tailMip;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_applying.swap(m_completed);
+    }
+    for (const Load& load : m_applying)
+    {
+        ApplyLoad(device, load);
+    }
+    m_applying.clear();
+
+    // Textures that only became sharp because they are wanted less count as never waiting.
+    Clock::time_point now = Clock::now();
+    for (Texture& texture : m_textures)
+    {
+        if (texture.residentMip <= texture.wantedMip)
+        {
+            texture.waiting = false;
+        }
+        else if (!texture.waiting)
+        {
+            texture.waiting = true;
+            texture.waitingSince = now;
+            texture.waitingSinceFrame = m_frame;
+        }
+    }
+
+    // A lowered budget, or tails that alone exceed it.
+    uint64_t committed = m_residentBytes + m_loadingBytes;
+    if (committed > m_desc.budgetBytes)
+    {
+        Evict(device, committed - m_desc.budgetBytes, c_notResident);
+    }
+
+    // Furthest from sharp first.
+    m_candidates.clear();
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        if (m_textures[i].wantedMip < m_textures[i].residentMip && !m_textures[i].loading)
+        {
+            m_candidates.push_back(i);
+        }
+    }
+    std::sort(m_candidates.begin(), m_candidates.end(), [this](uint32_t a, uint32_t b)
+    {
+        uint32_t gapA = m_textures[a].residentMip - m_textures[a].wantedMip;
+        uint32_t gapB = m_textures[b].residentMip - m_textures[b].wantedMip;
+        return gapA != gapB ? gapA > gapB : a < b;
+    });
+
+    uint32_t deferredLoads = 0;
+    std::vector<Load> issued;
+    for (uint32_t candidate : m_candidates)
+    {
+        if (m_loadsInFlight + issued.size() >= m_desc.maxLoadsInFlight)
+        {
+            break;
+        }
+
+        const Texture& texture = m_textures[candidate];
+        uint32_t firstMip = texture.wantedMip;
+        uint64_t bytes = GetChainBytes(candidate, firstMip) - GetChainBytes(candidate, texture.residentMip);
+
+        committed = m_residentBytes + m_loadingBytes;
+        if (committed + bytes > m_desc.budgetBytes)
+        {
+            Evict(device, committed + bytes - m_desc.budgetBytes, candidate);
+            committed = m_residentBytes + m_loadingBytes;
+        }
+
+        // Short of the whole way, go as far as fits.
+        while (committed + bytes > m_desc.budgetBytes && firstMip + 1 < texture.residentMip)
+        {
+            firstMip++;
+            bytes = GetChainBytes(candidate, firstMip) - GetChainBytes(candidate, texture.residentMip);
+        }
+        if (committed + bytes > m_desc.budgetBytes)
+        {
+            deferredLoads++;
+            continue;
+        }
+
+        Load load;
+        load.texture = candidate;
+        load.firstMip = firstMip;
+        load.lastMip = texture.residentMip;
+        load.generation = m_generation;
+        issued.push_back(std::move(load));
+
+        m_textures[candidate].loading = true;
+        m_loadingBytes += bytes;
+    }
+
+    if (!issued.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (Load& load : issued)
+            {
+                m_queued.push_back(std::move(load));
+            }
+        }
+        m_loadsInFlight += static_cast<uint32_t>(issued.size());
+        m_wake.notify_one();
+    }
+
+    m_statistics.textures = static_cast<uint32_t>(m_textures.size());
+    m_statistics.sharpTextures = 0;
+    m_statistics.wantedBytes = 0;
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        m_statistics.sharpTextures += m_textures[i].residentMip <= m_textures[i].wantedMip ? 1 : 0;
+        m_statistics.wantedBytes += GetChainBytes(i, m_textures[i].wantedMip);
+    }
+    m_statistics.loadsInFlight = m_loadsInFlight;
+    m_statistics.residentBytes = m_residentBytes;
+    m_statistics.budgetBytes = m_desc.budgetBytes;
+    m_statistics.budgetPressure = m_desc.budgetBytes ? static_cast<float>(static_cast<double>(m_statistics.wantedBytes) / m_desc.budgetBytes) : 0.0f;
+    m_statistics.deferredLoads = deferredLoads;
+}
+
+void DX::TextureStreamer::OnDeviceLost()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation++;
+        m_queued.clear();
+        m_completed.clear();
+    }
+
+    for (Texture& texture : m_textures)
+    {
+        texture.residentMip = c_notResident;
+        texture.loading = false;
+        texture.waiting = false;
+    }
+
+    m_residentBytes = 0;
+    m_loadingBytes = 0;
+    m_loadsInFlight = 0;
+}
+
+uint64_t DX::TextureStreamer::GetChainBytes(uint32_t texture, uint32_t firstMip) const
+{
+    const TexturePackEntry& entry = m_pack.GetTexture(texture);
+    return entry.bytes - GetMipChainOffset(entry.width, entry.height, firstMip);
+}
+
+void DX::TextureStreamer::Resize(IStreamingTextureDevice& device, uint32_t texture, uint32_t firstMip)
+{
+    Texture& target = m_textures[texture];
+    assert(firstMip > target.residentMip && !target.loading);
+
+    uint64_t bytes = GetChainBytes(texture, target.residentMip) - GetChainBytes(texture, firstMip);
+    device.UpdateTexture(texture, m_pack.GetTexture(texture), firstMip, nullptr, 0);
+    target.residentMip = firstMip;
+
+    m_residentBytes -= bytes;
+    m_statistics.evictions++;
+    m_statistics.evictedBytes += bytes;
+}
+
+uint64_t DX::TextureStreamer::Evict(IStreamingTextureDevice& device, uint64_t bytes, uint32_t protectedTexture)
+{
+    // Mips this frame did not ask for: all but the tail of textures not drawn, and those
+    // finer than needed of textures that were.
+    m_evictable.clear();
+    for (uint32_t i = 0; i < m_textures.size(); ++i)
+    {
+        const Texture& texture = m_textures[i];
+        if (i != protectedTexture && !texture.loading && texture.residentMip < texture.wantedMip)
+        {
+            m_evictable.push_back(i);
+        }
+    }
+    std::sort(m_evictable.begin(), m_evictable.end(), [this](uint32_t a, uint32_t b)
+    {
+        return m_textures[a].lastUsedFrame != m_textures[b].lastUsedFrame ? m_textures[a].lastUsedFrame < m_textures[b].lastUsedFrame : a < b;
+    });
+
+    uint64_t freed = 0;
+    for (uint32_t candidate : m_evictable)
+    {
+        const Texture& texture = m_textures[candidate];
+        uint32_t firstMip = texture.residentMip;
+        while (firstMip < texture.wantedMip && freed + GetChainBytes(candidate, texture.residentMip) - GetChainBytes(candidate, firstMip) < bytes)
+        {
+            firstMip++;
+        }
+
+        freed += GetChainBytes(candidate, texture.residentMip) - GetChainBytes(candidate, firstMip);
+        Resize(device, candidate, firstMip);
+        if (freed >= bytes)
+        {
+            break;
+        }
+    }
+    return freed;
+}
+
+void DX::TextureStreamer::ApplyLoad(IStreamingTextureDevice& device, const Load& load)
+{
+    // Started on a device that has since been lost.
+    if (load.generation != m_generation)
+    {
+        return;
+    }
+
+    Texture& texture = m_textures[load.texture];
+    assert(texture.loading && texture.residentMip == load.lastMip);
+
+    device.UpdateTexture(load.texture, m_pack.GetTexture(load.texture), load.firstMip, load.data.data(), load.lastMip - load.firstMip);
+    texture.residentMip = load.firstMip;
+    texture.loading = false;
+
+    m_residentBytes += load.data.size();
+    m_loadingBytes -= load.data.size();
+    m_loadsInFlight--;
+    m_statistics.loads++;
+    m_statistics.loadedBytes += load.data.size();
+
+    if (texture.waiting && texture.residentMip <= texture.wantedMip)
+    {
+        texture.waiting = false;
+        m_timeToSharp.Record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - texture.waitingSince).count());
+        m_framesToSharp.Record(m_frame - texture.waitingSinceFrame);
+    }
+}
+
+void DX::TextureStreamer::LoaderMain()
+{
+    SetCurrentThreadName("Texture loader");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_stopping || !m_queued.empty(); });
+        if (m_stopping)
+        {
+            return;
+        }
+
+        Load load = std::move(m_queued.front());
+        m_queued.erase(m_queued.begin());
+        lock.unlock();
+
+        // The copy is what pages the mips in, here rather than on the render thread.
+        const TexturePackEntry& entry = m_pack.GetTexture(load.texture);
+        const uint8_t* begin = entry.data + GetMipChainOffset(entry.width, entry.height, load.firstMip);
+        const uint8_t* end = entry.data + GetMipChainOffset(entry.width, entry.height, load.lastMip);
+        load.data.assign(begin, end);
+
+        lock.lock();
+        m_completed.push_back(std::move(load));
+    }
+}
+
+float DX::ComputeUvDensity(const MeshData& mesh, uint32_t indexOffset, uint32_t indexCount)
+{
+    double worldArea = 0.0;
+    double uvArea = 0.0;
+    for (uint32_t i = indexOffset; i + 2 < indexOffset + indexCount; i += 3)
+    {
+        const MeshVertex& v0 = mesh.vertices[mesh.indices[i]];
+        const MeshVertex& v1 = mesh.vertices[mesh.indices[i + 1]];
+        const MeshVertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+
+        float e1[3], e2[3];
+        Subtract(v1.position, v0.position, e1);
+        Subtract(v2.position, v0.position, e2);
+        float cross[3] =
+        {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+        };
+        worldArea += sqrt(double(cross[0]) * cross[0] + double(cross[1]) * cross[1] + double(cross[2]) * cross[2]);
+
+        float du1 = v1.texcoord[0] - v0.texcoord[0], dv1 = v1.texcoord[1] - v0.texcoord[1];
+        float du2 = v2.texcoord[0] - v0.texcoord[0], dv2 = v2.texcoord[1] - v0.texcoord[1];
+        uvArea += fabs(double(du1) * dv2 - double(dv1) * du2);
+    }
+
+    // Both sums are twice the areas.
+    return worldArea > 0.0 ? static_cast<float>(sqrt(uvArea / worldArea)) : 0.0f;
+}
+
+float DX::ComputeRequiredMip(uint32_t textureSize, float uvDensity, float distance, float projectionScale)
+{
+    // Texels per pixel: texels per world unit over pixels per world unit at this distance.
+    float texelsPerPixel = textureSize * uvDensity * distance / projectionScale;
+    return texelsPerPixel > 0.0f ? log2f(texelsPerPixel) : FLT_MAX;
+}
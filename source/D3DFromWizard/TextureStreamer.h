@@ -0,0 +1,175 @@
+//
+// TextureStreamer.h - Keeps each texture's mips resident down to what the screen needs, under
+//                     a memory budget, loading finer mips on a thread of its own
+//
+
+#pragma once
+
+#include "Histogram.h"
+#include "MeshData.h"
+#include "TexturePack.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace DX
+{
+    struct TextureStreamerDesc
+    {
+        TextureStreamerDesc() :
+            budgetBytes(256ull * 1024 * 1024),
+            tailSize(64),
+            maxLoadsInFlight(4)
+        {
+        }
+
+        uint64_t    budgetBytes;        // Every resident mip and every load in flight.
+        uint32_t    tailSize;           // Mips no larger than this are always resident.
+        uint32_t    maxLoadsInFlight;
+    };
+
+    // The device side: implemented by each backend. Calls come from the thread running Update.
+    interface IStreamingTextureDevice
+    {
+        // Replaces the texture's device object with one holding mips [firstMip, entry.mipCount).
+        // The first newMipCount of them are in newMips, tightly packed; the rest are copied
+        // from the current object, which holds them. A newMipCount of zero drops top mips.
+        virtual void UpdateTexture(uint32_t texture, const TexturePackEntry& entry, uint32_t firstMip,
+            const uint8_t* newMips, uint32_t newMipCount) = 0;
+    };
+
+    struct TextureStreamingStatistics
+    {
+        uint32_t    textures;
+        uint32_t    sharpTextures;      // Resident down to the mip this frame wants.
+        uint32_t    loadsInFlight;
+        uint64_t    residentBytes;
+        uint64_t    wantedBytes;        // What every texture's wanted mips would take.
+        uint64_t    budgetBytes;
+        float       budgetPressure;     // wantedBytes / budgetBytes; above one cannot all be sharp.
+        uint32_t    deferredLoads;      // This frame, loads that could not fit even after eviction.
+
+        // Since construction.
+        uint64_t    loads;
+        uint64_t    loadedBytes;
+        uint64_t    evictions;
+        uint64_t    evictedBytes;
+    };
+
+    // Textures start with their mip tail resident, the mips no larger than tailSize, created
+    // straight from the pack on the first Update. Each frame the renderer asks for the mip
+    // every visible texture needs (ComputeRequiredMip); Update then loads the finest missing
+    // mips of the textures furthest from sharp, and, when the budget will not hold them,
+    // drops mips nothing asked for this frame, least recently used first. A texture is never
+    // dropped below the mip it was asked for this frame, so under pressure the budget
+    // decides how sharp things get, not which textures flicker.
+    //
+    // D3D11 has no tiled residency, so a texture changes resident mips by being recreated at
+    // its new size: the loaded mips are uploaded and the kept ones copied on the GPU.
+    class TextureStreamer
+    {
+    public:
+        static const uint32_t c_notResident = 0xFFFFFFFF;
+
+        explicit TextureStreamer(const TexturePack& pack, const TextureStreamerDesc& desc = TextureStreamerDesc());
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        // Forgets the last frame's requests.
+        void BeginFrame();
+
+        // The texture is drawn this frame and needs this mip, fractional as ComputeRequiredMip
+        // returns it; the finest of a frame's requests wins.
+        void RequestMip(uint32_t texture, float mip);
+
+        // Applies finished loads, evicts and starts new loads. Call once per frame, after the
+        // frame's requests and before drawing.
+        void Update(IStreamingTextureDevice& device);
+
+        // Every device object is gone. Loads in flight are dropped; the next Update recreates
+        // the tails and streams in again what the frame needs.
+        void OnDeviceLost();
+
+        void SetBudget(uint64_t budgetBytes)            { m_desc.budgetBytes = budgetBytes; }
+
+        uint32_t GetResidentMip(uint32_t texture) const { return m_textures[texture].residentMip; }
+        uint32_t GetWantedMip(uint32_t texture) const   { return m_textures[texture].wantedMip; }
+
+        const TextureStreamingStatistics& GetStatistics() const     { return m_statistics; }
+
+        // From the frame a texture first wanted a finer mip than it had to the Update that
+        // made it sharp, in microseconds and in frames.
+        void GetTimeToSharp(HistogramSnapshot& snapshot) const      { m_timeToSharp.TakeSnapshot(snapshot); }
+        void GetFramesToSharp(HistogramSnapshot& snapshot) const    { m_framesToSharp.TakeSnapshot(snapshot); }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Texture
+        {
+            uint32_t            tailMip;
+            uint32_t            residentMip;
+            uint32_t            wantedMip;
+            float               requestedMip;       // Finest of this frame's requests.
+            bool                requested;          // Drawn this frame.
+            uint64_t            lastUsedFrame;
+            bool                loading;
+            bool                waiting;            // Wants a finer mip than it has.
+            Clock::time_point   waitingSince;
+            uint64_t            waitingSinceFrame;
+        };
+
+        struct Load
+        {
+            uint32_t                texture;
+            uint32_t                firstMip;
+            uint32_t                lastMip;        // Exclusive: the resident mip when it was issued.
+            uint64_t                generation;
+            std::vector<uint8_t>    data;
+        };
+
+        uint64_t GetChainBytes(uint32_t texture, uint32_t firstMip) const;
+        void Resize(IStreamingTextureDevice& device, uint32_t texture, uint32_t firstMip);
+        uint64_t Evict(IStreamingTextureDevice& device, uint64_t bytes, uint32_t protectedTexture);
+        void ApplyLoad(IStreamingTextureDevice& device, const Load& load);
+        void LoaderMain();
+
+        const TexturePack&              m_pack;
+        TextureStreamerDesc             m_desc;
+        std::vector<Texture>            m_textures;
+        uint64_t                        m_frame;
+        uint64_t                        m_residentBytes;
+        uint64_t                        m_loadingBytes;     // Reserved by loads in flight.
+        uint32_t                        m_loadsInFlight;
+        TextureStreamingStatistics      m_statistics;
+        Histogram                       m_timeToSharp;
+        Histogram                       m_framesToSharp;
+
+        // Per update scratch.
+        std::vector<uint32_t>           m_candidates;
+        std::vector<uint32_t>           m_evictable;
+        std::vector<Load>               m_applying;
+
+        // Shared with the loader thread.
+        std::thread                     m_loader;
+        std::mutex                      m_mutex;
+        std::condition_variable         m_wake;
+        std::vector<Load>               m_queued;
+        std::vector<Load>               m_completed;
+        uint64_t                        m_generation;       // Bumped by device lost.
+        bool                            m_stopping;
+    };
+
+    // Square root of texture area over world area across the triangles: texture coordinate
+    // units per world unit, for ComputeRequiredMip.
+    float ComputeUvDensity(const MeshData& mesh, uint32_t indexOffset, uint32_t indexCount);
+
+    // The mip whose texels are about one pixel on screen for a surface uvDensity maps at the
+    // given distance; projectionScale is ComputeLodProjectionScale's. Negative means finer
+    // than the top mip; FLT_MAX means the surface maps no texture area and any mip will do.
+    float ComputeRequiredMip(uint32_t textureSize, float uvDensity, float distance, float projectionScale);
+}
@@ -0,0 +1,201 @@
+//
+// TgaReader.cpp - Truevision TGA decoding into 8 bit RGBA
+//
+
+#include "pch.h"
+#include "TgaReader.h"
+#include "MappedFile.h"
+
+using namespace DX;
+
+namespace
+{
+    enum TgaImageType
+    {
+        TgaImageType_TrueColor = 2,
+        TgaImageType_Greyscale = 3,
+        TgaImageType_RleTrueColor = 10,
+        TgaImageType_RleGreyscale = 11,
+    };
+
+    const size_t c_tgaHeaderBytes = 18;
+
+    // Descriptor bits.
+    const uint8_t c_tgaAlphaBitsMask = 0x0F;
+    const uint8_t c_tgaRightToLeft = 0x10;
+    const uint8_t c_tgaTopToBottom = 0x20;
+
+    inline uint16_t ReadUint16(const uint8_t* data)
+    {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    inline uint8_t Expand5(uint32_t value)
+    {
+        return static_cast<uint8_t>((value << 3) | (value >> 2));
+    }
+
+    // One pixel of the file's layout into RGBA.
+    inline void ConvertPixel(const uint8_t* source, uint32_t bytesPerPixel, bool greyscale, bool hasAlpha, uint8_t* target)
+    {
+        if (greyscale)
+        {
+            target[0] = target[1] = target[2] = source[0];
+            target[3] = bytesPerPixel == 2 && hasAlpha ? source[1] : 255;
+        }
+        else if (bytesPerPixel == 2)
+        {
+            // A1R5G5B5.
+            uint32_t value = ReadUint16(source);
+            target[0] = Expand5((value >> 10) & 31);
+            target[1] = Expand5((value >> 5) & 31);
+            target[2] = Expand5(value & 31);
+            target[3] = hasAlpha && !(value & 0x8000) ? 0 : 255;
+        }
+        else
+        {
+            // BGR or BGRA.
+            target[0] = source[2];
+            target[1] = source[1];
+            target[2] = source[0];
+            target[3] = bytesPerPixel == 4 && hasAlpha ? source[3] : 255;
+        }
+    }
+};
+
+TgaImage DX::DecodeTga(const uint8_t* data, size_t size, const std::string& name)
+{
+    if (size < c_tgaHeaderBytes)
+    {
+        throw std::runtime_error("Truncated TGA header: " + name);
+    }
+
+    uint32_t idLength = data[0];
+    uint32_t colorMapType = data[1];
+    uint32_t imageType = data[2];
+    uint32_t colorMapLength = ReadUint16(data + 5);
+    uint32_t colorMapEntryBits = data[7];
+    uint32_t width = ReadUint16(data + 12);
+    uint32_t height = ReadUint16(data + 14);
+    uint32_t bitsPerPixel = data[16];
+    uint8_t descriptor = data[17];
+
+    bool greyscale = imageType == TgaImageType_Greyscale || imageType == TgaImageType_RleGreyscale;
+    bool rle = imageType == TgaImageType_RleTrueColor || imageType == TgaImageType_RleGreyscale;
+    bool supported =
+        (imageType == TgaImageType_TrueColor || imageType == TgaImageType_RleTrueColor) ? bitsPerPixel == 16 || bitsPerPixel == 24 || bitsPerPixel == 32 :
+        greyscale ? bitsPerPixel == 8 || bitsPerPixel == 16 : false;
+    if (!supported || width == 0 || height == 0)
+    {
+        char buffer[128];
+        sprintf_s(buffer, "Unsupported TGA (type %u, %u bits per pixel, %ux%u): ", imageType, bitsPerPixel, width, height);
+        throw std::runtime_error(buffer + name);
+    }
+
+    // A colour map may be present even when the image does not use it.
+    size_t offset = c_tgaHeaderBytes + idLength;
+    if (colorMapType == 1)
+    {
+        offset += colorMapLength * ((colorMapEntryBits + 7) / 8);
+    }
+
+    const uint32_t bytesPerPixel = bitsPerPixel / 8;
+    const bool hasAlpha = (descriptor & c_tgaAlphaBitsMask) != 0;
+    const size_t pixelCount = size_t(width) * height;
+
+    TgaImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(pixelCount * 4);
+
+    // Pixels in file order first; rows and columns are put right afterwards.
+    uint8_t* target = image.pixels.data();
+    if (!rle)
+    {
+        if (offset > size || (size - offset) / bytesPerPixel < pixelCount)
+        {
+            throw std::runtime_error("Truncated TGA pixels: " + name);
+        }
+
+        const uint8_t* source = data + offset;
+        for (size_t i = 0; i < pixelCount; ++i, source += bytesPerPixel, target += 4)
+        {
+            ConvertPixel(source, bytesPerPixel, greyscale, hasAlpha, target);
+        }
+    }
+    else
+    {
+        // Packets may run on across rows.
+        const uint8_t* source = data + offset;
+        const uint8_t* end = data + size;
+        for (size_t i = 0; i < pixelCount;)
+        {
+            if (source >= end)
+            {
+                throw std::runtime_error("Truncated TGA packets: " + name);
+            }
+
+            uint32_t header = *source++;
+            size_t count = std::min<size_t>((header & 0x7F) + 1, pixelCount - i);
+            bool run = (header & 0x80) != 0;
+            size_t sourceBytes = run ? bytesPerPixel : count * bytesPerPixel;
+            if (static_cast<size_t>(end - source) < sourceBytes)
+            {
+                throw std::runtime_error("Truncated TGA packets: " + name);
+            }
+
+            if (run)
+            {
+                uint8_t pixel[4];
+                ConvertPixel(source, bytesPerPixel, greyscale, hasAlpha, pixel);
+                for (size_t j = 0; j < count; ++j, target += 4)
+                {
+                    memcpy(target, pixel, 4);
+                }
+            }
+            else
+            {
+                for (size_t j = 0; j < count; ++j, target += 4)
+                {
+                    ConvertPixel(source + j * bytesPerPixel, bytesPerPixel, greyscale, hasAlpha, target);
+                }
+            }
+
+            source += sourceBytes;
+            i += count;
+        }
+    }
+
+    const size_t rowBytes = size_t(width) * 4;
+    if (descriptor & c_tgaRightToLeft)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            uint32_t* row = reinterpret_cast<uint32_t*>(image.pixels.data() + y * rowBytes);
+            std::reverse(row, row + width);
+        }
+    }
+
+    // Bottom to top is the default.
+    if (!(descriptor & c_tgaTopToBottom))
+    {
+        for (uint32_t y = 0; y < height / 2; ++y)
+        {
+            std::swap_ranges(image.pixels.begin() + y * rowBytes, image.pixels.begin() + (y + 1) * rowBytes,
+                image.pixels.begin() + (height - 1 - y) * rowBytes);
+        }
+    }
+
+    return image;
+}
+
+TgaImage DX::LoadTga(const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        throw std::runtime_error("Unable to open " + path);
+    }
+
+    return DecodeTga(file.GetData(), file.GetSize(), path);
+}
@@ -0,0 +1,28 @@
+//
+// TgaReader.h - Truevision TGA decoding into 8 bit RGBA
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    struct TgaImage
+    {
+        uint32_t                width;
+        uint32_t                height;
+        std::vector<uint8_t>    pixels;     // 8 bit RGBA, top row first, tightly packed.
+    };
+
+    // Decodes uncompressed and run-length encoded true colour (16, 24 or 32 bits) and greyscale
+    // (8 bits, or 16 with alpha) images in either row order. Images without alpha bits come out
+    // opaque. Throws std::runtime_error naming the image if it is truncated, colour mapped or
+    // otherwise unsupported.
+    TgaImage DecodeTga(const uint8_t* data, size_t size, const std::string& name);
+
+    // Throws std::runtime_error if the file cannot be read, or as DecodeTga does.
+    TgaImage LoadTga(const std::string& path);
+}
@@ -0,0 +1,624 @@
+//
+// VertexLayout.h - Vertex input layouts and constant buffer packing derived from C++ structs and
+// checked at compile time
+//
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace DX
+{
+    // Values are the DXGI_FORMAT each one is read with, so they convert directly.
+    enum VertexFormat
+    {
+        VertexFormat_Unknown    = 0,
+        VertexFormat_Float4     = 2,        // R32G32B32A32_FLOAT
+        VertexFormat_Float3     = 6,        // R32G32B32_FLOAT
+        VertexFormat_Half4      = 10,       // R16G16B16A16_FLOAT
+        VertexFormat_SNorm16x4  = 13,       // R16G16B16A16_SNORM
+        VertexFormat_Float2     = 16,       // R32G32_FLOAT
+        VertexFormat_UNorm8x4   = 28,       // R8G8B8A8_UNORM
+        VertexFormat_SNorm8x4   = 31,       // R8G8B8A8_SNORM
+        VertexFormat_Half2      = 34,       // R16G16_FLOAT
+        VertexFormat_SNorm16x2  = 37,       // R16G16_SNORM
+        VertexFormat_Float1     = 41,       // R32_FLOAT
+    };
+
+    // Storage for the quantized formats. The shader reads all of them as floats.
+    struct Half2        { uint16_t  value[2]; };
+    struct Half4        { uint16_t  value[4]; };
+    struct SNorm16x2    { int16_t   value[2]; };
+    struct SNorm16x4    { int16_t   value[4]; };
+    struct UNorm8x4     { uint8_t   value[4]; };
+    struct SNorm8x4     { int8_t    value[4]; };
+
+    // The format a vertex struct member is read with. A member type without one does not compile.
+    template<typename T> struct VertexFormatOf;
+    template<> struct VertexFormatOf<float>         { static const VertexFormat value = VertexFormat_Float1; };
+    template<> struct VertexFormatOf<float[2]>      { static const VertexFormat value = VertexFormat_Float2; };
+    template<> struct VertexFormatOf<float[3]>      { static const VertexFormat value = VertexFormat_Float3; };
+    template<> struct VertexFormatOf<float[4]>      { static const VertexFormat value = VertexFormat_Float4; };
+    template<> struct VertexFormatOf<Half2>         { static const VertexFormat value = VertexFormat_Half2; };
+    template<> struct VertexFormatOf<Half4>         { static const VertexFormat value = VertexFormat_Half4; };
+    template<> struct VertexFormatOf<SNorm16x2>     { static const VertexFormat value = VertexFormat_SNorm16x2; };
+    template<> struct VertexFormatOf<SNorm16x4>     { static const VertexFormat value = VertexFormat_SNorm16x4; };
+    template<> struct VertexFormatOf<UNorm8x4>      { static const VertexFormat value = VertexFormat_UNorm8x4; };
+    template<> struct VertexFormatOf<SNorm8x4>      { static const VertexFormat value = VertexFormat_SNorm8x4; };
+
+    constexpr uint32_t GetVertexFormatComponents(VertexFormat format)
+    {
+        switch (format)
+        {
+        case VertexFormat_Float1:       return 1;
+        case VertexFormat_Float2:
+        case VertexFormat_Half2:
+        case VertexFormat_SNorm16x2:    return 2;
+        case VertexFormat_Float3:       return 3;
+        case VertexFormat_Float4:
+        case VertexFormat_Half4:
+        case VertexFormat_SNorm16x4:
+        case VertexFormat_UNorm8x4:
+        case VertexFormat_SNorm8x4:     return 4;
+        default:                        return 0;
+        }
+    }
+
+    constexpr uint32_t GetVertexFormatBytes(VertexFormat format)
+    {
+        switch (format)
+        {
+        case VertexFormat_UNorm8x4:
+        case VertexFormat_SNorm8x4:     return 4;
+        case VertexFormat_Half2:
+        case VertexFormat_SNorm16x2:
+        case VertexFormat_Half4:
+        case VertexFormat_SNorm16x4:    return 2 * GetVertexFormatComponents(format);
+        default:                        return 4 * GetVertexFormatComponents(format);
+        }
+    }
+
+    struct VertexElement
+    {
+        const char*     semantic;
+        uint32_t        semanticIndex;
+        VertexFormat    format;
+        uint32_t        offset;
+        uint32_t        bytes;          // Of the struct member.
+    };
+
+    // Describes one member of a vertex struct; its format follows from the member's type.
+    #define DX_VERTEX_ELEMENT(Vertex, member, semantic, semanticIndex) \
+        ::DX::VertexElement{ semantic, semanticIndex, ::DX::VertexFormatOf<decltype(Vertex::member)>::value, \
+            static_cast<uint32_t>(offsetof(Vertex, member)), static_cast<uint32_t>(sizeof(Vertex::member)) }
+
+    // Every element of a vertex struct read from one buffer slot, in member order.
+    template<typename Vertex, size_t Count>
+    struct VertexLayout
+    {
+        VertexElement   elements[Count];
+        uint32_t        stride;
+    };
+
+    template<typename Vertex, typename... Elements>
+    constexpr VertexLayout<Vertex, sizeof...(Elements)> MakeVertexLayout(Elements... elements)
+    {
+        return VertexLayout<Vertex, sizeof...(Elements)>{ { elements... }, static_cast<uint32_t>(sizeof(Vertex)) };
+    }
+
+    constexpr bool SemanticsEqual(const char* a, const char* b)
+    {
+        while (*a && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+
+    // Each member is exactly as large as the format the input assembler reads it with.
+    template<typename Vertex, size_t Count>
+    constexpr bool VertexElementsMatchFormats(const VertexLayout<Vertex, Count>& layout)
+    {
+        for (size_t i = 0; i < Count; ++i)
+        {
+            if (layout.elements[i].bytes != GetVertexFormatBytes(layout.elements[i].format))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Direct3D 11 requires 4 byte aligned elements, and the elements must not overlap.
+    template<typename Vertex, size_t Count>
+    constexpr bool VertexElementsArePlaced(const VertexLayout<Vertex, Count>& layout)
+    {
+        for (size_t i = 0; i < Count; ++i)
+        {
+            const VertexElement& element = layout.elements[i];
+            if (element.offset % 4 != 0 || element.offset + element.bytes > layout.stride)
+            {
+                return false;
+            }
+            for (size_t j = 0; j < i; ++j)
+            {
+                const VertexElement& other = layout.elements[j];
+                if (element.offset < other.offset + other.bytes && other.offset < element.offset + element.bytes)
+                {
+                    return false;
+                }
+                if (SemanticsEqual(element.semantic, other.semantic) && element.semanticIndex == other.semanticIndex)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // No member of the struct is left out of the layout, so no vertex bytes go unread.
+    template<typename Vertex, size_t Count>
+    constexpr bool VertexElementsCoverStride(const VertexLayout<Vertex, Count>& layout)
+    {
+        uint32_t bytes = 0;
+        for (size_t i = 0; i < Count; ++i)
+        {
+            bytes += layout.elements[i].bytes;
+        }
+        return bytes == layout.stride;
+    }
+
+    #define DX_CHECK_VERTEX_LAYOUT(layout) \
+        static_assert(::DX::VertexElementsMatchFormats(layout), #layout ": a member's size does not match its format"); \
+        static_assert(::DX::VertexElementsArePlaced(layout), #layout ": elements are misaligned, overlap or repeat a semantic"); \
+        static_assert(::DX::VertexElementsCoverStride(layout), #layout ": the vertex struct has bytes no element reads")
+
+    namespace ShaderText
+    {
+        constexpr bool IsIdentifier(char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        constexpr bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        constexpr bool StartsWith(const char* text, const char* prefix)
+        {
+            while (*prefix && *text == *prefix)
+            {
+                ++text;
+                ++prefix;
+            }
+            return *prefix == 0;
+        }
+
+        constexpr size_t Length(const char* text)
+        {
+            size_t length = 0;
+            while (text[length])
+            {
+                ++length;
+            }
+            return length;
+        }
+
+        // Offset of the first '{' after "<keyword> <name>" as a whole word, or npos.
+        constexpr size_t FindBlock(const char* source, const char* keyword, const char* name)
+        {
+            const size_t npos = static_cast<size_t>(-1);
+            size_t keywordLength = Length(keyword);
+            size_t nameLength = Length(name);
+            for (size_t i = 0; source[i]; ++i)
+            {
+                if ((i > 0 && IsIdentifier(source[i - 1])) || !StartsWith(source + i, keyword) || !IsSpace(source[i + keywordLength]))
+                {
+                    continue;
+                }
+                size_t at = i + keywordLength;
+                while (IsSpace(source[at]))
+                {
+                    ++at;
+                }
+                if (!StartsWith(source + at, name) || IsIdentifier(source[at + nameLength]))
+                {
+                    continue;
+                }
+                at += nameLength;
+                while (source[at] && source[at] != '{')
+                {
+                    ++at;
+                }
+                return source[at] ? at + 1 : npos;
+            }
+            return npos;
+        }
+
+        // One "type name[count] : semantic;" member declaration of a struct or cbuffer.
+        struct Member
+        {
+            size_t      typeBegin;
+            size_t      typeEnd;
+            size_t      nameEnd;
+            uint32_t    arrayCount;         // Zero when not an array.
+            size_t      semanticBegin;      // Zero when there is none.
+            size_t      semanticEnd;
+            bool        rowMajor;
+            size_t      next;               // Just past the ';', or where the block ends.
+            bool        valid;
+        };
+
+        constexpr Member ReadMember(const char* source, size_t at)
+        {
+            Member member = {};
+            while (IsSpace(source[at]))
+            {
+                ++at;
+            }
+            if (!source[at] || source[at] == '}')
+            {
+                member.next = at;
+                return member;
+            }
+
+            for (;;)
+            {
+                if (StartsWith(source + at, "row_major") && IsSpace(source[at + 9]))
+                {
+                    member.rowMajor = true;
+                    at += 9;
+                }
+                else if (StartsWith(source + at, "column_major") && IsSpace(source[at + 12]))
+                {
+                    at += 12;
+                }
+                else
+                {
+                    break;
+                }
+                while (IsSpace(source[at]))
+                {
+                    ++at;
+                }
+            }
+
+            member.typeBegin = at;
+            while (IsIdentifier(source[at]))
+            {
+                ++at;
+            }
+            member.typeEnd = at;
+            while (IsSpace(source[at]))
+            {
+                ++at;
+            }
+            while (IsIdentifier(source[at]))
+            {
+                ++at;
+            }
+            member.nameEnd = at;
+            while (IsSpace(source[at]))
+            {
+                ++at;
+            }
+            if (source[at] == '[')
+            {
+                ++at;
+                while (source[at] >= '0' && source[at] <= '9')
+                {
+                    member.arrayCount = member.arrayCount * 10 + (source[at++] - '0');
+                }
+                while (source[at] && source[at] != ']')
+                {
+                    ++at;
+                }
+                if (source[at])
+                {
+                    ++at;
+                }
+            }
+            while (IsSpace(source[at]))
+            {
+                ++at;
+            }
+            if (source[at] == ':')
+            {
+                ++at;
+                while (IsSpace(source[at]))
+                {
+                    ++at;
+                }
+                member.semanticBegin = at;
+                while (IsIdentifier(source[at]))
+                {
+                    ++at;
+                }
+                member.semanticEnd = at;
+            }
+            while (source[at] && source[at] != ';' && source[at] != '}')
+            {
+                ++at;
+            }
+
+            member.valid = source[at] == ';' && member.typeEnd > member.typeBegin && member.nameEnd > member.typeEnd;
+            member.next = source[at] == ';' ? at + 1 : at;
+            return member;
+        }
+
+        // Numeric HLSL types: float, half, int, uint or bool with optional dimensions, as in
+        // float3 or float4x4. Returns false for anything else.
+        constexpr bool ParseType(const char* source, size_t begin, size_t end, bool& isFloat, uint32_t& rows, uint32_t& columns)
+        {
+            const char* const bases[] = { "float", "half", "int", "uint", "bool" };
+            for (size_t base = 0; base < 5; ++base)
+            {
+                size_t length = Length(bases[base]);
+                if (!StartsWith(source + begin, bases[base]) || begin + length > end)
+                {
+                    continue;
+                }
+
+                size_t at = begin + length;
+                isFloat = base < 2;
+                rows = 1;
+                columns = 1;
+                if (at < end && source[at] >= '1' && source[at] <= '4')
+                {
+                    columns = static_cast<uint32_t>(source[at++] - '0');
+                    if (at + 1 < end && source[at] == 'x' && source[at + 1] >= '1' && source[at + 1] <= '4')
+                    {
+                        rows = columns;
+                        columns = static_cast<uint32_t>(source[at + 1] - '0');
+                        at += 2;
+                    }
+                }
+                if (at == end)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        constexpr bool SemanticMatches(const char* source, const Member& member, const char* semantic, uint32_t semanticIndex)
+        {
+            size_t length = Length(semantic);
+            if (member.semanticEnd - member.semanticBegin < length)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < length; ++i)
+            {
+                char c = source[member.semanticBegin + i];
+                char upper = c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+                if (upper != semantic[i])
+                {
+                    return false;
+                }
+            }
+
+            // Semantics are case insensitive, and an index of zero may be left out.
+            uint32_t index = 0;
+            for (size_t at = member.semanticBegin + length; at < member.semanticEnd; ++at)
+            {
+                if (source[at] < '0' || source[at] > '9')
+                {
+                    return false;
+                }
+                index = index * 10 + (source[at] - '0');
+            }
+            return index == semanticIndex;
+        }
+    }
+
+    // True if the struct named inputStruct in the HLSL source declares a float input of at most
+    // as many components as its format provides for every element of the layout. This is what
+    // CreateInputLayout checks against the shader signature at run time.
+    template<typename Vertex, size_t Count>
+    constexpr bool ShaderInputMatches(const char* source, const char* inputStruct, const VertexLayout<Vertex, Count>& layout)
+    {
+        size_t block = ShaderText::FindBlock(source, "struct", inputStruct);
+        if (block == static_cast<size_t>(-1))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < Count; ++i)
+        {
+            bool found = false;
+            for (ShaderText::Member member = ShaderText::ReadMember(source, block); member.valid; member = ShaderText::ReadMember(source, member.next))
+            {
+                if (!ShaderText::SemanticMatches(source, member, layout.elements[i].semantic, layout.elements[i].semanticIndex))
+                {
+                    continue;
+                }
+
+                bool isFloat = false;
+                uint32_t rows = 0, columns = 0;
+                found = ShaderText::ParseType(source, member.typeBegin, member.typeEnd, isFloat, rows, columns) &&
+                    isFloat && rows == 1 && member.arrayCount == 0 && columns <= GetVertexFormatComponents(layout.elements[i].format);
+                break;
+            }
+            if (!found)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // One member of a constant buffer struct.
+    struct ConstantMember
+    {
+        uint32_t    offset;
+        uint32_t    bytes;
+    };
+
+    #define DX_CONSTANT_MEMBER(Struct, member) \
+        ::DX::ConstantMember{ static_cast<uint32_t>(offsetof(Struct, member)), static_cast<uint32_t>(sizeof(Struct::member)) }
+
+    // HLSL packs constants into 16 byte registers: a vector never straddles one, while arrays,
+    // matrices and structs always start a new one, and array elements are each a register apart.
+    constexpr uint32_t PackConstant(uint32_t offset, uint32_t bytes, bool startsRegister)
+    {
+        return startsRegister || (offset % 16) + bytes > 16 ? (offset + 15) & ~15u : offset;
+    }
+
+    // True if the cbuffer named bufferName in the HLSL source has exactly these members at these
+    // offsets and sizes, in declaration order, and the struct is padded to whole registers as a
+    // constant buffer's size must be.
+    template<typename Struct, typename... Members>
+    constexpr bool ConstantBufferMatches(const char* source, const char* bufferName, Members... members)
+    {
+        const ConstantMember list[] = { members... };
+        const size_t count = sizeof...(Members);
+
+        size_t block = ShaderText::FindBlock(source, "cbuffer", bufferName);
+        if (block == static_cast<size_t>(-1))
+        {
+            return false;
+        }
+
+        uint32_t offset = 0;
+        size_t index = 0;
+        ShaderText::Member member = ShaderText::ReadMember(source, block);
+        for (; member.valid; member = ShaderText::ReadMember(source, member.next), ++index)
+        {
+            bool isFloat = false;
+            uint32_t rows = 0, columns = 0;
+            if (index == count || !ShaderText::ParseType(source, member.typeBegin, member.typeEnd, isFloat, rows, columns))
+            {
+                return false;
+            }
+
+            // Matrices are column major unless declared otherwise, one register per column.
+            bool matrix = rows > 1;
+            uint32_t registers = !matrix ? 1 : member.rowMajor ? rows : columns;
+            uint32_t lastRegister = 4 * (!matrix || member.rowMajor ? columns : rows);
+            uint32_t elementBytes = 16 * (registers - 1) + lastRegister;
+            uint32_t bytes = member.arrayCount == 0 ? elementBytes : 16 * registers * (member.arrayCount - 1) + elementBytes;
+
+            offset = PackConstant(offset, bytes, matrix || member.arrayCount != 0);
+            if (list[index].offset != offset || list[index].bytes != bytes)
+            {
+                return false;
+            }
+            offset += bytes;
+        }
+
+        return index == count && member.next != 0 && source[member.next] == '}' && sizeof(Struct) == ((offset + 15) & ~15u);
+    }
+
+    inline int16_t EncodeSNorm16(float value)
+    {
+        value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+        return static_cast<int16_t>(lrintf(value * 32767.0f));
+    }
+
+    inline int8_t EncodeSNorm8(float value)
+    {
+        value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+        return static_cast<int8_t>(lrintf(value * 127.0f));
+    }
+
+    inline uint8_t EncodeUNorm8(float value)
+    {
+        value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+        return static_cast<uint8_t>(lrintf(value * 255.0f));
+    }
+
+    // IEEE half precision, rounded to nearest even. Out of range values become infinity.
+    inline uint16_t EncodeHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t magnitude = bits & 0x7fffffffu;
+
+        if (magnitude >= 0x7f800000u)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+        }
+        if (magnitude >= 0x477ff000u)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00u);
+        }
+        if (magnitude < 0x38800000u)
+        {
+            // Denormal: the mantissa counts multiples of 2^-24.
+            return static_cast<uint16_t>(sign | static_cast<uint32_t>(lrintf(fabsf(value) * 16777216.0f)));
+        }
+
+        uint32_t half = (magnitude - 0x38000000u) >> 13;
+        uint32_t rest = magnitude & 0x1fffu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+        {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Writes count floats into a vertex member of any format; components past count are zero.
+    template<size_t N>
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, float (&out)[N])
+    {
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            out[i] = i < count ? values[i] : 0.0f;
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, Half2& out)
+    {
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            out.value[i] = EncodeHalf(i < count ? values[i] : 0.0f);
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, Half4& out)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            out.value[i] = EncodeHalf(i < count ? values[i] : 0.0f);
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, SNorm16x2& out)
+    {
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            out.value[i] = EncodeSNorm16(i < count ? values[i] : 0.0f);
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, SNorm16x4& out)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            out.value[i] = EncodeSNorm16(i < count ? values[i] : 0.0f);
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, UNorm8x4& out)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            out.value[i] = EncodeUNorm8(i < count ? values[i] : 0.0f);
+        }
+    }
+
+    inline void EncodeVertexAttribute(const float* values, uint32_t count, SNorm8x4& out)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            out.value[i] = EncodeSNorm8(i < count ? values[i] : 0.0f);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+//
+// WorkerPool.cpp - Fixed set of worker threads for data parallel loops
+//
+
+#include "pch.h"
+#include "WorkerPool.h"
+#include "Platform.h"
+
+DX::WorkerPool::WorkerPool(uint32_t workerCount) :
+    m_generation(0),
+    m_busyWorkers(0),
+    m_stopping(false),
+    m_function(nullptr),
+    m_count(0),
+    m_next(0)
+{
+    if (workerCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        m_workers.emplace_back(&WorkerPool::WorkerMain, this, i);
+    }
+}
+
+DX::WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void DX::WorkerPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function)
+{
+    // Waking the workers costs more than a single iteration is likely to.
+    if (m_workers.empty() || count <= 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            function(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_function = &function;
+        m_count = count;
+        m_next = 0;
+        m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunIterations();
+
+    // Every worker checks in, even one that woke after the last iteration was taken, so none
+    // can still be reading m_function when this returns.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_function = nullptr;
+}
+
+void DX::WorkerPool::WorkerMain(uint32_t index)
+{
+    char name[32];
+    sprintf_s(name, "Worker %u", index);
+    SetCurrentThreadName(name);
+
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        RunIterations();
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            last = --m_busyWorkers == 0;
+        }
+        if (last)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+void DX::WorkerPool::RunIterations()
+{
+    for (;;)
+    {
+        uint32_t i = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= m_count)
+        {
+            return;
+        }
+        (*m_function)(i);
+    }
+}
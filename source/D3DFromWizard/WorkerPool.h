@@ -0,0 +1,55 @@
+//
+// WorkerPool.h - Fixed set of worker threads for data parallel loops
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+    // Runs the iterations of a loop on persistent worker threads and the calling thread. The
+    // threads sleep between loops, so an idle pool costs nothing.
+    class WorkerPool
+    {
+    public:
+        // Zero workers means one fewer than the number of hardware threads, since the calling
+        // thread takes part in every loop.
+        explicit WorkerPool(uint32_t workerCount = 0);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Workers plus the calling thread.
+        uint32_t GetThreadCount() const         { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+        // Calls function(i) for every i in [0, count) and returns once all calls have returned.
+        // Iterations run in no particular order and must not throw. Not reentrant: call from
+        // one thread at a time, and not from inside function.
+        void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function);
+
+    private:
+        void WorkerMain(uint32_t index);
+        void RunIterations();
+
+        std::vector<std::thread>                m_workers;
+
+        std::mutex                              m_mutex;
+        std::condition_variable                 m_wake;
+        std::condition_variable                 m_done;
+        uint64_t                                m_generation;
+        uint32_t                                m_busyWorkers;
+        bool                                    m_stopping;
+
+        // The loop being run. Written under m_mutex before the workers are woken.
+        const std::function<void(uint32_t)>*    m_function;
+        uint32_t                                m_count;
+        std::atomic<uint32_t>                   m_next;
+    };
+}
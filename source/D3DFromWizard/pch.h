@@ -5,6 +5,8 @@
 
 #pragma once
 
+#if defined(_WIN32)
+
 #include <WinSDKVer.h>
 #define _WIN32_WINNT 0x0600
 #include <SDKDDKVer.h>
@@ -35,12 +37,18 @@
 #include <DirectXMath.h>
 #include <DirectXColors.h>
 
+#endif
+
 #include <algorithm>
+#include <assert.h>
 #include <exception>
 #include <memory>
 #include <stdexcept>
 
 #include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
 
 namespace DX
 {
@@ -48,17 +56,21 @@ namespace DX
     class com_exception : public std::exception
     {
     public:
-        com_exception(HRESULT hr) : result(hr) {}
+        com_exception(HRESULT hr) : result(hr)
+        {
+            snprintf(message, sizeof(message), "Failure with HRESULT of %08X", static_cast<unsigned int>(hr));
+        }
 
-        virtual const char* what() const override
+        virtual const char* what() const noexcept override
         {
-            static char s_str[64] = { 0 };
-            sprintf_s(s_str, "Failure with HRESULT of %08X", result);
-            return s_str;
+            return message;
         }
 
+        HRESULT get_result() const noexcept { return result; }
+
     private:
         HRESULT result;
+        char message[64];
     };
 
     // Helper utility converts D3D API failures into exceptions.
@@ -69,4 +81,29 @@ namespace DX
             throw com_exception(hr);
         }
     }
-}
\ No newline at end of file
+}
+
+#else
+
+// Everything except the Direct3D 11 backend also builds with GCC and Clang (see CMakeLists.txt).
+// These are the few MSVC spellings it relies on.
+
+#include <errno.h>
+
+#define interface struct
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+template<size_t TSize, typename... TArgs>
+inline int sprintf_s(char (&buffer)[TSize], const char* format, TArgs... args)
+{
+    return snprintf(buffer, TSize, format, args...);
+}
+
+inline int fopen_s(FILE** file, const char* path, const char* mode)
+{
+    *file = fopen(path, mode);
+    return *file ? 0 : errno;
+}
+
+#endif
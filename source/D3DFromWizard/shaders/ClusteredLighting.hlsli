@@ -0,0 +1,71 @@
+//
+// ClusteredLighting.hlsli - Point and spot lights looked up through the clustered light grid
+// built by DX::LightClusterBuilder
+//
+
+// Must match LightClustering.h.
+#define LIGHT_GRID_TILES_X  16
+#define LIGHT_GRID_TILES_Y  8
+#define LIGHT_GRID_SLICES   24
+
+#define LIGHT_TYPE_POINT    0
+#define LIGHT_TYPE_SPOT     1
+
+// DX::Light, in view space.
+struct ClusteredLight
+{
+    float3  position;
+    float   range;
+    float3  direction;
+    float   spotAngle;
+    float3  color;
+    uint    type;
+};
+
+cbuffer LightGridBuffer
+{
+    float2  screenSize;         // Render target size in pixels.
+    float   sliceScale;         // LightClusterBuilder::GetSliceScale.
+    float   sliceBias;          // LightClusterBuilder::GetSliceBias.
+};
+
+StructuredBuffer<ClusteredLight>    lights;
+StructuredBuffer<uint2>             lightClusters;      // LightClusterRange per cluster.
+Buffer<uint>                        lightIndices;       // R16_UINT.
+
+uint GetLightCluster(float4 svPosition, float viewDepth)
+{
+    uint2 tile = min(uint2(svPosition.xy * float2(LIGHT_GRID_TILES_X, LIGHT_GRID_TILES_Y) / screenSize),
+        uint2(LIGHT_GRID_TILES_X - 1, LIGHT_GRID_TILES_Y - 1));
+    uint slice = uint(clamp(floor(log(viewDepth) * sliceScale + sliceBias), 0, LIGHT_GRID_SLICES - 1));
+    return (slice * LIGHT_GRID_TILES_Y + tile.y) * LIGHT_GRID_TILES_X + tile.x;
+}
+
+// Diffuse light reaching a view-space surface from every light in its cluster, with the same
+// smooth falloff to zero at range that the cluster bounds assume.
+float3 ComputeClusteredLighting(float4 svPosition, float3 viewPosition, float3 normal)
+{
+    uint2 range = lightClusters[GetLightCluster(svPosition, viewPosition.z)];
+
+    float3 total = 0;
+    for (uint i = 0; i < range.y; ++i)
+    {
+        ClusteredLight light = lights[lightIndices[range.x + i]];
+
+        float3 toLight = light.position - viewPosition;
+        float distance = length(toLight);
+        toLight /= distance;
+
+        float falloff = saturate(1 - distance / light.range);
+        float intensity = saturate(dot(normal, toLight)) * falloff * falloff;
+
+        if (light.type == LIGHT_TYPE_SPOT)
+        {
+            float cosOuter = cos(light.spotAngle);
+            intensity *= saturate((dot(-toLight, light.direction) - cosOuter) / (1 - cosOuter));
+        }
+
+        total += light.color * intensity;
+    }
+    return total;
+}
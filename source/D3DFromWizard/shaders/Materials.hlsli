@@ -0,0 +1,72 @@
+//
+// Materials.hlsli - Material parameters and textures looked up by material id, as bound by
+// DX::MaterialSystem through the command sink
+//
+
+// Must match MaterialSystem.h.
+#define MATERIAL_TEXTURE_TABLES         8
+#define MATERIAL_NO_TEXTURE             0xFFFFFFFF
+
+#define MATERIAL_FLAG_TRANSPARENT       1
+#define MATERIAL_FLAG_TWO_SIDED         2
+
+// DX::MaterialParameters.
+struct MaterialParameters
+{
+    float3  diffuse;
+    float   opacity;
+    float3  specular;
+    float   specularExponent;
+    float3  ambient;
+    float   alphaCutoff;
+    uint    diffuseMap;
+    uint    normalMap;
+    uint    specularMap;
+    uint    flags;
+};
+
+// Bound once per frame; a draw passes its DrawPacket::material with its per-object constants.
+StructuredBuffer<MaterialParameters>    materials           : register(t0);
+Texture2DArray                          materialTable0      : register(t1);
+Texture2DArray                          materialTable1      : register(t2);
+Texture2DArray                          materialTable2      : register(t3);
+Texture2DArray                          materialTable3      : register(t4);
+Texture2DArray                          materialTable4      : register(t5);
+Texture2DArray                          materialTable5      : register(t6);
+Texture2DArray                          materialTable6      : register(t7);
+Texture2DArray                          materialTable7      : register(t8);
+SamplerState                            materialSampler     : register(s0);
+
+// Shader model 5 cannot index an array of textures with a computed value, hence the switch.
+float4 SampleMaterialTexture(uint texture, float2 uv, float4 missing)
+{
+    if (texture == MATERIAL_NO_TEXTURE)
+    {
+        return missing;
+    }
+
+    float3 location = float3(uv, texture & 0xFFFF);
+    [forcecase] switch (texture >> 16)
+    {
+    case 0:     return materialTable0.Sample(materialSampler, location);
+    case 1:     return materialTable1.Sample(materialSampler, location);
+    case 2:     return materialTable2.Sample(materialSampler, location);
+    case 3:     return materialTable3.Sample(materialSampler, location);
+    case 4:     return materialTable4.Sample(materialSampler, location);
+    case 5:     return materialTable5.Sample(materialSampler, location);
+    case 6:     return materialTable6.Sample(materialSampler, location);
+    default:    return materialTable7.Sample(materialSampler, location);
+    }
+}
+
+// Diffuse colour and opacity at uv, with the diffuse map applied; discards texels below the
+// material's alpha cutoff.
+float4 GetMaterialDiffuse(MaterialParameters material, float2 uv)
+{
+    float4 color = float4(material.diffuse, material.opacity) * SampleMaterialTexture(material.diffuseMap, uv, 1);
+    if (color.a < material.alphaCutoff)
+    {
+        discard;
+    }
+    return color;
+}
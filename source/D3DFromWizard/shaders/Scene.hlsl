@@ -0,0 +1,69 @@
+//
+// Scene.hlsl - Preset scene instances (DX::PresetScene) shaded with their material under a key
+// light. The three pixel shaders let the scene exercise pixel shader switches.
+//
+
+#include "Materials.hlsli"
+
+// Must match SceneConstants in Game.cpp. Filled per draw by the command sink's draw callback.
+cbuffer SceneConstants : register(b0)
+{
+    row_major float4x4  worldViewProjection;
+    row_major float4x4  world;
+    float4              lightDirection;     // World space, towards the light.
+    uint                material;
+};
+
+struct VS_IN
+{
+    float3 pos      : POSITION;
+    float3 normal   : NORMAL;
+    float2 uv       : TEXCOORD;
+};
+
+struct VS_OUT
+{
+    float4 pos      : SV_POSITION;
+    float3 normal   : NORMAL;
+    float2 uv       : TEXCOORD;
+};
+
+VS_OUT VS(VS_IN input)
+{
+    VS_OUT output;
+    output.pos = mul(float4(input.pos, 1), worldViewProjection);
+
+    // Instances are only scaled uniformly and rotated, so the world matrix transforms normals.
+    output.normal = mul(input.normal, (float3x3)world);
+    output.uv = input.uv;
+    return output;
+}
+
+// Lambert with the material's ambient term.
+float4 PSDiffuse(VS_OUT input) : SV_Target
+{
+    MaterialParameters parameters = materials[material];
+    float4 diffuse = GetMaterialDiffuse(parameters, input.uv);
+    float lighting = saturate(dot(normalize(input.normal), lightDirection.xyz));
+    return float4(parameters.ambient + diffuse.rgb * lighting, diffuse.a);
+}
+
+// Adds a Blinn-Phong highlight for a viewer looking down the light, which needs no camera.
+float4 PSSpecular(VS_OUT input) : SV_Target
+{
+    MaterialParameters parameters = materials[material];
+    float4 diffuse = GetMaterialDiffuse(parameters, input.uv);
+    float3 normal = normalize(input.normal);
+    float lighting = saturate(dot(normal, lightDirection.xyz));
+    float highlight = pow(lighting, max(parameters.specularExponent, 1));
+    return float4(parameters.ambient + diffuse.rgb * lighting + parameters.specular * highlight, diffuse.a);
+}
+
+// Two-band toon shading.
+float4 PSBanded(VS_OUT input) : SV_Target
+{
+    MaterialParameters parameters = materials[material];
+    float4 diffuse = GetMaterialDiffuse(parameters, input.uv);
+    float lighting = dot(normalize(input.normal), lightDirection.xyz) > 0.3 ? 1.0 : 0.4;
+    return float4(parameters.ambient + diffuse.rgb * lighting, diffuse.a);
+}